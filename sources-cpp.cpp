@@ -1,4 +1,6 @@
 #include "src\common\Common.cpp"
+#include "src\common\Bitset.cpp"
+#include "src\common\Arena.cpp"
 #include "src\common\Csv.cpp"
 #include "src\common\Directory.cpp"
 #include "src\common\FileStream.cpp"
@@ -7,16 +9,26 @@
 #include "src\common\Mime.cpp"
 #include "src\common\RootHandler.cpp"
 #include "src\common\Sockets.cpp"
+#include "src\common\Threads.cpp"
+#include "src\common\PerfCounters.cpp"
+#include "src\common\IoRing.cpp"
+#include "src\common\SharedMemory.cpp"
 #include "src\md5\md5.cpp"
 #include "src\CascDecompress.cpp"
 #include "src\CascDecrypt.cpp"
 #include "src\CascDumpData.cpp"
 #include "src\CascFiles.cpp"
 #include "src\CascFindFile.cpp"
+#include "src\CascFrameCache.cpp"
+#include "src\CascExtract.cpp"
+#include "src\CascCdnCache.cpp"
+#include "src\CascScrub.cpp"
+#include "src\CascSharedIndex.cpp"
 #include "src\CascIndexFiles.cpp"
 #include "src\CascOpenFile.cpp"
 #include "src\CascOpenStorage.cpp"
 #include "src\CascReadFile.cpp"
+#include "src\CascReadFileAsync.cpp"
 #include "src\CascRootFile_Diablo3.cpp"
 #include "src\CascRootFile_Install.cpp"
 #include "src\CascRootFile_MNDX.cpp"
@@ -0,0 +1,601 @@
+/*****************************************************************************/
+/* CascCdnCache.cpp                       Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Disk cache of the data files downloaded from CDN                          */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 19.10.26  1.00  Lad  The first version of CascCdnCache.cpp                */
+/*****************************************************************************/
+
+#define __CASCLIB_SELF__
+#include "CascLib.h"
+#include "CascCommon.h"
+
+//-----------------------------------------------------------------------------
+// Local defines
+
+#define CASC_CDN_CACHE_SIGNATURE    0x43444E43      // 'CNDC'
+#define CASC_CDN_CACHE_VERSION      1
+
+#define CASC_CDN_CACHE_MIN_BUCKETS  0x400           // Minimum number of hash buckets
+#define CASC_CDN_CACHE_MAX_BUCKETS  0x100000        // Maximum number of hash buckets
+#define CASC_CDN_CACHE_BUCKET_BYTES 0x10000         // One hash bucket per this many bytes of the budget
+#define CASC_CDN_CACHE_MIN_LOG      0x400           // The index is rewritten when the log has this many records
+                                                    // (or more records than the cache has entries)
+#define CASC_CDN_CACHE_MAX_FILE     0x10000000      // Larger index or log is considered corrupt
+
+#define CASC_CDN_OP_STORE           0x45524F54      // 'TORE': The file was stored to the cache
+#define CASC_CDN_OP_DELETE          0x454C4544      // 'DELE': The file was deleted from the cache
+
+// Header of "cache.idx". The records follow
+struct CASC_CDN_CACHE_HEADER
+{
+    DWORD Signature;                                // CASC_CDN_CACHE_SIGNATURE
+    DWORD Version;                                  // CASC_CDN_CACHE_VERSION
+    DWORD RecordCount;                              // Number of records that follow the header
+    DWORD Reserved;
+};
+
+// One record of "cache.idx" and "cache.log". The index contains the files
+// from the least recently used to the most recently used one
+struct CASC_CDN_CACHE_RECORD
+{
+    BYTE EKey[MD5_HASH_SIZE];                       // EKey of the file
+    DWORD FileSize;                                 // Size of the file
+    DWORD Operation;                                // CASC_CDN_OP_XXX
+    DWORD Checksum;                                 // Detects a record that was not written completely
+};
+
+static DWORD GetRecordChecksum(const CASC_CDN_CACHE_RECORD & Record)
+{
+    const BYTE * pbRecord = (const BYTE *)(&Record);
+    DWORD dwHash = 0x811C9DC5;
+
+    // FNV-1a of everything but the checksum
+    for(size_t i = 0; i < FIELD_OFFSET(CASC_CDN_CACHE_RECORD, Checksum); i++)
+        dwHash = (dwHash ^ pbRecord[i]) * 0x01000193;
+    return dwHash ^ CASC_CDN_CACHE_SIGNATURE;
+}
+
+static void InitRecord(CASC_CDN_CACHE_RECORD & Record, LPBYTE EKey, DWORD FileSize, DWORD Operation)
+{
+    memcpy(Record.EKey, EKey, MD5_HASH_SIZE);
+    Record.FileSize = FileSize;
+    Record.Operation = Operation;
+    Record.Checksum = GetRecordChecksum(Record);
+}
+
+static bool RenameFile(LPCTSTR szOldName, LPCTSTR szNewName)
+{
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    if(!MoveFileEx(szOldName, szNewName, MOVEFILE_REPLACE_EXISTING))
+    {
+        SetCascError(GetLastError());
+        return false;
+    }
+#else
+    if(rename(szOldName, szNewName) == -1)
+    {
+        SetCascError(errno);
+        return false;
+    }
+#endif
+    return true;
+}
+
+static DWORD GetProcessIdentifier()
+{
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    return GetCurrentProcessId();
+#else
+    return (DWORD)getpid();
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// CASC_CDN_CACHE functions
+
+CASC_CDN_CACHE::CASC_CDN_CACHE()
+{
+    CascInitLock(Lock);
+    szCacheDir = NULL;
+    hLockFile = INVALID_HANDLE_VALUE;
+    pLogStream = NULL;
+    HashTable = NULL;
+    pLruFirst = pLruLast = NULL;
+    HashTableSize = EntryCount = LogRecords = 0;
+    LogSize = MaxSize = BytesUsed = 0;
+    Hits = Misses = Evictions = BytesHit = BytesStored = 0;
+    TempCounter = 0;
+}
+
+CASC_CDN_CACHE::~CASC_CDN_CACHE()
+{
+    Free();
+    CascFreeLock(Lock);
+}
+
+DWORD CASC_CDN_CACHE::Create(LPCTSTR szNewCacheDir, ULONGLONG NewMaxSize)
+{
+    TCHAR szFileName[MAX_PATH];
+    size_t nBuckets = CASC_CDN_CACHE_MIN_BUCKETS;
+    DWORD dwErrCode;
+
+    // Don't create the cache twice
+    assert(szCacheDir == NULL);
+
+    // Round the number of buckets up to a power of two
+    while(nBuckets < CASC_CDN_CACHE_MAX_BUCKETS && nBuckets < (NewMaxSize / CASC_CDN_CACHE_BUCKET_BYTES))
+        nBuckets <<= 1;
+
+    // Allocate the hash table and make sure that the directory exists
+    if((HashTable = CASC_ALLOC_ZERO<CASC_CDN_CACHE_ENTRY *>(nBuckets)) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    if((szCacheDir = CascNewStr(szNewCacheDir)) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    if((dwErrCode = ForcePathExist(szCacheDir, false)) != ERROR_SUCCESS)
+    {
+        Free();
+        return dwErrCode;
+    }
+
+    // Another cache object (in this process or another one) owns the directory.
+    // Two owners would overwrite each other's index and log, so this one stays disabled
+    CombinePath(szFileName, _countof(szFileName), szCacheDir, _T("cache.lock"), NULL);
+    if((hLockFile = LockDirectoryFile(szFileName)) == INVALID_HANDLE_VALUE)
+    {
+        Free();
+        return ERROR_SUCCESS;
+    }
+
+    // Temporary files left by a crashed owner would never be deleted
+    DeleteDirectoryFiles(szCacheDir, _T(".tmp"));
+
+    HashTableSize = nBuckets;
+    MaxSize = NewMaxSize;
+
+    // Load the index, then the changes made after it was written.
+    // If there is no index, the cache is empty
+    CombinePath(szFileName, _countof(szFileName), szCacheDir, _T("cache.idx"), NULL);
+    LoadRecords(szFileName, false);
+    CombinePath(szFileName, _countof(szFileName), szCacheDir, _T("cache.log"), NULL);
+    LoadRecords(szFileName, true);
+
+    // The budget may be lower than it was the last time
+    CascLock(Lock);
+    EvictEntries();
+    dwErrCode = SaveIndex();
+    CascUnlock(Lock);
+
+    // Without the log, the cache can't be used
+    if(dwErrCode != ERROR_SUCCESS)
+        Free();
+    return dwErrCode;
+}
+
+CASC_CDN_CACHE_ENTRY ** CASC_CDN_CACHE::GetBucket(LPBYTE EKey)
+{
+    // The EKeys are MD5 hashes, so any part of them is a good hash
+    return &HashTable[ConvertBytesToInteger_4_LE(EKey) & (HashTableSize - 1)];
+}
+
+CASC_CDN_CACHE_ENTRY * CASC_CDN_CACHE::FindEntry(LPBYTE EKey)
+{
+    CASC_CDN_CACHE_ENTRY * pEntry;
+
+    for(pEntry = GetBucket(EKey)[0]; pEntry != NULL; pEntry = pEntry->pNextHash)
+    {
+        if(!memcmp(pEntry->EKey, EKey, MD5_HASH_SIZE))
+            return pEntry;
+    }
+    return NULL;
+}
+
+CASC_CDN_CACHE_ENTRY * CASC_CDN_CACHE::InsertEntry(LPBYTE EKey, DWORD FileSize)
+{
+    CASC_CDN_CACHE_ENTRY ** ppBucket = GetBucket(EKey);
+    CASC_CDN_CACHE_ENTRY * pEntry;
+
+    if((pEntry = CASC_ALLOC<CASC_CDN_CACHE_ENTRY>(1)) != NULL)
+    {
+        memcpy(pEntry->EKey, EKey, MD5_HASH_SIZE);
+        pEntry->FileSize = FileSize;
+        pEntry->pNextHash = ppBucket[0];
+        ppBucket[0] = pEntry;
+        LinkLru(pEntry);
+
+        BytesUsed += FileSize;
+        EntryCount++;
+    }
+    return pEntry;
+}
+
+void CASC_CDN_CACHE::RemoveEntry(CASC_CDN_CACHE_ENTRY * pEntry)
+{
+    CASC_CDN_CACHE_ENTRY ** ppEntry = GetBucket(pEntry->EKey);
+
+    // Remove the entry from the hash bucket
+    while(ppEntry[0] != pEntry)
+        ppEntry = &ppEntry[0]->pNextHash;
+    ppEntry[0] = pEntry->pNextHash;
+
+    // Remove the entry from the LRU list
+    UnlinkLru(pEntry);
+    BytesUsed -= pEntry->FileSize;
+    EntryCount--;
+    CASC_FREE(pEntry);
+}
+
+void CASC_CDN_CACHE::LinkLru(CASC_CDN_CACHE_ENTRY * pEntry)
+{
+    pEntry->pPrevLru = NULL;
+    pEntry->pNextLru = pLruFirst;
+    if(pLruFirst != NULL)
+        pLruFirst->pPrevLru = pEntry;
+    pLruFirst = pEntry;
+
+    if(pLruLast == NULL)
+        pLruLast = pEntry;
+}
+
+void CASC_CDN_CACHE::UnlinkLru(CASC_CDN_CACHE_ENTRY * pEntry)
+{
+    if(pEntry->pPrevLru != NULL)
+        pEntry->pPrevLru->pNextLru = pEntry->pNextLru;
+    else
+        pLruFirst = pEntry->pNextLru;
+
+    if(pEntry->pNextLru != NULL)
+        pEntry->pNextLru->pPrevLru = pEntry->pPrevLru;
+    else
+        pLruLast = pEntry->pPrevLru;
+}
+
+void CASC_CDN_CACHE::GetEntryPath(LPBYTE EKey, LPTSTR szFilePath, size_t ccFilePath)
+{
+    CASC_PATH<TCHAR> Path(PATH_SEP_CHAR);
+
+    Path.SetPathRoot(szCacheDir);
+    Path.AppendEKey(EKey);
+    Path.Copy(szFilePath, ccFilePath);
+}
+
+// Deletes the least recently used files until the cache fits into its budget.
+// The most recently used file always stays, even if it's bigger than the budget
+void CASC_CDN_CACHE::EvictEntries()
+{
+    TCHAR szFilePath[MAX_PATH];
+
+    while(BytesUsed > MaxSize && pLruLast != NULL && pLruLast != pLruFirst)
+    {
+        CASC_CDN_CACHE_ENTRY * pEntry = pLruLast;
+
+        // Delete the file first, then log it. On Windows, the file can't be deleted
+        // while it's open; it will be overwritten when it's downloaded again
+        GetEntryPath(pEntry->EKey, szFilePath, _countof(szFilePath));
+        _tremove(szFilePath);
+        AppendLog(pEntry->EKey, pEntry->FileSize, CASC_CDN_OP_DELETE);
+        RemoveEntry(pEntry);
+        Evictions++;
+    }
+}
+
+DWORD CASC_CDN_CACHE::LoadRecords(LPCTSTR szFileName, bool bIsLog)
+{
+    CASC_CDN_CACHE_HEADER * pHeader;
+    CASC_CDN_CACHE_RECORD * pRecord;
+    CASC_CDN_CACHE_RECORD * pRecordEnd;
+    CASC_CDN_CACHE_ENTRY * pEntry;
+    TFileStream * pStream;
+    ULONGLONG FileSize = 0;
+    LPBYTE pbFileData = NULL;
+    DWORD cbFileData;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // A missing file is not an error; the cache is just empty.
+    // The log is empty right after the index has been written
+    if((pStream = FileStream_OpenFile(szFileName, STREAM_FLAG_READ_ONLY)) == NULL)
+        return ERROR_FILE_NOT_FOUND;
+    FileStream_GetSize(pStream, &FileSize);
+    if(FileSize == 0 || FileSize > CASC_CDN_CACHE_MAX_FILE)
+    {
+        FileStream_Close(pStream);
+        return (FileSize != 0) ? ERROR_BAD_FORMAT : ERROR_SUCCESS;
+    }
+
+    // Load the entire file
+    cbFileData = (DWORD)FileSize;
+    if((pbFileData = CASC_ALLOC<BYTE>(cbFileData)) != NULL)
+    {
+        if(!FileStream_Read(pStream, NULL, pbFileData, cbFileData))
+            CASC_FREE(pbFileData);
+    }
+    FileStream_Close(pStream);
+
+    if(pbFileData == NULL)
+        return ERROR_FILE_CORRUPT;
+    pRecord = (CASC_CDN_CACHE_RECORD *)pbFileData;
+    pRecordEnd = pRecord + (cbFileData / sizeof(CASC_CDN_CACHE_RECORD));
+
+    // The index has a header that must match the file size
+    if(bIsLog == false)
+    {
+        pHeader = (CASC_CDN_CACHE_HEADER *)pbFileData;
+        if(cbFileData < sizeof(CASC_CDN_CACHE_HEADER) ||
+           pHeader->Signature != CASC_CDN_CACHE_SIGNATURE ||
+           pHeader->Version != CASC_CDN_CACHE_VERSION ||
+           cbFileData != (sizeof(CASC_CDN_CACHE_HEADER) + (size_t)pHeader->RecordCount * sizeof(CASC_CDN_CACHE_RECORD)))
+        {
+            CASC_FREE(pbFileData);
+            return ERROR_BAD_FORMAT;
+        }
+
+        pRecord = (CASC_CDN_CACHE_RECORD *)(pHeader + 1);
+        pRecordEnd = pRecord + pHeader->RecordCount;
+    }
+
+    // Replay the records. A broken record ends the file; it could have been cut by a crash
+    for(; pRecord < pRecordEnd; pRecord++)
+    {
+        if(pRecord->Checksum != GetRecordChecksum(pRecord[0]))
+        {
+            dwErrCode = ERROR_FILE_CORRUPT;
+            break;
+        }
+
+        pEntry = FindEntry(pRecord->EKey);
+        switch(pRecord->Operation)
+        {
+            case CASC_CDN_OP_STORE:
+                if(pEntry != NULL)
+                    RemoveEntry(pEntry);
+                InsertEntry(pRecord->EKey, pRecord->FileSize);
+                break;
+
+            case CASC_CDN_OP_DELETE:
+                if(pEntry != NULL)
+                    RemoveEntry(pEntry);
+                break;
+        }
+    }
+
+    CASC_FREE(pbFileData);
+    return dwErrCode;
+}
+
+// Writes the index as a whole and empties the log. The new index replaces
+// the old one by rename, so there is always one complete index on the disk
+DWORD CASC_CDN_CACHE::SaveIndex()
+{
+    CASC_CDN_CACHE_HEADER * pHeader;
+    CASC_CDN_CACHE_RECORD * pRecord;
+    CASC_CDN_CACHE_ENTRY * pEntry;
+    TFileStream * pStream;
+    TCHAR szIndexName[MAX_PATH];
+    TCHAR szTempName[MAX_PATH];
+    LPBYTE pbIndex;
+    size_t cbIndex = sizeof(CASC_CDN_CACHE_HEADER) + EntryCount * sizeof(CASC_CDN_CACHE_RECORD);
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // Build the index in memory
+    if((pbIndex = CASC_ALLOC<BYTE>(cbIndex)) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    pHeader = (CASC_CDN_CACHE_HEADER *)pbIndex;
+    pHeader->Signature = CASC_CDN_CACHE_SIGNATURE;
+    pHeader->Version = CASC_CDN_CACHE_VERSION;
+    pHeader->RecordCount = (DWORD)EntryCount;
+    pHeader->Reserved = 0;
+
+    // The least recently used file goes first
+    pRecord = (CASC_CDN_CACHE_RECORD *)(pHeader + 1);
+    for(pEntry = pLruLast; pEntry != NULL; pEntry = pEntry->pPrevLru)
+        InitRecord(*pRecord++, pEntry->EKey, pEntry->FileSize, CASC_CDN_OP_STORE);
+
+    // Write it to a temporary file and replace the index
+    CombinePath(szIndexName, _countof(szIndexName), szCacheDir, _T("cache.idx"), NULL);
+    CombinePath(szTempName, _countof(szTempName), szCacheDir, _T("cache.idx.tmp"), NULL);
+    if((pStream = FileStream_CreateFile(szTempName, BASE_PROVIDER_FILE | STREAM_PROVIDER_FLAT)) != NULL)
+    {
+        if(!FileStream_Write(pStream, NULL, pbIndex, (DWORD)cbIndex))
+            dwErrCode = GetCascError();
+        FileStream_Close(pStream);
+
+        if(dwErrCode == ERROR_SUCCESS && !RenameFile(szTempName, szIndexName))
+            dwErrCode = GetCascError();
+    }
+    else
+    {
+        dwErrCode = GetCascError();
+    }
+    CASC_FREE(pbIndex);
+
+    // Everything in the log is in the index now
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        if(pLogStream == NULL)
+        {
+            CombinePath(szTempName, _countof(szTempName), szCacheDir, _T("cache.log"), NULL);
+            if((pLogStream = FileStream_OpenFile(szTempName, BASE_PROVIDER_FILE | STREAM_PROVIDER_FLAT)) == NULL)
+                pLogStream = FileStream_CreateFile(szTempName, BASE_PROVIDER_FILE | STREAM_PROVIDER_FLAT);
+            if(pLogStream == NULL)
+                return GetCascError();
+        }
+
+        if(!FileStream_SetSize(pLogStream, 0))
+            return GetCascError();
+        LogRecords = 0;
+        LogSize = 0;
+    }
+
+    return dwErrCode;
+}
+
+void CASC_CDN_CACHE::AppendLog(LPBYTE EKey, DWORD FileSize, DWORD Operation)
+{
+    CASC_CDN_CACHE_RECORD Record;
+
+    // A record that fails to be written is a file that the index doesn't know about.
+    // That only wastes disk space, so we don't care
+    if(pLogStream != NULL)
+    {
+        InitRecord(Record, EKey, FileSize, Operation);
+        if(FileStream_Write(pLogStream, &LogSize, &Record, sizeof(CASC_CDN_CACHE_RECORD)))
+        {
+            LogSize += sizeof(CASC_CDN_CACHE_RECORD);
+            LogRecords++;
+        }
+    }
+}
+
+// Called when the index and the files are consistent again
+void CASC_CDN_CACHE::CompactLog()
+{
+    // Don't let the log grow forever
+    if(LogRecords >= CASC_CDN_CACHE_MIN_LOG && LogRecords > EntryCount)
+    {
+        SaveIndex();
+    }
+}
+
+bool CASC_CDN_CACHE::Lookup(LPBYTE EKey, LPTSTR szFilePath, size_t ccFilePath)
+{
+    CASC_CDN_CACHE_ENTRY * pEntry;
+
+    if(szCacheDir == NULL)
+        return false;
+
+    CascLock(Lock);
+    if((pEntry = FindEntry(EKey)) != NULL)
+    {
+        // Make it the most recently used file
+        UnlinkLru(pEntry);
+        LinkLru(pEntry);
+        GetEntryPath(EKey, szFilePath, ccFilePath);
+        BytesHit += pEntry->FileSize;
+        Hits++;
+    }
+    else
+    {
+        Misses++;
+    }
+    CascUnlock(Lock);
+
+    return (pEntry != NULL);
+}
+
+void CASC_CDN_CACHE::GetTempPath(LPBYTE EKey, LPTSTR szTempPath, size_t ccTempPath)
+{
+    TCHAR szFilePath[MAX_PATH];
+    DWORD dwCounter;
+
+    CascLock(Lock);
+    dwCounter = ++TempCounter;
+    CascUnlock(Lock);
+
+    // Several threads or processes may download the same file at once
+    GetEntryPath(EKey, szFilePath, _countof(szFilePath));
+    CascStrPrintf(szTempPath, ccTempPath, _T("%s.%u.%u.tmp"), szFilePath, GetProcessIdentifier(), dwCounter);
+}
+
+DWORD CASC_CDN_CACHE::Insert(LPBYTE EKey, LPCTSTR szTempPath, DWORD FileSize, LPTSTR szFilePath, size_t ccFilePath)
+{
+    CASC_CDN_CACHE_ENTRY * pEntry;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    CascLock(Lock);
+    GetEntryPath(EKey, szFilePath, ccFilePath);
+
+    // If another thread has inserted the file meanwhile, we use its file
+    if((pEntry = FindEntry(EKey)) == NULL)
+    {
+        // Log the file before it gets its final name. If we crash between,
+        // the index will contain a file that doesn't exist, which is harmless
+        AppendLog(EKey, FileSize, CASC_CDN_OP_STORE);
+        if(RenameFile(szTempPath, szFilePath))
+        {
+            if((pEntry = InsertEntry(EKey, FileSize)) != NULL)
+            {
+                BytesStored += FileSize;
+                EvictEntries();
+            }
+            else
+            {
+                _tremove(szFilePath);
+                AppendLog(EKey, FileSize, CASC_CDN_OP_DELETE);
+                dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+            }
+        }
+        else
+        {
+            dwErrCode = GetCascError();
+            AppendLog(EKey, FileSize, CASC_CDN_OP_DELETE);
+            _tremove(szTempPath);
+        }
+    }
+    else
+    {
+        _tremove(szTempPath);
+    }
+
+    CompactLog();
+    CascUnlock(Lock);
+    return dwErrCode;
+}
+
+void CASC_CDN_CACHE::Remove(LPBYTE EKey)
+{
+    CASC_CDN_CACHE_ENTRY * pEntry;
+    TCHAR szFilePath[MAX_PATH];
+
+    if(szCacheDir != NULL)
+    {
+        CascLock(Lock);
+        if((pEntry = FindEntry(EKey)) != NULL)
+        {
+            GetEntryPath(EKey, szFilePath, _countof(szFilePath));
+            _tremove(szFilePath);
+            AppendLog(EKey, pEntry->FileSize, CASC_CDN_OP_DELETE);
+            RemoveEntry(pEntry);
+            CompactLog();
+        }
+        CascUnlock(Lock);
+    }
+}
+
+void CASC_CDN_CACHE::Collect(PCASC_CDN_CACHE_INFO pInfo)
+{
+    CascLock(Lock);
+    pInfo->Hits = Hits;
+    pInfo->Misses = Misses;
+    pInfo->Evictions = Evictions;
+    pInfo->BytesHit = BytesHit;
+    pInfo->BytesStored = BytesStored;
+    pInfo->EntryCount = EntryCount;
+    pInfo->BytesUsed = BytesUsed;
+    pInfo->BytesMax = (szCacheDir != NULL) ? MaxSize : 0;
+    CascUnlock(Lock);
+}
+
+void CASC_CDN_CACHE::Free()
+{
+    CASC_CDN_CACHE_ENTRY * pEntry;
+
+    // Write the index, so the next open doesn't need to replay the log
+    if(szCacheDir != NULL && pLogStream != NULL)
+        SaveIndex();
+
+    FileStream_Close(pLogStream);
+    pLogStream = NULL;
+
+    while((pEntry = pLruFirst) != NULL)
+        RemoveEntry(pEntry);
+
+    CASC_FREE(HashTable);
+    CASC_FREE(szCacheDir);
+    HashTableSize = 0;
+
+    // Release the directory to other cache objects
+    UnlockDirectoryFile(hLockFile);
+    hLockFile = INVALID_HANDLE_VALUE;
+}
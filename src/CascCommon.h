@@ -24,7 +24,9 @@
 #include "CascPort.h"
 #include "common/Common.h"
 #include "common/Array.h"
+#include "common/Arena.h"
 #include "common/Map.h"
+#include "common/Bitset.h"
 #include "common/FileTree.h"
 #include "common/FileStream.h"
 #include "common/Directory.h"
@@ -34,6 +36,10 @@
 #include "common/Path.h"
 #include "common/RootHandler.h"
 #include "common/Sockets.h"
+#include "common/Threads.h"
+#include "common/IoRing.h"
+#include "common/SharedMemory.h"
+#include "common/PerfCounters.h"
 
 // Headers from Alexander Peslyak's MD5 implementation
 #include "md5/md5.h"
@@ -58,9 +64,11 @@
 #define CASC_MAGIC_STORAGE  0x524F545343534143      // 'CASCSTOR'
 #define CASC_MAGIC_FILE     0x454C494643534143      // 'CASCFILE'
 #define CASC_MAGIC_FIND     0x444E494643534143      // 'CASCFIND'
+#define CASC_MAGIC_QUEUE    0x5545555143534143      // 'CASCQUEU'
 
 // For CASC_CDN_DOWNLOAD::Flags
 #define CASC_CDN_FORCE_DOWNLOAD         0x0001      // Force downloading the file even if in the cache
+#define CASC_CDN_USE_CACHE              0x0002      // Data file: download it to the CDN cache, if the storage has one
 
 //-----------------------------------------------------------------------------
 // In-memory structures
@@ -93,10 +101,30 @@ typedef struct _CASC_INDEX
     LPTSTR szFileName;                              // Full name of the index file
     LPBYTE pbFileData;                              // Loaded content of the index file
     size_t cbFileData;                               // Size of the index file
+    ULONGLONG FileSize;                             // Size of the index file on disk. Kept after the storage is open
+    ULONGLONG FileTime;                             // Last write time of the index file. Kept after the storage is open
     DWORD NewSubIndex;                              // New subindex
     DWORD OldSubIndex;                              // Old subindex
+    bool bReused;                                   // The index file is the same as in the base storage and has not been loaded
 } CASC_INDEX, *PCASC_INDEX;
 
+// Information about one archive index of an online storage
+typedef struct _CASC_ARCHIVE_INDEX
+{
+    BYTE ArchiveKey[MD5_HASH_SIZE];                 // Key of the archive
+    size_t FirstEntry;                              // Index of the first entry in TCascStorage::IndexArray
+    size_t EntryCount;                              // Number of entries loaded from the archive index
+    DWORD OffsetBits;                               // Number of bits of the archive offset in CASC_EKEY_ENTRY::StorageOffset
+} CASC_ARCHIVE_INDEX, *PCASC_ARCHIVE_INDEX;
+
+// Information about one CKey page of the ENCODING manifest
+typedef struct _CASC_ENCODING_PAGE
+{
+    BYTE SegmentHash[MD5_HASH_SIZE];                // MD5 hash of the page, from the ENCODING page table
+    size_t FirstEntry;                              // Index of the first entry in TCascStorage::CKeyArray
+    size_t EntryCount;                              // Number of entries loaded from the page
+} CASC_ENCODING_PAGE, *PCASC_ENCODING_PAGE;
+
 // Normalized header of the index files.
 // Both version 1 and version 2 are converted to this structure
 typedef struct _CASC_INDEX_HEADER
@@ -187,6 +215,7 @@ typedef struct _CASC_TAG_ENTRY1
 // Tag structure for storing in arrays
 typedef struct _CASC_TAG_ENTRY2
 {
+    CASC_BITSET * pFileBits;                        // Indexes (into CKeyArray) of the files that have this tag
     size_t NameLength;                              // Length of the on-disk tag, in bytes
     DWORD TagValue;                                 // Tag value
     char szTagName[0x08];                           // Tag string. This member can be longer than declared. Aligned to 8 bytes.
@@ -226,6 +255,19 @@ typedef struct _CASC_FILE_SPAN
 
 } CASC_FILE_SPAN, *PCASC_FILE_SPAN;
 
+// Decoded frame, kept by the file handle for the positional reads (ReadFileRange).
+// Several slots let multiple threads read different parts of one file sequentially
+#define CASC_FRAME_SLOTS    4
+
+typedef struct _CASC_FRAME_SLOT
+{
+    ULONGLONG StartOffset;                          // Starting offset of the frame in the file
+    ULONGLONG EndOffset;                            // Ending offset of the frame in the file
+    LPBYTE pbData;                                  // The decoded frame. NULL if the slot is free
+    DWORD dwLastUse;                                // Value of TCascFile::dwSlotUse at the last hit
+
+} CASC_FRAME_SLOT, *PCASC_FRAME_SLOT;
+
 // Structure for downloading a file from the CDN (https://wowdev.wiki/TACT#File_types)
 // Remote path is combined as the following:
 //  [szCdnsHost]       /[szCdnsPath]/[szPathType]/EKey[0-1]/EKey[2-3]/[EKey].[Extension]
@@ -251,6 +293,217 @@ typedef struct _CASC_CDN_DOWNLOAD
 
 } CASC_CDN_DOWNLOAD, *PCASC_CDN_DOWNLOAD;
 
+//-----------------------------------------------------------------------------
+// Cache of the BLTE frame tables
+
+// A cached frame table. The frame array follows the entry.
+// Offsets of the frames are relative to the start of the span and to ArchiveOffs
+struct CASC_FRAME_CACHE_ENTRY
+{
+    CASC_FRAME_CACHE_ENTRY * pNextHash;             // Next entry in the same hash bucket
+    CASC_FRAME_CACHE_ENTRY * pPrevLru;              // More recently used entry
+    CASC_FRAME_CACHE_ENTRY * pNextLru;              // Less recently used entry
+    BYTE EKey[MD5_HASH_SIZE];                       // EKey of the file span
+    size_t cbEntry;                                 // Size of the entry, including the frames
+    DWORD ContentSize;                              // Content size of the span
+    DWORD HeaderSize;                               // Size of the encoded frame headers
+    DWORD FrameCount;                               // Number of frames that follow
+};
+
+// Storage-wide cache of parsed frame tables, shared by all open files.
+// Reopening a file takes its frame table from here instead of reading
+// and parsing the BLTE header again. The cache has a fixed memory budget;
+// the least recently used frame tables are removed when it is exceeded.
+class CASC_FRAME_CACHE
+{
+    public:
+
+    CASC_FRAME_CACHE();
+    ~CASC_FRAME_CACHE();
+
+    DWORD Create(size_t cbNewMaxSize);
+
+    // Fills the frames of the span. Returns false if the span is not in the cache
+    bool Load(PCASC_FILE_SPAN pFileSpan, PCASC_CKEY_ENTRY pCKeyEntry);
+
+    // Inserts the frames of a loaded span to the cache
+    void Store(PCASC_FILE_SPAN pFileSpan, PCASC_CKEY_ENTRY pCKeyEntry);
+
+    // Retrieves the cache statistics
+    void Collect(PCASC_FRAME_CACHE_INFO pInfo);
+
+    void Free();
+
+    protected:
+
+    CASC_FRAME_CACHE_ENTRY ** GetBucket(LPBYTE EKey);
+    void LinkLru(CASC_FRAME_CACHE_ENTRY * pEntry);
+    void UnlinkLru(CASC_FRAME_CACHE_ENTRY * pEntry);
+    void RemoveEntry(CASC_FRAME_CACHE_ENTRY * pEntry);
+
+    CASC_LOCK Lock;                                 // The cache is shared by all threads using the storage
+    CASC_FRAME_CACHE_ENTRY ** HashTable;            // Hash table of the entries, by EKey
+    CASC_FRAME_CACHE_ENTRY * pLruFirst;             // The most recently used entry
+    CASC_FRAME_CACHE_ENTRY * pLruLast;              // The least recently used entry
+    size_t HashTableSize;                           // Number of buckets. Always a power of two
+    size_t cbMaxSize;                               // Memory budget of the cache
+    size_t cbUsed;                                  // Memory used by the entries
+    size_t EntryCount;                              // Number of entries
+    ULONGLONG Hits;                                 // Number of successful lookups
+    ULONGLONG Misses;                               // Number of failed lookups
+    ULONGLONG Evictions;                            // Number of entries removed due to the memory budget
+};
+
+//-----------------------------------------------------------------------------
+// CDN cache of online storages
+
+// A file in the CDN cache. The file is "<cache dir>/##/##/<EKey>"
+struct CASC_CDN_CACHE_ENTRY
+{
+    CASC_CDN_CACHE_ENTRY * pNextHash;               // Next entry in the same hash bucket
+    CASC_CDN_CACHE_ENTRY * pPrevLru;                // More recently used entry
+    CASC_CDN_CACHE_ENTRY * pNextLru;                // Less recently used entry
+    BYTE EKey[MD5_HASH_SIZE];                       // EKey of the file
+    DWORD FileSize;                                 // Size of the file
+};
+
+// Disk cache of the data files downloaded from CDN, addressed by their EKeys.
+// The list of the files is kept in "cache.idx", written as a whole when the cache
+// is closed, and "cache.log", where every stored and deleted file is appended.
+// A file is logged before it's renamed to its final name and deleted before
+// its deletion is logged, so after a crash, the index can only name files
+// that don't exist; such entries are removed when found missing.
+// Only one cache object may own the directory; it holds "cache.lock" locked,
+// and any other storage opened over the same directory runs without the cache.
+class CASC_CDN_CACHE
+{
+    public:
+
+    CASC_CDN_CACHE();
+    ~CASC_CDN_CACHE();
+
+    DWORD Create(LPCTSTR szCacheDir, ULONGLONG NewMaxSize);
+
+    bool IsEnabled()
+    {
+        return (szCacheDir != NULL);
+    }
+
+    // Gives the path of the cached file. Returns false if the file is not in the cache
+    bool Lookup(LPBYTE EKey, LPTSTR szFilePath, size_t ccFilePath);
+
+    // Gives a unique path for downloading a file that will be inserted to the cache
+    void GetTempPath(LPBYTE EKey, LPTSTR szTempPath, size_t ccTempPath);
+
+    // Moves a downloaded file to the cache and gives its final path
+    DWORD Insert(LPBYTE EKey, LPCTSTR szTempPath, DWORD FileSize, LPTSTR szFilePath, size_t ccFilePath);
+
+    // Removes a file that turned out to be missing or damaged
+    void Remove(LPBYTE EKey);
+
+    // Retrieves the cache statistics
+    void Collect(PCASC_CDN_CACHE_INFO pInfo);
+
+    // Saves the index and frees the cache
+    void Free();
+
+    protected:
+
+    CASC_CDN_CACHE_ENTRY ** GetBucket(LPBYTE EKey);
+    CASC_CDN_CACHE_ENTRY * FindEntry(LPBYTE EKey);
+    CASC_CDN_CACHE_ENTRY * InsertEntry(LPBYTE EKey, DWORD FileSize);
+    void RemoveEntry(CASC_CDN_CACHE_ENTRY * pEntry);
+    void LinkLru(CASC_CDN_CACHE_ENTRY * pEntry);
+    void UnlinkLru(CASC_CDN_CACHE_ENTRY * pEntry);
+    void GetEntryPath(LPBYTE EKey, LPTSTR szFilePath, size_t ccFilePath);
+    void EvictEntries();
+
+    DWORD LoadRecords(LPCTSTR szFileName, bool bIsLog);
+    DWORD SaveIndex();
+    void AppendLog(LPBYTE EKey, DWORD FileSize, DWORD Operation);
+    void CompactLog();
+
+    CASC_LOCK Lock;                                 // The cache is shared by all threads using the storage
+    LPTSTR szCacheDir;                              // Directory of the cache. NULL if the cache is disabled
+    HANDLE hLockFile;                               // Locked "cache.lock", owning the directory
+    TFileStream * pLogStream;                       // Open "cache.log"
+    CASC_CDN_CACHE_ENTRY ** HashTable;              // Hash table of the entries, by EKey
+    CASC_CDN_CACHE_ENTRY * pLruFirst;               // The most recently used entry
+    CASC_CDN_CACHE_ENTRY * pLruLast;                // The least recently used entry
+    size_t HashTableSize;                           // Number of buckets. Always a power of two
+    size_t EntryCount;                              // Number of entries
+    size_t LogRecords;                              // Number of records in the log since the index was saved
+    ULONGLONG LogSize;                              // Size of the log file
+    ULONGLONG MaxSize;                              // Disk budget of the cache
+    ULONGLONG BytesUsed;                            // Total size of the cached files
+    ULONGLONG Hits;                                 // Number of files found in the cache
+    ULONGLONG Misses;                               // Number of files not found in the cache
+    ULONGLONG Evictions;                            // Number of files deleted due to the disk budget
+    ULONGLONG BytesHit;                             // Total size of the files found in the cache
+    ULONGLONG BytesStored;                          // Total size of the files inserted to the cache
+    DWORD TempCounter;                              // Makes the names of the temporary files unique
+};
+
+// Reference counts of the CKey entries that must not be written to, because they are
+// mapped from a shared memory segment. The other entries keep their own RefCount.
+struct CASC_CKEY_REFS
+{
+    CASC_CKEY_REFS()
+    {
+        pFirstEntry = NULL;
+        nEntries = 0;
+        RefCounts = NULL;
+    }
+
+    ~CASC_CKEY_REFS()
+    {
+        Free();
+    }
+
+    DWORD Create(PCASC_CKEY_ENTRY pCKeyEntries, size_t nCKeyEntries)
+    {
+        if((RefCounts = CASC_ALLOC_ZERO<USHORT>(CASCLIB_MAX(nCKeyEntries, 1))) == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+        pFirstEntry = pCKeyEntries;
+        nEntries = nCKeyEntries;
+        return ERROR_SUCCESS;
+    }
+
+    void Free()
+    {
+        CASC_FREE(RefCounts);
+        pFirstEntry = NULL;
+        nEntries = 0;
+    }
+
+    // Returns the reference count of the entry, wherever it is kept
+    USHORT & RefCount(PCASC_CKEY_ENTRY pCKeyEntry)
+    {
+        size_t nIndex = ((size_t)pCKeyEntry - (size_t)pFirstEntry) / sizeof(CASC_CKEY_ENTRY);
+
+        if((size_t)pCKeyEntry >= (size_t)pFirstEntry && nIndex < nEntries)
+            return RefCounts[nIndex];
+        return pCKeyEntry->RefCount;
+    }
+
+    void AddRef(PCASC_CKEY_ENTRY pCKeyEntry)
+    {
+        USHORT & nRefCount = RefCount(pCKeyEntry);
+
+        assert(nRefCount != 0xFFFF);
+        nRefCount++;
+    }
+
+    bool IsFile(PCASC_CKEY_ENTRY pCKeyEntry)
+    {
+        return pCKeyEntry->IsFile(RefCount(pCKeyEntry));
+    }
+
+    PCASC_CKEY_ENTRY pFirstEntry;                   // The first entry whose reference count is in RefCounts
+    size_t nEntries;                                // Number of entries covered by RefCounts
+    USHORT * RefCounts;                             // Reference count of each covered entry
+};
+
 //-----------------------------------------------------------------------------
 // Structures for CASC storage and CASC file
 
@@ -276,7 +529,12 @@ struct TCascStorage
 
     // Class members
     PCASC_OPEN_STORAGE_ARGS pArgs;                  // Open storage arguments. Only valid during opening the storage
+    TCascStorage * pBaseStorage;                    // Storage of the previous build (CASC_OPEN_STORAGE_ARGS::hBaseStorage). Only valid during opening the storage
     CASC_LOCK StorageLock;                          // Lock for multi-threaded operations
+    CASC_ARENA Arena;                               // Arena for small structures that live as long as the storage
+    CASC_FRAME_CACHE FrameCache;                    // Cache of the BLTE frame tables of the opened files
+    CASC_CDN_CACHE CdnCache;                        // Disk cache of the data files downloaded from CDN (online storages)
+    CASC_SHARED_MEMORY SharedIndex;                 // Shared memory segment with the storage index (CASC_OPEN_STORAGE_ARGS::szSharedIndex)
 
     LPCTSTR szIndexFormat;                          // Format of the index file name
     LPTSTR  szCdnHostUrl;                           // CDN host URL for online storage
@@ -320,11 +578,15 @@ struct TCascStorage
 
     TRootHandler * pRootHandler;                    // Common handler for various ROOT file formats
     CASC_ARRAY IndexArray;                          // Array of CASC_EKEY_ENTRY, loaded from online indexes
+    CASC_ARRAY ArchiveIndexes;                      // Array of CASC_ARCHIVE_INDEX, ranges of IndexArray for each archive
     CASC_ARRAY CKeyArray;                           // Array of CASC_CKEY_ENTRY, loaded from ENCODING file
+    CASC_ARRAY EncodingPages;                       // Array of CASC_ENCODING_PAGE, ranges of CKeyArray for each ENCODING page
     CASC_ARRAY TagsArray;                           // Array of CASC_DOWNLOAD_TAG2
+    CASC_BITSET TaggedFiles;                        // Indexes (into CKeyArray) of all files listed in DOWNLOAD/INSTALL manifests
     CASC_MAP IndexMap;                              // Map of EKey -> IndexArray (for online archives)
     CASC_MAP CKeyMap;                               // Map of CKey -> CKeyArray
     CASC_MAP EKeyMap;                               // Map of EKey -> CKeyArray
+    CASC_CKEY_REFS CKeyRefs;                        // Reference counts of the file entries. Kept out of the entries of a shared index
     size_t LocalFiles;                              // Number of files that are present locally
     size_t TotalFiles;                              // Total number of files in the storage, some may not be present locally
     size_t EKeyEntries;                             // Number of CKeyEntry-ies loaded from text build file
@@ -333,6 +595,8 @@ struct TCascStorage
 
     CASC_KEY_MAP KeyMap;                            // Growable map of encryption keys
     ULONGLONG  LastFailKeyName;                     // The value of the encryption key that recently was NOT found.
+
+    CASC_PERF_COUNTERS PerfCounters;                // Performance counters. Only collected if CASC_OPEN_PERF_COUNTERS was given
 };
 
 struct TCascFile
@@ -365,6 +629,7 @@ struct TCascFile
     ULONGLONG ContentSize;                          // Content size. This is the summed content size of all file spans
     ULONGLONG EncodedSize;                          // Encoded size. This is the summed encoded size of all file spans
     ULONGLONG FilePointer;                          // Current file pointer
+    ULONGLONG FileNameHash;                         // Hash of the name the file was opened by. 0 if not opened by name
     DWORD SpanCount;                                // Number of file spans. There is one CKey entry for each file span
     DWORD bVerifyIntegrity:1;                       // If true, then the data are validated more strictly when read
     DWORD bDownloadFileIf:1;                        // If true, then the data will be downloaded from the online storage if missing
@@ -376,6 +641,13 @@ struct TCascFile
     ULONGLONG FileCacheEnd;                         // Ending offset of the file cached area
     LPBYTE pbFileCache;                             // Pointer to file cached area
     CSTRTG CacheStrategy;                           // Caching strategy. See CSTRTG enum for more info
+
+    PCASC_ENCRYPTION_KEY pLastKey;                  // The key that decrypted the last encrypted frame
+
+    // Positional reads (CascReadFileAt, CascReadFileAsync) may run on multiple threads at once
+    CASC_LOCK FileLock;                             // Protects loading of the file frames and the frame slots
+    CASC_FRAME_SLOT FrameSlots[CASC_FRAME_SLOTS];   // Decoded frames of the positional reads
+    DWORD dwSlotUse;                                // Use counter of the frame slots, for LRU replacement
 };
 
 struct TCascSearch
@@ -388,9 +660,15 @@ struct TCascSearch
 
         // Init provider-specific data
         pCache = NULL;
+        pRootContext = NULL;
+        pTreeContext = NULL;
+        pTagMatches = NULL;
+        pFoundEntry = NULL;
+        memset(&TagIterator, 0, sizeof(CASC_BITSET_ITERATOR));
         nFileIndex = 0;
         nSearchState = 0;
         bListFileUsed = false;
+        bNoFileNames = false;
 
         // Allocate mask
         szListFile = CascNewStr(aszListFile);
@@ -399,6 +677,10 @@ struct TCascSearch
 
     ~TCascSearch()
     {
+        // Let the root handler free its search context
+        if(hs->pRootHandler != NULL)
+            hs->pRootHandler->EndSearch(this);
+
         // Dereference the CASC storage
         hs = hs->Release();
         ClassName = 0;
@@ -406,7 +688,8 @@ struct TCascSearch
         // Free the rest of the members
         CASC_FREE(szMask);
         CASC_FREE(szListFile);
-        CASC_FREE(pCache);
+        ListFile_Free(pCache);
+        delete pTagMatches;
     }
 
     static TCascSearch * IsValid(HANDLE hFind)
@@ -425,11 +708,18 @@ struct TCascSearch
     LPTSTR szListFile;                              // Name of the listfile
     void * pCache;                                  // Listfile cache
     char * szMask;                                  // Search mask
+    CASC_MASK Mask;                                 // Search mask, compiled in CascFindFirstFile
 
     // Provider-specific data
+    void * pRootContext;                            // Root-specific search context, freed by TRootHandler::EndSearch
+    void * pTreeContext;                            // Search context of TFileTreeRoot, freed by TFileTreeRoot::EndSearch
+    CASC_BITSET * pTagMatches;                      // Files matching the tag query (CascFindFirstTaggedFile)
+    CASC_BITSET_ITERATOR TagIterator;               // Position of the search in pTagMatches
+    PCASC_CKEY_ENTRY pFoundEntry;                   // CKey entry of the last found file, as given by the root handler
     size_t nFileIndex;                              // Root-specific search context
     DWORD nSearchState:8;                           // The current search state (0 = listfile, 1 = nameless, 2 = done)
     DWORD bListFileUsed:1;                          // TRUE: The listfile has already been loaded
+    DWORD bNoFileNames:1;                           // TRUE: The caller doesn't want file names (CASC_FIND_NO_FILE_NAMES)
 };
 
 //-----------------------------------------------------------------------------
@@ -450,6 +740,7 @@ inline void FreeCascBlob(PQUERY_KEY pBlob)
 bool  InvokeProgressCallback(TCascStorage * hs, LPCSTR szMessage, LPCSTR szObject, DWORD CurrentValue, DWORD TotalValue);
 DWORD GetFileSpanInfo(PCASC_CKEY_ENTRY pCKeyEntry, PULONGLONG PtrContentSize, PULONGLONG PtrEncodedSize = NULL);
 DWORD DownloadFileFromCDN(TCascStorage * hs, CASC_CDN_DOWNLOAD & CdnsInfo);
+DWORD ForcePathExist(LPCTSTR szFileName, bool bIsFileName);
 DWORD CheckGameDirectory(TCascStorage * hs, LPTSTR szDirectory);
 DWORD LoadCdnsFile(TCascStorage * hs);
 DWORD LoadBuildInfo(TCascStorage * hs);
@@ -461,6 +752,15 @@ LPBYTE LoadFileToMemory(LPCTSTR szFileName, DWORD * pcbFileData);
 bool OpenFileByCKeyEntry(TCascStorage * hs, PCASC_CKEY_ENTRY pCKeyEntry, DWORD dwOpenFlags, HANDLE * PtrFileHandle);
 bool SetCacheStrategy(HANDLE hFile, CSTRTG CacheStrategy);
 
+//-----------------------------------------------------------------------------
+// Reading the file data (CascReadFile.cpp)
+
+bool  ReadDataStream(TCascStorage * hs, PCASC_FILE_SPAN pFileSpan, ULONGLONG * PtrByteOffset, void * pvBuffer, DWORD dwBytesToRead);
+DWORD EnsureFileSpanFramesLoaded(TCascFile * hf);
+DWORD DecodeFileFrame(TCascStorage * hs, PCASC_CKEY_ENTRY pCKeyEntry, PCASC_FILE_FRAME pFrame, LPBYTE pbEncoded, LPBYTE pbDecoded, DWORD FrameIndex, bool bVerifyIntegrity, bool bOvercomeEncrypted, PCASC_ENCRYPTION_KEY * PtrLastKey = NULL);
+DWORD DecodeFileFrame(TCascFile * hf, PCASC_CKEY_ENTRY pCKeyEntry, PCASC_FILE_FRAME pFrame, LPBYTE pbEncoded, LPBYTE pbDecoded, DWORD FrameIndex);
+DWORD ReadFileRange(TCascFile * hf, LPBYTE pbBuffer, ULONGLONG StartOffset, ULONGLONG EndOffset);
+
 //-----------------------------------------------------------------------------
 // Internal file functions
 
@@ -468,23 +768,38 @@ void * ProbeOutputBuffer(void * pvBuffer, size_t cbLength, size_t cbMinLength, s
 
 PCASC_CKEY_ENTRY FindCKeyEntry_CKey(TCascStorage * hs, LPBYTE pbCKey, PDWORD PtrIndex = NULL);
 PCASC_CKEY_ENTRY FindCKeyEntry_EKey(TCascStorage * hs, LPBYTE pbEKey, PDWORD PtrIndex = NULL);
+DWORD FindCKeyEntry_OpenName(TCascStorage * hs, const void * pvFileName, DWORD dwOpenFlags, PCASC_CKEY_ENTRY * PtrCKeyEntry, PULONGLONG PtrFileNameHash = NULL);
 
 size_t GetTagBitmapLength(LPBYTE pbFilePtr, LPBYTE pbFileEnd, DWORD EntryCount);
+DWORD InsertManifestTags(TCascStorage * hs, PCASC_TAG_ENTRY1 TagArray, size_t nTagCount, PDWORD EntryIndexes, size_t nEntryCount);
 
 DWORD CascDecompress(LPBYTE pvOutBuffer, PDWORD pcbOutBuffer, LPBYTE pvInBuffer, DWORD cbInBuffer);
 DWORD CascDirectCopy(LPBYTE pbOutBuffer, PDWORD pcbOutBuffer, LPBYTE pbInBuffer, DWORD cbInBuffer);
 
 DWORD CascLoadEncryptionKeys(TCascStorage * hs);
-DWORD CascDecrypt(TCascStorage * hs, LPBYTE pbOutBuffer, PDWORD pcbOutBuffer, LPBYTE pbInBuffer, DWORD cbInBuffer, DWORD dwFrameIndex);
+DWORD CascDecrypt(TCascStorage * hs, LPBYTE pbOutBuffer, PDWORD pcbOutBuffer, LPBYTE pbInBuffer, DWORD cbInBuffer, DWORD dwFrameIndex, PCASC_ENCRYPTION_KEY * PtrLastKey = NULL);
 
 //-----------------------------------------------------------------------------
 // Support for index files
 
-bool CopyEKeyEntry(TCascStorage * hs, PCASC_CKEY_ENTRY pCKeyEntry);
+bool CopyEKeyEntry(TCascStorage * hs, PCASC_CKEY_ENTRY pCKeyEntry, PCASC_CKEY_ENTRY pBaseEntry = NULL);
 
+DWORD QueryIndexFiles(TCascStorage * hs);
 DWORD LoadIndexFiles(TCascStorage * hs);
+DWORD LoadIndexEntries(TCascStorage * hs, CASC_ARRAY & EKeyEntries);
 void  FreeIndexFiles(TCascStorage * hs);
 
+//-----------------------------------------------------------------------------
+// Support for shared storage index (CascSharedIndex.cpp)
+
+DWORD AttachSharedIndex(TCascStorage * hs, LPCTSTR szName);
+DWORD PublishSharedIndex(TCascStorage * hs, LPCTSTR szName);
+
+//-----------------------------------------------------------------------------
+// Support for file extraction (CascExtract.cpp)
+
+size_t GetSafeName(const char * szFileName, char * szSafeName, size_t ccSafeName);
+
 //-----------------------------------------------------------------------------
 // Support for ROOT file
 
@@ -496,6 +811,13 @@ DWORD RootHandler_CreateOverwatch(TCascStorage * hs, LPBYTE pbRootFile, DWORD cb
 DWORD RootHandler_CreateStarcraft1(TCascStorage * hs, LPBYTE pbRootFile, DWORD cbRootFile);
 DWORD RootHandler_CreateInstall(TCascStorage * hs, LPBYTE pbRootFile, DWORD cbRootFile);
 
+// Returns the maximum number of threads for loading the files referenced by the ROOT file.
+// Online storages download missing files on demand, which must not be done in parallel
+inline DWORD GetRootLoaderThreads(TCascStorage * hs)
+{
+    return (hs->dwFeatures & CASC_FEATURE_ONLINE) ? 1 : 0;
+}
+
 //-----------------------------------------------------------------------------
 // Dumpers (CascDumpData.cpp)
 
@@ -23,19 +23,16 @@ typedef struct _CASC_SALSA20
 
 } CASC_SALSA20, *PCASC_SALSA20;
 
-// For static-stored keys
-struct CASC_ENCRYPTION_KEY
-{
-    ULONGLONG KeyName;                          // "Name" of the key
-    BYTE Key[CASC_KEY_LENGTH];                  // The key itself
-};
+// Perfect hash of the static keys. Each bucket has a seed that maps its keys
+// to distinct slots; a key is found by one compare, whatever the number of keys
+#define CASC_STATIC_KEY_COUNT       _countof(StaticCascKeys)
+#define CASC_STATIC_KEY_BUCKETS     ((CASC_STATIC_KEY_COUNT / 4) + 1)
+#define CASC_STATIC_KEY_MAX_SEED    0xFFFF
 
-// For keys inside the key map
-struct CASC_ENCRYPTION_KEY2 : public CASC_ENCRYPTION_KEY
-{
-    CASC_ENCRYPTION_KEY2 * pNext;               // Pointer to the next key wihh the same hash
-};
-typedef CASC_ENCRYPTION_KEY2 * PCASC_ENCRYPTION_KEY2;
+#define STATIC_KEYS_NOT_BUILT       0           // The perfect hash hasn't been built yet
+#define STATIC_KEYS_BUILDING        1           // A thread is building the perfect hash
+#define STATIC_KEYS_READY           2           // The perfect hash is ready
+#define STATIC_KEYS_FAILED          3           // The perfect hash could not be built
 
 //-----------------------------------------------------------------------------
 // Known encryption keys. See https://wowdev.wiki/CASC for updates
@@ -527,6 +524,11 @@ static CASC_ENCRYPTION_KEY StaticCascKeys[] =
     { 0xFF7C9A1B789D0D42ULL, { 0xA9, 0xEC, 0x27, 0x53, 0x3B, 0x7D, 0x9D, 0xB1, 0xE2, 0x39, 0xEC, 0x68, 0x8B, 0xA6, 0x53, 0xF4 } },   // WOW-33978patch9.0.1_Beta
 };
 
+static USHORT StaticKeySeeds[CASC_STATIC_KEY_BUCKETS];     // Seed of each bucket
+static USHORT StaticKeySlots[CASC_STATIC_KEY_COUNT];        // Index to StaticCascKeys for each slot
+static DWORD StaticKeySlotCount = 0;                        // Number of slots (number of unique static keys)
+static DWORD StaticKeysState = STATIC_KEYS_NOT_BUILT;
+
 //-----------------------------------------------------------------------------
 // Local functions
 
@@ -652,97 +654,353 @@ static int Decrypt_Salsa20(LPBYTE pbOutBuffer, LPBYTE pbInBuffer, size_t cbInBuf
 }
 
 //-----------------------------------------------------------------------------
-// Key map implementation
+// Perfect hash of the static keys
+
+// The key names are not random enough to be used as hash directly
+static ULONGLONG HashKeyName(ULONGLONG KeyName, DWORD Seed)
+{
+    ULONGLONG Hash = KeyName + (Seed * 0x9E3779B97F4A7C15ULL);
+
+    Hash = (Hash ^ (Hash >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    Hash = (Hash ^ (Hash >> 27)) * 0x94D049BB133111EBULL;
+    return Hash ^ (Hash >> 31);
+}
+
+static size_t GetStaticKeyBucket(ULONGLONG KeyName)
+{
+    return (size_t)(HashKeyName(KeyName, 0) % CASC_STATIC_KEY_BUCKETS);
+}
+
+static size_t GetStaticKeySlot(ULONGLONG KeyName, DWORD Seed)
+{
+    return (size_t)(HashKeyName(KeyName, Seed) % StaticKeySlotCount);
+}
+
+// Finds a seed that puts all keys of the bucket to free slots
+static bool PlaceStaticKeyBucket(const USHORT * KeyIndexes, size_t nKeyCount, LPBYTE SlotUsed, size_t BucketIndex)
+{
+    size_t Slots[0x40];
+
+    // Buckets with that many keys are extremely unlikely
+    if(nKeyCount > _countof(Slots))
+        return false;
+
+    for(DWORD Seed = 1; Seed <= CASC_STATIC_KEY_MAX_SEED; Seed++)
+    {
+        size_t i, j;
+
+        // All slots must be free and different from each other
+        for(i = 0; i < nKeyCount; i++)
+        {
+            Slots[i] = GetStaticKeySlot(StaticCascKeys[KeyIndexes[i]].KeyName, Seed);
+            if(SlotUsed[Slots[i]])
+                break;
+            for(j = 0; j < i && Slots[j] != Slots[i]; j++);
+            if(j < i)
+                break;
+        }
+
+        // Did we find the seed?
+        if(i == nKeyCount)
+        {
+            for(i = 0; i < nKeyCount; i++)
+            {
+                StaticKeySlots[Slots[i]] = KeyIndexes[i];
+                SlotUsed[Slots[i]] = 1;
+            }
+            StaticKeySeeds[BucketIndex] = (USHORT)Seed;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static DWORD BuildStaticKeyHash()
+{
+    USHORT * BucketKeys;                // Key indexes, grouped by bucket
+    DWORD * BucketStart;                // Begin of each bucket in BucketKeys
+    DWORD * BucketEnd;                  // End of each bucket in BucketKeys
+    LPBYTE SlotUsed;
+    size_t nMaxBucketSize = 0;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // Allocate the work buffers
+    BucketKeys = CASC_ALLOC<USHORT>(CASC_STATIC_KEY_COUNT);
+    BucketStart = CASC_ALLOC_ZERO<DWORD>(CASC_STATIC_KEY_BUCKETS + 1);
+    BucketEnd = CASC_ALLOC_ZERO<DWORD>(CASC_STATIC_KEY_BUCKETS);
+    SlotUsed = CASC_ALLOC_ZERO<BYTE>(CASC_STATIC_KEY_COUNT);
+    if(BucketKeys != NULL && BucketStart != NULL && BucketEnd != NULL && SlotUsed != NULL)
+    {
+        // Reserve space for each bucket
+        for(size_t i = 0; i < CASC_STATIC_KEY_COUNT; i++)
+            BucketStart[GetStaticKeyBucket(StaticCascKeys[i].KeyName) + 1]++;
+        for(size_t i = 0; i < CASC_STATIC_KEY_BUCKETS; i++)
+        {
+            BucketStart[i + 1] += BucketStart[i];
+            BucketEnd[i] = BucketStart[i];
+        }
+
+        // Insert the keys to the buckets. If a key is in the table more than once, the first one wins
+        StaticKeySlotCount = 0;
+        for(size_t i = 0; i < CASC_STATIC_KEY_COUNT; i++)
+        {
+            size_t BucketIndex = GetStaticKeyBucket(StaticCascKeys[i].KeyName);
+            size_t j;
+
+            for(j = BucketStart[BucketIndex]; j < BucketEnd[BucketIndex]; j++)
+            {
+                if(StaticCascKeys[BucketKeys[j]].KeyName == StaticCascKeys[i].KeyName)
+                    break;
+            }
 
-static PCASC_ENCRYPTION_KEY2 CreateKeyItem(ULONGLONG KeyName, LPBYTE Key)
+            if(j == BucketEnd[BucketIndex])
+            {
+                BucketKeys[BucketEnd[BucketIndex]++] = (USHORT)i;
+                nMaxBucketSize = CASCLIB_MAX(nMaxBucketSize, BucketEnd[BucketIndex] - BucketStart[BucketIndex]);
+                StaticKeySlotCount++;
+            }
+        }
+
+        // Place the biggest buckets first, while most of the slots are free
+        for(size_t nBucketSize = nMaxBucketSize; nBucketSize > 0 && dwErrCode == ERROR_SUCCESS; nBucketSize--)
+        {
+            for(size_t i = 0; i < CASC_STATIC_KEY_BUCKETS; i++)
+            {
+                size_t nKeyCount = BucketEnd[i] - BucketStart[i];
+
+                if(nKeyCount == nBucketSize && !PlaceStaticKeyBucket(BucketKeys + BucketStart[i], nKeyCount, SlotUsed, i))
+                {
+                    dwErrCode = ERROR_CAN_NOT_COMPLETE;
+                    break;
+                }
+            }
+        }
+    }
+    else
+    {
+        dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    CASC_FREE(SlotUsed);
+    CASC_FREE(BucketEnd);
+    CASC_FREE(BucketStart);
+    CASC_FREE(BucketKeys);
+    return dwErrCode;
+}
+
+// Builds the perfect hash once per process. Returns true if it's available
+static bool EnsureStaticKeyHash()
 {
-    PCASC_ENCRYPTION_KEY2 pNewItem;
+    DWORD dwState;
 
-    if((pNewItem = new CASC_ENCRYPTION_KEY2) != NULL)
+    // The first thread builds the perfect hash, the others wait for it
+    if((dwState = CascInterlockedCompareExchange(&StaticKeysState, STATIC_KEYS_BUILDING, STATIC_KEYS_NOT_BUILT)) == STATIC_KEYS_NOT_BUILT)
     {
-        memset(pNewItem, 0, sizeof(CASC_ENCRYPTION_KEY2));
-        pNewItem->KeyName = KeyName;
-        memcpy(pNewItem->Key, Key, CASC_KEY_LENGTH);
+        dwState = (BuildStaticKeyHash() == ERROR_SUCCESS) ? STATIC_KEYS_READY : STATIC_KEYS_FAILED;
+        CascMemoryBarrier();
+        StaticKeysState = dwState;
     }
 
-    return pNewItem;
+    while(dwState == STATIC_KEYS_BUILDING)
+    {
+        CascYield();
+        dwState = CascInterlockedCompareExchange(&StaticKeysState, STATIC_KEYS_BUILDING, STATIC_KEYS_BUILDING);
+    }
+
+    return (dwState == STATIC_KEYS_READY);
+}
+
+static PCASC_ENCRYPTION_KEY FindStaticKey(ULONGLONG KeyName)
+{
+    PCASC_ENCRYPTION_KEY pKey;
+    DWORD Seed = StaticKeySeeds[GetStaticKeyBucket(KeyName)];
+
+    // Empty bucket has no seed
+    if(Seed == 0)
+        return NULL;
+
+    pKey = &StaticCascKeys[StaticKeySlots[GetStaticKeySlot(KeyName, Seed)]];
+    return (pKey->KeyName == KeyName) ? pKey : NULL;
 }
 
-CASC_KEY_MAP::CASC_KEY_MAP()
+//-----------------------------------------------------------------------------
+// Key map implementation
+
+CASC_KEY_MAP::CASC_KEY_MAP(CASC_ARENA * pNewArena)
 {
-    memset(HashTable, 0, sizeof(HashTable));
+    CascInitLock(Lock);
+    pTable = NULL;
+    ItemCount = 0;
+    pArena = pNewArena;
+    bStaticKeys = false;
 }
 
 CASC_KEY_MAP::~CASC_KEY_MAP()
 {
-    PCASC_ENCRYPTION_KEY2 pNextItem;
-    PCASC_ENCRYPTION_KEY2 pKeyItem;
+    CASC_KEY_TABLE * pFreeTable = pTable;
+    CASC_KEY_TABLE * pPrevTable;
 
-    for(size_t i = 0; i < CASC_KEY_TABLE_SIZE; i++)
+    // Tables from the arena are released together with the arena
+    while(pArena == NULL && pFreeTable != NULL)
     {
-        if((pKeyItem = (PCASC_ENCRYPTION_KEY2)HashTable[i]) != NULL)
+        pPrevTable = pFreeTable->pPrevTable;
+        CASC_FREE(pFreeTable);
+        pFreeTable = pPrevTable;
+    }
+    pTable = NULL;
+
+    CascFreeLock(Lock);
+}
+
+DWORD CASC_KEY_MAP::LoadStaticKeys()
+{
+    // If the perfect hash can't be built, the static keys are added one by one
+    if(!EnsureStaticKeyHash())
+    {
+        for(size_t i = 0; i < CASC_STATIC_KEY_COUNT; i++)
         {
-            while(pKeyItem != NULL)
+            if(!AddKey(StaticCascKeys[i].KeyName, StaticCascKeys[i].Key))
+                return ERROR_NOT_ENOUGH_MEMORY;
+        }
+        return ERROR_SUCCESS;
+    }
+
+    bStaticKeys = true;
+    return ERROR_SUCCESS;
+}
+
+CASC_KEY_TABLE * CASC_KEY_MAP::CreateTable(size_t TableSize)
+{
+    CASC_KEY_TABLE * pNewTable;
+    size_t cbTable = sizeof(CASC_KEY_TABLE) + (TableSize - 1) * sizeof(CASC_ENCRYPTION_KEY);
+
+    // Allocate the table. The free slots have zero key name
+    pNewTable = (pArena != NULL) ? (CASC_KEY_TABLE *)pArena->Alloc<BYTE>(cbTable) : (CASC_KEY_TABLE *)CASC_ALLOC<BYTE>(cbTable);
+    if(pNewTable != NULL)
+    {
+        memset(pNewTable, 0, cbTable);
+        pNewTable->TableSize = TableSize;
+    }
+
+    return pNewTable;
+}
+
+// Creates a table twice as big and makes it current. Readers that
+// still use the old table will find all keys that were in it
+bool CASC_KEY_MAP::EnlargeTable()
+{
+    CASC_KEY_TABLE * pOldTable = pTable;
+    CASC_KEY_TABLE * pNewTable;
+
+    if((pNewTable = CreateTable((pOldTable != NULL) ? (pOldTable->TableSize * 2) : CASC_KEY_TABLE_SIZE)) == NULL)
+        return false;
+
+    // Move the keys to the new table
+    if(pOldTable != NULL)
+    {
+        for(size_t i = 0; i < pOldTable->TableSize; i++)
+        {
+            PCASC_ENCRYPTION_KEY pOldKey = &pOldTable->Keys[i];
+
+            if(pOldKey->KeyName != 0)
             {
-                pNextItem = pKeyItem->pNext;
-                delete pKeyItem;
-                pKeyItem = pNextItem;
+                size_t nIndex = (size_t)HashKeyName(pOldKey->KeyName, 0) & (pNewTable->TableSize - 1);
+
+                while(pNewTable->Keys[nIndex].KeyName != 0)
+                    nIndex = (nIndex + 1) & (pNewTable->TableSize - 1);
+                pNewTable->Keys[nIndex] = *pOldKey;
             }
         }
     }
+
+    // Publish the new table after it's complete
+    pNewTable->pPrevTable = pOldTable;
+    CascMemoryBarrier();
+    pTable = pNewTable;
+    return true;
 }
 
-LPBYTE CASC_KEY_MAP::FindKey(ULONGLONG KeyName)
+PCASC_ENCRYPTION_KEY CASC_KEY_MAP::FindRuntimeKey(ULONGLONG KeyName)
 {
-    PCASC_ENCRYPTION_KEY2 pKeyItem = NULL;
-    size_t HashIndex = (size_t)(KeyName & CASC_KEY_TABLE_MASK);
+    CASC_KEY_TABLE * pCurrTable = pTable;
 
-    // Check the key chain beginning at the hash table
-    pKeyItem = (PCASC_ENCRYPTION_KEY2)HashTable[HashIndex];
-    while(pKeyItem != NULL)
+    if(pCurrTable != NULL)
     {
-        if(pKeyItem->KeyName == KeyName)
-            return pKeyItem->Key;
-        pKeyItem = pKeyItem->pNext;
+        size_t nMask = pCurrTable->TableSize - 1;
+        size_t nIndex = (size_t)HashKeyName(KeyName, 0) & nMask;
+
+        // The table is never full, so there is always a free slot to stop at
+        while(pCurrTable->Keys[nIndex].KeyName != 0)
+        {
+            if(pCurrTable->Keys[nIndex].KeyName == KeyName)
+                return &pCurrTable->Keys[nIndex];
+            nIndex = (nIndex + 1) & nMask;
+        }
     }
 
-    // Not found
     return NULL;
 }
 
+PCASC_ENCRYPTION_KEY CASC_KEY_MAP::FindKeyItem(ULONGLONG KeyName)
+{
+    PCASC_ENCRYPTION_KEY pKey = NULL;
+
+    if(bStaticKeys)
+        pKey = FindStaticKey(KeyName);
+    if(pKey == NULL)
+        pKey = FindRuntimeKey(KeyName);
+    return pKey;
+}
+
+LPBYTE CASC_KEY_MAP::FindKey(ULONGLONG KeyName)
+{
+    PCASC_ENCRYPTION_KEY pKey = FindKeyItem(KeyName);
+
+    return (pKey != NULL) ? pKey->Key : NULL;
+}
+
 bool CASC_KEY_MAP::AddKey(ULONGLONG KeyName, LPBYTE Key)
 {
-    PCASC_ENCRYPTION_KEY2 pKeyItem;
-    PCASC_ENCRYPTION_KEY2 pNewItem;
-    size_t HashIndex = (size_t)(KeyName & CASC_KEY_TABLE_MASK);
+    bool bResult = true;
+
+    // Zero marks a free slot
+    if(KeyName == 0)
+        return false;
+
+    CascLock(Lock);
 
-    // Is the key already there?
-    if(FindKey(KeyName) == NULL)
+    // If the key is already there, it's OK
+    if(FindKeyItem(KeyName) == NULL)
     {
-        // Create new key item
-        if((pNewItem = CreateKeyItem(KeyName, Key)) == NULL)
-            return false;
+        // Keep the table at most half full
+        if(pTable == NULL || ((ItemCount + 1) * 2) > pTable->TableSize)
+            bResult = EnlargeTable();
 
-        if(HashTable[HashIndex] != NULL)
+        if(bResult)
         {
-            // Get the last-in-chain key item
-            pKeyItem = (PCASC_ENCRYPTION_KEY2)(HashTable[HashIndex]);
-            while(pKeyItem->pNext != NULL)
-                pKeyItem = pKeyItem->pNext;
+            size_t nMask = pTable->TableSize - 1;
+            size_t nIndex = (size_t)HashKeyName(KeyName, 0) & nMask;
 
-            // Insert the key to the chain
-            pKeyItem->pNext = pNewItem;
-            return true;
-        }
-        else
-        {
-            HashTable[HashIndex] = pNewItem;
-            return true;
+            while(pTable->Keys[nIndex].KeyName != 0)
+                nIndex = (nIndex + 1) & nMask;
+
+            // The key must be complete before the readers can see its name
+            memcpy(pTable->Keys[nIndex].Key, Key, CASC_KEY_LENGTH);
+            CascMemoryBarrier();
+            pTable->Keys[nIndex].KeyName = KeyName;
+            ItemCount++;
         }
     }
 
-    // Already exists, it's OK
-    return true;
+    CascUnlock(Lock);
+    return bResult;
+}
+
+PCASC_ENCRYPTION_KEY CASC_KEY_MAP::GetStaticKeys(size_t & nKeyCount)
+{
+    nKeyCount = CASC_STATIC_KEY_COUNT;
+    return StaticCascKeys;
 }
 
 //-----------------------------------------------------------------------------
@@ -750,15 +1008,7 @@ bool CASC_KEY_MAP::AddKey(ULONGLONG KeyName, LPBYTE Key)
 
 DWORD CascLoadEncryptionKeys(TCascStorage * hs)
 {
-    for(size_t i = 0; i < _countof(StaticCascKeys); i++)
-    {
-        if(!hs->KeyMap.AddKey(StaticCascKeys[i].KeyName, StaticCascKeys[i].Key))
-        {
-            return ERROR_NOT_ENOUGH_MEMORY;
-        }
-    }
-
-    return ERROR_SUCCESS;
+    return hs->KeyMap.LoadStaticKeys();
 }
 
 bool WINAPI CascAddEncryptionKey(HANDLE hStorage, ULONGLONG KeyName, LPBYTE Key)
@@ -773,8 +1023,20 @@ bool WINAPI CascAddEncryptionKey(HANDLE hStorage, ULONGLONG KeyName, LPBYTE Key)
         return false;
     }
 
+    // Zero key name marks a free entry in the key map
+    if(KeyName == 0)
+    {
+        SetCascError(ERROR_INVALID_PARAMETER);
+        return false;
+    }
+
     // Add the key to the map and return result
-    return hs->KeyMap.AddKey(KeyName, Key);
+    if(!hs->KeyMap.AddKey(KeyName, Key))
+    {
+        SetCascError(ERROR_NOT_ENOUGH_MEMORY);
+        return false;
+    }
+    return true;
 }
 
 bool WINAPI CascAddStringEncryptionKey(HANDLE hStorage, ULONGLONG KeyName, LPCSTR szKey)
@@ -943,11 +1205,11 @@ DWORD CascDirectCopy(LPBYTE pbOutBuffer, PDWORD pcbOutBuffer, LPBYTE pbInBuffer,
     return ERROR_SUCCESS;
 }
 
-DWORD CascDecrypt(TCascStorage * hs, LPBYTE pbOutBuffer, PDWORD pcbOutBuffer, LPBYTE pbInBuffer, DWORD cbInBuffer, DWORD dwFrameIndex)
+DWORD CascDecrypt(TCascStorage * hs, LPBYTE pbOutBuffer, PDWORD pcbOutBuffer, LPBYTE pbInBuffer, DWORD cbInBuffer, DWORD dwFrameIndex, PCASC_ENCRYPTION_KEY * PtrLastKey)
 {
+    PCASC_ENCRYPTION_KEY pKey = NULL;
     ULONGLONG KeyName = 0;
     LPBYTE pbBufferEnd = pbInBuffer + cbInBuffer;
-    LPBYTE pbKey;
     DWORD KeyNameSize;
     DWORD dwShift = 0;
     DWORD IVSize;
@@ -993,12 +1255,22 @@ DWORD CascDecrypt(TCascStorage * hs, LPBYTE pbOutBuffer, PDWORD pcbOutBuffer, LP
     if((DWORD)(pbBufferEnd - pbInBuffer) > pcbOutBuffer[0])
         return ERROR_INSUFFICIENT_BUFFER;
 
+    // All frames of a file are usually encrypted by the same key.
+    // If the caller remembers the last one, we don't need to look it up
+    if(PtrLastKey != NULL && PtrLastKey[0] != NULL && PtrLastKey[0]->KeyName == KeyName)
+        pKey = PtrLastKey[0];
+
     // Check if we know the key
-    pbKey = hs->KeyMap.FindKey(KeyName);
-    if(pbKey == NULL)
+    if(pKey == NULL)
     {
-        hs->LastFailKeyName = KeyName;
-        return ERROR_FILE_ENCRYPTED;
+        if((pKey = hs->KeyMap.FindKeyItem(KeyName)) == NULL)
+        {
+            hs->LastFailKeyName = KeyName;
+            return ERROR_FILE_ENCRYPTED;
+        }
+
+        if(PtrLastKey != NULL)
+            PtrLastKey[0] = pKey;
     }
 
     // Shuffle the Vector with the block index
@@ -1014,7 +1286,7 @@ DWORD CascDecrypt(TCascStorage * hs, LPBYTE pbOutBuffer, PDWORD pcbOutBuffer, LP
     switch(EncryptionType)
     {
         case 'S':   // Salsa20
-            dwErrCode = Decrypt_Salsa20(pbOutBuffer, pbInBuffer, (pbBufferEnd - pbInBuffer), pbKey, 0x10, Vector);
+            dwErrCode = Decrypt_Salsa20(pbOutBuffer, pbInBuffer, (pbBufferEnd - pbInBuffer), pKey->Key, 0x10, Vector);
             if(dwErrCode != ERROR_SUCCESS)
                 return dwErrCode;
 
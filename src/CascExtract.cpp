@@ -0,0 +1,797 @@
+/*****************************************************************************/
+/* CascExtract.cpp                        Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Multi-threaded extraction of files to a directory                         */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 19.10.26  1.00  Lad  The first version of CascExtract.cpp                 */
+/*****************************************************************************/
+
+#define __CASCLIB_SELF__
+#include "CascLib.h"
+#include "CascCommon.h"
+
+//-----------------------------------------------------------------------------
+// Local defines
+
+#define CASC_EXTRACT_CHUNK_FILES    0x100           // Maximum number of files in one work item
+#define CASC_EXTRACT_CHUNK_BYTES    0x1000000       // Maximum number of content bytes in one work item
+#define CASC_EXTRACT_BUFFER_SIZE    0x100000        // Size of the buffer of one worker. Files are written in blocks of this size
+#define CASC_EXTRACT_ALIGNMENT      0x1000          // Alignment of the buffer and of the writes, as required by unbuffered I/O
+#define CASC_EXTRACT_PROGRESS_TIME  100000          // Minimum time between two progress callbacks, in microseconds
+
+#ifdef CASCLIB_PLATFORM_WINDOWS
+#define CASC_INVALID_OUTPUT         INVALID_HANDLE_VALUE
+typedef HANDLE CASC_OUTPUT_HANDLE;
+#else
+#define CASC_INVALID_OUTPUT         -1
+typedef int CASC_OUTPUT_HANDLE;
+#endif
+
+// One file to extract
+struct CASC_EXTRACT_ITEM
+{
+    PCASC_CKEY_ENTRY pCKeyEntry;                    // The file entry. Files with the same entry have the same content
+    ULONGLONG StorageOffset;                        // Position of the file in the storage. The items are sorted by it
+    size_t nNameOffset;                             // Offset of the safe file name in CASC_EXTRACT_CONTEXT::Names
+    size_t nFindIndex;                              // Order in which the file was found
+    bool bDuplicate;                                // A file with the same target name was found before
+};
+
+// Range of items processed by one work item. Files with the same content are never split
+struct CASC_EXTRACT_CHUNK
+{
+    size_t nFirstItem;                              // Index of the first item in CASC_EXTRACT_CONTEXT::Items
+    size_t nItemCount;                              // Number of items
+};
+
+// Target file being written
+struct CASC_OUTPUT_FILE
+{
+    CASC_OUTPUT_HANDLE hFile;                       // Handle of the file
+    ULONGLONG ByteOffset;                           // Current write position
+    bool bDirectIo;                                 // The file is open for unbuffered I/O
+};
+
+// State of one work item
+struct CASC_EXTRACT_WORKER
+{
+    LPBYTE pbBuffer;                                // Aligned buffer for the file data
+
+    // Counters, added to the result when the work item is done
+    ULONGLONG ContentBytes;
+    ULONGLONG BytesWritten;
+    size_t FilesExtracted;
+    size_t FilesLinked;
+    size_t FilesEncrypted;
+    size_t FilesFailed;
+    DWORD dwErrCode;                                // Error code of the first failed file
+};
+
+struct CASC_EXTRACT_CONTEXT
+{
+    TCascStorage * hs;                              // The storage
+    LPCTSTR szTargetDir;                            // Target directory given by the caller
+    PCASC_EXTRACT_RESULT pResult;                   // Result given by the caller
+    PFNEXTRACTCALLBACK PfnExtractCallback;          // Progress callback and its parameter
+    void * PtrExtractParam;
+    DWORD dwFlags;                                  // See CASC_EXTRACT_XXX
+
+    CASC_ARRAY Items;                               // Files to extract (CASC_EXTRACT_ITEM), sorted by the storage offset
+    CASC_ARRAY Names;                               // Names of the files, zero terminated
+    CASC_ARRAY Chunks;                              // Work items (CASC_EXTRACT_CHUNK)
+    size_t nItemCount;                              // Number of files to extract. The duplicate names follow them
+
+    CASC_LOCK Lock;                                 // Protects everything below
+    ULONGLONG StartTime;
+    ULONGLONG LastProgressTime;
+    DWORD dwErrCode;                                // Error code of the first failed file
+    bool bCancelled;
+};
+
+//-----------------------------------------------------------------------------
+// Local functions - target files
+
+static LPBYTE AllocAlignedBuffer(size_t cbBuffer)
+{
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    return (LPBYTE)VirtualAlloc(NULL, cbBuffer, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+    void * pvBuffer = NULL;
+
+    return (posix_memalign(&pvBuffer, CASC_EXTRACT_ALIGNMENT, cbBuffer) == 0) ? (LPBYTE)pvBuffer : NULL;
+#endif
+}
+
+static void FreeAlignedBuffer(LPBYTE pbBuffer)
+{
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    if(pbBuffer != NULL)
+        VirtualFree(pbBuffer, 0, MEM_RELEASE);
+#else
+    free(pbBuffer);
+#endif
+}
+
+static CASC_OUTPUT_HANDLE OpenOutputHandle(LPCTSTR szFileName, bool bDirectIo)
+{
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    DWORD dwFlags = (bDirectIo) ? (FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH) : FILE_FLAG_SEQUENTIAL_SCAN;
+
+    return CreateFile(szFileName, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | dwFlags, NULL);
+#else
+    int nFlags = O_WRONLY | O_CREAT | O_TRUNC;
+#ifdef O_DIRECT
+    if(bDirectIo)
+        nFlags |= O_DIRECT;
+#else
+    CASCLIB_UNUSED(bDirectIo);
+#endif
+    return open(szFileName, nFlags, 0644);
+#endif
+}
+
+static bool IsPathNotFound()
+{
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    return (GetLastError() == ERROR_PATH_NOT_FOUND);
+#else
+    return (errno == ENOENT);
+#endif
+}
+
+static DWORD GetLastOsError()
+{
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    return GetLastError();
+#else
+    return errno;
+#endif
+}
+
+// Creates the target file, including its directory, and allocates its space on the disk
+static DWORD CreateOutputFile(CASC_OUTPUT_FILE & Output, LPCTSTR szFileName, ULONGLONG FileSize, bool bDirectIo)
+{
+    // The directories are only created when the file can't be created without them
+    Output.hFile = OpenOutputHandle(szFileName, bDirectIo);
+    if(Output.hFile == CASC_INVALID_OUTPUT && IsPathNotFound())
+    {
+        if(ForcePathExist(szFileName, true) == ERROR_SUCCESS)
+            Output.hFile = OpenOutputHandle(szFileName, bDirectIo);
+    }
+
+    // Some file systems don't support unbuffered I/O
+    if(Output.hFile == CASC_INVALID_OUTPUT && bDirectIo)
+    {
+        Output.hFile = OpenOutputHandle(szFileName, false);
+        bDirectIo = false;
+    }
+    if(Output.hFile == CASC_INVALID_OUTPUT)
+        return GetLastOsError();
+
+    Output.ByteOffset = 0;
+    Output.bDirectIo = bDirectIo;
+
+    // Allocate the whole file at once, so the file system can keep it contiguous.
+    // Failure is not an error, not all file systems support it
+    if(FileSize != 0)
+    {
+#if defined(CASCLIB_PLATFORM_WINDOWS)
+        LARGE_INTEGER NewPosition;
+
+        NewPosition.QuadPart = (LONGLONG)FileSize;
+        if(SetFilePointerEx(Output.hFile, NewPosition, NULL, FILE_BEGIN))
+            SetEndOfFile(Output.hFile);
+        NewPosition.QuadPart = 0;
+        SetFilePointerEx(Output.hFile, NewPosition, NULL, FILE_BEGIN);
+#elif defined(CASCLIB_PLATFORM_LINUX)
+        fallocate(Output.hFile, 0, 0, (off_t)FileSize);
+#elif defined(CASCLIB_PLATFORM_MAC)
+        if(bDirectIo)
+            fcntl(Output.hFile, F_NOCACHE, 1);
+#endif
+    }
+
+    return ERROR_SUCCESS;
+}
+
+// Writes the data at the current position. With unbuffered I/O, the end of the file
+// is padded to the alignment; CloseOutputFile then cuts the file to its real size
+static DWORD WriteOutputFile(CASC_OUTPUT_FILE & Output, LPBYTE pbBuffer, DWORD cbBuffer)
+{
+    DWORD cbToWrite = cbBuffer;
+
+    if(Output.bDirectIo && (cbToWrite & (CASC_EXTRACT_ALIGNMENT - 1)))
+    {
+        cbToWrite = ALIGN_TO_SIZE(cbBuffer, CASC_EXTRACT_ALIGNMENT);
+        memset(pbBuffer + cbBuffer, 0, cbToWrite - cbBuffer);
+    }
+
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    DWORD dwWritten = 0;
+
+    if(!WriteFile(Output.hFile, pbBuffer, cbToWrite, &dwWritten, NULL) || dwWritten != cbToWrite)
+        return GetLastError();
+#else
+    while(cbToWrite != 0)
+    {
+        ssize_t nWritten = write(Output.hFile, pbBuffer, cbToWrite);
+
+        if(nWritten <= 0)
+            return (nWritten < 0) ? errno : ERROR_DISK_FULL;
+        pbBuffer += nWritten;
+        cbToWrite -= (DWORD)nWritten;
+    }
+#endif
+
+    Output.ByteOffset += cbBuffer;
+    return ERROR_SUCCESS;
+}
+
+static DWORD CloseOutputFile(CASC_OUTPUT_FILE & Output)
+{
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // Set the real size of the file. It may be shorter than the preallocated
+    // size if the file could not be read, or longer because of the padding
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    LARGE_INTEGER NewPosition;
+
+    NewPosition.QuadPart = (LONGLONG)Output.ByteOffset;
+    if(!SetFilePointerEx(Output.hFile, NewPosition, NULL, FILE_BEGIN) || !SetEndOfFile(Output.hFile))
+        dwErrCode = GetLastError();
+    CloseHandle(Output.hFile);
+#else
+    if(ftruncate(Output.hFile, (off_t)Output.ByteOffset) != 0)
+        dwErrCode = errno;
+    if(close(Output.hFile) != 0 && dwErrCode == ERROR_SUCCESS)
+        dwErrCode = errno;
+#endif
+
+    Output.hFile = CASC_INVALID_OUTPUT;
+    return dwErrCode;
+}
+
+static bool CreateLink(LPCTSTR szExistingFile, LPCTSTR szNewFile)
+{
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    return (::CreateHardLink(szNewFile, szExistingFile, NULL) != FALSE);
+#else
+    return (link(szExistingFile, szNewFile) == 0);
+#endif
+}
+
+static bool LinkOutputFile(LPCTSTR szExistingFile, LPCTSTR szNewFile)
+{
+    // Replace the file from the previous extraction
+    _tremove(szNewFile);
+
+    // The directories are only created when the link can't be created without them
+    if(!CreateLink(szExistingFile, szNewFile))
+    {
+        if(!IsPathNotFound() || ForcePathExist(szNewFile, true) != ERROR_SUCCESS)
+            return false;
+        return CreateLink(szExistingFile, szNewFile);
+    }
+    return true;
+}
+
+// Converts the name of the file to the name that can be used in the target directory.
+// Files can't be written outside of the target directory, so ".." path parts are changed
+// to "__". Different file names may give the same safe name; see MarkDuplicateNames
+size_t GetSafeName(const char * szFileName, char * szSafeName, size_t ccSafeName)
+{
+    size_t i;
+
+    for(i = 0; szFileName[i] != 0 && i < (ccSafeName - 1); i++)
+    {
+        BYTE OneChar = (BYTE)szFileName[i];
+        bool bPartBegin = (i == 0 || szFileName[i - 1] == '\\' || szFileName[i - 1] == '/');
+
+        // Characters that are not allowed in file names
+        if(OneChar < 0x20 || strchr(":*?\"<>|", OneChar) != NULL)
+            OneChar = '_';
+
+        // Both separators give the same path
+        if(OneChar == '\\')
+            OneChar = '/';
+
+        // The ".." path part. If only one character fits, the name is cut after the first '_'
+        if(OneChar == '.' && bPartBegin && szFileName[i + 1] == '.')
+        {
+            if(szFileName[i + 2] == 0 || szFileName[i + 2] == '\\' || szFileName[i + 2] == '/')
+            {
+                if((i + 2) < ccSafeName)
+                    szSafeName[i++] = '_';
+                OneChar = '_';
+            }
+        }
+
+        szSafeName[i] = OneChar;
+    }
+    szSafeName[i] = 0;
+    return i;
+}
+
+static void GetTargetPath(CASC_EXTRACT_CONTEXT & Ctx, const char * szSafeName, LPTSTR szTargetPath, size_t ccTargetPath)
+{
+    TCHAR szFileName[MAX_PATH];
+
+    CascStrCopy(szFileName, _countof(szFileName), szSafeName);
+    CombinePath(szTargetPath, ccTargetPath, Ctx.szTargetDir, szFileName, NULL);
+}
+
+//-----------------------------------------------------------------------------
+// Local functions - preparation of the work items
+
+static int CompareItemsByName(const void * pvItem1, const void * pvItem2)
+{
+    const char * szName1 = *(const char **)pvItem1;
+    const char * szName2 = *(const char **)pvItem2;
+    int nResult;
+
+    // The pointers are in the order in which the files were found
+    if((nResult = _stricmp(szName1, szName2)) != 0)
+        return nResult;
+    return (szName1 < szName2) ? -1 : +1;
+}
+
+static int CompareItemsByOffset(const void * pvItem1, const void * pvItem2)
+{
+    CASC_EXTRACT_ITEM * pItem1 = (CASC_EXTRACT_ITEM *)pvItem1;
+    CASC_EXTRACT_ITEM * pItem2 = (CASC_EXTRACT_ITEM *)pvItem2;
+
+    // The files with duplicate names are moved to the end
+    if(pItem1->bDuplicate != pItem2->bDuplicate)
+        return (pItem1->bDuplicate) ? +1 : -1;
+    if(pItem1->StorageOffset != pItem2->StorageOffset)
+        return (pItem1->StorageOffset < pItem2->StorageOffset) ? -1 : +1;
+    if(pItem1->pCKeyEntry != pItem2->pCKeyEntry)
+        return (pItem1->pCKeyEntry < pItem2->pCKeyEntry) ? -1 : +1;
+    return (pItem1->nFindIndex < pItem2->nFindIndex) ? -1 : +1;
+}
+
+// Finds all files that match the mask
+static DWORD FindFilesToExtract(CASC_EXTRACT_CONTEXT & Ctx, LPCSTR szMask, LPCTSTR szListFile)
+{
+    PCASC_CKEY_ENTRY pCKeyEntry;
+    CASC_EXTRACT_ITEM * pItem;
+    CASC_FIND_DATA cf;
+    TCascSearch * pSearch;
+    TCascStorage * hs = Ctx.hs;
+    HANDLE hFind;
+    size_t nLength;
+    char szSafeName[MAX_PATH];
+    char * szName;
+    bool bFileFound = true;
+
+    if((hFind = CascFindFirstFile((HANDLE)hs, szMask, &cf, szListFile)) == INVALID_HANDLE_VALUE)
+        return (GetCascError() == ERROR_NO_MORE_FILES) ? ERROR_SUCCESS : GetCascError();
+    pSearch = TCascSearch::IsValid(hFind);
+
+    while(bFileFound)
+    {
+        Ctx.pResult->FileCount++;
+
+        // Use the entry given by the root handler. Looking it up by the key would give
+        // the global entry of the first span, which is not followed by the other spans.
+        // Files of local storages must be present in the data files
+        pCKeyEntry = pSearch->pFoundEntry;
+        if(pCKeyEntry == NULL || (!(pCKeyEntry->Flags & CASC_CE_FILE_IS_LOCAL) && !(hs->dwFeatures & CASC_FEATURE_ONLINE)))
+        {
+            Ctx.pResult->FilesSkipped++;
+            bFileFound = CascFindNextFile(hFind, &cf);
+            continue;
+        }
+
+        // Remember the file and the name it will have in the target directory
+        nLength = GetSafeName(cf.szFileName, szSafeName, _countof(szSafeName)) + 1;
+        if((pItem = (CASC_EXTRACT_ITEM *)Ctx.Items.Insert(1)) == NULL || (szName = (char *)Ctx.Names.Insert(nLength)) == NULL)
+        {
+            CascFindClose(hFind);
+            return ERROR_NOT_ENOUGH_MEMORY;
+        }
+        memcpy(szName, szSafeName, nLength);
+        pItem->pCKeyEntry = pCKeyEntry;
+        pItem->StorageOffset = pCKeyEntry->StorageOffset;
+        pItem->nNameOffset = Ctx.Names.IndexOf(szName);
+        pItem->nFindIndex = Ctx.Items.ItemCount() - 1;
+        pItem->bDuplicate = false;
+
+        bFileFound = CascFindNextFile(hFind, &cf);
+    }
+
+    CascFindClose(hFind);
+    return ERROR_SUCCESS;
+}
+
+// Marks the files whose target names were already found. Some storages have several
+// files with the same name, e.g. for different locales, and different names can give
+// the same safe name. Only the first found file of each target name is extracted
+static DWORD MarkDuplicateNames(CASC_EXTRACT_CONTEXT & Ctx)
+{
+    CASC_EXTRACT_ITEM * pItems = (CASC_EXTRACT_ITEM *)Ctx.Items.ItemArray();
+    const char ** NamePtrs;
+    const char * szNames = (const char *)Ctx.Names.ItemArray();
+    size_t nItemCount = Ctx.Items.ItemCount();
+    size_t nNameIndex = 0;
+
+    Ctx.nItemCount = nItemCount;
+    if(nItemCount < 2)
+        return ERROR_SUCCESS;
+    if((NamePtrs = CASC_ALLOC<const char *>(nItemCount)) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    // Sort the names. The first found file of each name is the first one after sorting
+    for(size_t i = 0; i < nItemCount; i++)
+        NamePtrs[i] = szNames + pItems[i].nNameOffset;
+    qsort(NamePtrs, nItemCount, sizeof(const char *), CompareItemsByName);
+
+    // The name offsets grow with the item index, so the item of a name
+    // is found by binary search
+    for(size_t i = 1; i < nItemCount; i++)
+    {
+        if(_stricmp(NamePtrs[nNameIndex], NamePtrs[i]))
+        {
+            nNameIndex = i;
+            continue;
+        }
+
+        for(size_t nLow = 0, nHigh = nItemCount, nNameOffset = (size_t)(NamePtrs[i] - szNames); nLow < nHigh; )
+        {
+            size_t nMid = (nLow + nHigh) / 2;
+
+            if(pItems[nMid].nNameOffset == nNameOffset)
+            {
+                pItems[nMid].bDuplicate = true;
+                Ctx.nItemCount--;
+                break;
+            }
+
+            if(pItems[nMid].nNameOffset < nNameOffset)
+                nLow = nMid + 1;
+            else
+                nHigh = nMid;
+        }
+    }
+
+    Ctx.pResult->FilesSkipped += (nItemCount - Ctx.nItemCount);
+    CASC_FREE(NamePtrs);
+    return ERROR_SUCCESS;
+}
+
+// Sorts the files by their position in the storage and splits them to work items.
+// Files with the same content follow each other and stay in the same work item
+static DWORD PrepareWorkItems(CASC_EXTRACT_CONTEXT & Ctx)
+{
+    CASC_EXTRACT_ITEM * pItems = (CASC_EXTRACT_ITEM *)Ctx.Items.ItemArray();
+    CASC_EXTRACT_CHUNK * pChunk = NULL;
+    ULONGLONG ChunkBytes = 0;
+
+    qsort(pItems, Ctx.Items.ItemCount(), sizeof(CASC_EXTRACT_ITEM), CompareItemsByOffset);
+
+    for(size_t i = 0; i < Ctx.nItemCount; i++)
+    {
+        // Start a new work item if needed, but only with a new content
+        if(i == 0 || pItems[i].pCKeyEntry != pItems[i - 1].pCKeyEntry)
+        {
+            if(pChunk == NULL || pChunk->nItemCount >= CASC_EXTRACT_CHUNK_FILES || ChunkBytes >= CASC_EXTRACT_CHUNK_BYTES)
+            {
+                if((pChunk = (CASC_EXTRACT_CHUNK *)Ctx.Chunks.Insert(1)) == NULL)
+                    return ERROR_NOT_ENOUGH_MEMORY;
+                pChunk->nFirstItem = i;
+                pChunk->nItemCount = 0;
+                ChunkBytes = 0;
+            }
+
+            if(pItems[i].pCKeyEntry->ContentSize != CASC_INVALID_SIZE)
+                ChunkBytes += pItems[i].pCKeyEntry->ContentSize;
+        }
+        pChunk->nItemCount++;
+    }
+
+    return ERROR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// Local functions - extraction
+
+static void AddFailure(CASC_EXTRACT_WORKER & Worker, DWORD dwErrCode)
+{
+    if(dwErrCode == ERROR_FILE_ENCRYPTED)
+    {
+        Worker.FilesEncrypted++;
+    }
+    else
+    {
+        if(Worker.dwErrCode == ERROR_SUCCESS)
+            Worker.dwErrCode = dwErrCode;
+        Worker.FilesFailed++;
+    }
+}
+
+// Reads one file and writes it to the target directory. Returns the error code
+// of the file; only failure to allocate memory stops the extraction
+static DWORD ExtractItem(CASC_EXTRACT_CONTEXT & Ctx, CASC_EXTRACT_WORKER & Worker, CASC_EXTRACT_ITEM * pItem, LPCTSTR szTargetPath)
+{
+    PCASC_CKEY_ENTRY pCKeyEntry = pItem->pCKeyEntry;
+    CASC_OUTPUT_FILE Output = {CASC_INVALID_OUTPUT, 0, false};
+    ULONGLONG FileSize = 0;
+    ULONGLONG ByteOffset = 0;
+    MD5_CTX md5_ctx;
+    HANDLE hFile = NULL;
+    BYTE md5_digest[MD5_HASH_SIZE];
+    DWORD dwErrCode = ERROR_SUCCESS;
+    bool bWriteFile = (Ctx.dwFlags & CASC_EXTRACT_NO_WRITE) ? false : true;
+    bool bVerify = (Ctx.dwFlags & CASC_EXTRACT_VERIFY) && (pCKeyEntry->Flags & CASC_CE_HAS_CKEY) && (pCKeyEntry->SpanCount <= 1);
+
+    // Open the file
+    if(!OpenFileByCKeyEntry(Ctx.hs, pCKeyEntry, 0, &hFile) || !CascGetFileSize64(hFile, &FileSize))
+        dwErrCode = GetCascError();
+
+    // Create the target file
+    if(dwErrCode == ERROR_SUCCESS && bWriteFile)
+        dwErrCode = CreateOutputFile(Output, szTargetPath, FileSize, (Ctx.dwFlags & CASC_EXTRACT_DIRECT_IO) ? true : false);
+    MD5_Init(&md5_ctx);
+
+    // Copy the data in large blocks
+    while(dwErrCode == ERROR_SUCCESS && ByteOffset < FileSize)
+    {
+        DWORD dwBytesToRead = (DWORD)CASCLIB_MIN(FileSize - ByteOffset, CASC_EXTRACT_BUFFER_SIZE);
+        DWORD dwBytesRead = 0;
+
+        if(!CascReadFile(hFile, Worker.pbBuffer, dwBytesToRead, &dwBytesRead) || dwBytesRead != dwBytesToRead)
+        {
+            dwErrCode = (GetCascError() != ERROR_SUCCESS) ? GetCascError() : ERROR_FILE_CORRUPT;
+            break;
+        }
+
+        if(bVerify)
+            MD5_Update(&md5_ctx, Worker.pbBuffer, dwBytesRead);
+        if(bWriteFile)
+            dwErrCode = WriteOutputFile(Output, Worker.pbBuffer, dwBytesRead);
+        ByteOffset += dwBytesRead;
+    }
+
+    // Verify the content key
+    if(dwErrCode == ERROR_SUCCESS && bVerify)
+    {
+        MD5_Final(md5_digest, &md5_ctx);
+        if(memcmp(md5_digest, pCKeyEntry->CKey, MD5_HASH_SIZE))
+            dwErrCode = ERROR_FILE_CORRUPT;
+    }
+
+    // Close the target file. Don't leave incomplete files in the target directory
+    if(Output.hFile != CASC_INVALID_OUTPUT)
+    {
+        DWORD dwCloseError = CloseOutputFile(Output);
+
+        if(dwErrCode == ERROR_SUCCESS)
+            dwErrCode = dwCloseError;
+        if(dwErrCode != ERROR_SUCCESS)
+            _tremove(szTargetPath);
+    }
+
+    if(hFile != NULL)
+        CascCloseFile(hFile);
+
+    // Update the counters
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        Worker.ContentBytes += ByteOffset;
+        Worker.BytesWritten += (bWriteFile) ? ByteOffset : 0;
+        Worker.FilesExtracted++;
+    }
+    else
+    {
+        AddFailure(Worker, dwErrCode);
+    }
+    return dwErrCode;
+}
+
+// Reports the progress. Returns true if the caller wants to cancel the extraction
+static bool AddProgress(CASC_EXTRACT_CONTEXT & Ctx, CASC_EXTRACT_WORKER & Worker)
+{
+    PCASC_EXTRACT_RESULT pResult = Ctx.pResult;
+    ULONGLONG CurrentTime;
+    bool bCancelled;
+
+    CascLock(Ctx.Lock);
+
+    // Add the counters of the work item
+    pResult->ContentBytes += Worker.ContentBytes;
+    pResult->BytesWritten += Worker.BytesWritten;
+    pResult->FilesExtracted += Worker.FilesExtracted;
+    pResult->FilesLinked += Worker.FilesLinked;
+    pResult->FilesEncrypted += Worker.FilesEncrypted;
+    pResult->FilesFailed += Worker.FilesFailed;
+    if(Ctx.dwErrCode == ERROR_SUCCESS)
+        Ctx.dwErrCode = Worker.dwErrCode;
+
+    // Update the throughput
+    CurrentTime = CascPerfGetTime();
+    pResult->ElapsedMs = (CurrentTime - Ctx.StartTime) / 1000;
+    pResult->BytesPerSecond = (pResult->ContentBytes * 1000) / CASCLIB_MAX(pResult->ElapsedMs, 1);
+
+    // Call the callback not more often than each CASC_EXTRACT_PROGRESS_TIME.
+    // The lock is held, so the callback is never called concurrently
+    if(Ctx.PfnExtractCallback != NULL && Ctx.bCancelled == false)
+    {
+        if((CurrentTime - Ctx.LastProgressTime) >= CASC_EXTRACT_PROGRESS_TIME)
+        {
+            Ctx.bCancelled = Ctx.PfnExtractCallback(Ctx.PtrExtractParam, pResult);
+            Ctx.LastProgressTime = CurrentTime;
+        }
+    }
+    bCancelled = Ctx.bCancelled;
+
+    CascUnlock(Ctx.Lock);
+    return bCancelled;
+}
+
+static DWORD ExtractWorker(void * pvContext, size_t nItemIndex)
+{
+    CASC_EXTRACT_CONTEXT & Ctx = *(CASC_EXTRACT_CONTEXT *)pvContext;
+    CASC_EXTRACT_CHUNK * pChunk = (CASC_EXTRACT_CHUNK *)Ctx.Chunks.ItemAt(nItemIndex);
+    CASC_EXTRACT_ITEM * pItems = (CASC_EXTRACT_ITEM *)Ctx.Items.ItemArray() + pChunk->nFirstItem;
+    CASC_EXTRACT_WORKER Worker;
+    const char * szNames = (const char *)Ctx.Names.ItemArray();
+    TCHAR szSourcePath[MAX_PATH];
+    TCHAR szTargetPath[MAX_PATH];
+    DWORD dwErrCode = ERROR_SUCCESS;
+    bool bCancelled;
+
+    // Don't start new work after the extraction was cancelled
+    CascLock(Ctx.Lock);
+    bCancelled = Ctx.bCancelled;
+    CascUnlock(Ctx.Lock);
+    if(bCancelled)
+        return ERROR_CANCELLED;
+
+    // The buffer is aligned for unbuffered I/O
+    memset(&Worker, 0, sizeof(CASC_EXTRACT_WORKER));
+    if((Worker.pbBuffer = AllocAlignedBuffer(CASC_EXTRACT_BUFFER_SIZE)) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    for(size_t i = 0; i < pChunk->nItemCount && dwErrCode != ERROR_NOT_ENOUGH_MEMORY; )
+    {
+        CASC_EXTRACT_ITEM * pSource = &pItems[i];
+        DWORD dwSourceError;
+
+        // The first file of each content is extracted
+        GetTargetPath(Ctx, szNames + pSource->nNameOffset, szSourcePath, _countof(szSourcePath));
+        dwErrCode = dwSourceError = ExtractItem(Ctx, Worker, pSource, szSourcePath);
+
+        // The other files with the same content are hard links to it
+        for(i++; i < pChunk->nItemCount && pItems[i].pCKeyEntry == pSource->pCKeyEntry; i++)
+        {
+            // If the file failed, the other ones fail the same way
+            if(dwSourceError != ERROR_SUCCESS)
+            {
+                AddFailure(Worker, dwSourceError);
+                continue;
+            }
+
+            // If nothing is written, there is no need to read the same content again
+            if(Ctx.dwFlags & CASC_EXTRACT_NO_WRITE)
+            {
+                Worker.FilesLinked++;
+                continue;
+            }
+
+            // Copy the file if the hard link can't be created (e.g. not supported by the file system)
+            GetTargetPath(Ctx, szNames + pItems[i].nNameOffset, szTargetPath, _countof(szTargetPath));
+            if(!(Ctx.dwFlags & CASC_EXTRACT_NO_HARDLINKS) && LinkOutputFile(szSourcePath, szTargetPath))
+                Worker.FilesLinked++;
+            else
+                dwErrCode = ExtractItem(Ctx, Worker, &pItems[i], szTargetPath);
+        }
+    }
+
+    // Only failure to allocate memory stops the extraction
+    dwErrCode = (dwErrCode == ERROR_NOT_ENOUGH_MEMORY) ? dwErrCode : ERROR_SUCCESS;
+
+    // Merge the counters and report the progress
+    if(AddProgress(Ctx, Worker) && dwErrCode == ERROR_SUCCESS)
+        dwErrCode = ERROR_CANCELLED;
+
+    FreeAlignedBuffer(Worker.pbBuffer);
+    return dwErrCode;
+}
+
+static DWORD ExtractFiles(CASC_EXTRACT_CONTEXT & Ctx, LPCSTR szMask, LPCTSTR szListFile, DWORD dwThreadCount)
+{
+    TCascStorage * hs = Ctx.hs;
+    DWORD dwErrCode;
+
+    // Find the files and prepare the work items
+    if((dwErrCode = Ctx.Items.Create<CASC_EXTRACT_ITEM>(0x10000)) != ERROR_SUCCESS)
+        return dwErrCode;
+    if((dwErrCode = Ctx.Names.Create<char>(0x100000)) != ERROR_SUCCESS)
+        return dwErrCode;
+    if((dwErrCode = FindFilesToExtract(Ctx, szMask, szListFile)) != ERROR_SUCCESS)
+        return dwErrCode;
+    if((dwErrCode = MarkDuplicateNames(Ctx)) != ERROR_SUCCESS)
+        return dwErrCode;
+    if((dwErrCode = Ctx.Chunks.Create<CASC_EXTRACT_CHUNK>((Ctx.nItemCount / CASC_EXTRACT_CHUNK_FILES) + 0x10)) != ERROR_SUCCESS)
+        return dwErrCode;
+    if((dwErrCode = PrepareWorkItems(Ctx)) != ERROR_SUCCESS)
+        return dwErrCode;
+
+    // Online storages download missing files on demand, which must not be done in parallel
+    dwThreadCount = (dwThreadCount != 0) ? dwThreadCount : CascGetProcessorCount();
+    dwThreadCount = (hs->dwFeatures & CASC_FEATURE_ONLINE) ? 1 : dwThreadCount;
+    dwThreadCount = (DWORD)CASCLIB_MIN(CASCLIB_MIN(dwThreadCount, CASC_MAX_WORKER_THREADS), CASCLIB_MAX(Ctx.Chunks.ItemCount(), 1));
+    Ctx.pResult->dwThreadCount = dwThreadCount;
+
+    // Extract the files over the pool of threads
+    return CascRunWorkers(ExtractWorker, &Ctx, Ctx.Chunks.ItemCount(), dwThreadCount);
+}
+
+//-----------------------------------------------------------------------------
+// Public functions
+
+bool WINAPI CascExtractFiles(HANDLE hStorage, LPCSTR szMask, LPCTSTR szTargetDir, PCASC_EXTRACT_ARGS pArgs, PCASC_EXTRACT_RESULT pResult)
+{
+    CASC_EXTRACT_CONTEXT Ctx;
+    TCascStorage * hs;
+    LPCTSTR szListFile = NULL;
+    DWORD dwThreadCount = 0;
+    DWORD dwErrCode;
+
+    // Validate the storage handle
+    hs = TCascStorage::IsValid(hStorage);
+    if(hs == NULL)
+    {
+        SetCascError(ERROR_INVALID_HANDLE);
+        return false;
+    }
+
+    // Prepare the context. All arguments are optional
+    Ctx.hs = hs;
+    Ctx.szTargetDir = szTargetDir;
+    Ctx.pResult = pResult;
+    Ctx.PfnExtractCallback = NULL;
+    Ctx.PtrExtractParam = NULL;
+    Ctx.dwFlags = 0;
+    Ctx.StartTime = CascPerfGetTime();
+    Ctx.LastProgressTime = Ctx.StartTime;
+    Ctx.dwErrCode = ERROR_SUCCESS;
+    Ctx.bCancelled = false;
+    ExtractVersionedArgument(pArgs, offsetof(CASC_EXTRACT_ARGS, dwFlags), &Ctx.dwFlags);
+    ExtractVersionedArgument(pArgs, offsetof(CASC_EXTRACT_ARGS, dwThreadCount), &dwThreadCount);
+    ExtractVersionedArgument(pArgs, offsetof(CASC_EXTRACT_ARGS, szListFile), &szListFile);
+    ExtractVersionedArgument(pArgs, offsetof(CASC_EXTRACT_ARGS, PfnExtractCallback), &Ctx.PfnExtractCallback);
+    ExtractVersionedArgument(pArgs, offsetof(CASC_EXTRACT_ARGS, PtrExtractParam), &Ctx.PtrExtractParam);
+
+    // Validate the other parameters
+    if(pResult == NULL || szMask == NULL || (szTargetDir == NULL && !(Ctx.dwFlags & CASC_EXTRACT_NO_WRITE)))
+    {
+        SetCascError(ERROR_INVALID_PARAMETER);
+        return false;
+    }
+    memset(pResult, 0, sizeof(CASC_EXTRACT_RESULT));
+    CascInitLock(Ctx.Lock);
+
+    // Perform the extraction
+    dwErrCode = ExtractFiles(Ctx, szMask, szListFile, dwThreadCount);
+
+    // Calculate the throughput
+    pResult->ElapsedMs = (CascPerfGetTime() - Ctx.StartTime) / 1000;
+    pResult->BytesPerSecond = (pResult->ContentBytes * 1000) / CASCLIB_MAX(pResult->ElapsedMs, 1);
+
+    // Free the context
+    CascFreeLock(Ctx.Lock);
+    Ctx.Chunks.Free();
+    Ctx.Names.Free();
+    Ctx.Items.Free();
+
+    // The files that could not be extracted are reported by the error code of the first one.
+    // Encrypted files are not an error, they are just counted
+    if(dwErrCode == ERROR_SUCCESS)
+        dwErrCode = Ctx.dwErrCode;
+    if(dwErrCode != ERROR_SUCCESS)
+        SetCascError(dwErrCode);
+    return (dwErrCode == ERROR_SUCCESS);
+}
@@ -997,7 +997,7 @@ static void CreateRemoteAndLocalPath(TCascStorage * hs, CASC_CDN_DOWNLOAD & Cdns
     LocalPath.AppendString(CdnsInfo.szExtension, false);
 }
 
-static DWORD ForcePathExist(LPCTSTR szFileName, bool bIsFileName)
+DWORD ForcePathExist(LPCTSTR szFileName, bool bIsFileName)
 {
     LPTSTR szLocalPath;
     size_t nIndex;
@@ -1028,8 +1028,8 @@ static DWORD ForcePathExist(LPCTSTR szFileName, bool bIsFileName)
                         // Skip the very first separator
                         if(bFirstSeparator == true)
                         {
-                            // Is it there?
-                            if(DirectoryExists(szLocalPath) == false && MakeDirectory(szLocalPath) == false)
+                            // Is it there? Another thread may have created it in the meantime
+                            if(DirectoryExists(szLocalPath) == false && MakeDirectory(szLocalPath) == false && DirectoryExists(szLocalPath) == false)
                             {
                                 dwErrCode = ERROR_PATH_NOT_FOUND;
                                 break;
@@ -1077,11 +1077,13 @@ static bool FileAlreadyExists(LPCTSTR szFileName)
 }
 
 static DWORD DownloadFile(
+    TCascStorage * hs,
     LPCTSTR szRemoteName,
     LPCTSTR szLocalName,
     PULONGLONG PtrByteOffset,
     DWORD cbReadSize,
-    DWORD dwPortFlags)
+    DWORD dwPortFlags,
+    PDWORD PtrBytesWritten = NULL)
 {
     TFileStream * pRemStream;
     TFileStream * pLocStream;
@@ -1115,7 +1117,12 @@ static DWORD DownloadFile(
                 if(pLocStream != NULL)
                 {
                     if(FileStream_Write(pLocStream, NULL, pbFileData, cbReadSize))
+                    {
+                        CASC_PERF_ADD(hs, CdnBytesDownloaded, cbReadSize);
+                        if(PtrBytesWritten != NULL)
+                            PtrBytesWritten[0] = cbReadSize;
                         dwErrCode = ERROR_SUCCESS;
+                    }
 
                     FileStream_Close(pLocStream);
                 }
@@ -1193,6 +1200,45 @@ static DWORD RibbitDownloadFile(LPCTSTR szCdnHostUrl, LPCTSTR szProduct, LPCTSTR
     return dwErrCode;
 }
 
+// Downloads a data file to the CDN cache. Files from archives are downloaded
+// alone, by a range request, so the cached file is always the file itself
+static DWORD DownloadFileToCache(TCascStorage * hs, CASC_CDN_DOWNLOAD & CdnsInfo, LPCTSTR szRemotePath)
+{
+    ULONGLONG ByteOffset = CdnsInfo.ArchiveOffs;
+    TCHAR szTempPath[MAX_PATH];
+    DWORD cbFileSize = 0;
+    DWORD dwErrCode;
+
+    // Download the file to a temporary name
+    hs->CdnCache.GetTempPath(CdnsInfo.pbEKey, szTempPath, _countof(szTempPath));
+    if((dwErrCode = ForcePathExist(szTempPath, true)) != ERROR_SUCCESS)
+        return dwErrCode;
+
+    ULONGLONG StartTime = CASC_PERF_START(hs);
+    if(CdnsInfo.pbArchiveKey != NULL)
+        dwErrCode = DownloadFile(hs, szRemotePath, szTempPath, &ByteOffset, CdnsInfo.EncodedSize, 0, &cbFileSize);
+    else
+        dwErrCode = DownloadFile(hs, szRemotePath, szTempPath, NULL, 0, 0, &cbFileSize);
+    CASC_PERF_STOP(hs, CdnDownloadTime, StartTime);
+    CASC_PERF_ADD(hs, CdnDownloadCount, 1);
+
+    // Move the file to the cache
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        if((dwErrCode = hs->CdnCache.Insert(CdnsInfo.pbEKey, szTempPath, cbFileSize, CdnsInfo.szLocalPath, CdnsInfo.ccLocalPath)) == ERROR_SUCCESS)
+        {
+            CdnsInfo.pbArchiveKey = NULL;
+            CdnsInfo.ArchiveOffs = 0;
+        }
+    }
+    else
+    {
+        _tremove(szTempPath);
+    }
+
+    return dwErrCode;
+}
+
 static DWORD DownloadFileFromCDN2(TCascStorage * hs, CASC_CDN_DOWNLOAD & CdnsInfo)
 {
     CASC_PATH<TCHAR> RemotePath(URL_SEP_CHAR);
@@ -1203,6 +1249,13 @@ static DWORD DownloadFileFromCDN2(TCascStorage * hs, CASC_CDN_DOWNLOAD & CdnsInf
     assert(CdnsInfo.szCdnsHost != NULL && CdnsInfo.szCdnsHost[0] != 0);
     CreateRemoteAndLocalPath(hs, CdnsInfo, RemotePath, LocalPath);
 
+    // Data files go to the CDN cache, if there is one
+    if((CdnsInfo.Flags & CASC_CDN_USE_CACHE) && hs->CdnCache.IsEnabled())
+    {
+        assert(CdnsInfo.pbEKey != NULL && CdnsInfo.szLocalPath != NULL);
+        return DownloadFileToCache(hs, CdnsInfo, RemotePath);
+    }
+
     // Check whether the local file exists
     if((CdnsInfo.Flags & CASC_CDN_FORCE_DOWNLOAD) || !FileAlreadyExists(LocalPath))
     {
@@ -1212,7 +1265,10 @@ static DWORD DownloadFileFromCDN2(TCascStorage * hs, CASC_CDN_DOWNLOAD & CdnsInf
             return dwErrCode;
 
         // Attempt to download the file
-        dwErrCode = DownloadFile(RemotePath, LocalPath, NULL, 0, 0);
+        ULONGLONG StartTime = CASC_PERF_START(hs);
+        dwErrCode = DownloadFile(hs, RemotePath, LocalPath, NULL, 0, 0);
+        CASC_PERF_STOP(hs, CdnDownloadTime, StartTime);
+        CASC_PERF_ADD(hs, CdnDownloadCount, 1);
         if(dwErrCode != ERROR_SUCCESS)
             return dwErrCode;
     }
@@ -1228,17 +1284,26 @@ DWORD DownloadFileFromCDN(TCascStorage * hs, CASC_CDN_DOWNLOAD & CdnsInfo)
     TCHAR szCdnHost[MAX_PATH] = _T("");
     DWORD dwErrCode = ERROR_CAN_NOT_COMPLETE;
 
+    // The CDN cache is checked before any network request
+    if((CdnsInfo.Flags & CASC_CDN_USE_CACHE) && !(CdnsInfo.Flags & CASC_CDN_FORCE_DOWNLOAD))
+    {
+        if(hs->CdnCache.Lookup(CdnsInfo.pbEKey, CdnsInfo.szLocalPath, CdnsInfo.ccLocalPath))
+            return ERROR_SUCCESS;
+    }
+
     // If we have a given CDN server, use it. If not, try all CDNs
     // from the storage's configuration
     if(CdnsInfo.szCdnsHost == NULL)
     {
-        // Try all download servers
+        // Try all download servers. The host name is a local buffer,
+        // so it must not stay in the structure after we return
         while((szCdnServers = ExtractCdnServerName(szCdnHost, _countof(szCdnHost), szCdnServers)) != NULL)
         {
             CdnsInfo.szCdnsHost = szCdnHost;
             if((dwErrCode = DownloadFileFromCDN2(hs, CdnsInfo)) == ERROR_SUCCESS)
-                return ERROR_SUCCESS;
+                break;
         }
+        CdnsInfo.szCdnsHost = NULL;
     }
     else
     {
@@ -1296,7 +1361,7 @@ static DWORD FetchAndLoadConfigFile(TCascStorage * hs, PQUERY_KEY pFileKey, PARS
         {
             dwErrCode = ERROR_FILE_CORRUPT;
         }
-        CASC_FREE(pvListFile);
+        ListFile_Free(pvListFile);
     }
     else
     {
@@ -62,11 +62,14 @@ static void SupplyFakeFileName(PCASC_FIND_DATA pFindData, PCASC_CKEY_ENTRY pCKey
     assert(false);
 }
 
-static bool CopyCKeyEntryToFindData(PCASC_FIND_DATA pFindData, PCASC_CKEY_ENTRY pCKeyEntry)
+static bool CopyCKeyEntryToFindData(TCascSearch * pSearch, PCASC_FIND_DATA pFindData, PCASC_CKEY_ENTRY pCKeyEntry)
 {
     ULONGLONG ContentSize = 0;
     ULONGLONG EncodedSize = 0;
 
+    // Remember the entry. For multi-span files, it's the first one of the span entries
+    pSearch->pFoundEntry = pCKeyEntry;
+
     // Supply both keys
     CopyMemory16(pFindData->CKey, pCKeyEntry->CKey);
     CopyMemory16(pFindData->EKey, pCKeyEntry->EKey);
@@ -94,7 +97,16 @@ static bool CopyCKeyEntryToFindData(PCASC_FIND_DATA pFindData, PCASC_CKEY_ENTRY
 
     // Supply a fake file name, if there is none supplied by the root handler
     if(pFindData->szFileName[0] == 0)
+    {
+        // If the caller didn't want names, don't bother with making one
+        if(pSearch->bNoFileNames)
+        {
+            pFindData->NameType = CascNameNone;
+            return true;
+        }
+
         SupplyFakeFileName(pFindData, pCKeyEntry);
+    }
     return true;
 }
 
@@ -117,10 +129,10 @@ static bool DoStorageSearch_RootFile(TCascSearch * pSearch, PCASC_FIND_DATA pFin
             return false;
 
         // The entry is expected to be referenced by the root directory
-        assert(pCKeyEntry->RefCount != 0);
+        assert(hs->CKeyRefs.RefCount(pCKeyEntry) != 0);
 
         // Copy the CKey entry to the find data and return it
-        return CopyCKeyEntryToFindData(pFindData, pCKeyEntry);
+        return CopyCKeyEntryToFindData(pSearch, pFindData, pCKeyEntry);
     }
 }
 
@@ -141,9 +153,9 @@ static bool DoStorageSearch_CKey(TCascSearch * pSearch, PCASC_FIND_DATA pFindDat
         //BREAK_ON_XKEY3(pCKeyEntry->CKey, 0x2B, 0xfc, 0xe4);
 
         // Only report files that are unreferenced by the ROOT handler
-        if(pCKeyEntry->IsFile() && pCKeyEntry->RefCount == 0)
+        if(hs->CKeyRefs.IsFile(pCKeyEntry) && hs->CKeyRefs.RefCount(pCKeyEntry) == 0)
         {
-            return CopyCKeyEntryToFindData(pFindData, pCKeyEntry);
+            return CopyCKeyEntryToFindData(pSearch, pFindData, pCKeyEntry);
         }
     }
 
@@ -151,8 +163,34 @@ static bool DoStorageSearch_CKey(TCascSearch * pSearch, PCASC_FIND_DATA pFindDat
     return false;
 }
 
+static bool DoStorageSearch_Tags(TCascSearch * pSearch, PCASC_FIND_DATA pFindData)
+{
+    PCASC_CKEY_ENTRY pCKeyEntry;
+    TCascStorage * hs = pSearch->hs;
+    DWORD dwItemIndex;
+
+    // Reset the find data structure
+    ResetFindData(pFindData);
+
+    // Only the matching entries are visited
+    while(pSearch->pTagMatches->Next(pSearch->TagIterator, dwItemIndex))
+    {
+        pCKeyEntry = (PCASC_CKEY_ENTRY)hs->CKeyArray.ItemAt(dwItemIndex);
+        if(pCKeyEntry != NULL && hs->CKeyRefs.IsFile(pCKeyEntry))
+        {
+            return CopyCKeyEntryToFindData(pSearch, pFindData, pCKeyEntry);
+        }
+    }
+
+    return false;
+}
+
 static bool DoStorageSearch(TCascSearch * pSearch, PCASC_FIND_DATA pFindData)
 {
+    // Tag queries only enumerate the matching CKey entries
+    if(pSearch->pTagMatches != NULL)
+        return DoStorageSearch_Tags(pSearch, pFindData);
+
     // State 0: No search done yet
     if(pSearch->nSearchState == 0)
     {
@@ -177,7 +215,7 @@ static bool DoStorageSearch(TCascSearch * pSearch, PCASC_FIND_DATA pFindData)
     }
 
     // State 2: Searching the remaining entries by CKey
-    if(pSearch->nSearchState == 2 && (pSearch->szMask == NULL || !strcmp(pSearch->szMask, "*")))
+    if(pSearch->nSearchState == 2 && pSearch->Mask.IsMatchAll())
     {
         if(DoStorageSearch_CKey(pSearch, pFindData))
             return true;
@@ -190,6 +228,154 @@ static bool DoStorageSearch(TCascSearch * pSearch, PCASC_FIND_DATA pFindData)
     return false;
 }
 
+//-----------------------------------------------------------------------------
+// Tag queries. The query is a boolean expression of tag names:
+//
+//   Expr   := Term   { '|' Term }
+//   Term   := Factor { '&' Factor }
+//   Factor := '!' Factor | '(' Expr ')' | TagName
+//
+// Example: "Windows & x86_64 & (enUS | !SpeechLang)"
+// A term is evaluated as AND of its positive factors minus the OR of its negated factors,
+// so a negation never needs the complement of a tag. A term with no positive factor starts
+// with all files listed in the DOWNLOAD/INSTALL manifests.
+
+static DWORD ParseTagExpr(TCascStorage * hs, const char *& szQuery, CASC_BITSET & Result);
+
+static const char * SkipSpaces(const char * szQuery)
+{
+    while(szQuery[0] == ' ' || szQuery[0] == '\t')
+        szQuery++;
+    return szQuery;
+}
+
+static DWORD ParseTagName(TCascStorage * hs, const char *& szQuery, CASC_BITSET & Result)
+{
+    PCASC_TAG_ENTRY2 pTag;
+    const char * szTagName = szQuery;
+    size_t nLength;
+
+    // Tag names end with a space or an operator
+    while(szQuery[0] != 0 && strchr(" \t&|!()", szQuery[0]) == NULL)
+        szQuery++;
+    if((nLength = (szQuery - szTagName)) == 0)
+        return ERROR_INVALID_PARAMETER;
+
+    // Find the tag. The names are not case sensitive
+    for(size_t i = 0; i < hs->TagsArray.ItemCount(); i++)
+    {
+        pTag = (PCASC_TAG_ENTRY2)hs->TagsArray.ItemAt(i);
+        if(pTag->NameLength == nLength && !_strnicmp(pTag->szTagName, szTagName, nLength))
+        {
+            Result.Free();
+            return (pTag->pFileBits != NULL) ? Result.CopyFrom(pTag->pFileBits[0]) : ERROR_SUCCESS;
+        }
+    }
+
+    return ERROR_INVALID_PARAMETER;
+}
+
+static DWORD ParseTagFactor(TCascStorage * hs, const char *& szQuery, CASC_BITSET & Result, bool & bNegated)
+{
+    DWORD dwErrCode;
+
+    szQuery = SkipSpaces(szQuery);
+    switch(szQuery[0])
+    {
+        case '!':
+            szQuery++;
+            dwErrCode = ParseTagFactor(hs, szQuery, Result, bNegated);
+            bNegated = !bNegated;
+            return dwErrCode;
+
+        case '(':
+            szQuery++;
+            bNegated = false;
+            if((dwErrCode = ParseTagExpr(hs, szQuery, Result)) != ERROR_SUCCESS)
+                return dwErrCode;
+            szQuery = SkipSpaces(szQuery);
+            if(szQuery[0] != ')')
+                return ERROR_INVALID_PARAMETER;
+            szQuery++;
+            return ERROR_SUCCESS;
+
+        default:
+            bNegated = false;
+            return ParseTagName(hs, szQuery, Result);
+    }
+}
+
+static DWORD ParseTagTerm(TCascStorage * hs, const char *& szQuery, CASC_BITSET & Result)
+{
+    CASC_BITSET Negative;
+    CASC_BITSET Factor;
+    bool bHasPositive = false;
+    bool bNegated = false;
+    DWORD dwErrCode;
+
+    for(;;)
+    {
+        // Parse the factor
+        if((dwErrCode = ParseTagFactor(hs, szQuery, Factor, bNegated)) != ERROR_SUCCESS)
+            return dwErrCode;
+
+        // Merge the factor to the positive or negative set
+        if(bNegated)
+            dwErrCode = Negative.Or(Factor);
+        else if(bHasPositive)
+            dwErrCode = Result.And(Factor);
+        else
+            dwErrCode = Result.CopyFrom(Factor);
+        if(dwErrCode != ERROR_SUCCESS)
+            return dwErrCode;
+        bHasPositive = bHasPositive || !bNegated;
+
+        // Is there another factor?
+        szQuery = SkipSpaces(szQuery);
+        if(szQuery[0] != '&')
+            break;
+        szQuery++;
+    }
+
+    // If there was no positive factor, the negated tags are removed from all tagged files
+    if(bHasPositive == false && (dwErrCode = Result.CopyFrom(hs->TaggedFiles)) != ERROR_SUCCESS)
+        return dwErrCode;
+    return Result.AndNot(Negative);
+}
+
+static DWORD ParseTagExpr(TCascStorage * hs, const char *& szQuery, CASC_BITSET & Result)
+{
+    CASC_BITSET Term;
+    DWORD dwErrCode;
+
+    // Parse the first term
+    if((dwErrCode = ParseTagTerm(hs, szQuery, Result)) != ERROR_SUCCESS)
+        return dwErrCode;
+
+    // Merge the other terms
+    while((szQuery = SkipSpaces(szQuery))[0] == '|')
+    {
+        szQuery++;
+        if((dwErrCode = ParseTagTerm(hs, szQuery, Term)) != ERROR_SUCCESS)
+            return dwErrCode;
+        if((dwErrCode = Result.Or(Term)) != ERROR_SUCCESS)
+            return dwErrCode;
+    }
+
+    return ERROR_SUCCESS;
+}
+
+static DWORD EvaluateTagQuery(TCascStorage * hs, const char * szQuery, CASC_BITSET & Result)
+{
+    DWORD dwErrCode;
+
+    // The whole query must be parsed
+    dwErrCode = ParseTagExpr(hs, szQuery, Result);
+    if(dwErrCode == ERROR_SUCCESS && SkipSpaces(szQuery)[0] != 0)
+        dwErrCode = ERROR_INVALID_PARAMETER;
+    return dwErrCode;
+}
+
 //-----------------------------------------------------------------------------
 // Public functions
 
@@ -222,6 +408,15 @@ HANDLE WINAPI CascFindFirstFile(
             dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
     }
 
+    // Compile the search mask. It is then used for every found name
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        if(pSearch->szMask == NULL)
+            dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+        if(dwErrCode == ERROR_SUCCESS)
+            dwErrCode = pSearch->Mask.Compile(pSearch->szMask);
+    }
+
     // Perform search
     if(dwErrCode == ERROR_SUCCESS)
     {
@@ -238,6 +433,58 @@ HANDLE WINAPI CascFindFirstFile(
     return (HANDLE)pSearch;
 }
 
+// Finds the files whose tags match the query. The files are enumerated directly
+// from the bitsets of the tags, so the time is given by the number of found files.
+// The root handler is not involved, so the files don't have names (see SupplyFakeFileName).
+// Use CascFindNextFile(s) and CascFindClose with the returned handle.
+HANDLE WINAPI CascFindFirstTaggedFile(
+    HANDLE hStorage,
+    LPCSTR szTagQuery,
+    PCASC_FIND_DATA pFindData)
+{
+    TCascStorage * hs;
+    TCascSearch * pSearch = NULL;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // Check parameters
+    if((hs = TCascStorage::IsValid(hStorage)) == NULL)
+        dwErrCode = ERROR_INVALID_HANDLE;
+    if(szTagQuery == NULL || szTagQuery[0] == 0 || pFindData == NULL)
+        dwErrCode = ERROR_INVALID_PARAMETER;
+
+    // The storage must support tags
+    if(dwErrCode == ERROR_SUCCESS && hs->TagsArray.IsInitialized() == false)
+        dwErrCode = ERROR_NOT_SUPPORTED;
+
+    // Allocate the search handle and the bitset of the matching files
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        pSearch = new TCascSearch(hs, NULL, "*");
+        if(pSearch == NULL || pSearch->szMask == NULL || (pSearch->pTagMatches = new CASC_BITSET()) == NULL)
+            dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    // Evaluate the query
+    if(dwErrCode == ERROR_SUCCESS)
+        dwErrCode = EvaluateTagQuery(hs, szTagQuery, pSearch->pTagMatches[0]);
+
+    // Find the first file
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        if(!DoStorageSearch(pSearch, pFindData))
+            dwErrCode = ERROR_NO_MORE_FILES;
+    }
+
+    if(dwErrCode != ERROR_SUCCESS)
+    {
+        SetCascError(dwErrCode);
+        delete pSearch;
+        pSearch = (TCascSearch *)INVALID_HANDLE_VALUE;
+    }
+
+    return (HANDLE)pSearch;
+}
+
 bool WINAPI CascFindNextFile(
     HANDLE hFind,
     PCASC_FIND_DATA pFindData)
@@ -255,6 +502,84 @@ bool WINAPI CascFindNextFile(
     return DoStorageSearch(pSearch, pFindData);
 }
 
+bool WINAPI CascFindNextFiles(
+    HANDLE hFind,
+    PCASC_FIND_DATA pFindData,
+    DWORD dwMaxCount,
+    PDWORD pdwFoundCount,
+    DWORD dwFlags)
+{
+    TCascSearch * pSearch;
+    DWORD dwFoundCount = 0;
+
+    pSearch = TCascSearch::IsValid(hFind);
+    if(pSearch == NULL || pFindData == NULL || dwMaxCount == 0)
+    {
+        SetCascError(ERROR_INVALID_PARAMETER);
+        return false;
+    }
+
+    // File names can only be skipped if the mask doesn't need them
+    pSearch->bNoFileNames = ((dwFlags & CASC_FIND_NO_FILE_NAMES) && pSearch->Mask.IsMatchAll()) ? true : false;
+
+    // Fill as many entries as we can
+    while(dwFoundCount < dwMaxCount)
+    {
+        if(!DoStorageSearch(pSearch, pFindData + dwFoundCount))
+            break;
+        dwFoundCount++;
+    }
+
+    // Names are only skipped for this call
+    pSearch->bNoFileNames = false;
+
+    // Give the number of found entries
+    if(pdwFoundCount != NULL)
+        pdwFoundCount[0] = dwFoundCount;
+    return (dwFoundCount != 0);
+}
+
+bool WINAPI CascApplyListFile(HANDLE hStorage, LPCTSTR szListFile)
+{
+    TCascStorage * hs;
+    void * pvListFile;
+    DWORD dwErrCode;
+
+    // Check parameters
+    if((hs = TCascStorage::IsValid(hStorage)) == NULL || hs->pRootHandler == NULL)
+    {
+        SetCascError(ERROR_INVALID_HANDLE);
+        return false;
+    }
+    if(szListFile == NULL || szListFile[0] == 0)
+    {
+        SetCascError(ERROR_INVALID_PARAMETER);
+        return false;
+    }
+
+    // Load the listfile
+    if((pvListFile = ListFile_OpenExternal(szListFile)) == NULL)
+    {
+        SetCascError(ERROR_FILE_NOT_FOUND);
+        return false;
+    }
+
+    // Assigning the names rebuilds the name maps of the file tree, which the name
+    // lookups and searches read without a lock. The storage must not be in use:
+    // no open files, searches or storages opened on top of this one
+    CascLock(hs->StorageLock);
+    if(hs->dwRefCount == 1)
+        dwErrCode = hs->pRootHandler->ApplyListFile(hs, pvListFile);
+    else
+        dwErrCode = ERROR_ACCESS_DENIED;
+    CascUnlock(hs->StorageLock);
+    ListFile_Free(pvListFile);
+
+    if(dwErrCode != ERROR_SUCCESS)
+        SetCascError(dwErrCode);
+    return (dwErrCode == ERROR_SUCCESS);
+}
+
 bool WINAPI CascFindClose(HANDLE hFind)
 {
     TCascSearch * pSearch;
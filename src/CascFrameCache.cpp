@@ -0,0 +1,252 @@
+/*****************************************************************************/
+/* CascFrameCache.cpp                     Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Storage-wide cache of parsed BLTE frame tables                            */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 19.10.26  1.00  Lad  The first version of CascFrameCache.cpp              */
+/*****************************************************************************/
+
+#define __CASCLIB_SELF__
+#include "CascLib.h"
+#include "CascCommon.h"
+
+//-----------------------------------------------------------------------------
+// Local defines
+
+#define CASC_FRAME_CACHE_MIN_BUCKETS    0x40        // Minimum number of hash buckets
+#define CASC_FRAME_CACHE_BUCKET_BYTES   0x100       // One hash bucket per this many bytes of the budget
+
+static PCASC_FILE_FRAME GetEntryFrames(CASC_FRAME_CACHE_ENTRY * pEntry)
+{
+    return (PCASC_FILE_FRAME)(pEntry + 1);
+}
+
+//-----------------------------------------------------------------------------
+// CASC_FRAME_CACHE functions
+
+CASC_FRAME_CACHE::CASC_FRAME_CACHE()
+{
+    CascInitLock(Lock);
+    HashTable = NULL;
+    pLruFirst = pLruLast = NULL;
+    HashTableSize = cbMaxSize = cbUsed = EntryCount = 0;
+    Hits = Misses = Evictions = 0;
+}
+
+CASC_FRAME_CACHE::~CASC_FRAME_CACHE()
+{
+    Free();
+    CascFreeLock(Lock);
+}
+
+DWORD CASC_FRAME_CACHE::Create(size_t cbNewMaxSize)
+{
+    size_t nBuckets = CASC_FRAME_CACHE_MIN_BUCKETS;
+
+    // Don't create the cache twice
+    assert(HashTable == NULL);
+
+    // Round the number of buckets up to a power of two
+    while(nBuckets < (cbNewMaxSize / CASC_FRAME_CACHE_BUCKET_BYTES))
+        nBuckets <<= 1;
+
+    // Allocate the hash table
+    if((HashTable = CASC_ALLOC_ZERO<CASC_FRAME_CACHE_ENTRY *>(nBuckets)) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    HashTableSize = nBuckets;
+    cbMaxSize = cbNewMaxSize;
+    return ERROR_SUCCESS;
+}
+
+CASC_FRAME_CACHE_ENTRY ** CASC_FRAME_CACHE::GetBucket(LPBYTE EKey)
+{
+    // The EKeys are MD5 hashes, so any part of them is a good hash
+    return &HashTable[ConvertBytesToInteger_4_LE(EKey) & (HashTableSize - 1)];
+}
+
+void CASC_FRAME_CACHE::LinkLru(CASC_FRAME_CACHE_ENTRY * pEntry)
+{
+    pEntry->pPrevLru = NULL;
+    pEntry->pNextLru = pLruFirst;
+    if(pLruFirst != NULL)
+        pLruFirst->pPrevLru = pEntry;
+    pLruFirst = pEntry;
+
+    if(pLruLast == NULL)
+        pLruLast = pEntry;
+}
+
+void CASC_FRAME_CACHE::UnlinkLru(CASC_FRAME_CACHE_ENTRY * pEntry)
+{
+    if(pEntry->pPrevLru != NULL)
+        pEntry->pPrevLru->pNextLru = pEntry->pNextLru;
+    else
+        pLruFirst = pEntry->pNextLru;
+
+    if(pEntry->pNextLru != NULL)
+        pEntry->pNextLru->pPrevLru = pEntry->pPrevLru;
+    else
+        pLruLast = pEntry->pPrevLru;
+}
+
+void CASC_FRAME_CACHE::RemoveEntry(CASC_FRAME_CACHE_ENTRY * pEntry)
+{
+    CASC_FRAME_CACHE_ENTRY ** ppEntry = GetBucket(pEntry->EKey);
+
+    // Remove the entry from the hash bucket
+    while(ppEntry[0] != pEntry)
+        ppEntry = &ppEntry[0]->pNextHash;
+    ppEntry[0] = pEntry->pNextHash;
+
+    // Remove the entry from the LRU list
+    UnlinkLru(pEntry);
+    cbUsed -= pEntry->cbEntry;
+    EntryCount--;
+    CASC_FREE(pEntry);
+}
+
+bool CASC_FRAME_CACHE::Load(PCASC_FILE_SPAN pFileSpan, PCASC_CKEY_ENTRY pCKeyEntry)
+{
+    CASC_FRAME_CACHE_ENTRY * pEntry;
+    PCASC_FILE_FRAME pFrames = NULL;
+    PCASC_FILE_FRAME pSrcFrame;
+
+    // Is the cache enabled at all?
+    if(HashTable == NULL || (pCKeyEntry->Flags & CASC_CE_PLAIN_DATA))
+        return false;
+
+    CascLock(Lock);
+
+    // Find the entry in the hash bucket
+    for(pEntry = GetBucket(pCKeyEntry->EKey)[0]; pEntry != NULL; pEntry = pEntry->pNextHash)
+    {
+        if(!memcmp(pEntry->EKey, pCKeyEntry->EKey, MD5_HASH_SIZE))
+            break;
+    }
+
+    // Copy the frames to the span, moving them to the span's file range and archive offset
+    if(pEntry != NULL && (pFrames = CASC_ALLOC<CASC_FILE_FRAME>(pEntry->FrameCount)) != NULL)
+    {
+        pSrcFrame = GetEntryFrames(pEntry);
+        for(DWORD i = 0; i < pEntry->FrameCount; i++)
+        {
+            pFrames[i] = pSrcFrame[i];
+            pFrames[i].StartOffset += pFileSpan->StartOffset;
+            pFrames[i].EndOffset += pFileSpan->StartOffset;
+            pFrames[i].DataFileOffset += pFileSpan->ArchiveOffs;
+        }
+
+        pFileSpan->pFrames = pFrames;
+        pFileSpan->FrameCount = pEntry->FrameCount;
+        pFileSpan->HeaderSize = pEntry->HeaderSize;
+        if(pCKeyEntry->ContentSize == CASC_INVALID_SIZE)
+            pCKeyEntry->ContentSize = pEntry->ContentSize;
+
+        // Make the entry the most recently used one
+        UnlinkLru(pEntry);
+        LinkLru(pEntry);
+        Hits++;
+    }
+    else
+    {
+        Misses++;
+    }
+
+    CascUnlock(Lock);
+    return (pFrames != NULL);
+}
+
+void CASC_FRAME_CACHE::Store(PCASC_FILE_SPAN pFileSpan, PCASC_CKEY_ENTRY pCKeyEntry)
+{
+    CASC_FRAME_CACHE_ENTRY ** ppBucket;
+    CASC_FRAME_CACHE_ENTRY * pEntry;
+    PCASC_FILE_FRAME pDstFrame;
+    size_t cbEntry = sizeof(CASC_FRAME_CACHE_ENTRY) + pFileSpan->FrameCount * sizeof(CASC_FILE_FRAME);
+
+    // Plain files have no BLTE header. Very large frame tables would push out too many small ones.
+    if(HashTable == NULL || (pCKeyEntry->Flags & CASC_CE_PLAIN_DATA) || pCKeyEntry->ContentSize == CASC_INVALID_SIZE)
+        return;
+    if(pFileSpan->pFrames == NULL || cbEntry > (cbMaxSize / 8))
+        return;
+
+    // Prepare the entry outside the lock
+    if((pEntry = (CASC_FRAME_CACHE_ENTRY *)CASC_ALLOC<BYTE>(cbEntry)) == NULL)
+        return;
+    memcpy(pEntry->EKey, pCKeyEntry->EKey, MD5_HASH_SIZE);
+    pEntry->cbEntry = cbEntry;
+    pEntry->ContentSize = pCKeyEntry->ContentSize;
+    pEntry->HeaderSize = pFileSpan->HeaderSize;
+    pEntry->FrameCount = pFileSpan->FrameCount;
+
+    // Store the frames relative to the span
+    pDstFrame = GetEntryFrames(pEntry);
+    for(DWORD i = 0; i < pFileSpan->FrameCount; i++)
+    {
+        pDstFrame[i] = pFileSpan->pFrames[i];
+        pDstFrame[i].StartOffset -= pFileSpan->StartOffset;
+        pDstFrame[i].EndOffset -= pFileSpan->StartOffset;
+        pDstFrame[i].DataFileOffset -= pFileSpan->ArchiveOffs;
+    }
+
+    CascLock(Lock);
+
+    // Another thread may have inserted the same frame table in the meantime
+    ppBucket = GetBucket(pEntry->EKey);
+    for(CASC_FRAME_CACHE_ENTRY * pItem = ppBucket[0]; pItem != NULL; pItem = pItem->pNextHash)
+    {
+        if(!memcmp(pItem->EKey, pEntry->EKey, MD5_HASH_SIZE))
+        {
+            CascUnlock(Lock);
+            CASC_FREE(pEntry);
+            return;
+        }
+    }
+
+    // Make space for the new entry
+    while(pLruLast != NULL && (cbUsed + cbEntry) > cbMaxSize)
+    {
+        RemoveEntry(pLruLast);
+        Evictions++;
+    }
+
+    // Insert the entry
+    pEntry->pNextHash = ppBucket[0];
+    ppBucket[0] = pEntry;
+    LinkLru(pEntry);
+    cbUsed += cbEntry;
+    EntryCount++;
+
+    CascUnlock(Lock);
+}
+
+void CASC_FRAME_CACHE::Collect(PCASC_FRAME_CACHE_INFO pInfo)
+{
+    CascLock(Lock);
+    pInfo->Hits = Hits;
+    pInfo->Misses = Misses;
+    pInfo->Evictions = Evictions;
+    pInfo->EntryCount = EntryCount;
+    pInfo->BytesUsed = cbUsed;
+    pInfo->BytesMax = cbMaxSize;
+    CascUnlock(Lock);
+}
+
+void CASC_FRAME_CACHE::Free()
+{
+    CASC_FRAME_CACHE_ENTRY * pEntry;
+
+    CascLock(Lock);
+    while((pEntry = pLruFirst) != NULL)
+    {
+        pLruFirst = pEntry->pNextLru;
+        CASC_FREE(pEntry);
+    }
+    CASC_FREE(HashTable);
+
+    pLruFirst = pLruLast = NULL;
+    HashTableSize = cbMaxSize = cbUsed = EntryCount = 0;
+    CascUnlock(Lock);
+}
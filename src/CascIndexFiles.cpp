@@ -22,7 +22,7 @@ static LPCTSTR szIndexFormat_V2 = _T("%02x%08x.idx");
 // Limit for "orphaned" items - those that are in index files, but are not in ENCODING manifest
 #define CASC_MAX_ORPHANED_ITEMS 0x100
 
-typedef bool (*EKEY_ENTRY_CALLBACK)(TCascStorage * hs, CASC_INDEX_HEADER & InHeader, LPBYTE pbEKeyEntry);
+typedef bool (*EKEY_ENTRY_CALLBACK)(TCascStorage * hs, CASC_INDEX_HEADER & InHeader, LPBYTE pbEKeyEntry, void * pvContext);
 
 //-----------------------------------------------------------------------------
 // Local functions
@@ -145,6 +145,16 @@ static void SaveFileOffsetBitsAndEKeyLength(TCascStorage * hs, BYTE FileOffsetBi
     assert(hs->EKeyLength == EKeyLength);
 }
 
+// Returns the bucket (index file) where the EKey belongs
+static DWORD GetBucketIndex(LPBYTE EKey)
+{
+    BYTE HashValue = 0;
+
+    for(size_t i = 0; i < CASC_EKEY_SIZE; i++)
+        HashValue ^= EKey[i];
+    return (HashValue & 0x0F) ^ (HashValue >> 4);
+}
+
 // Verifies a guarded block - data availability and checksum match
 static LPBYTE CaptureGuardedBlock1(LPBYTE pbFileData, LPBYTE pbFileEnd)
 {
@@ -314,7 +324,7 @@ static void InsertCKeyEntry(TCascStorage * hs, CASC_EKEY_ENTRY & EKeyEntry, DWOR
     pCKeyEntry->Flags |= Flags;
 }
 */
-static DWORD LoadIndexItems(TCascStorage * hs, CASC_INDEX_HEADER & InHeader, EKEY_ENTRY_CALLBACK PfnEKeyEntry, LPBYTE pbEKeyEntry, LPBYTE pbEKeyEnd)
+static DWORD LoadIndexItems(TCascStorage * hs, CASC_INDEX_HEADER & InHeader, EKEY_ENTRY_CALLBACK PfnEKeyEntry, void * pvContext, LPBYTE pbEKeyEntry, LPBYTE pbEKeyEnd)
 {
     size_t EntryLength = InHeader.EntryLength;
 
@@ -323,7 +333,7 @@ static DWORD LoadIndexItems(TCascStorage * hs, CASC_INDEX_HEADER & InHeader, EKE
         // ENCODING for Starcraft II Beta
         BREAK_ON_XKEY3(pbEKeyEntry, 0x8b, 0x0d, 0x9a);
 
-        if(!PfnEKeyEntry(hs, InHeader, pbEKeyEntry))
+        if(!PfnEKeyEntry(hs, InHeader, pbEKeyEntry, pvContext))
             return ERROR_INDEX_PARSING_DONE;
 
         pbEKeyEntry += EntryLength;
@@ -426,7 +436,7 @@ static DWORD CaptureIndexHeader_V2(CASC_INDEX_HEADER & InHeader, LPBYTE pbFileDa
     return ERROR_SUCCESS;
 }    
 
-static DWORD LoadIndexFile_V1(TCascStorage * hs, CASC_INDEX_HEADER & InHeader, EKEY_ENTRY_CALLBACK PfnEKeyEntry, LPBYTE pbFileData, size_t cbFileData)
+static DWORD LoadIndexFile_V1(TCascStorage * hs, CASC_INDEX_HEADER & InHeader, EKEY_ENTRY_CALLBACK PfnEKeyEntry, void * pvContext, LPBYTE pbFileData, size_t cbFileData)
 {
     LPBYTE pbEKeyEntries = pbFileData + InHeader.HeaderLength + InHeader.HeaderPadding;
 
@@ -434,10 +444,10 @@ static DWORD LoadIndexFile_V1(TCascStorage * hs, CASC_INDEX_HEADER & InHeader, E
     SaveFileOffsetBitsAndEKeyLength(hs, InHeader.FileOffsetBits, InHeader.EKeyLength);
 
     // Load the entries from a continuous array
-    return LoadIndexItems(hs, InHeader, PfnEKeyEntry, pbEKeyEntries, pbFileData + cbFileData);
+    return LoadIndexItems(hs, InHeader, PfnEKeyEntry, pvContext, pbEKeyEntries, pbFileData + cbFileData);
 }
 
-static DWORD LoadIndexFile_V2(TCascStorage * hs, CASC_INDEX_HEADER & InHeader, EKEY_ENTRY_CALLBACK PfnEKeyEntry, LPBYTE pbFileData, size_t cbFileData)
+static DWORD LoadIndexFile_V2(TCascStorage * hs, CASC_INDEX_HEADER & InHeader, EKEY_ENTRY_CALLBACK PfnEKeyEntry, void * pvContext, LPBYTE pbFileData, size_t cbFileData)
 {
     LPBYTE pbEKeyEntry;
     LPBYTE pbFileEnd = pbFileData + cbFileData;
@@ -456,7 +466,7 @@ static DWORD LoadIndexFile_V2(TCascStorage * hs, CASC_INDEX_HEADER & InHeader, E
         InHeader.HeaderPadding += sizeof(FILE_INDEX_GUARDED_BLOCK);
 
         // Load the continuous array of EKeys
-        return LoadIndexItems(hs, InHeader, PfnEKeyEntry, pbEKeyEntry, pbEKeyEntry + BlockSize);
+        return LoadIndexItems(hs, InHeader, PfnEKeyEntry, pvContext, pbEKeyEntry, pbEKeyEntry + BlockSize);
     }
 
     // Get the pointer to the second block of EKey entries.
@@ -483,7 +493,7 @@ static DWORD LoadIndexFile_V2(TCascStorage * hs, CASC_INDEX_HEADER & InHeader, E
                 //BREAK_ON_XKEY3(pbEKeyEntry, 0xbc, 0xe8, 0x23);
 
                 // Call the EKey entry callback
-                if(!PfnEKeyEntry(hs, InHeader, pbEKeyEntry))
+                if(!PfnEKeyEntry(hs, InHeader, pbEKeyEntry, pvContext))
                     return ERROR_INDEX_PARSING_DONE;
 
                 pbEKeyEntry += AlignedLength;
@@ -498,17 +508,17 @@ static DWORD LoadIndexFile_V2(TCascStorage * hs, CASC_INDEX_HEADER & InHeader, E
     return dwErrCode;
 }
 
-static DWORD LoadIndexFile(TCascStorage * hs, EKEY_ENTRY_CALLBACK PfnEKeyEntry, LPBYTE pbFileData, size_t cbFileData, DWORD BucketIndex)
+static DWORD LoadIndexFile(TCascStorage * hs, EKEY_ENTRY_CALLBACK PfnEKeyEntry, void * pvContext, LPBYTE pbFileData, size_t cbFileData, DWORD BucketIndex)
 {
     CASC_INDEX_HEADER InHeader;
 
     // Check for CASC version 2
     if(CaptureIndexHeader_V2(InHeader, pbFileData, cbFileData, BucketIndex) == ERROR_SUCCESS)
-        return LoadIndexFile_V2(hs, InHeader, PfnEKeyEntry, pbFileData, cbFileData);
+        return LoadIndexFile_V2(hs, InHeader, PfnEKeyEntry, pvContext, pbFileData, cbFileData);
 
     // Check for CASC index version 1
     if(CaptureIndexHeader_V1(InHeader, pbFileData, cbFileData, BucketIndex) == ERROR_SUCCESS)
-        return LoadIndexFile_V1(hs, InHeader, PfnEKeyEntry, pbFileData, cbFileData);
+        return LoadIndexFile_V1(hs, InHeader, PfnEKeyEntry, pvContext, pbFileData, cbFileData);
 
     // Should never happen
     assert(false);
@@ -516,12 +526,33 @@ static DWORD LoadIndexFile(TCascStorage * hs, EKEY_ENTRY_CALLBACK PfnEKeyEntry,
 }
 
 // Checks the EKey entry for EKey of the ENCODING manifest
-static bool InsertEncodingEKeyToMap(TCascStorage * hs, CASC_INDEX_HEADER &, LPBYTE pbEKeyEntry)
+static bool InsertEncodingEKeyToMap(TCascStorage * hs, CASC_INDEX_HEADER &, LPBYTE pbEKeyEntry, void *)
 {
     hs->IndexEKeyMap.InsertObject(pbEKeyEntry, pbEKeyEntry);
     return true;
 }
 
+// Copies the EKey entry to an array of CASC_EKEY_ENTRY
+static bool InsertEKeyEntryToArray(TCascStorage *, CASC_INDEX_HEADER & InHeader, LPBYTE pbEKeyEntry, void * pvContext)
+{
+    CASC_ARRAY * pEKeyEntries = (CASC_ARRAY *)pvContext;
+    PCASC_EKEY_ENTRY pEKeyEntry;
+
+    if((pEKeyEntry = (PCASC_EKEY_ENTRY)pEKeyEntries->Insert(1)) != NULL)
+    {
+        // Copy the EKey of the variable length
+        ZeroMemory16(pEKeyEntry->EKey);
+        memcpy(pEKeyEntry->EKey, pbEKeyEntry, InHeader.EKeyLength);
+        pbEKeyEntry += InHeader.EKeyLength;
+
+        // Copy the storage offset and encoded size
+        pEKeyEntry->StorageOffset = ConvertBytesToInteger_5(pbEKeyEntry);
+        pEKeyEntry->EncodedSize = ConvertBytesToInteger_4_LE(pbEKeyEntry + InHeader.StorageOffsetLength);
+        pEKeyEntry->Alignment = 0;
+    }
+    return (pEKeyEntry != NULL);
+}
+
 static DWORD ProcessLocalIndexFiles(TCascStorage * hs, EKEY_ENTRY_CALLBACK PfnEKeyEntry, DWORD dwIndexCount)
 {
     DWORD dwErrCode = ERROR_SUCCESS;
@@ -538,8 +569,12 @@ static DWORD ProcessLocalIndexFiles(TCascStorage * hs, EKEY_ENTRY_CALLBACK PfnEK
             break;
         }
 
+        // Index files that are the same as in the base storage are only loaded on demand
+        if(IndexFile.bReused)
+            continue;
+
         // Load the index file
-        if((dwErrCode = LoadIndexFile(hs, PfnEKeyEntry, IndexFile.pbFileData, IndexFile.cbFileData, i)) != ERROR_SUCCESS)
+        if((dwErrCode = LoadIndexFile(hs, PfnEKeyEntry, NULL, IndexFile.pbFileData, IndexFile.cbFileData, i)) != ERROR_SUCCESS)
             break;
     }
 
@@ -552,9 +587,122 @@ static DWORD ProcessLocalIndexFiles(TCascStorage * hs, EKEY_ENTRY_CALLBACK PfnEK
     return dwErrCode;
 }
 
+// Checks whether the index file is the same as the one in the base storage
+static bool IsSameIndexFile(TCascStorage * hs, CASC_INDEX & IndexFile, DWORD BucketIndex)
+{
+    TCascStorage * pBaseStorage = hs->pBaseStorage;
+
+    // The base storage must be a local storage loaded from the same directory
+    if(pBaseStorage == NULL || (pBaseStorage->dwFeatures & CASC_FEATURE_ONLINE))
+        return false;
+    if(pBaseStorage->szIndexPath == NULL || _tcsicmp(pBaseStorage->szIndexPath, hs->szIndexPath))
+        return false;
+
+    // Index files are never modified in place; a changed index file has a new sub-index.
+    // We also check the size and the last write time, in case the file was replaced
+    CASC_INDEX & BaseIndexFile = pBaseStorage->IndexFiles[BucketIndex];
+    return (BaseIndexFile.NewSubIndex == IndexFile.NewSubIndex &&
+            BaseIndexFile.FileSize == IndexFile.FileSize &&
+            BaseIndexFile.FileTime == IndexFile.FileTime &&
+            BaseIndexFile.FileSize != 0);
+}
+
+// Loads an index file that was skipped because it's the same as in the base storage.
+// Happens when an EKey from that index file is not known to the base storage
+// (or to the shared index, see LoadSharedIndexFile)
+static DWORD LoadReusedIndexFile(TCascStorage * hs, DWORD BucketIndex)
+{
+    CASC_INDEX & IndexFile = hs->IndexFiles[BucketIndex];
+    DWORD cbFileData = 0;
+    DWORD dwErrCode;
+
+    // Don't try it again for the next EKey
+    IndexFile.bReused = false;
+
+    // Load the file and insert its entries to the map
+    if((IndexFile.pbFileData = LoadFileToMemory(IndexFile.szFileName, &cbFileData)) == NULL)
+        return GetCascError();
+    IndexFile.cbFileData = cbFileData;
+
+    dwErrCode = LoadIndexFile(hs, InsertEncodingEKeyToMap, NULL, IndexFile.pbFileData, IndexFile.cbFileData, BucketIndex);
+    return (dwErrCode == ERROR_INDEX_PARSING_DONE) ? ERROR_SUCCESS : dwErrCode;
+}
+
+// Storages attached to a shared index don't load the index files, as the locations
+// of all files in ENCODING and DOWNLOAD are in the shared index. The ROOT handler
+// may ask for other EKeys (e.g. TVFS); the index file of their bucket is loaded then
+static DWORD LoadSharedIndexFile(TCascStorage * hs, DWORD BucketIndex)
+{
+    ULONGLONG TotalSize = 0;
+    DWORD dwErrCode;
+
+    // The map is sized for all index files found by QueryIndexFiles
+    if(!hs->IndexEKeyMap.IsInitialized())
+    {
+        for(size_t i = 0; i < CASC_INDEX_COUNT; i++)
+            TotalSize += hs->IndexFiles[i].FileSize;
+        if((dwErrCode = hs->IndexEKeyMap.Create((size_t)(TotalSize / sizeof(FILE_EKEY_ENTRY)), CASC_EKEY_SIZE, 0)) != ERROR_SUCCESS)
+            return dwErrCode;
+    }
+
+    // The bucket may be missing, like in storages downloaded by Blizzget tool
+    if(hs->IndexFiles[BucketIndex].FileSize == 0)
+        return ERROR_FILE_NOT_FOUND;
+    return LoadReusedIndexFile(hs, BucketIndex);
+}
+
+// Retrieves the size and the last write time of the index file
+static DWORD QueryIndexFile(CASC_INDEX & IndexFile)
+{
+    TFileStream * pStream;
+
+    pStream = FileStream_OpenFile(IndexFile.szFileName, STREAM_FLAG_READ_ONLY | STREAM_FLAG_WRITE_SHARE | STREAM_PROVIDER_FLAT | BASE_PROVIDER_FILE);
+    if(pStream == NULL)
+        return GetCascError();
+
+    FileStream_GetSize(pStream, &IndexFile.FileSize);
+    FileStream_GetTime(pStream, &IndexFile.FileTime);
+    FileStream_Close(pStream);
+    return ERROR_SUCCESS;
+}
+
+// Finds the newest index file of each bucket and retrieves its size and last write time.
+// Stops at the first missing bucket. Can be called more than once
+static DWORD QueryLocalIndexFiles(TCascStorage * hs, DWORD & dwIndexCount)
+{
+    DWORD dwErrCode;
+
+    // Perform the directory scan. The scan is only done once
+    if(hs->szIndexFormat == NULL)
+    {
+        if((dwErrCode = ScanIndexDirectory(hs->szIndexPath, IndexDirectory_OnFileFound, hs)) != ERROR_SUCCESS)
+            return dwErrCode;
+
+        // If no index file was found, we cannot load anything
+        if(hs->szIndexFormat == NULL)
+            return ERROR_FILE_NOT_FOUND;
+    }
+
+    for(dwIndexCount = 0; dwIndexCount < CASC_INDEX_COUNT; dwIndexCount++)
+    {
+        CASC_INDEX & IndexFile = hs->IndexFiles[dwIndexCount];
+
+        // Create the file name
+        if(IndexFile.szFileName == NULL && (IndexFile.szFileName = CreateIndexFileName(hs, dwIndexCount, IndexFile.NewSubIndex)) == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+
+        // Storages downloaded by Blizzget tool don't have all index files present
+        if((dwErrCode = QueryIndexFile(IndexFile)) != ERROR_SUCCESS)
+            return (dwErrCode == ERROR_FILE_NOT_FOUND) ? ERROR_SUCCESS : dwErrCode;
+    }
+
+    return ERROR_SUCCESS;
+}
+
 static DWORD LoadLocalIndexFiles(TCascStorage * hs)
 {
     ULONGLONG TotalSize = 0;
+    DWORD dwReusedCount = 0;
     DWORD dwIndexCount = 0;
     DWORD dwErrCode;
 
@@ -562,40 +710,34 @@ static DWORD LoadLocalIndexFiles(TCascStorage * hs)
     if(InvokeProgressCallback(hs, "Loading index files", NULL, 0, 0))
         return ERROR_CANCELLED;
 
-    // Perform the directory scan
-    if((dwErrCode = ScanIndexDirectory(hs->szIndexPath, IndexDirectory_OnFileFound, hs)) == ERROR_SUCCESS)
+    // Find the index files
+    if((dwErrCode = QueryLocalIndexFiles(hs, dwIndexCount)) == ERROR_SUCCESS)
     {
-        // If no index file was found, we cannot load anything
-        if(hs->szIndexFormat == NULL)
-            return ERROR_FILE_NOT_FOUND;
-
         // Load each index file
-        for(DWORD i = 0; i < CASC_INDEX_COUNT; i++)
+        for(DWORD i = 0; i < dwIndexCount; i++)
         {
             CASC_INDEX & IndexFile = hs->IndexFiles[i];
             DWORD cbFileData = 0;
 
-            // Create the file name
-            if((IndexFile.szFileName = CreateIndexFileName(hs, i, IndexFile.NewSubIndex)) == NULL)
-                return ERROR_NOT_ENOUGH_MEMORY;
+            // If the index file didn't change since the base storage, we don't load it.
+            // Locations of its EKeys are taken from the base storage
+            if(IsSameIndexFile(hs, IndexFile, i))
+            {
+                IndexFile.bReused = true;
+                CASC_PERF_ADD(hs, OpenReusedIndexes, 1);
+                dwReusedCount++;
+            }
 
             // WoW6 actually reads THE ENTIRE file to memory. Verified on Mac build (x64).
-            if((IndexFile.pbFileData = LoadFileToMemory(IndexFile.szFileName, &cbFileData)) == NULL)
+            else
             {
-                // Storages downloaded by Blizzget tool don't have all index files present
-                if((dwErrCode = GetCascError()) == ERROR_FILE_NOT_FOUND)
-                {
-                    dwErrCode = ERROR_SUCCESS;
-                    break;
-                }
-
-                return dwErrCode;
+                if((IndexFile.pbFileData = LoadFileToMemory(IndexFile.szFileName, &cbFileData)) == NULL)
+                    return GetCascError();
+                IndexFile.cbFileData = cbFileData;
             }
 
             // Add to the total size of the index files
-            IndexFile.cbFileData = cbFileData;
-            TotalSize += cbFileData;
-            dwIndexCount++;
+            TotalSize += IndexFile.FileSize;
         }
 
         // Build the map of EKey -> IndexEKeyEntry
@@ -604,6 +746,13 @@ static DWORD LoadLocalIndexFiles(TCascStorage * hs)
         {
             dwErrCode = ProcessLocalIndexFiles(hs, InsertEncodingEKeyToMap, dwIndexCount);
         }
+
+        // If all index files were skipped, take the values from their headers from the base storage
+        if(dwErrCode == ERROR_SUCCESS && dwReusedCount != 0 && hs->FileOffsetBits == 0)
+        {
+            hs->FileOffsetBits = hs->pBaseStorage->FileOffsetBits;
+            hs->EKeyLength = hs->pBaseStorage->EKeyLength;
+        }
     }
 
     return dwErrCode;
@@ -780,8 +929,76 @@ static DWORD BuildMapOfArchiveIndices(TCascStorage * hs)
     return dwErrCode;
 }
 
+// Remembers the range of IndexArray that was loaded from one archive index.
+// The next build, opened with this storage as base, can copy the entries
+static DWORD InsertArchiveIndex(TCascStorage * hs, LPBYTE pbArchiveKey, size_t FirstEntry)
+{
+    PCASC_ARCHIVE_INDEX pArchiveIndex;
+
+    if((pArchiveIndex = (PCASC_ARCHIVE_INDEX)hs->ArchiveIndexes.Insert(1)) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    CopyMemory16(pArchiveIndex->ArchiveKey, pbArchiveKey);
+    pArchiveIndex->FirstEntry = FirstEntry;
+    pArchiveIndex->EntryCount = hs->IndexArray.ItemCount() - FirstEntry;
+    pArchiveIndex->OffsetBits = hs->FileOffsetBits;
+    return ERROR_SUCCESS;
+}
+
+// Copies the entries of an archive index from the base storage.
+// The archive may have a different position in the "archives" list,
+// so the archive number in the storage offset must be replaced
+static DWORD CopyArchiveIndex(TCascStorage * hs, PCASC_ARCHIVE_INDEX pBaseArchive, size_t nArchive)
+{
+    TCascStorage * pBaseStorage = hs->pBaseStorage;
+    PCASC_EKEY_ENTRY pEKeyEntry;
+    ULONGLONG OffsetMask = ((ULONGLONG)1 << pBaseArchive->OffsetBits) - 1;
+
+    // Remember the file offset and EKey length
+    SaveFileOffsetBitsAndEKeyLength(hs, (BYTE)pBaseArchive->OffsetBits, (BYTE)pBaseStorage->EKeyLength);
+
+    // Copy all entries at once
+    if(pBaseArchive->EntryCount != 0)
+    {
+        pEKeyEntry = (PCASC_EKEY_ENTRY)hs->IndexArray.Insert(pBaseStorage->IndexArray.ItemAt(pBaseArchive->FirstEntry), pBaseArchive->EntryCount);
+        if(pEKeyEntry == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+
+        for(size_t i = 0; i < pBaseArchive->EntryCount; i++, pEKeyEntry++)
+        {
+            pEKeyEntry->StorageOffset = ((ULONGLONG)nArchive << pBaseArchive->OffsetBits) | (pEKeyEntry->StorageOffset & OffsetMask);
+        }
+    }
+
+    CASC_PERF_ADD(hs, OpenReusedIndexes, 1);
+    return ERROR_SUCCESS;
+}
+
+// Creates map of ArchiveKey -> CASC_ARCHIVE_INDEX of the base storage
+static DWORD CreateBaseArchiveMap(TCascStorage * hs, CASC_MAP & BaseArchiveMap)
+{
+    TCascStorage * pBaseStorage = hs->pBaseStorage;
+    PCASC_ARCHIVE_INDEX pBaseArchive;
+    size_t nArchiveCount = pBaseStorage->ArchiveIndexes.ItemCount();
+    DWORD dwErrCode;
+
+    dwErrCode = BaseArchiveMap.Create(nArchiveCount, MD5_HASH_SIZE, FIELD_OFFSET(CASC_ARCHIVE_INDEX, ArchiveKey));
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        for(size_t i = 0; i < nArchiveCount; i++)
+        {
+            pBaseArchive = (PCASC_ARCHIVE_INDEX)pBaseStorage->ArchiveIndexes.ItemAt(i);
+            BaseArchiveMap.InsertObject(pBaseArchive, pBaseArchive->ArchiveKey);
+        }
+    }
+
+    return dwErrCode;
+}
+
 static DWORD LoadArchiveIndexFiles(TCascStorage * hs)
 {
+    PCASC_ARCHIVE_INDEX pBaseArchive;
+    CASC_MAP BaseArchiveMap;
     LPBYTE pbFileData;
     TCHAR szLocalPath[MAX_PATH];
     DWORD cbFileData = 0;
@@ -793,11 +1010,25 @@ static DWORD LoadArchiveIndexFiles(TCascStorage * hs)
     if (dwErrCode != ERROR_SUCCESS)
         return dwErrCode;
 
+    // Create the array of ranges of the indices
+    dwErrCode = hs->ArchiveIndexes.Create(sizeof(CASC_ARCHIVE_INDEX), nArchiveCount);
+    if (dwErrCode != ERROR_SUCCESS)
+        return dwErrCode;
+
+    // If we have a base storage, we can take unchanged archive indices from it
+    if (hs->pBaseStorage != NULL && hs->pBaseStorage->ArchiveIndexes.ItemCount() != 0)
+    {
+        dwErrCode = CreateBaseArchiveMap(hs, BaseArchiveMap);
+        if (dwErrCode != ERROR_SUCCESS)
+            return dwErrCode;
+    }
+
     // Load all the indices
     for (size_t i = 0; i < nArchiveCount; i++)
     {
         CASC_CDN_DOWNLOAD CdnsInfo = {0};
         LPBYTE pbIndexHash = hs->ArchivesKey.pbData + (i * MD5_HASH_SIZE);
+        size_t FirstEntry = hs->IndexArray.ItemCount();
 
         // Inform the user about what we are doing
         if(InvokeProgressCallback(hs, "Downloading archive indexes", NULL, (DWORD)(i), (DWORD)(nArchiveCount)))
@@ -806,6 +1037,17 @@ static DWORD LoadArchiveIndexFiles(TCascStorage * hs)
             break;
         }
 
+        // The archive index was loaded by the base storage
+        pBaseArchive = (PCASC_ARCHIVE_INDEX)BaseArchiveMap.FindObject(pbIndexHash);
+        if (pBaseArchive != NULL && pBaseArchive->EntryCount != 0)
+        {
+            if ((dwErrCode = CopyArchiveIndex(hs, pBaseArchive, i)) != ERROR_SUCCESS)
+                break;
+            if ((dwErrCode = InsertArchiveIndex(hs, pbIndexHash, FirstEntry)) != ERROR_SUCCESS)
+                break;
+            continue;
+        }
+
         // Prepare the download structure for "%CDNS_HOST%/%CDNS_PATH%/##/##/EKey" file
         CdnsInfo.szCdnsPath = hs->szCdnPath;
         CdnsInfo.szPathType = _T("data");
@@ -827,6 +1069,10 @@ static DWORD LoadArchiveIndexFiles(TCascStorage * hs)
             }
         }
 
+        // Remember the range of the entries
+        if (dwErrCode == ERROR_SUCCESS)
+            dwErrCode = InsertArchiveIndex(hs, pbIndexHash, FirstEntry);
+
         // Break if an error
         if (dwErrCode != ERROR_SUCCESS)
             break;
@@ -841,13 +1087,41 @@ static DWORD LoadArchiveIndexFiles(TCascStorage * hs)
 //-----------------------------------------------------------------------------
 // Public functions
 
-bool CopyEKeyEntry(TCascStorage * hs, PCASC_CKEY_ENTRY pCKeyEntry)
+// If pBaseEntry is given, it's the entry of the same file in the base storage
+bool CopyEKeyEntry(TCascStorage * hs, PCASC_CKEY_ENTRY pCKeyEntry, PCASC_CKEY_ENTRY pBaseEntry)
 {
-    LPBYTE pbEKeyEntry = (LPBYTE)hs->IndexEKeyMap.FindObject(pCKeyEntry->EKey);
+    LPBYTE pbEKeyEntry;
 
     // Don't do this on online storages
     if(!(hs->dwFeatures & CASC_FEATURE_ONLINE))
     {
+        DWORD BucketIndex = GetBucketIndex(pCKeyEntry->EKey);
+
+        // If the index file is the same as in the base storage, the base storage knows the location
+        if(hs->IndexFiles[BucketIndex].bReused)
+        {
+            if(pBaseEntry == NULL)
+                pBaseEntry = (PCASC_CKEY_ENTRY)hs->pBaseStorage->EKeyMap.FindObject(pCKeyEntry->EKey);
+            if(pBaseEntry != NULL && (pBaseEntry->Flags & CASC_CE_FILE_IS_LOCAL))
+            {
+                pCKeyEntry->StorageOffset = pBaseEntry->StorageOffset;
+                pCKeyEntry->EncodedSize = pBaseEntry->EncodedSize;
+                pCKeyEntry->Flags |= CASC_CE_FILE_IS_LOCAL;
+                return true;
+            }
+
+            // Not known to the base storage: we need to load the index file
+            if(LoadReusedIndexFile(hs, BucketIndex) != ERROR_SUCCESS)
+                return false;
+        }
+
+        // Not in the shared index: we need to load the index file
+        else if((hs->dwFeatures & CASC_FEATURE_SHARED_INDEX) && hs->IndexFiles[BucketIndex].pbFileData == NULL)
+        {
+            if(LoadSharedIndexFile(hs, BucketIndex) != ERROR_SUCCESS)
+                return false;
+        }
+
         // If the file was found, then copy the content to the CKey entry
         pbEKeyEntry = (LPBYTE)hs->IndexEKeyMap.FindObject(pCKeyEntry->EKey);
         if(pbEKeyEntry == NULL)
@@ -875,6 +1149,65 @@ DWORD LoadIndexFiles(TCascStorage * hs)
     }
 }
 
+DWORD QueryIndexFiles(TCascStorage * hs)
+{
+    DWORD dwIndexCount = 0;
+
+    // Online storages have no local index files
+    if(hs->dwFeatures & CASC_FEATURE_ONLINE)
+        return ERROR_SUCCESS;
+    return QueryLocalIndexFiles(hs, dwIndexCount);
+}
+
+// Loads all entries of the local index files into an array of CASC_EKEY_ENTRY.
+// The index files are read again; the storage itself does not keep them
+DWORD LoadIndexEntries(TCascStorage * hs, CASC_ARRAY & EKeyEntries)
+{
+    ULONGLONG TotalSize = 0;
+    DWORD dwIndexCount = 0;
+    DWORD dwErrCode;
+
+    // Online storages have no local index files
+    if(hs->dwFeatures & CASC_FEATURE_ONLINE)
+        return ERROR_NOT_SUPPORTED;
+
+    // Find the current index files
+    if((dwErrCode = QueryLocalIndexFiles(hs, dwIndexCount)) != ERROR_SUCCESS)
+        return dwErrCode;
+    for(DWORD i = 0; i < dwIndexCount; i++)
+        TotalSize += hs->IndexFiles[i].FileSize;
+
+    // Prepare the array for all entries
+    if((dwErrCode = EKeyEntries.Create<CASC_EKEY_ENTRY>((size_t)(TotalSize / sizeof(FILE_EKEY_ENTRY)))) != ERROR_SUCCESS)
+        return dwErrCode;
+
+    // Load each index file
+    for(DWORD i = 0; i < dwIndexCount && dwErrCode == ERROR_SUCCESS; i++)
+    {
+        LPTSTR szFileName;
+        LPBYTE pbFileData;
+        DWORD cbFileData = 0;
+
+        if((szFileName = CreateIndexFileName(hs, i, hs->IndexFiles[i].NewSubIndex)) == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+
+        if((pbFileData = LoadFileToMemory(szFileName, &cbFileData)) != NULL)
+        {
+            dwErrCode = LoadIndexFile(hs, InsertEKeyEntryToArray, &EKeyEntries, pbFileData, cbFileData, i);
+            CASC_FREE(pbFileData);
+        }
+        else
+        {
+            dwErrCode = GetCascError();
+        }
+
+        CASC_FREE(szFileName);
+    }
+
+    // An array that could not be enlarged is the only reason to stop parsing
+    return (dwErrCode == ERROR_INDEX_PARSING_DONE) ? ERROR_NOT_ENOUGH_MEMORY : dwErrCode;
+}
+
 void FreeIndexFiles(TCascStorage * hs)
 {
     // Free the map of EKey -> Index Ekey item
@@ -891,5 +1224,6 @@ void FreeIndexFiles(TCascStorage * hs)
 
         // Free the file name
         CASC_FREE(IndexFile.szFileName);
+        IndexFile.bReused = false;
     }
 }
@@ -87,6 +87,23 @@ extern "C" {
 #define CASC_STRICT_DATA_CHECK      0x00000010  // Verify all data read from a file
 #define CASC_OVERCOME_ENCRYPTED     0x00000020  // When CascReadFile encounters a block encrypted with a key that is missing, the block is filled with zeros and returned as success
 
+// Flags for CascFindNextFiles
+#define CASC_FIND_NO_FILE_NAMES     0x00000001  // Don't build file names if the mask is "*". Useful when the caller only needs keys or file data IDs
+
+// Flags for CASC_OPEN_STORAGE_ARGS::dwFlags
+#define CASC_OPEN_PERF_COUNTERS     0x00000001  // Collect performance counters. Retrieve them with CascGetStorageInfo(CascStoragePerfCounters)
+#define CASC_OPEN_NO_FRAME_CACHE    0x00000002  // Don't cache the BLTE frame tables of the opened files
+#define CASC_OPEN_NO_CDN_CACHE      0x00000004  // Online storages: store the downloaded data files under the local path, without the CDN cache
+
+// Default size of the cache of BLTE frame tables (CASC_OPEN_STORAGE_ARGS::cbFrameCache)
+#define CASC_FRAME_CACHE_DEFAULT    0x400000
+
+// Default disk budget of the CDN cache (CASC_OPEN_STORAGE_ARGS::CdnCacheSize)
+#define CASC_CDN_CACHE_DEFAULT      0x100000000ULL
+
+// Flags for CascCreateReadQueue
+#define CASC_READ_QUEUE_THREAD_POOL 0x00000001  // Always use the worker thread backend, even if io_uring is available
+
 #define CASC_LOCALE_ALL             0xFFFFFFFF
 #define CASC_LOCALE_ALL_WOW         0x0001F3F6  // All except enCN and enTW
 #define CASC_LOCALE_NONE            0x00000000
@@ -140,6 +157,7 @@ extern "C" {
 #define CASC_FEATURE_LOCALE_FLAGS   0x00000040  // Locale flags are supported
 #define CASC_FEATURE_CONTENT_FLAGS  0x00000080  // Content flags are supported
 #define CASC_FEATURE_ONLINE         0x00000100  // The storage is an online storage
+#define CASC_FEATURE_SHARED_INDEX   0x00000200  // The storage index was taken from a shared memory segment (CASC_OPEN_STORAGE_ARGS::szSharedIndex)
 
 // Macro to convert FileDataId to the argument of CascOpenFile
 #define CASC_FILE_DATA_ID(FileDataId) ((LPCSTR)(size_t)FileDataId)
@@ -167,6 +185,10 @@ typedef enum _CASC_STORAGE_INFO_CLASS
     CascStorageProduct,                         // Gives CASC_STORAGE_PRODUCT
     CascStorageTags,                            // Gives CASC_STORAGE_TAGS structure
     CascStoragePathProduct,                     // Gives Path:Product into a LPTSTR buffer
+    CascStoragePerfCounters,                    // Gives CASC_STORAGE_PERF_COUNTERS structure
+    CascStorageMemory,                          // Gives CASC_STORAGE_MEMORY structure
+    CascStorageFrameCache,                      // Gives CASC_FRAME_CACHE_INFO structure
+    CascStorageCdnCache,                        // Gives CASC_CDN_CACHE_INFO structure
     CascStorageInfoClassMax
 
 } CASC_STORAGE_INFO_CLASS, *PCASC_STORAGE_INFO_CLASS;
@@ -188,7 +210,8 @@ typedef enum _CASC_NAME_TYPE
     CascNameFull,                               // Fully qualified file name
     CascNameDataId,                             // Name created from file data id (FILE%08X.dat)
     CascNameCKey,                               // Name created as string representation of CKey
-    CascNameEKey                                // Name created as string representation of EKey
+    CascNameEKey,                               // Name created as string representation of EKey
+    CascNameNone                                // No name was built (CASC_FIND_NO_FILE_NAMES)
 } CASC_NAME_TYPE, *PCASC_NAME_TYPE;
 
 // Structure for SFileFindFirstFile and SFileFindNextFile
@@ -257,6 +280,90 @@ typedef struct _CASC_STORAGE_PRODUCT
 
 } CASC_STORAGE_PRODUCT, *PCASC_STORAGE_PRODUCT;
 
+// Cumulative performance counters of a storage. Only collected if the storage
+// was open with CASC_OPEN_PERF_COUNTERS. All times are in microseconds
+typedef struct _CASC_STORAGE_PERF_COUNTERS
+{
+    // Opening the storage
+    ULONGLONG OpenTotalTime;                    // Total time of loading the storage
+    ULONGLONG OpenConfigTime;                   // Loading the build file, CDN config and CDN build config
+    ULONGLONG OpenIndexTime;                    // Loading the index files
+    ULONGLONG OpenEncodingTime;                 // Loading the ENCODING manifest
+    ULONGLONG OpenDownloadTime;                 // Loading the DOWNLOAD manifest
+    ULONGLONG OpenRootTime;                     // Loading the ROOT manifest (or INSTALL, if ROOT failed)
+    ULONGLONG OpenReusedIndexes;                // Index files (local) or archive indexes (online) reused from CASC_OPEN_STORAGE_ARGS::hBaseStorage
+    ULONGLONG OpenReusedPages;                  // ENCODING pages whose entries were copied from CASC_OPEN_STORAGE_ARGS::hBaseStorage
+
+    // Reading the encoded data
+    ULONGLONG DataStreamOpens;                  // Number of file spans that were bound to a data stream
+    ULONGLONG DiskReadCount;                    // Number of reads from data files (or locally cached CDN files)
+    ULONGLONG DiskBytesRead;                    // Number of bytes read from data files
+    ULONGLONG CdnDownloadCount;                 // Number of download attempts from CDN
+    ULONGLONG CdnBytesDownloaded;               // Number of bytes downloaded from CDN
+    ULONGLONG CdnDownloadTime;                  // Time spent by downloading from CDN
+
+    // Decoding the file frames
+    ULONGLONG FramesPlain;                      // Frames of plain (non-BLTE) files
+    ULONGLONG FramesNormal;                     // 'N' frames
+    ULONGLONG FramesCompressed;                 // 'Z' frames
+    ULONGLONG FramesEncrypted;                  // 'E' frames
+    ULONGLONG FramesVerified;                   // Frames whose MD5 was verified (CASC_STRICT_DATA_CHECK)
+    ULONGLONG DecodeTime;                       // Total time of decoding frames, including the times below
+    ULONGLONG DecompressTime;                   // Time spent in decompression
+    ULONGLONG DecryptTime;                      // Time spent in decryption
+    ULONGLONG VerifyTime;                       // Time spent in verifying the frame MD5
+
+    // Cache of the decoded frame in the file handle
+    ULONGLONG CacheHits;                        // CascReadFile requests that were (at least partially) satisfied from the cache
+    ULONGLONG CacheMisses;                      // CascReadFile requests that needed to decode frames
+
+    // Lookups in the CKey and EKey maps
+    ULONGLONG MapLookups;                       // Number of lookups
+    ULONGLONG MapProbes;                        // Number of probed hash table items. MapProbes / MapLookups is the average probe length
+
+} CASC_STORAGE_PERF_COUNTERS, *PCASC_STORAGE_PERF_COUNTERS;
+
+// Memory of the storage arena. The arena holds the small structures created
+// while loading the storage (encryption keys, tag bitsets). All of it is
+// released at once by CascCloseStorage
+typedef struct _CASC_STORAGE_MEMORY
+{
+    ULONGLONG ArenaReserved;                    // Bytes allocated from the system
+    ULONGLONG ArenaUsed;                        // Bytes currently in use
+    ULONGLONG ArenaPeak;                        // Peak value of ArenaUsed
+    ULONGLONG ArenaAllocations;                 // Number of allocations served by the arena
+    ULONGLONG ArenaBlocks;                      // Number of blocks allocated from the system
+
+} CASC_STORAGE_MEMORY, *PCASC_STORAGE_MEMORY;
+
+// Statistics of the cache of BLTE frame tables. The cache is shared by all files
+// open in the storage, so reopening a file doesn't need to read its BLTE header again
+typedef struct _CASC_FRAME_CACHE_INFO
+{
+    ULONGLONG Hits;                             // Number of frame tables taken from the cache
+    ULONGLONG Misses;                           // Number of frame tables that were not in the cache
+    ULONGLONG Evictions;                        // Number of frame tables removed to make space for new ones
+    ULONGLONG EntryCount;                       // Number of frame tables currently in the cache
+    ULONGLONG BytesUsed;                        // Memory used by the cached frame tables
+    ULONGLONG BytesMax;                         // Maximum memory of the cache. Zero if the cache is disabled
+
+} CASC_FRAME_CACHE_INFO, *PCASC_FRAME_CACHE_INFO;
+
+// Statistics of the CDN cache of an online storage. Hits and misses count
+// the data files that were needed by the storage; a miss means a download
+typedef struct _CASC_CDN_CACHE_INFO
+{
+    ULONGLONG Hits;                             // Number of files taken from the cache
+    ULONGLONG Misses;                           // Number of files that had to be downloaded
+    ULONGLONG Evictions;                        // Number of files removed to keep the cache within its budget
+    ULONGLONG BytesHit;                         // Total size of the files taken from the cache
+    ULONGLONG BytesStored;                      // Total size of the files stored to the cache
+    ULONGLONG EntryCount;                       // Number of files currently in the cache
+    ULONGLONG BytesUsed;                        // Total size of the files currently in the cache
+    ULONGLONG BytesMax;                         // Disk budget of the cache. Zero if the cache is disabled
+
+} CASC_CDN_CACHE_INFO, *PCASC_CDN_CACHE_INFO;
+
 typedef struct _CASC_FILE_FULL_INFO
 {
     BYTE CKey[MD5_HASH_SIZE];                   // CKey
@@ -289,6 +396,31 @@ typedef struct _CASC_FILE_SPAN_INFO
 
 } CASC_FILE_SPAN_INFO, *PCASC_FILE_SPAN_INFO;
 
+// Completion of an asynchronous read. See CascReadFileAsync
+typedef struct _CASC_READ_COMPLETION
+{
+    void * pvUserData;                          // The user value passed to CascReadFileAsync
+    HANDLE hFile;                               // The file handle passed to CascReadFileAsync
+    void * pvBuffer;                            // The buffer passed to CascReadFileAsync
+    ULONGLONG ByteOffset;                       // The byte offset passed to CascReadFileAsync
+    DWORD dwBytesRead;                          // Number of bytes read. Less than requested if the range goes beyond the end of the file
+    DWORD dwErrCode;                            // ERROR_SUCCESS or an error code. If nonzero, dwBytesRead is zero
+
+} CASC_READ_COMPLETION, *PCASC_READ_COMPLETION;
+
+// Result of a name resolution. See CascResolveFiles
+typedef struct _CASC_RESOLVED_FILE
+{
+    BYTE CKey[MD5_HASH_SIZE];                   // Content key of the file. Zeroed if not found
+    BYTE EKey[MD5_HASH_SIZE];                   // Encoded key of the file. Zeroed if not found
+    ULONGLONG ContentSize;                      // Content size of all spans. CASC_INVALID_SIZE64 if not known
+    ULONGLONG EncodedSize;                      // Encoded size of all spans. CASC_INVALID_SIZE64 if not known
+    DWORD dwSpanCount;                          // Number of spans forming the file
+    DWORD dwErrCode;                            // ERROR_SUCCESS, ERROR_FILE_NOT_FOUND or ERROR_INVALID_PARAMETER
+    DWORD bFileAvailable;                       // If true the file is available locally
+
+} CASC_RESOLVED_FILE, *PCASC_RESOLVED_FILE;
+
 //-----------------------------------------------------------------------------
 // Extended version of CascOpenStorage
 
@@ -329,7 +461,7 @@ typedef struct _CASC_OPEN_STORAGE_ARGS
     void * PtrProductParam;                     // Pointer-sized parameter that will be passed to PfnProgressCallback
 
     DWORD dwLocaleMask;                         // Locale mask to open
-    DWORD dwFlags;                              // Reserved. Set to zero.
+    DWORD dwFlags;                              // Open flags. See CASC_OPEN_XXX
 
     //
     // Any additional member from here on must be checked for availability using the ExtractVersionedArgument function.
@@ -344,8 +476,132 @@ typedef struct _CASC_OPEN_STORAGE_ARGS
     LPCTSTR szCdnHostUrl;                       // If non-null, specifies the custom CDN URL. Must contain protocol, can contain port number
                                                 // Example: http://eu.custom-wow-cdn.com:8000
 
+    HANDLE hBaseStorage;                        // If non-null, this is an open storage of a previous build of the same product.
+                                                // Unchanged index files and ENCODING pages are taken from it instead of being loaded again.
+                                                // The handle is only used during CascOpenStorageEx; it can be closed afterwards.
+
+    size_t cbFrameCache;                        // Maximum memory for the cache of BLTE frame tables. 0 = CASC_FRAME_CACHE_DEFAULT
+
+    LPCTSTR szSharedIndex;                      // Name of a shared memory segment with the storage index (optional).
+                                                // If the segment exists and matches the build and the index files, the storage index
+                                                // (file entries, their maps and tags) is mapped from it instead of being loaded.
+                                                // Otherwise the index is loaded and published under this name for the next process.
+                                                // POSIX: "/name" is a shm_open() name, anything else is a file path (e.g. "/proc/self/fd/N" for a memfd).
+                                                // Windows: name of a file mapping object. It exists as long as a storage that uses it is open.
+
+    LPCTSTR szCdnCache;                         // Online storages: directory of the CDN cache. NULL = "cache" in the local path.
+                                                // Data files downloaded from CDN are stored there by their encoded key; files from CDN archives
+                                                // are downloaded alone, not with the whole archive. The least recently used files are deleted
+                                                // when the cache exceeds CdnCacheSize. Only one open storage should use a cache directory at a time.
+    ULONGLONG CdnCacheSize;                     // Disk budget of the CDN cache, in bytes. 0 = CASC_CDN_CACHE_DEFAULT
+
 } CASC_OPEN_STORAGE_ARGS, *PCASC_OPEN_STORAGE_ARGS;
 
+//-----------------------------------------------------------------------------
+// Storage integrity check. See CascScrubStorage
+
+#define CASC_SCRUB_SKIP_CONTENT     0x00000001  // Don't decode the files and don't verify their content keys
+#define CASC_SCRUB_SKIP_ENCODING    0x00000002  // Don't verify the pages of the ENCODING manifest
+
+// Type of damage found by CascScrubStorage
+typedef enum _CASC_SCRUB_DAMAGE
+{
+    CascScrubReadError,                         // The entry could not be read from the data file
+    CascScrubLocalHeader,                       // The local header before the BLTE data doesn't match the index entry
+    CascScrubBlteHeader,                        // Bad BLTE header or frame table
+    CascScrubEKey,                              // MD5 of the BLTE header doesn't match the encoded key
+    CascScrubFrameHash,                         // MD5 of a frame doesn't match the frame table. dwDetail is the frame index
+    CascScrubContent,                           // The file could not be decoded or its MD5 doesn't match the content key
+    CascScrubIndexMismatch,                     // The entry overlaps with another entry or its size differs from the ENCODING manifest
+    CascScrubEncodingPage                       // MD5 of an ENCODING page doesn't match. dwDetail is the page index
+
+} CASC_SCRUB_DAMAGE, *PCASC_SCRUB_DAMAGE;
+
+// Damaged entry found by CascScrubStorage
+typedef struct _CASC_SCRUB_ENTRY
+{
+    BYTE EKey[MD5_HASH_SIZE];                   // Encoded key from the index file (only the first 9 bytes are stored there)
+    BYTE CKey[MD5_HASH_SIZE];                   // Content key of the file. Zeroed if the entry is not in the ENCODING manifest
+    ULONGLONG StorageOffset;                    // Storage offset from the index file
+    DWORD EncodedSize;                          // Encoded size from the index file, including the 0x1E-byte local header
+    DWORD ArchiveIndex;                         // Index of the data file ("data.%03u")
+    DWORD ArchiveOffs;                          // Offset of the entry in the data file
+    CASC_SCRUB_DAMAGE Damage;                   // Type of the damage
+    DWORD dwDetail;                             // Frame index or page index (see CASC_SCRUB_DAMAGE)
+    DWORD dwErrCode;                            // Error code of the failed operation, if any
+
+} CASC_SCRUB_ENTRY, *PCASC_SCRUB_ENTRY;
+
+typedef struct _CASC_SCRUB_ARGS
+{
+    size_t Size;                                // Length of this structure. Initialize to sizeof(CASC_SCRUB_ARGS)
+    DWORD dwFlags;                              // See CASC_SCRUB_XXX
+    DWORD dwThreadCount;                        // Number of threads. 0 = number of processors
+    PFNPROGRESSCALLBACK PfnProgressCallback;    // Progress callback (optional). Called from the worker threads, one call at a time
+    void * PtrProgressParam;                    // Pointer-sized parameter that will be passed to PfnProgressCallback
+    PCASC_SCRUB_ENTRY pDamaged;                 // Array that receives the damaged entries (optional)
+    size_t nMaxDamaged;                         // Number of items in the pDamaged array
+
+} CASC_SCRUB_ARGS, *PCASC_SCRUB_ARGS;
+
+typedef struct _CASC_SCRUB_RESULT
+{
+    size_t EntryCount;                          // Number of entries in the index files
+    size_t OrphanCount;                         // Entries that are not referenced by the ENCODING manifest
+    size_t EncryptedCount;                      // Files whose content was not verified because their key is not known
+    size_t DamagedCount;                        // Number of damaged entries. Only the first nMaxDamaged are stored
+    size_t EncodingPages;                       // Number of verified ENCODING pages
+    ULONGLONG FramesVerified;                   // Number of verified BLTE frames
+    ULONGLONG BytesVerified;                    // Number of encoded bytes read and verified
+    ULONGLONG ContentBytes;                     // Number of decoded bytes verified against the content keys
+    ULONGLONG ElapsedMs;                        // Duration of the check, in milliseconds
+    ULONGLONG BytesPerSecond;                   // Throughput of the check (BytesVerified per second)
+    DWORD dwThreadCount;                        // Number of threads used
+
+} CASC_SCRUB_RESULT, *PCASC_SCRUB_RESULT;
+
+//-----------------------------------------------------------------------------
+// Extraction of many files at once. See CascExtractFiles
+
+#define CASC_EXTRACT_VERIFY         0x00000001  // Verify the content key of each extracted file
+#define CASC_EXTRACT_NO_WRITE       0x00000002  // Only read (and verify) the files, don't write anything. The target directory may be NULL
+#define CASC_EXTRACT_DIRECT_IO      0x00000004  // Write the files with unbuffered I/O (O_DIRECT, FILE_FLAG_NO_BUFFERING), if the file system allows it
+#define CASC_EXTRACT_NO_HARDLINKS   0x00000008  // Write each file with the same content again, instead of creating a hard link
+
+typedef struct _CASC_EXTRACT_RESULT
+{
+    size_t FileCount;                           // Number of files that match the mask
+    size_t FilesExtracted;                      // Files read and written (or verified, with CASC_EXTRACT_NO_WRITE)
+    size_t FilesLinked;                         // Files with the same content as an extracted file. Created as hard links (or not read again, with CASC_EXTRACT_NO_WRITE)
+    size_t FilesSkipped;                        // Files not present in a local storage, or with the same target path as another file
+    size_t FilesEncrypted;                      // Files that could not be decrypted, because their key is not known
+    size_t FilesFailed;                         // Files that could not be read, verified or written
+    ULONGLONG ContentBytes;                     // Number of bytes read from the storage
+    ULONGLONG BytesWritten;                     // Number of bytes written to the target files
+    ULONGLONG ElapsedMs;                        // Duration of the extraction, in milliseconds
+    ULONGLONG BytesPerSecond;                   // Throughput of the extraction (ContentBytes per second)
+    DWORD dwThreadCount;                        // Number of threads used
+
+} CASC_EXTRACT_RESULT, *PCASC_EXTRACT_RESULT;
+
+// Reports the progress of CascExtractFiles. Called from the worker threads, one call at a time,
+// not more often than each 100 ms. The structure has the current values, including the throughput
+typedef bool (WINAPI * PFNEXTRACTCALLBACK)(     // Return 'true' to cancel the extraction
+    void * PtrUserParam,                        // User-specific parameter passed to the callback
+    PCASC_EXTRACT_RESULT pProgress              // Progress of the extraction so far
+    );
+
+typedef struct _CASC_EXTRACT_ARGS
+{
+    size_t Size;                                // Length of this structure. Initialize to sizeof(CASC_EXTRACT_ARGS)
+    DWORD dwFlags;                              // See CASC_EXTRACT_XXX
+    DWORD dwThreadCount;                        // Number of threads. 0 = number of processors. Online storages always use one thread
+    LPCTSTR szListFile;                         // Listfile for the file names (optional). See CascFindFirstFile
+    PFNEXTRACTCALLBACK PfnExtractCallback;      // Progress callback (optional)
+    void * PtrExtractParam;                     // Pointer-sized parameter that will be passed to PfnExtractCallback
+
+} CASC_EXTRACT_ARGS, *PCASC_EXTRACT_ARGS;
+
 //-----------------------------------------------------------------------------
 // Functions for storage manipulation
 
@@ -354,6 +610,7 @@ bool   WINAPI CascOpenStorage(LPCTSTR szParams, DWORD dwLocaleMask, HANDLE * phS
 bool   WINAPI CascOpenOnlineStorage(LPCTSTR szParams, DWORD dwLocaleMask, HANDLE * phStorage);
 bool   WINAPI CascGetStorageInfo(HANDLE hStorage, CASC_STORAGE_INFO_CLASS InfoClass, void * pvStorageInfo, size_t cbStorageInfo, size_t * pcbLengthNeeded);
 bool   WINAPI CascCloseStorage(HANDLE hStorage);
+bool   WINAPI CascScrubStorage(HANDLE hStorage, PCASC_SCRUB_ARGS pArgs, PCASC_SCRUB_RESULT pResult);
 
 bool   WINAPI CascOpenFile(HANDLE hStorage, const void * pvFileName, DWORD dwLocaleFlags, DWORD dwOpenFlags, HANDLE * PtrFileHandle);
 bool   WINAPI CascOpenLocalFile(LPCTSTR szFileName, DWORD dwOpenFlags, HANDLE * PtrFileHandle);
@@ -361,15 +618,33 @@ bool   WINAPI CascGetFileInfo(HANDLE hFile, CASC_FILE_INFO_CLASS InfoClass, void
 bool   WINAPI CascGetFileSize64(HANDLE hFile, PULONGLONG PtrFileSize);
 bool   WINAPI CascSetFilePointer64(HANDLE hFile, LONGLONG DistanceToMove, PULONGLONG PtrNewPos, DWORD dwMoveMethod);
 bool   WINAPI CascReadFile(HANDLE hFile, void * lpBuffer, DWORD dwToRead, PDWORD pdwRead);
+bool   WINAPI CascReadFileAt(HANDLE hFile, ULONGLONG ByteOffset, void * pvBuffer, DWORD dwBytesToRead, PDWORD PtrBytesRead);
 bool   WINAPI CascCloseFile(HANDLE hFile);
+bool   WINAPI CascReadWholeFile(HANDLE hStorage, const void * pvFileName, DWORD dwLocaleFlags, DWORD dwOpenFlags, void * pvBuffer, DWORD cbBuffer, PDWORD PtrBytesRead);
+bool   WINAPI CascResolveFiles(HANDLE hStorage, const void ** PtrFileNames, size_t nCount, DWORD dwOpenFlags, PCASC_RESOLVED_FILE pResults, size_t * PtrFound);
+bool   WINAPI CascExtractFiles(HANDLE hStorage, LPCSTR szMask, LPCTSTR szTargetDir, PCASC_EXTRACT_ARGS pArgs, PCASC_EXTRACT_RESULT pResult);
 
 DWORD  WINAPI CascGetFileSize(HANDLE hFile, PDWORD pdwFileSizeHigh);
 DWORD  WINAPI CascSetFilePointer(HANDLE hFile, LONG lFilePos, LONG * PtrFilePosHigh, DWORD dwMoveMethod);
 
+HANDLE WINAPI CascCreateReadQueue(DWORD dwQueueDepth, DWORD dwFlags);
+bool   WINAPI CascReadFileAsync(HANDLE hQueue, HANDLE hFile, ULONGLONG ByteOffset, void * pvBuffer, DWORD dwBytesToRead, void * pvUserData);
+bool   WINAPI CascGetReadCompletions(HANDLE hQueue, PCASC_READ_COMPLETION pCompletions, DWORD dwMaxCount, PDWORD PtrCount, bool bWait);
+bool   WINAPI CascCloseReadQueue(HANDLE hQueue);
+
+// The search mask may contain '*' and '?'. A mask that doesn't end with '*' or '?' only needs to match the begin
+// of the file name: "*.m2" also matches "Model.m2i" and "world\\maps" matches all files in that folder.
+// The match is case-insensitive and '/' matches '\\'. The same applies to the mask of CascExtractFiles
 HANDLE WINAPI CascFindFirstFile(HANDLE hStorage, LPCSTR szMask, PCASC_FIND_DATA pFindData, LPCTSTR szListFile);
+HANDLE WINAPI CascFindFirstTaggedFile(HANDLE hStorage, LPCSTR szTagQuery, PCASC_FIND_DATA pFindData);
 bool   WINAPI CascFindNextFile(HANDLE hFind, PCASC_FIND_DATA pFindData);
+bool   WINAPI CascFindNextFiles(HANDLE hFind, PCASC_FIND_DATA pFindData, DWORD dwMaxCount, PDWORD pdwFoundCount, DWORD dwFlags);
 bool   WINAPI CascFindClose(HANDLE hFind);
 
+// Gives names from the listfile to the files that don't have one. Fails with ERROR_ACCESS_DENIED
+// if the storage has open files or searches. No other thread may use the storage during the call
+bool   WINAPI CascApplyListFile(HANDLE hStorage, LPCTSTR szListFile);
+
 bool   WINAPI CascAddEncryptionKey(HANDLE hStorage, ULONGLONG KeyName, LPBYTE Key);
 bool   WINAPI CascAddStringEncryptionKey(HANDLE hStorage, ULONGLONG KeyName, LPCSTR szKey);
 bool   WINAPI CascImportKeysFromString(HANDLE hStorage, LPCSTR szKeyList);
@@ -23,12 +23,17 @@ TCascFile::TCascFile(TCascStorage * ahs, PCASC_CKEY_ENTRY apCKeyEntry)
     ClassName = CASC_MAGIC_FILE;
 
     FilePointer = 0;
+    FileNameHash = 0;
     pCKeyEntry = apCKeyEntry;
     SpanCount = (pCKeyEntry->SpanCount != 0) ? pCKeyEntry->SpanCount : 1;
     bVerifyIntegrity = false;
     bDownloadFileIf = false;
     bCloseFileStream = false;
     bFreeCKeyEntries = false;
+    pLastKey = NULL;
+    memset(FrameSlots, 0, sizeof(FrameSlots));
+    dwSlotUse = 0;
+    CascInitLock(FileLock);
 
     // Allocate the array of file spans
     if((pFileSpan = CASC_ALLOC_ZERO<CASC_FILE_SPAN>(SpanCount)) != NULL)
@@ -66,6 +71,9 @@ TCascFile::~TCascFile()
 
     // Free the file cache
     CASC_FREE(pbFileCache);
+    for(DWORD i = 0; i < CASC_FRAME_SLOTS; i++)
+        CASC_FREE(FrameSlots[i].pbData);
+    CascFreeLock(FileLock);
 
     // Close (dereference) the archive handle
     if(hs != NULL)
@@ -180,11 +188,35 @@ static size_t GetSpanFileCount(LPTSTR szSpanList)
 
 PCASC_CKEY_ENTRY FindCKeyEntry_CKey(TCascStorage * hs, LPBYTE pbCKey, PDWORD PtrIndex)
 {
+#ifndef CASC_NO_PERF_COUNTERS
+    if(hs->PerfCounters.IsEnabled())
+    {
+        PCASC_CKEY_ENTRY pCKeyEntry;
+        ULONGLONG Probes = 0;
+
+        pCKeyEntry = (PCASC_CKEY_ENTRY)hs->CKeyMap.FindObject(pbCKey, PtrIndex, &Probes);
+        CASC_PERF_ADD(hs, MapLookups, 1);
+        CASC_PERF_ADD(hs, MapProbes, Probes);
+        return pCKeyEntry;
+    }
+#endif
     return (PCASC_CKEY_ENTRY)hs->CKeyMap.FindObject(pbCKey, PtrIndex);
 }
 
 PCASC_CKEY_ENTRY FindCKeyEntry_EKey(TCascStorage * hs, LPBYTE pbEKey, PDWORD PtrIndex)
 {
+#ifndef CASC_NO_PERF_COUNTERS
+    if(hs->PerfCounters.IsEnabled())
+    {
+        PCASC_CKEY_ENTRY pCKeyEntry;
+        ULONGLONG Probes = 0;
+
+        pCKeyEntry = (PCASC_CKEY_ENTRY)hs->EKeyMap.FindObject(pbEKey, PtrIndex, &Probes);
+        CASC_PERF_ADD(hs, MapLookups, 1);
+        CASC_PERF_ADD(hs, MapProbes, Probes);
+        return pCKeyEntry;
+    }
+#endif
     return (PCASC_CKEY_ENTRY)hs->EKeyMap.FindObject(pbEKey, PtrIndex);
 }
 
@@ -299,35 +331,32 @@ bool SetCacheStrategy(HANDLE hFile, CSTRTG CacheStrategy)
     return false;
 }
 
+static void SetResolvedFile(PCASC_RESOLVED_FILE pResult, PCASC_CKEY_ENTRY pCKeyEntry, DWORD dwErrCode)
+{
+    memset(pResult, 0, sizeof(CASC_RESOLVED_FILE));
+    pResult->ContentSize = CASC_INVALID_SIZE64;
+    pResult->EncodedSize = CASC_INVALID_SIZE64;
+    pResult->dwErrCode = dwErrCode;
+
+    if(pCKeyEntry != NULL)
+    {
+        CopyMemory16(pResult->CKey, pCKeyEntry->CKey);
+        CopyMemory16(pResult->EKey, pCKeyEntry->EKey);
+        pResult->dwSpanCount = GetFileSpanInfo(pCKeyEntry, &pResult->ContentSize, &pResult->EncodedSize);
+        pResult->bFileAvailable = (pCKeyEntry->Flags & CASC_CE_FILE_IS_LOCAL) ? 1 : 0;
+    }
+}
+
 //-----------------------------------------------------------------------------
 // Public functions
 
-bool WINAPI CascOpenFile(HANDLE hStorage, const void * pvFileName, DWORD dwLocaleFlags, DWORD dwOpenFlags, HANDLE * PtrFileHandle)
+// Finds the CKey entry by the file name, CKey, EKey or file data id, depending on the open flags
+DWORD FindCKeyEntry_OpenName(TCascStorage * hs, const void * pvFileName, DWORD dwOpenFlags, PCASC_CKEY_ENTRY * PtrCKeyEntry, PULONGLONG PtrFileNameHash)
 {
     PCASC_CKEY_ENTRY pCKeyEntry = NULL;
-    TCascStorage * hs;
     const char * szFileName;
     DWORD FileDataId = CASC_INVALID_ID;
     BYTE CKeyEKeyBuffer[MD5_HASH_SIZE];
-    DWORD dwErrCode = ERROR_SUCCESS;
-
-    // This parameter is not used
-    CASCLIB_UNUSED(dwLocaleFlags);
-
-    // Validate the storage handle
-    hs = TCascStorage::IsValid(hStorage);
-    if(hs == NULL)
-    {
-        SetCascError(ERROR_INVALID_HANDLE);
-        return false;
-    }
-
-    // Validate the other parameters
-    if(PtrFileHandle == NULL)
-    {
-        SetCascError(ERROR_INVALID_PARAMETER);
-        return false;
-    }
 
     // Retrieve the CKey/EKey from the file name in different modes
     switch(dwOpenFlags & CASC_OPEN_TYPE_MASK)
@@ -337,15 +366,17 @@ bool WINAPI CascOpenFile(HANDLE hStorage, const void * pvFileName, DWORD dwLocal
             // The 'pvFileName' must be zero terminated ANSI file name
             szFileName = (const char *)pvFileName;
             if(szFileName == NULL || szFileName[0] == 0)
-            {
-                SetCascError(ERROR_INVALID_PARAMETER);
-                return false;
-            }
+                return ERROR_INVALID_PARAMETER;
 
             // The first chance: Try to find the file by name (using the root handler)
             pCKeyEntry = hs->pRootHandler->GetFile(hs, szFileName);
             if(pCKeyEntry != NULL)
+            {
+                // Give the hash of the name, if the caller wants it
+                if(PtrFileNameHash != NULL)
+                    PtrFileNameHash[0] = CalcFileNameHash(szFileName);
                 break;
+            }
 
             // Second chance: If the file name is actually a file data id, we convert it to file data ID
             if(IsFileDataIdName(szFileName, FileDataId))
@@ -366,18 +397,13 @@ bool WINAPI CascOpenFile(HANDLE hStorage, const void * pvFileName, DWORD dwLocal
                 if(pCKeyEntry != NULL)
                     break;
             }
-
-            SetCascError(ERROR_FILE_NOT_FOUND);
-            return false;
+            break;
 
         case CASC_OPEN_BY_CKEY:
 
             // The 'pvFileName' must be a pointer to 16-byte CKey or EKey
             if(pvFileName == NULL)
-            {
-                SetCascError(ERROR_INVALID_PARAMETER);
-                return false;
-            }
+                return ERROR_INVALID_PARAMETER;
 
             // Search the CKey map in order to find the CKey entry
             pCKeyEntry = FindCKeyEntry_CKey(hs, (LPBYTE)pvFileName);
@@ -387,10 +413,7 @@ bool WINAPI CascOpenFile(HANDLE hStorage, const void * pvFileName, DWORD dwLocal
 
             // The 'pvFileName' must be a pointer to 16-byte CKey or EKey
             if(pvFileName == NULL)
-            {
-                SetCascError(ERROR_INVALID_PARAMETER);
-                return false;
-            }
+                return ERROR_INVALID_PARAMETER;
 
             // Search the CKey map in order to find the CKey entry
             pCKeyEntry = FindCKeyEntry_EKey(hs, (LPBYTE)pvFileName);
@@ -405,12 +428,115 @@ bool WINAPI CascOpenFile(HANDLE hStorage, const void * pvFileName, DWORD dwLocal
         default:
 
             // Unknown open mode
-            dwErrCode = ERROR_INVALID_PARAMETER;
-            break;
+            return ERROR_INVALID_PARAMETER;
+    }
+
+    PtrCKeyEntry[0] = pCKeyEntry;
+    return (pCKeyEntry != NULL) ? ERROR_SUCCESS : ERROR_FILE_NOT_FOUND;
+}
+
+bool WINAPI CascOpenFile(HANDLE hStorage, const void * pvFileName, DWORD dwLocaleFlags, DWORD dwOpenFlags, HANDLE * PtrFileHandle)
+{
+    PCASC_CKEY_ENTRY pCKeyEntry = NULL;
+    TCascStorage * hs;
+    ULONGLONG FileNameHash = 0;
+    DWORD dwErrCode;
+
+    // This parameter is not used
+    CASCLIB_UNUSED(dwLocaleFlags);
+
+    // Validate the storage handle
+    hs = TCascStorage::IsValid(hStorage);
+    if(hs == NULL)
+    {
+        SetCascError(ERROR_INVALID_HANDLE);
+        return false;
+    }
+
+    // Validate the other parameters
+    if(PtrFileHandle == NULL)
+    {
+        SetCascError(ERROR_INVALID_PARAMETER);
+        return false;
+    }
+
+    // Find the CKey entry of the file. If the file is not there, OpenFileByCKeyEntry will fail
+    dwErrCode = FindCKeyEntry_OpenName(hs, pvFileName, dwOpenFlags, &pCKeyEntry, &FileNameHash);
+    if(dwErrCode == ERROR_INVALID_PARAMETER)
+    {
+        SetCascError(dwErrCode);
+        return false;
     }
 
     // Perform the open operation
-    return OpenFileByCKeyEntry(hs, pCKeyEntry, dwOpenFlags, PtrFileHandle);
+    if(!OpenFileByCKeyEntry(hs, pCKeyEntry, dwOpenFlags, PtrFileHandle))
+        return false;
+
+    // Remember the name hash. Root handlers that don't keep the file names
+    // in the file tree (MNDX) can't give it by CascGetFileInfo otherwise
+    ((TCascFile *)PtrFileHandle[0])->FileNameHash = FileNameHash;
+    return true;
+}
+
+bool WINAPI CascResolveFiles(HANDLE hStorage, const void ** PtrFileNames, size_t nCount, DWORD dwOpenFlags, PCASC_RESOLVED_FILE pResults, size_t * PtrFound)
+{
+    PCASC_CKEY_ENTRY CKeyEntries[CASC_RESOLVE_BATCH];
+    const char * FileNames[CASC_RESOLVE_BATCH];
+    TCascStorage * hs;
+    size_t nFound = 0;
+
+    // Validate the storage handle
+    hs = TCascStorage::IsValid(hStorage);
+    if(hs == NULL)
+    {
+        SetCascError(ERROR_INVALID_HANDLE);
+        return false;
+    }
+
+    // Validate the other parameters
+    if((PtrFileNames == NULL || pResults == NULL) && nCount != 0)
+    {
+        SetCascError(ERROR_INVALID_PARAMETER);
+        return false;
+    }
+
+    // Resolve the names in batches
+    for(size_t nStart = 0; nStart < nCount; nStart += CASC_RESOLVE_BATCH)
+    {
+        size_t nBatch = CASCLIB_MIN(nCount - nStart, CASC_RESOLVE_BATCH);
+
+        // Plain file names are hashed and looked up by the root handler all at once
+        memset(CKeyEntries, 0, sizeof(CKeyEntries));
+        if((dwOpenFlags & CASC_OPEN_TYPE_MASK) == CASC_OPEN_BY_NAME)
+        {
+            for(size_t i = 0; i < nBatch; i++)
+                FileNames[i] = (PtrFileNames[nStart + i] != NULL) ? (const char *)PtrFileNames[nStart + i] : "";
+            hs->pRootHandler->GetFiles(hs, FileNames, CKeyEntries, nBatch);
+
+            // Empty names are invalid, whatever the root handler found for them
+            for(size_t i = 0; i < nBatch; i++)
+                CKeyEntries[i] = (FileNames[i][0] != 0) ? CKeyEntries[i] : NULL;
+        }
+
+        // Anything the batch didn't find goes through the same lookup as CascOpenFile.
+        // That covers other open modes, root-specific lookups and FileDataId/CKey names.
+        for(size_t i = 0; i < nBatch; i++)
+        {
+            PCASC_CKEY_ENTRY pCKeyEntry = CKeyEntries[i];
+            DWORD dwErrCode = ERROR_SUCCESS;
+
+            if(pCKeyEntry == NULL)
+                dwErrCode = FindCKeyEntry_OpenName(hs, PtrFileNames[nStart + i], dwOpenFlags, &pCKeyEntry);
+
+            SetResolvedFile(&pResults[nStart + i], pCKeyEntry, dwErrCode);
+            nFound += (pCKeyEntry != NULL) ? 1 : 0;
+        }
+    }
+
+    // Give the number of found files
+    if(PtrFound != NULL)
+        PtrFound[0] = nFound;
+    return true;
 }
 
 bool WINAPI CascOpenLocalFile(LPCTSTR szFileName, DWORD dwOpenFlags, HANDLE * PtrFileHandle)
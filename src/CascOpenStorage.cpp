@@ -54,7 +54,7 @@ inline bool CheckForXKey(LPBYTE XKey)
 //-----------------------------------------------------------------------------
 // TCascStorage class functions
 
-TCascStorage::TCascStorage()
+TCascStorage::TCascStorage() : TaggedFiles(&Arena), KeyMap(&Arena)
 {
     // Prepare the base storage parameters
     ClassName = CASC_MAGIC_STORAGE;
@@ -77,6 +77,7 @@ TCascStorage::TCascStorage()
     LastFailKeyName = 0;
     LocalFiles = TotalFiles = EKeyEntries = EKeyLength = FileOffsetBits = 0;
     pArgs = NULL;
+    pBaseStorage = NULL;
 }
 
 TCascStorage::~TCascStorage()
@@ -96,6 +97,13 @@ TCascStorage::~TCascStorage()
     // Cleanup space occupied by index files
     FreeIndexFiles(this);
 
+    // Free the bitsets of the tags
+    for(size_t i = 0; i < TagsArray.ItemCount(); i++)
+    {
+        PCASC_TAG_ENTRY2 pTag = (PCASC_TAG_ENTRY2)TagsArray.ItemAt(i);
+        delete pTag->pFileBits;
+    }
+
     // Cleanup the lock
     CascFreeLock(StorageLock);
 
@@ -223,23 +231,24 @@ static PCASC_CKEY_ENTRY InsertCKeyEntry(TCascStorage * hs, CASC_CKEY_ENTRY & CKe
 }
 
 // Inserts an entry from ENCODING
-static PCASC_CKEY_ENTRY InsertCKeyEntry(TCascStorage * hs, PFILE_CKEY_ENTRY pFileEntry)
+// If the entry is copied from the base storage, pBaseEntry is the original entry
+static PCASC_CKEY_ENTRY InsertCKeyEntry(TCascStorage * hs, LPBYTE CKey, LPBYTE EKey, DWORD ContentSize, PCASC_CKEY_ENTRY pBaseEntry = NULL)
 {
     PCASC_CKEY_ENTRY pCKeyEntry;
 
     // Stop on file-of-interest
-    BREAK_ON_WATCHED(pFileEntry->EKey);
+    BREAK_ON_WATCHED(EKey);
 
     // Insert a new entry to the array. DO NOT ALLOW enlarge array here
     pCKeyEntry = (PCASC_CKEY_ENTRY)hs->CKeyArray.Insert(1, false);
     if(pCKeyEntry != NULL)
     {
         // Initialize the entry
-        CopyMemory16(pCKeyEntry->CKey, pFileEntry->CKey);
-        CopyMemory16(pCKeyEntry->EKey, pFileEntry->EKey);
+        CopyMemory16(pCKeyEntry->CKey, CKey);
+        CopyMemory16(pCKeyEntry->EKey, EKey);
         pCKeyEntry->StorageOffset = CASC_INVALID_OFFS64;
         pCKeyEntry->TagBitMask = 0;
-        pCKeyEntry->ContentSize = ConvertBytesToInteger_4(pFileEntry->ContentSize);
+        pCKeyEntry->ContentSize = ContentSize;
         pCKeyEntry->EncodedSize = CASC_INVALID_SIZE;
         pCKeyEntry->Flags = CASC_CE_HAS_CKEY | CASC_CE_HAS_EKEY | CASC_CE_IN_ENCODING;
         pCKeyEntry->RefCount = 0;
@@ -247,7 +256,7 @@ static PCASC_CKEY_ENTRY InsertCKeyEntry(TCascStorage * hs, PFILE_CKEY_ENTRY pFil
         pCKeyEntry->Priority = 0;
 
         // Copy the information from index files to the CKey entry
-        CopyEKeyEntry(hs, pCKeyEntry);
+        CopyEKeyEntry(hs, pCKeyEntry, pBaseEntry);
 
         // Insert the item into both maps
         hs->CKeyMap.InsertObject(pCKeyEntry, pCKeyEntry->CKey);
@@ -261,6 +270,11 @@ static PCASC_CKEY_ENTRY InsertCKeyEntry(TCascStorage * hs, PFILE_CKEY_ENTRY pFil
     return pCKeyEntry;
 }
 
+static PCASC_CKEY_ENTRY InsertCKeyEntry(TCascStorage * hs, PFILE_CKEY_ENTRY pFileEntry)
+{
+    return InsertCKeyEntry(hs, pFileEntry->CKey, pFileEntry->EKey, ConvertBytesToInteger_4(pFileEntry->ContentSize));
+}
+
 // Inserts an entry from DOWNLOAD
 static PCASC_CKEY_ENTRY InsertCKeyEntry(TCascStorage * hs, CASC_DOWNLOAD_ENTRY & DlEntry)
 {
@@ -448,9 +462,97 @@ static int LoadEncodingCKeyPage(TCascStorage * hs, CASC_ENCODING_HEADER & EnHead
     return ERROR_SUCCESS;
 }
 
+// Remembers the range of CKeyArray that was loaded from one ENCODING page.
+// The next build, opened with this storage as base, can copy the entries
+static DWORD InsertEncodingPage(TCascStorage * hs, LPBYTE SegmentHash, size_t FirstEntry)
+{
+    PCASC_ENCODING_PAGE pPage;
+
+    if((pPage = (PCASC_ENCODING_PAGE)hs->EncodingPages.Insert(1)) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    CopyMemory16(pPage->SegmentHash, SegmentHash);
+    pPage->FirstEntry = FirstEntry;
+    pPage->EntryCount = hs->CKeyArray.ItemCount() - FirstEntry;
+    return ERROR_SUCCESS;
+}
+
+// Copies the entries of an unchanged ENCODING page from the base storage.
+// Only the values that come from ENCODING are taken; the rest
+// is filled-in the same way as if the page was loaded from the file
+static DWORD CopyEncodingCKeyPage(TCascStorage * hs, PCASC_ENCODING_PAGE pBasePage)
+{
+    TCascStorage * pBaseStorage = hs->pBaseStorage;
+    PCASC_CKEY_ENTRY pBaseEntry;
+
+    for(size_t i = 0; i < pBasePage->EntryCount; i++)
+    {
+        if((pBaseEntry = (PCASC_CKEY_ENTRY)pBaseStorage->CKeyArray.ItemAt(pBasePage->FirstEntry + i)) == NULL)
+            return ERROR_FILE_CORRUPT;
+        InsertCKeyEntry(hs, pBaseEntry->CKey, pBaseEntry->EKey, pBaseEntry->ContentSize, pBaseEntry);
+    }
+
+    CASC_PERF_ADD(hs, OpenReusedPages, 1);
+    return ERROR_SUCCESS;
+}
+
+// The ENCODING manifest is the same as in the base storage. Instead of loading it,
+// we copy all its pages
+static DWORD CopyEncodingManifest(TCascStorage * hs)
+{
+    TCascStorage * pBaseStorage = hs->pBaseStorage;
+    PCASC_ENCODING_PAGE pBasePage;
+    size_t nPageCount = pBaseStorage->EncodingPages.ItemCount();
+    size_t FirstEntry;
+    DWORD dwErrCode;
+
+    // Create the array of the ENCODING pages
+    dwErrCode = hs->EncodingPages.Create(sizeof(CASC_ENCODING_PAGE), nPageCount);
+    if(dwErrCode != ERROR_SUCCESS)
+        return dwErrCode;
+
+    // Copy all pages
+    for(size_t i = 0; i < nPageCount; i++)
+    {
+        pBasePage = (PCASC_ENCODING_PAGE)pBaseStorage->EncodingPages.ItemAt(i);
+        FirstEntry = hs->CKeyArray.ItemCount();
+
+        if((dwErrCode = CopyEncodingCKeyPage(hs, pBasePage)) != ERROR_SUCCESS)
+            return dwErrCode;
+        if((dwErrCode = InsertEncodingPage(hs, pBasePage->SegmentHash, FirstEntry)) != ERROR_SUCCESS)
+            return dwErrCode;
+    }
+
+    // All CKey->EKey entries from the text build files need to be copied to the CKey array
+    return CopyBuildFileItemsToCKeyArray(hs);
+}
+
+// Creates map of SegmentHash -> CASC_ENCODING_PAGE of the base storage
+static DWORD CreateBasePageMap(TCascStorage * hs, CASC_MAP & BasePageMap)
+{
+    TCascStorage * pBaseStorage = hs->pBaseStorage;
+    PCASC_ENCODING_PAGE pBasePage;
+    size_t nPageCount = pBaseStorage->EncodingPages.ItemCount();
+    DWORD dwErrCode;
+
+    dwErrCode = BasePageMap.Create(nPageCount, MD5_HASH_SIZE, FIELD_OFFSET(CASC_ENCODING_PAGE, SegmentHash));
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        for(size_t i = 0; i < nPageCount; i++)
+        {
+            pBasePage = (PCASC_ENCODING_PAGE)pBaseStorage->EncodingPages.ItemAt(i);
+            BasePageMap.InsertObject(pBasePage, pBasePage->SegmentHash);
+        }
+    }
+
+    return dwErrCode;
+}
+
 static int LoadEncodingManifest(TCascStorage * hs)
 {
     CASC_CKEY_ENTRY & CKeyEntry = hs->EncodingCKey;
+    TCascStorage * pBaseStorage = hs->pBaseStorage;
+    CASC_MAP BasePageMap;
     LPBYTE pbEncodingFile;
     DWORD cbEncodingFile = 0;
     DWORD dwErrCode = ERROR_SUCCESS;
@@ -464,6 +566,15 @@ static int LoadEncodingManifest(TCascStorage * hs)
         return ERROR_FILE_NOT_FOUND;
     InsertCKeyEntry(hs, CKeyEntry);
 
+    // If the base storage has the same ENCODING manifest, we don't need to load it at all
+    if(pBaseStorage != NULL && pBaseStorage->EncodingPages.ItemCount() != 0)
+    {
+        if(!memcmp(pBaseStorage->EncodingCKey.CKey, CKeyEntry.CKey, MD5_HASH_SIZE))
+            return CopyEncodingManifest(hs);
+        if((dwErrCode = CreateBasePageMap(hs, BasePageMap)) != ERROR_SUCCESS)
+            return dwErrCode;
+    }
+
     // Load the entire encoding file to memory
     pbEncodingFile = LoadInternalFileToMemory(hs, &hs->EncodingCKey, &cbEncodingFile);
     if(pbEncodingFile != NULL && cbEncodingFile != 0)
@@ -472,15 +583,24 @@ static int LoadEncodingManifest(TCascStorage * hs)
 
         // Capture the header of the ENCODING file
         dwErrCode = CaptureEncodingHeader(EnHeader, pbEncodingFile, cbEncodingFile);
+        if(dwErrCode == ERROR_SUCCESS)
+        {
+            // Create the array of the ENCODING pages
+            dwErrCode = hs->EncodingPages.Create(sizeof(CASC_ENCODING_PAGE), EnHeader.CKeyPageCount);
+        }
+
         if(dwErrCode == ERROR_SUCCESS)
         {
             // Get the CKey page header and the first page
             PFILE_CKEY_PAGE pPageHeader = (PFILE_CKEY_PAGE)(pbEncodingFile + sizeof(FILE_ENCODING_HEADER) + EnHeader.ESpecBlockSize);
+            PCASC_ENCODING_PAGE pBasePage;
             LPBYTE pbCKeyPage = (LPBYTE)(pPageHeader + EnHeader.CKeyPageCount);
 
             // Go through all CKey pages and verify them
             for(DWORD i = 0; i < EnHeader.CKeyPageCount; i++)
             {
+                size_t FirstEntry = hs->CKeyArray.ItemCount();
+
                 // Check if there is enough space in the buffer
                 if((pbCKeyPage + EnHeader.CKeyPageSize) > (pbEncodingFile + cbEncodingFile))
                 {
@@ -503,12 +623,19 @@ static int LoadEncodingManifest(TCascStorage * hs)
                     break;
                 }
 
-                // Load the entire page of CKey entries.
+                // If the base storage has the same page, copy its entries. Otherwise, load the entire page of CKey entries.
                 // This operation will never fail, because all memory is already pre-allocated
-                dwErrCode = LoadEncodingCKeyPage(hs, EnHeader, pbCKeyPage, pbCKeyPage + EnHeader.CKeyPageSize);
+                if((pBasePage = (PCASC_ENCODING_PAGE)BasePageMap.FindObject(pPageHeader[i].SegmentHash)) != NULL)
+                    dwErrCode = CopyEncodingCKeyPage(hs, pBasePage);
+                else
+                    dwErrCode = LoadEncodingCKeyPage(hs, EnHeader, pbCKeyPage, pbCKeyPage + EnHeader.CKeyPageSize);
                 if(dwErrCode != ERROR_SUCCESS)
                     break;
 
+                // Remember the range of entries loaded from the page
+                if((dwErrCode = InsertEncodingPage(hs, pPageHeader[i].SegmentHash, FirstEntry)) != ERROR_SUCCESS)
+                    break;
+
                 // Move to the next CKey page
                 pbCKeyPage += EnHeader.CKeyPageSize;
             }
@@ -650,15 +777,181 @@ int CaptureDownloadTag(CASC_DOWNLOAD_HEADER & DlHeader, CASC_TAG_ENTRY1 & DlTag,
     return ERROR_SUCCESS;
 }
 
+// Creates the array of tags, or makes its entries longer if the tags of this manifest
+// have longer names than the tags that are already there (from the other manifest)
+static DWORD PrepareTagsArray(TCascStorage * hs, PCASC_TAG_ENTRY1 TagArray, size_t nTagCount)
+{
+    LPBYTE pbOldTags;
+    size_t nOldEntryLength = hs->TagsArray.ItemSize();
+    size_t nOldTagCount = hs->TagsArray.ItemCount();
+    size_t nMaxNameLength = 0;
+    size_t nTagEntryLengh;
+    DWORD dwErrCode;
+
+    // Get the longest tag name
+    for(size_t i = 0; i < nTagCount; i++)
+        nMaxNameLength = CASCLIB_MAX(nMaxNameLength, TagArray[i].NameLength);
+
+    // Determine the tag entry length
+    nTagEntryLengh = FIELD_OFFSET(CASC_TAG_ENTRY2, szTagName) + nMaxNameLength;
+    nTagEntryLengh = ALIGN_TO_SIZE(nTagEntryLengh, 8);
+
+    // Create the array of tags in the storage structure, if this is the first manifest with tags
+    if(hs->TagsArray.IsInitialized() == false)
+        return hs->TagsArray.Create(nTagEntryLengh, CASCLIB_MAX(nTagCount, 1));
+
+    // Do the names fit into the existing entries?
+    if(nTagEntryLengh <= nOldEntryLength)
+        return ERROR_SUCCESS;
+
+    // Save the existing entries. The bitsets of the tags are moved by pointer
+    if((pbOldTags = CASC_ALLOC<BYTE>(nOldTagCount * nOldEntryLength + 1)) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    memcpy(pbOldTags, hs->TagsArray.ItemArray(), nOldTagCount * nOldEntryLength);
+
+    // Recreate the array with the longer entries and put the existing tags back
+    hs->TagsArray.Free();
+    if((dwErrCode = hs->TagsArray.Create(nTagEntryLengh, CASCLIB_MAX(nOldTagCount + nTagCount, 1))) == ERROR_SUCCESS)
+    {
+        for(size_t i = 0; i < nOldTagCount; i++)
+        {
+            LPBYTE pbNewTag = (LPBYTE)hs->TagsArray.Insert(1);
+
+            memset(pbNewTag, 0, nTagEntryLengh);
+            memcpy(pbNewTag, pbOldTags + i * nOldEntryLength, nOldEntryLength);
+        }
+    }
+    else
+    {
+        // Don't leak the bitsets of the tags that are lost
+        for(size_t i = 0; i < nOldTagCount; i++)
+            delete ((PCASC_TAG_ENTRY2)(pbOldTags + i * nOldEntryLength))->pFileBits;
+    }
+
+    CASC_FREE(pbOldTags);
+    return dwErrCode;
+}
+
+static DWORD FindOrInsertTag(TCascStorage * hs, CASC_TAG_ENTRY1 & SourceTag, PCASC_TAG_ENTRY2 * PtrTag)
+{
+    PCASC_TAG_ENTRY2 pTargetTag;
+    size_t nTagEntryLengh = hs->TagsArray.ItemSize();
+
+    // Is there a tag with the same name already?
+    for(size_t i = 0; i < hs->TagsArray.ItemCount(); i++)
+    {
+        pTargetTag = (PCASC_TAG_ENTRY2)hs->TagsArray.ItemAt(i);
+        if(pTargetTag->NameLength == SourceTag.NameLength && !memcmp(pTargetTag->szTagName, SourceTag.szTagName, SourceTag.NameLength))
+        {
+            PtrTag[0] = pTargetTag;
+            return ERROR_SUCCESS;
+        }
+    }
+
+    // The name must fit into the tag entry. PrepareTagsArray made the entries long enough
+    assert((FIELD_OFFSET(CASC_TAG_ENTRY2, szTagName) + SourceTag.NameLength) <= nTagEntryLengh);
+
+    // Insert the tag to the array
+    if((pTargetTag = (PCASC_TAG_ENTRY2)hs->TagsArray.Insert(1)) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    memset(pTargetTag, 0, nTagEntryLengh);
+    memcpy(pTargetTag->szTagName, SourceTag.szTagName, SourceTag.NameLength);
+    pTargetTag->NameLength = SourceTag.NameLength;
+    pTargetTag->TagValue = SourceTag.TagValue;
+    PtrTag[0] = pTargetTag;
+    return ERROR_SUCCESS;
+}
+
+// Inserts the tags of a DOWNLOAD or INSTALL manifest to the storage.
+// For each tag, we build a bitset of the tagged files (their indexes in CKeyArray),
+// so that the tag queries don't need to check every file in the storage.
+// EntryIndexes gives the CKeyArray index of each manifest entry (CASC_INVALID_INDEX if none).
+// Tags that are already known from the other manifest are merged by name.
+DWORD InsertManifestTags(TCascStorage * hs, PCASC_TAG_ENTRY1 TagArray, size_t nTagCount, PDWORD EntryIndexes, size_t nEntryCount)
+{
+    PCASC_CKEY_ENTRY pCKeyEntry;
+    PCASC_TAG_ENTRY2 pTag;
+    CASC_BITSET FileBits;
+    ULONGLONG * pBitmap;
+    size_t nBitCount = hs->CKeyArray.ItemCount();
+    size_t nWordCount = (nBitCount / 64) + 1;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // Create the tag array, or make sure that the tag names of this manifest fit into it
+    if((dwErrCode = PrepareTagsArray(hs, TagArray, nTagCount)) != ERROR_SUCCESS)
+        return dwErrCode;
+
+    // Allocate the plain bitmap that is compressed to the bitsets
+    if((pBitmap = CASC_ALLOC_ZERO<ULONGLONG>(nWordCount)) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    // Remember all files of the manifest. Negated tags in the queries are taken from this set
+    for(size_t i = 0; i < nEntryCount; i++)
+    {
+        if(EntryIndexes[i] != CASC_INVALID_INDEX)
+            pBitmap[EntryIndexes[i] / 64] |= (ULONGLONG)1 << (EntryIndexes[i] % 64);
+    }
+    if((dwErrCode = FileBits.Create(pBitmap, nBitCount)) == ERROR_SUCCESS)
+        dwErrCode = hs->TaggedFiles.Or(FileBits);
+
+    // Build the bitset of each tag
+    for(size_t i = 0; i < nTagCount && dwErrCode == ERROR_SUCCESS; i++)
+    {
+        CASC_TAG_ENTRY1 & SourceTag = TagArray[i];
+        ULONGLONG TagBit = 0;
+        size_t nTagIndex;
+
+        // Find or insert the tag
+        if((dwErrCode = FindOrInsertTag(hs, SourceTag, &pTag)) != ERROR_SUCCESS)
+            break;
+
+        // The CASC_CKEY_ENTRY::TagBitMask can only hold the first 64 tags
+        nTagIndex = hs->TagsArray.IndexOf(pTag);
+        if(nTagIndex < 64)
+            TagBit = (ULONGLONG)1 << nTagIndex;
+
+        // Convert the manifest bitmap (one bit per manifest entry, MSB first) to a bitmap of CKeyArray indexes.
+        // Zero bytes of the manifest bitmap are skipped at once
+        memset(pBitmap, 0, nWordCount * sizeof(ULONGLONG));
+        for(size_t nByteIndex = 0; nByteIndex < SourceTag.BitmapLength; nByteIndex++)
+        {
+            BYTE BitMask = SourceTag.Bitmap[nByteIndex];
+
+            for(size_t nEntry = nByteIndex * 8; BitMask != 0 && nEntry < nEntryCount; nEntry++, BitMask <<= 1)
+            {
+                if((BitMask & 0x80) && EntryIndexes[nEntry] != CASC_INVALID_INDEX)
+                {
+                    pBitmap[EntryIndexes[nEntry] / 64] |= (ULONGLONG)1 << (EntryIndexes[nEntry] % 64);
+
+                    pCKeyEntry = (PCASC_CKEY_ENTRY)hs->CKeyArray.ItemAt(EntryIndexes[nEntry]);
+                    pCKeyEntry->TagBitMask |= TagBit;
+                }
+            }
+        }
+
+        // Compress the bitmap and merge it with the existing bitset of the tag
+        if(pTag->pFileBits == NULL && (pTag->pFileBits = new CASC_BITSET(&hs->Arena)) == NULL)
+            dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+        if(dwErrCode == ERROR_SUCCESS)
+            dwErrCode = FileBits.Create(pBitmap, nBitCount);
+        if(dwErrCode == ERROR_SUCCESS)
+            dwErrCode = pTag->pFileBits->Or(FileBits);
+    }
+
+    CASC_FREE(pBitmap);
+    return dwErrCode;
+}
+
 static int LoadDownloadManifest(TCascStorage * hs, CASC_DOWNLOAD_HEADER & DlHeader, LPBYTE pbFileData, LPBYTE pbFileEnd)
 {
     PCASC_TAG_ENTRY1 TagArray = NULL;
+    PDWORD EntryIndexes = NULL;
     LPBYTE pbEntries = pbFileData + DlHeader.HeaderLength;
     LPBYTE pbEntry = pbEntries;
     LPBYTE pbTags = pbEntries + DlHeader.EntryLength * DlHeader.EntryCount;
     LPBYTE pbTag = pbTags;
-    size_t nMaxNameLength = 0;
-    size_t nTagEntryLengh = 0;
+    size_t nTagCount = 0;
     DWORD dwErrCode = ERROR_SUCCESS;
 
     // Does the storage support tags?
@@ -667,63 +960,33 @@ static int LoadDownloadManifest(TCascStorage * hs, CASC_DOWNLOAD_HEADER & DlHead
         // Remember that we support tags
         hs->dwFeatures |= CASC_FEATURE_TAGS;
 
-        // Allocate space for the tag array
+        // Allocate space for the tag array and for the CKeyArray index of each entry
         TagArray = CASC_ALLOC<CASC_TAG_ENTRY1>(DlHeader.TagCount);
-        if(TagArray != NULL)
+        EntryIndexes = CASC_ALLOC<DWORD>(DlHeader.EntryCount);
+        if(TagArray == NULL || EntryIndexes == NULL)
         {
-            // Get the longest tag name
-            for(DWORD i = 0; i < DlHeader.TagCount; i++)
-            {
-                if(CaptureDownloadTag(DlHeader, TagArray[i], pbTag, pbFileEnd) == ERROR_SUCCESS)
-                    nMaxNameLength = CASCLIB_MAX(nMaxNameLength, TagArray[i].NameLength);
-                pbTag = pbTag + TagArray[i].TagLength;
-            }
-
-            // Determine the tag entry length
-            nTagEntryLengh = FIELD_OFFSET(CASC_TAG_ENTRY2, szTagName) + nMaxNameLength;
-            nTagEntryLengh = ALIGN_TO_SIZE(nTagEntryLengh, 8);
-
-            // Load the tags into array in the storage structure
-            dwErrCode = hs->TagsArray.Create(nTagEntryLengh, DlHeader.TagCount);
-            if(dwErrCode == ERROR_SUCCESS)
-            {
-                // Convert the array of CASC_DOWNLOAD_TAG1 to array of CASC_DOWNLOAD_TAG2
-                for(DWORD i = 0; i < DlHeader.TagCount; i++)
-                {
-                    PCASC_TAG_ENTRY1 pSourceTag = &TagArray[i];
-                    PCASC_TAG_ENTRY2 pTargetTag;
-
-                    // Insert the tag to the array
-                    pTargetTag = (PCASC_TAG_ENTRY2)hs->TagsArray.Insert(1);
-                    if(pTargetTag == NULL)
-                    {
-                        dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
-                        break;
-                    }
-
-                    // Copy the tag structure
-                    memset(pTargetTag, 0, nTagEntryLengh);
-                    memcpy(pTargetTag->szTagName, pSourceTag->szTagName, pSourceTag->NameLength);
-                    pTargetTag->NameLength = pSourceTag->NameLength;
-                    pTargetTag->TagValue = pSourceTag->TagValue;
-                }
-            }
+            CASC_FREE(EntryIndexes);
+            CASC_FREE(TagArray);
+            return ERROR_NOT_ENOUGH_MEMORY;
         }
-        else
+
+        // Capture all tags
+        while(nTagCount < DlHeader.TagCount)
         {
-            dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+            if(CaptureDownloadTag(DlHeader, TagArray[nTagCount], pbTag, pbFileEnd) != ERROR_SUCCESS)
+                break;
+            pbTag = pbTag + TagArray[nTagCount++].TagLength;
         }
+
+        // Entries that fail to load won't have any tag
+        memset(EntryIndexes, 0xFF, DlHeader.EntryCount * sizeof(DWORD));
     }
 
-    // Now parse all entries. For each entry, mark the corresponding tag bit in the EKey table
+    // Now parse all entries. For each entry, remember its index in the CKey table
     for(DWORD i = 0; i < DlHeader.EntryCount; i++)
     {
         CASC_DOWNLOAD_ENTRY DlEntry;
         PCASC_CKEY_ENTRY pCKeyEntry;
-        ULONGLONG TagBit = 1;
-        size_t BitMaskOffset = (i / 8);
-        size_t TagItemCount = hs->TagsArray.ItemCount();
-        BYTE BitMaskBit = 0x80 >> (i % 8);
 
         // Capture the download entry
         if(CaptureDownloadEntry(DlHeader, DlEntry, pbEntry, pbFileEnd) != ERROR_SUCCESS)
@@ -733,25 +996,19 @@ static int LoadDownloadManifest(TCascStorage * hs, CASC_DOWNLOAD_HEADER & DlHead
         //BREAK_ON_XKEY3(DlEntry.EKey, 0xa5, 0x00, 0x16);
 
         // Insert the entry to the central CKey table
-        if((pCKeyEntry = InsertCKeyEntry(hs, DlEntry)) != NULL)
-        {
-            // Supply the tag bits
-            for(size_t j = 0; j < TagItemCount; j++)
-            {
-                // Set the bit in the entry, if the tag for it is present
-                if((BitMaskOffset < TagArray[j].BitmapLength) && (TagArray[j].Bitmap[BitMaskOffset] & BitMaskBit))
-                    pCKeyEntry->TagBitMask |= TagBit;
-
-                // Move to the next bit
-                TagBit <<= 1;
-            }
-        }
+        if((pCKeyEntry = InsertCKeyEntry(hs, DlEntry)) != NULL && EntryIndexes != NULL)
+            EntryIndexes[i] = (DWORD)hs->CKeyArray.IndexOf(pCKeyEntry);
 
         // Move to the next entry
         pbEntry += DlHeader.EntryLength;
     }
 
+    // Build the tag bitsets and the tag bit masks of the entries
+    if(TagArray != NULL)
+        dwErrCode = InsertManifestTags(hs, TagArray, nTagCount, EntryIndexes, DlHeader.EntryCount);
+
     // Free the tag array, if any
+    CASC_FREE(EntryIndexes);
     CASC_FREE(TagArray);
 
     // Remember the total file count
@@ -951,14 +1208,14 @@ static DWORD GetStorageTotalFileCount(TCascStorage * hs)
     {
         if((pCKeyEntry = (PCASC_CKEY_ENTRY)hs->CKeyArray.ItemAt(i)) != NULL)
         {
-            if(pCKeyEntry->IsFile())
+            if(hs->CKeyRefs.IsFile(pCKeyEntry))
             {
                 // If there is zero or one file name reference, we count the item as one file.
                 // If there is more than 1 name reference, we count the file as many times as number of references
-                DWORD RefCount = (pCKeyEntry->RefCount > 0) ? pCKeyEntry->RefCount : 1;
+                DWORD RefCount = hs->CKeyRefs.RefCount(pCKeyEntry);
 
                 // Add the number of references to the total file count
-                TotalFileCount += RefCount;
+                TotalFileCount += (RefCount > 0) ? RefCount : 1;
             }
         }
     }
@@ -1083,6 +1340,53 @@ static bool GetStoragePathProduct(TCascStorage * hs, void * pvStorageInfo, size_
     return (szBuffer != NULL);
 }
 
+static bool GetStoragePerfCounters(TCascStorage * hs, void * pvStorageInfo, size_t cbStorageInfo, size_t * pcbLengthNeeded)
+{
+    PCASC_STORAGE_PERF_COUNTERS pCounters;
+
+    // The counters are only available if the storage was open with CASC_OPEN_PERF_COUNTERS
+    if(!hs->PerfCounters.IsEnabled())
+    {
+        SetCascError(ERROR_NOT_SUPPORTED);
+        return false;
+    }
+
+    pCounters = (PCASC_STORAGE_PERF_COUNTERS)ProbeOutputBuffer(pvStorageInfo, cbStorageInfo, sizeof(CASC_STORAGE_PERF_COUNTERS), pcbLengthNeeded);
+    if(pCounters != NULL)
+        hs->PerfCounters.Collect(pCounters);
+    return (pCounters != NULL);
+}
+
+static bool GetStorageMemory(TCascStorage * hs, void * pvStorageInfo, size_t cbStorageInfo, size_t * pcbLengthNeeded)
+{
+    PCASC_STORAGE_MEMORY pMemory;
+
+    pMemory = (PCASC_STORAGE_MEMORY)ProbeOutputBuffer(pvStorageInfo, cbStorageInfo, sizeof(CASC_STORAGE_MEMORY), pcbLengthNeeded);
+    if(pMemory != NULL)
+        hs->Arena.Collect(pMemory);
+    return (pMemory != NULL);
+}
+
+static bool GetStorageFrameCache(TCascStorage * hs, void * pvStorageInfo, size_t cbStorageInfo, size_t * pcbLengthNeeded)
+{
+    PCASC_FRAME_CACHE_INFO pInfo;
+
+    pInfo = (PCASC_FRAME_CACHE_INFO)ProbeOutputBuffer(pvStorageInfo, cbStorageInfo, sizeof(CASC_FRAME_CACHE_INFO), pcbLengthNeeded);
+    if(pInfo != NULL)
+        hs->FrameCache.Collect(pInfo);
+    return (pInfo != NULL);
+}
+
+static bool GetStorageCdnCache(TCascStorage * hs, void * pvStorageInfo, size_t cbStorageInfo, size_t * pcbLengthNeeded)
+{
+    PCASC_CDN_CACHE_INFO pInfo;
+
+    pInfo = (PCASC_CDN_CACHE_INFO)ProbeOutputBuffer(pvStorageInfo, cbStorageInfo, sizeof(CASC_CDN_CACHE_INFO), pcbLengthNeeded);
+    if(pInfo != NULL)
+        hs->CdnCache.Collect(pInfo);
+    return (pInfo != NULL);
+}
+
 static DWORD InitializeLocalDirectories(TCascStorage * hs, PCASC_OPEN_STORAGE_ARGS pArgs)
 {
     LPTSTR szWorkPath;
@@ -1154,15 +1458,41 @@ static DWORD LoadCascStorage(TCascStorage * hs, PCASC_OPEN_STORAGE_ARGS pArgs)
     LPCTSTR szCodeName = NULL;
     LPCTSTR szRegion = NULL;
     LPCTSTR szBuildKey = NULL;
+    LPCTSTR szSharedIndex = NULL;
+    LPCTSTR szCdnCache = NULL;
+    HANDLE hBaseStorage = NULL;
+    ULONGLONG CdnCacheSize = 0;
+    ULONGLONG OpenStartTime;
+    size_t cbFrameCache = 0;
+    ULONGLONG PhaseStartTime;
     DWORD dwLocaleMask = 0;
     DWORD dwErrCode = ERROR_SUCCESS;
+    bool bSharedIndex = false;
 
     // Pass the argument array to the storage
     hs->pArgs = pArgs;
 
+#ifndef CASC_NO_PERF_COUNTERS
+    // Enable the performance counters, if the caller wants them
+    if(pArgs->dwFlags & CASC_OPEN_PERF_COUNTERS)
+    {
+        if((dwErrCode = hs->PerfCounters.Create()) != ERROR_SUCCESS)
+            return dwErrCode;
+    }
+#endif
+    OpenStartTime = PhaseStartTime = CASC_PERF_START(hs);
+
     // Extract optional arguments
     ExtractVersionedArgument(pArgs, FIELD_OFFSET(CASC_OPEN_STORAGE_ARGS, dwLocaleMask), &dwLocaleMask);
 
+    // Create the cache of the BLTE frame tables, unless the caller doesn't want it
+    if((pArgs->dwFlags & CASC_OPEN_NO_FRAME_CACHE) == 0)
+    {
+        ExtractVersionedArgument(pArgs, FIELD_OFFSET(CASC_OPEN_STORAGE_ARGS, cbFrameCache), &cbFrameCache);
+        if((dwErrCode = hs->FrameCache.Create(cbFrameCache ? cbFrameCache : CASC_FRAME_CACHE_DEFAULT)) != ERROR_SUCCESS)
+            return dwErrCode;
+    }
+
     // Extract the CDN host URL
     if(ExtractVersionedArgument(pArgs, FIELD_OFFSET(CASC_OPEN_STORAGE_ARGS, szCdnHostUrl), &szCdnHostUrl) && szCdnHostUrl != NULL)
         hs->szCdnHostUrl = CascNewStr(szCdnHostUrl);
@@ -1179,8 +1509,20 @@ static DWORD LoadCascStorage(TCascStorage * hs, PCASC_OPEN_STORAGE_ARGS pArgs)
     if(ExtractVersionedArgument(pArgs, FIELD_OFFSET(CASC_OPEN_STORAGE_ARGS, szBuildKey), &szBuildKey) && szBuildKey != NULL)
         hs->szBuildKey = CascNewStrT2A(szBuildKey);
 
+    // Extract the storage of the previous build (optional)
+    if(ExtractVersionedArgument(pArgs, FIELD_OFFSET(CASC_OPEN_STORAGE_ARGS, hBaseStorage), &hBaseStorage) && hBaseStorage != NULL)
+    {
+        if((hs->pBaseStorage = TCascStorage::IsValid(hBaseStorage)) == NULL)
+            dwErrCode = ERROR_INVALID_HANDLE;
+        else
+            hs->pBaseStorage->AddRef();
+    }
+
+    // Extract the name of the shared storage index (optional)
+    ExtractVersionedArgument(pArgs, FIELD_OFFSET(CASC_OPEN_STORAGE_ARGS, szSharedIndex), &szSharedIndex);
+
     // Special handling to online storages
-    if(hs->dwFeatures & CASC_FEATURE_ONLINE)
+    if(dwErrCode == ERROR_SUCCESS && (hs->dwFeatures & CASC_FEATURE_ONLINE))
     {
         // Enable caching of the sockets. This will add references
         // to all existing and all future sockets
@@ -1190,6 +1532,23 @@ static DWORD LoadCascStorage(TCascStorage * hs, PCASC_OPEN_STORAGE_ARGS pArgs)
         dwErrCode = LoadCdnsFile(hs);
     }
 
+    // Create the disk cache of the downloaded data files, unless the caller doesn't want it
+    if(dwErrCode == ERROR_SUCCESS && (hs->dwFeatures & CASC_FEATURE_ONLINE) && (pArgs->dwFlags & CASC_OPEN_NO_CDN_CACHE) == 0)
+    {
+        TCHAR szCacheDir[MAX_PATH];
+
+        ExtractVersionedArgument(pArgs, FIELD_OFFSET(CASC_OPEN_STORAGE_ARGS, szCdnCache), &szCdnCache);
+        ExtractVersionedArgument(pArgs, FIELD_OFFSET(CASC_OPEN_STORAGE_ARGS, CdnCacheSize), &CdnCacheSize);
+
+        // The default cache directory is "cache" in the local path
+        if(szCdnCache == NULL)
+        {
+            CombinePath(szCacheDir, _countof(szCacheDir), hs->szRootPath, _T("cache"), NULL);
+            szCdnCache = szCacheDir;
+        }
+        dwErrCode = hs->CdnCache.Create(szCdnCache, CdnCacheSize ? CdnCacheSize : CASC_CDN_CACHE_DEFAULT);
+    }
+
     // Now, load the main storage file ".build.info" (or ".build.db" in old storages) 
     if(dwErrCode == ERROR_SUCCESS)
     {
@@ -1210,29 +1569,53 @@ static DWORD LoadCascStorage(TCascStorage * hs, PCASC_OPEN_STORAGE_ARGS pArgs)
     {
         dwErrCode = LoadCdnBuildFile(hs);
     }
+    CASC_PERF_STOP(hs, OpenConfigTime, PhaseStartTime);
+
+    // Map the storage index from the shared memory segment, if there is a valid one.
+    // The generation check needs the sizes and times of the index files
+    if(dwErrCode == ERROR_SUCCESS && szSharedIndex != NULL)
+    {
+        PhaseStartTime = CASC_PERF_START(hs);
+        if(QueryIndexFiles(hs) == ERROR_SUCCESS && AttachSharedIndex(hs, szSharedIndex) == ERROR_SUCCESS)
+            bSharedIndex = true;
+        CASC_PERF_STOP(hs, OpenIndexTime, PhaseStartTime);
+    }
 
     // Create the array of CKey entries. Each entry represents a file in the storage
-    if(dwErrCode == ERROR_SUCCESS)
+    if(dwErrCode == ERROR_SUCCESS && bSharedIndex == false)
     {
         dwErrCode = InitCKeyArray(hs);
     }
 
     // Pre-load the local index files
-    if(dwErrCode == ERROR_SUCCESS)
+    if(dwErrCode == ERROR_SUCCESS && bSharedIndex == false)
     {
+        PhaseStartTime = CASC_PERF_START(hs);
         dwErrCode = LoadIndexFiles(hs);
+        CASC_PERF_STOP(hs, OpenIndexTime, PhaseStartTime);
     }
 
     // Load the ENCODING manifest
-    if(dwErrCode == ERROR_SUCCESS)
+    if(dwErrCode == ERROR_SUCCESS && bSharedIndex == false)
     {
+        PhaseStartTime = CASC_PERF_START(hs);
         dwErrCode = LoadEncodingManifest(hs);
+        CASC_PERF_STOP(hs, OpenEncodingTime, PhaseStartTime);
     }
 
     // We need to load the DOWNLOAD manifest
-    if(dwErrCode == ERROR_SUCCESS)
+    if(dwErrCode == ERROR_SUCCESS && bSharedIndex == false)
     {
+        PhaseStartTime = CASC_PERF_START(hs);
         dwErrCode = LoadDownloadManifest(hs);
+        CASC_PERF_STOP(hs, OpenDownloadTime, PhaseStartTime);
+    }
+
+    // Publish the index for the other processes before the ROOT handler modifies the file entries.
+    // The storage can be used even if this fails
+    if(dwErrCode == ERROR_SUCCESS && szSharedIndex != NULL && bSharedIndex == false)
+    {
+        PublishSharedIndex(hs, szSharedIndex);
     }
 
     // Load the build manifest ("ROOT" file)
@@ -1248,12 +1631,14 @@ static DWORD LoadCascStorage(TCascStorage * hs, PCASC_OPEN_STORAGE_ARGS pArgs)
         }
 
         // Continue loading the manifest
+        PhaseStartTime = CASC_PERF_START(hs);
         dwErrCode = LoadBuildManifest(hs, dwLocaleMask);
         if(dwErrCode != ERROR_SUCCESS)
         {
             // If we fail to load the ROOT file, we take the file names from the INSTALL manifest
             dwErrCode = LoadInstallManifest(hs);
         }
+        CASC_PERF_STOP(hs, OpenRootTime, PhaseStartTime);
     }
 
     // Insert entries for files with well-known names. Their CKeys are in the BUILD file
@@ -1279,6 +1664,10 @@ static DWORD LoadCascStorage(TCascStorage * hs, PCASC_OPEN_STORAGE_ARGS pArgs)
 
     // Cleanup and exit
     FreeIndexFiles(hs);
+    CASC_PERF_STOP(hs, OpenTotalTime, OpenStartTime);
+    if(hs->pBaseStorage != NULL)
+        hs->pBaseStorage->Release();
+    hs->pBaseStorage = NULL;
     hs->pArgs = NULL;
     return dwErrCode;
 }
@@ -1531,6 +1920,18 @@ bool WINAPI CascGetStorageInfo(
         case CascStoragePathProduct:
             return GetStoragePathProduct(hs, pvStorageInfo, cbStorageInfo, pcbLengthNeeded);
 
+        case CascStoragePerfCounters:
+            return GetStoragePerfCounters(hs, pvStorageInfo, cbStorageInfo, pcbLengthNeeded);
+
+        case CascStorageMemory:
+            return GetStorageMemory(hs, pvStorageInfo, cbStorageInfo, pcbLengthNeeded);
+
+        case CascStorageFrameCache:
+            return GetStorageFrameCache(hs, pvStorageInfo, cbStorageInfo, pcbLengthNeeded);
+
+        case CascStorageCdnCache:
+            return GetStorageCdnCache(hs, pvStorageInfo, cbStorageInfo, pcbLengthNeeded);
+
         default:
             SetCascError(ERROR_INVALID_PARAMETER);
             return false;
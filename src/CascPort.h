@@ -76,6 +76,7 @@
   #include <sys/stat.h>
   #include <sys/socket.h>
   #include <sys/mman.h>
+  #include <sys/file.h>
   #include <fcntl.h>
   #include <dirent.h>
   #include <unistd.h>
@@ -90,6 +91,7 @@
   #include <cassert>
   #include <errno.h>
   #include <pthread.h>
+  #include <sched.h>
   #include <netdb.h>
 
   // Support for PowerPC on Max OS X
@@ -127,6 +129,7 @@
   #include <sys/stat.h>
   #include <sys/socket.h>
   #include <sys/mman.h>
+  #include <sys/file.h>
   #include <fcntl.h>
   #include <dirent.h>
   #include <unistd.h>
@@ -141,6 +144,7 @@
   #include <assert.h>
   #include <errno.h>
   #include <pthread.h>
+  #include <sched.h>
   #include <netdb.h>
 
   #define URL_SEP_CHAR              '/'
@@ -345,8 +349,54 @@ inline DWORD CascInterlockedDecrement(DWORD * PtrValue)
 #endif
 }
 
+inline void CascInterlockedAdd64(ULONGLONG * PtrValue, ULONGLONG Value)
+{
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    InterlockedExchangeAdd64((LONGLONG *)(PtrValue), (LONGLONG)(Value));
+#elif defined(__GNUC__)
+    __sync_fetch_and_add(PtrValue, Value);
+#else
+    PtrValue[0] += Value;
+#endif
+}
+
+// Returns the original value. The exchange only happens if it was equal to Comparand
+inline DWORD CascInterlockedCompareExchange(DWORD * PtrValue, DWORD Exchange, DWORD Comparand)
+{
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    return (DWORD)InterlockedCompareExchange((LONG *)(PtrValue), (LONG)(Exchange), (LONG)(Comparand));
+#elif defined(__GNUC__)
+    return __sync_val_compare_and_swap(PtrValue, Comparand, Exchange);
+#else
+    DWORD OldValue = PtrValue[0];
+    if(OldValue == Comparand)
+        PtrValue[0] = Exchange;
+    return OldValue;
+#endif
+}
+
+// Makes all previous writes visible to other threads before any later write
+inline void CascMemoryBarrier()
+{
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    MemoryBarrier();
+#elif defined(__GNUC__)
+    __sync_synchronize();
+#endif
+}
+
+// Gives up the rest of the time slice of the current thread
+inline void CascYield()
+{
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
 //-----------------------------------------------------------------------------
-// Lock functions
+// Lock and condition variable functions
 
 #ifdef CASCLIB_PLATFORM_WINDOWS
 
@@ -356,6 +406,13 @@ typedef RTL_CRITICAL_SECTION CASC_LOCK;
 #define CascLock(Lock)          EnterCriticalSection(&Lock);
 #define CascUnlock(Lock)        LeaveCriticalSection(&Lock);
 
+typedef CONDITION_VARIABLE CASC_COND;
+#define CascInitCond(Cond)      InitializeConditionVariable(&Cond);
+#define CascFreeCond(Cond)      /* Nothing to free */
+#define CascWaitCond(Cond, Lock) SleepConditionVariableCS(&Cond, &Lock, INFINITE);
+#define CascSignalCond(Cond)    WakeConditionVariable(&Cond);
+#define CascBroadcastCond(Cond) WakeAllConditionVariable(&Cond);
+
 #else
 
 typedef pthread_mutex_t CASC_LOCK;
@@ -364,6 +421,25 @@ typedef pthread_mutex_t CASC_LOCK;
 #define CascLock(Lock)          pthread_mutex_lock(&Lock);
 #define CascUnlock(Lock)        pthread_mutex_unlock(&Lock);
 
+typedef pthread_cond_t CASC_COND;
+#define CascInitCond(Cond)      pthread_cond_init(&Cond, NULL);
+#define CascFreeCond(Cond)      pthread_cond_destroy(&Cond);
+#define CascWaitCond(Cond, Lock) pthread_cond_wait(&Cond, &Lock);
+#define CascSignalCond(Cond)    pthread_cond_signal(&Cond);
+#define CascBroadcastCond(Cond) pthread_cond_broadcast(&Cond);
+
+#endif
+
+//-----------------------------------------------------------------------------
+// Memory prefetch hint. Only a hint; does nothing on unsupported compilers
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <xmmintrin.h>
+#define CASC_PREFETCH(ptr)      _mm_prefetch((const char *)(ptr), _MM_HINT_T0)
+#elif defined(__GNUC__)
+#define CASC_PREFETCH(ptr)      __builtin_prefetch(ptr)
+#else
+#define CASC_PREFETCH(ptr)      /* Not supported */
 #endif
 
 //-----------------------------------------------------------------------------
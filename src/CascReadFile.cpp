@@ -12,6 +12,11 @@
 #include "CascLib.h"
 #include "CascCommon.h"
 
+//-----------------------------------------------------------------------------
+// Local defines
+
+#define CASC_ONE_SHOT_BUFFER    0x4000      // Files up to this encoded size are read by CascReadWholeFile to a buffer on the stack
+
 //-----------------------------------------------------------------------------
 // Local functions
 
@@ -25,63 +30,83 @@ static DWORD GetStreamEncodedSize(TFileStream * pStream)
     return (DWORD)(FileSize);
 }
 
+// Returns the stream of the local data file (data.###). The streams are shared by all files
+static TFileStream * OpenLocalDataFile(TCascStorage * hs, DWORD dwArchiveIndex)
+{
+    TFileStream * pStream;
+    TCHAR szDataFile[MAX_PATH];
+    TCHAR szPlainName[0x80];
+
+    // Lock the storage to make the operation thread-safe
+    CascLock(hs->StorageLock);
+
+    // If the data archive is not open yet, open it now.
+    if((pStream = hs->DataFiles[dwArchiveIndex]) == NULL)
+    {
+        // Prepare the name of the data file
+        CascStrPrintf(szPlainName, _countof(szPlainName), _T("data.%03u"), dwArchiveIndex);
+        CombinePath(szDataFile, _countof(szDataFile), hs->szIndexPath, szPlainName, NULL);
+
+        // Open the data stream with read+write sharing to prevent Battle.net agent
+        // detecting a corruption and redownloading the entire package
+        pStream = FileStream_OpenFile(szDataFile, STREAM_FLAG_READ_ONLY | STREAM_FLAG_WRITE_SHARE | STREAM_PROVIDER_FLAT | STREAM_FLAG_FILL_MISSING | BASE_PROVIDER_FILE);
+        hs->DataFiles[dwArchiveIndex] = pStream;
+    }
+
+    // Unlock the storage
+    CascUnlock(hs->StorageLock);
+    CASC_PERF_ADD(hs, DataStreamOpens, 1);
+    return pStream;
+}
+
 static DWORD OpenDataStream(TCascFile * hf, PCASC_FILE_SPAN pFileSpan, PCASC_CKEY_ENTRY pCKeyEntry, bool bDownloadFileIf)
 {
     TCascStorage * hs = hf->hs;
     TFileStream * pStream = NULL;
     TCHAR szCachePath[MAX_PATH];
-    TCHAR szDataFile[MAX_PATH];
-    TCHAR szPlainName[0x80];
     DWORD dwErrCode;
 
     // If the file is available locally, we rely on data files.
     // If not, we download the file and open the stream
     if(pCKeyEntry->Flags & CASC_CE_FILE_IS_LOCAL)
     {
-        DWORD dwArchiveIndex = pFileSpan->ArchiveIndex;
-
-        // Lock the storage to make the operation thread-safe
-        CascLock(hs->StorageLock);
-
-        // If the data archive is not open yet, open it now.
-        if(hs->DataFiles[dwArchiveIndex] == NULL)
-        {
-            // Prepare the name of the data file
-            CascStrPrintf(szPlainName, _countof(szPlainName), _T("data.%03u"), dwArchiveIndex);
-            CombinePath(szDataFile, _countof(szDataFile), hs->szIndexPath, szPlainName, NULL);
-
-            // Open the data stream with read+write sharing to prevent Battle.net agent
-            // detecting a corruption and redownloading the entire package
-            pStream = FileStream_OpenFile(szDataFile, STREAM_FLAG_READ_ONLY | STREAM_FLAG_WRITE_SHARE | STREAM_PROVIDER_FLAT | STREAM_FLAG_FILL_MISSING | BASE_PROVIDER_FILE);
-            hs->DataFiles[dwArchiveIndex] = pStream;
-        }
-
-        // Unlock the storage
-        CascUnlock(hs->StorageLock);
-
-        // Return error or success
-        pFileSpan->pStream = hs->DataFiles[dwArchiveIndex];
+        pFileSpan->pStream = OpenLocalDataFile(hs, pFileSpan->ArchiveIndex);
         return (pFileSpan->pStream != NULL) ? ERROR_SUCCESS : ERROR_FILE_NOT_FOUND;
     }
     else
     {
         if(bDownloadFileIf)
         {
-            CASC_CDN_DOWNLOAD CdnsInfo = {0};
             LPCTSTR szPathType = (pCKeyEntry->Flags & CASC_CE_FILE_PATCH) ? _T("patch") : _T("data");
 
-            // Prepare the download structure for "%CDNS_HOST%/%CDNS_PATH%/##/##/EKey" file
-            CdnsInfo.szCdnsPath = hs->szCdnPath;
-            CdnsInfo.szPathType = szPathType;
-            CdnsInfo.pbEKey = pCKeyEntry->EKey;
-            CdnsInfo.szLocalPath = szCachePath;
-            CdnsInfo.ccLocalPath = _countof(szCachePath);
-
-            // Download the file from CDN
-            dwErrCode = DownloadFileFromCDN(hs, CdnsInfo);
-            if(dwErrCode == ERROR_SUCCESS)
+            // Download the file from CDN. A file from the CDN cache that does not match
+            // the expected encoded size is damaged; drop it and download it once more
+            for(int nAttempt = 0; nAttempt < 2; nAttempt++)
             {
+                CASC_CDN_DOWNLOAD CdnsInfo = {0};
+
+                // Prepare the download structure for "%CDNS_HOST%/%CDNS_PATH%/##/##/EKey" file.
+                // The download fills the structure, so each attempt starts with a new one
+                CdnsInfo.szCdnsPath = hs->szCdnPath;
+                CdnsInfo.szPathType = szPathType;
+                CdnsInfo.pbEKey = pCKeyEntry->EKey;
+                CdnsInfo.szLocalPath = szCachePath;
+                CdnsInfo.ccLocalPath = _countof(szCachePath);
+                CdnsInfo.Flags = CASC_CDN_USE_CACHE;
+
+                if((dwErrCode = DownloadFileFromCDN(hs, CdnsInfo)) != ERROR_SUCCESS)
+                    break;
+
                 pStream = FileStream_OpenFile(szCachePath, BASE_PROVIDER_FILE | STREAM_PROVIDER_FLAT);
+                if(pStream != NULL && CdnsInfo.pbArchiveKey == NULL && pCKeyEntry->EncodedSize != CASC_INVALID_SIZE)
+                {
+                    if(pCKeyEntry->EncodedSize != GetStreamEncodedSize(pStream))
+                    {
+                        FileStream_Close(pStream);
+                        pStream = NULL;
+                    }
+                }
+
                 if(pStream != NULL)
                 {
                     // Initialize information about the position and size of the file in archive
@@ -106,14 +131,19 @@ static DWORD OpenDataStream(TCascFile * hf, PCASC_FILE_SPAN pFileSpan, PCASC_CKE
                         // Encoded size
                         if(pCKeyEntry->EncodedSize == CASC_INVALID_SIZE)
                             pCKeyEntry->EncodedSize = GetStreamEncodedSize(pStream);
-                        assert(pCKeyEntry->EncodedSize == GetStreamEncodedSize(pStream));
                     }
 
                     // We need to close the file stream after we're done
                     pFileSpan->pStream = pStream;
                     hf->bCloseFileStream = true;
+                    CASC_PERF_ADD(hs, DataStreamOpens, 1);
                     return ERROR_SUCCESS;
                 }
+
+                // Only a file from the CDN cache can be retried
+                if(!hs->CdnCache.IsEnabled())
+                    break;
+                hs->CdnCache.Remove(pCKeyEntry->EKey);
             }
         }
 
@@ -228,7 +258,15 @@ static DWORD ParseBlteHeader(PCASC_FILE_SPAN pFileSpan, PCASC_CKEY_ENTRY pCKeyEn
     return ERROR_SUCCESS;
 }
 
-static LPBYTE ReadMissingHeaderData(PCASC_FILE_SPAN pFileSpan, ULONGLONG DataFileOffset, LPBYTE pbEncodedBuffer, size_t cbEncodedBuffer, size_t cbTotalHeaderSize)
+// Reads encoded data of a file span. All reads from data files should go through here
+bool ReadDataStream(TCascStorage * hs, PCASC_FILE_SPAN pFileSpan, ULONGLONG * PtrByteOffset, void * pvBuffer, DWORD dwBytesToRead)
+{
+    CASC_PERF_ADD(hs, DiskReadCount, 1);
+    CASC_PERF_ADD(hs, DiskBytesRead, dwBytesToRead);
+    return FileStream_Read(pFileSpan->pStream, PtrByteOffset, pvBuffer, dwBytesToRead);
+}
+
+static LPBYTE ReadMissingHeaderData(TCascStorage * hs, PCASC_FILE_SPAN pFileSpan, ULONGLONG DataFileOffset, LPBYTE pbEncodedBuffer, size_t cbEncodedBuffer, size_t cbTotalHeaderSize)
 {
     LPBYTE pbNewBuffer;
 
@@ -238,7 +276,7 @@ static LPBYTE ReadMissingHeaderData(PCASC_FILE_SPAN pFileSpan, ULONGLONG DataFil
     {
         // Load the missing data
         DataFileOffset += cbEncodedBuffer;
-        if (FileStream_Read(pFileSpan->pStream, &DataFileOffset, pbNewBuffer + cbEncodedBuffer, (DWORD)(cbTotalHeaderSize - cbEncodedBuffer)))
+        if (ReadDataStream(hs, pFileSpan, &DataFileOffset, pbNewBuffer + cbEncodedBuffer, (DWORD)(cbTotalHeaderSize - cbEncodedBuffer)))
         {
             return pbNewBuffer;
         }
@@ -325,8 +363,9 @@ static DWORD LoadSpanFrames(PCASC_FILE_SPAN pFileSpan, PCASC_CKEY_ENTRY pCKeyEnt
         {
             // Fill the single frame
             memset(&pFrames->FrameHash, 0, sizeof(CONTENT_KEY));
+            // Note that the span range may not be set yet if the file size was unknown
             pFrames->StartOffset = pFileSpan->StartOffset;
-            pFrames->EndOffset = pFileSpan->EndOffset;
+            pFrames->EndOffset = pFileSpan->StartOffset + pCKeyEntry->ContentSize;
             pFrames->DataFileOffset = DataFileOffset;
             pFrames->EncodedSize = (DWORD)(pCKeyEntry->EncodedSize - cbHeaderSize);
             pFrames->ContentSize = pCKeyEntry->ContentSize;
@@ -380,7 +419,7 @@ static DWORD LoadSpanFramesForPlainFile(PCASC_FILE_SPAN pFileSpan, PCASC_CKEY_EN
     return ERROR_NOT_ENOUGH_MEMORY;
 }
 
-static DWORD LoadEncodedHeaderAndSpanFrames(PCASC_FILE_SPAN pFileSpan, PCASC_CKEY_ENTRY pCKeyEntry)
+static DWORD LoadEncodedHeaderAndSpanFrames(TCascStorage * hs, PCASC_FILE_SPAN pFileSpan, PCASC_CKEY_ENTRY pCKeyEntry)
 {
     LPBYTE pbEncodedBuffer;
     size_t cbEncodedBuffer = MAX_ENCODED_HEADER;
@@ -407,7 +446,7 @@ static DWORD LoadEncodedHeaderAndSpanFrames(PCASC_FILE_SPAN pFileSpan, PCASC_CKE
         // Load the entire (eventual) header area. This is faster than doing
         // two read operations in a row. Read as much as possible. If the file is cut,
         // the FileStream will pad it with zeros
-        if (FileStream_Read(pFileSpan->pStream, &ReadOffset, pbEncodedBuffer, (DWORD)cbEncodedBuffer))
+        if (ReadDataStream(hs, pFileSpan, &ReadOffset, pbEncodedBuffer, (DWORD)cbEncodedBuffer))
         {
             // Parse the BLTE header
             dwErrCode = ParseBlteHeader(pFileSpan, pCKeyEntry, ReadOffset, pbEncodedBuffer, cbEncodedBuffer, &cbHeaderSize);
@@ -417,7 +456,7 @@ static DWORD LoadEncodedHeaderAndSpanFrames(PCASC_FILE_SPAN pFileSpan, PCASC_CKE
                 pFileSpan->HeaderSize = (DWORD)(cbTotalHeaderSize = cbHeaderSize + (pFileSpan->FrameCount * sizeof(BLTE_FRAME)));
                 if (cbTotalHeaderSize > cbEncodedBuffer)
                 {
-                    pbEncodedBuffer = ReadMissingHeaderData(pFileSpan, ReadOffset, pbEncodedBuffer, cbEncodedBuffer, cbTotalHeaderSize);
+                    pbEncodedBuffer = ReadMissingHeaderData(hs, pFileSpan, ReadOffset, pbEncodedBuffer, cbEncodedBuffer, cbTotalHeaderSize);
                     if (pbEncodedBuffer == NULL)
                         dwErrCode = GetCascError();
                     cbEncodedBuffer = cbTotalHeaderSize;
@@ -471,8 +510,15 @@ static DWORD LoadSpanFrames(TCascFile * hf, PCASC_FILE_SPAN pFileSpan, PCASC_CKE
             return dwErrCode;
     }
 
+    // The frame table may have been loaded by another handle
+    if(hf->hs->FrameCache.Load(pFileSpan, pCKeyEntry))
+        return ERROR_SUCCESS;
+
     // Make sure we have header area loaded
-    return LoadEncodedHeaderAndSpanFrames(pFileSpan, pCKeyEntry);
+    dwErrCode = LoadEncodedHeaderAndSpanFrames(hf->hs, pFileSpan, pCKeyEntry);
+    if(dwErrCode == ERROR_SUCCESS)
+        hf->hs->FrameCache.Store(pFileSpan, pCKeyEntry);
+    return dwErrCode;
 }
 
 // Loads all file spans to memory
@@ -521,34 +567,38 @@ static DWORD LoadFileSpanFrames(TCascFile * hf)
     return dwErrCode;
 }
 
-static DWORD EnsureFileSpanFramesLoaded(TCascFile * hf)
+// The frames are loaded once; after that, the spans are never changed.
+// The lock makes this safe for positional reads of one handle from multiple threads
+DWORD EnsureFileSpanFramesLoaded(TCascFile * hf)
 {
-    DWORD dwErrCode;
+    DWORD dwErrCode = ERROR_SUCCESS;
 
+    CascLock(hf->FileLock);
     if(hf->ContentSize == CASC_INVALID_SIZE64 || hf->pFileSpan->pFrames == NULL)
     {
         // Load all frames of all file spans
         dwErrCode = LoadFileSpanFrames(hf);
-        if(dwErrCode != ERROR_SUCCESS)
-            return dwErrCode;
 
         // Now the content size must be known
-        if(hf->ContentSize == CASC_INVALID_SIZE64)
-            return ERROR_CAN_NOT_COMPLETE;
+        if(dwErrCode == ERROR_SUCCESS && hf->ContentSize == CASC_INVALID_SIZE64)
+            dwErrCode = ERROR_CAN_NOT_COMPLETE;
     }
+    CascUnlock(hf->FileLock);
 
-    return ERROR_SUCCESS;
+    return dwErrCode;
 }
 
-static DWORD DecodeFileFrame(
-    TCascFile * hf,
+DWORD DecodeFileFrame(
+    TCascStorage * hs,
     PCASC_CKEY_ENTRY pCKeyEntry,
     PCASC_FILE_FRAME pFrame,
     LPBYTE pbEncoded,
     LPBYTE pbDecoded,
-    DWORD FrameIndex)
+    DWORD FrameIndex,
+    bool bVerifyIntegrity,
+    bool bOvercomeEncrypted,
+    PCASC_ENCRYPTION_KEY * PtrLastKey)
 {
-    TCascStorage * hs = hf->hs;
     LPBYTE pbWorkBuffer = NULL;
     DWORD cbDecodedExpected = 0;
     DWORD cbWorkBuffer = 0;
@@ -556,6 +606,8 @@ static DWORD DecodeFileFrame(
     DWORD dwErrCode = ERROR_SUCCESS;
     DWORD cbEncoded = pFrame->EncodedSize;
     DWORD cbDecoded = pFrame->ContentSize;
+    ULONGLONG DecodeStartTime;
+    ULONGLONG StartTime;
     bool bWorkComplete = false;
 
     //if(pFrame->EncodedSize == 0xda001)
@@ -572,13 +624,19 @@ static DWORD DecodeFileFrame(
         assert(pCKeyEntry->ContentSize == pFrame->ContentSize);
         assert(pFrame->ContentSize == pFrame->EncodedSize);
         memcpy(pbDecoded, pbEncoded, pCKeyEntry->ContentSize);
+        CASC_PERF_ADD(hs, FramesPlain, 1);
         return ERROR_SUCCESS;
     }
 
     // Shall we verify the frame integrity?
-    if(hf->bVerifyIntegrity)
+    DecodeStartTime = CASC_PERF_START(hs);
+    if(bVerifyIntegrity)
     {
-        if(!CascVerifyDataBlockHash(pbEncoded, pFrame->EncodedSize, pFrame->FrameHash.Value))
+        bool bHashMatch = CascVerifyDataBlockHash(pbEncoded, pFrame->EncodedSize, pFrame->FrameHash.Value);
+
+        CASC_PERF_STOP(hs, VerifyTime, DecodeStartTime);
+        CASC_PERF_ADD(hs, FramesVerified, 1);
+        if(!bHashMatch)
             return ERROR_FILE_CORRUPT;
     }
 
@@ -604,7 +662,10 @@ static DWORD DecodeFileFrame(
                     return ERROR_NOT_ENOUGH_MEMORY;
 
                 // Decrypt the stream to the work buffer
-                dwErrCode = CascDecrypt(hs, pbWorkBuffer, &cbWorkBuffer, pbEncoded + 1, cbEncoded - 1, FrameIndex);
+                StartTime = CASC_PERF_START(hs);
+                dwErrCode = CascDecrypt(hs, pbWorkBuffer, &cbWorkBuffer, pbEncoded + 1, cbEncoded - 1, FrameIndex, PtrLastKey);
+                CASC_PERF_STOP(hs, DecryptTime, StartTime);
+                CASC_PERF_ADD(hs, FramesEncrypted, 1);
                 if(dwErrCode != ERROR_SUCCESS)
                 {
                     bWorkComplete = true;
@@ -622,7 +683,10 @@ static DWORD DecodeFileFrame(
                 // If we decompressed less than expected, we simply fill the rest with zeros
                 // Example: INSTALL file from the TACT CASC storage
                 cbDecodedExpected = cbDecoded;
+                StartTime = CASC_PERF_START(hs);
                 dwErrCode = CascDecompress(pbDecoded, &cbDecoded, pbEncoded + 1, cbEncoded - 1);
+                CASC_PERF_STOP(hs, DecompressTime, StartTime);
+                CASC_PERF_ADD(hs, FramesCompressed, 1);
 
                 // We exactly know what the output buffer size will be.
                 // If the uncompressed data is smaller, fill the rest with zeros
@@ -633,6 +697,7 @@ static DWORD DecodeFileFrame(
 
             case 'N':   // Normal stored files
                 dwErrCode = CascDirectCopy(pbDecoded, &cbDecoded, pbEncoded + 1, cbEncoded - 1);
+                CASC_PERF_ADD(hs, FramesNormal, 1);
                 bWorkComplete = true;
                 break;
 
@@ -651,7 +716,7 @@ static DWORD DecodeFileFrame(
     // Some people find it handy to extract data from partially encrypted file,
     // even at the cost of producing corrupt files.
     // We overcome missing decryption key by zeroing the encrypted portions
-    if(dwErrCode == ERROR_FILE_ENCRYPTED && hf->bOvercomeEncrypted)
+    if(dwErrCode == ERROR_FILE_ENCRYPTED && bOvercomeEncrypted)
     {
         memset(pbDecoded, 0, cbDecoded);
         dwErrCode = ERROR_SUCCESS;
@@ -659,9 +724,21 @@ static DWORD DecodeFileFrame(
 
     // Free the temporary buffer
     CASC_FREE(pbWorkBuffer);
+    CASC_PERF_STOP(hs, DecodeTime, DecodeStartTime);
     return dwErrCode;
 }
 
+DWORD DecodeFileFrame(
+    TCascFile * hf,
+    PCASC_CKEY_ENTRY pCKeyEntry,
+    PCASC_FILE_FRAME pFrame,
+    LPBYTE pbEncoded,
+    LPBYTE pbDecoded,
+    DWORD FrameIndex)
+{
+    return DecodeFileFrame(hf->hs, pCKeyEntry, pFrame, pbEncoded, pbDecoded, FrameIndex, hf->bVerifyIntegrity, hf->bOvercomeEncrypted, &hf->pLastKey);
+}
+
 static bool GetFileFullInfo(TCascFile * hf, void * pvFileInfo, size_t cbFileInfo, size_t * pcbLengthNeeded)
 {
     PCASC_FILE_FULL_INFO pFileInfo;
@@ -692,7 +769,7 @@ static bool GetFileFullInfo(TCascFile * hf, void * pvFileInfo, size_t cbFileInfo
         CascStrPrintf(pFileInfo->DataFileName, _countof(pFileInfo->DataFileName), "data.%03u", hf->pFileSpan->ArchiveIndex);
         pFileInfo->StorageOffset = pCKeyEntry->StorageOffset;
         pFileInfo->SegmentOffset = hf->pFileSpan->ArchiveOffs;
-        pFileInfo->FileNameHash = 0;
+        pFileInfo->FileNameHash = hf->FileNameHash;
         pFileInfo->TagBitMask = pCKeyEntry->TagBitMask;
         pFileInfo->ContentSize = hf->ContentSize;
         pFileInfo->EncodedSize = hf->EncodedSize;
@@ -798,7 +875,7 @@ static DWORD ReadFile_WholeFile(TCascFile * hf, LPBYTE pbBuffer)
         }
 
         // Load the encoded buffer
-        if(FileStream_Read(pFileSpan->pStream, &ByteOffset, pbEncoded, EncodedSize))
+        if(ReadDataStream(hf->hs, pFileSpan, &ByteOffset, pbEncoded, EncodedSize))
         {
             PCASC_FILE_FRAME pFileFrame = pFileSpan->pFrames;
 
@@ -881,7 +958,7 @@ static DWORD ReadFile_FrameCached(TCascFile * hf, LPBYTE pbBuffer, ULONGLONG Sta
                     }
 
                     // Load the frame to the encoded buffer
-                    if(FileStream_Read(pFileSpan->pStream, &pFileFrame->DataFileOffset, pbEncoded, pFileFrame->EncodedSize))
+                    if(ReadDataStream(hf->hs, pFileSpan, &pFileFrame->DataFileOffset, pbEncoded, pFileFrame->EncodedSize))
                     {
                         ULONGLONG EndOfCopy = CASCLIB_MIN(pFileFrame->EndOffset, EndOffset);
                         DWORD dwBytesToCopy = (DWORD)(EndOfCopy - StartOffset);
@@ -955,6 +1032,348 @@ static DWORD ReadFile_NonCached(TCascFile * hf, LPBYTE pbBuffer, ULONGLONG Start
     return 0;
 }
 
+// Copies a part of a decoded frame from the frame slots. Returns false if the frame is not there
+static bool ReadFrameSlot(TCascFile * hf, PCASC_FILE_FRAME pFileFrame, LPBYTE pbBuffer, ULONGLONG StartOffset, ULONGLONG EndOfCopy)
+{
+    bool bFound = false;
+
+    CascLock(hf->FileLock);
+    for(DWORD i = 0; i < CASC_FRAME_SLOTS; i++)
+    {
+        PCASC_FRAME_SLOT pSlot = &hf->FrameSlots[i];
+
+        if(pSlot->pbData != NULL && pSlot->StartOffset == pFileFrame->StartOffset)
+        {
+            memcpy(pbBuffer, pSlot->pbData + (size_t)(StartOffset - pSlot->StartOffset), (size_t)(EndOfCopy - StartOffset));
+            pSlot->dwLastUse = ++hf->dwSlotUse;
+            bFound = true;
+            break;
+        }
+    }
+    CascUnlock(hf->FileLock);
+
+    return bFound;
+}
+
+// Puts a decoded frame to the least recently used slot. Takes ownership of the buffer
+static void StoreFrameSlot(TCascFile * hf, PCASC_FILE_FRAME pFileFrame, LPBYTE pbDecoded)
+{
+    PCASC_FRAME_SLOT pVictim = &hf->FrameSlots[0];
+
+    CascLock(hf->FileLock);
+    for(DWORD i = 0; i < CASC_FRAME_SLOTS; i++)
+    {
+        PCASC_FRAME_SLOT pSlot = &hf->FrameSlots[i];
+
+        // Another thread may have decoded the same frame in the meantime
+        if(pSlot->pbData != NULL && pSlot->StartOffset == pFileFrame->StartOffset)
+        {
+            pVictim = NULL;
+            break;
+        }
+
+        // Prefer free slots, then the least recently used one
+        if(pSlot->pbData == NULL || (pVictim->pbData != NULL && pSlot->dwLastUse < pVictim->dwLastUse))
+            pVictim = pSlot;
+    }
+
+    if(pVictim != NULL)
+    {
+        LPBYTE pbOldData = pVictim->pbData;
+
+        pVictim->StartOffset = pFileFrame->StartOffset;
+        pVictim->EndOffset = pFileFrame->EndOffset;
+        pVictim->pbData = pbDecoded;
+        pVictim->dwLastUse = ++hf->dwSlotUse;
+        pbDecoded = pbOldData;
+    }
+    CascUnlock(hf->FileLock);
+
+    CASC_FREE(pbDecoded);
+}
+
+// Reads a range of the file to the user buffer. The file pointer is not used, so this
+// can run on multiple threads at once, as long as the file frames have already been loaded
+// (EnsureFileSpanFramesLoaded). Frames that are read only partially are kept in the frame
+// slots, because the following read usually continues in the same frame
+DWORD ReadFileRange(TCascFile * hf, LPBYTE pbBuffer, ULONGLONG StartOffset, ULONGLONG EndOffset)
+{
+    PCASC_ENCRYPTION_KEY pLastKey = NULL;
+    PCASC_CKEY_ENTRY pCKeyEntry = hf->pCKeyEntry;
+    PCASC_FILE_SPAN pFileSpan = hf->pFileSpan;
+    LPBYTE pbEncoded;
+    LPBYTE pbDecoded;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    for(DWORD SpanIndex = 0; SpanIndex < hf->SpanCount && StartOffset < EndOffset; SpanIndex++, pCKeyEntry++, pFileSpan++)
+    {
+        // Skip the spans that are out of the range
+        if(pFileSpan->EndOffset <= StartOffset || EndOffset <= pFileSpan->StartOffset)
+            continue;
+
+        for(DWORD FrameIndex = 0; FrameIndex < pFileSpan->FrameCount && StartOffset < EndOffset; FrameIndex++)
+        {
+            PCASC_FILE_FRAME pFileFrame = pFileSpan->pFrames + FrameIndex;
+            ULONGLONG EndOfCopy;
+            bool bPartialFrame;
+
+            // Skip the frames that are out of the range
+            if(pFileFrame->EndOffset <= StartOffset || EndOffset <= pFileFrame->StartOffset)
+                continue;
+            EndOfCopy = CASCLIB_MIN(pFileFrame->EndOffset, EndOffset);
+            bPartialFrame = (pFileFrame->StartOffset < StartOffset || EndOffset < pFileFrame->EndOffset);
+
+            // Is the frame already decoded?
+            if(bPartialFrame && ReadFrameSlot(hf, pFileFrame, pbBuffer, StartOffset, EndOfCopy))
+            {
+                CASC_PERF_ADD(hf->hs, CacheHits, 1);
+                pbBuffer += (size_t)(EndOfCopy - StartOffset);
+                StartOffset = EndOfCopy;
+                continue;
+            }
+
+            // If the frame is fully covered by the range, decode it directly to the user buffer
+            pbDecoded = pbBuffer;
+            if(bPartialFrame)
+            {
+                if((pbDecoded = CASC_ALLOC<BYTE>(pFileFrame->ContentSize)) == NULL)
+                    return ERROR_NOT_ENOUGH_MEMORY;
+                CASC_PERF_ADD(hf->hs, CacheMisses, 1);
+            }
+
+            // Load and decode the frame. The last key is local, as the handle may be shared
+            if((pbEncoded = CASC_ALLOC<BYTE>(pFileFrame->EncodedSize)) != NULL)
+            {
+                ULONGLONG DataFileOffset = pFileFrame->DataFileOffset;
+
+                if(ReadDataStream(hf->hs, pFileSpan, &DataFileOffset, pbEncoded, pFileFrame->EncodedSize))
+                    dwErrCode = DecodeFileFrame(hf->hs, pCKeyEntry, pFileFrame, pbEncoded, pbDecoded, FrameIndex, hf->bVerifyIntegrity, hf->bOvercomeEncrypted, &pLastKey);
+                else
+                    dwErrCode = (GetCascError() != ERROR_SUCCESS) ? GetCascError() : ERROR_CAN_NOT_COMPLETE;
+                CASC_FREE(pbEncoded);
+            }
+            else
+            {
+                dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+            }
+
+            // Copy the requested part of the frame and keep the frame for the next read
+            if(pbDecoded != pbBuffer)
+            {
+                if(dwErrCode == ERROR_SUCCESS)
+                {
+                    memcpy(pbBuffer, pbDecoded + (size_t)(StartOffset - pFileFrame->StartOffset), (size_t)(EndOfCopy - StartOffset));
+                    StoreFrameSlot(hf, pFileFrame, pbDecoded);
+                }
+                else
+                {
+                    CASC_FREE(pbDecoded);
+                }
+            }
+
+            if(dwErrCode != ERROR_SUCCESS)
+                return dwErrCode;
+            pbBuffer += (size_t)(EndOfCopy - StartOffset);
+            StartOffset = EndOfCopy;
+        }
+    }
+
+    return ERROR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// Reading whole files without a file handle
+
+// Decodes all frames of a file that has been read to memory as a whole.
+// pbFramePtr points to the frame table, which is followed by the frames
+static DWORD DecodeWholeFile(
+    TCascStorage * hs,
+    PCASC_CKEY_ENTRY pCKeyEntry,
+    DWORD FrameCount,
+    LPBYTE pbFramePtr,
+    LPBYTE pbEncodedEnd,
+    LPBYTE pbBuffer,
+    DWORD cbBuffer,
+    DWORD dwOpenFlags,
+    PDWORD PtrBytesRead)
+{
+    PCASC_ENCRYPTION_KEY pLastKey = NULL;
+    CASC_FILE_FRAME Frame;
+    ULONGLONG ContentSize = 0;
+    ULONGLONG EncodedSize = 0;
+    LPBYTE pbFrameTable = pbFramePtr;
+    LPBYTE pbFrameEnd = pbFramePtr + (FrameCount * sizeof(BLTE_FRAME));
+    LPBYTE pbEncoded = pbFrameEnd;
+    DWORD dwErrCode = ERROR_SUCCESS;
+    bool bVerifyIntegrity = (dwOpenFlags & CASC_STRICT_DATA_CHECK) ? true : false;
+    bool bOvercomeEncrypted = (dwOpenFlags & CASC_OVERCOME_ENCRYPTED) ? true : false;
+
+    if(pbEncoded > pbEncodedEnd)
+        return ERROR_BAD_FORMAT;
+
+    // No frame table: the rest of the file is a single frame
+    if(FrameCount == 0)
+    {
+        // We need to know the content size in this case
+        if(pCKeyEntry->ContentSize == CASC_INVALID_SIZE)
+            return ERROR_NOT_SUPPORTED;
+
+        memset(&Frame, 0, sizeof(CASC_FILE_FRAME));
+        Frame.EncodedSize = (DWORD)(pbEncodedEnd - pbEncoded);
+        Frame.ContentSize = pCKeyEntry->ContentSize;
+        dwErrCode = DecodeFileFrame(hs, pCKeyEntry, &Frame, pbEncoded, pbBuffer, 0, bVerifyIntegrity, bOvercomeEncrypted);
+        if(dwErrCode == ERROR_SUCCESS)
+            PtrBytesRead[0] = Frame.ContentSize;
+        return dwErrCode;
+    }
+
+    // Sum the sizes of all frames first, so we know that the content fits into the buffer
+    for(DWORD i = 0; i < FrameCount; i++)
+    {
+        if((pbFramePtr = CaptureBlteFileFrame(Frame, pbFramePtr, pbFrameEnd)) == NULL)
+            return ERROR_BAD_FORMAT;
+        ContentSize += Frame.ContentSize;
+        EncodedSize += Frame.EncodedSize;
+    }
+
+    // Verify the sizes
+    if(EncodedSize > (ULONGLONG)(pbEncodedEnd - pbEncoded))
+        return ERROR_BAD_FORMAT;
+    if(ContentSize > cbBuffer)
+    {
+        PtrBytesRead[0] = (DWORD)CASCLIB_MIN(ContentSize, CASC_INVALID_SIZE);
+        return ERROR_INSUFFICIENT_BUFFER;
+    }
+
+    // Decode the frames directly to the caller's buffer
+    pbFramePtr = pbFrameTable;
+    for(DWORD i = 0; i < FrameCount; i++)
+    {
+        pbFramePtr = CaptureBlteFileFrame(Frame, pbFramePtr, pbFrameEnd);
+        dwErrCode = DecodeFileFrame(hs, pCKeyEntry, &Frame, pbEncoded, pbBuffer, i, bVerifyIntegrity, bOvercomeEncrypted, &pLastKey);
+        if(dwErrCode != ERROR_SUCCESS)
+            return dwErrCode;
+
+        pbEncoded += Frame.EncodedSize;
+        pbBuffer += Frame.ContentSize;
+    }
+
+    // Save the content size of the file
+    if(pCKeyEntry->ContentSize == CASC_INVALID_SIZE)
+        pCKeyEntry->ContentSize = (DWORD)ContentSize;
+    PtrBytesRead[0] = (DWORD)ContentSize;
+    return ERROR_SUCCESS;
+}
+
+// Reads a local single-span file with one read of the data file and decodes it to the caller's buffer.
+// Returns ERROR_NOT_SUPPORTED if the file must be read through a file handle.
+static DWORD ReadWholeFile_OneShot(TCascStorage * hs, PCASC_CKEY_ENTRY pCKeyEntry, DWORD dwOpenFlags, LPBYTE pbBuffer, DWORD cbBuffer, PDWORD PtrBytesRead)
+{
+    CASC_FILE_SPAN FileSpan;
+    ULONGLONG ByteOffset;
+    LPBYTE pbEncoded;
+    size_t cbHeaderSize = 0;
+    DWORD dwErrCode;
+    BYTE StackBuffer[CASC_ONE_SHOT_BUFFER];
+
+    // The file must be in local data files and its location must be known
+    if((pCKeyEntry->Flags & CASC_CE_FILE_IS_LOCAL) == 0 || pCKeyEntry->SpanCount > 1)
+        return ERROR_NOT_SUPPORTED;
+    if(pCKeyEntry->StorageOffset == CASC_INVALID_OFFS64 || pCKeyEntry->EncodedSize == CASC_INVALID_SIZE)
+        return ERROR_NOT_SUPPORTED;
+
+    // If we know the content size, check the buffer before reading anything
+    if(pCKeyEntry->ContentSize != CASC_INVALID_SIZE && pCKeyEntry->ContentSize > cbBuffer)
+    {
+        PtrBytesRead[0] = pCKeyEntry->ContentSize;
+        return ERROR_INSUFFICIENT_BUFFER;
+    }
+
+    // Locate the file in the data files
+    memset(&FileSpan, 0, sizeof(CASC_FILE_SPAN));
+    FileSpan.ArchiveIndex = (DWORD)(pCKeyEntry->StorageOffset >> hs->FileOffsetBits);
+    FileSpan.ArchiveOffs = (DWORD)(pCKeyEntry->StorageOffset & (((ULONGLONG)1 << hs->FileOffsetBits) - 1));
+    if(FileSpan.ArchiveIndex >= CASC_MAX_DATA_FILES)
+        return ERROR_FILE_CORRUPT;
+    if((FileSpan.pStream = OpenLocalDataFile(hs, FileSpan.ArchiveIndex)) == NULL)
+        return ERROR_FILE_NOT_FOUND;
+
+    // Small files are read to the stack buffer
+    pbEncoded = StackBuffer;
+    if(pCKeyEntry->EncodedSize > sizeof(StackBuffer))
+    {
+        if((pbEncoded = CASC_ALLOC<BYTE>(pCKeyEntry->EncodedSize)) == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    // Read the header, the frame table and all frames at once
+    ByteOffset = FileSpan.ArchiveOffs;
+    if(ReadDataStream(hs, &FileSpan, &ByteOffset, pbEncoded, pCKeyEntry->EncodedSize))
+    {
+        // Plain files ("PATCH") have no BLTE header. The content size has been checked above.
+        if(pCKeyEntry->Flags & CASC_CE_PLAIN_DATA)
+            dwErrCode = ERROR_BAD_FORMAT;
+        else
+            dwErrCode = ParseBlteHeader(&FileSpan, pCKeyEntry, FileSpan.ArchiveOffs, pbEncoded, pCKeyEntry->EncodedSize, &cbHeaderSize);
+
+        if(dwErrCode == ERROR_SUCCESS)
+        {
+            dwErrCode = DecodeWholeFile(hs, pCKeyEntry, FileSpan.FrameCount, pbEncoded + cbHeaderSize, pbEncoded + pCKeyEntry->EncodedSize, pbBuffer, cbBuffer, dwOpenFlags, PtrBytesRead);
+        }
+        else if(pCKeyEntry->EncodedSize == pCKeyEntry->ContentSize)
+        {
+            pCKeyEntry->Flags |= CASC_CE_PLAIN_DATA;
+            memcpy(pbBuffer, pbEncoded, pCKeyEntry->ContentSize);
+            PtrBytesRead[0] = pCKeyEntry->ContentSize;
+            CASC_PERF_ADD(hs, FramesPlain, 1);
+            dwErrCode = ERROR_SUCCESS;
+        }
+    }
+    else
+    {
+        dwErrCode = ERROR_FILE_CORRUPT;
+    }
+
+    // Free the buffer
+    if(pbEncoded != StackBuffer)
+        CASC_FREE(pbEncoded);
+    return dwErrCode;
+}
+
+// Reads the whole file through a file handle. Used for online and multi-span files
+static DWORD ReadWholeFile_Handle(TCascStorage * hs, PCASC_CKEY_ENTRY pCKeyEntry, DWORD dwOpenFlags, LPBYTE pbBuffer, DWORD cbBuffer, PDWORD PtrBytesRead)
+{
+    ULONGLONG FileSize = 0;
+    HANDLE hFile = NULL;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    if(!OpenFileByCKeyEntry(hs, pCKeyEntry, dwOpenFlags, &hFile))
+        return GetCascError();
+
+    // The whole file goes directly to the caller's buffer
+    SetCacheStrategy(hFile, CascCacheNothing);
+    if(CascGetFileSize64(hFile, &FileSize))
+    {
+        if(FileSize <= cbBuffer)
+        {
+            if(!CascReadFile(hFile, pbBuffer, (DWORD)FileSize, PtrBytesRead))
+                dwErrCode = GetCascError();
+        }
+        else
+        {
+            PtrBytesRead[0] = (DWORD)CASCLIB_MIN(FileSize, CASC_INVALID_SIZE);
+            dwErrCode = ERROR_INSUFFICIENT_BUFFER;
+        }
+    }
+    else
+    {
+        dwErrCode = GetCascError();
+    }
+
+    CascCloseFile(hFile);
+    return dwErrCode;
+}
+
 //-----------------------------------------------------------------------------
 // Public functions
 
@@ -1228,6 +1647,8 @@ bool WINAPI CascReadFile(HANDLE hFile, void * pvBuffer, DWORD dwBytesToRead, PDW
     // Can we handle the request (at least partially) from the cache?
     if((dwBytesRead1 = ReadFile_Cache(hf, pbBuffer, StartOffset, EndOffset)) != 0)
     {
+        CASC_PERF_ADD(hf->hs, CacheHits, 1);
+
         // Move pointers
         StartOffset = StartOffset + dwBytesRead1;
         pbBuffer += dwBytesRead1;
@@ -1243,6 +1664,7 @@ bool WINAPI CascReadFile(HANDLE hFile, void * pvBuffer, DWORD dwBytesToRead, PDW
     }
 
     // Perform the cache-strategy-specific read
+    CASC_PERF_ADD(hf->hs, CacheMisses, 1);
     switch(hf->CacheStrategy)
     {
         // No caching at all. The entire file will be read directly to the user buffer
@@ -1278,3 +1700,90 @@ bool WINAPI CascReadFile(HANDLE hFile, void * pvBuffer, DWORD dwBytesToRead, PDW
         return (dwBytesToRead == 0);
     }
 }
+
+bool WINAPI CascReadFileAt(HANDLE hFile, ULONGLONG ByteOffset, void * pvBuffer, DWORD dwBytesToRead, PDWORD PtrBytesRead)
+{
+    ULONGLONG StartOffset;
+    ULONGLONG EndOffset;
+    TCascFile * hf;
+    DWORD dwErrCode;
+
+    // Validate the file handle
+    if((hf = TCascFile::IsValid(hFile)) == NULL)
+    {
+        SetCascError(ERROR_INVALID_HANDLE);
+        return false;
+    }
+
+    // The buffer must be valid
+    if(pvBuffer == NULL || PtrBytesRead == NULL)
+    {
+        SetCascError(ERROR_INVALID_PARAMETER);
+        return false;
+    }
+    PtrBytesRead[0] = 0;
+
+    // Load the frames and the file size. Only the first read of the handle does the work
+    dwErrCode = EnsureFileSpanFramesLoaded(hf);
+    if(dwErrCode != ERROR_SUCCESS)
+    {
+        SetCascError(dwErrCode);
+        return false;
+    }
+
+    // Reading at or beyond the end of the file gives zero bytes
+    StartOffset = CASCLIB_MIN(ByteOffset, hf->ContentSize);
+    EndOffset = CASCLIB_MIN(StartOffset + dwBytesToRead, hf->ContentSize);
+
+    // Read the range. Neither the file pointer nor the cache of CascReadFile are used
+    dwErrCode = ReadFileRange(hf, (LPBYTE)pvBuffer, StartOffset, EndOffset);
+    if(dwErrCode != ERROR_SUCCESS)
+    {
+        SetCascError(dwErrCode);
+        return false;
+    }
+
+    PtrBytesRead[0] = (DWORD)(EndOffset - StartOffset);
+    return true;
+}
+
+bool WINAPI CascReadWholeFile(HANDLE hStorage, const void * pvFileName, DWORD dwLocaleFlags, DWORD dwOpenFlags, void * pvBuffer, DWORD cbBuffer, PDWORD PtrBytesRead)
+{
+    PCASC_CKEY_ENTRY pCKeyEntry = NULL;
+    TCascStorage * hs;
+    DWORD dwErrCode;
+
+    // This parameter is not used
+    CASCLIB_UNUSED(dwLocaleFlags);
+
+    // Validate the storage handle
+    if((hs = TCascStorage::IsValid(hStorage)) == NULL)
+    {
+        SetCascError(ERROR_INVALID_HANDLE);
+        return false;
+    }
+
+    // The buffer may only be NULL if the caller just wants the file size
+    if(PtrBytesRead == NULL || (pvBuffer == NULL && cbBuffer != 0))
+    {
+        SetCascError(ERROR_INVALID_PARAMETER);
+        return false;
+    }
+    PtrBytesRead[0] = 0;
+
+    // Find the file and read it. Fall back to the file handle if the one-shot read is not possible
+    dwErrCode = FindCKeyEntry_OpenName(hs, pvFileName, dwOpenFlags, &pCKeyEntry);
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        dwErrCode = ReadWholeFile_OneShot(hs, pCKeyEntry, dwOpenFlags, (LPBYTE)pvBuffer, cbBuffer, PtrBytesRead);
+        if(dwErrCode == ERROR_NOT_SUPPORTED)
+            dwErrCode = ReadWholeFile_Handle(hs, pCKeyEntry, dwOpenFlags, (LPBYTE)pvBuffer, cbBuffer, PtrBytesRead);
+    }
+
+    if(dwErrCode != ERROR_SUCCESS)
+    {
+        SetCascError(dwErrCode);
+        return false;
+    }
+    return true;
+}
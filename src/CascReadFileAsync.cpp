@@ -0,0 +1,747 @@
+/*****************************************************************************/
+/* CascReadFileAsync.cpp                  Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Asynchronous reading of file ranges                                       */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 19.10.26  1.00  Lad  The first version of CascReadFileAsync.cpp           */
+/*****************************************************************************/
+
+#define __CASCLIB_SELF__
+#include "CascLib.h"
+#include "CascCommon.h"
+
+//-----------------------------------------------------------------------------
+// Local structures
+
+// One read request, as passed to CascReadFileAsync
+struct CASC_ASYNC_READ
+{
+    CASC_READ_COMPLETION Completion;                // Given to the caller when the read is complete
+    TCascFile * hf;                                 // The file to read from
+    LPBYTE pbBuffer;                                // Target buffer
+    ULONGLONG StartOffset;                          // Start of the range to read
+    ULONGLONG EndOffset;                            // End of the range to read, already cut to the file size
+    DWORD dwPendingFrames;                          // io_uring: Number of frames that are not decoded yet
+    CASC_ASYNC_READ * pNext;                        // Next read in the pending or in the completed list
+};
+
+// One frame of a read request (io_uring backend only)
+struct CASC_ASYNC_FRAME
+{
+    CASC_ASYNC_READ * pRead;                        // The read request this frame belongs to
+    PCASC_CKEY_ENTRY pCKeyEntry;                    // CKey entry of the file span
+    PCASC_FILE_SPAN pFileSpan;                      // The file span
+    PCASC_FILE_FRAME pFrame;                        // The file frame
+    DWORD FrameIndex;                               // Index of the frame within the span (needed for decryption)
+    HANDLE hDataFile;                               // OS handle of the data file
+    LPBYTE pbEncoded;                               // Buffer for the encoded frame
+    DWORD cbRead;                                   // Number of encoded bytes read so far
+    DWORD dwErrCode;                                // Error code of reading
+    CASC_ASYNC_FRAME * pNext;                       // Next frame in the list of finished frames
+};
+
+// Simple FIFO list of read requests
+struct CASC_ASYNC_LIST
+{
+    CASC_ASYNC_LIST()
+    {
+        pFirst = pLast = NULL;
+    }
+
+    void Push(CASC_ASYNC_READ * pRead)
+    {
+        pRead->pNext = NULL;
+        if(pLast != NULL)
+            pLast->pNext = pRead;
+        else
+            pFirst = pRead;
+        pLast = pRead;
+    }
+
+    CASC_ASYNC_READ * Pop()
+    {
+        CASC_ASYNC_READ * pRead = pFirst;
+
+        if(pRead != NULL)
+        {
+            pFirst = pRead->pNext;
+            if(pFirst == NULL)
+                pLast = NULL;
+        }
+        return pRead;
+    }
+
+    bool IsEmpty()
+    {
+        return (pFirst == NULL);
+    }
+
+    CASC_ASYNC_READ * pFirst;
+    CASC_ASYNC_READ * pLast;
+};
+
+// The read queue. There are two backends:
+// - io_uring (Linux): all frame reads of all requests are issued at once. The threads that
+//   collect completions also decode the frames.
+// - Worker threads: each worker takes one request and reads it synchronously.
+struct TCascReadQueue
+{
+    TCascReadQueue();
+    ~TCascReadQueue();
+
+    static TCascReadQueue * IsValid(HANDLE hQueue)
+    {
+        TCascReadQueue * pQueue = (TCascReadQueue *)hQueue;
+
+        return (pQueue != INVALID_HANDLE_VALUE &&
+                pQueue != NULL &&
+                pQueue->ClassName == CASC_MAGIC_QUEUE) ? pQueue : NULL;
+    }
+
+    DWORD Create(DWORD dwQueueDepth, DWORD dwFlags);
+    void Submit(CASC_ASYNC_READ * pRead);
+    DWORD GetCompletions(PCASC_READ_COMPLETION pCompletions, DWORD dwMaxCount, PDWORD PtrCount, bool bWait);
+
+    // Class recognizer. Has constant value of 'CASCQUEU' (CASC_MAGIC_QUEUE)
+    ULONGLONG ClassName;
+
+    protected:
+
+    void CompleteRead(CASC_ASYNC_READ * pRead, DWORD dwErrCode);
+    void WorkerThread();
+
+    void SubmitToRing(CASC_ASYNC_READ * pRead);
+    void QueueFrameRead(CASC_ASYNC_FRAME * pFrame);
+    DWORD SubmitRing();
+    void FinishFrames(CASC_ASYNC_FRAME * pFinished);
+    bool ProcessRing();
+    void WaitForRing();
+
+    static void WorkerThreadRoutine(void * pvParam);
+
+    CASC_LOCK Lock;                                 // Lock for the entire queue
+    CASC_COND WorkCond;                             // Worker threads: Signalled when a new read is pending
+    CASC_COND DoneCond;                             // Signalled when a read is complete (or the ring waiter is done)
+    CASC_ASYNC_LIST PendingList;                    // Worker threads: Reads that were not taken by a worker yet
+    CASC_ASYNC_LIST DoneList;                       // Completed reads, not retrieved by the caller yet
+    DWORD dwInFlight;                               // Number of reads that are submitted, but not complete yet
+    DWORD dwCallers;                                // Number of threads inside Submit or GetCompletions
+
+    CASC_IO_RING Ring;                              // io_uring, if available
+    DWORD dwRingInFlight;                           // io_uring: Number of frame reads in the ring
+    bool bRingWaiter;                               // io_uring: A thread is waiting in the kernel for completions
+
+    CASC_THREAD Threads[CASC_MAX_WORKER_THREADS];   // Worker threads, if io_uring is not used
+    DWORD dwThreadCount;                            // Number of worker threads
+    bool bShutdown;                                 // Worker threads: Set to true when the queue is being closed
+};
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+// Creates the frame structure for io_uring
+static CASC_ASYNC_FRAME * AllocateAsyncFrame(CASC_ASYNC_READ * pRead, PCASC_CKEY_ENTRY pCKeyEntry, PCASC_FILE_SPAN pFileSpan, DWORD FrameIndex, HANDLE hDataFile)
+{
+    CASC_ASYNC_FRAME * pFrame;
+
+    if((pFrame = CASC_ALLOC_ZERO<CASC_ASYNC_FRAME>(1)) != NULL)
+    {
+        pFrame->pRead = pRead;
+        pFrame->pCKeyEntry = pCKeyEntry;
+        pFrame->pFileSpan = pFileSpan;
+        pFrame->pFrame = pFileSpan->pFrames + FrameIndex;
+        pFrame->FrameIndex = FrameIndex;
+        pFrame->hDataFile = hDataFile;
+
+        if((pFrame->pbEncoded = CASC_ALLOC<BYTE>(pFrame->pFrame->EncodedSize)) == NULL)
+        {
+            CASC_FREE(pFrame);
+            return NULL;
+        }
+    }
+
+    return pFrame;
+}
+
+static void FreeAsyncFrame(CASC_ASYNC_FRAME * pFrame)
+{
+    CASC_FREE(pFrame->pbEncoded);
+    CASC_FREE(pFrame);
+}
+
+// Decodes a frame that has been fully read and copies its part to the user buffer
+static DWORD DecodeAsyncFrame(CASC_ASYNC_FRAME * pFrame)
+{
+    CASC_ASYNC_READ * pRead = pFrame->pRead;
+    PCASC_FILE_FRAME pFileFrame = pFrame->pFrame;
+    ULONGLONG StartOfCopy = CASCLIB_MAX(pFileFrame->StartOffset, pRead->StartOffset);
+    ULONGLONG EndOfCopy = CASCLIB_MIN(pFileFrame->EndOffset, pRead->EndOffset);
+    LPBYTE pbTarget = pRead->pbBuffer + (size_t)(StartOfCopy - pRead->StartOffset);
+    LPBYTE pbDecoded = pbTarget;
+    DWORD dwErrCode;
+
+    // If the frame is not fully covered by the read, we need a temporary buffer
+    if(pFileFrame->StartOffset < pRead->StartOffset || pRead->EndOffset < pFileFrame->EndOffset)
+    {
+        if((pbDecoded = CASC_ALLOC<BYTE>(pFileFrame->ContentSize)) == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    // Decode the frame
+    dwErrCode = DecodeFileFrame(pRead->hf, pFrame->pCKeyEntry, pFileFrame, pFrame->pbEncoded, pbDecoded, pFrame->FrameIndex);
+
+    // Copy the requested part of the frame
+    if(pbDecoded != pbTarget)
+    {
+        if(dwErrCode == ERROR_SUCCESS)
+            memcpy(pbTarget, pbDecoded + (size_t)(StartOfCopy - pFileFrame->StartOffset), (size_t)(EndOfCopy - StartOfCopy));
+        CASC_FREE(pbDecoded);
+    }
+
+    return dwErrCode;
+}
+
+//-----------------------------------------------------------------------------
+// TCascReadQueue functions
+
+TCascReadQueue::TCascReadQueue()
+{
+    ClassName = CASC_MAGIC_QUEUE;
+    dwInFlight = 0;
+    dwCallers = 0;
+    dwRingInFlight = 0;
+    dwThreadCount = 0;
+    bRingWaiter = false;
+    bShutdown = false;
+
+    CascInitLock(Lock);
+    CascInitCond(WorkCond);
+    CascInitCond(DoneCond);
+}
+
+TCascReadQueue::~TCascReadQueue()
+{
+    CASC_ASYNC_READ * pRead;
+
+    // Wait until all submitted reads are complete. The caller's buffers are still in use until then
+    CascLock(Lock);
+    if(Ring.IsOpen())
+    {
+        while(dwInFlight != 0)
+        {
+            if(!ProcessRing())
+                WaitForRing();
+        }
+    }
+    else
+    {
+        while(dwInFlight != 0)
+            CascWaitCond(DoneCond, Lock);
+    }
+
+    // Wait until other threads leave the queue. A thread that waits in the kernel
+    // for the ring comes back within CASC_IO_RING_WAIT_TIMEOUT, even with nothing left in the ring
+    while(dwCallers != 0 || bRingWaiter)
+        CascWaitCond(DoneCond, Lock);
+
+    // Tell the worker threads to exit
+    bShutdown = true;
+    CascBroadcastCond(WorkCond);
+    CascUnlock(Lock);
+
+    // Wait for the worker threads to finish
+    for(DWORD i = 0; i < dwThreadCount; i++)
+        CascJoinThread(Threads[i]);
+    dwThreadCount = 0;
+
+    // Free the completions that were never retrieved
+    while((pRead = DoneList.Pop()) != NULL)
+        CASC_FREE(pRead);
+
+    CascFreeCond(DoneCond);
+    CascFreeCond(WorkCond);
+    CascFreeLock(Lock);
+    ClassName = 0;
+}
+
+DWORD TCascReadQueue::Create(DWORD dwQueueDepth, DWORD dwFlags)
+{
+    DWORD dwThreads;
+
+    // Use io_uring, if it is available and the caller didn't forbid it
+    if((dwFlags & CASC_READ_QUEUE_THREAD_POOL) == 0)
+    {
+        if(Ring.Create(dwQueueDepth))
+            return ERROR_SUCCESS;
+    }
+
+    // Otherwise, start the worker threads
+    dwThreads = (dwQueueDepth != 0) ? dwQueueDepth : CascGetProcessorCount();
+    dwThreads = CASCLIB_MIN(dwThreads, CASC_MAX_WORKER_THREADS);
+    while(dwThreadCount < dwThreads)
+    {
+        if(!CascCreateThread(Threads[dwThreadCount], WorkerThreadRoutine, this))
+            break;
+        dwThreadCount++;
+    }
+
+    return (dwThreadCount != 0) ? ERROR_SUCCESS : ERROR_CAN_NOT_COMPLETE;
+}
+
+void TCascReadQueue::Submit(CASC_ASYNC_READ * pRead)
+{
+    CascLock(Lock);
+    dwCallers++;
+    dwInFlight++;
+
+    // Reads that are beyond the end of the file are complete immediately
+    if(pRead->StartOffset >= pRead->EndOffset)
+    {
+        CompleteRead(pRead, ERROR_SUCCESS);
+    }
+    else if(Ring.IsOpen())
+    {
+        SubmitToRing(pRead);
+    }
+    else
+    {
+        PendingList.Push(pRead);
+        CascSignalCond(WorkCond);
+    }
+
+    // CascCloseReadQueue may be waiting for us to leave
+    if(--dwCallers == 0)
+        CascBroadcastCond(DoneCond);
+    CascUnlock(Lock);
+}
+
+DWORD TCascReadQueue::GetCompletions(PCASC_READ_COMPLETION pCompletions, DWORD dwMaxCount, PDWORD PtrCount, bool bWait)
+{
+    CASC_ASYNC_READ * pRead;
+    DWORD dwErrCode = ERROR_SUCCESS;
+    DWORD dwCount = 0;
+
+    CascLock(Lock);
+    dwCallers++;
+
+    // Wait until there is at least one completion, or nothing to wait for
+    for(;;)
+    {
+        // io_uring: Reap and decode whatever has been read so far
+        if(Ring.IsOpen() && ProcessRing())
+            continue;
+
+        if(!DoneList.IsEmpty() || !bWait || dwInFlight == 0)
+            break;
+
+        if(Ring.IsOpen())
+            WaitForRing();
+        else
+            CascWaitCond(DoneCond, Lock);
+    }
+
+    // Give the completions to the caller
+    while(dwCount < dwMaxCount && (pRead = DoneList.Pop()) != NULL)
+    {
+        pCompletions[dwCount++] = pRead->Completion;
+        CASC_FREE(pRead);
+    }
+
+    // If there was nothing to give and nothing in flight, tell the caller
+    if(dwCount == 0 && dwInFlight == 0)
+        dwErrCode = ERROR_NO_MORE_FILES;
+
+    // CascCloseReadQueue may be waiting for us to leave
+    if(--dwCallers == 0)
+        CascBroadcastCond(DoneCond);
+    CascUnlock(Lock);
+
+    PtrCount[0] = dwCount;
+    return dwErrCode;
+}
+
+// Must be called with the lock held
+void TCascReadQueue::CompleteRead(CASC_ASYNC_READ * pRead, DWORD dwErrCode)
+{
+    pRead->Completion.dwErrCode = dwErrCode;
+    pRead->Completion.dwBytesRead = (dwErrCode == ERROR_SUCCESS) ? (DWORD)(pRead->EndOffset - pRead->StartOffset) : 0;
+    DoneList.Push(pRead);
+    dwInFlight--;
+
+    CascBroadcastCond(DoneCond);
+}
+
+void TCascReadQueue::WorkerThread()
+{
+    CASC_ASYNC_READ * pRead;
+    DWORD dwErrCode;
+
+    CascLock(Lock);
+    for(;;)
+    {
+        // Wait for a pending read
+        while(PendingList.IsEmpty() && bShutdown == false)
+            CascWaitCond(WorkCond, Lock);
+        if((pRead = PendingList.Pop()) == NULL)
+            break;
+        CascUnlock(Lock);
+
+        // Perform the read. This doesn't touch the file pointer nor the file cache
+        dwErrCode = ReadFileRange(pRead->hf, pRead->pbBuffer, pRead->StartOffset, pRead->EndOffset);
+
+        CascLock(Lock);
+        CompleteRead(pRead, dwErrCode);
+    }
+    CascUnlock(Lock);
+}
+
+void TCascReadQueue::WorkerThreadRoutine(void * pvParam)
+{
+    ((TCascReadQueue *)pvParam)->WorkerThread();
+}
+
+// Splits the read to frames and issues one read per frame. Must be called with the lock held
+void TCascReadQueue::SubmitToRing(CASC_ASYNC_READ * pRead)
+{
+    CASC_ASYNC_FRAME * pFrame;
+    PCASC_CKEY_ENTRY pCKeyEntry = pRead->hf->pCKeyEntry;
+    PCASC_FILE_SPAN pFileSpan = pRead->hf->pFileSpan;
+    TCascFile * hf = pRead->hf;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // Only the data files that are plain OS files can be read by io_uring.
+    // Anything else is read synchronously
+    for(DWORD SpanIndex = 0; SpanIndex < hf->SpanCount; SpanIndex++)
+    {
+        if(FileStream_GetFileHandle(pFileSpan[SpanIndex].pStream) == INVALID_HANDLE_VALUE)
+        {
+            CascUnlock(Lock);
+            dwErrCode = ReadFileRange(hf, pRead->pbBuffer, pRead->StartOffset, pRead->EndOffset);
+            CascLock(Lock);
+
+            CompleteRead(pRead, dwErrCode);
+            return;
+        }
+    }
+
+    // The extra pending frame keeps the read alive until all its frames are queued
+    pRead->dwPendingFrames = 1;
+    pRead->Completion.dwErrCode = ERROR_SUCCESS;
+
+    for(DWORD SpanIndex = 0; SpanIndex < hf->SpanCount && dwErrCode == ERROR_SUCCESS; SpanIndex++, pCKeyEntry++, pFileSpan++)
+    {
+        HANDLE hDataFile = FileStream_GetFileHandle(pFileSpan->pStream);
+
+        // Skip the spans that are out of the range
+        if(pFileSpan->EndOffset <= pRead->StartOffset || pRead->EndOffset <= pFileSpan->StartOffset)
+            continue;
+
+        for(DWORD FrameIndex = 0; FrameIndex < pFileSpan->FrameCount; FrameIndex++)
+        {
+            PCASC_FILE_FRAME pFileFrame = pFileSpan->pFrames + FrameIndex;
+
+            // Skip the frames that are out of the range
+            if(pFileFrame->EndOffset <= pRead->StartOffset || pRead->EndOffset <= pFileFrame->StartOffset)
+                continue;
+
+            // Allocate the frame and queue its read
+            if((pFrame = AllocateAsyncFrame(pRead, pCKeyEntry, pFileSpan, FrameIndex, hDataFile)) == NULL)
+            {
+                pRead->Completion.dwErrCode = dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+                break;
+            }
+
+            CASC_PERF_ADD(hf->hs, DiskReadCount, 1);
+            CASC_PERF_ADD(hf->hs, DiskBytesRead, pFileFrame->EncodedSize);
+            pRead->dwPendingFrames++;
+            QueueFrameRead(pFrame);
+        }
+    }
+
+    // Hand the reads to the kernel. On failure, the frames that did not get there are already failed
+    SubmitRing();
+
+    // Drop the extra pending frame. If all frames are done (or there were none), the read is complete
+    if(--pRead->dwPendingFrames == 0)
+        CompleteRead(pRead, pRead->Completion.dwErrCode);
+}
+
+// Puts (the rest of) the frame read into the ring. Must be called with the lock held
+void TCascReadQueue::QueueFrameRead(CASC_ASYNC_FRAME * pFrame)
+{
+    // Never have more reads in the ring than the completion queue can hold
+    while(dwRingInFlight >= Ring.CqEntries)
+    {
+        SubmitRing();
+        if(!ProcessRing())
+            WaitForRing();
+    }
+
+    // If the submission queue is full, hand the entries to the kernel and try again
+    while(!Ring.PushRead(pFrame->hDataFile, pFrame->pbEncoded + pFrame->cbRead, pFrame->pFrame->EncodedSize - pFrame->cbRead, pFrame->pFrame->DataFileOffset + pFrame->cbRead, pFrame))
+        SubmitRing();
+    dwRingInFlight++;
+}
+
+// Hands the queued frame reads to the kernel. If that fails, the reads that were not handed over
+// are taken back from the ring and their frames fail. Otherwise, nobody would ever complete them
+// and WaitForRing would wait for them forever. Must be called with the lock held
+DWORD TCascReadQueue::SubmitRing()
+{
+    CASC_ASYNC_FRAME * pFinished = NULL;
+    CASC_ASYNC_FRAME * pFrame;
+    DWORD dwErrCode;
+
+    if((dwErrCode = Ring.Submit()) != ERROR_SUCCESS)
+    {
+        while(Ring.PopPending((void **)&pFrame))
+        {
+            pFrame->dwErrCode = dwErrCode;
+            pFrame->pNext = pFinished;
+            pFinished = pFrame;
+            dwRingInFlight--;
+        }
+
+        if(pFinished != NULL)
+        {
+            CascUnlock(Lock);
+            FinishFrames(pFinished);
+            CascLock(Lock);
+        }
+    }
+
+    return dwErrCode;
+}
+
+// Decodes the finished frames and completes their reads. Must be called without the lock
+void TCascReadQueue::FinishFrames(CASC_ASYNC_FRAME * pFinished)
+{
+    CASC_ASYNC_FRAME * pFrame;
+
+    // Decode the frames. This is where the CPU time goes, so we do it without the lock
+    for(pFrame = pFinished; pFrame != NULL; pFrame = pFrame->pNext)
+    {
+        if(pFrame->dwErrCode == ERROR_SUCCESS)
+            pFrame->dwErrCode = DecodeAsyncFrame(pFrame);
+    }
+
+    // Complete the reads whose all frames are done
+    CascLock(Lock);
+    while((pFrame = pFinished) != NULL)
+    {
+        CASC_ASYNC_READ * pRead = pFrame->pRead;
+
+        if(pFrame->dwErrCode != ERROR_SUCCESS && pRead->Completion.dwErrCode == ERROR_SUCCESS)
+            pRead->Completion.dwErrCode = pFrame->dwErrCode;
+        if(--pRead->dwPendingFrames == 0)
+            CompleteRead(pRead, pRead->Completion.dwErrCode);
+
+        pFinished = pFrame->pNext;
+        FreeAsyncFrame(pFrame);
+    }
+    CascUnlock(Lock);
+}
+
+// Reaps the completions from the ring and decodes the frames that are fully read.
+// Must be called with the lock held. Returns true if any completion was processed
+bool TCascReadQueue::ProcessRing()
+{
+    CASC_ASYNC_FRAME * pFinished = NULL;
+    CASC_ASYNC_FRAME * pFrame;
+    bool bRequeued = false;
+    int nResult;
+
+    while(Ring.PopCompletion((void **)&pFrame, &nResult))
+    {
+        DWORD cbRemaining = pFrame->pFrame->EncodedSize - pFrame->cbRead;
+        DWORD dwStreamFlags = 0;
+
+        dwRingInFlight--;
+
+        // Read error
+        if(nResult < 0)
+        {
+            pFrame->dwErrCode = (DWORD)(-nResult);
+        }
+
+        // End of file. Same as FileStream_Read: If the stream allows it, fill the rest with zeros
+        else if(nResult == 0)
+        {
+            FileStream_GetFlags(pFrame->pFileSpan->pStream, &dwStreamFlags);
+            if(dwStreamFlags & STREAM_FLAG_FILL_MISSING)
+                memset(pFrame->pbEncoded + pFrame->cbRead, 0, cbRemaining);
+            else
+                pFrame->dwErrCode = ERROR_HANDLE_EOF;
+        }
+
+        // Short read: Queue the rest of the frame again
+        else if((DWORD)nResult < cbRemaining)
+        {
+            pFrame->cbRead += (DWORD)nResult;
+            QueueFrameRead(pFrame);
+            bRequeued = true;
+            continue;
+        }
+
+        // Put the frame to the list of finished frames
+        pFrame->pNext = pFinished;
+        pFinished = pFrame;
+    }
+
+    // If some frames were queued again, submit them
+    if(bRequeued)
+        SubmitRing();
+
+    // Decode the finished frames without holding the lock
+    if(pFinished != NULL)
+    {
+        CascUnlock(Lock);
+        FinishFrames(pFinished);
+        CascLock(Lock);
+    }
+
+    return (pFinished != NULL || bRequeued);
+}
+
+// Waits until something happens in the ring. Must be called with the lock held.
+// Only one thread waits in the kernel; the others wait until it wakes up.
+// The kernel wait has a timeout: while we are not holding the lock, other threads
+// may reap all the remaining completions, and the wait would never end
+void TCascReadQueue::WaitForRing()
+{
+    if(bRingWaiter == false && dwRingInFlight != 0)
+    {
+        bRingWaiter = true;
+        CascUnlock(Lock);
+        Ring.Wait(CASC_IO_RING_WAIT_TIMEOUT);
+        CascLock(Lock);
+        bRingWaiter = false;
+
+        CascBroadcastCond(DoneCond);
+    }
+    else
+    {
+        // Either another thread waits for the ring, or the remaining frames
+        // are being decoded by other threads. Both will signal DoneCond
+        CascWaitCond(DoneCond, Lock);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// Public functions
+
+HANDLE WINAPI CascCreateReadQueue(DWORD dwQueueDepth, DWORD dwFlags)
+{
+    TCascReadQueue * pQueue;
+    DWORD dwErrCode;
+
+    if((pQueue = new TCascReadQueue()) == NULL)
+    {
+        SetCascError(ERROR_NOT_ENOUGH_MEMORY);
+        return NULL;
+    }
+
+    if((dwErrCode = pQueue->Create(dwQueueDepth, dwFlags)) != ERROR_SUCCESS)
+    {
+        delete pQueue;
+        SetCascError(dwErrCode);
+        return NULL;
+    }
+
+    return (HANDLE)pQueue;
+}
+
+bool WINAPI CascReadFileAsync(HANDLE hQueue, HANDLE hFile, ULONGLONG ByteOffset, void * pvBuffer, DWORD dwBytesToRead, void * pvUserData)
+{
+    CASC_ASYNC_READ * pRead;
+    TCascReadQueue * pQueue;
+    TCascFile * hf;
+    DWORD dwErrCode;
+
+    // Validate the parameters
+    if((pQueue = TCascReadQueue::IsValid(hQueue)) == NULL || (hf = TCascFile::IsValid(hFile)) == NULL)
+    {
+        SetCascError(ERROR_INVALID_HANDLE);
+        return false;
+    }
+
+    if(pvBuffer == NULL)
+    {
+        SetCascError(ERROR_INVALID_PARAMETER);
+        return false;
+    }
+
+    // The frames must be loaded before the file can be read from multiple threads.
+    // This also gives us the file size
+    if((dwErrCode = EnsureFileSpanFramesLoaded(hf)) != ERROR_SUCCESS)
+    {
+        SetCascError(dwErrCode);
+        return false;
+    }
+
+    // Create the read request
+    if((pRead = CASC_ALLOC_ZERO<CASC_ASYNC_READ>(1)) == NULL)
+    {
+        SetCascError(ERROR_NOT_ENOUGH_MEMORY);
+        return false;
+    }
+
+    pRead->Completion.pvUserData = pvUserData;
+    pRead->Completion.hFile = hFile;
+    pRead->Completion.pvBuffer = pvBuffer;
+    pRead->Completion.ByteOffset = ByteOffset;
+    pRead->hf = hf;
+    pRead->pbBuffer = (LPBYTE)pvBuffer;
+    pRead->StartOffset = CASCLIB_MIN(ByteOffset, hf->ContentSize);
+    pRead->EndOffset = CASCLIB_MIN(pRead->StartOffset + dwBytesToRead, hf->ContentSize);
+
+    pQueue->Submit(pRead);
+    return true;
+}
+
+bool WINAPI CascGetReadCompletions(HANDLE hQueue, PCASC_READ_COMPLETION pCompletions, DWORD dwMaxCount, PDWORD PtrCount, bool bWait)
+{
+    TCascReadQueue * pQueue;
+    DWORD dwCount = 0;
+    DWORD dwErrCode;
+
+    if((pQueue = TCascReadQueue::IsValid(hQueue)) == NULL)
+    {
+        SetCascError(ERROR_INVALID_HANDLE);
+        return false;
+    }
+
+    if(pCompletions == NULL || dwMaxCount == 0)
+    {
+        SetCascError(ERROR_INVALID_PARAMETER);
+        return false;
+    }
+
+    // Returns ERROR_NO_MORE_FILES if there are no completions and no reads in flight
+    dwErrCode = pQueue->GetCompletions(pCompletions, dwMaxCount, &dwCount, bWait);
+    if(PtrCount != NULL)
+        PtrCount[0] = dwCount;
+
+    if(dwErrCode != ERROR_SUCCESS)
+    {
+        SetCascError(dwErrCode);
+        return false;
+    }
+    return true;
+}
+
+bool WINAPI CascCloseReadQueue(HANDLE hQueue)
+{
+    TCascReadQueue * pQueue;
+
+    if((pQueue = TCascReadQueue::IsValid(hQueue)) == NULL)
+    {
+        SetCascError(ERROR_INVALID_HANDLE);
+        return false;
+    }
+
+    delete pQueue;
+    return true;
+}
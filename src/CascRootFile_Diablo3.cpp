@@ -75,9 +75,70 @@ typedef struct _DIABLO3_DIRECTORY
     DWORD dwAssetEntries;                           // Number of asset entries without subitem number
     DWORD dwAssetIdxEntries;
     DWORD dwNamedEntries;
-    DWORD dwNodeIndex;                              // Index of file node for this folder
 } DIABLO3_DIRECTORY, *PDIABLO3_DIRECTORY;
 
+// In-memory entry of a name batch
+typedef struct _DIABLO3_NAME_ENTRY
+{
+    PCASC_CKEY_ENTRY pCKeyEntry;                    // CKey entry of the file
+    size_t nNameOffset;                             // Offset of the file name in the name buffer
+} DIABLO3_NAME_ENTRY, *PDIABLO3_NAME_ENTRY;
+
+// Batch of file names. Batches are built by worker threads, one for each folder,
+// and inserted into the file tree by a single thread, in the original order
+struct DIABLO3_NAME_BATCH
+{
+    bool Insert(PCASC_CKEY_ENTRY pCKeyEntry, const char * szFileName, size_t nLength)
+    {
+        PDIABLO3_NAME_ENTRY pEntry;
+        char * szNameCopy;
+
+        // Create both arrays on the first insertion
+        if(!Entries.IsInitialized() && Entries.Create<DIABLO3_NAME_ENTRY>(0x100) != ERROR_SUCCESS)
+            return false;
+        if(!Names.IsInitialized() && Names.Create<char>(0x1000) != ERROR_SUCCESS)
+            return false;
+
+        // Insert the entry and the name
+        pEntry = (PDIABLO3_NAME_ENTRY)Entries.Insert(1);
+        szNameCopy = (char *)Names.Insert(nLength + 1);
+        if(pEntry == NULL || szNameCopy == NULL)
+            return false;
+
+        // Fill the entry
+        memcpy(szNameCopy, szFileName, nLength);
+        szNameCopy[nLength] = 0;
+        pEntry->pCKeyEntry = pCKeyEntry;
+        pEntry->nNameOffset = Names.IndexOf(szNameCopy);
+        return true;
+    }
+
+    const char * NameAt(PDIABLO3_NAME_ENTRY pEntry)
+    {
+        return (const char *)Names.ItemAt(pEntry->nNameOffset);
+    }
+
+    void Free()
+    {
+        Entries.Free();
+        Names.Free();
+    }
+
+    CASC_ARRAY Entries;                             // Array of DIABLO3_NAME_ENTRY
+    CASC_ARRAY Names;                               // Buffer of zero-terminated names
+};
+
+// Loading context of one root folder (the named entries of the ROOT file)
+struct DIABLO3_ROOT_FOLDER
+{
+    DIABLO3_DIRECTORY Directory;                    // Parsed directory file of the folder
+    PCASC_CKEY_ENTRY pCKeyEntry;                    // CKey entry of the directory file
+    const char * szFolderName;                      // Folder name. Points to the ROOT file data
+    size_t nFolderName;                             // Length of the folder name
+    DIABLO3_NAME_BATCH NamedFiles;                  // Names from the named entries. Example: "Base\CoreTOC.dat"
+    DIABLO3_NAME_BATCH AssetFiles;                  // Names from the asset entries. Example: "Base\SoundBank\Angel.sbk"
+};
+
 // Structure for conversion DirectoryID -> Directory name
 typedef struct _DIABLO3_ASSET_INFO
 {
@@ -174,7 +235,7 @@ struct TDiabloRoot : public TFileTreeRoot
 
     TDiabloRoot() : TFileTreeRoot(0)
     {
-        memset(RootFolders, 0, sizeof(RootFolders));
+        nRootFolders = 0;
         pFileIndices = NULL;
         pbCoreTocFile = NULL;
         pbCoreTocData = NULL;
@@ -212,19 +273,6 @@ struct TDiabloRoot : public TFileTreeRoot
         return (char *)PackagesMap.FindString(szFileName, szFileName + nLength);
     }
 
-    LPBYTE LoadFileToMemory(TCascStorage * hs, const char * szFileName, DWORD * pcbFileData)
-    {
-        PCASC_CKEY_ENTRY pCKeyEntry;
-        LPBYTE pbFileData = NULL;
-
-        // Try to find CKey for the file
-        pCKeyEntry = GetFile(hs, szFileName);
-        if(pCKeyEntry != NULL)
-            pbFileData = LoadInternalFileToMemory(hs, pCKeyEntry, pcbFileData);
-
-        return pbFileData;
-    }
-
     static LPBYTE CaptureDirectoryData(
         DIABLO3_DIRECTORY & DirHeader,
         LPBYTE pbDirectory,
@@ -459,18 +507,18 @@ struct TDiabloRoot : public TFileTreeRoot
     // Parse the asset entries
     DWORD ParseAssetEntries(
         TCascStorage * hs,
-        DIABLO3_DIRECTORY & Directory,
+        DIABLO3_ROOT_FOLDER & Folder,
         CASC_PATH<char> & PathBuffer)
     {
-        PDIABLO3_ASSET_ENTRY pEntry = (PDIABLO3_ASSET_ENTRY)Directory.pbAssetEntries;
+        PDIABLO3_ASSET_ENTRY pEntry = (PDIABLO3_ASSET_ENTRY)Folder.Directory.pbAssetEntries;
         PCASC_CKEY_ENTRY pCKeyEntry;
         size_t nSavePos = PathBuffer.Save();
-        DWORD dwEntries = Directory.dwAssetEntries;
+        DWORD dwEntries = Folder.Directory.dwAssetEntries;
 
         // Do nothing if there is no entries
         if(pEntry != NULL && dwEntries != 0)
         {
-            // Insert all asset entries to the file tree
+            // Insert all asset entries to the name batch
             for(DWORD i = 0; i < dwEntries; i++, pEntry++)
             {
                 pCKeyEntry = FindCKeyEntry_CKey(hs, pEntry->CKey.Value);
@@ -479,8 +527,9 @@ struct TDiabloRoot : public TFileTreeRoot
                     // Construct the full path name of the entry
                     if(CreateAssetFileName(PathBuffer, pEntry->FileIndex, CASC_INVALID_INDEX))
                     {
-                        // Insert the entry to the file tree
-                        FileTree.InsertByName(pCKeyEntry, PathBuffer);
+                        // Insert the entry to the name batch
+                        if(!Folder.AssetFiles.Insert(pCKeyEntry, PathBuffer, PathBuffer.Length()))
+                            return ERROR_NOT_ENOUGH_MEMORY;
                     }
 
                     // Restore the path buffer position
@@ -494,18 +543,18 @@ struct TDiabloRoot : public TFileTreeRoot
 
     DWORD ParseAssetAndIdxEntries(
         TCascStorage * hs,
-        DIABLO3_DIRECTORY & Directory,
+        DIABLO3_ROOT_FOLDER & Folder,
         CASC_PATH<char> & PathBuffer)
     {
-        PDIABLO3_ASSETIDX_ENTRY pEntry = (PDIABLO3_ASSETIDX_ENTRY)Directory.pbAssetIdxEntries;
+        PDIABLO3_ASSETIDX_ENTRY pEntry = (PDIABLO3_ASSETIDX_ENTRY)Folder.Directory.pbAssetIdxEntries;
         PCASC_CKEY_ENTRY pCKeyEntry;
         size_t nSavePos = PathBuffer.Save();
-        DWORD dwEntries = Directory.dwAssetIdxEntries;
+        DWORD dwEntries = Folder.Directory.dwAssetIdxEntries;
 
         // Do nothing if there is no entries
         if(pEntry != NULL && dwEntries != 0)
         {
-            // Insert all asset entries to the file tree
+            // Insert all asset entries to the name batch
             for(DWORD i = 0; i < dwEntries; i++, pEntry++)
             {
                 pCKeyEntry = FindCKeyEntry_CKey(hs, pEntry->CKey.Value);
@@ -514,9 +563,9 @@ struct TDiabloRoot : public TFileTreeRoot
                     // Construct the full path name of the entry
                     if(CreateAssetFileName(PathBuffer, pEntry->FileIndex, pEntry->SubIndex))
                     {
-                        // Insert the entry to the file tree
-//                      fprintf(fp, "%08u %04u %s\n", pEntry->FileIndex, pEntry->SubIndex, PathBuffer.szBegin);
-                        FileTree.InsertByName(pCKeyEntry, PathBuffer);
+                        // Insert the entry to the name batch
+                        if(!Folder.AssetFiles.Insert(pCKeyEntry, PathBuffer, PathBuffer.Length()))
+                            return ERROR_NOT_ENOUGH_MEMORY;
                     }
 
                     // Restore the path buffer position
@@ -528,27 +577,67 @@ struct TDiabloRoot : public TFileTreeRoot
         return ERROR_SUCCESS;
     }
 
-    // Parse the named entries of all folders
-    DWORD ParseDirectory_Phase1(
-        TCascStorage * hs, 
-        DIABLO3_DIRECTORY & Directory,
-        CASC_PATH<char> & PathBuffer,
-        bool bIsRootDirectory)
+    // Parse the named entries of the ROOT file. Each of them is a root folder
+    DWORD ParseRootDirectory(TCascStorage * hs, DIABLO3_DIRECTORY & RootDirectory)
     {
         DIABLO3_NAMED_ENTRY NamedEntry;
-        size_t nFolderIndex = 0;
-        size_t nSavePos = PathBuffer.Save();
-        DWORD dwErrCode = ERROR_SUCCESS;
+        PCASC_CKEY_ENTRY pCKeyEntry;
+        LPBYTE pbDataPtr = RootDirectory.pbNamedEntries;
+        LPBYTE pbDataEnd = RootDirectory.pbDirectoryEnd;
 
         // Do nothing if there is no named headers
-        if(Directory.pbNamedEntries && Directory.dwNamedEntries)
+        if(RootDirectory.pbNamedEntries && RootDirectory.dwNamedEntries)
         {
-            PCASC_CKEY_ENTRY pCKeyEntry;
-            PCASC_FILE_NODE pFileNode;
-            LPBYTE pbDataPtr = Directory.pbNamedEntries;
-            LPBYTE pbDataEnd = Directory.pbDirectoryEnd;
-            DWORD dwNodeIndex;
+            // Parse all entries
+            while(pbDataPtr < pbDataEnd)
+            {
+                // Capture the named entry
+                pbDataPtr = CaptureNamedEntry(pbDataPtr, pbDataEnd, &NamedEntry);
+                if(pbDataPtr == NULL)
+                    return ERROR_BAD_FORMAT;
+
+                // Check whether the folder exists in the storage
+                pCKeyEntry = FindCKeyEntry_CKey(hs, NamedEntry.pCKey->Value);
+                if(pCKeyEntry != NULL)
+                {
+                    // Check the maximum number of root folders
+                    if(nRootFolders >= DIABLO3_MAX_ROOT_FOLDERS)
+                        return ERROR_BAD_FORMAT;
+                    DIABLO3_ROOT_FOLDER & Folder = RootFolders[nRootFolders];
+
+                    // Mark the entry as directory
+                    pCKeyEntry->Flags |= CASC_CE_FOLDER_ENTRY;
+
+                    // Remember the folder. Its directory file is loaded later
+                    memset(&Folder.Directory, 0, sizeof(DIABLO3_DIRECTORY));
+                    Folder.pCKeyEntry = pCKeyEntry;
+                    Folder.szFolderName = NamedEntry.szFileName;
+                    Folder.nFolderName = (NamedEntry.szFileEnd - NamedEntry.szFileName);
+                    nRootFolders++;
+                }
+            }
+        }
+
+        return ERROR_SUCCESS;
+    }
+
+    // Parse the named entries of a root folder
+    DWORD ParseNamedEntries(TCascStorage * hs, DIABLO3_ROOT_FOLDER & Folder)
+    {
+        DIABLO3_NAMED_ENTRY NamedEntry;
+        CASC_PATH<char> PathBuffer;
+        PCASC_CKEY_ENTRY pCKeyEntry;
+        LPBYTE pbDataPtr = Folder.Directory.pbNamedEntries;
+        LPBYTE pbDataEnd = Folder.Directory.pbDirectoryEnd;
+        size_t nSavePos;
+
+        // All names begin with the folder name
+        PathBuffer.AppendStringN(Folder.szFolderName, Folder.nFolderName, true);
+        nSavePos = PathBuffer.Save();
 
+        // Do nothing if there is no named headers
+        if(Folder.Directory.pbNamedEntries && Folder.Directory.dwNamedEntries)
+        {
             // Parse all entries
             while(pbDataPtr < pbDataEnd)
             {
@@ -564,78 +653,88 @@ struct TDiabloRoot : public TFileTreeRoot
                 pCKeyEntry = FindCKeyEntry_CKey(hs, NamedEntry.pCKey->Value);
                 if(pCKeyEntry != NULL)
                 {
-                    // Create file node belonging to this folder
-                    pFileNode = FileTree.InsertByName(pCKeyEntry, PathBuffer);
-                    dwNodeIndex = (DWORD)FileTree.IndexOf(pFileNode);
-
-                    // If we are parsing root folder, we also need to load the data of the sub-folder file
-                    if(bIsRootDirectory)
-                    {
-                        // Mark the node as directory
-                        pCKeyEntry->Flags |= CASC_CE_FOLDER_ENTRY;
-                        pFileNode->Flags |= CFN_FLAG_FOLDER;
-
-                        // Load the sub-directory file
-                        dwErrCode = LoadDirectoryFile(hs, RootFolders[nFolderIndex], pCKeyEntry);
-                        if(dwErrCode != ERROR_SUCCESS)
-                            return dwErrCode;
-
-                        // Parse the sub-directory file
-                        dwErrCode = ParseDirectory_Phase1(hs, RootFolders[nFolderIndex], PathBuffer, false);
-                        if(dwErrCode != ERROR_SUCCESS)
-                            return dwErrCode;
-
-                        // Also save the item pointer and increment the folder index
-                        RootFolders[nFolderIndex].dwNodeIndex = dwNodeIndex;
-                        nFolderIndex++;
-                    }
-
-                    // Restore the path pointer
-                    PathBuffer.Restore(nSavePos);
+                    if(!Folder.NamedFiles.Insert(pCKeyEntry, PathBuffer, PathBuffer.Length()))
+                        return ERROR_NOT_ENOUGH_MEMORY;
                 }
+
+                // Restore the path pointer
+                PathBuffer.Restore(nSavePos);
             }
         }
 
-        return dwErrCode;
+        return ERROR_SUCCESS;
     }
 
-    // Parse the nameless entries of all folders
-    int ParseDirectory_Phase2(TCascStorage * hs)
+    // Finds a file among the named entries that have been parsed so far
+    PCASC_CKEY_ENTRY FindNamedFile(const char * szFileName)
     {
-        CASC_PATH<char> PathBuffer;
-        char szBuffer[MAX_PATH];
+        PDIABLO3_NAME_ENTRY pEntry;
 
-        // Parse each root subdirectory
-        for(size_t i = 0; i < DIABLO3_MAX_ROOT_FOLDERS; i++)
+        for(size_t i = 0; i < nRootFolders; i++)
         {
-            // Is this root folder loaded?
-            if(RootFolders[i].pbDirectoryData != NULL)
+            DIABLO3_NAME_BATCH & Batch = RootFolders[i].NamedFiles;
+
+            for(size_t j = 0; j < Batch.Entries.ItemCount(); j++)
             {
-                // Retrieve the parent name
-                if(RootFolders[i].dwNodeIndex != 0)
-                {
-                    FileTree.PathAt(szBuffer, _countof(szBuffer), RootFolders[i].dwNodeIndex);
-                    PathBuffer.SetPathRoot(szBuffer);
-                }
+                pEntry = (PDIABLO3_NAME_ENTRY)Batch.Entries.ItemAt(j);
+                if(IsSameFileName(Batch.NameAt(pEntry), szFileName))
+                    return pEntry->pCKeyEntry;
+            }
+        }
 
-                // Array of DIABLO3_ASSET_ENTRY entries.
-                // These are for files belonging to an asset, without subitem number.
-                // Example: "SoundBank\SoundFile.smp"
-                ParseAssetEntries(hs, RootFolders[i], PathBuffer);
+        return NULL;
+    }
 
-                // Array of DIABLO3_ASSETIDX_ENTRY entries.
-                // These are for files belonging to an asset, with a subitem number.
-                // Example: "SoundBank\SoundFile\0001.smp"
-                ParseAssetAndIdxEntries(hs, RootFolders[i], PathBuffer);
-            }
+    static bool IsSameFileName(const char * szFileName1, const char * szFileName2)
+    {
+        // Compare the names case-insensitive, with slashes equal to backslashes
+        while(AsciiToUpperTable_BkSlash[(BYTE)szFileName1[0]] == AsciiToUpperTable_BkSlash[(BYTE)szFileName2[0]])
+        {
+            if(szFileName1[0] == 0)
+                return true;
+            szFileName1++;
+            szFileName2++;
         }
 
-        return ERROR_SUCCESS;
+        return false;
+    }
+
+    // Inserts all names from the batch to the file tree and frees the batch
+    void InsertNameBatch(DIABLO3_NAME_BATCH & Batch)
+    {
+        PDIABLO3_NAME_ENTRY pEntry;
+
+        for(size_t i = 0; i < Batch.Entries.ItemCount(); i++)
+        {
+            pEntry = (PDIABLO3_NAME_ENTRY)Batch.Entries.ItemAt(i);
+            FileTree.InsertByName(pEntry->pCKeyEntry, Batch.NameAt(pEntry));
+        }
+
+        Batch.Free();
+    }
+
+    // Inserts all root folders and their named entries to the file tree
+    void InsertNamedFiles()
+    {
+        PCASC_FILE_NODE pFileNode;
+
+        for(size_t i = 0; i < nRootFolders; i++)
+        {
+            DIABLO3_ROOT_FOLDER & Folder = RootFolders[i];
+
+            // Create the file node of the folder. Note that the folder name is zero-terminated
+            pFileNode = FileTree.InsertByName(Folder.pCKeyEntry, Folder.szFolderName);
+            if(pFileNode != NULL)
+                pFileNode->Flags |= CFN_FLAG_FOLDER;
+
+            // Insert all files belonging to this folder
+            InsertNameBatch(Folder.NamedFiles);
+        }
     }
 
     // Creates an array of DIABLO3_CORE_TOC_ENTRY entries indexed by FileIndex
     // Used as lookup table when we have FileIndex and need Asset+PlainName
-    DWORD CreateMapOfFileIndices(TCascStorage * hs, const char * szFileName)
+    DWORD CreateMapOfFileIndices(TCascStorage * hs, PCASC_CKEY_ENTRY pCKeyEntry)
     {
         PDIABLO3_CORE_TOC_HEADER pTocHeader = NULL;
         LPBYTE pbCoreTocPtr = pbCoreTocFile;
@@ -643,7 +742,8 @@ struct TDiabloRoot : public TFileTreeRoot
         DWORD dwErrCode = ERROR_CAN_NOT_COMPLETE;
 
         // Load the entire file to memory
-        pbCoreTocFile = pbCoreTocPtr = LoadFileToMemory(hs, szFileName, &cbCoreTocFile);
+        if(pCKeyEntry != NULL)
+            pbCoreTocFile = pbCoreTocPtr = LoadInternalFileToMemory(hs, pCKeyEntry, &cbCoreTocFile);
         if(pbCoreTocFile && cbCoreTocFile)
         {
             LPBYTE pbCoreTocEnd = pbCoreTocFile + cbCoreTocFile;
@@ -693,13 +793,14 @@ struct TDiabloRoot : public TFileTreeRoot
     // Packages.dat contains a list of full file names (without locale prefix).
     // They are not sorted, nor they correspond to file IDs.
     // Does the sort order mean something? Perhaps we could use them as listfile?
-    int CreateMapOfRealNames(TCascStorage * hs, const char * szFileName)
+    int CreateMapOfRealNames(TCascStorage * hs, PCASC_CKEY_ENTRY pCKeyEntry)
     {
         DWORD Signature = 0;
         DWORD NumberOfNames = 0;
 
         // Load the entire file to memory
-        pbPackagesDat = LoadFileToMemory(hs, szFileName, &cbPackagesDat);
+        if(pCKeyEntry != NULL)
+            pbPackagesDat = LoadInternalFileToMemory(hs, pCKeyEntry, &cbPackagesDat);
         if(pbPackagesDat && cbPackagesDat)
         {
             LPBYTE pbPackagesPtr = pbPackagesDat;
@@ -735,42 +836,145 @@ struct TDiabloRoot : public TFileTreeRoot
         return ERROR_SUCCESS;
     }
 
-    DWORD Load(TCascStorage * hs, DIABLO3_DIRECTORY & RootDirectory)
+    //
+    //  Worker threads for loading the root folders. The directory files, CoreTOC.dat
+    //  and Packages.dat are independent of each other, so they are loaded in parallel.
+    //  The file names are collected into per-folder batches and merged at the end.
+    //
+
+    struct TLoadContext
+    {
+        TDiabloRoot * pRootHandler;                 // The root handler being loaded
+        TCascStorage * hs;                          // The storage being loaded
+        PCASC_CKEY_ENTRY pCoreTocEntry;             // CKey entry of "Base\CoreTOC.dat"
+        PCASC_CKEY_ENTRY pPackagesEntry;            // CKey entry of "Base\Data_D3\PC\Misc\Packages.dat"
+    };
+
+    // Loads the directory file of one root folder and parses its named entries
+    static DWORD LoadRootFolderWorker(void * pvContext, size_t nItemIndex)
+    {
+        TLoadContext * pContext = (TLoadContext *)pvContext;
+        TDiabloRoot * pRootHandler = pContext->pRootHandler;
+        DIABLO3_ROOT_FOLDER & Folder = pRootHandler->RootFolders[nItemIndex];
+        DWORD dwErrCode;
+
+        dwErrCode = pRootHandler->LoadDirectoryFile(pContext->hs, Folder.Directory, Folder.pCKeyEntry);
+        if(dwErrCode == ERROR_SUCCESS)
+            dwErrCode = pRootHandler->ParseNamedEntries(pContext->hs, Folder);
+        return dwErrCode;
+    }
+
+    // Inserts the named entries to the file tree while CoreTOC.dat and Packages.dat are being loaded
+    static DWORD LoadCoreFilesWorker(void * pvContext, size_t nItemIndex)
     {
+        TLoadContext * pContext = (TLoadContext *)pvContext;
+        TDiabloRoot * pRootHandler = pContext->pRootHandler;
+
+        switch(nItemIndex)
+        {
+            case 0:     // Merge the named entries into the file tree
+                pRootHandler->InsertNamedFiles();
+                return ERROR_SUCCESS;
+
+            case 1:     // CoreTOC.dat is required
+                return pRootHandler->CreateMapOfFileIndices(pContext->hs, pContext->pCoreTocEntry);
+
+            case 2:     // Packages.dat is optional
+                pRootHandler->CreateMapOfRealNames(pContext->hs, pContext->pPackagesEntry);
+                return ERROR_SUCCESS;
+        }
+
+        return ERROR_INVALID_PARAMETER;
+    }
+
+    // Resolves the names of the asset entries of one root folder
+    static DWORD ParseAssetsWorker(void * pvContext, size_t nItemIndex)
+    {
+        TLoadContext * pContext = (TLoadContext *)pvContext;
+        TDiabloRoot * pRootHandler = pContext->pRootHandler;
+        DIABLO3_ROOT_FOLDER & Folder = pRootHandler->RootFolders[nItemIndex];
         CASC_PATH<char> PathBuffer;
+        DWORD dwErrCode = ERROR_SUCCESS;
+
+        // Is this root folder loaded?
+        if(Folder.Directory.pbDirectoryData != NULL)
+        {
+            // All names begin with the folder name
+            PathBuffer.AppendStringN(Folder.szFolderName, Folder.nFolderName, false);
+            PathBuffer.AppendString("\\", false);
+
+            // Array of DIABLO3_ASSET_ENTRY entries.
+            // These are for files belonging to an asset, without subitem number.
+            // Example: "SoundBank\SoundFile.smp"
+            dwErrCode = pRootHandler->ParseAssetEntries(pContext->hs, Folder, PathBuffer);
+
+            // Array of DIABLO3_ASSETIDX_ENTRY entries.
+            // These are for files belonging to an asset, with a subitem number.
+            // Example: "SoundBank\SoundFile\0001.smp"
+            if(dwErrCode == ERROR_SUCCESS)
+                dwErrCode = pRootHandler->ParseAssetAndIdxEntries(pContext->hs, Folder, PathBuffer);
+        }
+
+        return dwErrCode;
+    }
+
+    DWORD Load(TCascStorage * hs, DIABLO3_DIRECTORY & RootDirectory)
+    {
+        TLoadContext Context = {this, hs, NULL, NULL};
+        DWORD dwMaxThreads = GetRootLoaderThreads(hs);
         DWORD dwErrCode;
 
+        // The reference counts of the file entries are kept by the storage
+        FileTree.SetCKeyRefs(&hs->CKeyRefs);
+
         // Always parse the named entries first. They always point to a file.
-        // These are entries with arbitrary names, and they do not belong to an asset
-        dwErrCode = ParseDirectory_Phase1(hs, RootDirectory, PathBuffer, true);
+        // These are entries with arbitrary names, and they do not belong to an asset.
+        // Named entries in the ROOT file are the root folders
+        dwErrCode = ParseRootDirectory(hs, RootDirectory);
+
+        // Load the directory files of all root folders and parse their named entries
+        if(dwErrCode == ERROR_SUCCESS)
+            dwErrCode = CascRunWorkers(LoadRootFolderWorker, &Context, nRootFolders, dwMaxThreads);
+
         if(dwErrCode == ERROR_SUCCESS)
         {
             // The asset entries in the ROOT file don't contain file names, but indices.
-            // To convert a file index to a file name, we need to load and parse the "Base\\CoreTOC.dat" file.
-            dwErrCode = CreateMapOfFileIndices(hs, "Base\\CoreTOC.dat");
+            // To convert a file index to a file name, we need to load and parse the "Base\CoreTOC.dat" file.
+            Context.pCoreTocEntry = FindNamedFile("Base\\CoreTOC.dat");
+
+            // The file "Base\Data_D3\PC\Misc\Packages.dat" contains the file names
+            // (without level-0 and level-1 directory).
+            // We can use these names for supplying the missing extensions
+            Context.pPackagesEntry = FindNamedFile("Base\\Data_D3\\PC\\Misc\\Packages.dat");
+
+            // Load both files while inserting the named entries to the file tree
+            dwErrCode = CascRunWorkers(LoadCoreFilesWorker, &Context, 3, dwMaxThreads);
             if(dwErrCode == ERROR_SUCCESS)
             {
-                // The file "Base\Data_D3\PC\Misc\Packages.dat" contains the file names
-                // (without level-0 and level-1 directory).
-                // We can use these names for supplying the missing extensions
-                CreateMapOfRealNames(hs, "Base\\Data_D3\\PC\\Misc\\Packages.dat");
-
                 // Now parse all folders and resolve the full names
-                ParseDirectory_Phase2(hs);
-            }
+                dwErrCode = CascRunWorkers(ParseAssetsWorker, &Context, nRootFolders, dwMaxThreads);
 
-            // Free all stuff that was used during loading of the ROOT file
-            FreeLoadingStuff();
+                // Merge the asset names into the file tree, in the folder order
+                for(size_t i = 0; i < nRootFolders; i++)
+                    InsertNameBatch(RootFolders[i].AssetFiles);
+            }
         }
 
+        // Free all stuff that was used during loading of the ROOT file
+        FreeLoadingStuff();
         return dwErrCode;
     }
 
     void FreeLoadingStuff()
     {
-        // Free the captured root sub-directories
-        for(size_t i = 0; i < DIABLO3_MAX_SUBDIRS; i++)
-            CASC_FREE(RootFolders[i].pbDirectoryData);
+        // Free the captured root sub-directories and the name batches
+        for(size_t i = 0; i < nRootFolders; i++)
+        {
+            CASC_FREE(RootFolders[i].Directory.pbDirectoryData);
+            RootFolders[i].NamedFiles.Free();
+            RootFolders[i].AssetFiles.Free();
+        }
+        nRootFolders = 0;
 
         // Free the package map
         PackagesMap.Free();
@@ -786,7 +990,8 @@ struct TDiabloRoot : public TFileTreeRoot
     }
 
     // Array of root directory subdirectories
-    DIABLO3_DIRECTORY RootFolders[DIABLO3_MAX_ROOT_FOLDERS];
+    DIABLO3_ROOT_FOLDER RootFolders[DIABLO3_MAX_ROOT_FOLDERS];
+    size_t nRootFolders;
 
     // Array of DIABLO3_TOC_ENTRY structures, sorted by the file index
     // Used for converting FileIndex -> Asset+PlainName during loading
@@ -28,18 +28,53 @@ struct TRootHandler_Install : public TFileTreeRoot
     DWORD Load(TCascStorage * hs, CASC_INSTALL_HEADER InHeader, LPBYTE pbInstallFile, LPBYTE pbInstallEnd)
     {
         PCASC_CKEY_ENTRY pCKeyEntry;
+        PCASC_TAG_ENTRY1 TagArray = NULL;
+        PDWORD EntryIndexes = NULL;
         const char * szString;
         size_t nBitmapLength;
         size_t nFileCount = InHeader.EntryCount;
+        size_t nTagCount = 0;
+        DWORD dwErrCode = ERROR_SUCCESS;
+
+        // The reference counts of the file entries are kept by the storage
+        FileTree.SetCKeyRefs(&hs->CKeyRefs);
 
         // Skip the header
         pbInstallFile += InHeader.HeaderLength;
 
-        // Skip the tags
+        // Allocate space for the tags and for the CKeyArray index of each entry
+        if(InHeader.TagCount != 0)
+        {
+            TagArray = CASC_ALLOC<CASC_TAG_ENTRY1>(InHeader.TagCount);
+            EntryIndexes = CASC_ALLOC<DWORD>(InHeader.EntryCount);
+            if(TagArray == NULL || EntryIndexes == NULL)
+            {
+                CASC_FREE(EntryIndexes);
+                CASC_FREE(TagArray);
+                return ERROR_NOT_ENOUGH_MEMORY;
+            }
+            memset(EntryIndexes, 0xFF, InHeader.EntryCount * sizeof(DWORD));
+        }
+
+        // Capture the tags. They have the same format like the tags in the DOWNLOAD manifest
         for (DWORD i = 0; i < InHeader.TagCount; i++)
         {
             szString = (const char *)pbInstallFile;
             nBitmapLength = GetTagBitmapLength(pbInstallFile, pbInstallEnd, InHeader.EntryCount);
+
+            // Remember the tag, if it's complete
+            if((pbInstallFile + strlen(szString) + 1 + sizeof(USHORT) + nBitmapLength) <= pbInstallEnd)
+            {
+                CASC_TAG_ENTRY1 & InTag = TagArray[nTagCount++];
+
+                InTag.szTagName = szString;
+                InTag.NameLength = strlen(szString);
+                InTag.TagValue = ConvertBytesToInteger_2(pbInstallFile + InTag.NameLength + 1);
+                InTag.Bitmap = pbInstallFile + InTag.NameLength + 1 + sizeof(USHORT);
+                InTag.BitmapLength = nBitmapLength;
+                InTag.TagLength = InTag.NameLength + 1 + sizeof(USHORT) + nBitmapLength;
+            }
+
             pbInstallFile = pbInstallFile + strlen(szString) + 1 + sizeof(USHORT) + nBitmapLength;
         }
 
@@ -56,11 +91,24 @@ struct TRootHandler_Install : public TFileTreeRoot
 
             // Insert the FileName+CKey to the file tree
             if (pCKeyEntry != NULL)
+            {
+                if(EntryIndexes != NULL)
+                    EntryIndexes[InHeader.EntryCount - nFileCount] = (DWORD)hs->CKeyArray.IndexOf(pCKeyEntry);
                 FileTree.InsertByName(pCKeyEntry, szString);
+            }
             nFileCount--;
         }
 
-        return ERROR_SUCCESS;
+        // Insert the tags to the storage
+        if(TagArray != NULL)
+        {
+            hs->dwFeatures |= CASC_FEATURE_TAGS;
+            dwErrCode = InsertManifestTags(hs, TagArray, nTagCount, EntryIndexes, InHeader.EntryCount);
+        }
+
+        CASC_FREE(EntryIndexes);
+        CASC_FREE(TagArray);
+        return dwErrCode;
     }
 };
 
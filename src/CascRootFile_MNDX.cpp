@@ -13,6 +13,15 @@
 #include "CascLib.h"
 #include "CascCommon.h"
 
+// Hardware POPCNT/PDEP/TZCNT are only used on x64, and only if the CPU has them
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#define MNDX_HW_BITOPS
+#elif defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define MNDX_HW_BITOPS
+#endif
+
 //-----------------------------------------------------------------------------
 // Local defines
 
@@ -89,6 +98,14 @@ typedef struct _MNDX_CKEY_ENTRY
 
 } MNDX_CKEY_ENTRY, *PMNDX_CKEY_ENTRY;
 
+// In-memory copy of the MNDX CKey entry, resolved to the storage CKey entry
+typedef struct _MNDX_FILE_ENTRY
+{
+    PCASC_CKEY_ENTRY pCKeyEntry;                    // Pointer to the CKey entry in the storage. NULL if not present
+    DWORD Flags;                                    // Copy of MNDX_CKEY_ENTRY::Flags
+
+} MNDX_FILE_ENTRY, *PMNDX_FILE_ENTRY;
+
 typedef struct _FILE_MAR_INFO
 {
     DWORD MarIndex;
@@ -254,6 +271,111 @@ static DWORD GetNumberOfSetBits32(DWORD Value32)
     return GetNumberOfSetBits(Value32).u.Lower32;
 }
 
+static DWORD GetNumberOfSetBits64_Sw(ULONGLONG Value64)
+{
+    return GetNumberOfSetBits32((DWORD)(Value64)) + GetNumberOfSetBits32((DWORD)(Value64 >> 0x20));
+}
+
+// Returns the bit index of the n-th (zero-based) set bit in a 64-bit value.
+// The caller must make sure that the value has more than n bits set.
+static DWORD GetNthSetBit64_Sw(ULONGLONG Value64, DWORD nBit)
+{
+    SETBITS SetBits;
+    DWORD Value32 = (DWORD)(Value64);
+    DWORD BitIndex = 0;
+
+    // Move to the upper 32 bits if the bit is not in the lower ones
+    SetBits = GetNumberOfSetBits(Value32);
+    if(nBit >= SetBits.u.Lower32)
+    {
+        Value32 = (DWORD)(Value64 >> 0x20);
+        nBit = nBit - SetBits.u.Lower32;
+        SetBits = GetNumberOfSetBits(Value32);
+        BitIndex = 0x20;
+    }
+
+    // Find the byte which contains the bit
+    if(nBit < SetBits.u.Lower16)
+    {
+        if(nBit >= SetBits.u.Lower08)
+        {
+            Value32 >>= 0x08;
+            BitIndex += 0x08;
+            nBit -= SetBits.u.Lower08;
+        }
+    }
+    else
+    {
+        if(nBit < SetBits.u.Lower24)
+        {
+            Value32 >>= 0x10;
+            BitIndex += 0x10;
+            nBit -= SetBits.u.Lower16;
+        }
+        else
+        {
+            Value32 >>= 0x18;
+            BitIndex += 0x18;
+            nBit -= SetBits.u.Lower24;
+        }
+    }
+
+    // The rest is done by the lookup table
+    assert(((nBit << 0x08) + (Value32 & 0xFF)) < sizeof(table_1BA1818));
+    return table_1BA1818[(nBit << 0x08) + (Value32 & 0xFF)] + BitIndex;
+}
+
+#ifdef MNDX_HW_BITOPS
+#ifdef _MSC_VER
+static DWORD GetNumberOfSetBits64_Hw(ULONGLONG Value64)
+{
+    return (DWORD)__popcnt64(Value64);
+}
+
+static DWORD GetNthSetBit64_Hw(ULONGLONG Value64, DWORD nBit)
+{
+    return (DWORD)_tzcnt_u64(_pdep_u64((ULONGLONG)1 << nBit, Value64));
+}
+#else
+__attribute__((target("popcnt")))
+static DWORD GetNumberOfSetBits64_Hw(ULONGLONG Value64)
+{
+    return (DWORD)__builtin_popcountll(Value64);
+}
+
+__attribute__((target("bmi,bmi2")))
+static DWORD GetNthSetBit64_Hw(ULONGLONG Value64, DWORD nBit)
+{
+    return (DWORD)_tzcnt_u64(_pdep_u64((ULONGLONG)1 << nBit, Value64));
+}
+#endif
+
+// Detected once, when the library is loaded
+static DWORD MndxCpuFeatures = CascGetCpuFeatures();
+#endif
+
+inline DWORD GetNumberOfSetBits64(ULONGLONG Value64)
+{
+#if defined(__POPCNT__)
+    return (DWORD)__builtin_popcountll(Value64);
+#else
+#ifdef MNDX_HW_BITOPS
+    if(MndxCpuFeatures & CASC_CPU_POPCNT)
+        return GetNumberOfSetBits64_Hw(Value64);
+#endif
+    return GetNumberOfSetBits64_Sw(Value64);
+#endif
+}
+
+inline DWORD GetNthSetBit64(ULONGLONG Value64, DWORD nBit)
+{
+#ifdef MNDX_HW_BITOPS
+    if(MndxCpuFeatures & CASC_CPU_BMI2)
+        return GetNthSetBit64_Hw(Value64, nBit);
+#endif
+    return GetNthSetBit64_Sw(Value64, nBit);
+}
+
 static LPBYTE CaptureData(LPBYTE pbRootPtr, LPBYTE pbRootEnd, void * pvBuffer, size_t cbLength)
 {
     // Check whether there is enough data in the buffer
@@ -602,21 +724,15 @@ class TBitEntryArray : public TGenericArray<DWORD>
         DWORD dwItemIndex = (EntryIndex * BitsPerEntry) >> 0x05;
         DWORD dwStartBit = (EntryIndex * BitsPerEntry) & 0x1F;
         DWORD dwEndBit = dwStartBit + BitsPerEntry;
-        DWORD dwResult;
+        ULONGLONG Value64 = ItemArray[dwItemIndex];
 
         // If the end bit index is greater than 32,
         // we also need to load from the next 32-bit item
         if(dwEndBit > 0x20)
-        {
-            dwResult = (ItemArray[dwItemIndex + 1] << (0x20 - dwStartBit)) | (ItemArray[dwItemIndex] >> dwStartBit);
-        }
-        else
-        {
-            dwResult = ItemArray[dwItemIndex] >> dwStartBit;
-        }
+            Value64 |= (ULONGLONG)ItemArray[dwItemIndex + 1] << 0x20;
 
         // Now we also need to mask the result by the bit mask
-        return dwResult & EntryBitMask;
+        return (DWORD)(Value64 >> dwStartBit) & EntryBitMask;
     }
 
     DWORD LoadBitsFromStream(TByteStream & InStream)
@@ -743,8 +859,8 @@ class TSparseArray
     DWORD GetItemValueAt(size_t index)
     {
         BASEVALS & SetBitsCount = BaseVals[index >> 0x09];
+        ULONGLONG BitMask;
         DWORD IntValue;
-        DWORD BitMask;
 
         //
         // Since we don't want to count bits for the entire array,
@@ -787,13 +903,21 @@ class TSparseArray
                 break;
         }
 
-        // 3) Count the bits of the higher DWORD, if the index 0x20 - 0x30 above the 0x200 base
-        if(index & 0x20)
-            IntValue += GetNumberOfSetBits32(ItemBits[(index >> 0x05) - 1]);
+        // 3) Count the bits in the current 0x40-item block (masked by bit index mask)
+        BitMask = ((ULONGLONG)1 << (index & 0x3F)) - 1;
+        return IntValue + GetNumberOfSetBits64(GetItemBits64(index >> 0x06) & BitMask);
+    }
 
-        // 4) Count the bits in the current DWORD (masked by bit index mask) 
-        BitMask = (1 << (index & 0x1F)) - 1;
-        return IntValue + GetNumberOfSetBits32(ItemBits[index >> 0x05] & BitMask);
+    // Retrieves 64 item bits at once. The bit array consists of 32-bit integers,
+    // so the upper half may be missing at the end of the array
+    ULONGLONG GetItemBits64(size_t index64)
+    {
+        size_t index32 = (index64 << 0x01);
+        ULONGLONG Value64 = ItemBits[index32];
+
+        if((index32 + 1) < ItemBits.ItemCount)
+            Value64 |= (ULONGLONG)ItemBits[index32 + 1] << 0x20;
+        return Value64;
     }
 
     DWORD FindGroup_Items0(DWORD index)
@@ -881,11 +1005,8 @@ class TSparseArray
     // Returns the value of Item0[index] (HOTS: 1959CB0)
     DWORD GetItem0(DWORD index)
     {
-        SETBITS zeroBits;
         DWORD groupIndex;
         DWORD dwordIndex;
-        DWORD itemIndex;
-        DWORD bitGroup;
         DWORD edx = index;
 
 #ifdef _DEBUG
@@ -976,71 +1097,15 @@ class TSparseArray
         }
 
         // HOTS: 1959E53:
-        // Calculate the number of bits set in the value of "bitGroup"
-        bitGroup = ~ItemBits[dwordIndex];
-        zeroBits = GetNumberOfSetBits(bitGroup);
-
-        if (edx >= zeroBits.u.Lower32)
-        {
-            // HOTS: 1959ea4
-            bitGroup = ~ItemBits[++dwordIndex];
-            edx = edx - zeroBits.u.Lower32;
-            zeroBits = GetNumberOfSetBits(bitGroup);
-        }
-
-        // Re-calculate the item index
-        itemIndex = (dwordIndex << 0x05);
-
-        // HOTS: 1959eea
-        if (edx < zeroBits.u.Lower16)
-        {
-            // HOTS: 1959EFC
-            if (edx >= zeroBits.u.Lower08)
-            {
-                // HOTS: 1959F05
-                bitGroup >>= 0x08;
-                itemIndex += 0x08;
-                edx -= zeroBits.u.Lower08;
-            }
-        }
-        else
-        {
-            // HOTS: 1959F0D
-            if (edx < zeroBits.u.Lower24)
-            {
-                // HOTS: 1959F19
-                bitGroup >>= 0x10;
-                itemIndex += 0x10;
-                edx -= zeroBits.u.Lower16;
-            }
-            else
-            {
-                // HOTS: 1959F23
-                bitGroup >>= 0x18;
-                itemIndex += 0x18;
-                edx -= zeroBits.u.Lower24;
-            }
-        }
-
-        // HOTS: 1959f2b
-        edx = edx << 0x08;
-        bitGroup = bitGroup & 0xFF;
-
-        // BUGBUG: Possible buffer overflow here. Happens when dwItemIndex >= 0x9C.
-        // The same happens in Heroes of the Storm (build 29049), so I am not sure
-        // if this is a bug or a case that never happens
-        assert((bitGroup + edx) < sizeof(table_1BA1818));
-        return table_1BA1818[bitGroup + edx] + itemIndex;
+        // The item is the edx-th zero bit in the 0x40-bit block that begins at dwordIndex
+        return (dwordIndex << 0x05) + GetNthSetBit64(~GetItemBits64(dwordIndex >> 0x01), edx);
     }
 
     DWORD GetItem1(DWORD index)
     {
-        SETBITS setBits;
         DWORD distFromBase;
         DWORD groupIndex;
         DWORD dwordIndex;
-        DWORD itemIndex;
-        DWORD bitGroup;
 
         // If the index is at begin of the group, we just return the start value
         if ((index & 0x1FF) == 0)
@@ -1122,59 +1187,8 @@ class TSparseArray
         }
 
         // HOTS: 195A066
-        bitGroup = ItemBits[dwordIndex];
-        setBits = GetNumberOfSetBits(bitGroup);
-
-        // Get total number of set bits in the bit group
-        if (distFromBase >= setBits.u.Lower32)
-        {
-            // HOTS: 195A0B2
-            bitGroup = ItemBits[++dwordIndex];
-            distFromBase = distFromBase - setBits.u.Lower32;
-            setBits = GetNumberOfSetBits(bitGroup);
-        }
-
-        // Calculate the item index
-        itemIndex = (dwordIndex << 0x05);
-
-        // Get the number of set bits in the lower word (HOTS: 195A0F6)
-        if (distFromBase < setBits.u.Lower16)
-        {
-            // HOTS: 195A111
-            if (distFromBase >= setBits.u.Lower08)
-            {
-                // HOTS: 195A111
-                itemIndex = itemIndex + 0x08;
-                bitGroup = bitGroup >> 0x08;
-                distFromBase = distFromBase - setBits.u.Lower08;
-            }
-        }
-        else
-        {
-            // HOTS: 195A119
-            if (distFromBase < setBits.u.Lower24)
-            {
-                // HOTS: 195A125
-                bitGroup = bitGroup >> 0x10;
-                itemIndex = itemIndex + 0x10;
-                distFromBase = distFromBase - setBits.u.Lower16;
-            }
-            else
-            {
-                // HOTS: 195A12F
-                bitGroup = bitGroup >> 0x18;
-                itemIndex = itemIndex + 0x18;
-                distFromBase = distFromBase - setBits.u.Lower24;
-            }
-        }
-
-        bitGroup = bitGroup & 0xFF;
-        distFromBase = distFromBase << 0x08;
-
-        // BUGBUG: Potential buffer overflow
-        // Happens in Heroes of the Storm when index == 0x5B
-        assert((bitGroup + distFromBase) < sizeof(table_1BA1818));
-        return table_1BA1818[bitGroup + distFromBase] + itemIndex;
+        // The item is the distFromBase-th set bit in the 0x40-bit block that begins at dwordIndex
+        return (dwordIndex << 0x05) + GetNthSetBit64(GetItemBits64(dwordIndex >> 0x01), distFromBase);
     }
 
 #ifdef _DEBUG
@@ -1375,6 +1389,24 @@ class TMndxSearch
     DWORD nIndex;                       // Index of the file name
 };
 
+//-----------------------------------------------------------------------------
+// Local functions - TMndxFind. Context of the file enumeration; each name
+// found in the MAR is a group of CKey entries, one for every package.
+
+struct TMndxFind
+{
+    TMndxFind()
+    {
+        Search.SetSearchMask("", 0);
+        pFileEntry = NULL;
+        bSearching = true;
+    }
+
+    TMndxSearch Search;                 // Search in the MAR with stripped names
+    PMNDX_FILE_ENTRY pFileEntry;        // Next entry in the current name group. NULL = take the next name
+    bool bSearching;                    // false if the MAR search is complete
+};
+
 //-----------------------------------------------------------------------------
 // TPathFragmentTable class. This class implements table of the path fragments.
 // These path fragments can either by terminated by zeros (ASCIIZ)
@@ -2609,6 +2641,7 @@ struct TMndxHandler
         for(i = 0; i < MAR_COUNT; i++)
             delete MndxInfo.MarFiles[i];
         CASC_FREE(FileNameIndexToCKeyIndex);
+        CASC_FREE(FileEntries);
         pCKeyEntries = NULL;
 
         for(i = 0; i < Packages.ItemCount(); i++)
@@ -2777,14 +2810,14 @@ struct TMndxHandler
         if(dwErrCode == ERROR_SUCCESS)
         {
             assert(MndxInfo.FileNameCount <= MndxInfo.CKeyEntriesCount);
-            FileNameIndexToCKeyIndex = CASC_ALLOC<PMNDX_CKEY_ENTRY>(MndxInfo.FileNameCount + 1);
+            FileNameIndexToCKeyIndex = CASC_ALLOC<DWORD>(MndxInfo.FileNameCount + 1);
             if(FileNameIndexToCKeyIndex != NULL)
             {
                 PMNDX_CKEY_ENTRY pRootEntry = pCKeyEntries;
                 DWORD nFileNameIndex = 0;
 
                 // The first entry is always beginning of a file name group
-                FileNameIndexToCKeyIndex[nFileNameIndex++] = pRootEntry;
+                FileNameIndexToCKeyIndex[nFileNameIndex++] = 0;
 
                 // Get the remaining file name groups
                 for(i = 0; i < MndxInfo.CKeyEntriesCount; i++, pRootEntry++)
@@ -2794,7 +2827,7 @@ struct TMndxHandler
 
                     if (pRootEntry->Flags & MNDX_LAST_CKEY_ENTRY)
                     {
-                        FileNameIndexToCKeyIndex[nFileNameIndex++] = pRootEntry + 1;
+                        FileNameIndexToCKeyIndex[nFileNameIndex++] = i + 1;
                     }
                 }
 
@@ -2815,72 +2848,135 @@ struct TMndxHandler
         return dwErrCode;
     }
 
-    DWORD LoadFileNames(TCascStorage * hs, CASC_FILE_TREE & FileTree)
+    // Resolves all MNDX CKey entries against the storage and keeps them in memory.
+    // Must be called while the ROOT file data are still valid.
+    DWORD LoadFileEntries(TCascStorage * hs)
     {
         PCASC_CKEY_ENTRY pCKeyEntry;
-        PMNDX_CKEY_ENTRY pRootEntry;
-        PMNDX_CKEY_ENTRY pRootEnd = pCKeyEntries + MndxInfo.CKeyEntriesCount;
-        PMNDX_PACKAGE pPackage;
-        TMndxMarFile * pMarFile = MndxInfo.MarFiles[MAR_STRIPPED_NAMES];
-        TMndxSearch Search;
-        char szFileName[MAX_PATH];
-        bool bFindResult = false;
-        DWORD dwErrCode;
+        PMNDX_CKEY_ENTRY pRootEntry = pCKeyEntries;
+        PMNDX_FILE_ENTRY pFileEntry;
 
-        // Setup the search mask
-        Search.SetSearchMask("", 0);
+        // Allocate the array of resolved entries
+        FileEntries = pFileEntry = CASC_ALLOC<MNDX_FILE_ENTRY>(MndxInfo.CKeyEntriesCount);
+        if(FileEntries == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
 
-        // Keep searching ad long as we found something
-        while ((dwErrCode = pMarFile->DoSearch(&Search, &bFindResult)) == ERROR_SUCCESS && bFindResult)
+        // Find the appropriate CKey entries in the central storage.
+        // Each reference is counted, so that the entry is not reported as nameless
+        for(DWORD i = 0; i < MndxInfo.CKeyEntriesCount; i++, pRootEntry++, pFileEntry++)
         {
-            // Sanity check
-            assert(Search.cchFoundPath < MAX_PATH);
+            pCKeyEntry = FindCKeyEntry_CKey(hs, pRootEntry->CKey);
+            if(pCKeyEntry != NULL)
+                hs->CKeyRefs.AddRef(pCKeyEntry);
 
-            // The found file name index must fall into range of file names
-            if (Search.nIndex < MndxInfo.FileNameCount)
+            pFileEntry->pCKeyEntry = pCKeyEntry;
+            pFileEntry->Flags = pRootEntry->Flags;
+        }
+
+        // The ROOT file data are freed after the handler is created
+        pCKeyEntries = NULL;
+        return ERROR_SUCCESS;
+    }
+
+    // Looks up a single file name in the MAR databases. The name must use slashes
+    // and must be in the same letter case as the name stored in the MAR.
+    PCASC_CKEY_ENTRY FindFile(const char * szFileName, size_t cchFileName)
+    {
+        PMNDX_FILE_ENTRY pFileEntry;
+        PMNDX_FILE_ENTRY pFileEnd = FileEntries + MndxInfo.CKeyEntriesCount;
+        TMndxMarFile * pMarFile = MndxInfo.MarFiles[MAR_STRIPPED_NAMES];
+        PMNDX_PACKAGE pPackage;
+        TMndxSearch Search;
+
+        // The name begins with the package name. Since package names can be
+        // prefixes of each other, we have to try all packages that match
+        for(size_t i = 0; i < Packages.ItemCount(); i++)
+        {
+            // Check whether the file name begins with "<package>/"
+            pPackage = (PMNDX_PACKAGE)Packages.ItemAt(i);
+            if(pPackage->szFileName == NULL || pPackage->nLength + 1 >= cchFileName)
+                continue;
+            if(szFileName[pPackage->nLength] != '/' || memcmp(szFileName, pPackage->szFileName, pPackage->nLength))
+                continue;
+
+            // Look up the rest of the name in the MAR of stripped names
+            Search.SetSearchMask(szFileName + pPackage->nLength + 1, cchFileName - pPackage->nLength - 1);
+            if(pMarFile->SearchFile(&Search) != ERROR_SUCCESS || Search.nIndex >= MndxInfo.FileNameCount)
+                continue;
+
+            // Find the entry that belongs to this package
+            pFileEntry = FileEntries + FileNameIndexToCKeyIndex[Search.nIndex];
+            while(pFileEntry < pFileEnd)
             {
-                // Retrieve the first-in-group CKey entry of that name
-                pRootEntry = FileNameIndexToCKeyIndex[Search.nIndex];
+                if((pFileEntry->Flags & 0x00FFFFFF) == pPackage->nIndex)
+                    return pFileEntry->pCKeyEntry;
+                if(pFileEntry->Flags & MNDX_LAST_CKEY_ENTRY)
+                    break;
+                pFileEntry++;
+            }
+        }
 
-                // Now take all files of that name, prepend their package name and insert to file tree
-                while(pRootEntry < pRootEnd)
-                {
-                    // Find the appropriate CKey entry in the central storage
-                    pCKeyEntry = FindCKeyEntry_CKey(hs, pRootEntry->CKey);
-                    if (pCKeyEntry != NULL)
-                    {
-                        size_t nPackageIndex = pRootEntry->Flags & 0x00FFFFFF;
+        return NULL;
+    }
 
-                        // Retrieve the package for this entry
-                        pPackage = (PMNDX_PACKAGE)Packages.ItemAt(nPackageIndex);
-                        if (pPackage != NULL)
-                        {
-                            // Sanity check
-                            assert(pPackage->nIndex == nPackageIndex);
+    // Retrieves the next file from the MAR database, together with its full name.
+    // The file name is built the same way as the file tree would build it
+    PCASC_CKEY_ENTRY FindNextFile(TMndxFind * pFind, char * szBuffer, size_t cchBuffer)
+    {
+        PMNDX_FILE_ENTRY pFileEntry;
+        TMndxMarFile * pMarFile = MndxInfo.MarFiles[MAR_STRIPPED_NAMES];
+        PMNDX_PACKAGE pPackage;
+        bool bFindResult = false;
+
+        while(pFind->bSearching)
+        {
+            // Do we need to find a next file name?
+            if(pFind->pFileEntry == NULL)
+            {
+                if(pMarFile->DoSearch(&pFind->Search, &bFindResult) != ERROR_SUCCESS || bFindResult == false)
+                {
+                    pFind->bSearching = false;
+                    break;
+                }
 
-                            // Merge the package name and file name
-                            MakeFileName(szFileName, _countof(szFileName), pPackage, &Search);
+                // The found file name index must fall into range of file names
+                if(pFind->Search.nIndex < MndxInfo.FileNameCount)
+                    pFind->pFileEntry = FileEntries + FileNameIndexToCKeyIndex[pFind->Search.nIndex];
+                continue;
+            }
 
-                            // Insert the entry to the file tree
-                            FileTree.InsertByName(pCKeyEntry, szFileName);
-                        }
-                    }
+            // Take the entry and move to the next one in the group
+            pFileEntry = pFind->pFileEntry++;
+            if((pFileEntry->Flags & MNDX_LAST_CKEY_ENTRY) || pFind->pFileEntry >= FileEntries + MndxInfo.CKeyEntriesCount)
+                pFind->pFileEntry = NULL;
 
-                    // Is this the last-in-group entry?
-                    if (pRootEntry->Flags & MNDX_LAST_CKEY_ENTRY)
-                        break;
-                    pRootEntry++;
+            // Only report entries that are present in the storage
+            if(pFileEntry->pCKeyEntry != NULL)
+            {
+                pPackage = (PMNDX_PACKAGE)Packages.ItemAt(pFileEntry->Flags & 0x00FFFFFF);
+                if(pPackage != NULL && pPackage->szFileName != NULL)
+                {
+                    MakeFileName(szBuffer, cchBuffer, pPackage, &pFind->Search);
+                    return pFileEntry->pCKeyEntry;
                 }
             }
         }
 
-        return dwErrCode;
+        return NULL;
     }
 
     //
     //  Helper functions
     //
 
+    static char * CopyFileNamePart(char * szBuffer, char * szBufferEnd, const char * szNamePart, size_t cchNamePart)
+    {
+        // Copy the part of the name, converting slashes to backslashes
+        for(size_t i = 0; i < cchNamePart && szBuffer < szBufferEnd; i++)
+            *szBuffer++ = (szNamePart[i] == '/') ? '\\' : szNamePart[i];
+        return szBuffer;
+    }
+
     void MakeFileName(char * szBuffer, size_t cchBuffer, PMNDX_PACKAGE pPackage, TMndxSearch * pSearch)
     {
         char * szBufferEnd = szBuffer + cchBuffer - 1;
@@ -2889,23 +2985,14 @@ struct TMndxHandler
         assert((pPackage->nLength + 1 + pSearch->cchFoundPath + 1) < cchBuffer);
 
         // Copy the package name
-        if ((szBuffer + pPackage->nLength) < szBufferEnd)
-        {
-            memcpy(szBuffer, pPackage->szFileName, pPackage->nLength);
-            szBuffer += pPackage->nLength;
-        }
+        szBuffer = CopyFileNamePart(szBuffer, szBufferEnd, pPackage->szFileName, pPackage->nLength);
 
-        // Append slash
-        if ((szBuffer + 1) < szBufferEnd)
-            *szBuffer++ = '/';
+        // Append backslash
+        if(szBuffer < szBufferEnd)
+            *szBuffer++ = '\\';
 
         // Append file name
-        if ((szBuffer + pSearch->cchFoundPath) < szBufferEnd)
-        {
-            memcpy(szBuffer, pSearch->szFoundPath, pSearch->cchFoundPath);
-            szBuffer += pSearch->cchFoundPath;
-        }
-
+        szBuffer = CopyFileNamePart(szBuffer, szBufferEnd, pSearch->szFoundPath, pSearch->cchFoundPath);
         szBuffer[0] = 0;
     }
 
@@ -2913,13 +3000,30 @@ struct TMndxHandler
 
     FILE_MNDX_INFO MndxInfo;
 
-    PMNDX_CKEY_ENTRY * FileNameIndexToCKeyIndex;
-    PMNDX_CKEY_ENTRY pCKeyEntries;
+    DWORD * FileNameIndexToCKeyIndex;           // For each file name, index of the first CKey entry of its group
+    PMNDX_CKEY_ENTRY pCKeyEntries;              // CKey entries in the ROOT file. Only valid during loading
+    PMNDX_FILE_ENTRY FileEntries;               // Resolved CKey entries, kept after loading
     CASC_ARRAY Packages;                        // Linear list of present packages
 };
 
 //-----------------------------------------------------------------------------
 // Handler definition for MNDX root file
+//
+// The MNDX root does not build the file tree. The MAR databases are kept
+// in memory and file names are resolved on demand, both when opening a file
+// by name and during file enumeration. The file tree only holds names
+// that were inserted by the storage (ENCODING, ROOT, ...).
+//
+// The MAR lookup is case-sensitive, but file names are not. Names that are
+// not found in lowercase nor in the caller's letter case are looked up through
+// a map of case-insensitive name hashes, which is built from all MAR names
+// on the first such miss.
+
+typedef struct _MNDX_NAME_HASH
+{
+    ULONGLONG FileNameHash;                     // Hash of the full file name, as calculated by CalcFileNameHash
+    PCASC_CKEY_ENTRY pCKeyEntry;                // CKey entry of the file
+} MNDX_NAME_HASH, *PMNDX_NAME_HASH;
 
 struct TRootHandler_MNDX : public TFileTreeRoot
 {
@@ -2929,23 +3033,162 @@ struct TRootHandler_MNDX : public TFileTreeRoot
     {
         // MNDX supports file names and CKeys
         dwFeatures |= CASC_FEATURE_FILE_NAMES | CASC_FEATURE_ROOT_CKEY;
+
+        // The name hash map is only created when needed
+        CascInitLock(NameHashLock);
+        bNameHashesLoaded = false;
+    }
+
+    ~TRootHandler_MNDX()
+    {
+        NameHashMap.Free();
+        NameHashes.Free();
+        CascFreeLock(NameHashLock);
     }
 
     DWORD Load(TCascStorage * hs, const FILE_MNDX_HEADER & MndxHeader, LPBYTE pbRootFile, LPBYTE pbRootEnd)
     {
-        TMndxHandler Handler;
         DWORD dwErrCode;
 
         // Load and parse the entire MNDX structure
         dwErrCode = Handler.Load(MndxHeader, pbRootFile, pbRootEnd);
         if (dwErrCode == ERROR_SUCCESS)
         {
-            // Search all file names and insert them into the file tree
-            dwErrCode = Handler.LoadFileNames(hs, FileTree);
+            // Resolve the CKey entries, so we don't need the ROOT file anymore
+            dwErrCode = Handler.LoadFileEntries(hs);
         }
 
         return dwErrCode;
     }
+
+    PCASC_CKEY_ENTRY GetFile(TCascStorage * hs, const char * szFileName)
+    {
+        PCASC_CKEY_ENTRY pCKeyEntry;
+        char szNormName[MAX_PATH + 1];
+        size_t nLength;
+
+        // Check the names that were explicitly inserted to the file tree
+        if((pCKeyEntry = TFileTreeRoot::GetFile(hs, szFileName)) != NULL)
+            return pCKeyEntry;
+
+        // File names in the MAR are stored in lowercase, with slashes as separators
+        nLength = NormalizeFileName_LowerSlash(szNormName, szFileName, MAX_PATH);
+        if((pCKeyEntry = Handler.FindFile(szNormName, nLength)) != NULL)
+            return pCKeyEntry;
+
+        // Try the name with the original letter case
+        for(size_t i = 0; i < nLength; i++)
+            szNormName[i] = (szFileName[i] == '\\') ? '/' : szFileName[i];
+        if((pCKeyEntry = Handler.FindFile(szNormName, nLength)) != NULL)
+            return pCKeyEntry;
+
+        // The MAR name has mixed letter case that differs from the caller's one
+        return FindFileByNameHash(CalcFileNameHash(szFileName));
+    }
+
+    PCASC_CKEY_ENTRY GetFile(TCascStorage * hs, DWORD FileDataId)
+    {
+        return TFileTreeRoot::GetFile(hs, FileDataId);
+    }
+
+    PCASC_CKEY_ENTRY Search(TCascSearch * pSearch, PCASC_FIND_DATA pFindData)
+    {
+        PCASC_CKEY_ENTRY pCKeyEntry;
+        TMndxFind * pFind = (TMndxFind *)pSearch->pRootContext;
+
+        // Create the MAR search context on the first call
+        if(pFind == NULL)
+        {
+            pSearch->pRootContext = pFind = new TMndxFind();
+            if(pFind == NULL)
+                return NULL;
+        }
+
+        // Enumerate the file names from the MAR database
+        while((pCKeyEntry = Handler.FindNextFile(pFind, pFindData->szFileName, MAX_PATH)) != NULL)
+        {
+            if(pSearch->Mask.Check(pFindData->szFileName))
+                return pCKeyEntry;
+        }
+
+        // Continue with the names inserted to the file tree
+        return TFileTreeRoot::Search(pSearch, pFindData);
+    }
+
+    void EndSearch(TCascSearch * pSearch)
+    {
+        delete (TMndxFind *)pSearch->pRootContext;
+        pSearch->pRootContext = NULL;
+
+        // Also free the context of the file tree search
+        TFileTreeRoot::EndSearch(pSearch);
+    }
+
+    protected:
+
+    DWORD LoadNameHashes()
+    {
+        PMNDX_NAME_HASH pNameHash;
+        PCASC_CKEY_ENTRY pCKeyEntry;
+        TMndxFind Find;
+        char szFileName[MAX_PATH + 1];
+        DWORD dwErrCode;
+
+        // Hash all file names from the MAR database
+        if((dwErrCode = NameHashes.Create<MNDX_NAME_HASH>(0x10000)) != ERROR_SUCCESS)
+            return dwErrCode;
+        while((pCKeyEntry = Handler.FindNextFile(&Find, szFileName, MAX_PATH)) != NULL)
+        {
+            if((pNameHash = (PMNDX_NAME_HASH)NameHashes.Insert(1)) == NULL)
+                return ERROR_NOT_ENOUGH_MEMORY;
+            pNameHash->FileNameHash = CalcFileNameHash(szFileName);
+            pNameHash->pCKeyEntry = pCKeyEntry;
+        }
+
+        // Create the map over the finished array. Names that only differ
+        // in letter case have the same hash, the first one wins.
+        dwErrCode = NameHashMap.Create(NameHashes.ItemCount(), sizeof(ULONGLONG), FIELD_OFFSET(MNDX_NAME_HASH, FileNameHash));
+        if(dwErrCode != ERROR_SUCCESS)
+            return dwErrCode;
+        for(size_t i = 0; i < NameHashes.ItemCount(); i++)
+        {
+            pNameHash = (PMNDX_NAME_HASH)NameHashes.ItemAt(i);
+            NameHashMap.InsertObject(pNameHash, &pNameHash->FileNameHash);
+        }
+        return ERROR_SUCCESS;
+    }
+
+    PCASC_CKEY_ENTRY FindFileByNameHash(ULONGLONG FileNameHash)
+    {
+        PMNDX_NAME_HASH pNameHash = NULL;
+
+        CascLock(NameHashLock);
+        {
+            // Build the map on the first lookup. If it fails, we do not retry
+            if(bNameHashesLoaded == false)
+            {
+                if(LoadNameHashes() != ERROR_SUCCESS)
+                {
+                    NameHashMap.Free();
+                    NameHashes.Free();
+                }
+                bNameHashesLoaded = true;
+            }
+
+            if(NameHashMap.IsInitialized())
+                pNameHash = (PMNDX_NAME_HASH)NameHashMap.FindObject(&FileNameHash);
+        }
+        CascUnlock(NameHashLock);
+
+        return (pNameHash != NULL) ? pNameHash->pCKeyEntry : NULL;
+    }
+
+    TMndxHandler Handler;
+
+    CASC_ARRAY NameHashes;                      // Array of MNDX_NAME_HASH. Only created on the first name that misses the MAR
+    CASC_MAP NameHashMap;                       // Map of FileNameHash -> MNDX_NAME_HASH
+    CASC_LOCK NameHashLock;                     // Lock for building the name hash map
+    bool bNameHashesLoaded;                     // If true, the name hash map was already built
 };
 
 //-----------------------------------------------------------------------------
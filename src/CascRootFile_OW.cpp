@@ -490,7 +490,8 @@ struct TRootHandler_OW : public TFileTreeRoot
 //      size_t nApmFiles = 0;
         BYTE CKey[MD5_HASH_SIZE];
 
-        CASCLIB_UNUSED(hs);
+        // The reference counts of the file entries are kept by the storage
+        FileTree.SetCKeyRefs(&hs->CKeyRefs);
 
         // Keep loading every line until there is something
         while(Csv.LoadNextLine())
@@ -559,6 +560,10 @@ struct TRootHandler_OW : public TFileTreeRoot
 // Public functions
 
 // TODO: There is way more files in the Overwatch CASC storage than present in the ROOT file.
+// They are listed in the CMF/APM manifests, whose parsing is not finished (see TCmfFile and TApmFile).
+// Once it is, the manifests are independent of each other and should be loaded in parallel
+// using CascRunWorkers (see the Diablo III root handler), one name batch per manifest,
+// and merged into the file tree afterwards.
 DWORD RootHandler_CreateOverwatch(TCascStorage * hs, LPBYTE pbRootFile, DWORD cbRootFile)
 {
     TRootHandler_OW * pRootHandler = NULL;
@@ -573,13 +573,15 @@ struct TRootHandler_TVFS : public TFileTreeRoot
                                 pCKeyEntry->ContentSize = pSpanEntry->ContentSize;
                             assert(pCKeyEntry->ContentSize == pSpanEntry->ContentSize);
 
-                            // Fill-in the span entry
+                            // Fill-in the span entry. The entry is only written to if it changes,
+                            // so that the pages of a shared index are not copied needlessly
                             if(dwSpanIndex == 0)
                             {
-                                pCKeyEntry->SpanCount = (BYTE)(dwSpanCount);
-                                pCKeyEntry->RefCount++;
+                                if(pCKeyEntry->SpanCount != (BYTE)(dwSpanCount))
+                                    pCKeyEntry->SpanCount = (BYTE)(dwSpanCount);
+                                hs->CKeyRefs.AddRef(pCKeyEntry);
                             }
-                            else
+                            else if((pCKeyEntry->Flags & CASC_CE_FILE_SPAN) == 0)
                             {
                                 // Mark the CKey entry as a file span. Note that a CKey entry
                                 // can actually be both a file span and a standalone file:
@@ -589,6 +591,7 @@ struct TRootHandler_TVFS : public TFileTreeRoot
 
                             // Copy all from the existing CKey entry
                             memcpy(pSpanEntry, pCKeyEntry, sizeof(CASC_CKEY_ENTRY));
+                            pSpanEntry->RefCount = hs->CKeyRefs.RefCount(pCKeyEntry);
                         }
 
                         // Do nothing if the file is not present locally
@@ -657,6 +660,9 @@ struct TRootHandler_TVFS : public TFileTreeRoot
         CASC_PATH<char> PathBuffer;
         DWORD dwErrCode;
 
+        // The reference counts of the file entries are kept by the storage
+        FileTree.SetCKeyRefs(&hs->CKeyRefs);
+
         // Save the length of the key
         FileTree.SetKeyLength(RootHeader.EKeySize);
 
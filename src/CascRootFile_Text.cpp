@@ -56,6 +56,9 @@ struct TRootHandler_SC1 : public TFileTreeRoot
         BYTE CKey[MD5_HASH_SIZE];
         DWORD dwErrCode;
 
+        // The reference counts of the file entries are kept by the storage
+        FileTree.SetCKeyRefs(&hs->CKeyRefs);
+
         // Parse the ROOT file first in order to see whether we have the correct format
         dwErrCode = Csv.Load(pbRootFile, cbRootFile);
         if(dwErrCode == ERROR_SUCCESS)
@@ -385,6 +385,9 @@ struct TRootHandler_WoW : public TFileTreeRoot
     {
         DWORD dwErrCode;
 
+        // The reference counts of the file entries are kept by the storage
+        FileTree.SetCKeyRefs(&hs->CKeyRefs);
+
         dwErrCode = ParseWowRootFile_Level1(hs, pbRootPtr, pbRootEnd, dwLocaleMask, 0);
         if (dwErrCode == ERROR_SUCCESS)
             dwErrCode = ParseWowRootFile_Level1(hs, pbRootPtr, pbRootEnd, dwLocaleMask, 1);
@@ -398,59 +401,10 @@ struct TRootHandler_WoW : public TFileTreeRoot
         // If we have a listfile, we'll feed the listfile entries to the file tree
         if(pSearch->pCache != NULL && pSearch->bListFileUsed == false)
         {
-            PCASC_FILE_NODE pFileNode;
-            ULONGLONG FileNameHash;
-            size_t nLength;
-            DWORD FileDataId = CASC_INVALID_ID;
-            char szFileName[MAX_PATH];
-
-            if(RootFormat == RootFormatWoW82)
-            {
-                // Keep going through the listfile
-                for(;;)
-                {
-                    // Retrieve the next line from the list file. Ignore lines that are too long to fit in the buffer
-                    nLength = ListFile_GetNext(pSearch->pCache, szFileName, _countof(szFileName), &FileDataId);
-                    if(nLength == 0)
-                    {
-                        if(GetCascError() == ERROR_INSUFFICIENT_BUFFER)
-                            continue;
-                        break;
-                    }
-
-                    // Try to find the file node by file data id
-                    pFileNode = FileTree.FindById(FileDataId);
-                    if(pFileNode != NULL && pFileNode->NameLength == 0)
-                    {
-                        FileTree.SetNodeFileName(pFileNode, szFileName);
-                    }
-                }
-            }
-            else
-            {
-                // Keep going through the listfile
-                for(;;)
-                {
-                    // Retrieve the next line from the list file. Ignore lines that are too long to fit in the buffer
-                    nLength = ListFile_GetNextLine(pSearch->pCache, szFileName, _countof(szFileName));
-                    if(nLength == 0)
-                    {
-                        if(GetCascError() == ERROR_INSUFFICIENT_BUFFER)
-                            continue;
-                        break;
-                    }
-
-                    // Calculate the hash of the file name
-                    FileNameHash = CalcFileNameHash(szFileName);
-
-                    // Try to find the file node by file name hash
-                    pFileNode = FileTree.Find(FileNameHash);
-                    if(pFileNode != NULL && pFileNode->NameLength == 0)
-                    {
-                        FileTree.SetNodeFileName(pFileNode, szFileName);
-                    }
-                }
-            }
+            // Serialize with CascApplyListFile and other searches
+            CascLock(pSearch->hs->StorageLock);
+            ApplyListFile(pSearch->hs, pSearch->pCache);
+            CascUnlock(pSearch->hs->StorageLock);
             pSearch->bListFileUsed = true;
         }
 
@@ -0,0 +1,714 @@
+/*****************************************************************************/
+/* CascScrub.cpp                          Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Integrity check of the entire local storage                               */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 19.10.26  1.00  Lad  The first version of CascScrub.cpp                   */
+/*****************************************************************************/
+
+#define __CASCLIB_SELF__
+#include "CascLib.h"
+#include "CascCommon.h"
+
+//-----------------------------------------------------------------------------
+// Local defines
+
+#define CASC_SCRUB_CHUNK_ENTRIES    0x100           // Maximum number of entries in one work item
+#define CASC_SCRUB_CHUNK_BYTES      0x1000000       // Maximum number of encoded bytes in one work item
+#define CASC_SCRUB_PROGRESS_TIME    100000          // Minimum time between two progress callbacks, in microseconds
+#define CASC_SCRUB_FRAME_TABLE      (BLTE_HEADER_DELTA + 0x0C)  // Offset of the BLTE frame table from the begin of the entry
+
+// Implemented in CascOpenStorage.cpp
+int CaptureEncodingHeader(CASC_ENCODING_HEADER & EnHeader, LPBYTE pbFileData, size_t cbFileData);
+
+// Range of index entries processed by one work item. All entries are in the same data file
+struct CASC_SCRUB_CHUNK
+{
+    size_t nFirstEntry;                             // Index of the first entry in CASC_SCRUB_CONTEXT::Entries
+    size_t nEntryCount;                             // Number of entries
+    DWORD ArchiveIndex;                             // Index of the data file
+};
+
+// State of one work item
+struct CASC_SCRUB_WORKER
+{
+    TFileStream * pStream;                          // Private stream of the data file
+    LPBYTE pbEncoded;                               // Buffer for the encoded data
+    LPBYTE pbDecoded;                               // Buffer for the decoded frame
+    size_t cbEncoded;
+    size_t cbDecoded;
+    PCASC_ENCRYPTION_KEY pLastKey;                  // The key of the last encrypted frame
+
+    // Counters, added to the result when the work item is done
+    ULONGLONG FramesVerified;
+    ULONGLONG BytesVerified;
+    ULONGLONG ContentBytes;
+    size_t OrphanCount;
+    size_t EncryptedCount;
+};
+
+struct CASC_SCRUB_CONTEXT
+{
+    TCascStorage * hs;                              // The storage being checked
+    PCASC_SCRUB_RESULT pResult;                     // Result given by the caller
+    PFNPROGRESSCALLBACK PfnProgressCallback;        // Progress callback and its parameter
+    void * PtrProgressParam;
+    PCASC_SCRUB_ENTRY pDamaged;                     // Array of damaged entries given by the caller
+    size_t nMaxDamaged;
+    DWORD dwFlags;                                  // See CASC_SCRUB_XXX
+
+    CASC_ARRAY Entries;                             // Entries of the index files (CASC_EKEY_ENTRY), sorted by the storage offset
+    CASC_ARRAY Chunks;                              // Work items (CASC_SCRUB_CHUNK)
+    CASC_MAP ESpecMap;                              // EKey -> FILE_ESPEC_ENTRY in the ENCODING manifest
+    LPBYTE pbEncodingFile;                          // Loaded ENCODING manifest
+    size_t nEntryCount;                             // Number of entries after removing duplicates
+
+    CASC_LOCK Lock;                                 // Protects everything below
+    ULONGLONG LastProgressTime;
+    size_t nEntriesDone;
+    bool bCancelled;
+};
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+static int CompareEKeyEntries(const void * pvEntry1, const void * pvEntry2)
+{
+    PCASC_EKEY_ENTRY pEntry1 = (PCASC_EKEY_ENTRY)pvEntry1;
+    PCASC_EKEY_ENTRY pEntry2 = (PCASC_EKEY_ENTRY)pvEntry2;
+
+    if(pEntry1->StorageOffset != pEntry2->StorageOffset)
+        return (pEntry1->StorageOffset < pEntry2->StorageOffset) ? -1 : +1;
+    return memcmp(pEntry1->EKey, pEntry2->EKey, MD5_HASH_SIZE);
+}
+
+static int CompareDamagedEntries(const void * pvEntry1, const void * pvEntry2)
+{
+    PCASC_SCRUB_ENTRY pEntry1 = (PCASC_SCRUB_ENTRY)pvEntry1;
+    PCASC_SCRUB_ENTRY pEntry2 = (PCASC_SCRUB_ENTRY)pvEntry2;
+
+    if(pEntry1->StorageOffset != pEntry2->StorageOffset)
+        return (pEntry1->StorageOffset < pEntry2->StorageOffset) ? -1 : +1;
+    return (int)pEntry1->Damage - (int)pEntry2->Damage;
+}
+
+static void InitScrubEntry(TCascStorage * hs, CASC_SCRUB_ENTRY & Entry, LPBYTE EKey, ULONGLONG StorageOffset, DWORD EncodedSize, PCASC_CKEY_ENTRY pCKeyEntry)
+{
+    memset(&Entry, 0, sizeof(CASC_SCRUB_ENTRY));
+    CopyMemory16(Entry.EKey, EKey);
+    if(pCKeyEntry != NULL && (pCKeyEntry->Flags & CASC_CE_HAS_CKEY))
+        CopyMemory16(Entry.CKey, pCKeyEntry->CKey);
+    Entry.StorageOffset = StorageOffset;
+    Entry.EncodedSize = EncodedSize;
+    Entry.ArchiveIndex = (DWORD)(StorageOffset >> hs->FileOffsetBits);
+    Entry.ArchiveOffs = (DWORD)(StorageOffset & (((ULONGLONG)1 << hs->FileOffsetBits) - 1));
+}
+
+static void AddDamage(CASC_SCRUB_CONTEXT & Ctx, CASC_SCRUB_ENTRY & Entry, CASC_SCRUB_DAMAGE Damage, DWORD dwDetail, DWORD dwErrCode)
+{
+    Entry.Damage = Damage;
+    Entry.dwDetail = dwDetail;
+    Entry.dwErrCode = dwErrCode;
+
+    CascLock(Ctx.Lock);
+    if(Ctx.pResult->DamagedCount < Ctx.nMaxDamaged)
+        Ctx.pDamaged[Ctx.pResult->DamagedCount] = Entry;
+    Ctx.pResult->DamagedCount++;
+    CascUnlock(Ctx.Lock);
+}
+
+static LPBYTE EnsureBuffer(LPBYTE & pbBuffer, size_t & cbBuffer, size_t cbNeeded)
+{
+    if(cbNeeded > cbBuffer)
+    {
+        LPBYTE pbNewBuffer;
+
+        if((pbNewBuffer = CASC_REALLOC(BYTE, pbBuffer, cbNeeded)) == NULL)
+            return NULL;
+        pbBuffer = pbNewBuffer;
+        cbBuffer = cbNeeded;
+    }
+    return pbBuffer;
+}
+
+// Reads data of the entry from the data file
+static DWORD ReadEntryData(CASC_SCRUB_WORKER & Worker, ULONGLONG ByteOffset, LPBYTE pbBuffer, DWORD cbToRead)
+{
+    if(Worker.pStream == NULL)
+        return ERROR_FILE_NOT_FOUND;
+    if(!FileStream_Read(Worker.pStream, &ByteOffset, pbBuffer, cbToRead))
+        return GetCascError();
+    return ERROR_SUCCESS;
+}
+
+// Loads the ENCODING manifest, verifies its pages and builds the map of EKey -> ESpec entry.
+// Damaged pages are reported; only a failure to allocate memory stops the check
+static DWORD VerifyEncodingManifest(CASC_SCRUB_CONTEXT & Ctx)
+{
+    CASC_ENCODING_HEADER EnHeader;
+    CASC_SCRUB_ENTRY Entry;
+    PFILE_CKEY_PAGE pPageHeader;
+    TCascStorage * hs = Ctx.hs;
+    LPBYTE pbEncodingEnd;
+    LPBYTE pbPage;
+    DWORD cbEncodingFile = 0;
+    DWORD dwErrCode;
+
+    // Damage of the ENCODING manifest is reported for its own entry
+    InitScrubEntry(hs, Entry, hs->EncodingCKey.EKey, hs->EncodingCKey.StorageOffset, hs->EncodingCKey.EncodedSize, &hs->EncodingCKey);
+
+    // Load the entire ENCODING manifest
+    if((Ctx.pbEncodingFile = LoadInternalFileToMemory(hs, &hs->EncodingCKey, &cbEncodingFile)) == NULL)
+    {
+        if((dwErrCode = GetCascError()) == ERROR_NOT_ENOUGH_MEMORY)
+            return dwErrCode;
+        AddDamage(Ctx, Entry, CascScrubEncodingPage, 0, dwErrCode);
+        return ERROR_SUCCESS;
+    }
+    pbEncodingEnd = Ctx.pbEncodingFile + cbEncodingFile;
+
+    // Capture the header of the ENCODING manifest
+    if((dwErrCode = (DWORD)CaptureEncodingHeader(EnHeader, Ctx.pbEncodingFile, cbEncodingFile)) != ERROR_SUCCESS)
+    {
+        AddDamage(Ctx, Entry, CascScrubEncodingPage, 0, dwErrCode);
+        return ERROR_SUCCESS;
+    }
+
+    // Verify the CKey pages
+    pPageHeader = (PFILE_CKEY_PAGE)(Ctx.pbEncodingFile + sizeof(FILE_ENCODING_HEADER) + EnHeader.ESpecBlockSize);
+    pbPage = (LPBYTE)(pPageHeader + EnHeader.CKeyPageCount);
+    for(DWORD i = 0; i < EnHeader.CKeyPageCount; i++, pbPage += EnHeader.CKeyPageSize)
+    {
+        if((pbPage + EnHeader.CKeyPageSize) > pbEncodingEnd)
+        {
+            AddDamage(Ctx, Entry, CascScrubEncodingPage, i, ERROR_FILE_CORRUPT);
+            return ERROR_SUCCESS;
+        }
+
+        if(!CascVerifyDataBlockHash(pbPage, EnHeader.CKeyPageSize, pPageHeader[i].SegmentHash))
+            AddDamage(Ctx, Entry, CascScrubEncodingPage, i, ERROR_FILE_CORRUPT);
+        Ctx.pResult->EncodingPages++;
+    }
+
+    // Verify the EKey pages. Their ESpec entries give the expected encoded sizes
+    pPageHeader = (PFILE_CKEY_PAGE)pbPage;
+    pbPage = (LPBYTE)(pPageHeader + EnHeader.EKeyPageCount);
+    if(EnHeader.EKeyPageCount != 0)
+    {
+        size_t MaxItems = ((size_t)EnHeader.EKeyPageCount * EnHeader.EKeyPageSize) / sizeof(FILE_ESPEC_ENTRY);
+
+        if((dwErrCode = Ctx.ESpecMap.Create(MaxItems, CASC_EKEY_SIZE, FIELD_OFFSET(FILE_ESPEC_ENTRY, ESpecKey))) != ERROR_SUCCESS)
+            return dwErrCode;
+
+        for(DWORD i = 0; i < EnHeader.EKeyPageCount; i++, pbPage += EnHeader.EKeyPageSize)
+        {
+            LPBYTE pbPageEnd = pbPage + EnHeader.EKeyPageSize;
+
+            if(pbPageEnd > pbEncodingEnd)
+            {
+                AddDamage(Ctx, Entry, CascScrubEncodingPage, EnHeader.CKeyPageCount + i, ERROR_FILE_CORRUPT);
+                return ERROR_SUCCESS;
+            }
+
+            // Entries of a damaged page are not used for the size check
+            Ctx.pResult->EncodingPages++;
+            if(!CascVerifyDataBlockHash(pbPage, EnHeader.EKeyPageSize, pPageHeader[i].SegmentHash))
+            {
+                AddDamage(Ctx, Entry, CascScrubEncodingPage, EnHeader.CKeyPageCount + i, ERROR_FILE_CORRUPT);
+                continue;
+            }
+
+            // The rest of the page is padded with zeros
+            for(LPBYTE pbESpecEntry = pbPage; (pbESpecEntry + sizeof(FILE_ESPEC_ENTRY)) <= pbPageEnd; pbESpecEntry += sizeof(FILE_ESPEC_ENTRY))
+            {
+                if(!CascIsValidMD5(pbESpecEntry))
+                    break;
+                Ctx.ESpecMap.InsertObject(pbESpecEntry, pbESpecEntry);
+            }
+        }
+    }
+
+    return ERROR_SUCCESS;
+}
+
+// Sorts the index entries by their position in the data files, removes duplicates,
+// reports overlapping entries and splits the entries to work items
+static DWORD PrepareEntries(CASC_SCRUB_CONTEXT & Ctx)
+{
+    PCASC_EKEY_ENTRY pEntries = (PCASC_EKEY_ENTRY)Ctx.Entries.ItemArray();
+    CASC_SCRUB_CHUNK * pChunk = NULL;
+    TCascStorage * hs = Ctx.hs;
+    ULONGLONG ChunkBytes = 0;
+    ULONGLONG MaxEndOffset = 0;                     // The highest end of the previous entries in the same data file
+    size_t nEntryCount = 0;
+
+    qsort(pEntries, Ctx.Entries.ItemCount(), sizeof(CASC_EKEY_ENTRY), CompareEKeyEntries);
+
+    for(size_t i = 0; i < Ctx.Entries.ItemCount(); i++)
+    {
+        PCASC_EKEY_ENTRY pEntry = &pEntries[i];
+        DWORD ArchiveIndex = (DWORD)(pEntry->StorageOffset >> hs->FileOffsetBits);
+
+        if(nEntryCount != 0)
+        {
+            PCASC_EKEY_ENTRY pPrevEntry = &pEntries[nEntryCount - 1];
+
+            // The same EKey may be in the index files more than once
+            if(pPrevEntry->StorageOffset == pEntry->StorageOffset && !memcmp(pPrevEntry->EKey, pEntry->EKey, MD5_HASH_SIZE))
+                continue;
+
+            // Two entries must never share the same bytes of a data file. A long entry
+            // can overlap more than the next one, so we compare with the highest end so far
+            if((pPrevEntry->StorageOffset >> hs->FileOffsetBits) == ArchiveIndex && MaxEndOffset > pEntry->StorageOffset)
+            {
+                CASC_SCRUB_ENTRY Entry;
+
+                InitScrubEntry(hs, Entry, pEntry->EKey, pEntry->StorageOffset, pEntry->EncodedSize, FindCKeyEntry_EKey(hs, pEntry->EKey));
+                AddDamage(Ctx, Entry, CascScrubIndexMismatch, 0, ERROR_FILE_CORRUPT);
+            }
+        }
+
+        // The storage offset includes the data file index, so the end offsets of different data files never mix
+        if(nEntryCount == 0 || (pEntries[nEntryCount - 1].StorageOffset >> hs->FileOffsetBits) != ArchiveIndex)
+            MaxEndOffset = 0;
+        MaxEndOffset = CASCLIB_MAX(MaxEndOffset, pEntry->StorageOffset + pEntry->EncodedSize);
+
+        // Start a new work item if needed
+        if(pChunk == NULL || pChunk->ArchiveIndex != ArchiveIndex || pChunk->nEntryCount >= CASC_SCRUB_CHUNK_ENTRIES || ChunkBytes >= CASC_SCRUB_CHUNK_BYTES)
+        {
+            if((pChunk = (CASC_SCRUB_CHUNK *)Ctx.Chunks.Insert(1)) == NULL)
+                return ERROR_NOT_ENOUGH_MEMORY;
+            pChunk->nFirstEntry = nEntryCount;
+            pChunk->nEntryCount = 0;
+            pChunk->ArchiveIndex = ArchiveIndex;
+            ChunkBytes = 0;
+        }
+
+        // Move the entry to its final position
+        pEntries[nEntryCount++] = *pEntry;
+        ChunkBytes += pEntry->EncodedSize;
+        pChunk->nEntryCount++;
+    }
+
+    Ctx.nEntryCount = nEntryCount;
+    return ERROR_SUCCESS;
+}
+
+// Verifies one entry of the index files
+static DWORD ScrubEntry(CASC_SCRUB_CONTEXT & Ctx, CASC_SCRUB_WORKER & Worker, PCASC_EKEY_ENTRY pEKeyEntry)
+{
+    PBLTE_ENCODED_HEADER pEncodedHeader;
+    PCASC_CKEY_ENTRY pCKeyEntry;
+    CASC_SCRUB_ENTRY Entry;
+    CASC_FILE_FRAME Frame;
+    TCascStorage * hs = Ctx.hs;
+    ULONGLONG ContentSize = 0;
+    ULONGLONG ByteOffset;
+    MD5_CTX EKeyHash;
+    MD5_CTX CKeyHash;
+    LPBYTE pbFramePtr;
+    BYTE md5_digest[MD5_HASH_SIZE];
+    size_t EKeyLength = hs->EKeyLength;
+    DWORD cbEntry = pEKeyEntry->EncodedSize;
+    DWORD cbHeader;
+    DWORD cbRead;
+    DWORD HeaderSize;
+    DWORD FrameCount = 0;
+    DWORD FrameBytes = 0;
+    DWORD dwErrCode;
+    bool bVerifyContent;
+
+    // Find the file entry. Entries that are not in the ENCODING manifest are orphans
+    if((pCKeyEntry = FindCKeyEntry_EKey(hs, pEKeyEntry->EKey)) == NULL)
+        Worker.OrphanCount++;
+    InitScrubEntry(hs, Entry, pEKeyEntry->EKey, pEKeyEntry->StorageOffset, cbEntry, pCKeyEntry);
+
+    // The index files only contain the first bytes of the EKey. The file entry may have all of them
+    if(pCKeyEntry != NULL && (pCKeyEntry->Flags & CASC_CE_HAS_EKEY) && !(pCKeyEntry->Flags & CASC_CE_HAS_EKEY_PARTIAL))
+    {
+        CopyMemory16(Entry.EKey, pCKeyEntry->EKey);
+        EKeyLength = MD5_HASH_SIZE;
+    }
+
+    // The encoded size in the ENCODING manifest doesn't include the local header
+    if(Ctx.ESpecMap.IsInitialized())
+    {
+        PFILE_ESPEC_ENTRY pESpecEntry = (PFILE_ESPEC_ENTRY)Ctx.ESpecMap.FindObject(pEKeyEntry->EKey);
+
+        if(pESpecEntry != NULL && (ConvertBytesToInteger_5(pESpecEntry->FileSizeBE) + BLTE_HEADER_DELTA) != cbEntry)
+            AddDamage(Ctx, Entry, CascScrubIndexMismatch, 0, ERROR_FILE_CORRUPT);
+    }
+
+    // Entries that consist only of the local header have no data to verify
+    if(cbEntry <= BLTE_HEADER_DELTA)
+        return ERROR_SUCCESS;
+
+    // Read the local header, the BLTE header and the beginning of the data
+    cbRead = CASCLIB_MIN(cbEntry, MAX_ENCODED_HEADER);
+    if(EnsureBuffer(Worker.pbEncoded, Worker.cbEncoded, cbRead) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    if((dwErrCode = ReadEntryData(Worker, Entry.ArchiveOffs, Worker.pbEncoded, cbRead)) != ERROR_SUCCESS)
+    {
+        AddDamage(Ctx, Entry, CascScrubReadError, 0, dwErrCode);
+        return ERROR_SUCCESS;
+    }
+
+    // The local header contains the byte-reversed EKey and the encoded size
+    pEncodedHeader = (PBLTE_ENCODED_HEADER)Worker.pbEncoded;
+    for(size_t i = 0; i < EKeyLength; i++)
+    {
+        if(pEncodedHeader->EKey.Value[MD5_HASH_SIZE - 1 - i] != Entry.EKey[i])
+        {
+            AddDamage(Ctx, Entry, CascScrubLocalHeader, 0, ERROR_FILE_CORRUPT);
+            return ERROR_SUCCESS;
+        }
+    }
+    if(ConvertBytesToInteger_4_LE((LPBYTE)&pEncodedHeader->EncodedSize) != cbEntry)
+    {
+        AddDamage(Ctx, Entry, CascScrubLocalHeader, 0, ERROR_FILE_CORRUPT);
+        return ERROR_SUCCESS;
+    }
+
+    // Verify the BLTE header. The header size counts from the signature
+    HeaderSize = (cbRead >= (BLTE_HEADER_DELTA + 8)) ? ConvertBytesToInteger_4(pEncodedHeader->HeaderSize) : 0;
+    cbHeader = BLTE_HEADER_DELTA + ((HeaderSize != 0) ? HeaderSize : 8);
+    if(cbRead < (BLTE_HEADER_DELTA + 8) || ConvertBytesToInteger_4_LE(pEncodedHeader->Signature) != BLTE_HEADER_SIGNATURE || cbHeader > cbEntry)
+    {
+        AddDamage(Ctx, Entry, CascScrubBlteHeader, 0, ERROR_BAD_FORMAT);
+        return ERROR_SUCCESS;
+    }
+
+    // If the header size is nonzero, the frame table follows
+    if(HeaderSize != 0)
+    {
+        FrameCount = (HeaderSize >= 0x0C) ? ConvertBytesToInteger_3(pEncodedHeader->FrameCount) : 0;
+        if(HeaderSize < 0x0C || pEncodedHeader->MustBe0F != 0x0F || FrameCount == 0 || HeaderSize != (0x0C + FrameCount * sizeof(BLTE_FRAME)))
+        {
+            AddDamage(Ctx, Entry, CascScrubBlteHeader, 0, ERROR_BAD_FORMAT);
+            return ERROR_SUCCESS;
+        }
+    }
+
+    // Read the rest of the frame table
+    if(cbHeader > cbRead)
+    {
+        if(EnsureBuffer(Worker.pbEncoded, Worker.cbEncoded, cbHeader) == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+        if((dwErrCode = ReadEntryData(Worker, Entry.ArchiveOffs + cbRead, Worker.pbEncoded + cbRead, cbHeader - cbRead)) != ERROR_SUCCESS)
+        {
+            AddDamage(Ctx, Entry, CascScrubReadError, 0, dwErrCode);
+            return ERROR_SUCCESS;
+        }
+        cbRead = cbHeader;
+    }
+
+    // The frames must cover the rest of the entry
+    pbFramePtr = Worker.pbEncoded + CASC_SCRUB_FRAME_TABLE;
+    for(DWORD i = 0; i < FrameCount; i++, pbFramePtr += sizeof(BLTE_FRAME))
+        FrameBytes += ConvertBytesToInteger_4(((PBLTE_FRAME)pbFramePtr)->EncodedSize);
+    if(FrameCount != 0 && FrameBytes != (cbEntry - cbHeader))
+    {
+        AddDamage(Ctx, Entry, CascScrubBlteHeader, 0, ERROR_BAD_FORMAT);
+        return ERROR_SUCCESS;
+    }
+
+    // The EKey is the MD5 of the BLTE header. Without frame table, it's the MD5 of all the BLTE data
+    MD5_Init(&EKeyHash);
+    MD5_Update(&EKeyHash, Worker.pbEncoded + BLTE_HEADER_DELTA, cbHeader - BLTE_HEADER_DELTA);
+
+    // The content can only be verified for files that are in the ENCODING manifest with a single span
+    bVerifyContent = (pCKeyEntry != NULL) &&
+                     (pCKeyEntry->Flags & CASC_CE_HAS_CKEY) &&
+                     !(pCKeyEntry->Flags & CASC_CE_PLAIN_DATA) &&
+                     (pCKeyEntry->SpanCount <= 1) &&
+                     (pCKeyEntry->ContentSize != CASC_INVALID_SIZE) &&
+                     !(Ctx.dwFlags & CASC_SCRUB_SKIP_CONTENT);
+    MD5_Init(&CKeyHash);
+
+    // Verify all frames. Frameless data is one frame with the content size from the file entry
+    ByteOffset = Entry.ArchiveOffs + cbHeader;
+    for(DWORD i = 0; i < CASCLIB_MAX(FrameCount, 1); i++)
+    {
+        // The frame table is kept at the begin of the buffer
+        if(FrameCount != 0)
+        {
+            PBLTE_FRAME pFileFrame = (PBLTE_FRAME)(Worker.pbEncoded + CASC_SCRUB_FRAME_TABLE) + i;
+
+            Frame.FrameHash   = pFileFrame->FrameHash;
+            Frame.EncodedSize = ConvertBytesToInteger_4(pFileFrame->EncodedSize);
+            Frame.ContentSize = ConvertBytesToInteger_4(pFileFrame->ContentSize);
+        }
+        else
+        {
+            ZeroMemory16(Frame.FrameHash.Value);
+            Frame.EncodedSize = cbEntry - cbHeader;
+            Frame.ContentSize = (pCKeyEntry != NULL) ? pCKeyEntry->ContentSize : 0;
+        }
+
+        // Empty frame can't be decoded
+        if(Frame.EncodedSize == 0)
+        {
+            AddDamage(Ctx, Entry, CascScrubBlteHeader, i, ERROR_BAD_FORMAT);
+            return ERROR_SUCCESS;
+        }
+
+        // Load the frame after the frame table
+        if(EnsureBuffer(Worker.pbEncoded, Worker.cbEncoded, cbHeader + Frame.EncodedSize) == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+        if((dwErrCode = ReadEntryData(Worker, ByteOffset, Worker.pbEncoded + cbHeader, Frame.EncodedSize)) != ERROR_SUCCESS)
+        {
+            AddDamage(Ctx, Entry, CascScrubReadError, i, dwErrCode);
+            return ERROR_SUCCESS;
+        }
+        ByteOffset += Frame.EncodedSize;
+
+        // Verify the frame hash
+        if(FrameCount == 0)
+            MD5_Update(&EKeyHash, Worker.pbEncoded + cbHeader, Frame.EncodedSize);
+        if(!CascVerifyDataBlockHash(Worker.pbEncoded + cbHeader, Frame.EncodedSize, Frame.FrameHash.Value))
+        {
+            AddDamage(Ctx, Entry, CascScrubFrameHash, i, ERROR_FILE_CORRUPT);
+            return ERROR_SUCCESS;
+        }
+        Worker.FramesVerified++;
+
+        // Decode the frame and hash the content
+        if(bVerifyContent)
+        {
+            if(EnsureBuffer(Worker.pbDecoded, Worker.cbDecoded, CASCLIB_MAX(Frame.ContentSize, 1)) == NULL)
+                return ERROR_NOT_ENOUGH_MEMORY;
+
+            dwErrCode = DecodeFileFrame(hs, pCKeyEntry, &Frame, Worker.pbEncoded + cbHeader, Worker.pbDecoded, i, false, false, &Worker.pLastKey);
+            if(dwErrCode == ERROR_FILE_ENCRYPTED)
+            {
+                Worker.EncryptedCount++;
+                bVerifyContent = false;
+            }
+            else if(dwErrCode != ERROR_SUCCESS)
+            {
+                AddDamage(Ctx, Entry, CascScrubContent, i, dwErrCode);
+                return ERROR_SUCCESS;
+            }
+            else
+            {
+                MD5_Update(&CKeyHash, Worker.pbDecoded, Frame.ContentSize);
+                ContentSize += Frame.ContentSize;
+            }
+        }
+    }
+
+    // Verify the EKey
+    MD5_Final(md5_digest, &EKeyHash);
+    if(memcmp(md5_digest, Entry.EKey, EKeyLength))
+    {
+        AddDamage(Ctx, Entry, CascScrubEKey, 0, ERROR_FILE_CORRUPT);
+        return ERROR_SUCCESS;
+    }
+    Worker.BytesVerified += cbEntry;
+
+    // Verify the content key
+    if(bVerifyContent)
+    {
+        MD5_Final(md5_digest, &CKeyHash);
+        if(ContentSize != pCKeyEntry->ContentSize || memcmp(md5_digest, pCKeyEntry->CKey, MD5_HASH_SIZE))
+        {
+            AddDamage(Ctx, Entry, CascScrubContent, 0, ERROR_FILE_CORRUPT);
+            return ERROR_SUCCESS;
+        }
+        Worker.ContentBytes += ContentSize;
+    }
+
+    return ERROR_SUCCESS;
+}
+
+// Reports the progress. Returns true if the caller wants to cancel the check
+static bool AddProgress(CASC_SCRUB_CONTEXT & Ctx, CASC_SCRUB_WORKER & Worker, size_t nEntries)
+{
+    PCASC_SCRUB_RESULT pResult = Ctx.pResult;
+    ULONGLONG CurrentTime;
+    bool bCancelled;
+
+    CascLock(Ctx.Lock);
+
+    // Add the counters of the work item
+    pResult->FramesVerified += Worker.FramesVerified;
+    pResult->BytesVerified += Worker.BytesVerified;
+    pResult->ContentBytes += Worker.ContentBytes;
+    pResult->OrphanCount += Worker.OrphanCount;
+    pResult->EncryptedCount += Worker.EncryptedCount;
+    Ctx.nEntriesDone += nEntries;
+
+    // Call the callback not more often than each CASC_SCRUB_PROGRESS_TIME.
+    // The lock is held, so the callback is never called concurrently
+    CurrentTime = CascPerfGetTime();
+    if(Ctx.PfnProgressCallback != NULL && Ctx.bCancelled == false)
+    {
+        if((CurrentTime - Ctx.LastProgressTime) >= CASC_SCRUB_PROGRESS_TIME || Ctx.nEntriesDone == Ctx.nEntryCount)
+        {
+            Ctx.bCancelled = Ctx.PfnProgressCallback(Ctx.PtrProgressParam, "Verifying storage", NULL, (DWORD)Ctx.nEntriesDone, (DWORD)Ctx.nEntryCount);
+            Ctx.LastProgressTime = CurrentTime;
+        }
+    }
+    bCancelled = Ctx.bCancelled;
+
+    CascUnlock(Ctx.Lock);
+    return bCancelled;
+}
+
+static DWORD ScrubWorker(void * pvContext, size_t nItemIndex)
+{
+    CASC_SCRUB_CONTEXT & Ctx = *(CASC_SCRUB_CONTEXT *)pvContext;
+    CASC_SCRUB_CHUNK * pChunk = (CASC_SCRUB_CHUNK *)Ctx.Chunks.ItemAt(nItemIndex);
+    PCASC_EKEY_ENTRY pEntries = (PCASC_EKEY_ENTRY)Ctx.Entries.ItemArray();
+    CASC_SCRUB_WORKER Worker;
+    TCHAR szPlainName[0x40];
+    TCHAR szDataFile[MAX_PATH];
+    DWORD dwErrCode = ERROR_SUCCESS;
+    bool bCancelled;
+
+    // Don't start new work after the check was cancelled
+    CascLock(Ctx.Lock);
+    bCancelled = Ctx.bCancelled;
+    CascUnlock(Ctx.Lock);
+    if(bCancelled)
+        return ERROR_CANCELLED;
+
+    // Each work item has its own stream, so the reads don't wait for each other.
+    // A missing data file is reported as read error for all its entries
+    memset(&Worker, 0, sizeof(CASC_SCRUB_WORKER));
+    CascStrPrintf(szPlainName, _countof(szPlainName), _T("data.%03u"), pChunk->ArchiveIndex);
+    CombinePath(szDataFile, _countof(szDataFile), Ctx.hs->szIndexPath, szPlainName, NULL);
+    Worker.pStream = FileStream_OpenFile(szDataFile, STREAM_FLAG_READ_ONLY | STREAM_FLAG_WRITE_SHARE | STREAM_PROVIDER_FLAT | BASE_PROVIDER_FILE);
+
+    // Verify all entries of the work item
+    for(size_t i = 0; i < pChunk->nEntryCount && dwErrCode == ERROR_SUCCESS; i++)
+        dwErrCode = ScrubEntry(Ctx, Worker, &pEntries[pChunk->nFirstEntry + i]);
+
+    // Merge the counters and report the progress
+    if(AddProgress(Ctx, Worker, pChunk->nEntryCount) && dwErrCode == ERROR_SUCCESS)
+        dwErrCode = ERROR_CANCELLED;
+
+    FileStream_Close(Worker.pStream);
+    CASC_FREE(Worker.pbEncoded);
+    CASC_FREE(Worker.pbDecoded);
+    return dwErrCode;
+}
+
+static DWORD ScrubStorage(CASC_SCRUB_CONTEXT & Ctx, DWORD dwThreadCount)
+{
+    PCASC_SCRUB_RESULT pResult = Ctx.pResult;
+    TCascStorage * hs = Ctx.hs;
+    DWORD dwErrCode;
+
+    // Inform the user about what we are doing
+    if(Ctx.PfnProgressCallback != NULL && Ctx.PfnProgressCallback(Ctx.PtrProgressParam, "Loading index files", NULL, 0, 0))
+        return ERROR_CANCELLED;
+
+    // Load all entries of the index files
+    if((dwErrCode = LoadIndexEntries(hs, Ctx.Entries)) != ERROR_SUCCESS)
+        return dwErrCode;
+    pResult->EntryCount = Ctx.Entries.ItemCount();
+
+    // Verify the ENCODING manifest
+    if(!(Ctx.dwFlags & CASC_SCRUB_SKIP_ENCODING))
+    {
+        if((dwErrCode = VerifyEncodingManifest(Ctx)) != ERROR_SUCCESS)
+            return dwErrCode;
+    }
+
+    // Sort the entries and prepare the work items
+    if((dwErrCode = Ctx.Chunks.Create<CASC_SCRUB_CHUNK>((Ctx.Entries.ItemCount() / CASC_SCRUB_CHUNK_ENTRIES) + 0x10)) != ERROR_SUCCESS)
+        return dwErrCode;
+    if((dwErrCode = PrepareEntries(Ctx)) != ERROR_SUCCESS)
+        return dwErrCode;
+
+    // Verify the entries over the pool of threads
+    dwThreadCount = (dwThreadCount != 0) ? dwThreadCount : CascGetProcessorCount();
+    dwThreadCount = (DWORD)CASCLIB_MIN(CASCLIB_MIN(dwThreadCount, CASC_MAX_WORKER_THREADS), CASCLIB_MAX(Ctx.Chunks.ItemCount(), 1));
+    pResult->dwThreadCount = dwThreadCount;
+    return CascRunWorkers(ScrubWorker, &Ctx, Ctx.Chunks.ItemCount(), dwThreadCount);
+}
+
+//-----------------------------------------------------------------------------
+// Public functions
+
+bool WINAPI CascScrubStorage(HANDLE hStorage, PCASC_SCRUB_ARGS pArgs, PCASC_SCRUB_RESULT pResult)
+{
+    CASC_SCRUB_CONTEXT Ctx;
+    TCascStorage * hs;
+    ULONGLONG StartTime = CascPerfGetTime();
+    DWORD dwThreadCount = 0;
+    DWORD dwErrCode;
+
+    // Validate the storage handle
+    hs = TCascStorage::IsValid(hStorage);
+    if(hs == NULL)
+    {
+        SetCascError(ERROR_INVALID_HANDLE);
+        return false;
+    }
+
+    // Validate the other parameters
+    if(pResult == NULL)
+    {
+        SetCascError(ERROR_INVALID_PARAMETER);
+        return false;
+    }
+
+    // Only local storages have data files to verify
+    if(hs->dwFeatures & CASC_FEATURE_ONLINE)
+    {
+        SetCascError(ERROR_NOT_SUPPORTED);
+        return false;
+    }
+
+    // Prepare the context. All arguments are optional
+    memset(pResult, 0, sizeof(CASC_SCRUB_RESULT));
+    Ctx.hs = hs;
+    Ctx.pResult = pResult;
+    Ctx.PfnProgressCallback = NULL;
+    Ctx.PtrProgressParam = NULL;
+    Ctx.pDamaged = NULL;
+    Ctx.nMaxDamaged = 0;
+    Ctx.dwFlags = 0;
+    Ctx.pbEncodingFile = NULL;
+    Ctx.nEntryCount = 0;
+    Ctx.LastProgressTime = 0;
+    Ctx.nEntriesDone = 0;
+    Ctx.bCancelled = false;
+    ExtractVersionedArgument(pArgs, offsetof(CASC_SCRUB_ARGS, dwFlags), &Ctx.dwFlags);
+    ExtractVersionedArgument(pArgs, offsetof(CASC_SCRUB_ARGS, dwThreadCount), &dwThreadCount);
+    ExtractVersionedArgument(pArgs, offsetof(CASC_SCRUB_ARGS, PfnProgressCallback), &Ctx.PfnProgressCallback);
+    ExtractVersionedArgument(pArgs, offsetof(CASC_SCRUB_ARGS, PtrProgressParam), &Ctx.PtrProgressParam);
+    ExtractVersionedArgument(pArgs, offsetof(CASC_SCRUB_ARGS, pDamaged), &Ctx.pDamaged);
+    ExtractVersionedArgument(pArgs, offsetof(CASC_SCRUB_ARGS, nMaxDamaged), &Ctx.nMaxDamaged);
+    Ctx.nMaxDamaged = (Ctx.pDamaged != NULL) ? Ctx.nMaxDamaged : 0;
+    CascInitLock(Ctx.Lock);
+
+    // Perform the check
+    dwErrCode = ScrubStorage(Ctx, dwThreadCount);
+
+    // Give the damaged entries in the order of the storage offset
+    if(Ctx.pDamaged != NULL)
+        qsort(Ctx.pDamaged, CASCLIB_MIN(pResult->DamagedCount, Ctx.nMaxDamaged), sizeof(CASC_SCRUB_ENTRY), CompareDamagedEntries);
+
+    // Calculate the throughput
+    pResult->ElapsedMs = (CascPerfGetTime() - StartTime) / 1000;
+    pResult->BytesPerSecond = (pResult->BytesVerified * 1000) / CASCLIB_MAX(pResult->ElapsedMs, 1);
+
+    // Free the context
+    CascFreeLock(Ctx.Lock);
+    CASC_FREE(Ctx.pbEncodingFile);
+    Ctx.ESpecMap.Free();
+    Ctx.Chunks.Free();
+    Ctx.Entries.Free();
+
+    // Any damage is reported as ERROR_FILE_CORRUPT
+    if(dwErrCode == ERROR_SUCCESS && pResult->DamagedCount != 0)
+        dwErrCode = ERROR_FILE_CORRUPT;
+    if(dwErrCode != ERROR_SUCCESS)
+        SetCascError(dwErrCode);
+    return (dwErrCode == ERROR_SUCCESS);
+}
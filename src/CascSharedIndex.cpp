@@ -0,0 +1,432 @@
+/*****************************************************************************/
+/* CascSharedIndex.cpp                    Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Storage index shared between processes through a shared memory segment   */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 19.10.26  1.00  Lad  The first version of CascSharedIndex.cpp             */
+/*****************************************************************************/
+
+#define __CASCLIB_SELF__
+#include "CascLib.h"
+#include "CascCommon.h"
+
+//-----------------------------------------------------------------------------
+// Local defines
+
+#define CASC_SHARED_INDEX_SIGNATURE 0x58444E49      // 'INDX'
+#define CASC_SHARED_INDEX_VERSION   1
+#define CASC_SHARED_INDEX_ALIGNMENT 0x40            // Alignment of the sections in the segment
+
+// One section of the segment
+typedef struct _CASC_SHARED_SECTION
+{
+    ULONGLONG Offset;                               // Offset of the section from the begin of the segment
+    ULONGLONG ItemCount;                            // Number of items in the section
+    ULONGLONG ItemSize;                             // Size of one item, in bytes
+} CASC_SHARED_SECTION, *PCASC_SHARED_SECTION;
+
+// Header of the segment. The segment only contains arrays of pointer-free structures;
+// the hash tables of the maps are stored as indexes into the arrays (CASC_MAP::SaveIndexes)
+typedef struct _CASC_SHARED_INDEX_HEADER
+{
+    DWORD Signature;                                // CASC_SHARED_INDEX_SIGNATURE
+    DWORD Version;                                  // CASC_SHARED_INDEX_VERSION
+    DWORD PointerSize;                              // sizeof(void *) of the process that published the segment
+    DWORD bComplete;                                // Set to 1 after everything else has been written
+    BYTE  Generation[MD5_HASH_SIZE];                // Hash of the build and of the index files the segment was built from
+    ULONGLONG SegmentSize;                          // Size of the segment, in bytes
+
+    ULONGLONG LocalFiles;                           // TCascStorage::LocalFiles
+    ULONGLONG TotalFiles;                           // TCascStorage::TotalFiles
+    ULONGLONG EKeyLength;                           // TCascStorage::EKeyLength
+    ULONGLONG CKeyCount;                            // Number of used items in CKeyArray
+    ULONGLONG IndexMapItems;                        // Maximum item count the IndexMap was created with
+    DWORD FileOffsetBits;                           // TCascStorage::FileOffsetBits
+    DWORD dwFeatures;                               // Features set by loading the index (CASC_FEATURE_TAGS)
+
+    CASC_SHARED_SECTION CKeyArray;                  // All items of CKeyArray, including the spare ones
+    CASC_SHARED_SECTION CKeyMap;                    // Hash table of CKeyMap
+    CASC_SHARED_SECTION EKeyMap;                    // Hash table of EKeyMap
+    CASC_SHARED_SECTION EncodingPages;              // Items of EncodingPages
+    CASC_SHARED_SECTION IndexArray;                 // Items of IndexArray (online storages)
+    CASC_SHARED_SECTION ArchiveIndexes;             // Items of ArchiveIndexes (online storages)
+    CASC_SHARED_SECTION IndexMap;                   // Hash table of IndexMap (online storages)
+    CASC_SHARED_SECTION TagsArray;                  // Items of TagsArray. CASC_TAG_ENTRY2::pFileBits are NULL
+    CASC_SHARED_SECTION TagBitmaps;                 // Plain bitmap of the files of each tag, one item per tag
+    CASC_SHARED_SECTION TaggedFiles;                // Plain bitmap of TaggedFiles
+} CASC_SHARED_INDEX_HEADER, *PCASC_SHARED_INDEX_HEADER;
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+// The generation identifies the build and the state of the index files.
+// Any change of the build or of any index file makes the segment stale.
+static void CalculateGeneration(TCascStorage * hs, LPBYTE Generation)
+{
+    LPCTSTR szStoragePath = (hs->szIndexPath != NULL) ? hs->szIndexPath : hs->szRootPath;
+    MD5_CTX md5_ctx;
+
+    MD5_Init(&md5_ctx);
+    MD5_Update(&md5_ctx, hs->CdnBuildKey.pbData, (unsigned long)hs->CdnBuildKey.cbData);
+    MD5_Update(&md5_ctx, hs->CdnConfigKey.pbData, (unsigned long)hs->CdnConfigKey.cbData);
+    if(szStoragePath != NULL)
+        MD5_Update(&md5_ctx, szStoragePath, (unsigned long)(_tcslen(szStoragePath) * sizeof(TCHAR)));
+    if(hs->szCodeName != NULL)
+        MD5_Update(&md5_ctx, hs->szCodeName, (unsigned long)(_tcslen(hs->szCodeName) * sizeof(TCHAR)));
+
+    // Local storages: the newest index file of each bucket
+    for(size_t i = 0; i < CASC_INDEX_COUNT; i++)
+    {
+        CASC_INDEX & IndexFile = hs->IndexFiles[i];
+
+        MD5_Update(&md5_ctx, &IndexFile.NewSubIndex, sizeof(DWORD));
+        MD5_Update(&md5_ctx, &IndexFile.FileSize, sizeof(ULONGLONG));
+        MD5_Update(&md5_ctx, &IndexFile.FileTime, sizeof(ULONGLONG));
+    }
+
+    MD5_Final(Generation, &md5_ctx);
+}
+
+static void SetSection(CASC_SHARED_SECTION & Section, size_t & cbOffset, size_t ItemCount, size_t ItemSize)
+{
+    Section.Offset = cbOffset;
+    Section.ItemCount = ItemCount;
+    Section.ItemSize = ItemSize;
+    cbOffset = ALIGN_TO_SIZE(cbOffset + ItemCount * ItemSize, CASC_SHARED_INDEX_ALIGNMENT);
+}
+
+static bool IsValidSection(PCASC_SHARED_INDEX_HEADER pHeader, CASC_SHARED_SECTION & Section, size_t ItemSize)
+{
+    if(Section.ItemCount != 0 && Section.ItemSize != ItemSize)
+        return false;
+    if(Section.Offset > pHeader->SegmentSize || Section.ItemCount > ((pHeader->SegmentSize - Section.Offset) / CASCLIB_MAX(ItemSize, 1)))
+        return false;
+    return true;
+}
+
+static LPBYTE GetSection(PCASC_SHARED_INDEX_HEADER pHeader, CASC_SHARED_SECTION & Section)
+{
+    return (LPBYTE)pHeader + Section.Offset;
+}
+
+static size_t GetBitmapSize(size_t nBitCount)
+{
+    return ((nBitCount / 64) + 1) * sizeof(ULONGLONG);
+}
+
+static void SaveBitset(const CASC_BITSET & Bitset, ULONGLONG * pBitmap)
+{
+    CASC_BITSET_ITERATOR Iterator = {0};
+    DWORD dwValue;
+
+    while(Bitset.Next(Iterator, dwValue))
+        pBitmap[dwValue / 64] |= (ULONGLONG)1 << (dwValue % 64);
+}
+
+static DWORD CopyItems(CASC_ARRAY & Array, PCASC_SHARED_INDEX_HEADER pHeader, CASC_SHARED_SECTION & Section)
+{
+    size_t ItemCount = (size_t)Section.ItemCount;
+    size_t ItemSize = (size_t)Section.ItemSize;
+    void * pvItems;
+    DWORD dwErrCode;
+
+    if((dwErrCode = Array.Create(ItemSize, CASCLIB_MAX(ItemCount, 1))) != ERROR_SUCCESS)
+        return dwErrCode;
+    if((pvItems = Array.Insert(ItemCount)) != NULL)
+        memcpy(pvItems, GetSection(pHeader, Section), ItemCount * ItemSize);
+    return ERROR_SUCCESS;
+}
+
+static DWORD LoadMap(CASC_MAP & Map, size_t MaxItems, size_t KeyLength, size_t KeyOffset, PCASC_SHARED_INDEX_HEADER pHeader, CASC_SHARED_SECTION & Section, void * pvItemArray, size_t ItemSize, size_t ItemCount)
+{
+    DWORD dwErrCode;
+
+    if((dwErrCode = Map.Create(MaxItems, KeyLength, KeyOffset)) != ERROR_SUCCESS)
+        return dwErrCode;
+
+    // The hash values depend on the hash table size, so it must be the same as in the publishing process
+    if(Map.HashTableSize() != Section.ItemCount)
+        return ERROR_FILE_CORRUPT;
+
+    // The map may only point to the used items of the array
+    if(!Map.LoadIndexes((PDWORD)GetSection(pHeader, Section), pvItemArray, ItemSize, ItemCount))
+        return ERROR_FILE_CORRUPT;
+    return ERROR_SUCCESS;
+}
+
+static bool IsValidHeader(TCascStorage * hs, PCASC_SHARED_INDEX_HEADER pHeader, size_t cbSegment)
+{
+    BYTE Generation[MD5_HASH_SIZE];
+
+    // Check the header
+    if(cbSegment < sizeof(CASC_SHARED_INDEX_HEADER) || pHeader->Signature != CASC_SHARED_INDEX_SIGNATURE || pHeader->Version != CASC_SHARED_INDEX_VERSION)
+        return false;
+    if(pHeader->PointerSize != sizeof(void *) || pHeader->bComplete == 0 || pHeader->SegmentSize > cbSegment)
+        return false;
+
+    // The segment must have been built from the same build and the same index files
+    CalculateGeneration(hs, Generation);
+    if(memcmp(pHeader->Generation, Generation, MD5_HASH_SIZE))
+        return false;
+
+    // Check the sections
+    if(pHeader->CKeyCount > pHeader->CKeyArray.ItemCount || pHeader->CKeyCount > CASC_INVALID_INDEX)
+        return false;
+    if(!IsValidSection(pHeader, pHeader->CKeyArray, sizeof(CASC_CKEY_ENTRY)) ||
+       !IsValidSection(pHeader, pHeader->CKeyMap, sizeof(DWORD)) ||
+       !IsValidSection(pHeader, pHeader->EKeyMap, sizeof(DWORD)) ||
+       !IsValidSection(pHeader, pHeader->EncodingPages, sizeof(CASC_ENCODING_PAGE)) ||
+       !IsValidSection(pHeader, pHeader->IndexArray, sizeof(CASC_EKEY_ENTRY)) ||
+       !IsValidSection(pHeader, pHeader->ArchiveIndexes, sizeof(CASC_ARCHIVE_INDEX)) ||
+       !IsValidSection(pHeader, pHeader->IndexMap, sizeof(DWORD)) ||
+       !IsValidSection(pHeader, pHeader->TagsArray, (size_t)pHeader->TagsArray.ItemSize) ||
+       !IsValidSection(pHeader, pHeader->TagBitmaps, GetBitmapSize((size_t)pHeader->CKeyCount)) ||
+       !IsValidSection(pHeader, pHeader->TaggedFiles, GetBitmapSize((size_t)pHeader->CKeyCount)))
+        return false;
+
+    // Each tag has its bitmap
+    if(pHeader->TagsArray.ItemCount != 0 && pHeader->TagsArray.ItemSize < sizeof(CASC_TAG_ENTRY2))
+        return false;
+    return (pHeader->TagBitmaps.ItemCount == pHeader->TagsArray.ItemCount);
+}
+
+// Frees everything that AttachSharedIndex may have set up
+static void DetachSharedIndex(TCascStorage * hs)
+{
+    for(size_t i = 0; i < hs->TagsArray.ItemCount(); i++)
+    {
+        PCASC_TAG_ENTRY2 pTag = (PCASC_TAG_ENTRY2)hs->TagsArray.ItemAt(i);
+        delete pTag->pFileBits;
+    }
+
+    hs->TaggedFiles.Free();
+    hs->TagsArray.Free();
+    hs->IndexMap.Free();
+    hs->ArchiveIndexes.Free();
+    hs->IndexArray.Free();
+    hs->EncodingPages.Free();
+    hs->EKeyMap.Free();
+    hs->CKeyMap.Free();
+    hs->CKeyRefs.Free();
+    hs->CKeyArray.Free();
+    hs->SharedIndex.Close();
+}
+
+static DWORD LoadSharedIndex(TCascStorage * hs, PCASC_SHARED_INDEX_HEADER pHeader)
+{
+    LPBYTE pbCKeyArray = GetSection(pHeader, pHeader->CKeyArray);
+    size_t nCKeyCountMax = (size_t)pHeader->CKeyArray.ItemCount;
+    size_t nCKeyCount = (size_t)pHeader->CKeyCount;
+    DWORD dwErrCode;
+
+    // The file entries are used in place. A write to an entry would copy its page, so the ROOT handler
+    // counts the references of the entries in a private table instead of in CASC_CKEY_ENTRY::RefCount
+    hs->CKeyArray.Attach(pbCKeyArray, sizeof(CASC_CKEY_ENTRY), nCKeyCount, nCKeyCountMax);
+    dwErrCode = hs->CKeyRefs.Create((PCASC_CKEY_ENTRY)pbCKeyArray, nCKeyCountMax);
+    if(dwErrCode == ERROR_SUCCESS)
+        dwErrCode = LoadMap(hs->CKeyMap, nCKeyCountMax, MD5_HASH_SIZE, FIELD_OFFSET(CASC_CKEY_ENTRY, CKey), pHeader, pHeader->CKeyMap, pbCKeyArray, sizeof(CASC_CKEY_ENTRY), nCKeyCount);
+    if(dwErrCode == ERROR_SUCCESS)
+        dwErrCode = LoadMap(hs->EKeyMap, nCKeyCountMax, CASC_EKEY_SIZE, FIELD_OFFSET(CASC_CKEY_ENTRY, EKey), pHeader, pHeader->EKeyMap, pbCKeyArray, sizeof(CASC_CKEY_ENTRY), nCKeyCount);
+
+    // The small arrays are copied
+    if(dwErrCode == ERROR_SUCCESS && pHeader->EncodingPages.ItemCount != 0)
+        dwErrCode = CopyItems(hs->EncodingPages, pHeader, pHeader->EncodingPages);
+    if(dwErrCode == ERROR_SUCCESS && pHeader->ArchiveIndexes.ItemCount != 0)
+        dwErrCode = CopyItems(hs->ArchiveIndexes, pHeader, pHeader->ArchiveIndexes);
+
+    // Online storages: the archive index entries and their map
+    if(dwErrCode == ERROR_SUCCESS && pHeader->IndexArray.ItemCount != 0)
+    {
+        dwErrCode = CopyItems(hs->IndexArray, pHeader, pHeader->IndexArray);
+        if(dwErrCode == ERROR_SUCCESS)
+            dwErrCode = LoadMap(hs->IndexMap, (size_t)pHeader->IndexMapItems, MD5_HASH_SIZE, FIELD_OFFSET(CASC_EKEY_ENTRY, EKey), pHeader, pHeader->IndexMap, hs->IndexArray.ItemAt(0), sizeof(CASC_EKEY_ENTRY), hs->IndexArray.ItemCount());
+    }
+
+    // Tags: the bitsets are created again from the plain bitmaps
+    if(dwErrCode == ERROR_SUCCESS && pHeader->TagsArray.ItemCount != 0)
+    {
+        LPBYTE pbTagBitmap = GetSection(pHeader, pHeader->TagBitmaps);
+
+        dwErrCode = CopyItems(hs->TagsArray, pHeader, pHeader->TagsArray);
+        for(size_t i = 0; i < hs->TagsArray.ItemCount() && dwErrCode == ERROR_SUCCESS; i++, pbTagBitmap += pHeader->TagBitmaps.ItemSize)
+        {
+            PCASC_TAG_ENTRY2 pTag = (PCASC_TAG_ENTRY2)hs->TagsArray.ItemAt(i);
+
+            if((pTag->pFileBits = new CASC_BITSET(&hs->Arena)) == NULL)
+                dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+            if(dwErrCode == ERROR_SUCCESS)
+                dwErrCode = pTag->pFileBits->Create((ULONGLONG *)pbTagBitmap, nCKeyCount);
+        }
+    }
+    if(dwErrCode == ERROR_SUCCESS && pHeader->TaggedFiles.ItemCount != 0)
+        dwErrCode = hs->TaggedFiles.Create((ULONGLONG *)GetSection(pHeader, pHeader->TaggedFiles), nCKeyCount);
+
+    // Restore the values that were set by loading the index
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        hs->LocalFiles = (size_t)pHeader->LocalFiles;
+        hs->TotalFiles = (size_t)pHeader->TotalFiles;
+        hs->EKeyLength = (size_t)pHeader->EKeyLength;
+        hs->FileOffsetBits = pHeader->FileOffsetBits;
+        hs->dwFeatures |= (pHeader->dwFeatures & CASC_FEATURE_TAGS) | CASC_FEATURE_SHARED_INDEX;
+    }
+    return dwErrCode;
+}
+
+static size_t CreateLayout(TCascStorage * hs, PCASC_SHARED_INDEX_HEADER pHeader)
+{
+    size_t nBitmapSize = GetBitmapSize(hs->CKeyArray.ItemCount());
+    size_t cbOffset = ALIGN_TO_SIZE(sizeof(CASC_SHARED_INDEX_HEADER), CASC_SHARED_INDEX_ALIGNMENT);
+
+    memset(pHeader, 0, sizeof(CASC_SHARED_INDEX_HEADER));
+    pHeader->Signature = CASC_SHARED_INDEX_SIGNATURE;
+    pHeader->Version = CASC_SHARED_INDEX_VERSION;
+    pHeader->PointerSize = sizeof(void *);
+    CalculateGeneration(hs, pHeader->Generation);
+
+    pHeader->LocalFiles = hs->LocalFiles;
+    pHeader->TotalFiles = hs->TotalFiles;
+    pHeader->EKeyLength = hs->EKeyLength;
+    pHeader->CKeyCount = hs->CKeyArray.ItemCount();
+    pHeader->IndexMapItems = hs->IndexArray.ItemCount();
+    pHeader->FileOffsetBits = hs->FileOffsetBits;
+    pHeader->dwFeatures = hs->dwFeatures & CASC_FEATURE_TAGS;
+
+    // The whole capacity of CKeyArray is in the segment, so that the attached storages
+    // can insert the well-known files. The spare items don't take memory until written.
+    SetSection(pHeader->CKeyArray, cbOffset, hs->CKeyArray.ItemCountMax(), sizeof(CASC_CKEY_ENTRY));
+    SetSection(pHeader->CKeyMap, cbOffset, hs->CKeyMap.HashTableSize(), sizeof(DWORD));
+    SetSection(pHeader->EKeyMap, cbOffset, hs->EKeyMap.HashTableSize(), sizeof(DWORD));
+    SetSection(pHeader->EncodingPages, cbOffset, hs->EncodingPages.ItemCount(), sizeof(CASC_ENCODING_PAGE));
+    SetSection(pHeader->IndexArray, cbOffset, hs->IndexArray.ItemCount(), sizeof(CASC_EKEY_ENTRY));
+    SetSection(pHeader->ArchiveIndexes, cbOffset, hs->ArchiveIndexes.ItemCount(), sizeof(CASC_ARCHIVE_INDEX));
+    SetSection(pHeader->IndexMap, cbOffset, hs->IndexMap.HashTableSize(), sizeof(DWORD));
+    SetSection(pHeader->TagsArray, cbOffset, hs->TagsArray.ItemCount(), hs->TagsArray.ItemSize());
+    SetSection(pHeader->TagBitmaps, cbOffset, hs->TagsArray.ItemCount(), nBitmapSize);
+    SetSection(pHeader->TaggedFiles, cbOffset, (hs->TagsArray.ItemCount() != 0) ? 1 : 0, nBitmapSize);
+    pHeader->SegmentSize = cbOffset;
+    return cbOffset;
+}
+
+static void SaveSharedIndex(TCascStorage * hs, PCASC_SHARED_INDEX_HEADER pHeader)
+{
+    LPBYTE pbTagBitmap = GetSection(pHeader, pHeader->TagBitmaps);
+
+    // Arrays
+    if(hs->CKeyArray.ItemCount() != 0)
+        memcpy(GetSection(pHeader, pHeader->CKeyArray), hs->CKeyArray.ItemAt(0), hs->CKeyArray.ItemCount() * sizeof(CASC_CKEY_ENTRY));
+    if(hs->EncodingPages.ItemCount() != 0)
+        memcpy(GetSection(pHeader, pHeader->EncodingPages), hs->EncodingPages.ItemAt(0), hs->EncodingPages.ItemCount() * sizeof(CASC_ENCODING_PAGE));
+    if(hs->IndexArray.ItemCount() != 0)
+        memcpy(GetSection(pHeader, pHeader->IndexArray), hs->IndexArray.ItemAt(0), hs->IndexArray.ItemCount() * sizeof(CASC_EKEY_ENTRY));
+    if(hs->ArchiveIndexes.ItemCount() != 0)
+        memcpy(GetSection(pHeader, pHeader->ArchiveIndexes), hs->ArchiveIndexes.ItemAt(0), hs->ArchiveIndexes.ItemCount() * sizeof(CASC_ARCHIVE_INDEX));
+
+    // Maps
+    if(hs->CKeyMap.IsInitialized())
+        hs->CKeyMap.SaveIndexes((PDWORD)GetSection(pHeader, pHeader->CKeyMap), hs->CKeyArray.ItemAt(0), sizeof(CASC_CKEY_ENTRY));
+    if(hs->EKeyMap.IsInitialized())
+        hs->EKeyMap.SaveIndexes((PDWORD)GetSection(pHeader, pHeader->EKeyMap), hs->CKeyArray.ItemAt(0), sizeof(CASC_CKEY_ENTRY));
+    if(hs->IndexMap.IsInitialized())
+        hs->IndexMap.SaveIndexes((PDWORD)GetSection(pHeader, pHeader->IndexMap), hs->IndexArray.ItemAt(0), sizeof(CASC_EKEY_ENTRY));
+
+    // Tags. The pointers to the bitsets are not valid in other processes
+    for(size_t i = 0; i < hs->TagsArray.ItemCount(); i++, pbTagBitmap += pHeader->TagBitmaps.ItemSize)
+    {
+        PCASC_TAG_ENTRY2 pSrcTag = (PCASC_TAG_ENTRY2)hs->TagsArray.ItemAt(i);
+        PCASC_TAG_ENTRY2 pDstTag = (PCASC_TAG_ENTRY2)(GetSection(pHeader, pHeader->TagsArray) + i * hs->TagsArray.ItemSize());
+
+        memcpy(pDstTag, pSrcTag, hs->TagsArray.ItemSize());
+        pDstTag->pFileBits = NULL;
+        if(pSrcTag->pFileBits != NULL)
+            SaveBitset(pSrcTag->pFileBits[0], (ULONGLONG *)pbTagBitmap);
+    }
+    if(pHeader->TaggedFiles.ItemCount != 0)
+        SaveBitset(hs->TaggedFiles, (ULONGLONG *)GetSection(pHeader, pHeader->TaggedFiles));
+}
+
+//-----------------------------------------------------------------------------
+// Public functions
+
+// Maps the storage index from the shared memory segment. Fails if there is no such segment,
+// or if it was published for a different build or different index files.
+// Must be called after the build files are loaded and after QueryIndexFiles.
+DWORD AttachSharedIndex(TCascStorage * hs, LPCTSTR szName)
+{
+    PCASC_SHARED_INDEX_HEADER pHeader;
+    DWORD dwErrCode;
+
+    // Open the segment
+    if((dwErrCode = hs->SharedIndex.Open(szName)) != ERROR_SUCCESS)
+        return dwErrCode;
+    pHeader = (PCASC_SHARED_INDEX_HEADER)hs->SharedIndex.Data();
+
+    // Refuse incomplete or stale segments. They will be replaced by PublishSharedIndex
+    if(!IsValidHeader(hs, pHeader, hs->SharedIndex.Size()))
+    {
+        hs->SharedIndex.Close();
+        return ERROR_FILE_CORRUPT;
+    }
+
+    // Load the index from the segment
+    if((dwErrCode = LoadSharedIndex(hs, pHeader)) != ERROR_SUCCESS)
+        DetachSharedIndex(hs);
+    return dwErrCode;
+}
+
+// Publishes the loaded storage index for other processes. Must be called
+// after the DOWNLOAD manifest is loaded and before the ROOT file is loaded.
+DWORD PublishSharedIndex(TCascStorage * hs, LPCTSTR szName)
+{
+    CASC_SHARED_INDEX_HEADER Header;
+    DWORD dwErrCode;
+
+    // Don't publish a storage that is attached to another segment
+    if(hs->dwFeatures & CASC_FEATURE_SHARED_INDEX)
+        return ERROR_SUCCESS;
+
+    // Prepare the layout of the segment
+    CreateLayout(hs, &Header);
+
+    // Only one process creates or replaces the segment at a time.
+    // If another process is publishing it right now, we leave it to that process
+    if(!hs->SharedIndex.Lock(szName))
+        return ERROR_SUCCESS;
+
+    // If the segment exists, another process was faster, or the segment is stale. It can also be incomplete
+    // if its publisher failed; nobody else is writing it while we hold the lock. Except for the first case,
+    // we remove the segment. The processes that have it mapped keep using it.
+    if((dwErrCode = hs->SharedIndex.Create(szName, (size_t)Header.SegmentSize)) == ERROR_ALREADY_EXISTS)
+    {
+        if(hs->SharedIndex.Open(szName) == ERROR_SUCCESS)
+        {
+            bool bIsValid = IsValidHeader(hs, (PCASC_SHARED_INDEX_HEADER)hs->SharedIndex.Data(), hs->SharedIndex.Size());
+
+            hs->SharedIndex.Close();
+            if(bIsValid)
+            {
+                hs->SharedIndex.Unlock();
+                return ERROR_SUCCESS;
+            }
+        }
+
+        CASC_SHARED_MEMORY::Unlink(szName);
+        dwErrCode = hs->SharedIndex.Create(szName, (size_t)Header.SegmentSize);
+    }
+
+    // Write the data. The completion flag is set last, so other processes never see a partial segment as complete.
+    // The segment stays mapped while the storage is open; on Windows, this keeps the file mapping alive.
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        PCASC_SHARED_INDEX_HEADER pHeader = (PCASC_SHARED_INDEX_HEADER)hs->SharedIndex.Data();
+
+        memcpy(pHeader, &Header, sizeof(CASC_SHARED_INDEX_HEADER));
+        SaveSharedIndex(hs, pHeader);
+        CascInterlockedIncrement(&pHeader->bComplete);
+    }
+
+    hs->SharedIndex.Unlock();
+    return dwErrCode;
+}
@@ -0,0 +1,214 @@
+/*****************************************************************************/
+/* Arena.cpp                              Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Per-storage arena allocator                                               */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 19.10.26  1.00  Lad  The first version of Arena.cpp                       */
+/*****************************************************************************/
+
+#define __CASCLIB_SELF__
+#include "../CascLib.h"
+#include "../CascCommon.h"
+
+//-----------------------------------------------------------------------------
+// Local defines
+
+#define CASC_ARENA_HEADER_SIZE  ALIGN_TO_SIZE(sizeof(CASC_ARENA_BLOCK), CASC_ARENA_ALIGNMENT)
+
+//-----------------------------------------------------------------------------
+// CASC_ARENA functions
+
+CASC_ARENA::CASC_ARENA()
+{
+    CascInitLock(Lock);
+    memset(FreeLists, 0, sizeof(FreeLists));
+    pBlocks = NULL;
+    pbBlockPtr = pbBlockEnd = NULL;
+    BytesReserved = BytesUsed = BytesPeak = 0;
+    AllocCount = BlockCount = 0;
+}
+
+CASC_ARENA::~CASC_ARENA()
+{
+    Release();
+    CascFreeLock(Lock);
+}
+
+// Returns the index of the smallest size class that can hold cbSize bytes
+size_t CASC_ARENA::GetSizeClass(size_t cbSize)
+{
+    size_t nClass = 0;
+
+    while((size_t)(CASC_ARENA_MIN_CLASS << nClass) < cbSize)
+        nClass++;
+    return nClass;
+}
+
+void * CASC_ARENA::AllocFromBlock(size_t cbSize)
+{
+    CASC_ARENA_BLOCK * pBlock;
+    void * ptr;
+
+    // Is there enough space in the current block?
+    if((size_t)(pbBlockEnd - pbBlockPtr) < cbSize)
+    {
+        // Give the rest of the current block to the free lists, biggest classes first
+        for(size_t nClass = CASC_ARENA_CLASS_COUNT; nClass > 0; nClass--)
+        {
+            size_t cbClass = CASC_ARENA_MIN_CLASS << (nClass - 1);
+
+            while((size_t)(pbBlockEnd - pbBlockPtr) >= cbClass)
+            {
+                *(void **)pbBlockPtr = FreeLists[nClass - 1];
+                FreeLists[nClass - 1] = pbBlockPtr;
+                pbBlockPtr += cbClass;
+            }
+        }
+
+        // Allocate new block and make it current
+        if((pBlock = (CASC_ARENA_BLOCK *)CASC_ALLOC<BYTE>(CASC_ARENA_BLOCK_SIZE)) == NULL)
+            return NULL;
+        pBlock->pNext = pBlocks;
+        pBlock->cbBlock = CASC_ARENA_BLOCK_SIZE;
+        pBlocks = pBlock;
+
+        pbBlockPtr = (LPBYTE)pBlock + CASC_ARENA_HEADER_SIZE;
+        pbBlockEnd = (LPBYTE)pBlock + CASC_ARENA_BLOCK_SIZE;
+        BytesReserved += CASC_ARENA_BLOCK_SIZE;
+        BlockCount++;
+    }
+
+    ptr = pbBlockPtr;
+    pbBlockPtr += cbSize;
+    return ptr;
+}
+
+void * CASC_ARENA::Alloc(size_t cbSize)
+{
+    CASC_ARENA_BLOCK * pBlock;
+    void * ptr = NULL;
+
+    CascLock(Lock);
+
+    // Large allocation: gets its own block, which is placed behind the current one
+    if(cbSize > CASC_ARENA_MAX_CLASS)
+    {
+        size_t cbBlock = CASC_ARENA_HEADER_SIZE + ALIGN_TO_SIZE(cbSize, CASC_ARENA_ALIGNMENT);
+
+        if((pBlock = (CASC_ARENA_BLOCK *)CASC_ALLOC<BYTE>(cbBlock)) != NULL)
+        {
+            if(pBlocks != NULL)
+            {
+                pBlock->pNext = pBlocks->pNext;
+                pBlocks->pNext = pBlock;
+            }
+            else
+            {
+                pBlock->pNext = NULL;
+                pBlocks = pBlock;
+            }
+
+            pBlock->cbBlock = cbBlock;
+            BytesReserved += cbBlock;
+            BlockCount++;
+            ptr = (LPBYTE)pBlock + CASC_ARENA_HEADER_SIZE;
+        }
+    }
+
+    // Small allocation: reuse a freed item of the same class or take new space from the block
+    else
+    {
+        size_t nClass = GetSizeClass(cbSize);
+
+        cbSize = CASC_ARENA_MIN_CLASS << nClass;
+        if((ptr = FreeLists[nClass]) != NULL)
+            FreeLists[nClass] = *(void **)ptr;
+        else
+            ptr = AllocFromBlock(cbSize);
+    }
+
+    // Update the statistics
+    if(ptr != NULL)
+    {
+        BytesUsed += cbSize;
+        BytesPeak = CASCLIB_MAX(BytesPeak, BytesUsed);
+        AllocCount++;
+    }
+
+    CascUnlock(Lock);
+    return ptr;
+}
+
+void * CASC_ARENA::Realloc(void * ptr, size_t cbOldSize, size_t cbNewSize)
+{
+    void * pNewPtr;
+
+    // Still the same size class?
+    if(ptr != NULL && cbOldSize <= CASC_ARENA_MAX_CLASS && cbNewSize <= CASC_ARENA_MAX_CLASS)
+    {
+        if(GetSizeClass(cbOldSize) == GetSizeClass(cbNewSize))
+            return ptr;
+    }
+
+    // Move the data to the new location
+    if((pNewPtr = Alloc(cbNewSize)) != NULL && ptr != NULL)
+    {
+        memcpy(pNewPtr, ptr, CASCLIB_MIN(cbOldSize, cbNewSize));
+        Free(ptr, cbOldSize);
+    }
+    return pNewPtr;
+}
+
+void CASC_ARENA::Free(void * ptr, size_t cbSize)
+{
+    if(ptr != NULL)
+    {
+        CascLock(Lock);
+
+        // The space of large allocations is only returned on Release()
+        if(cbSize > CASC_ARENA_MAX_CLASS)
+        {
+            BytesUsed -= cbSize;
+        }
+        else
+        {
+            size_t nClass = GetSizeClass(cbSize);
+
+            *(void **)ptr = FreeLists[nClass];
+            FreeLists[nClass] = ptr;
+            BytesUsed -= (CASC_ARENA_MIN_CLASS << nClass);
+        }
+
+        CascUnlock(Lock);
+    }
+}
+
+void CASC_ARENA::Collect(PCASC_STORAGE_MEMORY pMemory)
+{
+    CascLock(Lock);
+    pMemory->ArenaReserved = BytesReserved;
+    pMemory->ArenaUsed = BytesUsed;
+    pMemory->ArenaPeak = BytesPeak;
+    pMemory->ArenaAllocations = AllocCount;
+    pMemory->ArenaBlocks = BlockCount;
+    CascUnlock(Lock);
+}
+
+void CASC_ARENA::Release()
+{
+    CASC_ARENA_BLOCK * pBlock;
+
+    CascLock(Lock);
+    while((pBlock = pBlocks) != NULL)
+    {
+        pBlocks = pBlock->pNext;
+        CASC_FREE(pBlock);
+    }
+
+    memset(FreeLists, 0, sizeof(FreeLists));
+    pbBlockPtr = pbBlockEnd = NULL;
+    BytesReserved = BytesUsed = 0;
+    CascUnlock(Lock);
+}
@@ -0,0 +1,80 @@
+/*****************************************************************************/
+/* Arena.h                                Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Per-storage arena allocator                                               */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 19.10.26  1.00  Lad  The first version of Arena.h                         */
+/*****************************************************************************/
+
+#ifndef __CASC_ARENA_H__
+#define __CASC_ARENA_H__
+
+//-----------------------------------------------------------------------------
+// Defines
+
+#define CASC_ARENA_BLOCK_SIZE   0x10000             // Size of one block allocated from the system
+#define CASC_ARENA_ALIGNMENT    0x10                // All allocations are aligned to this
+#define CASC_ARENA_MIN_CLASS    0x10                // Smallest size class
+#define CASC_ARENA_MAX_CLASS    0x2000              // Largest size class. Larger allocations get their own block
+#define CASC_ARENA_CLASS_COUNT  10                  // Number of size classes (0x10, 0x20, ..., 0x2000)
+
+//-----------------------------------------------------------------------------
+// Structures
+
+// Header of a block allocated from the system
+struct CASC_ARENA_BLOCK
+{
+    CASC_ARENA_BLOCK * pNext;                       // The previously allocated block
+    size_t cbBlock;                                 // Size of the block, including this header
+};
+
+//-----------------------------------------------------------------------------
+// Arena allocator for the small structures that live as long as the storage.
+// Allocations are rounded up to a power-of-two size class. Freed items go
+// to a free list of their class, so they can be reused by the next allocation.
+// The memory itself is returned to the system only by Release().
+
+class CASC_ARENA
+{
+    public:
+
+    CASC_ARENA();
+    ~CASC_ARENA();
+
+    // The caller must pass the same size to Free and Realloc that was given to Alloc
+    void * Alloc(size_t cbSize);
+    void * Realloc(void * ptr, size_t cbOldSize, size_t cbNewSize);
+    void Free(void * ptr, size_t cbSize);
+
+    template <typename T>
+    T * Alloc(size_t nCount)
+    {
+        return (T *)Alloc(nCount * sizeof(T));
+    }
+
+    // Retrieves the memory statistics
+    void Collect(PCASC_STORAGE_MEMORY pMemory);
+
+    // Frees all blocks
+    void Release();
+
+    protected:
+
+    static size_t GetSizeClass(size_t cbSize);
+    void * AllocFromBlock(size_t cbSize);
+
+    CASC_LOCK Lock;                                 // The arena is shared by all threads using the storage
+    CASC_ARENA_BLOCK * pBlocks;                     // List of all blocks, the current one is the first
+    LPBYTE pbBlockPtr;                              // Free space in the current block
+    LPBYTE pbBlockEnd;                              // End of the current block
+    void * FreeLists[CASC_ARENA_CLASS_COUNT];       // Freed items of each size class
+    ULONGLONG BytesReserved;                        // Total size of the blocks
+    ULONGLONG BytesUsed;                            // Bytes given to the callers and not freed yet
+    ULONGLONG BytesPeak;                            // Peak value of BytesUsed
+    ULONGLONG AllocCount;                           // Number of allocations
+    ULONGLONG BlockCount;                           // Number of blocks
+};
+
+#endif // __CASC_ARENA_H__
@@ -25,6 +25,7 @@ class CASC_ARRAY
         m_ItemCountMax = 0;
         m_ItemCount = 0;
         m_ItemSize = 0;
+        m_bAttached = false;
     }
 
     ~CASC_ARRAY()
@@ -49,9 +50,22 @@ class CASC_ARRAY
         m_ItemCountMax = ItemCountMax;
         m_ItemCount = 0;
         m_ItemSize = ItemSize;
+        m_bAttached = false;
         return ERROR_SUCCESS;
     }
 
+    // Uses an existing block of memory as the item array. The array doesn't free
+    // the memory and can't be enlarged beyond ItemCountMax.
+    void Attach(void * pvItemArray, size_t ItemSize, size_t ItemCount, size_t ItemCountMax)
+    {
+        Free();
+        m_pItemArray = (LPBYTE)pvItemArray;
+        m_ItemCountMax = ItemCountMax;
+        m_ItemCount = ItemCount;
+        m_ItemSize = ItemSize;
+        m_bAttached = true;
+    }
+
     // Inserts one or more items; returns pointer to the first inserted item
     void * Insert(size_t NewItemCount, bool bEnlargeAllowed = true)
     {
@@ -163,7 +177,10 @@ class CASC_ARRAY
     // Frees the array
     void Free()
     {
-        CASC_FREE(m_pItemArray);
+        if(m_bAttached == false)
+            CASC_FREE(m_pItemArray);
+        m_pItemArray = NULL;
+        m_bAttached = false;
         m_ItemCountMax = m_ItemCount = m_ItemSize = 0;
     }
 
@@ -181,8 +198,8 @@ class CASC_ARRAY
         // Shall we enlarge the table?
         if (NewItemCount > m_ItemCountMax)
         {
-            // Deny enlarge if not allowed
-            if(bEnlargeAllowed == false)
+            // Deny enlarge if not allowed. Attached memory can't be reallocated
+            if(bEnlargeAllowed == false || m_bAttached)
                 return false;
 
             // Calculate new table size
@@ -207,6 +224,7 @@ class CASC_ARRAY
     size_t m_ItemCountMax;                      // Maximum item count
     size_t m_ItemCount;                         // Current item count
     size_t m_ItemSize;                          // Size of an item
+    bool m_bAttached;                           // If true, the item array is not owned by the array
 };
 
 #endif // __CASC_ARRAY__
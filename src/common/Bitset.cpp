@@ -0,0 +1,426 @@
+/*****************************************************************************/
+/* Bitset.cpp                             Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Compressed bitset of 32-bit values                                        */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 19.10.26  1.00  Lad  The first version of Bitset.cpp                      */
+/*****************************************************************************/
+
+#define __CASCLIB_SELF__
+#include "../CascLib.h"
+#include "../CascCommon.h"
+
+//-----------------------------------------------------------------------------
+// Local defines
+
+#define BITSET_OP_AND       0
+#define BITSET_OP_OR        1
+#define BITSET_OP_AND_NOT   2
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+static DWORD PopCount64(ULONGLONG Value64)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return (DWORD)__builtin_popcountll(Value64);
+#else
+    Value64 = Value64 - ((Value64 >> 1) & 0x5555555555555555ULL);
+    Value64 = (Value64 & 0x3333333333333333ULL) + ((Value64 >> 2) & 0x3333333333333333ULL);
+    Value64 = (Value64 + (Value64 >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (DWORD)((Value64 * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+static DWORD CountTrailingZeros64(ULONGLONG Value64)
+{
+    return PopCount64((Value64 & (0 - Value64)) - 1);
+}
+
+static void ExpandChunk(const CASC_BITSET_CHUNK & Chunk, ULONGLONG * pBitmap)
+{
+    if(Chunk.pBitmap != NULL)
+    {
+        memcpy(pBitmap, Chunk.pBitmap, CASC_BITSET_CHUNK_WORDS * sizeof(ULONGLONG));
+    }
+    else
+    {
+        memset(pBitmap, 0, CASC_BITSET_CHUNK_WORDS * sizeof(ULONGLONG));
+        for(DWORD i = 0; i < Chunk.ValueCount; i++)
+            pBitmap[Chunk.pValues[i] >> 6] |= (ULONGLONG)1 << (Chunk.pValues[i] & 0x3F);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// CASC_BITSET functions
+
+CASC_BITSET::CASC_BITSET(CASC_ARENA * pNewArena)
+{
+    pArena = pNewArena;
+    pChunks = NULL;
+    ChunkCountMax = 0;
+    ChunkCount = 0;
+}
+
+CASC_BITSET::~CASC_BITSET()
+{
+    Free();
+}
+
+void * CASC_BITSET::AllocMemory(size_t cbSize)
+{
+    return (pArena != NULL) ? pArena->Alloc(cbSize) : CASC_ALLOC<BYTE>(cbSize);
+}
+
+void CASC_BITSET::FreeMemory(void * ptr, size_t cbSize)
+{
+    if(pArena != NULL)
+    {
+        pArena->Free(ptr, cbSize);
+    }
+    else
+    {
+        CASC_FREE(ptr);
+    }
+}
+
+void CASC_BITSET::FreeChunks(CASC_BITSET_CHUNK * pFreeChunks, size_t nCount, size_t nCountMax)
+{
+    for(size_t i = 0; i < nCount; i++)
+    {
+        if(pFreeChunks[i].pValues != NULL)
+            FreeMemory(pFreeChunks[i].pValues, pFreeChunks[i].ValueCount * sizeof(USHORT));
+        if(pFreeChunks[i].pBitmap != NULL)
+            FreeMemory(pFreeChunks[i].pBitmap, CASC_BITSET_CHUNK_WORDS * sizeof(ULONGLONG));
+    }
+
+    if(pFreeChunks != NULL)
+        FreeMemory(pFreeChunks, nCountMax * sizeof(CASC_BITSET_CHUNK));
+}
+
+// Compresses one chunk, given as a bitmap, and appends it to the chunk array
+DWORD CASC_BITSET::AppendChunk(CASC_BITSET_CHUNK *& pNewChunks, size_t & nNewCount, size_t & nNewCountMax, DWORD ChunkIndex, const ULONGLONG * pBitmap)
+{
+    CASC_BITSET_CHUNK * pChunk;
+    DWORD ValueCount = 0;
+
+    // Empty chunks are not stored at all
+    for(size_t i = 0; i < CASC_BITSET_CHUNK_WORDS; i++)
+        ValueCount += PopCount64(pBitmap[i]);
+    if(ValueCount == 0)
+        return ERROR_SUCCESS;
+
+    // Enlarge the chunk array, if needed
+    if(nNewCount >= nNewCountMax)
+    {
+        size_t nCountMax = (nNewCountMax != 0) ? (nNewCountMax * 2) : 0x10;
+
+        if((pChunk = (CASC_BITSET_CHUNK *)AllocMemory(nCountMax * sizeof(CASC_BITSET_CHUNK))) == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+        if(pNewChunks != NULL)
+        {
+            memcpy(pChunk, pNewChunks, nNewCount * sizeof(CASC_BITSET_CHUNK));
+            FreeMemory(pNewChunks, nNewCountMax * sizeof(CASC_BITSET_CHUNK));
+        }
+        pNewChunks = pChunk;
+        nNewCountMax = nCountMax;
+    }
+
+    // Initialize the new chunk
+    pChunk = &pNewChunks[nNewCount++];
+    pChunk->ChunkIndex = ChunkIndex;
+    pChunk->ValueCount = ValueCount;
+    pChunk->pValues = NULL;
+    pChunk->pBitmap = NULL;
+
+    // Sparse chunk: extract the values to a sorted array
+    if(ValueCount <= CASC_BITSET_ARRAY_MAX)
+    {
+        USHORT * pValues;
+
+        if((pChunk->pValues = pValues = (USHORT *)AllocMemory(ValueCount * sizeof(USHORT))) == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+
+        for(size_t i = 0; i < CASC_BITSET_CHUNK_WORDS; i++)
+        {
+            for(ULONGLONG Word = pBitmap[i]; Word != 0; Word &= (Word - 1))
+            {
+                *pValues++ = (USHORT)((i << 6) + CountTrailingZeros64(Word));
+            }
+        }
+    }
+
+    // Dense chunk: keep the bitmap
+    else
+    {
+        if((pChunk->pBitmap = (ULONGLONG *)AllocMemory(CASC_BITSET_CHUNK_WORDS * sizeof(ULONGLONG))) == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+        memcpy(pChunk->pBitmap, pBitmap, CASC_BITSET_CHUNK_WORDS * sizeof(ULONGLONG));
+    }
+
+    return ERROR_SUCCESS;
+}
+
+DWORD CASC_BITSET::Create(const ULONGLONG * pBitmap, size_t nBitCount)
+{
+    CASC_BITSET_CHUNK * pNewChunks = NULL;
+    ULONGLONG * pChunkBits;
+    size_t nWordCount = (nBitCount + 63) / 64;
+    size_t nNewCountMax = 0;
+    size_t nNewCount = 0;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // The bitset covers 32-bit values only
+    if((ULONGLONG)nBitCount > 0x100000000ULL)
+        return ERROR_INVALID_PARAMETER;
+    Free();
+
+    // Allocate buffer for one chunk. Temporary buffers are always on the heap
+    if((pChunkBits = CASC_ALLOC<ULONGLONG>(CASC_BITSET_CHUNK_WORDS)) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    // Compress the bitmap, one chunk at a time
+    for(size_t nWordIndex = 0; nWordIndex < nWordCount; nWordIndex += CASC_BITSET_CHUNK_WORDS)
+    {
+        size_t nChunkWords = CASCLIB_MIN(nWordCount - nWordIndex, CASC_BITSET_CHUNK_WORDS);
+
+        // Copy the chunk bits. Clear the bits that are beyond the end of the bitmap
+        memset(pChunkBits, 0, CASC_BITSET_CHUNK_WORDS * sizeof(ULONGLONG));
+        memcpy(pChunkBits, pBitmap + nWordIndex, nChunkWords * sizeof(ULONGLONG));
+        if((nWordIndex + nChunkWords) == nWordCount && (nBitCount & 0x3F) != 0)
+            pChunkBits[nChunkWords - 1] &= ((ULONGLONG)1 << (nBitCount & 0x3F)) - 1;
+
+        // Append the chunk
+        dwErrCode = AppendChunk(pNewChunks, nNewCount, nNewCountMax, (DWORD)(nWordIndex / CASC_BITSET_CHUNK_WORDS), pChunkBits);
+        if(dwErrCode != ERROR_SUCCESS)
+            break;
+    }
+
+    // Give the chunks to the bitset
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        pChunks = pNewChunks;
+        ChunkCountMax = nNewCountMax;
+        ChunkCount = nNewCount;
+    }
+    else
+    {
+        FreeChunks(pNewChunks, nNewCount, nNewCountMax);
+    }
+
+    CASC_FREE(pChunkBits);
+    return dwErrCode;
+}
+
+// Performs a boolean operation between this bitset and the source bitset
+DWORD CASC_BITSET::Combine(const CASC_BITSET & Source, int nOperation)
+{
+    CASC_BITSET_CHUNK * pNewChunks = NULL;
+    ULONGLONG * pBitmap1;
+    ULONGLONG * pBitmap2;
+    size_t nNewCountMax = 0;
+    size_t nNewCount = 0;
+    size_t i = 0, j = 0;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    // Allocate buffer for two expanded chunks
+    if((pBitmap1 = CASC_ALLOC<ULONGLONG>(CASC_BITSET_CHUNK_WORDS * 2)) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    pBitmap2 = pBitmap1 + CASC_BITSET_CHUNK_WORDS;
+
+    // Merge both sorted chunk arrays
+    while(dwErrCode == ERROR_SUCCESS && (i < ChunkCount || j < Source.ChunkCount))
+    {
+        const CASC_BITSET_CHUNK * pChunk1 = (i < ChunkCount) ? &pChunks[i] : NULL;
+        const CASC_BITSET_CHUNK * pChunk2 = (j < Source.ChunkCount) ? &Source.pChunks[j] : NULL;
+
+        // The chunk is only present in this bitset
+        if(pChunk2 == NULL || (pChunk1 != NULL && pChunk1->ChunkIndex < pChunk2->ChunkIndex))
+        {
+            if(nOperation != BITSET_OP_AND)
+            {
+                ExpandChunk(*pChunk1, pBitmap1);
+                dwErrCode = AppendChunk(pNewChunks, nNewCount, nNewCountMax, pChunk1->ChunkIndex, pBitmap1);
+            }
+            i++;
+            continue;
+        }
+
+        // The chunk is only present in the source bitset
+        if(pChunk1 == NULL || pChunk2->ChunkIndex < pChunk1->ChunkIndex)
+        {
+            if(nOperation == BITSET_OP_OR)
+            {
+                ExpandChunk(*pChunk2, pBitmap2);
+                dwErrCode = AppendChunk(pNewChunks, nNewCount, nNewCountMax, pChunk2->ChunkIndex, pBitmap2);
+            }
+            j++;
+            continue;
+        }
+
+        // The chunk is present in both. Combine the expanded bitmaps word by word
+        ExpandChunk(*pChunk1, pBitmap1);
+        ExpandChunk(*pChunk2, pBitmap2);
+        switch(nOperation)
+        {
+            case BITSET_OP_AND:
+                for(size_t n = 0; n < CASC_BITSET_CHUNK_WORDS; n++)
+                    pBitmap1[n] &= pBitmap2[n];
+                break;
+
+            case BITSET_OP_OR:
+                for(size_t n = 0; n < CASC_BITSET_CHUNK_WORDS; n++)
+                    pBitmap1[n] |= pBitmap2[n];
+                break;
+
+            case BITSET_OP_AND_NOT:
+                for(size_t n = 0; n < CASC_BITSET_CHUNK_WORDS; n++)
+                    pBitmap1[n] &= ~pBitmap2[n];
+                break;
+        }
+
+        dwErrCode = AppendChunk(pNewChunks, nNewCount, nNewCountMax, pChunk1->ChunkIndex, pBitmap1);
+        i++;
+        j++;
+    }
+
+    // Replace the chunks of this bitset with the result
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        Free();
+        pChunks = pNewChunks;
+        ChunkCountMax = nNewCountMax;
+        ChunkCount = nNewCount;
+    }
+    else
+    {
+        FreeChunks(pNewChunks, nNewCount, nNewCountMax);
+    }
+
+    CASC_FREE(pBitmap1);
+    return dwErrCode;
+}
+
+DWORD CASC_BITSET::CopyFrom(const CASC_BITSET & Source)
+{
+    Free();
+    return Combine(Source, BITSET_OP_OR);
+}
+
+DWORD CASC_BITSET::And(const CASC_BITSET & Source)
+{
+    return Combine(Source, BITSET_OP_AND);
+}
+
+DWORD CASC_BITSET::Or(const CASC_BITSET & Source)
+{
+    return Combine(Source, BITSET_OP_OR);
+}
+
+DWORD CASC_BITSET::AndNot(const CASC_BITSET & Source)
+{
+    return Combine(Source, BITSET_OP_AND_NOT);
+}
+
+bool CASC_BITSET::Contains(DWORD dwValue) const
+{
+    DWORD ChunkIndex = dwValue >> CASC_BITSET_CHUNK_SHIFT;
+    USHORT LowValue = (USHORT)(dwValue & (CASC_BITSET_CHUNK_VALUES - 1));
+    size_t nLeft = 0;
+    size_t nRight = ChunkCount;
+
+    // Binary search for the chunk
+    while(nLeft < nRight)
+    {
+        size_t nMiddle = (nLeft + nRight) / 2;
+
+        if(pChunks[nMiddle].ChunkIndex < ChunkIndex)
+            nLeft = nMiddle + 1;
+        else
+            nRight = nMiddle;
+    }
+
+    if(nLeft < ChunkCount && pChunks[nLeft].ChunkIndex == ChunkIndex)
+    {
+        const CASC_BITSET_CHUNK & Chunk = pChunks[nLeft];
+
+        // Dense chunk: test the bit
+        if(Chunk.pBitmap != NULL)
+            return (Chunk.pBitmap[LowValue >> 6] & ((ULONGLONG)1 << (LowValue & 0x3F))) ? true : false;
+
+        // Sparse chunk: binary search for the value
+        nLeft = 0;
+        nRight = Chunk.ValueCount;
+        while(nLeft < nRight)
+        {
+            size_t nMiddle = (nLeft + nRight) / 2;
+
+            if(Chunk.pValues[nMiddle] < LowValue)
+                nLeft = nMiddle + 1;
+            else
+                nRight = nMiddle;
+        }
+        return (nLeft < Chunk.ValueCount && Chunk.pValues[nLeft] == LowValue);
+    }
+
+    return false;
+}
+
+size_t CASC_BITSET::Cardinality() const
+{
+    size_t nCardinality = 0;
+
+    for(size_t i = 0; i < ChunkCount; i++)
+        nCardinality += pChunks[i].ValueCount;
+    return nCardinality;
+}
+
+bool CASC_BITSET::Next(CASC_BITSET_ITERATOR & Iterator, DWORD & dwValue) const
+{
+    while(Iterator.ChunkIndex < ChunkCount)
+    {
+        const CASC_BITSET_CHUNK & Chunk = pChunks[Iterator.ChunkIndex];
+        DWORD HighValue = Chunk.ChunkIndex << CASC_BITSET_CHUNK_SHIFT;
+
+        // Sparse chunk: return the next value from the array
+        if(Chunk.pValues != NULL)
+        {
+            if(Iterator.ItemIndex < Chunk.ValueCount)
+            {
+                dwValue = HighValue | Chunk.pValues[Iterator.ItemIndex++];
+                return true;
+            }
+        }
+
+        // Dense chunk: return the lowest remaining bit of the current word
+        else
+        {
+            while(Iterator.Word == 0 && Iterator.ItemIndex < CASC_BITSET_CHUNK_WORDS)
+                Iterator.Word = Chunk.pBitmap[Iterator.ItemIndex++];
+
+            if(Iterator.Word != 0)
+            {
+                dwValue = HighValue | (DWORD)(((Iterator.ItemIndex - 1) << 6) + CountTrailingZeros64(Iterator.Word));
+                Iterator.Word &= (Iterator.Word - 1);
+                return true;
+            }
+        }
+
+        // Move to the next chunk
+        Iterator.ChunkIndex++;
+        Iterator.ItemIndex = 0;
+        Iterator.Word = 0;
+    }
+
+    return false;
+}
+
+void CASC_BITSET::Free()
+{
+    FreeChunks(pChunks, ChunkCount, ChunkCountMax);
+    pChunks = NULL;
+    ChunkCountMax = 0;
+    ChunkCount = 0;
+}
@@ -0,0 +1,91 @@
+/*****************************************************************************/
+/* Bitset.h                               Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Compressed bitset of 32-bit values                                        */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 19.10.26  1.00  Lad  The first version of Bitset.h                        */
+/*****************************************************************************/
+
+#ifndef __CASC_BITSET_H__
+#define __CASC_BITSET_H__
+
+//-----------------------------------------------------------------------------
+// Defines
+
+#define CASC_BITSET_CHUNK_SHIFT     16                      // The upper 16 bits of a value select the chunk
+#define CASC_BITSET_CHUNK_VALUES    0x10000                 // Number of values covered by one chunk
+#define CASC_BITSET_CHUNK_WORDS     (CASC_BITSET_CHUNK_VALUES / 64)
+#define CASC_BITSET_ARRAY_MAX       4096                    // Chunks with more values are stored as bitmaps
+
+//-----------------------------------------------------------------------------
+// Structures
+
+// A chunk covers 65536 consecutive values. Sparse chunks keep a sorted array
+// of the lower 16 bits of the values, dense chunks keep a plain bitmap.
+// This is the same layout as the one used by Roaring bitmaps.
+struct CASC_BITSET_CHUNK
+{
+    DWORD ChunkIndex;                               // Upper 16 bits of all values in the chunk
+    DWORD ValueCount;                               // Number of values in the chunk
+    USHORT * pValues;                               // Sorted lower 16 bits (if ValueCount <= CASC_BITSET_ARRAY_MAX)
+    ULONGLONG * pBitmap;                            // Bitmap of CASC_BITSET_CHUNK_WORDS words (otherwise)
+};
+
+// Position of an iteration over the bitset
+struct CASC_BITSET_ITERATOR
+{
+    size_t ChunkIndex;                              // Index of the current chunk
+    size_t ItemIndex;                               // Index of the value (arrays) or the word (bitmaps) in the chunk
+    ULONGLONG Word;                                 // Bits of the current bitmap word that haven't been returned yet
+};
+
+//-----------------------------------------------------------------------------
+// Compressed bitset. The boolean operations work on whole chunks;
+// the dense chunks are combined 64 bits at a time, which the compiler vectorizes.
+// The bitset is not thread-safe for writing. If an arena is given, the chunks
+// are allocated from it; otherwise they are allocated from the heap.
+
+class CASC_BITSET
+{
+    public:
+
+    CASC_BITSET(CASC_ARENA * pNewArena = NULL);
+    ~CASC_BITSET();
+
+    // Compresses a plain bitmap of nBitCount bits. Bit N is in pBitmap[N / 64] & (1 << (N % 64))
+    DWORD Create(const ULONGLONG * pBitmap, size_t nBitCount);
+
+    // Boolean operations. The result is stored in this bitset
+    DWORD CopyFrom(const CASC_BITSET & Source);
+    DWORD And(const CASC_BITSET & Source);
+    DWORD Or(const CASC_BITSET & Source);
+    DWORD AndNot(const CASC_BITSET & Source);
+
+    // Returns true if the bitset contains the value
+    bool Contains(DWORD dwValue) const;
+
+    // Returns the number of values in the bitset
+    size_t Cardinality() const;
+
+    // Enumerates the values in ascending order. The iterator must be zeroed before the first call
+    bool Next(CASC_BITSET_ITERATOR & Iterator, DWORD & dwValue) const;
+
+    void Free();
+
+    protected:
+
+    DWORD Combine(const CASC_BITSET & Source, int nOperation);
+    DWORD AppendChunk(CASC_BITSET_CHUNK *& pNewChunks, size_t & nNewCount, size_t & nNewCountMax, DWORD ChunkIndex, const ULONGLONG * pBitmap);
+    void FreeChunks(CASC_BITSET_CHUNK * pFreeChunks, size_t nCount, size_t nCountMax);
+    void * AllocMemory(size_t cbSize);
+    void FreeMemory(void * ptr, size_t cbSize);
+
+    CASC_ARENA * pArena;                            // Arena for the chunks. NULL = heap
+    CASC_BITSET_CHUNK * pChunks;                    // Sorted array of non-empty chunks
+    size_t ChunkCountMax;                           // Capacity of the chunk array
+    size_t ChunkCount;                              // Number of chunks
+};
+
+#endif // __CASC_BITSET_H__
@@ -12,6 +12,12 @@
 #include "../CascLib.h"
 #include "../CascCommon.h"
 
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#endif
+
 //-----------------------------------------------------------------------------
 // Conversion to uppercase/lowercase
 
@@ -489,7 +495,7 @@ size_t NormalizeFileName(const unsigned char * NormTable, char * szNormName, con
 
     // Normalize the file name: ToLower + BackSlashToSlash
     for(i = 0; szFileName[0] != 0 && szNormName < szNormNameEnd; i++)
-        *szNormName++ = NormTable[*szFileName++];
+        *szNormName++ = NormTable[(BYTE)(*szFileName++)];
 
     // Terminate the string
     szNormName[0] = 0;
@@ -528,6 +534,118 @@ ULONGLONG CalcFileNameHash(const char * szFileName)
     return CalcNormNameHash(szNormName, nLength);
 }
 
+// Calculates the same hashes as CalcFileNameHash for a group of names at once.
+// The names are hashed in CASC_HASH_LANES lanes that run through the Jenkins
+// "mix" rounds in lock step. The lane loops are free of branches,
+// so the compiler turns them into vector instructions.
+#define CASC_HASH_LANES     8
+#define CASC_HASH_BLOCKS    ((MAX_PATH + 11) / 12)
+#define HASH_ROT(x, k)      (((x) << (k)) | ((x) >> (32 - (k))))
+
+static void CalcFileNameHashes_Lanes(const char ** FileNames, ULONGLONG * Hashes, size_t nCount)
+{
+    uint32_t Words[CASC_HASH_BLOCKS + 1][3][CASC_HASH_LANES];
+    uint32_t a[CASC_HASH_LANES], b[CASC_HASH_LANES], c[CASC_HASH_LANES];
+    uint32_t Blocks[CASC_HASH_LANES];
+    uint32_t Lengths[CASC_HASH_LANES];
+    uint32_t MaxBlocks = 0;
+    size_t nLane;
+
+    // Normalize the names straight into little-endian words, transposed by lane.
+    // Only the blocks used by the lane are written; the last one is zero-padded
+    for(nLane = 0; nLane < CASC_HASH_LANES; nLane++)
+    {
+        const BYTE * pbFileName = (const BYTE *)((nLane < nCount) ? FileNames[nLane] : "");
+        const BYTE * NormTable = AsciiToUpperTable_BkSlash;
+        uint32_t OneWord = 0;
+        size_t nLength = CASCLIB_MIN(strlen((const char *)pbFileName), MAX_PATH);
+        size_t nWord;
+
+        // Whole words first, then the rest of the name
+        for(nWord = 0; nWord < (nLength / 4); nWord++, pbFileName += 4)
+        {
+            Words[nWord / 3][nWord % 3][nLane] = ((uint32_t)NormTable[pbFileName[0]] << 0x00) |
+                                                 ((uint32_t)NormTable[pbFileName[1]] << 0x08) |
+                                                 ((uint32_t)NormTable[pbFileName[2]] << 0x10) |
+                                                 ((uint32_t)NormTable[pbFileName[3]] << 0x18);
+        }
+        for(size_t i = 0; i < (nLength & 3); i++)
+            OneWord |= (uint32_t)NormTable[pbFileName[i]] << (i * 8);
+
+        // All blocks except the last one go through "mix"; the last one through "final"
+        Lengths[nLane] = (uint32_t)nLength;
+        Blocks[nLane] = (nLength != 0) ? (uint32_t)((nLength - 1) / 12) : 0;
+        MaxBlocks = CASCLIB_MAX(MaxBlocks, Blocks[nLane]);
+        a[nLane] = b[nLane] = c[nLane] = 0xdeadbeef + (uint32_t)nLength;
+
+        // Store the incomplete word and pad the last block with zeros
+        for(; nWord < (Blocks[nLane] + 1) * 3; nWord++)
+        {
+            Words[nWord / 3][nWord % 3][nLane] = OneWord;
+            OneWord = 0;
+        }
+    }
+
+    // The lanes with fewer blocks also go through the blocks of the longest lane, with their result masked
+    for(nLane = 0; nLane < CASC_HASH_LANES; nLane++)
+    {
+        for(uint32_t nBlock = Blocks[nLane] + 1; nBlock < MaxBlocks; nBlock++)
+            Words[nBlock][0][nLane] = Words[nBlock][1][nLane] = Words[nBlock][2][nLane] = 0;
+    }
+
+    // Mix the full blocks. Lanes that have run out of blocks keep their state
+    for(uint32_t nBlock = 0; nBlock < MaxBlocks; nBlock++)
+    {
+        for(nLane = 0; nLane < CASC_HASH_LANES; nLane++)
+        {
+            uint32_t Mask = 0 - (uint32_t)(nBlock < Blocks[nLane]);
+            uint32_t x = a[nLane] + Words[nBlock][0][nLane];
+            uint32_t y = b[nLane] + Words[nBlock][1][nLane];
+            uint32_t z = c[nLane] + Words[nBlock][2][nLane];
+
+            x -= z;  x ^= HASH_ROT(z, 4);  z += y;
+            y -= x;  y ^= HASH_ROT(x, 6);  x += z;
+            z -= y;  z ^= HASH_ROT(y, 8);  y += x;
+            x -= z;  x ^= HASH_ROT(z,16);  z += y;
+            y -= x;  y ^= HASH_ROT(x,19);  x += z;
+            z -= y;  z ^= HASH_ROT(y, 4);  y += x;
+
+            a[nLane] = (x & Mask) | (a[nLane] & ~Mask);
+            b[nLane] = (y & Mask) | (b[nLane] & ~Mask);
+            c[nLane] = (z & Mask) | (c[nLane] & ~Mask);
+        }
+    }
+
+    // Add the last (zero-padded) block and do the final mixing. Empty names skip this
+    for(nLane = 0; nLane < CASC_HASH_LANES && nLane < nCount; nLane++)
+    {
+        uint32_t x = a[nLane] + Words[Blocks[nLane]][0][nLane];
+        uint32_t y = b[nLane] + Words[Blocks[nLane]][1][nLane];
+        uint32_t z = c[nLane] + Words[Blocks[nLane]][2][nLane];
+
+        if(Lengths[nLane] != 0)
+        {
+            z ^= y; z -= HASH_ROT(y,14);
+            x ^= z; x -= HASH_ROT(z,11);
+            y ^= x; y -= HASH_ROT(x,25);
+            z ^= y; z -= HASH_ROT(y,16);
+            x ^= z; x -= HASH_ROT(z,4);
+            y ^= x; y -= HASH_ROT(x,14);
+            z ^= y; z -= HASH_ROT(y,24);
+        }
+
+        Hashes[nLane] = ((ULONGLONG)z << 0x20) | y;
+    }
+}
+
+void CalcFileNameHashes(const char ** FileNames, ULONGLONG * Hashes, size_t nCount)
+{
+    for(size_t i = 0; i < nCount; i += CASC_HASH_LANES)
+    {
+        CalcFileNameHashes_Lanes(FileNames + i, Hashes + i, nCount - i);
+    }
+}
+
 //-----------------------------------------------------------------------------
 // File name utilities
 
@@ -642,6 +760,140 @@ bool CascCheckWildCard(const char * szString, const char * szWildCard)
     return true;
 }
 
+//-----------------------------------------------------------------------------
+// Compiled wildcard mask
+
+CASC_MASK::CASC_MASK()
+{
+    szNormMask = NULL;
+    SegmentEnds = NULL;
+    nSegments = 0;
+    nMinLength = 0;
+    nDirectoryLength = 0;
+    bHasAsterisk = false;
+    bPrefixMatch = false;
+    bMatchAll = false;
+}
+
+CASC_MASK::~CASC_MASK()
+{
+    CASC_FREE(SegmentEnds);
+    CASC_FREE(szNormMask);
+}
+
+DWORD CASC_MASK::Compile(const char * szMask)
+{
+    size_t nMaskLength = strlen(szMask);
+    size_t nNormLength = 0;
+    size_t i;
+
+    // Free the previous mask, if any
+    CASC_FREE(SegmentEnds);
+    CASC_FREE(szNormMask);
+
+    // There is at most one segment per character, plus one
+    szNormMask = CASC_ALLOC<char>(nMaskLength + 1);
+    SegmentEnds = CASC_ALLOC<size_t>(nMaskLength + 1);
+    if(szNormMask == NULL || SegmentEnds == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    nSegments = 0;
+    nDirectoryLength = 0;
+    bHasAsterisk = false;
+
+    // The directory part of the literal prefix. Only the part before the first wildcard counts
+    for(i = 0; i < nMaskLength && szMask[i] != '*' && szMask[i] != '?'; i++)
+    {
+        if(szMask[i] == '\\' || szMask[i] == '/' || szMask[i] == ':')
+            nDirectoryLength = i + 1;
+    }
+
+    // Split the mask to the segments separated by asterisks.
+    // Adjacent asterisks produce empty segments, which match anywhere
+    for(i = 0; i < nMaskLength; i++)
+    {
+        if(szMask[i] == '*')
+        {
+            SegmentEnds[nSegments++] = nNormLength;
+            bHasAsterisk = true;
+            continue;
+        }
+
+        szNormMask[nNormLength++] = AsciiToUpperTable_BkSlash[(BYTE)szMask[i]];
+    }
+    SegmentEnds[nSegments++] = nNormLength;
+    szNormMask[nNormLength] = 0;
+
+    nMinLength = nNormLength;
+    bPrefixMatch = (nMaskLength == 0 || (szMask[nMaskLength - 1] != '*' && szMask[nMaskLength - 1] != '?'));
+    bMatchAll = (bHasAsterisk && nNormLength == 0) || (nMaskLength == 0);
+    return ERROR_SUCCESS;
+}
+
+// Compares the string with the n-th segment. The string must be long enough
+bool CASC_MASK::CheckSegment(const char * szString, size_t nSegment)
+{
+    size_t nBegin = (nSegment != 0) ? SegmentEnds[nSegment - 1] : 0;
+    size_t nEnd = SegmentEnds[nSegment];
+
+    for(size_t i = nBegin; i < nEnd; i++, szString++)
+    {
+        if(szNormMask[i] != '?' && szNormMask[i] != AsciiToUpperTable_BkSlash[(BYTE)szString[0]])
+            return false;
+    }
+    return true;
+}
+
+bool CASC_MASK::Check(const char * szString, size_t nLength)
+{
+    const char * szStringEnd = szString + nLength;
+    size_t nLastSegment = nSegments;
+    size_t nSegmentLength;
+
+    // Quick checks first
+    if(bMatchAll)
+        return true;
+    if(nLength < nMinLength || (bHasAsterisk == false && bPrefixMatch == false && nLength != nMinLength))
+        return false;
+
+    // The first segment must match the begin of the string
+    if(!CheckSegment(szString, 0))
+        return false;
+    if(bHasAsterisk == false)
+        return true;
+    szString += SegmentEnds[0];
+
+    // The last segment must match the end of the string. If the string may continue
+    // after the match, the last segment is matched like the middle ones
+    if(bPrefixMatch == false)
+    {
+        nSegmentLength = SegmentEnds[nSegments - 1] - SegmentEnds[nSegments - 2];
+        szStringEnd -= nSegmentLength;
+        if(!CheckSegment(szStringEnd, nSegments - 1))
+            return false;
+        nLastSegment = nSegments - 1;
+    }
+
+    // Each middle segment is matched at the first possible position.
+    // Taking the first position never prevents the next segments from matching
+    for(size_t nSegment = 1; nSegment < nLastSegment; nSegment++)
+    {
+        nSegmentLength = SegmentEnds[nSegment] - SegmentEnds[nSegment - 1];
+
+        for(;;)
+        {
+            if((size_t)(szStringEnd - szString) < nSegmentLength)
+                return false;
+            if(CheckSegment(szString, nSegment))
+                break;
+            szString++;
+        }
+
+        szString += nSegmentLength;
+    }
+
+    return true;
+}
+
 //-----------------------------------------------------------------------------
 // Hashing functions
 
@@ -679,3 +931,63 @@ void CascCalculateDataBlockHash(void * pvDataBlock, DWORD cbDataBlock, LPBYTE md
     MD5_Update(&md5_ctx, pvDataBlock, cbDataBlock);
     MD5_Final(md5_hash, &md5_ctx);
 }
+
+//-----------------------------------------------------------------------------
+// Processor features
+
+static DWORD QueryCpuFeatures()
+{
+    DWORD dwCpuFeatures = 0;
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int CpuInfo[4];
+    int MaxLeaf;
+
+    // Leaf 1: ECX bit 23 is POPCNT
+    __cpuid(CpuInfo, 0);
+    MaxLeaf = CpuInfo[0];
+    __cpuid(CpuInfo, 1);
+    if(CpuInfo[2] & (1 << 23))
+        dwCpuFeatures |= CASC_CPU_POPCNT;
+
+    // Leaf 7: EBX bit 3 is BMI1, bit 8 is BMI2
+    if(MaxLeaf >= 7)
+    {
+        __cpuidex(CpuInfo, 7, 0);
+        if((CpuInfo[1] & (1 << 3)) && (CpuInfo[1] & (1 << 8)))
+            dwCpuFeatures |= CASC_CPU_BMI2;
+    }
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    unsigned int eax, ebx, ecx, edx;
+    unsigned int MaxLeaf = __get_cpuid_max(0, NULL);
+
+    // Leaf 1: ECX bit 23 is POPCNT
+    if(MaxLeaf >= 1)
+    {
+        __cpuid(1, eax, ebx, ecx, edx);
+        if(ecx & (1 << 23))
+            dwCpuFeatures |= CASC_CPU_POPCNT;
+    }
+
+    // Leaf 7: EBX bit 3 is BMI1, bit 8 is BMI2
+    if(MaxLeaf >= 7)
+    {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        if((ebx & (1 << 3)) && (ebx & (1 << 8)))
+            dwCpuFeatures |= CASC_CPU_BMI2;
+    }
+#endif
+
+    return dwCpuFeatures;
+}
+
+DWORD CascGetCpuFeatures()
+{
+    static DWORD dwCpuFeatures = CASC_INVALID_ID;
+
+    // The detection is idempotent, so it does not matter
+    // if more threads happen to run it at the same time
+    if(dwCpuFeatures == CASC_INVALID_ID)
+        dwCpuFeatures = QueryCpuFeatures();
+    return dwCpuFeatures;
+}
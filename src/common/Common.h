@@ -90,13 +90,19 @@ struct CASC_CKEY_ENTRY
     }
 
     bool IsFile()
+    {
+        return IsFile(RefCount);
+    }
+
+    // The reference count may be kept outside of the entry (see CASC_CKEY_REFS)
+    bool IsFile(USHORT nRefCount)
     {
         // Must not be a folder entry
         if((Flags & CASC_CE_FOLDER_ENTRY) == 0)
         {
             // There can be entries that are both file span or the standalone file
             // * zone/zm_red.xpak - { zone/zm_red.xpak_1, zone/zm_red.xpak_2, ..., zone/zm_red.xpak_6 }
-            if(RefCount != 0)
+            if(nRefCount != 0)
                 return true;
 
             // To include the file, it must either be present in ENCODING, DOWNLOAD or in BUILD file
@@ -338,6 +344,7 @@ size_t NormalizeFileName_LowerSlash(char * szNormName, const char * szFileName,
 
 ULONGLONG CalcNormNameHash(const char * szNormName, size_t nLength);
 ULONGLONG CalcFileNameHash(const char * szFileName);
+void CalcFileNameHashes(const char ** FileNames, ULONGLONG * Hashes, size_t nCount);
 
 //-----------------------------------------------------------------------------
 // String conversion functions
@@ -514,6 +521,59 @@ bool IsFileCKeyEKeyName(const char * szFileName, LPBYTE PtrKeyBuffer);
 
 bool CascCheckWildCard(const char * szString, const char * szWildCard);
 
+//-----------------------------------------------------------------------------
+// Compiled wildcard mask. The mask is only parsed once and the matching never backtracks.
+// Unlike CascCheckWildCard, the mask must match the entire string ("*.m2" doesn't match "Model.m2i")
+
+struct CASC_MASK
+{
+    CASC_MASK();
+    ~CASC_MASK();
+
+    // Compiles the mask. Must be called before Check
+    DWORD Compile(const char * szMask);
+
+    // Checks whether the string matches the mask. Like CascCheckWildCard, a mask that doesn't end
+    // with '*' or '?' only needs to match the begin of the string ("*.m2" matches "Model.m2i")
+    bool Check(const char * szString, size_t nLength);
+    bool Check(const char * szString)
+    {
+        return bMatchAll || Check(szString, strlen(szString));
+    }
+
+    // Returns the length of the literal directory part of the mask ("World\Maps\" for "world/maps/*.adt")
+    // Every matching string starts with it, so whole folders can be skipped if they don't
+    size_t GetDirectoryLength()
+    {
+        return nDirectoryLength;
+    }
+
+    // Returns the normalized mask (uppercase, backslashes)
+    const char * GetNormMask()
+    {
+        return szNormMask;
+    }
+
+    // Returns true if the mask matches any string
+    bool IsMatchAll()
+    {
+        return bMatchAll;
+    }
+
+    protected:
+
+    bool CheckSegment(const char * szString, size_t nSegment);
+
+    char * szNormMask;                              // Normalized mask, without the asterisks
+    size_t * SegmentEnds;                           // End offset of each segment of the mask in szNormMask
+    size_t nSegments;                               // Number of parts separated by asterisks
+    size_t nMinLength;                              // Minimal length of a matching string
+    size_t nDirectoryLength;                        // Length of the literal directory part of the mask
+    bool bHasAsterisk;                              // If false, the string must have exactly nMinLength characters (unless bPrefixMatch)
+    bool bPrefixMatch;                              // The mask doesn't end with '*' or '?', so the string may continue after the match
+    bool bMatchAll;                                 // The mask is "*" (or any number of asterisks)
+};
+
 //-----------------------------------------------------------------------------
 // Hashing functions
 
@@ -523,6 +583,14 @@ bool CascIsValidMD5(LPBYTE pbMd5);
 void CascCalculateDataBlockHash(void * pvDataBlock, DWORD cbDataBlock, LPBYTE md5_hash);
 bool CascVerifyDataBlockHash(void * pvDataBlock, DWORD cbDataBlock, LPBYTE expected_md5);
 
+//-----------------------------------------------------------------------------
+// Processor features, detected at runtime
+
+#define CASC_CPU_POPCNT             0x00000001      // The processor supports the POPCNT instruction
+#define CASC_CPU_BMI2               0x00000002      // The processor supports BMI1 and BMI2 (TZCNT, PDEP)
+
+DWORD CascGetCpuFeatures();
+
 //-----------------------------------------------------------------------------
 // Scanning a directory
 
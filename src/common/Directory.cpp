@@ -108,3 +108,101 @@ int ScanIndexDirectory(
 
     return ERROR_SUCCESS;
 }
+
+// Creates the lock file and locks it exclusively. Returns INVALID_HANDLE_VALUE
+// if the file is locked by another process or by another handle of this process
+HANDLE LockDirectoryFile(LPCTSTR szFileName)
+{
+#ifdef CASCLIB_PLATFORM_WINDOWS
+
+    return CreateFile(szFileName, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_ALWAYS, 0, NULL);
+
+#else // CASCLIB_PLATFORM_WINDOWS
+
+    intptr_t handle;
+
+    // The lock belongs to the open file description, so even two opens
+    // of the same file in one process exclude each other
+    if((handle = open(szFileName, O_RDWR | O_CREAT, 0644)) == -1)
+        return INVALID_HANDLE_VALUE;
+    if(flock(handle, LOCK_EX | LOCK_NB) == -1)
+    {
+        close(handle);
+        return INVALID_HANDLE_VALUE;
+    }
+    return (HANDLE)handle;
+
+#endif
+}
+
+void UnlockDirectoryFile(HANDLE hLockFile)
+{
+    if(hLockFile != INVALID_HANDLE_VALUE)
+    {
+#ifdef CASCLIB_PLATFORM_WINDOWS
+        CloseHandle(hLockFile);
+#else
+        close((intptr_t)hLockFile);
+#endif
+    }
+}
+
+static bool HasExtension(LPCTSTR szFileName, LPCTSTR szExtension)
+{
+    size_t nNameLength = _tcslen(szFileName);
+    size_t nExtLength = _tcslen(szExtension);
+
+    return (nNameLength > nExtLength && !_tcsicmp(szFileName + nNameLength - nExtLength, szExtension));
+}
+
+// Deletes the files with the given extension in the directory and all its subdirectories
+void DeleteDirectoryFiles(LPCTSTR szDirectory, LPCTSTR szExtension)
+{
+    TCHAR szFilePath[MAX_PATH];
+
+#ifdef CASCLIB_PLATFORM_WINDOWS
+
+    WIN32_FIND_DATA wf;
+    HANDLE hFind;
+
+    CombinePath(szFilePath, _countof(szFilePath), szDirectory, _T("*"), NULL);
+    if((hFind = FindFirstFile(szFilePath, &wf)) != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if(_tcscmp(wf.cFileName, _T(".")) && _tcscmp(wf.cFileName, _T("..")))
+            {
+                CombinePath(szFilePath, _countof(szFilePath), szDirectory, wf.cFileName, NULL);
+                if(wf.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                    DeleteDirectoryFiles(szFilePath, szExtension);
+                else if(HasExtension(wf.cFileName, szExtension))
+                    DeleteFile(szFilePath);
+            }
+        }
+        while(FindNextFile(hFind, &wf));
+        FindClose(hFind);
+    }
+
+#else // CASCLIB_PLATFORM_WINDOWS
+
+    struct dirent * dir_entry;
+    DIR * dir;
+
+    if((dir = opendir(szDirectory)) != NULL)
+    {
+        while((dir_entry = readdir(dir)) != NULL)
+        {
+            if(strcmp(dir_entry->d_name, ".") && strcmp(dir_entry->d_name, ".."))
+            {
+                CombinePath(szFilePath, _countof(szFilePath), szDirectory, dir_entry->d_name, NULL);
+                if(dir_entry->d_type == DT_DIR)
+                    DeleteDirectoryFiles(szFilePath, szExtension);
+                else if(HasExtension(dir_entry->d_name, szExtension))
+                    unlink(szFilePath);
+            }
+        }
+        closedir(dir);
+    }
+
+#endif
+}
@@ -24,4 +24,13 @@ int ScanIndexDirectory(
     void * pvContext
     );
 
+//-----------------------------------------------------------------------------
+// Lock files and cleanup of directories
+
+HANDLE LockDirectoryFile(LPCTSTR szFileName);
+
+void UnlockDirectoryFile(HANDLE hLockFile);
+
+void DeleteDirectoryFiles(LPCTSTR szDirectory, LPCTSTR szExtension);
+
 #endif // __DIRECTORY_H__
@@ -530,6 +530,8 @@ static bool BaseMap_Open(TFileStream * pStream, LPCTSTR szFileName, DWORD dwStre
         if(fstat64(handle, &fileinfo) != -1)
         {
             pStream->Base.Map.pbFile = (LPBYTE)mmap(NULL, (size_t)fileinfo.st_size, PROT_READ, MAP_PRIVATE, handle, 0);
+            if(pStream->Base.Map.pbFile == (LPBYTE)MAP_FAILED)
+                pStream->Base.Map.pbFile = NULL;
             if(pStream->Base.Map.pbFile != NULL)
             {
                 // time_t is number of seconds since 1.1.1970, UTC.
@@ -670,13 +672,17 @@ static DWORD BaseHttp_ParseURL(TFileStream * pStream, LPCTSTR szFileName, int *
 //-----------------------------------------------------------------------------
 // Local functions - base HTTP file support
 
-static bool BaseHttp_Download(TFileStream * pStream)
+// If cbRange is nonzero, only the given range of the file is requested.
+// The server may ignore the range and send the whole file
+static bool BaseHttp_Download(TFileStream * pStream, ULONGLONG RangeOffset = 0, DWORD cbRange = 0)
 {
     CASC_MIME Mime;
     const char * request_mask = "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: Keep-Alive\r\n\r\n";
+    const char * range_mask = "GET %s HTTP/1.1\r\nHost: %s\r\nRange: bytes=%llu-%llu\r\nConnection: Keep-Alive\r\n\r\n";
     char * server_response;
     char * fileName = pStream->Base.Socket.fileName;
-    char request[0x100];
+    char request[0x180];
+    bool bIsRange = false;
     size_t response_length = 0;
     size_t request_length = 0;
     DWORD dwErrCode;
@@ -694,15 +700,35 @@ static bool BaseHttp_Download(TFileStream * pStream)
         }
 
         // Send the request and receive decoded response
-        request_length = CascStrPrintf(request, _countof(request), request_mask, fileName, pStream->Base.Socket.hostName);
+        if(cbRange != 0 && (pStream->dwFlags & BASE_PROVIDER_MASK) == BASE_PROVIDER_HTTP)
+        {
+            unsigned long long RangeBegin = RangeOffset;
+            unsigned long long RangeEnd = RangeOffset + cbRange - 1;
+
+            request_length = CascStrPrintf(request, _countof(request), range_mask, fileName, pStream->Base.Socket.hostName, RangeBegin, RangeEnd);
+        }
+        else
+        {
+            request_length = CascStrPrintf(request, _countof(request), request_mask, fileName, pStream->Base.Socket.hostName);
+        }
         server_response = pStream->Base.Socket.pSocket->ReadResponse(request, request_length, &response_length);
         if(server_response != NULL)
         {
+            // "206 Partial Content" means that the server sent just the range
+            if(cbRange != 0 && response_length > 12 && !strncmp(server_response + 9, "206", 3))
+                bIsRange = true;
+
             // Decode the MIME document
             if((dwErrCode = Mime.Load(server_response, response_length)) == ERROR_SUCCESS)
             {
                 // Move the data from MIME to HTTP stream
                 pStream->Base.Socket.fileData = Mime.GiveAway(&pStream->Base.Socket.fileDataLength);
+                pStream->Base.Socket.fileDataOffset = bIsRange ? RangeOffset : 0;
+                pStream->Base.Socket.fileDataIsRange = bIsRange;
+            }
+            else
+            {
+                SetCascError(dwErrCode);
             }
 
             CASC_FREE(server_response);
@@ -713,6 +739,23 @@ static bool BaseHttp_Download(TFileStream * pStream)
     return (pStream->Base.Socket.fileData != NULL);
 }
 
+static void BaseHttp_FreeData(TFileStream * pStream)
+{
+    CASC_FREE(pStream->Base.Socket.fileData);
+    pStream->Base.Socket.fileData = NULL;
+    pStream->Base.Socket.fileDataOffset = 0;
+    pStream->Base.Socket.fileDataLength = 0;
+    pStream->Base.Socket.fileDataIsRange = false;
+}
+
+// Makes sure that the whole file is downloaded, not just a range of it
+static bool BaseHttp_DownloadAll(TFileStream * pStream)
+{
+    if(pStream->Base.Socket.fileDataIsRange)
+        BaseHttp_FreeData(pStream);
+    return BaseHttp_Download(pStream);
+}
+
 static bool BaseHttp_Open(TFileStream * pStream, LPCTSTR szFileName, DWORD dwStreamFlags)
 {
     PCASC_SOCKET pSocket;
@@ -750,20 +793,37 @@ static bool BaseHttp_Read(
         // Do we have to read anything at all?
         if(dwBytesToRead != 0)
         {
+            ULONGLONG DataOffset = pStream->Base.Socket.fileDataOffset;
+            size_t DataLength = pStream->Base.Socket.fileDataLength;
+            bool bDownloaded;
+
+            // A read at explicit offset of a file that was not downloaded yet only downloads the range.
+            // If we only have a range and the read is outside of it, we need the whole file
+            if(pStream->Base.Socket.fileData == NULL && pByteOffset != NULL)
+                bDownloaded = BaseHttp_Download(pStream, ByteOffset, dwBytesToRead);
+            else if(pStream->Base.Socket.fileDataIsRange && (ByteOffset < DataOffset || (ByteOffset + dwBytesToRead) > (DataOffset + DataLength)))
+                bDownloaded = BaseHttp_DownloadAll(pStream);
+            else
+                bDownloaded = BaseHttp_Download(pStream);
+
             // Make sure that we have the file downloaded
-            if(!BaseHttp_Download(pStream))
+            if(!bDownloaded)
             {
                 CascUnlock(pStream->Lock);
                 return false;
             }
 
+            // Work with offsets relative to the downloaded data
+            DataOffset = pStream->Base.Socket.fileDataOffset;
+            DataLength = pStream->Base.Socket.fileDataLength;
+
             // Are we trying to read more than available?
-            if(ByteOffset <= pStream->Base.Socket.fileDataLength)
+            if(DataOffset <= ByteOffset && (ByteOffset - DataOffset) <= DataLength)
             {
-                if((ByteOffset + dwBytesToRead) > pStream->Base.Socket.fileDataLength)
+                if((ByteOffset - DataOffset + dwBytesToRead) > DataLength)
                 {
                     bCanReadTheWholeRange = false;
-                    dwBytesToRead = (DWORD)(pStream->Base.Socket.fileDataLength - ByteOffset);
+                    dwBytesToRead = (DWORD)(DataLength - (ByteOffset - DataOffset));
                 }
             }
             else
@@ -775,7 +835,7 @@ static bool BaseHttp_Read(
             // Copy the data
             if(dwBytesToRead != 0)
             {
-                memcpy(pvBuffer, pStream->Base.Socket.fileData + ByteOffset, dwBytesToRead);
+                memcpy(pvBuffer, pStream->Base.Socket.fileData + (size_t)(ByteOffset - DataOffset), dwBytesToRead);
             }
         }
 
@@ -799,7 +859,7 @@ static bool BaseHttp_GetSize(TFileStream * pStream, ULONGLONG * pFileSize)
     CascLock(pStream->Lock);
     {
         // Make sure that we have the file data
-        bResult = BaseHttp_Download(pStream);
+        bResult = BaseHttp_DownloadAll(pStream);
         if(bResult)
         {
             *pFileSize = pStream->Base.Socket.fileDataLength;
@@ -2698,6 +2758,38 @@ bool FileStream_GetFlags(TFileStream * pStream, PDWORD pdwStreamFlags)
     return true;
 }
 
+/**
+ * Returns pointer to the memory-mapped view of the entire file.
+ * Only works for flat streams opened with BASE_PROVIDER_MAP
+ *
+ * \a pStream Pointer to an open stream
+ * \a PtrFileSize Pointer where to store the size of the mapped view
+ */
+LPBYTE FileStream_GetMappedView(TFileStream * pStream, ULONGLONG * PtrFileSize)
+{
+    // The view is only there for flat, memory-mapped streams without a master
+    if((pStream->dwFlags & STREAM_PROVIDERS_MASK) != (STREAM_PROVIDER_FLAT | BASE_PROVIDER_MAP) || pStream->pMaster != NULL)
+        return NULL;
+
+    if(PtrFileSize != NULL)
+        PtrFileSize[0] = pStream->Base.Map.FileSize;
+    return pStream->Base.Map.pbFile;
+}
+
+/**
+ * Returns the OS file handle of a stream, so the caller can issue its own positional
+ * reads (e.g. asynchronous ones). Only flat, file-based streams have it.
+ * Returns INVALID_HANDLE_VALUE for any other stream.
+ *
+ * \a pStream Pointer to an open stream
+ */
+HANDLE FileStream_GetFileHandle(TFileStream * pStream)
+{
+    if((pStream->dwFlags & STREAM_PROVIDERS_MASK) != (STREAM_PROVIDER_FLAT | BASE_PROVIDER_FILE) || pStream->pMaster != NULL)
+        return INVALID_HANDLE_VALUE;
+    return pStream->Base.File.hFile;
+}
+
 /**
  * Switches a stream with another. Used for final phase of archive compacting.
  * Performs these steps:
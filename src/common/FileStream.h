@@ -176,8 +176,10 @@ union TBaseProviderData
         unsigned char * fileData;           // Raw response converted to file data
         char * hostName;                    // Name of the remote host
         char * fileName;                    // Name of the remote resource
+        ULONGLONG fileDataOffset;           // Offset of the file data in the remote file. Nonzero only after a range request
         size_t fileDataLength;              // Length of the file data, in bytes
-        size_t fileDataPos;                 // Current position in the data
+        size_t fileDataPos;                 // Current position in the remote file
+        bool fileDataIsRange;               // If true, the file data is only a range of the remote file
     } Socket;
 };
 
@@ -263,6 +265,8 @@ bool FileStream_GetSize(TFileStream * pStream, ULONGLONG * pFileSize);
 bool FileStream_GetPos(TFileStream * pStream, ULONGLONG * pByteOffset);
 bool FileStream_GetTime(TFileStream * pStream, ULONGLONG * pFT);
 bool FileStream_GetFlags(TFileStream * pStream, PDWORD pdwStreamFlags);
+LPBYTE FileStream_GetMappedView(TFileStream * pStream, ULONGLONG * PtrFileSize);
+HANDLE FileStream_GetFileHandle(TFileStream * pStream);
 bool FileStream_Replace(TFileStream * pStream, TFileStream * pNewStream);
 void FileStream_Close(TFileStream * pStream);
 
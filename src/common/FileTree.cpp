@@ -165,6 +165,110 @@ DWORD CASC_FILE_TREE::GetNextFileDataId()
     return CASC_INVALID_ID;
 }
 
+// Hashes the pointer to the CKey entry into an index to the map of CKey entries
+static size_t CKeyMapIndex(PCASC_CKEY_ENTRY pCKeyEntry, size_t CKeyMapSize)
+{
+    ULONGLONG HashValue = (ULONGLONG)(size_t)pCKeyEntry * 0x9E3779B97F4A7C15ULL;
+
+    return (size_t)(HashValue >> 32) & (CKeyMapSize - 1);
+}
+
+// Enlarges the map of CKey entries. Only the first node of each CKey entry is in the map,
+// the rest is linked through CKeyLinks, so the chains stay valid
+bool CASC_FILE_TREE::EnlargeCKeyMap()
+{
+    PCASC_FILE_NODE pFileNode;
+    DWORD * NewCKeyMap;
+    size_t NewCKeyMapSize = (CKeyMapSize != 0) ? (CKeyMapSize * 2) : START_ITEM_COUNT;
+    size_t nIndex;
+
+    // Allocate the new map
+    if((NewCKeyMap = CASC_ALLOC_ZERO<DWORD>(NewCKeyMapSize)) == NULL)
+        return false;
+
+    // Move all first nodes to the new map
+    for(size_t i = 0; i < CKeyMapSize; i++)
+    {
+        if(CKeyMap[i] != 0)
+        {
+            pFileNode = (PCASC_FILE_NODE)NodeTable.ItemAt(CKeyMap[i]);
+            nIndex = CKeyMapIndex(pFileNode->pCKeyEntry, NewCKeyMapSize);
+
+            while(NewCKeyMap[nIndex] != 0)
+                nIndex = (nIndex + 1) & (NewCKeyMapSize - 1);
+            NewCKeyMap[nIndex] = CKeyMap[i];
+        }
+    }
+
+    // Replace the map
+    CASC_FREE(CKeyMap);
+    CKeyMap = NewCKeyMap;
+    CKeyMapSize = NewCKeyMapSize;
+    return true;
+}
+
+// Inserts the file node to the map of CKey entry -> CASC_FILE_NODE.
+// The map holds node indexes rather than pointers, so it survives reallocation of the NodeTable
+bool CASC_FILE_TREE::InsertToCKeyMap(PCASC_FILE_NODE pFileNode)
+{
+    PCASC_FILE_NODE pFirstNode;
+    DWORD * RefFirstLink;
+    DWORD * RefLink;
+    DWORD NodeIndex = (DWORD)NodeTable.IndexOf(pFileNode);
+    size_t nIndex;
+
+    // The root node (index 0) is used as the terminator and never has a CKey entry
+    if(pFileNode->pCKeyEntry == NULL || NodeIndex == 0)
+        return false;
+
+    // Keep the map at most two thirds full
+    if(((CKeyMapCount + 1) * 3 / 2) >= CKeyMapSize)
+    {
+        if(!EnlargeCKeyMap())
+            return false;
+    }
+
+    // Make sure that there is a link for the new node
+    if((RefLink = (DWORD *)CKeyLinks.InsertAt(NodeIndex)) == NULL)
+        return false;
+    RefLink[0] = 0;
+
+    // Find either the slot of the CKey entry or a free slot
+    nIndex = CKeyMapIndex(pFileNode->pCKeyEntry, CKeyMapSize);
+    while(CKeyMap[nIndex] != 0)
+    {
+        pFirstNode = (PCASC_FILE_NODE)NodeTable.ItemAt(CKeyMap[nIndex]);
+        if(pFirstNode->pCKeyEntry == pFileNode->pCKeyEntry)
+        {
+            // Link the node right after the first one. The first inserted node stays the first one
+            RefFirstLink = (DWORD *)CKeyLinks.ItemAt(CKeyMap[nIndex]);
+            RefLink[0] = RefFirstLink[0];
+            RefFirstLink[0] = NodeIndex;
+            return true;
+        }
+
+        nIndex = (nIndex + 1) & (CKeyMapSize - 1);
+    }
+
+    // This is the first node with this CKey entry
+    CKeyMap[nIndex] = NodeIndex;
+    CKeyMapCount++;
+    return true;
+}
+
+void CASC_FILE_TREE::AddRef(PCASC_CKEY_ENTRY pCKeyEntry)
+{
+    if(pCKeyRefs != NULL)
+    {
+        pCKeyRefs->AddRef(pCKeyEntry);
+    }
+    else
+    {
+        assert(pCKeyEntry->RefCount != 0xFFFF);
+        pCKeyEntry->RefCount++;
+    }
+}
+
 bool CASC_FILE_TREE::RebuildNameMaps()
 {
     PCASC_FILE_NODE pFileNode;
@@ -248,6 +352,8 @@ DWORD CASC_FILE_TREE::Create(DWORD Flags)
     {
         // Create the dynamic array that will hold the node names
         dwErrCode = NameTable.Create<char>(START_ITEM_COUNT);
+        if(dwErrCode == ERROR_SUCCESS)
+            dwErrCode = CKeyLinks.Create<DWORD>(START_ITEM_COUNT);
         if(dwErrCode == ERROR_SUCCESS)
         {
             // Insert the first "root" node, without name
@@ -276,6 +382,10 @@ void CASC_FILE_TREE::Free()
     NodeTable.Free();
     NameTable.Free();
     FileDataIds.Free();
+    CKeyLinks.Free();
+
+    // Free the map of CKey entries
+    CASC_FREE(CKeyMap);
 
     // Free the name map
     NameMap.Free();
@@ -284,6 +394,11 @@ void CASC_FILE_TREE::Free()
     memset(this, 0, sizeof(CASC_FILE_TREE));
 }
 
+void CASC_FILE_TREE::SetCKeyRefs(CASC_CKEY_REFS * pRefs)
+{
+    pCKeyRefs = pRefs;
+}
+
 PCASC_FILE_NODE CASC_FILE_TREE::InsertByName(PCASC_CKEY_ENTRY pCKeyEntry, const char * szFileName, DWORD FileDataId, DWORD LocaleFlags, DWORD ContentFlags)
 {
     PCASC_FILE_NODE pFileNode;
@@ -318,12 +433,14 @@ PCASC_FILE_NODE CASC_FILE_TREE::InsertByName(PCASC_CKEY_ENTRY pCKeyEntry, const
             // Also make sure that it's in the file data id table, if the table is initialized
             InsertToIdTable(pFileNode);
 
+            // Insert the node to the map of CKey entries
+            InsertToCKeyMap(pFileNode);
+
             // Set the file name of the new file node
             SetNodeFileName(pFileNode, szFileName);
 
             // If we created a new node, we need to increment the reference count
-            assert(pCKeyEntry->RefCount != 0xFFFF);
-            pCKeyEntry->RefCount++;
+            AddRef(pCKeyEntry);
             FileNodes++;
         }
     }
@@ -377,8 +494,11 @@ PCASC_FILE_NODE CASC_FILE_TREE::InsertById(PCASC_CKEY_ENTRY pCKeyEntry, DWORD Fi
             // Insert the file node to the FileDataId array
             InsertToIdTable(pFileNode);
 
+            // Insert the node to the map of CKey entries
+            InsertToCKeyMap(pFileNode);
+
             // Increment the number of references
-            pCKeyEntry->RefCount++;
+            AddRef(pCKeyEntry);
         }
     }
 
@@ -391,15 +511,30 @@ PCASC_FILE_NODE CASC_FILE_TREE::ItemAt(size_t nItemIndex)
     return (PCASC_FILE_NODE)NodeTable.ItemAt(nItemIndex);
 }
 
-PCASC_FILE_NODE CASC_FILE_TREE::PathAt(char * szBuffer, size_t cchBuffer, size_t nItemIndex)
+const char * CASC_FILE_TREE::NameAt(PCASC_FILE_NODE pFileNode)
 {
-    PCASC_FILE_NODE pFileNode = NULL;
+    if(pFileNode == NULL || pFileNode->NameIndex == CASC_INVALID_INDEX)
+        return NULL;
+    return (const char *)NameTable.ItemAt(pFileNode->NameIndex);
+}
+
+PCASC_FILE_NODE CASC_FILE_TREE::FileAt(size_t nItemIndex)
+{
+    PCASC_FILE_NODE * RefElement;
 
     // If we have FileDataId, then we need to enumerate the files by FileDataId
     if(FileDataIds.IsInitialized())
-        pFileNode = *(PCASC_FILE_NODE *)FileDataIds.ItemAt(nItemIndex);
-    else
-        pFileNode = (PCASC_FILE_NODE)NodeTable.ItemAt(nItemIndex);
+    {
+        RefElement = (PCASC_FILE_NODE *)FileDataIds.ItemAt(nItemIndex);
+        return (RefElement != NULL) ? RefElement[0] : NULL;
+    }
+
+    return (PCASC_FILE_NODE)NodeTable.ItemAt(nItemIndex);
+}
+
+PCASC_FILE_NODE CASC_FILE_TREE::PathAt(char * szBuffer, size_t cchBuffer, size_t nItemIndex)
+{
+    PCASC_FILE_NODE pFileNode = FileAt(nItemIndex);
 
     // Construct the entire path
     PathAt(szBuffer, cchBuffer, pFileNode);
@@ -479,25 +614,66 @@ PCASC_FILE_NODE CASC_FILE_TREE::Find(const char * szFullPath, DWORD FileDataId,
 PCASC_FILE_NODE CASC_FILE_TREE::Find(PCASC_CKEY_ENTRY pCKeyEntry)
 {
     PCASC_FILE_NODE pFileNode;
+    size_t nIndex;
 
-    for(size_t i = 0; i < NodeTable.ItemCount(); i++)
+    if(CKeyMap != NULL && pCKeyEntry != NULL)
     {
-        pFileNode = (PCASC_FILE_NODE)NodeTable.ItemAt(i);
-        if((pFileNode->Flags & (CFN_FLAG_FOLDER | CFN_FLAG_MOUNT_POINT)) == 0)
+        // Find the slot with the first node of the CKey entry
+        nIndex = CKeyMapIndex(pCKeyEntry, CKeyMapSize);
+        while(CKeyMap[nIndex] != 0)
         {
+            pFileNode = (PCASC_FILE_NODE)NodeTable.ItemAt(CKeyMap[nIndex]);
             if(pFileNode->pCKeyEntry == pCKeyEntry)
-                return pFileNode;
+            {
+                // Folders and mount points don't count
+                if((pFileNode->Flags & (CFN_FLAG_FOLDER | CFN_FLAG_MOUNT_POINT)) == 0)
+                    return pFileNode;
+                return FindNext(pFileNode);
+            }
+
+            nIndex = (nIndex + 1) & (CKeyMapSize - 1);
         }
     }
 
     return NULL;
 }
 
+PCASC_FILE_NODE CASC_FILE_TREE::FindNext(PCASC_FILE_NODE pFileNode)
+{
+    DWORD * RefLink;
+
+    // Follow the links to the next node with the same CKey entry
+    while(pFileNode != NULL)
+    {
+        RefLink = (DWORD *)CKeyLinks.ItemAt(NodeTable.IndexOf(pFileNode));
+        if(RefLink == NULL || RefLink[0] == 0)
+            break;
+
+        pFileNode = (PCASC_FILE_NODE)NodeTable.ItemAt(RefLink[0]);
+        if((pFileNode->Flags & (CFN_FLAG_FOLDER | CFN_FLAG_MOUNT_POINT)) == 0)
+            return pFileNode;
+    }
+
+    return NULL;
+}
+
 PCASC_FILE_NODE CASC_FILE_TREE::Find(ULONGLONG FileNameHash)
 {
     return (PCASC_FILE_NODE)NameMap.FindObject(&FileNameHash);
 }
 
+void CASC_FILE_TREE::FindMany(ULONGLONG * FileNameHashes, PCASC_FILE_NODE * FileNodes, size_t nCount)
+{
+    // Prefetch the hash table slots, then the nodes they point to.
+    // By the time we compare the keys, most of the cache misses are resolved.
+    for(size_t i = 0; i < nCount; i++)
+        NameMap.PrefetchSlot(&FileNameHashes[i]);
+    for(size_t i = 0; i < nCount; i++)
+        NameMap.PrefetchObject(&FileNameHashes[i]);
+    for(size_t i = 0; i < nCount; i++)
+        FileNodes[i] = (PCASC_FILE_NODE)NameMap.FindObject(&FileNameHashes[i]);
+}
+
 PCASC_FILE_NODE CASC_FILE_TREE::FindById(DWORD FileDataId)
 {
     PCASC_FILE_NODE * RefElement;
@@ -517,20 +693,44 @@ PCASC_FILE_NODE CASC_FILE_TREE::FindById(DWORD FileDataId)
 }
 
 bool CASC_FILE_TREE::SetNodeFileName(PCASC_FILE_NODE pFileNode, const char * szFileName)
+{
+    return SetNodeFileName(pFileNode, szFileName, strlen(szFileName), 0);
+}
+
+bool CASC_FILE_TREE::SetNodeFileName(PCASC_FILE_NODE pFileNode, const char * szFileName, size_t cchFileName, ULONGLONG NameHash)
 {
     ULONGLONG FileNameHash = 0;
     PCASC_FILE_NODE pFolderNode = NULL;
     CASC_PATH<char> PathBuffer;
     LPCSTR szNodeBegin = szFileName;
     size_t nFileNode = NodeTable.IndexOf(pFileNode);
-    size_t i;
+    size_t nCommonLength = 0;
+    size_t nFolders = 0;
+    size_t i = 0;
     DWORD Parent = 0;
 
     // Sanity checks
-    assert(szFileName != NULL && szFileName[0] != 0);
+    assert(szFileName != NULL && cchFileName != 0);
 
-    // Traverse the entire path. For each subfolder, we insert an appropriate fake entry
-    for(i = 0; szFileName[i] != 0; i++)
+    // Listfiles are usually sorted, so the name is likely to share folders with the previous one.
+    // Find out how many folders of the previous name we can reuse without hashing them again
+    while(nCommonLength < cchFileName && nCommonLength < CachedPathLength && AsciiToUpperTable_BkSlash[(BYTE)szFileName[nCommonLength]] == CachedPath[nCommonLength])
+        nCommonLength++;
+    while(nFolders < CachedFolderCount && CachedSeparators[nFolders] < nCommonLength)
+        nFolders++;
+
+    // Start after the separator of the last reused folder
+    if(nFolders != 0)
+    {
+        Parent = CachedFolders[nFolders - 1];
+        szNodeBegin = szFileName + CachedSeparators[nFolders - 1] + 1;
+        for(; i < CachedSeparators[nFolders - 1] + 1; i++)
+            PathBuffer.AppendChar(CachedPath[i]);
+    }
+    CachedFolderCount = nFolders;
+
+    // Traverse the rest of the path. For each subfolder, we insert an appropriate fake entry
+    for(; i < cchFileName; i++)
     {
         char chOneChar = szFileName[i];
 
@@ -566,14 +766,25 @@ bool CASC_FILE_TREE::SetNodeFileName(PCASC_FILE_NODE pFileNode, const char * szF
             // Move the parent to the current node
             Parent = (DWORD)NodeTable.IndexOf(pFolderNode);
 
+            // Remember the folder for the next name
+            if(CachedFolderCount < _countof(CachedFolders) && i < _countof(CachedPath))
+            {
+                CachedSeparators[CachedFolderCount] = i;
+                CachedFolders[CachedFolderCount++] = Parent;
+            }
+
             // Move the begin of the node after the separator
             szNodeBegin = szFileName + i + 1;
         }
 
         // Copy the next character, even if it was slash/backslash before
-        PathBuffer.AppendChar(AsciiToUpperTable_BkSlash[chOneChar]);
+        PathBuffer.AppendChar(AsciiToUpperTable_BkSlash[(BYTE)chOneChar]);
     }
 
+    // Save the normalized name for the next call
+    CachedPathLength = CASCLIB_MIN(i, _countof(CachedPath));
+    memcpy(CachedPath, (const char *)PathBuffer, CachedPathLength);
+
     // If anything left, this is gonna be our node name
     if(szNodeBegin < szFileName + i)
     {
@@ -587,7 +798,7 @@ bool CASC_FILE_TREE::SetNodeFileName(PCASC_FILE_NODE pFileNode, const char * szF
         // Also insert the node to the hash table so CascOpenFile can find it
         if(pFileNode->FileNameHash == 0)
         {
-            pFileNode->FileNameHash = CalcNormNameHash(PathBuffer, i);
+            pFileNode->FileNameHash = (NameHash != 0) ? NameHash : CalcNormNameHash(PathBuffer, i);
             InsertToHashTable(pFileNode);
         }
     }
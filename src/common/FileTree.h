@@ -18,6 +18,8 @@
 #define FTREE_FLAG_USE_LOCALE_FLAGS   0x0002        // The FILE_NODE also contains file locale flags
 #define FTREE_FLAG_USE_CONTENT_FLAGS  0x0004        // The FILE_NODE also contains content flags
 
+#define FTREE_MAX_CACHED_FOLDERS      0x20          // Max number of folders remembered between calls to SetNodeFileName
+
 #define CFN_FLAG_FOLDER               0x0001        // This item is a folder
 #define CFN_FLAG_MOUNT_POINT          0x0002        // This item is a mount point.
 
@@ -37,6 +39,8 @@ typedef struct _CASC_FILE_NODE
                                                     // ContentFlags: Only if FTREE_FLAG_USE_CONTENT_FLAGS specified at create
 } CASC_FILE_NODE, *PCASC_FILE_NODE;
 
+struct CASC_CKEY_REFS;
+
 // Main structure for the file tree
 class CASC_FILE_TREE
 {
@@ -46,24 +50,36 @@ class CASC_FILE_TREE
     DWORD Create(DWORD Flags = 0);
     void Free();
 
+    // Sets where the references of the CKey entries are counted. If not set, they are counted in the entries
+    void SetCKeyRefs(CASC_CKEY_REFS * pRefs);
+
     // Inserts a new node to the tree; either with name or nameless
     PCASC_FILE_NODE InsertByName(PCASC_CKEY_ENTRY pCKeyEntry, const char * szFileName, DWORD FileDataId = CASC_INVALID_ID, DWORD LocaleFlags = CASC_INVALID_ID, DWORD ContentFlags = CASC_INVALID_ID);
     PCASC_FILE_NODE InsertByHash(PCASC_CKEY_ENTRY pCKeyEntry, ULONGLONG FileNameHash, DWORD FileDataId, DWORD LocaleFlags = CASC_INVALID_ID, DWORD ContentFlags = CASC_INVALID_ID);
     PCASC_FILE_NODE InsertById(PCASC_CKEY_ENTRY pCKeyEntry, DWORD FileDataId, DWORD LocaleFlags = CASC_INVALID_ID, DWORD ContentFlags = CASC_INVALID_ID);
 
     // Returns an item at the given index. The PathAt also builds the full path of the node
+    // FileAt returns the n-th item in the search order (by FileDataId, if the tree has them)
+    // NameAt returns the plain name of the node (not zero terminated, see NameLength)
     PCASC_FILE_NODE ItemAt(size_t nItemIndex);
+    PCASC_FILE_NODE FileAt(size_t nItemIndex);
+    const char * NameAt(PCASC_FILE_NODE pFileNode);
     PCASC_FILE_NODE PathAt(char * szBuffer, size_t cchBuffer, size_t nItemIndex);
     size_t PathAt(char * szBuffer, size_t cchBuffer, PCASC_FILE_NODE pFileNode);
 
     // Finds a file using its full path, FileDataId or CKey/EKey
+    // FindNext returns the next node that refers to the same CKey entry
     PCASC_FILE_NODE Find(const char * szFullPath, DWORD FileDataId, struct _CASC_FIND_DATA * pFindData);
     PCASC_FILE_NODE Find(PCASC_CKEY_ENTRY pCKeyEntry);
+    PCASC_FILE_NODE FindNext(PCASC_FILE_NODE pFileNode);
     PCASC_FILE_NODE Find(ULONGLONG FileNameHash);
+    void FindMany(ULONGLONG * FileNameHashes, PCASC_FILE_NODE * FileNodes, size_t nCount);
     PCASC_FILE_NODE FindById(DWORD FileDataId);
 
-    // Assigns a file name to the node
+    // Assigns a file name to the node. The name doesn't need to be zero terminated.
+    // If nonzero, NameHash is the already calculated hash of the normalized name
     bool SetNodeFileName(PCASC_FILE_NODE pFileNode, const char * szFileName);
+    bool SetNodeFileName(PCASC_FILE_NODE pFileNode, const char * szFileName, size_t cchFileName, ULONGLONG NameHash);
 
     // Returns the number of items in the tree
     size_t GetMaxFileIndex();
@@ -88,6 +104,9 @@ class CASC_FILE_TREE
     PCASC_FILE_NODE InsertNew();
     bool InsertToHashTable(PCASC_FILE_NODE pFileNode);
     bool InsertToIdTable(PCASC_FILE_NODE pFileNode);
+    bool InsertToCKeyMap(PCASC_FILE_NODE pFileNode);
+    bool EnlargeCKeyMap();
+    void AddRef(PCASC_CKEY_ENTRY pCKeyEntry);
 
     bool SetNodePlainName(PCASC_FILE_NODE pFileNode, const char * szPlainName, const char * szPlainNameEnd);
     bool RebuildNameMaps();
@@ -98,9 +117,23 @@ class CASC_FILE_TREE
     CASC_ARRAY FileDataIds;                         // Dynamic array that maps FileDataId -> CASC_FILE_NODE
     CASC_MAP NameMap;                               // Map of FileNameHash -> CASC_FILE_NODE
 
+    CASC_ARRAY CKeyLinks;                           // For each node, index of the next node with the same CKey entry (0 = none)
+    DWORD * CKeyMap;                                // Map of CKey entry -> index of the first CASC_FILE_NODE (0 = free slot)
+    size_t CKeyMapSize;                             // Size of the CKeyMap, in entries. Always a power of two
+    size_t CKeyMapCount;                            // Number of CKey entries in the CKeyMap
+    CASC_CKEY_REFS * pCKeyRefs;                     // Reference counts of the CKey entries (TCascStorage::CKeyRefs)
+
     size_t FileDataIdOffset;                        // If nonzero, this is the offset of the "FileDataId" field in the CASC_FILE_NODE
     size_t LocaleFlagsOffset;                       // If nonzero, this is the offset of the "LocaleFlags" field in the CASC_FILE_NODE
     size_t ContentFlagsOffset;                      // If nonzero, this is the offset of the "ContentFlags" field in the CASC_FILE_NODE
+    // Folders of the last name passed to SetNodeFileName. Names from sorted listfiles
+    // mostly share their folders with the previous name, so these don't need to be hashed again
+    char CachedPath[MAX_PATH];                      // Normalized (uppercase, backslashes) previous name
+    size_t CachedPathLength;                        // Length of the name in CachedPath
+    size_t CachedSeparators[FTREE_MAX_CACHED_FOLDERS]; // Position of the separator after each folder
+    DWORD CachedFolders[FTREE_MAX_CACHED_FOLDERS];  // Node index of each folder
+    size_t CachedFolderCount;                       // Number of valid items in CachedFolders
+
     size_t FolderNodes;                             // Number of folder nodes
     size_t FileNodes;                               // Number of file nodes
     DWORD KeyLength;                                // Actual length of the key supported by the root handler
@@ -0,0 +1,311 @@
+/*****************************************************************************/
+/* IoRing.cpp                             Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Minimal io_uring wrapper for asynchronous positional reads (Linux only)   */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 19.10.26  1.00  Lad  The first version of IoRing.cpp                      */
+/*****************************************************************************/
+
+#define __CASCLIB_SELF__
+#include "../CascLib.h"
+#include "../CascCommon.h"
+
+#if defined(CASCLIB_PLATFORM_LINUX) && defined(CASC_USE_IO_URING)
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+// We do not depend on liburing; the system calls are issued directly
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup     425
+#endif
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter     426
+#endif
+
+// Waiting with a timeout needs Linux 5.11+. Older headers don't have the flags
+#ifndef IORING_ENTER_EXT_ARG
+#define IORING_ENTER_EXT_ARG    (1U << 3)
+#endif
+#ifndef IORING_FEAT_EXT_ARG
+#define IORING_FEAT_EXT_ARG     (1U << 8)
+#endif
+
+// Same layout as struct io_uring_getevents_arg and struct __kernel_timespec
+struct CASC_RING_GETEVENTS_ARG
+{
+    ULONGLONG sigmask;
+    DWORD sigmask_sz;
+    DWORD pad;
+    ULONGLONG ts;
+};
+
+struct CASC_RING_TIMESPEC
+{
+    LONGLONG tv_sec;
+    LONGLONG tv_nsec;
+};
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+static int io_uring_setup(unsigned entries, struct io_uring_params * p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, void * arg = NULL, size_t argsz = 0)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static void * MapRing(int RingFd, size_t cbLength, off_t Offset)
+{
+    void * pvRing = mmap(NULL, cbLength, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, RingFd, Offset);
+
+    return (pvRing != MAP_FAILED) ? pvRing : NULL;
+}
+
+#define RING_PTR(base, offs)    (unsigned *)((LPBYTE)(base) + (offs))
+
+#endif  // defined(CASCLIB_PLATFORM_LINUX) && defined(CASC_USE_IO_URING)
+
+//-----------------------------------------------------------------------------
+// CASC_IO_RING functions
+
+CASC_IO_RING::CASC_IO_RING()
+{
+    SqEntries = CqEntries = SqPending = 0;
+    RingFd = -1;
+    pvSqRing = pvCqRing = pvSqes = pvCqes = NULL;
+    cbSqRing = cbCqRing = cbSqes = 0;
+    SqHead = SqTail = SqMask = SqArray = NULL;
+    CqHead = CqTail = CqMask = NULL;
+}
+
+CASC_IO_RING::~CASC_IO_RING()
+{
+    Free();
+}
+
+bool CASC_IO_RING::Create(DWORD dwEntries)
+{
+#if defined(CASCLIB_PLATFORM_LINUX) && defined(CASC_USE_IO_URING)
+    struct io_uring_params Params;
+
+    // Create the ring. This fails on kernels without io_uring,
+    // or if io_uring is disabled by the system administrator
+    memset(&Params, 0, sizeof(struct io_uring_params));
+    Params.flags = IORING_SETUP_CLAMP;
+    if((RingFd = io_uring_setup((dwEntries != 0) ? dwEntries : CASC_IO_RING_DEFAULT_DEPTH, &Params)) < 0)
+    {
+        RingFd = -1;
+        return false;
+    }
+
+    // We need IORING_OP_READ (Linux 5.6+, the same kernel that introduced IORING_FEAT_RW_CUR_POS),
+    // a completion queue that never drops completions (IORING_FEAT_NODROP)
+    // and waiting with a timeout (IORING_FEAT_EXT_ARG, Linux 5.11+)
+    if((Params.features & (IORING_FEAT_RW_CUR_POS | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG)) != (IORING_FEAT_RW_CUR_POS | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG))
+    {
+        Free();
+        return false;
+    }
+
+    // Map the submission queue and the completion queue.
+    // On newer kernels, both rings live in a single mapping
+    cbSqRing = Params.sq_off.array + Params.sq_entries * sizeof(unsigned);
+    cbCqRing = Params.cq_off.cqes + Params.cq_entries * sizeof(struct io_uring_cqe);
+    if(Params.features & IORING_FEAT_SINGLE_MMAP)
+        cbSqRing = cbCqRing = CASCLIB_MAX(cbSqRing, cbCqRing);
+    if((pvSqRing = MapRing(RingFd, cbSqRing, IORING_OFF_SQ_RING)) == NULL)
+    {
+        Free();
+        return false;
+    }
+
+    if(Params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        pvCqRing = pvSqRing;
+    }
+    else if((pvCqRing = MapRing(RingFd, cbCqRing, IORING_OFF_CQ_RING)) == NULL)
+    {
+        Free();
+        return false;
+    }
+
+    // Map the array of submission queue entries
+    cbSqes = Params.sq_entries * sizeof(struct io_uring_sqe);
+    if((pvSqes = MapRing(RingFd, cbSqes, IORING_OFF_SQES)) == NULL)
+    {
+        Free();
+        return false;
+    }
+
+    // Resolve the pointers into the rings
+    SqHead  = RING_PTR(pvSqRing, Params.sq_off.head);
+    SqTail  = RING_PTR(pvSqRing, Params.sq_off.tail);
+    SqMask  = RING_PTR(pvSqRing, Params.sq_off.ring_mask);
+    SqArray = RING_PTR(pvSqRing, Params.sq_off.array);
+    CqHead  = RING_PTR(pvCqRing, Params.cq_off.head);
+    CqTail  = RING_PTR(pvCqRing, Params.cq_off.tail);
+    CqMask  = RING_PTR(pvCqRing, Params.cq_off.ring_mask);
+    pvCqes  = RING_PTR(pvCqRing, Params.cq_off.cqes);
+    SqEntries = Params.sq_entries;
+    CqEntries = Params.cq_entries;
+    SqPending = 0;
+    return true;
+#else
+    CASCLIB_UNUSED(dwEntries);
+    return false;
+#endif
+}
+
+void CASC_IO_RING::Free()
+{
+#if defined(CASCLIB_PLATFORM_LINUX) && defined(CASC_USE_IO_URING)
+    if(pvSqes != NULL)
+        munmap(pvSqes, cbSqes);
+    if(pvCqRing != NULL && pvCqRing != pvSqRing)
+        munmap(pvCqRing, cbCqRing);
+    if(pvSqRing != NULL)
+        munmap(pvSqRing, cbSqRing);
+    if(RingFd != -1)
+        close(RingFd);
+#endif
+
+    pvSqRing = pvCqRing = pvSqes = pvCqes = NULL;
+    SqEntries = CqEntries = SqPending = 0;
+    RingFd = -1;
+}
+
+bool CASC_IO_RING::PushRead(HANDLE hFile, void * pvBuffer, DWORD cbBuffer, ULONGLONG ByteOffset, void * pvUserData)
+{
+#if defined(CASCLIB_PLATFORM_LINUX) && defined(CASC_USE_IO_URING)
+    struct io_uring_sqe * pSqe;
+    unsigned Tail = *SqTail;
+    unsigned Index;
+
+    // Is there a free entry in the submission queue?
+    if((Tail - __atomic_load_n(SqHead, __ATOMIC_ACQUIRE)) >= SqEntries)
+        return false;
+    Index = Tail & *SqMask;
+
+    // Fill the submission queue entry
+    pSqe = (struct io_uring_sqe *)pvSqes + Index;
+    memset(pSqe, 0, sizeof(struct io_uring_sqe));
+    pSqe->opcode = IORING_OP_READ;
+    pSqe->fd = (int)(intptr_t)hFile;
+    pSqe->off = ByteOffset;
+    pSqe->addr = (ULONGLONG)(uintptr_t)pvBuffer;
+    pSqe->len = cbBuffer;
+    pSqe->user_data = (ULONGLONG)(uintptr_t)pvUserData;
+
+    // Publish the entry to the kernel
+    SqArray[Index] = Index;
+    __atomic_store_n(SqTail, Tail + 1, __ATOMIC_RELEASE);
+    SqPending++;
+    return true;
+#else
+    CASCLIB_UNUSED(hFile);
+    CASCLIB_UNUSED(pvBuffer);
+    CASCLIB_UNUSED(cbBuffer);
+    CASCLIB_UNUSED(ByteOffset);
+    CASCLIB_UNUSED(pvUserData);
+    return false;
+#endif
+}
+
+DWORD CASC_IO_RING::Submit()
+{
+#if defined(CASCLIB_PLATFORM_LINUX) && defined(CASC_USE_IO_URING)
+    while(SqPending != 0)
+    {
+        int nSubmitted = io_uring_enter(RingFd, SqPending, 0, 0);
+
+        if(nSubmitted < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            return errno;
+        }
+        SqPending -= (DWORD)nSubmitted;
+    }
+    return ERROR_SUCCESS;
+#else
+    return ERROR_NOT_SUPPORTED;
+#endif
+}
+
+bool CASC_IO_RING::PopPending(void ** PtrUserData)
+{
+#if defined(CASCLIB_PLATFORM_LINUX) && defined(CASC_USE_IO_URING)
+    struct io_uring_sqe * pSqe;
+    unsigned Tail = *SqTail - 1;
+
+    // The kernel only consumes the entries in io_uring_enter, so the entries
+    // that were not submitted yet can be removed from the tail of the queue
+    if(SqPending == 0)
+        return false;
+    pSqe = (struct io_uring_sqe *)pvSqes + SqArray[Tail & *SqMask];
+
+    PtrUserData[0] = (void *)(uintptr_t)pSqe->user_data;
+    __atomic_store_n(SqTail, Tail, __ATOMIC_RELEASE);
+    SqPending--;
+    return true;
+#else
+    CASCLIB_UNUSED(PtrUserData);
+    return false;
+#endif
+}
+
+DWORD CASC_IO_RING::Wait(DWORD dwTimeoutMs)
+{
+#if defined(CASCLIB_PLATFORM_LINUX) && defined(CASC_USE_IO_URING)
+    CASC_RING_GETEVENTS_ARG Arg;
+    CASC_RING_TIMESPEC Timeout;
+
+    // Prepare the timeout
+    Timeout.tv_sec = dwTimeoutMs / 1000;
+    Timeout.tv_nsec = (LONGLONG)(dwTimeoutMs % 1000) * 1000000;
+    memset(&Arg, 0, sizeof(CASC_RING_GETEVENTS_ARG));
+    Arg.ts = (ULONGLONG)(uintptr_t)&Timeout;
+
+    // A timeout (ETIME) is not an error. The caller checks the completion queue anyway
+    while(io_uring_enter(RingFd, 0, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &Arg, sizeof(CASC_RING_GETEVENTS_ARG)) < 0)
+    {
+        if(errno == ETIME)
+            break;
+        if(errno != EINTR)
+            return errno;
+    }
+    return ERROR_SUCCESS;
+#else
+    CASCLIB_UNUSED(dwTimeoutMs);
+    return ERROR_NOT_SUPPORTED;
+#endif
+}
+
+bool CASC_IO_RING::PopCompletion(void ** PtrUserData, int * PtrResult)
+{
+#if defined(CASCLIB_PLATFORM_LINUX) && defined(CASC_USE_IO_URING)
+    struct io_uring_cqe * pCqe;
+    unsigned Head = *CqHead;
+
+    // Is there a completion?
+    if(Head == __atomic_load_n(CqTail, __ATOMIC_ACQUIRE))
+        return false;
+    pCqe = (struct io_uring_cqe *)pvCqes + (Head & *CqMask);
+
+    // Give the completion to the caller and release the entry
+    PtrUserData[0] = (void *)(uintptr_t)pCqe->user_data;
+    PtrResult[0] = pCqe->res;
+    __atomic_store_n(CqHead, Head + 1, __ATOMIC_RELEASE);
+    return true;
+#else
+    CASCLIB_UNUSED(PtrUserData);
+    CASCLIB_UNUSED(PtrResult);
+    return false;
+#endif
+}
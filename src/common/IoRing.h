@@ -0,0 +1,87 @@
+/*****************************************************************************/
+/* IoRing.h                               Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Minimal io_uring wrapper for asynchronous positional reads (Linux only)   */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 19.10.26  1.00  Lad  The first version of IoRing.h                        */
+/*****************************************************************************/
+
+#ifndef __CASC_IO_RING_H__
+#define __CASC_IO_RING_H__
+
+//-----------------------------------------------------------------------------
+// Defines
+
+#define CASC_IO_RING_DEFAULT_DEPTH  64              // Default number of submission queue entries
+#define CASC_IO_RING_WAIT_TIMEOUT   10              // Longest wait for a completion, in milliseconds
+
+//-----------------------------------------------------------------------------
+// Structure for io_uring. Only positional reads are supported.
+// The structure is not thread-safe; the caller must serialize all calls
+// except Wait(), which may run concurrently with the others.
+// Without CASC_USE_IO_URING (or on non-Linux platforms), Create() always fails.
+
+struct CASC_IO_RING
+{
+    CASC_IO_RING();
+    ~CASC_IO_RING();
+
+    // Creates the ring. Returns false if io_uring is not available
+    bool Create(DWORD dwEntries);
+    void Free();
+
+    // Queues a read of cbBuffer bytes from the file descriptor. Returns false if the
+    // submission queue is full; call Submit() and try again
+    bool PushRead(HANDLE hFile, void * pvBuffer, DWORD cbBuffer, ULONGLONG ByteOffset, void * pvUserData);
+
+    // Hands the queued reads over to the kernel. Returns ERROR_SUCCESS or an error code
+    DWORD Submit();
+
+    // Takes back the last queued read that was not handed over to the kernel, so that
+    // the caller can fail it when Submit() fails. Returns false if there is no such read
+    bool PopPending(void ** PtrUserData);
+
+    // Waits until at least one completion is available or until the timeout elapses.
+    // Another thread may take the completions meanwhile, so the wait must never be unbounded.
+    // Returns ERROR_SUCCESS (also on timeout) or an error code
+    DWORD Wait(DWORD dwTimeoutMs);
+
+    // Takes one completion from the completion queue. nResult is the number of bytes read
+    // or a negative errno value. Returns false if there is no completion
+    bool PopCompletion(void ** PtrUserData, int * PtrResult);
+
+    bool IsOpen()
+    {
+        return (RingFd != -1);
+    }
+
+    DWORD SqEntries;                                // Number of entries in the submission queue
+    DWORD CqEntries;                                // Number of entries in the completion queue
+
+    protected:
+
+    int RingFd;                                     // File descriptor of the ring
+    DWORD SqPending;                                // Number of SQEs filled but not submitted yet
+
+    // Mapped rings
+    void * pvSqRing;                                // Submission queue ring
+    void * pvCqRing;                                // Completion queue ring (may be the same mapping as pvSqRing)
+    void * pvSqes;                                  // Array of submission queue entries
+    size_t cbSqRing;
+    size_t cbCqRing;
+    size_t cbSqes;
+
+    // Pointers into the mapped rings
+    unsigned * SqHead;
+    unsigned * SqTail;
+    unsigned * SqMask;
+    unsigned * SqArray;
+    unsigned * CqHead;
+    unsigned * CqTail;
+    unsigned * CqMask;
+    void * pvCqes;
+};
+
+#endif // __CASC_IO_RING_H__
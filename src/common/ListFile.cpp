@@ -22,12 +22,17 @@ typedef struct _LISTFILE_CACHE
     char * pBegin;                              // The begin of the listfile cache
     char * pPos;                                // Current position in the cache
     char * pEnd;                                // The last character in the file cache
+    TFileStream * pStream;                      // If not NULL, the cache is the mapped view of this stream
     DWORD Flags;
 
-    // Followed by the cache (variable length)
+    // Followed by the cache (variable length), unless the file is mapped
 
 } LISTFILE_CACHE, *PLISTFILE_CACHE;
 
+// Word-at-a-time scanning for the line end characters
+#define LISTFILE_SWAR_ONES      0x0101010101010101ULL
+#define LISTFILE_SWAR_HIGHS     0x8080808080808080ULL
+
 //-----------------------------------------------------------------------------
 // Creating the listfile cache for the given amount of data
 
@@ -43,6 +48,7 @@ static PLISTFILE_CACHE ListFile_CreateCache(DWORD dwFileSize)
         pCache->pBegin =
         pCache->pPos   = (char *)(pCache + 1);
         pCache->pEnd   = pCache->pBegin + dwFileSize;
+        pCache->pStream = NULL;
         pCache->Flags  = 0;
     }
 
@@ -50,6 +56,59 @@ static PLISTFILE_CACHE ListFile_CreateCache(DWORD dwFileSize)
     return pCache;
 }
 
+// Creates the listfile cache over the mapped view of the file
+static PLISTFILE_CACHE ListFile_CreateMappedCache(TFileStream * pStream)
+{
+    PLISTFILE_CACHE pCache = NULL;
+    ULONGLONG FileSize = 0;
+    LPBYTE pbFileView;
+
+    pbFileView = FileStream_GetMappedView(pStream, &FileSize);
+    if(pbFileView != NULL && 0 < FileSize && FileSize <= 0x30000000)
+    {
+        pCache = (PLISTFILE_CACHE)CASC_ALLOC<BYTE>(sizeof(LISTFILE_CACHE));
+        if(pCache != NULL)
+        {
+            // The cache only points to the view. Parsing functions never write to it
+            pCache->pBegin =
+            pCache->pPos   = (char *)pbFileView;
+            pCache->pEnd   = pCache->pBegin + (size_t)FileSize;
+            pCache->pStream = pStream;
+            pCache->Flags  = 0;
+        }
+    }
+
+    return pCache;
+}
+
+// Returns nonzero if any byte of the 64-bit word is equal to the given character
+static inline ULONGLONG ListFile_HasByte(ULONGLONG Word, BYTE OneByte)
+{
+    ULONGLONG Value = Word ^ (LISTFILE_SWAR_ONES * OneByte);
+
+    return (Value - LISTFILE_SWAR_ONES) & ~Value & LISTFILE_SWAR_HIGHS;
+}
+
+static char * ListFile_FindLineEnd(char * szPtr, char * szEnd)
+{
+    ULONGLONG Word;
+
+    // Skip 8 characters at once until we find a word that may contain a line end
+    // Note: the 0x85 char came from Overwatch build 24919
+    while((szPtr + sizeof(ULONGLONG)) <= szEnd)
+    {
+        memcpy(&Word, szPtr, sizeof(ULONGLONG));
+        if(ListFile_HasByte(Word, 0x0A) | ListFile_HasByte(Word, 0x0D) | ListFile_HasByte(Word, 0x85))
+            break;
+        szPtr += sizeof(ULONGLONG);
+    }
+
+    // Find the exact position
+    while(szPtr < szEnd && szPtr[0] != '\x0A' && szPtr[0] != '\x0D' && szPtr[0] != '\x85')
+        szPtr++;
+    return szPtr;
+}
+
 static char * ListFile_SkipSpaces(PLISTFILE_CACHE pCache)
 {
     // Skip newlines, spaces, tabs and another non-printable stuff
@@ -127,6 +186,18 @@ void * ListFile_OpenExternal(LPCTSTR szListFile)
     TFileStream * pStream;
     ULONGLONG FileSize = 0;
 
+    // Try to map the listfile into memory first. This saves reading and copying the entire file
+    pStream = FileStream_OpenFile(szListFile, STREAM_FLAG_READ_ONLY | BASE_PROVIDER_MAP);
+    if(pStream != NULL)
+    {
+        if((pCache = ListFile_CreateMappedCache(pStream)) != NULL)
+        {
+            ListFile_CheckFormat(pCache);
+            return pCache;
+        }
+        FileStream_Close(pStream);
+    }
+
     // Open the external listfile
     pStream = FileStream_OpenFile(szListFile, STREAM_FLAG_READ_ONLY);
     if(pStream != NULL)
@@ -189,30 +260,20 @@ size_t ListFile_GetNextLine(void * pvListFile, const char ** pszLineBegin, const
     char * szExtraString = NULL;
     char * szLineBegin;
     char * szLineEnd;
+    char * szTilde;
 
     // Skip newlines, spaces, tabs and another non-printable stuff
     // Remember the begin of the line
     szLineBegin = ListFile_SkipSpaces(pCache);
+    pCache->pPos = ListFile_FindLineEnd(szLineBegin, pCache->pEnd);
 
-    // Copy the remaining characters
-    while(pCache->pPos < pCache->pEnd)
-    {
-        // If we have found a newline, stop loading
-        // Note: the 0x85 char came from Overwatch build 24919
-        if(pCache->pPos[0] == '\x0A' || pCache->pPos[0] == '\x0D' || pCache->pPos[0] == '\x85')
-            break;
-
-        // Blizzard listfiles can also contain information about patch:
-        // Pass1\Files\MacOS\unconditional\user\Background Downloader.app\Contents\Info.plist~Patch(Data#frFR#base-frFR,1326)
-        if(pCache->pPos[0] == '~')
-            szExtraString = pCache->pPos;
-
-        // Move the position by one character forward
-        pCache->pPos++;
-    }
+    // Blizzard listfiles can also contain information about patch:
+    // Pass1\Files\MacOS\unconditional\user\Background Downloader.app\Contents\Info.plist~Patch(Data#frFR#base-frFR,1326)
+    for(szTilde = szLineBegin; (szTilde = (char *)memchr(szTilde, '~', pCache->pPos - szTilde)) != NULL; szTilde++)
+        szExtraString = szTilde;
 
     // Remember the end of the line
-    szLineEnd = (szExtraString != NULL && szExtraString[0] == '~' && szExtraString[1] == 'P') ? szExtraString : pCache->pPos;
+    szLineEnd = (szExtraString != NULL && (szExtraString + 1) < pCache->pPos && szExtraString[1] == 'P') ? szExtraString : pCache->pPos;
 
     // Give the caller the positions of the begin and end of the line
     pszLineBegin[0] = szLineBegin;
@@ -296,6 +357,52 @@ size_t ListFile_GetNext(void * pvListFile, char * szBuffer, size_t nMaxChars, PD
     return nLength;
 }
 
+size_t ListFile_GetNext(void * pvListFile, const char ** pszLineBegin, const char ** pszLineEnd, PDWORD PtrFileDataId)
+{
+    PLISTFILE_CACHE pCache = (PLISTFILE_CACHE)pvListFile;
+    const char * szTemp;
+    size_t nLength;
+    DWORD dwErrCode;
+
+    for(;;)
+    {
+        DWORD FileDataId = CASC_INVALID_ID;
+
+        // If this is a CSV-format listfile, we need to extract the FileDataId
+        // Lines that contain bogus data, invalid numbers or too big values will be skipped
+        if(pCache->Flags & LISTFILE_FLAG_USES_FILEDATAID)
+        {
+            dwErrCode = ListFile_GetFileDataId(pCache, &FileDataId);
+            if(dwErrCode == ERROR_NO_MORE_FILES)
+                return 0;
+
+            if(dwErrCode != ERROR_SUCCESS || FileDataId == CASC_INVALID_ID)
+            {
+                ListFile_GetNextLine(pvListFile, &szTemp, &szTemp);
+                continue;
+            }
+        }
+
+        // Retrieve the line in-place. Zero length means the end of the listfile
+        nLength = ListFile_GetNextLine(pvListFile, pszLineBegin, pszLineEnd);
+        PtrFileDataId[0] = FileDataId;
+        return nLength;
+    }
+}
+
+void ListFile_Free(void * pvListFile)
+{
+    PLISTFILE_CACHE pCache = (PLISTFILE_CACHE)pvListFile;
+
+    if(pCache != NULL)
+    {
+        // Mapped listfiles need the stream to be closed too
+        if(pCache->pStream != NULL)
+            FileStream_Close(pCache->pStream);
+        CASC_FREE(pCache);
+    }
+}
+
 LPBYTE ListFile_GetData(void * pvListFile, PDWORD PtrDataSize)
 {
     PLISTFILE_CACHE pCache = (PLISTFILE_CACHE)pvListFile;
@@ -20,6 +20,8 @@ bool   ListFile_VerifyMD5(void * pvListFile, LPBYTE pbHashMD5);
 size_t ListFile_GetNextLine(void * pvListFile, const char ** pszLineBegin, const char ** pszLineEnd);
 size_t ListFile_GetNextLine(void * pvListFile, char * szBuffer, size_t nMaxChars);
 size_t ListFile_GetNext(void * pvListFile, char * szBuffer, size_t nMaxChars, PDWORD PtrFileDataId);
+size_t ListFile_GetNext(void * pvListFile, const char ** pszLineBegin, const char ** pszLineEnd, PDWORD PtrFileDataId);
 LPBYTE ListFile_GetData(void * pvListFile, PDWORD PtrDataSize);
+void   ListFile_Free(void * pvListFile);
 
 #endif // __LISTFILE_H__
@@ -133,7 +133,8 @@ class CASC_MAP
         return (m_HashTable != NULL) ? ERROR_SUCCESS : ERROR_NOT_ENOUGH_MEMORY;
     }
 
-    void * FindObject(void * pvKey, PDWORD PtrIndex = NULL)
+    // If PtrProbes is not NULL, the number of probed hash table items is added to it
+    void * FindObject(void * pvKey, PDWORD PtrIndex = NULL, PULONGLONG PtrProbes = NULL)
     {
         void * pvObject;
         DWORD dwHashIndex;
@@ -147,6 +148,9 @@ class CASC_MAP
             // Search the hash table
             while((pvObject = m_HashTable[dwHashIndex]) != NULL)
             {
+                if(PtrProbes != NULL)
+                    PtrProbes[0]++;
+
                 // Compare the hash
                 if(CompareObject_Key(pvObject, pvKey))
                 {
@@ -164,6 +168,29 @@ class CASC_MAP
         return NULL;
     }
 
+    // Batched lookups first prefetch the hash table slots of all keys,
+    // then the objects in the slots, and only then call FindObject
+    void PrefetchSlot(void * pvKey)
+    {
+        if(m_HashTable != NULL && PfnCalcHashValue != NULL)
+        {
+            CASC_PREFETCH(&m_HashTable[HashToIndex(PfnCalcHashValue(pvKey, m_KeyLength))]);
+        }
+    }
+
+    void PrefetchObject(void * pvKey)
+    {
+        void * pvObject;
+
+        if(m_HashTable != NULL && PfnCalcHashValue != NULL)
+        {
+            if((pvObject = m_HashTable[HashToIndex(PfnCalcHashValue(pvKey, m_KeyLength))]) != NULL)
+            {
+                CASC_PREFETCH((LPBYTE)pvObject + m_KeyOffset);
+            }
+        }
+    }
+
     bool InsertObject(void * pvNewObject, void * pvKey)
     {
         void * pvExistingObject;
@@ -270,6 +297,37 @@ class CASC_MAP
         return false;
     }
 
+    // Stores the hash table as 1-based indexes of the objects in an array; zero is an empty slot.
+    // All objects must be items of the array.
+    void SaveIndexes(PDWORD Indexes, const void * pvItemArray, size_t ItemSize)
+    {
+        for(size_t i = 0; i < m_HashTableSize; i++)
+        {
+            size_t ByteOffset = (LPBYTE)m_HashTable[i] - (LPBYTE)pvItemArray;
+            Indexes[i] = (m_HashTable[i] != NULL) ? (DWORD)(ByteOffset / ItemSize) + 1 : 0;
+        }
+    }
+
+    // Fills the hash table from the output of SaveIndexes. The map must be created
+    // with the same hash table size. Returns false if an index is beyond the array
+    bool LoadIndexes(const DWORD * Indexes, void * pvItemArray, size_t ItemSize, size_t ItemCount)
+    {
+        m_ItemCount = 0;
+        for(size_t i = 0; i < m_HashTableSize; i++)
+        {
+            if(Indexes[i] > ItemCount)
+            {
+                memset(m_HashTable, 0, m_HashTableSize * sizeof(void *));
+                m_ItemCount = 0;
+                return false;
+            }
+
+            m_HashTable[i] = (Indexes[i] != 0) ? (LPBYTE)pvItemArray + (Indexes[i] - 1) * ItemSize : NULL;
+            m_ItemCount += (Indexes[i] != 0) ? 1 : 0;
+        }
+        return true;
+    }
+
     void * ItemAt(size_t nIndex)
     {
         assert(nIndex < m_HashTableSize);
@@ -360,21 +418,59 @@ class CASC_MAP
 // Maximum length of encryption key
 #define CASC_KEY_LENGTH         0x10
 #define CASC_KEY_TABLE_SIZE     0x100
-#define CASC_KEY_TABLE_MASK     (CASC_KEY_TABLE_SIZE - 1)
 
+// Encryption key
+struct CASC_ENCRYPTION_KEY
+{
+    ULONGLONG KeyName;                          // "Name" of the key. Zero is not a valid key name
+    BYTE Key[CASC_KEY_LENGTH];                  // The key itself
+};
+typedef CASC_ENCRYPTION_KEY * PCASC_ENCRYPTION_KEY;
+
+// Open-addressed table of keys. Tables are never freed while the map exists,
+// so a key found in any table stays valid until the map is destroyed
+struct CASC_KEY_TABLE
+{
+    CASC_KEY_TABLE * pPrevTable;                // Previous (smaller) table
+    size_t TableSize;                           // Number of slots. Always a power of two
+    CASC_ENCRYPTION_KEY Keys[1];                // Array of slots. Free slots have KeyName of zero
+};
+
+// Map of encryption keys. The keys known to CascLib are in a perfect hash table
+// shared by all storages; keys added at runtime go to an open-addressed table.
+// FindKey doesn't lock and can run concurrently with AddKey
 class CASC_KEY_MAP
 {
     public:
 
-    CASC_KEY_MAP();
+    CASC_KEY_MAP(CASC_ARENA * pNewArena = NULL);
     ~CASC_KEY_MAP();
 
+    DWORD LoadStaticKeys();
+    PCASC_ENCRYPTION_KEY FindKeyItem(ULONGLONG KeyName);
     LPBYTE FindKey(ULONGLONG KeyName);
     bool AddKey(ULONGLONG KeyName, LPBYTE Key);
 
+    // Returns true if the static keys are searched through the perfect hash
+    bool HasStaticKeys()
+    {
+        return bStaticKeys;
+    }
+
+    // Returns the table of the keys known to CascLib. A key name may be there more than once
+    static PCASC_ENCRYPTION_KEY GetStaticKeys(size_t & nKeyCount);
+
     protected:
 
-    void * HashTable[CASC_KEY_TABLE_SIZE];
+    PCASC_ENCRYPTION_KEY FindRuntimeKey(ULONGLONG KeyName);
+    CASC_KEY_TABLE * CreateTable(size_t TableSize);
+    bool EnlargeTable();
+
+    CASC_KEY_TABLE * volatile pTable;           // Current table of the keys added at runtime
+    size_t ItemCount;                           // Number of keys in the current table
+    CASC_ARENA * pArena;                        // If not NULL, the tables are allocated from this arena
+    CASC_LOCK Lock;                             // Serializes the AddKey calls
+    bool bStaticKeys;                           // If true, the static keys are searched too
 };
 
 #endif // __CASC_MAP_H__
@@ -62,6 +62,7 @@ bool CASC_MIME_HTTP::IsDataComplete(const char * response, size_t response_lengt
                     {
                         // Fill the HTTP info cache
                         response_valid = 0x48545450;    // 'HTTP'
+                        status_code = DecodeValueInt32(response + 9, content_begin_ptr);
                         content_offset = (content_begin_ptr + 4) - response;
                         content_length = DecodeValueInt32(content_length_ptr + 16, content_begin_ptr);
                         total_length = content_offset + content_length;
@@ -174,9 +175,12 @@ DWORD CASC_MIME_ELEMENT::Load(char * mime_data_begin, char * mime_data_end, cons
     bool mime_version = false;
 
     // Diversion for HTTP: No need to parse the entire headers and stuff.
-    // Just give the data right away
+    // Just give the data right away ("206 Partial Content" is the response to a range request). Error responses (like "404 Not Found") and responses
+    // cut by a closed connection must not be taken as the file data
     if(HttpInfo.IsDataComplete(mime_data_begin, (mime_data_end - mime_data_begin)))
     {
+        if(HttpInfo.status_code != 200 && HttpInfo.status_code != 206)
+            return (HttpInfo.status_code == 404) ? ERROR_FILE_NOT_FOUND : ERROR_CAN_NOT_COMPLETE;
         if((data.begin = CASC_ALLOC<BYTE>(HttpInfo.content_length)) == NULL)
             return ERROR_NOT_ENOUGH_MEMORY;
         
@@ -185,6 +189,10 @@ DWORD CASC_MIME_ELEMENT::Load(char * mime_data_begin, char * mime_data_end, cons
         return ERROR_SUCCESS;
     }
 
+    // HTTP response with less data than "Content-Length" says
+    if(HttpInfo.response_valid != 0)
+        return ERROR_HANDLE_EOF;
+
     // Reset the boundary
     boundary[0] = 0;
 
@@ -31,12 +31,13 @@ struct CASC_MIME_HTTP
 {
     CASC_MIME_HTTP()
     {
-        response_valid = content_length = content_offset = total_length = 0;
+        response_valid = status_code = content_length = content_offset = total_length = 0;
     }
 
     bool IsDataComplete(const char * response, size_t response_length);
 
     size_t response_valid;              // Nonzero if this is an already parsed HTTP response
+    size_t status_code;                 // HTTP status code, e.g. 200 for "HTTP/1.1 200 OK"
     size_t content_length;              // Parsed value of "Content-Length"
     size_t content_offset;              // Offset of the HTTP data, relative to the begin of the response
     size_t total_length;                // Expected total length of the HTTP response (content_offset + content_size)
@@ -0,0 +1,87 @@
+/*****************************************************************************/
+/* PerfCounters.cpp                       Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Per-storage performance counters                                          */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 19.10.26  1.00  Lad  The first version of PerfCounters.cpp                */
+/*****************************************************************************/
+
+#define __CASCLIB_SELF__
+#include "../CascLib.h"
+#include "../CascCommon.h"
+
+//-----------------------------------------------------------------------------
+// CASC_PERF_COUNTERS
+
+DWORD CASC_PERF_COUNTERS::Create()
+{
+    // Already created?
+    if(pbSlots == NULL)
+    {
+        if((pbSlots = CASC_ALLOC_ZERO<BYTE>(CASC_PERF_SLOT_COUNT * CASC_PERF_SLOT_SIZE)) == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+    }
+    return ERROR_SUCCESS;
+}
+
+void CASC_PERF_COUNTERS::Free()
+{
+    CASC_FREE(pbSlots);
+    pbSlots = NULL;
+}
+
+void CASC_PERF_COUNTERS::Collect(PCASC_STORAGE_PERF_COUNTERS pCounters)
+{
+    ULONGLONG * PtrOutput = (ULONGLONG *)pCounters;
+    size_t nCounterCount = sizeof(CASC_STORAGE_PERF_COUNTERS) / sizeof(ULONGLONG);
+
+    memset(pCounters, 0, sizeof(CASC_STORAGE_PERF_COUNTERS));
+    if(pbSlots != NULL)
+    {
+        for(size_t i = 0; i < CASC_PERF_SLOT_COUNT; i++)
+        {
+            ULONGLONG * PtrSlot = (ULONGLONG *)(pbSlots + i * CASC_PERF_SLOT_SIZE);
+
+            for(size_t j = 0; j < nCounterCount; j++)
+                PtrOutput[j] += PtrSlot[j];
+        }
+    }
+}
+
+size_t CASC_PERF_COUNTERS::GetSlotIndex()
+{
+    size_t ThreadId;
+
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    ThreadId = GetCurrentThreadId();
+#else
+    ThreadId = (size_t)pthread_self();
+#endif
+
+    // Thread IDs are often aligned. Mix the bits before taking the slot index
+    ThreadId = ThreadId ^ (ThreadId >> 7) ^ (ThreadId >> 13);
+    return ThreadId % CASC_PERF_SLOT_COUNT;
+}
+
+//-----------------------------------------------------------------------------
+// Public functions
+
+ULONGLONG CascPerfGetTime()
+{
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    static LARGE_INTEGER Frequency = {0};
+    LARGE_INTEGER Counter;
+
+    if(Frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Counter);
+    return (ULONGLONG)((Counter.QuadPart / Frequency.QuadPart) * 1000000 + ((Counter.QuadPart % Frequency.QuadPart) * 1000000) / Frequency.QuadPart);
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ULONGLONG)ts.tv_sec * 1000000 + (ts.tv_nsec / 1000);
+#endif
+}
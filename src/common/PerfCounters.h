@@ -0,0 +1,88 @@
+/*****************************************************************************/
+/* PerfCounters.h                         Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Per-storage performance counters                                          */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 19.10.26  1.00  Lad  The first version of PerfCounters.h                  */
+/*****************************************************************************/
+
+#ifndef __CASC_PERF_COUNTERS_H__
+#define __CASC_PERF_COUNTERS_H__
+
+//-----------------------------------------------------------------------------
+// Defines
+
+#define CASC_PERF_SLOT_COUNT    16                  // Number of accumulator slots. Threads are spread over them
+#define CASC_PERF_SLOT_SIZE     ALIGN_TO_SIZE(sizeof(CASC_STORAGE_PERF_COUNTERS), 64)
+
+// Index of the counter within CASC_STORAGE_PERF_COUNTERS
+#define CASC_PERF_INDEX(Counter) (FIELD_OFFSET(CASC_STORAGE_PERF_COUNTERS, Counter) / sizeof(ULONGLONG))
+
+//-----------------------------------------------------------------------------
+// Structure for collecting the counters. Each thread adds to one slot,
+// so that concurrent readers don't fight for the same cache line.
+// If not enabled, adding to counters is just one pointer check
+
+struct CASC_PERF_COUNTERS
+{
+    CASC_PERF_COUNTERS()
+    {
+        pbSlots = NULL;
+    }
+
+    ~CASC_PERF_COUNTERS()
+    {
+        Free();
+    }
+
+    DWORD Create();
+    void Free();
+
+    // Sums the slots into one structure
+    void Collect(PCASC_STORAGE_PERF_COUNTERS pCounters);
+
+    void Add(size_t nCounter, ULONGLONG Value)
+    {
+        if(pbSlots != NULL)
+        {
+            ULONGLONG * PtrSlot = (ULONGLONG *)(pbSlots + GetSlotIndex() * CASC_PERF_SLOT_SIZE);
+            CascInterlockedAdd64(PtrSlot + nCounter, Value);
+        }
+    }
+
+    bool IsEnabled()
+    {
+        return (pbSlots != NULL);
+    }
+
+    protected:
+
+    static size_t GetSlotIndex();
+
+    LPBYTE pbSlots;                                 // Array of CASC_PERF_SLOT_COUNT slots, CASC_PERF_SLOT_SIZE each
+};
+
+//-----------------------------------------------------------------------------
+// Functions
+
+// Returns monotonic time in microseconds
+ULONGLONG CascPerfGetTime();
+
+//-----------------------------------------------------------------------------
+// Macros for updating the counters. With CASC_NO_PERF_COUNTERS,
+// they all compile to nothing. The statement macros are wrapped in do-while,
+// so that they are safe in an unbraced if-else
+
+#ifndef CASC_NO_PERF_COUNTERS
+#define CASC_PERF_ADD(hs, Counter, Value)   (hs)->PerfCounters.Add(CASC_PERF_INDEX(Counter), (Value))
+#define CASC_PERF_START(hs)                 ((hs)->PerfCounters.IsEnabled() ? CascPerfGetTime() : 0)
+#define CASC_PERF_STOP(hs, Counter, Start)  do { if((hs)->PerfCounters.IsEnabled()) (hs)->PerfCounters.Add(CASC_PERF_INDEX(Counter), CascPerfGetTime() - (Start)); } while(0)
+#else
+#define CASC_PERF_ADD(hs, Counter, Value)   do { } while(0)
+#define CASC_PERF_START(hs)                 0
+#define CASC_PERF_STOP(hs, Counter, Start)  do { CASCLIB_UNUSED(Start); } while(0)
+#endif
+
+#endif // __CASC_PERF_COUNTERS_H__
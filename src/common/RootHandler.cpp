@@ -28,6 +28,185 @@ TFileTreeRoot::~TFileTreeRoot()
     dwFeatures = 0;
 }
 
+//-----------------------------------------------------------------------------
+// Search context - TFileTreeRoot
+
+#define FOLDER_STATE_UNKNOWN    0                   // The folder hasn't been checked against the mask yet
+#define FOLDER_STATE_COVERED    1                   // The folder path starts with the directory part of the mask. So do all subfolders
+#define FOLDER_STATE_PARTIAL    2                   // The folder path is a part of the directory part of the mask. Its files can't match
+#define FOLDER_STATE_PRUNED     3                   // No file in the folder or its subfolders can match the mask
+
+struct TFileTreeSearch
+{
+    TFileTreeSearch(CASC_MASK & SearchMask, size_t nNodeCount) : Mask(SearchMask)
+    {
+        // Allocate the array of folder states. If this fails, we simply won't prune
+        FolderStates = (Mask.GetDirectoryLength() != 0) ? CASC_ALLOC_ZERO<BYTE>(nNodeCount) : NULL;
+        nFolderStates = (FolderStates != NULL) ? nNodeCount : 0;
+
+        ParentIndex = CASC_INVALID_INDEX;
+        nParentLength = 0;
+        szPath[0] = 0;
+    }
+
+    ~TFileTreeSearch()
+    {
+        CASC_FREE(FolderStates);
+    }
+
+    CASC_MASK & Mask;                               // Compiled search mask (owned by TCascSearch)
+    char szPath[MAX_PATH];                          // Path of the last parent folder, including the trailing separator
+    size_t nParentLength;                           // Length of the parent folder path
+    DWORD ParentIndex;                              // Node index of the folder whose path is in szPath
+    LPBYTE FolderStates;                            // Per-folder result of the directory prefix check. See FOLDER_STATE_XXX
+    size_t nFolderStates;                           // Number of items in FolderStates
+};
+
+// Compares the folder path in szPath with the directory part of the mask
+static BYTE CheckFolderPath(TFileTreeSearch * pContext)
+{
+    const char * szNormMask = pContext->Mask.GetNormMask();
+    size_t nDirectoryLength = pContext->Mask.GetDirectoryLength();
+    size_t nCompareLength = CASCLIB_MIN(pContext->nParentLength, nDirectoryLength);
+
+    for(size_t i = 0; i < nCompareLength; i++)
+    {
+        if(AsciiToUpperTable_BkSlash[(BYTE)pContext->szPath[i]] != (BYTE)szNormMask[i])
+            return FOLDER_STATE_PRUNED;
+    }
+
+    // A file name never contains a path separator, so the files in a folder
+    // can only match if the folder path contains the entire directory part of the mask
+    return (pContext->nParentLength >= nDirectoryLength) ? FOLDER_STATE_COVERED : FOLDER_STATE_PARTIAL;
+}
+
+// Retrieves the state of the folder. Subfolders of covered or pruned folders
+// get the state of the parent without building their path
+static BYTE GetFolderState(CASC_FILE_TREE & FileTree, TFileTreeSearch * pContext, DWORD FolderIndex)
+{
+    PCASC_FILE_NODE pFolderNode;
+    BYTE FolderState;
+
+    // Without the array of states, we can't tell
+    if(FolderIndex >= pContext->nFolderStates)
+        return FOLDER_STATE_UNKNOWN;
+    if((FolderState = pContext->FolderStates[FolderIndex]) != FOLDER_STATE_UNKNOWN)
+        return FolderState;
+
+    // Inherit the state of the parent folder
+    pFolderNode = FileTree.ItemAt(FolderIndex);
+    if(pFolderNode->Parent != CASC_INVALID_INDEX && pFolderNode->Parent != FolderIndex)
+        FolderState = GetFolderState(FileTree, pContext, pFolderNode->Parent);
+
+    // Partial folder or no parent: compare the path
+    if(FolderState != FOLDER_STATE_COVERED && FolderState != FOLDER_STATE_PRUNED)
+    {
+        pContext->nParentLength = FileTree.PathAt(pContext->szPath, MAX_PATH, pFolderNode);
+        pContext->ParentIndex = FolderIndex;
+        FolderState = CheckFolderPath(pContext);
+    }
+
+    pContext->FolderStates[FolderIndex] = FolderState;
+    return FolderState;
+}
+
+static bool BuildSearchPath(CASC_FILE_TREE & FileTree, TFileTreeSearch * pContext, PCASC_FILE_NODE pFileNode, char * szBuffer)
+{
+    const char * szNodeName;
+    DWORD Parent = pFileNode->Parent;
+    BYTE FolderState;
+
+    // Nodes without name (inserted by hash or file data id) have an empty path
+    if((szNodeName = FileTree.NameAt(pFileNode)) == NULL)
+    {
+        szBuffer[0] = 0;
+        return true;
+    }
+
+    // Skip the files whose folder can't match the mask
+    FolderState = GetFolderState(FileTree, pContext, Parent);
+    if(FolderState == FOLDER_STATE_PRUNED || FolderState == FOLDER_STATE_PARTIAL)
+        return false;
+
+    // Build the parent path only when the parent folder changed
+    if(Parent != pContext->ParentIndex)
+    {
+        pContext->nParentLength = FileTree.PathAt(pContext->szPath, MAX_PATH, FileTree.ItemAt(Parent));
+        pContext->ParentIndex = Parent;
+
+        // If we have no folder states, we have to check the path here
+        if(FolderState == FOLDER_STATE_UNKNOWN && pContext->Mask.GetDirectoryLength() != 0 && CheckFolderPath(pContext) != FOLDER_STATE_COVERED)
+        {
+            pContext->ParentIndex = CASC_INVALID_INDEX;
+            return false;
+        }
+    }
+
+    // Append the plain name to the cached parent path. Let PathAt deal with overlong names
+    if((pContext->nParentLength + pFileNode->NameLength) >= (MAX_PATH - 1))
+    {
+        FileTree.PathAt(szBuffer, MAX_PATH, pFileNode);
+        return true;
+    }
+    memcpy(szBuffer, pContext->szPath, pContext->nParentLength);
+    memcpy(szBuffer + pContext->nParentLength, szNodeName, pFileNode->NameLength);
+    szBuffer[pContext->nParentLength + pFileNode->NameLength] = 0;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// Applying an external listfile - TFileTreeRoot
+
+#define LISTFILE_BATCH_SIZE     0x10000             // Number of listfile entries parsed at once
+#define LISTFILE_CHUNK_SIZE     0x1000              // Number of listfile entries resolved by one worker item
+
+typedef struct _LISTFILE_ENTRY
+{
+    const char * szFileName;                        // Begin of the name in the listfile (not zero terminated)
+    size_t cchFileName;                             // Length of the name
+    ULONGLONG FileNameHash;                         // Hash of the normalized name
+    DWORD FileDataId;                               // FileDataId from the listfile, or CASC_INVALID_ID
+    DWORD NodeIndex;                                // Index of the nameless node that gets the name, or CASC_INVALID_INDEX
+} LISTFILE_ENTRY, *PLISTFILE_ENTRY;
+
+struct TListFileContext
+{
+    PCASC_FILE_TREE pFileTree;
+    CASC_ARRAY * pEntries;
+};
+
+// Hashes the names and finds their nodes. The file tree is not modified here,
+// so any number of workers can run on it at once
+static DWORD ResolveListFileWorker(void * pvContext, size_t nItemIndex)
+{
+    TListFileContext * pContext = (TListFileContext *)pvContext;
+    PCASC_FILE_NODE pFileNode;
+    PLISTFILE_ENTRY pEntry;
+    size_t nEntry = nItemIndex * LISTFILE_CHUNK_SIZE;
+    size_t nEndEntry = CASCLIB_MIN(nEntry + LISTFILE_CHUNK_SIZE, pContext->pEntries->ItemCount());
+    char szNormName[MAX_PATH];
+
+    for(; nEntry < nEndEntry; nEntry++)
+    {
+        pEntry = (PLISTFILE_ENTRY)pContext->pEntries->ItemAt(nEntry);
+
+        // Calculate the hash of the normalized name
+        for(size_t i = 0; i < pEntry->cchFileName; i++)
+            szNormName[i] = AsciiToUpperTable_BkSlash[(BYTE)pEntry->szFileName[i]];
+        pEntry->FileNameHash = CalcNormNameHash(szNormName, pEntry->cchFileName);
+
+        // Find the node by file data id first, then by name hash
+        pFileNode = pContext->pFileTree->FindById(pEntry->FileDataId);
+        if(pFileNode == NULL)
+            pFileNode = pContext->pFileTree->Find(pEntry->FileNameHash);
+
+        // Only nodes without name are interesting
+        pEntry->NodeIndex = (pFileNode != NULL && pFileNode->NameLength == 0) ? (DWORD)pContext->pFileTree->IndexOf(pFileNode) : CASC_INVALID_INDEX;
+    }
+
+    return ERROR_SUCCESS;
+}
+
 //-----------------------------------------------------------------------------
 // Virtual functions - TFileTreeRoot
 
@@ -58,32 +237,72 @@ PCASC_CKEY_ENTRY TFileTreeRoot::GetFile(TCascStorage * /* hs */, DWORD FileDataI
     return (pFileNode != NULL) ? pFileNode->pCKeyEntry : NULL;
 }
 
+void TFileTreeRoot::GetFiles(TCascStorage * /* hs */, const char ** FileNames, PCASC_CKEY_ENTRY * CKeyEntries, size_t nCount)
+{
+    PCASC_FILE_NODE FileNodes[CASC_RESOLVE_BATCH];
+    ULONGLONG FileNameHashes[CASC_RESOLVE_BATCH];
+
+    // Hash the names and look them up in batches that fit on the stack
+    for(size_t nStart = 0; nStart < nCount; nStart += CASC_RESOLVE_BATCH)
+    {
+        size_t nBatch = CASCLIB_MIN(nCount - nStart, CASC_RESOLVE_BATCH);
+
+        CalcFileNameHashes(FileNames + nStart, FileNameHashes, nBatch);
+        FileTree.FindMany(FileNameHashes, FileNodes, nBatch);
+
+        for(size_t i = 0; i < nBatch; i++)
+        {
+            CKeyEntries[nStart + i] = (FileNodes[i] != NULL) ? FileNodes[i]->pCKeyEntry : NULL;
+        }
+    }
+}
+
 PCASC_CKEY_ENTRY TFileTreeRoot::Search(TCascSearch * pSearch, PCASC_FIND_DATA pFindData)
 {
+    TFileTreeSearch * pContext = (TFileTreeSearch *)pSearch->pTreeContext;
     PCASC_FILE_NODE pFileNode;
     size_t nMaxFileIndex = FileTree.GetMaxFileIndex();
 
+    // Create the search context on the first call. Must be done after the root handler
+    // has applied the listfile, because that may have created new folder nodes
+    if(pContext == NULL)
+    {
+        pSearch->pTreeContext = pContext = new TFileTreeSearch(pSearch->Mask, FileTree.GetCount());
+        if(pContext == NULL)
+            return NULL;
+    }
+
     // Are we still inside the root directory range?
     while(pSearch->nFileIndex < nMaxFileIndex)
     {
-        //BREAKIF(pSearch->nFileIndex >= 2823765);
-
         // Retrieve the file item
-        pFileNode = FileTree.PathAt(pFindData->szFileName, MAX_PATH, pSearch->nFileIndex++);
+        pFileNode = FileTree.FileAt(pSearch->nFileIndex++);
         if(pFileNode != NULL)
         {
             // Ignore folders and mount points
             if(!(pFileNode->Flags & CFN_FLAG_FOLDER))
             {
-                // Check the wildcard
-                if (CascCheckWildCard(pFindData->szFileName, pSearch->szMask))
+                // If the caller doesn't want names, we don't need to build the path at all
+                if(pSearch->bNoFileNames && pSearch->Mask.IsMatchAll())
                 {
-                    // Retrieve the extra values (FileDataId, file size and locale flags)
-                    FileTree.GetExtras(pFileNode, &pFindData->dwFileDataId, &pFindData->dwLocaleFlags, &pFindData->dwContentFlags);
+                    pFindData->szFileName[0] = 0;
+                }
+                else
+                {
+                    // Skip the files whose folder can't match the mask
+                    if(!BuildSearchPath(FileTree, pContext, pFileNode, pFindData->szFileName))
+                        continue;
 
-                    // Return the found CKey entry
-                    return pFileNode->pCKeyEntry;
+                    // Check the wildcard
+                    if(!pSearch->Mask.Check(pFindData->szFileName))
+                        continue;
                 }
+
+                // Retrieve the extra values (FileDataId, file size and locale flags)
+                FileTree.GetExtras(pFileNode, &pFindData->dwFileDataId, &pFindData->dwLocaleFlags, &pFindData->dwContentFlags);
+
+                // Return the found CKey entry
+                return pFileNode->pCKeyEntry;
             }
         }
     }
@@ -92,6 +311,78 @@ PCASC_CKEY_ENTRY TFileTreeRoot::Search(TCascSearch * pSearch, PCASC_FIND_DATA pF
     return NULL;
 }
 
+void TFileTreeRoot::EndSearch(TCascSearch * pSearch)
+{
+    delete (TFileTreeSearch *)pSearch->pTreeContext;
+    pSearch->pTreeContext = NULL;
+}
+
+DWORD TFileTreeRoot::ApplyListFile(TCascStorage * /* hs */, void * pvListFile)
+{
+    TListFileContext Context;
+    PCASC_FILE_NODE pFileNode;
+    PLISTFILE_ENTRY pEntry;
+    CASC_ARRAY Entries;
+    const char * szLineBegin;
+    const char * szLineEnd;
+    size_t nLength = 0;
+    DWORD FileDataId = CASC_INVALID_ID;
+    DWORD dwErrCode;
+
+    // Create the array for one batch of names
+    if((dwErrCode = Entries.Create<LISTFILE_ENTRY>(LISTFILE_BATCH_SIZE)) != ERROR_SUCCESS)
+        return dwErrCode;
+    Context.pFileTree = &FileTree;
+    Context.pEntries = &Entries;
+
+    do
+    {
+        // Split the next part of the listfile to names. The names stay in the listfile buffer
+        Entries.Reset();
+        while(Entries.ItemCount() < LISTFILE_BATCH_SIZE)
+        {
+            if((nLength = ListFile_GetNext(pvListFile, &szLineBegin, &szLineEnd, &FileDataId)) == 0)
+                break;
+
+            // Ignore the names that are too long
+            if(nLength < MAX_PATH)
+            {
+                pEntry = (PLISTFILE_ENTRY)Entries.Insert(1, false);
+                pEntry->szFileName = szLineBegin;
+                pEntry->cchFileName = nLength;
+                pEntry->FileNameHash = 0;
+                pEntry->FileDataId = FileDataId;
+                pEntry->NodeIndex = CASC_INVALID_INDEX;
+            }
+        }
+
+        // Hash the names and find their nodes on all CPUs
+        dwErrCode = CascRunWorkers(ResolveListFileWorker, &Context, (Entries.ItemCount() + LISTFILE_CHUNK_SIZE - 1) / LISTFILE_CHUNK_SIZE);
+        if(dwErrCode != ERROR_SUCCESS)
+            return dwErrCode;
+
+        // Assign the names in the listfile order. This creates the folder nodes,
+        // which can't be done in parallel
+        for(size_t i = 0; i < Entries.ItemCount(); i++)
+        {
+            pEntry = (PLISTFILE_ENTRY)Entries.ItemAt(i);
+            if(pEntry->NodeIndex != CASC_INVALID_INDEX)
+            {
+                // The same node may have been named by a previous line
+                pFileNode = FileTree.ItemAt(pEntry->NodeIndex);
+                if(pFileNode->NameLength == 0)
+                {
+                    if(!FileTree.SetNodeFileName(pFileNode, pEntry->szFileName, pEntry->cchFileName, pEntry->FileNameHash))
+                        return ERROR_NOT_ENOUGH_MEMORY;
+                }
+            }
+        }
+    }
+    while(nLength != 0);
+
+    return ERROR_SUCCESS;
+}
+
 bool TFileTreeRoot::GetInfo(PCASC_CKEY_ENTRY pCKeyEntry, PCASC_FILE_FULL_INFO pFileInfo)
 {
     PCASC_FILE_NODE pFileNode;
@@ -23,6 +23,8 @@
 #define DUMP_LEVEL_ENCODING_FILE                 2  // Dump root file + encoding file
 #define DUMP_LEVEL_INDEX_ENTRIES                 3  // Dump root file + encoding file + index entries
 
+#define CASC_RESOLVE_BATCH                      64  // Number of names hashed and looked up at once
+
 //-----------------------------------------------------------------------------
 // Class for generic root handler
 
@@ -62,6 +64,18 @@ struct TRootHandler
         return NULL;
     }
 
+    // Searches a batch of files by file names. Entries that are not found are set to NULL.
+    // Root handlers that don't override this leave all entries NULL, so the caller
+    // falls back to GetFile for each of them
+    // hs          - Pointer to the storage structure
+    // FileNames   - Array of file names
+    // CKeyEntries - Array that receives the CKey entries
+    // nCount      - Number of items in both arrays
+    virtual void GetFiles(struct TCascStorage * /* hs */, const char ** /* FileNames */, PCASC_CKEY_ENTRY * CKeyEntries, size_t nCount)
+    {
+        memset(CKeyEntries, 0, nCount * sizeof(PCASC_CKEY_ENTRY));
+    }
+
     // Performs find-next-file operation
     // pSearch   - Pointer to the initialized search structure
     // pFindData - Pointer to output structure that will contain the information
@@ -70,6 +84,19 @@ struct TRootHandler
         return NULL;
     }
 
+    // Frees the root-specific search context, if any
+    // pSearch   - Pointer to the search structure that is being closed
+    virtual void EndSearch(struct TCascSearch * /* pSearch */)
+    {}
+
+    // Gives names from an external listfile to the nameless files
+    // hs         - Pointer to the CASC storage
+    // pvListFile - Listfile cache created by ListFile_OpenExternal
+    virtual DWORD ApplyListFile(struct TCascStorage * /* hs */, void * /* pvListFile */)
+    {
+        return ERROR_NOT_SUPPORTED;
+    }
+
     // Returns advanced info from the root file entry.
     // pCKeyEntry - CKey/EKey, depending on which type the root handler provides
     // pFileInfo - Pointer to CASC_FILE_FULL_INFO structure
@@ -100,7 +127,10 @@ struct TFileTreeRoot : public TRootHandler
 
     PCASC_CKEY_ENTRY GetFile(struct TCascStorage * hs, const char * szFileName);
     PCASC_CKEY_ENTRY GetFile(struct TCascStorage * hs, DWORD FileDataId);
+    void GetFiles(struct TCascStorage * hs, const char ** FileNames, PCASC_CKEY_ENTRY * CKeyEntries, size_t nCount);
     PCASC_CKEY_ENTRY Search(struct TCascSearch * pSearch, struct _CASC_FIND_DATA * pFindData);
+    void EndSearch(struct TCascSearch * pSearch);
+    DWORD ApplyListFile(struct TCascStorage * hs, void * pvListFile);
     bool GetInfo(PCASC_CKEY_ENTRY pCKeyEntry, struct _CASC_FILE_FULL_INFO * pFileInfo);
 
     protected:
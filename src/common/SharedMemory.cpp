@@ -0,0 +1,238 @@
+/*****************************************************************************/
+/* SharedMemory.cpp                       Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Named shared memory segments                                              */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 19.10.26  1.00  Lad  The first version of SharedMemory.cpp                */
+/*****************************************************************************/
+
+#define __CASCLIB_SELF__
+#include "../CascLib.h"
+#include "../CascCommon.h"
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+#ifndef CASCLIB_PLATFORM_WINDOWS
+// "/name" is a POSIX shared memory object, everything else is a file
+static bool IsShmName(LPCTSTR szName)
+{
+    return (szName[0] == '/' && strchr(szName + 1, '/') == NULL);
+}
+
+static int OpenSegment(LPCTSTR szName, int nFlags)
+{
+    if(IsShmName(szName))
+        return shm_open(szName, nFlags, 0600);
+    return open(szName, nFlags, 0600);
+}
+#endif
+
+//-----------------------------------------------------------------------------
+// CASC_SHARED_MEMORY functions
+
+CASC_SHARED_MEMORY::CASC_SHARED_MEMORY()
+{
+    pbData = NULL;
+    cbData = 0;
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    hMapping = NULL;
+    hLock = NULL;
+#else
+    LockFd = -1;
+#endif
+}
+
+CASC_SHARED_MEMORY::~CASC_SHARED_MEMORY()
+{
+    Unlock();
+    Close();
+}
+
+DWORD CASC_SHARED_MEMORY::Create(LPCTSTR szName, size_t cbSize)
+{
+    assert(pbData == NULL);
+
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    ULONGLONG MappingSize = cbSize;
+
+    hMapping = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)(MappingSize >> 32), (DWORD)(MappingSize), szName);
+    if(hMapping == NULL)
+        return GetLastError();
+    if(GetLastError() == ERROR_ALREADY_EXISTS)
+    {
+        Close();
+        return ERROR_ALREADY_EXISTS;
+    }
+
+    if((pbData = (LPBYTE)MapViewOfFile(hMapping, FILE_MAP_WRITE, 0, 0, cbSize)) == NULL)
+    {
+        DWORD dwErrCode = GetLastError();
+
+        Close();
+        return dwErrCode;
+    }
+#else
+    void * pvData;
+    int fd;
+
+    if((fd = OpenSegment(szName, O_RDWR | O_CREAT | O_EXCL)) == -1)
+        return errno;
+
+    // The pages of the segment are only allocated when they are written to
+    if(ftruncate(fd, (off_t)cbSize) == -1 || (pvData = mmap(NULL, cbSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+    {
+        DWORD dwErrCode = errno;
+
+        close(fd);
+        Unlink(szName);
+        return dwErrCode;
+    }
+
+    pbData = (LPBYTE)pvData;
+    close(fd);
+#endif
+
+    cbData = cbSize;
+    return ERROR_SUCCESS;
+}
+
+DWORD CASC_SHARED_MEMORY::Open(LPCTSTR szName)
+{
+    assert(pbData == NULL);
+
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    MEMORY_BASIC_INFORMATION MemInfo;
+
+    if((hMapping = OpenFileMapping(FILE_MAP_COPY, FALSE, szName)) == NULL)
+        return GetLastError();
+
+    if((pbData = (LPBYTE)MapViewOfFile(hMapping, FILE_MAP_COPY, 0, 0, 0)) == NULL)
+    {
+        DWORD dwErrCode = GetLastError();
+
+        Close();
+        return dwErrCode;
+    }
+
+    // The size of the view is rounded up to the page size
+    VirtualQuery(pbData, &MemInfo, sizeof(MEMORY_BASIC_INFORMATION));
+    cbData = MemInfo.RegionSize;
+#else
+    struct stat64 FileInfo;
+    void * pvData;
+    int fd;
+
+    if((fd = OpenSegment(szName, O_RDONLY)) == -1)
+        return errno;
+
+    // Private mapping of a read-only descriptor: writes go to private copies of the pages
+    if(fstat64(fd, &FileInfo) == -1 || FileInfo.st_size == 0)
+    {
+        close(fd);
+        return ERROR_FILE_CORRUPT;
+    }
+
+    if((pvData = mmap(NULL, (size_t)FileInfo.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+    {
+        DWORD dwErrCode = errno;
+
+        close(fd);
+        return dwErrCode;
+    }
+
+    pbData = (LPBYTE)pvData;
+    cbData = (size_t)FileInfo.st_size;
+    close(fd);
+#endif
+
+    return ERROR_SUCCESS;
+}
+
+void CASC_SHARED_MEMORY::Unlink(LPCTSTR szName)
+{
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    CASCLIB_UNUSED(szName);
+#else
+    if(IsShmName(szName))
+        shm_unlink(szName);
+    else
+        unlink(szName);
+#endif
+}
+
+bool CASC_SHARED_MEMORY::Lock(LPCTSTR szName)
+{
+    TCHAR szLockName[MAX_PATH];
+
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    DWORD dwWaitResult;
+
+    assert(hLock == NULL);
+    CascStrPrintf(szLockName, _countof(szLockName), _T("%s_Lock"), szName);
+
+    // An abandoned mutex means that its owner has exited
+    if((hLock = CreateMutex(NULL, FALSE, szLockName)) == NULL)
+        return false;
+    dwWaitResult = WaitForSingleObject(hLock, 0);
+    if(dwWaitResult != WAIT_OBJECT_0 && dwWaitResult != WAIT_ABANDONED)
+    {
+        CloseHandle(hLock);
+        hLock = NULL;
+        return false;
+    }
+#else
+    int fd;
+
+    assert(LockFd == -1);
+    CascStrPrintf(szLockName, _countof(szLockName), _T("%s.lock"), szName);
+
+    // The lock file is never removed, so that all processes lock the same file.
+    // The kernel releases the lock if the process exits
+    if((fd = OpenSegment(szLockName, O_RDWR | O_CREAT)) == -1)
+        return false;
+    if(flock(fd, LOCK_EX | LOCK_NB) == -1)
+    {
+        close(fd);
+        return false;
+    }
+    LockFd = fd;
+#endif
+
+    return true;
+}
+
+void CASC_SHARED_MEMORY::Unlock()
+{
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    if(hLock != NULL)
+    {
+        ReleaseMutex(hLock);
+        CloseHandle(hLock);
+    }
+    hLock = NULL;
+#else
+    if(LockFd != -1)
+        close(LockFd);
+    LockFd = -1;
+#endif
+}
+
+void CASC_SHARED_MEMORY::Close()
+{
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    if(pbData != NULL)
+        UnmapViewOfFile(pbData);
+    if(hMapping != NULL)
+        CloseHandle(hMapping);
+    hMapping = NULL;
+#else
+    if(pbData != NULL)
+        munmap(pbData, cbData);
+#endif
+
+    pbData = NULL;
+    cbData = 0;
+}
@@ -0,0 +1,72 @@
+/*****************************************************************************/
+/* SharedMemory.h                         Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Named shared memory segments                                              */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 19.10.26  1.00  Lad  The first version of SharedMemory.h                  */
+/*****************************************************************************/
+
+#ifndef __CASC_SHARED_MEMORY_H__
+#define __CASC_SHARED_MEMORY_H__
+
+//-----------------------------------------------------------------------------
+// Named shared memory segment.
+//
+// POSIX: A name in the form of "/name" is a shm_open() segment. Any other name
+// is a path to a file, e.g. "/dev/shm/casc.idx" or "/proc/self/fd/5" for a memfd
+// that was inherited from the parent process.
+// Windows: The name is the name of a file mapping object. The mapping exists
+// as long as any process has it open; Unlink() does nothing.
+//
+// Create() maps the segment for writing. Open() maps it copy-on-write:
+// the pages are shared with the other processes until they are written to,
+// and the writes are never visible to the other processes.
+
+class CASC_SHARED_MEMORY
+{
+    public:
+
+    CASC_SHARED_MEMORY();
+    ~CASC_SHARED_MEMORY();
+
+    // Creates a new segment. Fails with ERROR_ALREADY_EXISTS if the segment exists
+    DWORD Create(LPCTSTR szName, size_t cbSize);
+
+    // Opens an existing segment. Fails with ERROR_FILE_NOT_FOUND if there is no such segment
+    DWORD Open(LPCTSTR szName);
+
+    // Removes the name of the segment. Processes that have it mapped keep their mapping
+    static void Unlink(LPCTSTR szName);
+
+    // Serializes creating and replacing the segment among processes. Returns false if another
+    // process holds the lock. The lock is released by Unlock() or when the process exits
+    bool Lock(LPCTSTR szName);
+    void Unlock();
+
+    void Close();
+
+    LPBYTE Data()
+    {
+        return pbData;
+    }
+
+    size_t Size()
+    {
+        return cbData;
+    }
+
+    protected:
+
+    LPBYTE pbData;                                  // Mapped view of the segment
+    size_t cbData;                                  // Size of the mapped view
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    HANDLE hMapping;                                // Handle to the file mapping object
+    HANDLE hLock;                                   // Named mutex held by Lock()
+#else
+    int LockFd;                                     // Lock file ("<name>.lock") held by Lock()
+#endif
+};
+
+#endif // __CASC_SHARED_MEMORY_H__
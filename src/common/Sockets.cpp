@@ -40,22 +40,25 @@ char * CASC_SOCKET::ReadResponse(const char * request, size_t request_length, si
     // Lock the socket
     CascLock(Lock);
 
-    // Send the request to the remote host. On Linux, this call may send signal(SIGPIPE),
-    // we need to prevend that by using the MSG_NOSIGNAL flag. On Windows, it fails normally.
-    while(send(sock, request, (int)request_length, MSG_NOSIGNAL) == SOCKET_ERROR)
+    for(int retry_count = 1; retry_count >= 0; retry_count--)
     {
-        // If the connection was closed by the remote host, we try to reconnect
-        if(ReconnectAfterShutdown(sock, remoteItem) == INVALID_SOCKET)
+        // Send the request to the remote host. On Linux, this call may send signal(SIGPIPE),
+        // we need to prevend that by using the MSG_NOSIGNAL flag. On Windows, it fails normally.
+        while(send(sock, request, (int)request_length, MSG_NOSIGNAL) == SOCKET_ERROR)
         {
-            SetCascError(ERROR_NETWORK_NOT_AVAILABLE);
-            CascUnlock(Lock);
-            return NULL;
+            // If the connection was closed by the remote host, we try to reconnect
+            if(ReconnectAfterShutdown(sock, remoteItem) == INVALID_SOCKET)
+            {
+                SetCascError(ERROR_NETWORK_NOT_AVAILABLE);
+                CascUnlock(Lock);
+                return NULL;
+            }
         }
-    }
 
-    // Allocate buffer for server response. Allocate one extra byte for zero terminator
-    if((server_response = CASC_ALLOC<char>(buffer_size + 1)) != NULL)
-    {
+        // Allocate buffer for server response. Allocate one extra byte for zero terminator
+        if((server_response = CASC_ALLOC<char>(buffer_size + 1)) == NULL)
+            break;
+
         for(;;)
         {
             // Reallocate the buffer size, if needed
@@ -84,6 +87,15 @@ char * CASC_SOCKET::ReadResponse(const char * request, size_t request_length, si
             if(HttpInfo.IsDataComplete(server_response, total_received))
                 break;
         }
+
+        // A kept-alive connection may have been closed by the remote host
+        // while idle. The send() succeeds, but nothing comes back. Reconnect once
+        // and send the request again
+        if(total_received != 0 || retry_count == 0)
+            break;
+        CASC_FREE(server_response);
+        closesocket(sock);
+        sock = CreateAndConnect(remoteItem);
     }
 
     // Unlock the socket
@@ -427,8 +439,9 @@ PCASC_SOCKET sockets_connect(const char * hostName, unsigned portNum)
         // Create new socket and connect it to the remote host
         pSocket = CASC_SOCKET::Connect(hostName, portNum);
 
-        // Insert it to the cache, if it's a HTTP connection
-        if(pSocket != NULL && pSocket->portNum == CASC_PORT_HTTP)
+        // Insert it to the cache, if it's a HTTP connection. Ribbit servers
+        // close the connection after each response, so those are not cached
+        if(pSocket != NULL && pSocket->portNum != CASC_PORT_RIBBIT)
             pSocket = SocketCache.InsertSocket(pSocket);
     }
 
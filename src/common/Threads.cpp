@@ -0,0 +1,167 @@
+/*****************************************************************************/
+/* Threads.cpp                            Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Simple worker pool for parallel loading                                   */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 19.10.26  1.00  Lad  The first version of Threads.cpp                     */
+/*****************************************************************************/
+
+#define __CASCLIB_SELF__
+#include "../CascLib.h"
+#include "../CascCommon.h"
+
+//-----------------------------------------------------------------------------
+// Local structures
+
+struct CASC_WORKER_JOB
+{
+    CASC_WORKER_ROUTINE PfnWorker;                  // Worker routine
+    void * pvContext;                               // Caller-supplied context
+    size_t nItemCount;                              // Total number of work items
+    size_t nNextItem;                               // The next work item to be taken
+    size_t nErrorItem;                              // Index of the lowest failed item
+    DWORD dwErrCode;                                // Error code of the lowest failed item
+    CASC_LOCK Lock;                                 // Lock for the job structure
+};
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+static void ProcessWorkItems(CASC_WORKER_JOB * pJob)
+{
+    size_t nItemIndex;
+    DWORD dwErrCode;
+
+    for(;;)
+    {
+        // Take the next work item
+        CascLock(pJob->Lock);
+        nItemIndex = pJob->nNextItem;
+        if(nItemIndex < pJob->nItemCount)
+            pJob->nNextItem++;
+        CascUnlock(pJob->Lock);
+
+        // Are we done?
+        if(nItemIndex >= pJob->nItemCount)
+            break;
+
+        // Process the item and remember the error with the lowest index
+        dwErrCode = pJob->PfnWorker(pJob->pvContext, nItemIndex);
+        if(dwErrCode != ERROR_SUCCESS)
+        {
+            CascLock(pJob->Lock);
+            if(nItemIndex < pJob->nErrorItem)
+            {
+                pJob->nErrorItem = nItemIndex;
+                pJob->dwErrCode = dwErrCode;
+            }
+            CascUnlock(pJob->Lock);
+        }
+    }
+}
+
+static void WorkerThread(void * pvParam)
+{
+    ProcessWorkItems((CASC_WORKER_JOB *)pvParam);
+}
+
+#ifdef CASCLIB_PLATFORM_WINDOWS
+static DWORD WINAPI ThreadStartRoutine(LPVOID lpParameter)
+{
+    CASC_THREAD * pThread = (CASC_THREAD *)lpParameter;
+
+    pThread->PfnRoutine(pThread->pvParam);
+    return 0;
+}
+#else
+static void * ThreadStartRoutine(void * pvParameter)
+{
+    CASC_THREAD * pThread = (CASC_THREAD *)pvParameter;
+
+    pThread->PfnRoutine(pThread->pvParam);
+    return NULL;
+}
+#endif
+
+//-----------------------------------------------------------------------------
+// Public functions
+
+DWORD CascGetProcessorCount()
+{
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    SYSTEM_INFO SystemInfo;
+
+    GetSystemInfo(&SystemInfo);
+    return (SystemInfo.dwNumberOfProcessors != 0) ? SystemInfo.dwNumberOfProcessors : 1;
+#else
+    long nProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return (nProcessors > 0) ? (DWORD)nProcessors : 1;
+#endif
+}
+
+bool CascCreateThread(CASC_THREAD & Thread, CASC_THREAD_ROUTINE PfnRoutine, void * pvParam)
+{
+    Thread.PfnRoutine = PfnRoutine;
+    Thread.pvParam = pvParam;
+
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    Thread.hThread = CreateThread(NULL, 0, ThreadStartRoutine, &Thread, 0, NULL);
+    return (Thread.hThread != NULL);
+#else
+    return (pthread_create(&Thread.hThread, NULL, ThreadStartRoutine, &Thread) == 0);
+#endif
+}
+
+void CascJoinThread(CASC_THREAD & Thread)
+{
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    WaitForSingleObject(Thread.hThread, INFINITE);
+    CloseHandle(Thread.hThread);
+#else
+    pthread_join(Thread.hThread, NULL);
+#endif
+}
+
+DWORD CascRunWorkers(CASC_WORKER_ROUTINE PfnWorker, void * pvContext, size_t nItemCount, DWORD dwMaxThreads)
+{
+    CASC_WORKER_JOB Job;
+    CASC_THREAD Threads[CASC_MAX_WORKER_THREADS];
+    size_t nThreadCount = 0;
+    size_t nThreads;
+
+    // Setup the job
+    Job.PfnWorker = PfnWorker;
+    Job.pvContext = pvContext;
+    Job.nItemCount = nItemCount;
+    Job.nNextItem = 0;
+    Job.nErrorItem = (size_t)(-1);
+    Job.dwErrCode = ERROR_SUCCESS;
+    CascInitLock(Job.Lock);
+
+    // Determine the number of threads. There is no point in having more threads than items
+    nThreads = (dwMaxThreads != 0) ? dwMaxThreads : CascGetProcessorCount();
+    nThreads = CASCLIB_MIN(nThreads, nItemCount);
+    nThreads = CASCLIB_MIN(nThreads, CASC_MAX_WORKER_THREADS);
+
+    // Start the extra worker threads. The calling thread is one of the workers.
+    // If a thread fails to start, the remaining threads will take its share
+    for(size_t i = 1; i < nThreads; i++)
+    {
+        if(!CascCreateThread(Threads[nThreadCount], WorkerThread, &Job))
+            break;
+        nThreadCount++;
+    }
+
+    // Process the items in the calling thread too
+    ProcessWorkItems(&Job);
+
+    // Wait for all worker threads to finish
+    for(size_t i = 0; i < nThreadCount; i++)
+        CascJoinThread(Threads[i]);
+
+    CascFreeLock(Job.Lock);
+    return Job.dwErrCode;
+}
@@ -0,0 +1,57 @@
+/*****************************************************************************/
+/* Threads.h                              Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Simple worker pool for parallel loading                                   */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 19.10.26  1.00  Lad  The first version of Threads.h                       */
+/*****************************************************************************/
+
+#ifndef __CASC_THREADS_H__
+#define __CASC_THREADS_H__
+
+//-----------------------------------------------------------------------------
+// Defines
+
+#define CASC_MAX_WORKER_THREADS     64              // Upper limit of worker threads for one job
+
+// Callback for processing one work item. Called concurrently from multiple threads
+// pvContext  - Caller-supplied context, shared by all work items
+// nItemIndex - Index of the work item, 0 to (nItemCount - 1)
+typedef DWORD (*CASC_WORKER_ROUTINE)(void * pvContext, size_t nItemIndex);
+
+// Entry point of a long-running thread (see CascCreateThread)
+typedef void (*CASC_THREAD_ROUTINE)(void * pvParam);
+
+// Thread object. Must stay at the same address until CascJoinThread returns
+struct CASC_THREAD
+{
+    CASC_THREAD_ROUTINE PfnRoutine;                 // Thread routine
+    void * pvParam;                                 // Parameter for the thread routine
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    HANDLE hThread;                                 // Thread handle
+#else
+    pthread_t hThread;                              // Thread handle
+#endif
+};
+
+//-----------------------------------------------------------------------------
+// Worker functions
+
+// Returns the number of processors available to the process
+DWORD CascGetProcessorCount();
+
+// Starts a new thread that calls PfnRoutine(pvParam)
+bool CascCreateThread(CASC_THREAD & Thread, CASC_THREAD_ROUTINE PfnRoutine, void * pvParam);
+
+// Waits until the thread finishes and frees the thread handle
+void CascJoinThread(CASC_THREAD & Thread);
+
+// Processes nItemCount work items over a pool of worker threads. The calling thread
+// also takes part. Each item is processed exactly once, in unspecified order.
+// dwMaxThreads - Maximum number of threads (including the caller). 0 = number of processors
+// Returns ERROR_SUCCESS or the error code of the lowest-indexed failed item
+DWORD CascRunWorkers(CASC_WORKER_ROUTINE PfnWorker, void * pvContext, size_t nItemCount, DWORD dwMaxThreads = 0);
+
+#endif // __CASC_THREADS_H__
@@ -0,0 +1,1990 @@
+/*****************************************************************************/
+/* CascBench.cpp                          Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Benchmark of CascLib on a generated synthetic storage. The online        */
+/* storage is benchmarked through a local mock CDN server                    */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 19.10.26  1.00  Lad  The first version of CascBench.cpp                   */
+/*****************************************************************************/
+
+#define _CRT_NON_CONFORMING_SWPRINTFS
+#define _CRT_SECURE_NO_DEPRECATE
+#define __CASCLIB_SELF__                    // Don't use CascLib.lib
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../src/CascLib.h"
+#include "../src/CascCommon.h"
+
+#include "TSyntheticStorage.cpp"
+#include "TMockCdnServer.cpp"
+
+#ifdef _MSC_VER
+#pragma warning(disable: 4505)              // 'XXX' : unreferenced local function has been removed
+#endif
+
+//-----------------------------------------------------------------------------
+// Defines
+
+#define BENCH_OPEN_ROUNDS       5           // Number of open/close rounds
+#define BENCH_RANDOM_READS      0x4000      // Number of random reads
+#define BENCH_RANDOM_READ_SIZE  0x1000      // Size of one random read
+#define BENCH_BUFFER_SIZE       0x10000     // Size of the read buffer
+#define BENCH_ASYNC_DEPTH       64          // Number of asynchronous reads in flight
+#define BENCH_ONLINE_TRIES      5           // Number of attempts to open the online storage (with failure injection)
+#define BENCH_HOT_FILES         64          // Number of files that are opened again and again
+#define BENCH_HOT_ROUNDS        1000        // Number of rounds over the hot files
+#define BENCH_RESOLVE_ROUNDS    10          // Number of rounds of name resolution
+#define BENCH_SHARED_FILES      64          // Number of files read at once by the shared handle phase
+#define BENCH_SHARED_PIECE      0x8123      // Size of one positional read. Not aligned to the frames on purpose
+#define BENCH_SHARED_THREADS    4           // Number of threads reading one file handle
+#define BENCH_SHARED_INDEX      _T("/casc_bench_index")   // Name of the shared memory segment with the storage index
+#define BENCH_SHARED_COPIED     8           // An attached storage may only copy 1/N of the pages of the segment
+#define BENCH_TVFS_FILES        256         // Number of files in the storage with TVFS root
+#define BENCH_DAMAGED_FILES     64          // Number of files in the deliberately damaged storage
+#define BENCH_INCR_FILES        20000       // Number of files in the storage that gets updated
+#define BENCH_INCR_MAX_SIZE     0x2000      // Maximal file size in the storage that gets updated
+#define BENCH_INCR_STAGED       8           // Number of files that are added by the update
+#define BENCH_INCR_CHANGED      2           // Number of files that are changed by the update
+#define BENCH_KEY_LOOKUPS       1000000     // Number of CascFindEncryptionKey calls
+
+#ifdef _MSC_VER
+#define fmt_I64u "%I64u"
+#else
+#define fmt_I64u "%llu"
+#endif
+
+//-----------------------------------------------------------------------------
+// Local structures
+
+struct BENCH_RESULT
+{
+    const char * szPhase;                   // Name of the phase
+    ULONGLONG TimeMs;                       // Wall-clock time of the phase
+    ULONGLONG ByteCount;                    // Number of content bytes processed, 0 if not relevant
+    DWORD ItemCount;                        // Number of files (or rounds) processed
+    DWORD ErrorCount;                       // Number of failures or MD5 mismatches
+};
+
+// One asynchronous whole-file read
+struct BENCH_ASYNC_SLOT
+{
+    HANDLE hFile;                           // The file being read
+    LPBYTE pbBuffer;                        // Buffer for the whole file
+    ULONGLONG FileSize;                     // Content size of the file
+    BYTE CKey[MD5_HASH_SIZE];               // Expected MD5 of the content
+};
+
+// Files read by multiple threads through one handle per file
+struct BENCH_SHARED_READ
+{
+    HANDLE hFiles[BENCH_SHARED_FILES];      // One handle per file, shared by all threads
+    LPBYTE pbData[BENCH_SHARED_FILES];      // Content of the files
+    ULONGLONG FileSize[BENCH_SHARED_FILES]; // Sizes of the files
+    size_t FirstPiece[BENCH_SHARED_FILES + 1];  // Index of the first piece of each file
+    DWORD dwFileCount;                      // Number of files in this batch
+    DWORD dwErrors;                         // Number of failed reads
+};
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+static void PrintResult(const BENCH_RESULT & Result)
+{
+    double MBytesPerSec = (Result.TimeMs != 0) ? ((double)Result.ByteCount / (1024.0 * 1024.0)) / ((double)Result.TimeMs / 1000.0) : 0.0;
+
+    printf("%-12s %10u %10u ms %10.1f MB/s %8u\n", Result.szPhase, Result.ItemCount, (DWORD)Result.TimeMs, MBytesPerSec, Result.ErrorCount);
+}
+
+// Reads the whole file, optionally writes it to a file and compares its MD5 with the CKey
+static bool ReadAndVerifyFile(HANDLE hFile, LPBYTE pbBuffer, ULONGLONG & ByteCount, TFileStream * pOutStream)
+{
+    CASC_FILE_FULL_INFO FileInfo;
+    ULONGLONG ByteOffset = 0;
+    MD5_CTX md5_ctx;
+    BYTE FileHash[MD5_HASH_SIZE];
+    DWORD dwBytesRead = 0;
+
+    if(!CascGetFileInfo(hFile, CascFileFullInfo, &FileInfo, sizeof(CASC_FILE_FULL_INFO), NULL))
+        return false;
+
+    MD5_Init(&md5_ctx);
+    while(CascReadFile(hFile, pbBuffer, BENCH_BUFFER_SIZE, &dwBytesRead) && dwBytesRead != 0)
+    {
+        if(pOutStream != NULL && !FileStream_Write(pOutStream, &ByteOffset, pbBuffer, dwBytesRead))
+            return false;
+        MD5_Update(&md5_ctx, pbBuffer, dwBytesRead);
+        ByteOffset += dwBytesRead;
+    }
+    MD5_Final(FileHash, &md5_ctx);
+
+    ByteCount += ByteOffset;
+    return (ByteOffset == FileInfo.ContentSize) && !memcmp(FileHash, FileInfo.CKey, MD5_HASH_SIZE);
+}
+
+//-----------------------------------------------------------------------------
+// Benchmark phases
+
+static DWORD Bench_Generate(const SYNTH_PARAMS & Params, BENCH_RESULT & Result)
+{
+    TSyntheticStorage Storage;
+    ULONGLONG StartTime = GetTimeMs();
+    DWORD dwErrCode;
+
+    dwErrCode = Storage.Generate(Params);
+    Result.TimeMs = GetTimeMs() - StartTime;
+    Result.ByteCount = Storage.TotalContentSize;
+    Result.ItemCount = Params.dwFileCount;
+    Result.ErrorCount = (dwErrCode != ERROR_SUCCESS) ? 1 : 0;
+
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        printf("Generated %u files, " fmt_I64u " bytes of content, " fmt_I64u " bytes encoded (N: %u, Z: %u, E+N: %u, E+Z: %u)\n",
+            Params.dwFileCount,
+            Storage.TotalContentSize,
+            Storage.TotalEncodedSize,
+            Storage.ModeCounts[SYNTH_MODE_NORMAL],
+            Storage.ModeCounts[SYNTH_MODE_ZLIB],
+            Storage.ModeCounts[SYNTH_MODE_ENCRYPTED_N],
+            Storage.ModeCounts[SYNTH_MODE_ENCRYPTED_Z]);
+        if(Params.dwCdnPort != 0)
+            printf("Generated CDN tree with %u archives and %u loose files\n", Storage.ArchiveCount, Storage.LooseFileCount);
+    }
+    return dwErrCode;
+}
+
+static DWORD Bench_OpenStorage(LPCTSTR szStoragePath, BENCH_RESULT & Result)
+{
+    ULONGLONG MinTime = (ULONGLONG)-1;
+    ULONGLONG TotalTime = 0;
+    ULONGLONG StartTime;
+    HANDLE hStorage;
+
+    for(DWORD i = 0; i < BENCH_OPEN_ROUNDS; i++)
+    {
+        StartTime = GetTimeMs();
+        if(!CascOpenStorage(szStoragePath, 0, &hStorage))
+            return GetCascError();
+        CascCloseStorage(hStorage);
+        StartTime = GetTimeMs() - StartTime;
+
+        MinTime = CASCLIB_MIN(MinTime, StartTime);
+        TotalTime += StartTime;
+    }
+
+    // Report the best round; the first one is usually slower due to cold file cache
+    printf("Open storage: min %u ms, avg %u ms\n", (DWORD)MinTime, (DWORD)(TotalTime / BENCH_OPEN_ROUNDS));
+    Result.TimeMs = MinTime;
+    Result.ItemCount = BENCH_OPEN_ROUNDS;
+    return ERROR_SUCCESS;
+}
+
+static DWORD Bench_EnumFiles(HANDLE hStorage, LPCTSTR szListFile, BENCH_RESULT & Result)
+{
+    CASC_FIND_DATA cf;
+    ULONGLONG StartTime = GetTimeMs();
+    HANDLE hFind;
+    bool bFileFound = true;
+
+    if((hFind = CascFindFirstFile(hStorage, "*", &cf, szListFile)) == INVALID_HANDLE_VALUE)
+        return GetCascError();
+
+    while(bFileFound)
+    {
+        // All files from ROOT must have their names from the listfile. Other files (like ENCODING) don't have them
+        Result.ErrorCount += (cf.dwFileDataId != CASC_INVALID_ID && cf.NameType != CascNameFull) ? 1 : 0;
+        Result.ItemCount++;
+        bFileFound = CascFindNextFile(hFind, &cf);
+    }
+
+    // The listfile can't be applied while a search is open, only after that
+    Result.ErrorCount += (CascApplyListFile(hStorage, szListFile) || GetCascError() != ERROR_ACCESS_DENIED) ? 1 : 0;
+    CascFindClose(hFind);
+    Result.ErrorCount += CascApplyListFile(hStorage, szListFile) ? 0 : 1;
+
+    Result.TimeMs = GetTimeMs() - StartTime;
+    return ERROR_SUCCESS;
+}
+
+// Queries over the DOWNLOAD tags. MatchTagQuery evaluates the same queries directly
+static const char * TagQueries[] =
+{
+    "Windows",
+    "Windows & x86_64 & enUS",
+    "(OSX | arm64) & !enUS",
+    "!frFR",
+    "deDE | frFR"
+};
+
+static bool MatchTagQuery(size_t nQuery, DWORD dwFileIndex)
+{
+    #define HAS_TAG(n)  TSyntheticStorage::FileHasTag(dwFileIndex, n)
+
+    switch(nQuery)
+    {
+        case 0: return HAS_TAG(0);
+        case 1: return HAS_TAG(0) && HAS_TAG(2) && HAS_TAG(4);
+        case 2: return (HAS_TAG(1) || HAS_TAG(3)) && !HAS_TAG(4);
+        case 3: return !HAS_TAG(6);
+        case 4: return HAS_TAG(5) || HAS_TAG(6);
+    }
+
+    #undef HAS_TAG
+    return false;
+}
+
+static DWORD Bench_TagQuery(HANDLE hStorage, DWORD dwFileCount, BENCH_RESULT & Result)
+{
+    CASC_FIND_DATA cf;
+    ULONGLONG StartTime = GetTimeMs();
+    HANDLE hFind;
+
+    for(size_t i = 0; i < _countof(TagQueries); i++)
+    {
+        DWORD dwExpected = 0;
+        DWORD dwFound = 0;
+
+        if((hFind = CascFindFirstTaggedFile(hStorage, TagQueries[i], &cf)) != INVALID_HANDLE_VALUE)
+        {
+            do
+            {
+                dwFound++;
+            }
+            while(CascFindNextFile(hFind, &cf));
+            CascFindClose(hFind);
+        }
+
+        // The number of found files must match the direct evaluation
+        for(DWORD j = 0; j < dwFileCount; j++)
+            dwExpected += MatchTagQuery(i, j) ? 1 : 0;
+        Result.ErrorCount += (dwFound != dwExpected) ? 1 : 0;
+        Result.ItemCount += dwFound;
+    }
+
+    Result.TimeMs = GetTimeMs() - StartTime;
+    return ERROR_SUCCESS;
+}
+
+// Sequential read of all files in the order of file data IDs, which is also the order in the data files
+static DWORD Bench_ReadSequential(HANDLE hStorage, DWORD dwFileCount, LPBYTE pbBuffer, BENCH_RESULT & Result)
+{
+    ULONGLONG StartTime = GetTimeMs();
+    HANDLE hFile;
+
+    for(DWORD i = 0; i < dwFileCount; i++)
+    {
+        if(CascOpenFile(hStorage, CASC_FILE_DATA_ID(i + 1), 0, CASC_OPEN_BY_FILEID, &hFile))
+        {
+            Result.ErrorCount += ReadAndVerifyFile(hFile, pbBuffer, Result.ByteCount, NULL) ? 0 : 1;
+            CascCloseFile(hFile);
+        }
+        else
+        {
+            Result.ErrorCount++;
+        }
+        Result.ItemCount++;
+    }
+
+    Result.TimeMs = GetTimeMs() - StartTime;
+    return ERROR_SUCCESS;
+}
+
+// Sequential read of all files with CascReadWholeFile. The expected CKeys are collected
+// by enumerating the storage before the time measurement starts
+static DWORD Bench_ReadWhole(HANDLE hStorage, DWORD dwFileCount, BENCH_RESULT & Result)
+{
+    CASC_FIND_DATA cf;
+    ULONGLONG StartTime;
+    MD5_CTX md5_ctx;
+    HANDLE hFind;
+    LPBYTE pbCKeys;
+    LPBYTE pbBuffer;
+    BYTE FileHash[MD5_HASH_SIZE];
+    DWORD cbBuffer = BENCH_BUFFER_SIZE;
+    DWORD dwBytesRead;
+    bool bFileFound = true;
+
+    // Collect the CKeys of all files, by file data id
+    if((pbCKeys = CASC_ALLOC_ZERO<BYTE>(dwFileCount * MD5_HASH_SIZE)) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    if((hFind = CascFindFirstFile(hStorage, "*", &cf, NULL)) != INVALID_HANDLE_VALUE)
+    {
+        while(bFileFound)
+        {
+            if(cf.dwFileDataId != CASC_INVALID_ID && 0 < cf.dwFileDataId && cf.dwFileDataId <= dwFileCount)
+                memcpy(pbCKeys + (cf.dwFileDataId - 1) * MD5_HASH_SIZE, cf.CKey, MD5_HASH_SIZE);
+            bFileFound = CascFindNextFile(hFind, &cf);
+        }
+        CascFindClose(hFind);
+    }
+
+    // The buffer grows when a file doesn't fit
+    if((pbBuffer = CASC_ALLOC<BYTE>(cbBuffer)) == NULL)
+    {
+        CASC_FREE(pbCKeys);
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    StartTime = GetTimeMs();
+    for(DWORD i = 0; i < dwFileCount; i++)
+    {
+        bool bSuccess = CascReadWholeFile(hStorage, CASC_FILE_DATA_ID(i + 1), 0, CASC_OPEN_BY_FILEID, pbBuffer, cbBuffer, &dwBytesRead);
+
+        if(!bSuccess && GetCascError() == ERROR_INSUFFICIENT_BUFFER)
+        {
+            CASC_FREE(pbBuffer);
+            if((pbBuffer = CASC_ALLOC<BYTE>(cbBuffer = dwBytesRead)) == NULL)
+                break;
+            bSuccess = CascReadWholeFile(hStorage, CASC_FILE_DATA_ID(i + 1), 0, CASC_OPEN_BY_FILEID, pbBuffer, cbBuffer, &dwBytesRead);
+        }
+
+        if(bSuccess)
+        {
+            MD5_Init(&md5_ctx);
+            MD5_Update(&md5_ctx, pbBuffer, dwBytesRead);
+            MD5_Final(FileHash, &md5_ctx);
+            Result.ErrorCount += memcmp(FileHash, pbCKeys + i * MD5_HASH_SIZE, MD5_HASH_SIZE) ? 1 : 0;
+            Result.ByteCount += dwBytesRead;
+        }
+        else
+        {
+            Result.ErrorCount++;
+        }
+        Result.ItemCount++;
+    }
+    Result.TimeMs = GetTimeMs() - StartTime;
+
+    CASC_FREE(pbBuffer);
+    CASC_FREE(pbCKeys);
+    return ERROR_SUCCESS;
+}
+
+// Compares the incrementally opened storage with its base storage and reads all files from it.
+// Returns the number of differences and failed reads
+static DWORD VerifyIncrementalStorage(HANDLE hStorage, HANDLE hBaseStorage, DWORD dwFileCount, LPBYTE pbBuffer)
+{
+    CASC_STORAGE_INFO_CLASS InfoClasses[] = {CascStorageLocalFileCount, CascStorageTotalFileCount, CascStorageFeatures};
+    BENCH_RESULT Verify = {0};
+    DWORD dwErrorCount = 0;
+
+    for(size_t i = 0; i < _countof(InfoClasses); i++)
+    {
+        DWORD dwValue1 = 0;
+        DWORD dwValue2 = 0;
+
+        CascGetStorageInfo(hStorage, InfoClasses[i], &dwValue1, sizeof(DWORD), NULL);
+        CascGetStorageInfo(hBaseStorage, InfoClasses[i], &dwValue2, sizeof(DWORD), NULL);
+        dwErrorCount += (dwValue1 != dwValue2) ? 1 : 0;
+    }
+
+    Bench_ReadSequential(hStorage, dwFileCount, pbBuffer, Verify);
+    return dwErrorCount + Verify.ErrorCount;
+}
+
+// Deletes a directory with all its content
+static void RemoveDirectoryTree(LPCTSTR szDirectory)
+{
+    TCHAR szPath[MAX_PATH];
+
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    WIN32_FIND_DATA wf;
+    HANDLE hFind;
+
+    CombinePath(szPath, _countof(szPath), szDirectory, _T("*"), NULL);
+    if((hFind = FindFirstFile(szPath, &wf)) != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if(_tcscmp(wf.cFileName, _T(".")) && _tcscmp(wf.cFileName, _T("..")))
+            {
+                CombinePath(szPath, _countof(szPath), szDirectory, wf.cFileName, NULL);
+                if(wf.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                    RemoveDirectoryTree(szPath);
+                else
+                    DeleteFile(szPath);
+            }
+        }
+        while(FindNextFile(hFind, &wf));
+        FindClose(hFind);
+    }
+    RemoveDirectory(szDirectory);
+#else
+    struct dirent * dir_entry;
+    DIR * dir;
+
+    if((dir = opendir(szDirectory)) != NULL)
+    {
+        while((dir_entry = readdir(dir)) != NULL)
+        {
+            if(strcmp(dir_entry->d_name, ".") && strcmp(dir_entry->d_name, ".."))
+            {
+                CombinePath(szPath, _countof(szPath), szDirectory, dir_entry->d_name, NULL);
+                if(dir_entry->d_type == DT_DIR)
+                    RemoveDirectoryTree(szPath);
+                else
+                    unlink(szPath);
+            }
+        }
+        closedir(dir);
+    }
+    rmdir(szDirectory);
+#endif
+}
+
+// Shows how much of the base storage was reused by the incremental open
+static void PrintReuseCounters(HANDLE hStorage)
+{
+    CASC_STORAGE_PERF_COUNTERS Counters;
+
+    if(CascGetStorageInfo(hStorage, CascStoragePerfCounters, &Counters, sizeof(CASC_STORAGE_PERF_COUNTERS), NULL))
+    {
+        printf("Incremental open: " fmt_I64u " index files and " fmt_I64u " ENCODING pages reused, %u ms (index %u, encoding %u)\n",
+            Counters.OpenReusedIndexes,
+            Counters.OpenReusedPages,
+            (DWORD)(Counters.OpenTotalTime / 1000), (DWORD)(Counters.OpenIndexTime / 1000), (DWORD)(Counters.OpenEncodingTime / 1000));
+    }
+}
+
+// Checks that the incremental open reused exactly the index files and ENCODING pages
+// that the generator left unchanged
+static DWORD VerifyReuseCounters(HANDLE hStorage, DWORD dwIndexCount, DWORD dwPageCount)
+{
+    CASC_STORAGE_PERF_COUNTERS Counters;
+
+    if(!CascGetStorageInfo(hStorage, CascStoragePerfCounters, &Counters, sizeof(CASC_STORAGE_PERF_COUNTERS), NULL))
+        return 1;
+    return (Counters.OpenReusedIndexes != dwIndexCount || Counters.OpenReusedPages != dwPageCount) ? 1 : 0;
+}
+
+// Compares the CKeys of all files with the ones from the generator
+static DWORD VerifyFileCKeys(HANDLE hStorage, TSyntheticStorage & Storage, DWORD dwFileCount)
+{
+    CASC_FILE_FULL_INFO FileInfo;
+    HANDLE hFile;
+    DWORD dwErrorCount = 0;
+
+    for(DWORD i = 0; i < dwFileCount; i++)
+    {
+        if(CascOpenFile(hStorage, CASC_FILE_DATA_ID(i + 1), 0, CASC_OPEN_BY_FILEID, &hFile))
+        {
+            if(!CascGetFileInfo(hFile, CascFileFullInfo, &FileInfo, sizeof(CASC_FILE_FULL_INFO), NULL))
+                dwErrorCount++;
+            else if(memcmp(FileInfo.CKey, Storage.FileAt(i)->CKey, MD5_HASH_SIZE))
+                dwErrorCount++;
+            CascCloseFile(hFile);
+        }
+        else
+        {
+            dwErrorCount++;
+        }
+    }
+
+    return dwErrorCount;
+}
+
+// Opens the next build of a storage with the previous build as the base, like after an update.
+// The update changes a few files and adds the staged ones, so some index files and ENCODING pages
+// are new and the others are reused. Some staged files are in a reused index file,
+// so that index file must be loaded after all. The incremental storage must be the same
+// as a full open of the new build
+static DWORD Bench_OpenIncremental(const SYNTH_PARAMS & Params, LPBYTE pbBuffer, BENCH_RESULT & Result)
+{
+    CASC_OPEN_STORAGE_ARGS OpenArgs = {sizeof(CASC_OPEN_STORAGE_ARGS)};
+    TSyntheticStorage Storage;
+    SYNTH_PARAMS IncrParams = Params;
+    ULONGLONG MinTime = (ULONGLONG)-1;
+    ULONGLONG StartTime;
+    HANDLE hBaseStorage = NULL;
+    HANDLE hFullStorage = NULL;
+    HANDLE hStorage = NULL;
+    TCHAR szStoragePath[MAX_PATH];
+    DWORD dwErrCode;
+
+    // Index files left by a previous run would have higher sub-indexes
+    CombinePath(szStoragePath, _countof(szStoragePath), Params.szStoragePath, _T("incr"), NULL);
+    RemoveDirectoryTree(szStoragePath);
+    IncrParams.szStoragePath = szStoragePath;
+    IncrParams.dwFileCount = BENCH_INCR_FILES;
+    IncrParams.dwMinFileSize = CASCLIB_MIN(Params.dwMinFileSize, BENCH_INCR_MAX_SIZE);
+    IncrParams.dwMaxFileSize = BENCH_INCR_MAX_SIZE;
+    IncrParams.dwStagedFiles = BENCH_INCR_STAGED;
+    IncrParams.dwCdnPort = 0;
+    IncrParams.bTvfsRoot = false;
+    IncrParams.bInstallRoot = false;
+
+    if((dwErrCode = Storage.Generate(IncrParams)) != ERROR_SUCCESS)
+        return dwErrCode;
+    OpenArgs.szLocalPath = szStoragePath;
+    OpenArgs.dwFlags = CASC_OPEN_PERF_COUNTERS;
+    if(!CascOpenStorageEx(NULL, &OpenArgs, false, &hBaseStorage))
+        return GetCascError();
+
+    // The same build again. Everything is reused
+    OpenArgs.hBaseStorage = hBaseStorage;
+    if(CascOpenStorageEx(NULL, &OpenArgs, false, &hStorage))
+    {
+        Result.ErrorCount += VerifyReuseCounters(hStorage, CASC_INDEX_COUNT, Storage.EncodingPageCount);
+        Result.ErrorCount += VerifyIncrementalStorage(hStorage, hBaseStorage, IncrParams.dwFileCount, pbBuffer);
+        CascCloseStorage(hStorage);
+    }
+    else
+    {
+        Result.ErrorCount++;
+    }
+
+    // Create the next build while the previous one is open
+    if((dwErrCode = Storage.Update(BENCH_INCR_CHANGED)) != ERROR_SUCCESS)
+    {
+        CascCloseStorage(hBaseStorage);
+        return dwErrCode;
+    }
+    IncrParams.dwFileCount += IncrParams.dwStagedFiles;
+
+    // The update must leave something to reuse and something to load
+    if(Storage.UnchangedIndexCount == 0 || Storage.UnchangedIndexCount == CASC_INDEX_COUNT || Storage.StagedUnchangedCount == 0)
+        Result.ErrorCount++;
+    if(Storage.UnchangedPageCount == 0 || Storage.UnchangedPageCount == Storage.EncodingPageCount)
+        Result.ErrorCount++;
+
+    // Full open of the new build, for comparison
+    OpenArgs.hBaseStorage = NULL;
+    if(!CascOpenStorageEx(NULL, &OpenArgs, false, &hFullStorage))
+    {
+        CascCloseStorage(hBaseStorage);
+        return GetCascError();
+    }
+    Result.ErrorCount += VerifyFileCKeys(hFullStorage, Storage, IncrParams.dwFileCount);
+
+    OpenArgs.hBaseStorage = hBaseStorage;
+    for(DWORD i = 0; i < BENCH_OPEN_ROUNDS; i++)
+    {
+        StartTime = GetTimeMs();
+        if(!CascOpenStorageEx(NULL, &OpenArgs, false, &hStorage))
+        {
+            Result.ErrorCount++;
+            break;
+        }
+        StartTime = GetTimeMs() - StartTime;
+        MinTime = CASCLIB_MIN(MinTime, StartTime);
+
+        // Verify the storage from the last round
+        if((i + 1) == BENCH_OPEN_ROUNDS)
+        {
+            Result.ErrorCount += VerifyReuseCounters(hStorage, Storage.UnchangedIndexCount, Storage.UnchangedPageCount);
+            Result.ErrorCount += VerifyIncrementalStorage(hStorage, hFullStorage, IncrParams.dwFileCount, pbBuffer);
+            Result.ErrorCount += VerifyFileCKeys(hStorage, Storage, IncrParams.dwFileCount);
+            PrintReuseCounters(hStorage);
+        }
+        CascCloseStorage(hStorage);
+    }
+    CascCloseStorage(hFullStorage);
+    CascCloseStorage(hBaseStorage);
+
+    Result.TimeMs = MinTime;
+    Result.ItemCount = BENCH_OPEN_ROUNDS;
+    return ERROR_SUCCESS;
+}
+
+// Random files, random positions within the files
+static DWORD Bench_ReadRandom(HANDLE hStorage, DWORD dwFileCount, DWORD dwSeed, LPBYTE pbBuffer, BENCH_RESULT & Result)
+{
+    ULONGLONG StartTime = GetTimeMs();
+    ULONGLONG FileSize;
+    ULONGLONG Random = dwSeed | 1;
+    HANDLE hFile;
+    DWORD dwBytesRead;
+
+    for(DWORD i = 0; i < BENCH_RANDOM_READS; i++)
+    {
+        // xorshift64
+        Random ^= Random << 13;
+        Random ^= Random >> 7;
+        Random ^= Random << 17;
+
+        if(CascOpenFile(hStorage, CASC_FILE_DATA_ID((DWORD)(Random % dwFileCount) + 1), 0, CASC_OPEN_BY_FILEID, &hFile))
+        {
+            if(CascGetFileSize64(hFile, &FileSize) && CascSetFilePointer64(hFile, (LONGLONG)((Random >> 32) % FileSize), NULL, FILE_BEGIN))
+            {
+                if(CascReadFile(hFile, pbBuffer, BENCH_RANDOM_READ_SIZE, &dwBytesRead))
+                    Result.ByteCount += dwBytesRead;
+                else
+                    Result.ErrorCount++;
+            }
+            else
+            {
+                Result.ErrorCount++;
+            }
+            CascCloseFile(hFile);
+        }
+        else
+        {
+            Result.ErrorCount++;
+        }
+        Result.ItemCount++;
+    }
+
+    Result.TimeMs = GetTimeMs() - StartTime;
+    return ERROR_SUCCESS;
+}
+
+// Opens a small set of files over and over and queries their information, which needs
+// the BLTE frame tables. No data is decoded, so the cost of loading the frame tables dominates
+static DWORD Bench_ReopenHot(HANDLE hStorage, DWORD dwFileCount, BENCH_RESULT & Result)
+{
+    CASC_FILE_FULL_INFO FileInfo;
+    ULONGLONG StartTime = GetTimeMs();
+    HANDLE hFile;
+    DWORD dwHotFiles = CASCLIB_MIN(dwFileCount, BENCH_HOT_FILES);
+
+    for(DWORD i = 0; i < BENCH_HOT_ROUNDS; i++)
+    {
+        for(DWORD j = 0; j < dwHotFiles; j++)
+        {
+            if(CascOpenFile(hStorage, CASC_FILE_DATA_ID(j + 1), 0, CASC_OPEN_BY_FILEID, &hFile))
+            {
+                if(!CascGetFileInfo(hFile, CascFileFullInfo, &FileInfo, sizeof(CASC_FILE_FULL_INFO), NULL))
+                    Result.ErrorCount++;
+                CascCloseFile(hFile);
+            }
+            else
+            {
+                Result.ErrorCount++;
+            }
+            Result.ItemCount++;
+        }
+    }
+
+    Result.TimeMs = GetTimeMs() - StartTime;
+    return ERROR_SUCCESS;
+}
+
+// The same as Bench_ReopenHot, on a storage without the cache of the frame tables
+static DWORD Bench_ReopenHotNoCache(LPCTSTR szStoragePath, DWORD dwFlags, DWORD dwFileCount, BENCH_RESULT & Result)
+{
+    CASC_OPEN_STORAGE_ARGS OpenArgs = {sizeof(CASC_OPEN_STORAGE_ARGS)};
+    HANDLE hStorage;
+
+    OpenArgs.szLocalPath = szStoragePath;
+    OpenArgs.dwFlags = dwFlags | CASC_OPEN_NO_FRAME_CACHE;
+    if(!CascOpenStorageEx(NULL, &OpenArgs, false, &hStorage))
+        return GetCascError();
+
+    Bench_ReopenHot(hStorage, dwFileCount, Result);
+    CascCloseStorage(hStorage);
+    return ERROR_SUCCESS;
+}
+
+// Sums the pages of the private (copy-on-write) mappings of the segment that the process
+// has written to and so has its own copies of. Returns false if the system doesn't tell
+static bool GetCopiedSegmentBytes(LPCTSTR szSegmentName, ULONGLONG & MappedBytes, ULONGLONG & CopiedBytes)
+{
+#ifdef CASCLIB_PLATFORM_LINUX
+    unsigned long long StartAddress;
+    unsigned long long EndAddress;
+    unsigned long long CopiedKB;
+    size_t nNameLength = strlen(szSegmentName);
+    size_t nLineLength;
+    FILE * fp;
+    char szPerms[8];
+    char szLine[0x200];
+    bool bInSegment = false;
+
+    MappedBytes = CopiedBytes = 0;
+    if((fp = fopen("/proc/self/smaps", "rt")) == NULL)
+        return false;
+
+    while(fgets(szLine, sizeof(szLine), fp) != NULL)
+    {
+        // Header of a mapping: "start-end perms offset dev inode path"
+        if(sscanf(szLine, "%llx-%llx %7s", &StartAddress, &EndAddress, szPerms) == 3)
+        {
+            nLineLength = strlen(szLine);
+            while(nLineLength > 0 && isspace((unsigned char)szLine[nLineLength - 1]))
+                szLine[--nLineLength] = 0;
+
+            bInSegment = (szPerms[3] == 'p' && nLineLength > nNameLength && !strcmp(szLine + nLineLength - nNameLength, szSegmentName));
+            if(bInSegment)
+                MappedBytes += EndAddress - StartAddress;
+            continue;
+        }
+
+        // Copied pages of a private file mapping are anonymous
+        if(bInSegment && sscanf(szLine, "Anonymous: %llu kB", &CopiedKB) == 1)
+            CopiedBytes += CopiedKB * 1024;
+    }
+
+    fclose(fp);
+    return (MappedBytes != 0);
+#else
+    CASCLIB_UNUSED(szSegmentName);
+    MappedBytes = CopiedBytes = 0;
+    return false;
+#endif
+}
+
+// Opens the storage once to publish its index to a shared memory segment, then opens it
+// again and again like other processes would, with the index mapped from the segment
+static DWORD Bench_OpenShared(LPCTSTR szStoragePath, DWORD dwFlags, DWORD dwFileCount, LPBYTE pbBuffer, BENCH_RESULT & Result)
+{
+    CASC_OPEN_STORAGE_ARGS OpenArgs = {sizeof(CASC_OPEN_STORAGE_ARGS)};
+    ULONGLONG MinTime = (ULONGLONG)-1;
+    ULONGLONG StartTime;
+    HANDLE hPublisher;
+    HANDLE hStorage;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    OpenArgs.szLocalPath = szStoragePath;
+    OpenArgs.dwFlags = dwFlags;
+    OpenArgs.szSharedIndex = BENCH_SHARED_INDEX;
+
+    // Remove a segment left by a previous run. The publishing storage stays open,
+    // because on Windows, the segment only exists while somebody has it open
+    CASC_SHARED_MEMORY::Unlink(BENCH_SHARED_INDEX);
+    if(!CascOpenStorageEx(NULL, &OpenArgs, false, &hPublisher))
+        return GetCascError();
+
+    for(DWORD i = 0; i < BENCH_OPEN_ROUNDS; i++)
+    {
+        StartTime = GetTimeMs();
+        if(!CascOpenStorageEx(NULL, &OpenArgs, false, &hStorage))
+        {
+            dwErrCode = GetCascError();
+            break;
+        }
+        StartTime = GetTimeMs() - StartTime;
+        MinTime = CASCLIB_MIN(MinTime, StartTime);
+
+        // Verify the storage from the last round. It must have been attached to the segment
+        if((i + 1) == BENCH_OPEN_ROUNDS)
+        {
+            BENCH_RESULT Verify = {0};
+            DWORD dwFeatures = 0;
+
+            ULONGLONG MappedBytes;
+            ULONGLONG CopiedBytes;
+
+            CascGetStorageInfo(hStorage, CascStorageFeatures, &dwFeatures, sizeof(DWORD), NULL);
+            Result.ErrorCount += (dwFeatures & CASC_FEATURE_SHARED_INDEX) ? 0 : 1;
+
+            // Loading the ROOT file must not have copied the file entries from the segment
+            if(GetCopiedSegmentBytes(BENCH_SHARED_INDEX, MappedBytes, CopiedBytes))
+            {
+                printf("Shared index: " fmt_I64u " KB mapped, " fmt_I64u " KB copied\n", MappedBytes / 1024, CopiedBytes / 1024);
+                Result.ErrorCount += (CopiedBytes > (MappedBytes / BENCH_SHARED_COPIED)) ? 1 : 0;
+            }
+
+            Bench_ReadSequential(hStorage, dwFileCount, pbBuffer, Verify);
+            Bench_TagQuery(hStorage, dwFileCount, Verify);
+            Result.ErrorCount += Verify.ErrorCount;
+        }
+        CascCloseStorage(hStorage);
+    }
+
+    CascCloseStorage(hPublisher);
+    CASC_SHARED_MEMORY::Unlink(BENCH_SHARED_INDEX);
+
+    Result.TimeMs = MinTime;
+    Result.ItemCount = BENCH_OPEN_ROUNDS;
+    return dwErrCode;
+}
+
+// Starts an asynchronous read of the whole file
+static bool StartAsyncRead(HANDLE hStorage, HANDLE hQueue, DWORD dwFileDataId, BENCH_ASYNC_SLOT * pSlot)
+{
+    CASC_FILE_FULL_INFO FileInfo;
+
+    if(CascOpenFile(hStorage, CASC_FILE_DATA_ID(dwFileDataId), 0, CASC_OPEN_BY_FILEID, &pSlot->hFile))
+    {
+        if(CascGetFileInfo(pSlot->hFile, CascFileFullInfo, &FileInfo, sizeof(CASC_FILE_FULL_INFO), NULL))
+        {
+            memcpy(pSlot->CKey, FileInfo.CKey, MD5_HASH_SIZE);
+            pSlot->FileSize = FileInfo.ContentSize;
+
+            if((pSlot->pbBuffer = CASC_ALLOC<BYTE>((size_t)pSlot->FileSize + 1)) != NULL)
+            {
+                if(CascReadFileAsync(hQueue, pSlot->hFile, 0, pSlot->pbBuffer, (DWORD)pSlot->FileSize, pSlot))
+                    return true;
+                CASC_FREE(pSlot->pbBuffer);
+            }
+        }
+        CascCloseFile(pSlot->hFile);
+    }
+    return false;
+}
+
+// Checks the result of an asynchronous read and frees the slot
+static bool FinishAsyncRead(const CASC_READ_COMPLETION & Completion, BENCH_ASYNC_SLOT * pSlot, ULONGLONG & ByteCount)
+{
+    MD5_CTX md5_ctx;
+    BYTE FileHash[MD5_HASH_SIZE];
+    bool bResult = false;
+
+    if(Completion.dwErrCode == ERROR_SUCCESS && Completion.dwBytesRead == pSlot->FileSize)
+    {
+        MD5_Init(&md5_ctx);
+        MD5_Update(&md5_ctx, pSlot->pbBuffer, Completion.dwBytesRead);
+        MD5_Final(FileHash, &md5_ctx);
+        bResult = (memcmp(FileHash, pSlot->CKey, MD5_HASH_SIZE) == 0);
+    }
+
+    ByteCount += Completion.dwBytesRead;
+    CascCloseFile(pSlot->hFile);
+    CASC_FREE(pSlot->pbBuffer);
+    return bResult;
+}
+
+// Reads all files through the asynchronous read queue, keeping BENCH_ASYNC_DEPTH reads in flight
+static DWORD Bench_ReadAsync(HANDLE hStorage, DWORD dwFileCount, DWORD dwQueueFlags, BENCH_RESULT & Result)
+{
+    CASC_READ_COMPLETION Completions[BENCH_ASYNC_DEPTH];
+    BENCH_ASYNC_SLOT * FreeSlots[BENCH_ASYNC_DEPTH];
+    BENCH_ASYNC_SLOT Slots[BENCH_ASYNC_DEPTH];
+    ULONGLONG StartTime = GetTimeMs();
+    HANDLE hQueue;
+    DWORD dwFreeSlots = 0;
+    DWORD dwCompleted = 0;
+    DWORD dwNextFile = 0;
+
+    if((hQueue = CascCreateReadQueue(0, dwQueueFlags)) == NULL)
+        return GetCascError();
+
+    for(DWORD i = 0; i < BENCH_ASYNC_DEPTH; i++)
+        FreeSlots[dwFreeSlots++] = &Slots[i];
+
+    while(dwNextFile < dwFileCount || dwFreeSlots < BENCH_ASYNC_DEPTH)
+    {
+        // Fill the queue
+        while(dwNextFile < dwFileCount && dwFreeSlots > 0)
+        {
+            BENCH_ASYNC_SLOT * pSlot = FreeSlots[--dwFreeSlots];
+
+            if(!StartAsyncRead(hStorage, hQueue, ++dwNextFile, pSlot))
+            {
+                FreeSlots[dwFreeSlots++] = pSlot;
+                Result.ErrorCount++;
+            }
+            Result.ItemCount++;
+        }
+
+        // Collect the completed reads
+        if(dwFreeSlots < BENCH_ASYNC_DEPTH && CascGetReadCompletions(hQueue, Completions, BENCH_ASYNC_DEPTH, &dwCompleted, true))
+        {
+            for(DWORD i = 0; i < dwCompleted; i++)
+            {
+                BENCH_ASYNC_SLOT * pSlot = (BENCH_ASYNC_SLOT *)Completions[i].pvUserData;
+
+                Result.ErrorCount += FinishAsyncRead(Completions[i], pSlot, Result.ByteCount) ? 0 : 1;
+                FreeSlots[dwFreeSlots++] = pSlot;
+            }
+        }
+    }
+
+    CascCloseReadQueue(hQueue);
+    Result.TimeMs = GetTimeMs() - StartTime;
+    return ERROR_SUCCESS;
+}
+
+static DWORD ReadSharedWorker(void * pvContext, size_t nPiece)
+{
+    BENCH_SHARED_READ * pBatch = (BENCH_SHARED_READ *)pvContext;
+    ULONGLONG ByteOffset;
+    DWORD dwBytesToRead;
+    DWORD dwBytesRead = 0;
+    DWORD i = 0;
+
+    // Find the file of the piece
+    while(pBatch->FirstPiece[i + 1] <= nPiece)
+        i++;
+    ByteOffset = (ULONGLONG)(nPiece - pBatch->FirstPiece[i]) * BENCH_SHARED_PIECE;
+    dwBytesToRead = (DWORD)CASCLIB_MIN(pBatch->FileSize[i] - ByteOffset, BENCH_SHARED_PIECE);
+
+    if(!CascReadFileAt(pBatch->hFiles[i], ByteOffset, pBatch->pbData[i] + ByteOffset, dwBytesToRead, &dwBytesRead) || dwBytesRead != dwBytesToRead)
+        CascInterlockedIncrement(&pBatch->dwErrors);
+    return ERROR_SUCCESS;
+}
+
+// Reads all files by pieces, with BENCH_SHARED_THREADS threads reading the same file handle
+// at once by CascReadFileAt. The pieces of one frame are read by different threads
+static DWORD Bench_ReadShared(HANDLE hStorage, DWORD dwFileCount, BENCH_RESULT & Result)
+{
+    BENCH_SHARED_READ Batch;
+    CASC_FILE_FULL_INFO FileInfo;
+    ULONGLONG StartTime = GetTimeMs();
+    MD5_CTX md5_ctx;
+    BYTE FileHash[MD5_HASH_SIZE];
+    BYTE CKeys[BENCH_SHARED_FILES][MD5_HASH_SIZE];
+
+    for(DWORD dwFirstFile = 0; dwFirstFile < dwFileCount; dwFirstFile += BENCH_SHARED_FILES)
+    {
+        // Open the files of the batch
+        memset(&Batch, 0, sizeof(BENCH_SHARED_READ));
+        for(DWORD i = dwFirstFile; i < dwFileCount && Batch.dwFileCount < BENCH_SHARED_FILES; i++)
+        {
+            DWORD dwIndex = Batch.dwFileCount;
+            HANDLE hFile = NULL;
+
+            Result.ItemCount++;
+            if(!CascOpenFile(hStorage, CASC_FILE_DATA_ID(i + 1), 0, CASC_OPEN_BY_FILEID, &hFile) ||
+               !CascGetFileInfo(hFile, CascFileFullInfo, &FileInfo, sizeof(CASC_FILE_FULL_INFO), NULL) ||
+               (Batch.pbData[dwIndex] = CASC_ALLOC<BYTE>((size_t)FileInfo.ContentSize + 1)) == NULL)
+            {
+                if(hFile != NULL)
+                    CascCloseFile(hFile);
+                Result.ErrorCount++;
+                continue;
+            }
+
+            Batch.hFiles[dwIndex] = hFile;
+            Batch.FileSize[dwIndex] = FileInfo.ContentSize;
+            Batch.FirstPiece[dwIndex + 1] = Batch.FirstPiece[dwIndex] + (size_t)((FileInfo.ContentSize + BENCH_SHARED_PIECE - 1) / BENCH_SHARED_PIECE);
+            memcpy(CKeys[dwIndex], FileInfo.CKey, MD5_HASH_SIZE);
+            Batch.dwFileCount++;
+        }
+
+        // Read the pieces of all files
+        CascRunWorkers(ReadSharedWorker, &Batch, Batch.FirstPiece[Batch.dwFileCount], BENCH_SHARED_THREADS);
+        Result.ErrorCount += Batch.dwErrors;
+
+        // Verify and close the files
+        for(DWORD i = 0; i < Batch.dwFileCount; i++)
+        {
+            MD5_Init(&md5_ctx);
+            MD5_Update(&md5_ctx, Batch.pbData[i], (unsigned long)Batch.FileSize[i]);
+            MD5_Final(FileHash, &md5_ctx);
+            Result.ErrorCount += memcmp(FileHash, CKeys[i], MD5_HASH_SIZE) ? 1 : 0;
+            Result.ByteCount += Batch.FileSize[i];
+
+            CascCloseFile(Batch.hFiles[i]);
+            CASC_FREE(Batch.pbData[i]);
+        }
+    }
+
+    Result.TimeMs = GetTimeMs() - StartTime;
+    return ERROR_SUCCESS;
+}
+
+// Resolves the names of all files, either one name per call or all names in one call.
+// The expected CKeys are resolved by file data id before the time measurement starts
+static DWORD Bench_Resolve(HANDLE hStorage, DWORD dwFileCount, bool bBatch, BENCH_RESULT & Result)
+{
+    PCASC_RESOLVED_FILE pExpected;
+    PCASC_RESOLVED_FILE pResults;
+    const void ** FileNames;
+    const void ** FileIds;
+    ULONGLONG StartTime;
+    char * szNames;
+
+    // Prepare the names, file data ids and the result arrays
+    szNames = CASC_ALLOC<char>(dwFileCount * MAX_PATH);
+    FileNames = CASC_ALLOC<const void *>(dwFileCount);
+    FileIds = CASC_ALLOC<const void *>(dwFileCount);
+    pExpected = CASC_ALLOC<CASC_RESOLVED_FILE>(dwFileCount);
+    pResults = CASC_ALLOC<CASC_RESOLVED_FILE>(dwFileCount);
+    if(szNames != NULL && FileNames != NULL && FileIds != NULL && pExpected != NULL && pResults != NULL)
+    {
+        for(DWORD i = 0; i < dwFileCount; i++)
+        {
+            TSyntheticStorage::GetFileName(szNames + i * MAX_PATH, MAX_PATH, i);
+            FileNames[i] = szNames + i * MAX_PATH;
+            FileIds[i] = CASC_FILE_DATA_ID(i + 1);
+        }
+        CascResolveFiles(hStorage, FileIds, dwFileCount, CASC_OPEN_BY_FILEID, pExpected, NULL);
+
+        StartTime = GetTimeMs();
+        for(DWORD i = 0; i < BENCH_RESOLVE_ROUNDS; i++)
+        {
+            if(bBatch)
+            {
+                CascResolveFiles(hStorage, FileNames, dwFileCount, CASC_OPEN_BY_NAME, pResults, NULL);
+            }
+            else
+            {
+                for(DWORD j = 0; j < dwFileCount; j++)
+                    CascResolveFiles(hStorage, FileNames + j, 1, CASC_OPEN_BY_NAME, pResults + j, NULL);
+            }
+            Result.ItemCount += dwFileCount;
+        }
+        Result.TimeMs = GetTimeMs() - StartTime;
+
+        // Verify the results of the last round
+        for(DWORD i = 0; i < dwFileCount; i++)
+        {
+            if(pResults[i].dwErrCode != ERROR_SUCCESS || memcmp(pResults[i].CKey, pExpected[i].CKey, MD5_HASH_SIZE))
+                Result.ErrorCount++;
+        }
+    }
+
+    CASC_FREE(pResults);
+    CASC_FREE(pExpected);
+    CASC_FREE(FileIds);
+    CASC_FREE(FileNames);
+    CASC_FREE(szNames);
+    return ERROR_SUCCESS;
+}
+
+// Looks up the names of the static encryption keys, BENCH_KEY_LOOKUPS times in total.
+// A key name may be in the table more than once; the first entry is the one that must be found
+static DWORD Bench_KeyLookup(HANDLE hStorage, BENCH_RESULT & Result)
+{
+    PCASC_ENCRYPTION_KEY StaticKeys;
+    ULONGLONG StartTime;
+    size_t nKeyCount = 0;
+    size_t nKeyIndex = 0;
+    size_t * FirstIndex;
+
+    // Find the first entry of every key name before the time measurement starts
+    StaticKeys = CASC_KEY_MAP::GetStaticKeys(nKeyCount);
+    if((FirstIndex = CASC_ALLOC<size_t>(nKeyCount)) != NULL)
+    {
+        for(size_t i = 0; i < nKeyCount; i++)
+        {
+            FirstIndex[i] = i;
+            for(size_t j = 0; j < i; j++)
+            {
+                if(StaticKeys[j].KeyName == StaticKeys[i].KeyName)
+                {
+                    FirstIndex[i] = j;
+                    break;
+                }
+            }
+        }
+
+        StartTime = GetTimeMs();
+        for(DWORD i = 0; i < BENCH_KEY_LOOKUPS; i++)
+        {
+            LPBYTE pbKey = CascFindEncryptionKey(hStorage, StaticKeys[nKeyIndex].KeyName);
+
+            if(pbKey == NULL || memcmp(pbKey, StaticKeys[FirstIndex[nKeyIndex]].Key, CASC_KEY_LENGTH))
+                Result.ErrorCount++;
+            nKeyIndex = (nKeyIndex + 1 < nKeyCount) ? (nKeyIndex + 1) : 0;
+            Result.ItemCount++;
+        }
+        Result.TimeMs = GetTimeMs() - StartTime;
+        CASC_FREE(FirstIndex);
+    }
+    return ERROR_SUCCESS;
+}
+
+// Verifies all data of the storage. A freshly generated storage must have no damage
+static DWORD Bench_Scrub(HANDLE hStorage, BENCH_RESULT & Result)
+{
+    CASC_SCRUB_RESULT ScrubResult;
+    CASC_SCRUB_ARGS ScrubArgs = {sizeof(CASC_SCRUB_ARGS)};
+
+    if(!CascScrubStorage(hStorage, &ScrubArgs, &ScrubResult))
+        Result.ErrorCount += (ScrubResult.DamagedCount != 0) ? (DWORD)ScrubResult.DamagedCount : 1;
+
+    Result.TimeMs = ScrubResult.ElapsedMs;
+    Result.ByteCount = ScrubResult.BytesVerified;
+    Result.ItemCount = (DWORD)ScrubResult.EntryCount;
+    return ERROR_SUCCESS;
+}
+
+// Flips one byte of a generated file in data.000
+static bool DamageDataFile(LPCTSTR szStoragePath, ULONGLONG ByteOffset)
+{
+    TFileStream * pStream;
+    TCHAR szDataFile[MAX_PATH];
+    BYTE OneByte = 0;
+    bool bResult = false;
+
+    CombinePath(szDataFile, _countof(szDataFile), szStoragePath, _T("data"), _T("data"), _T("data.000"), NULL);
+    if((pStream = FileStream_OpenFile(szDataFile, BASE_PROVIDER_FILE | STREAM_PROVIDER_FLAT)) != NULL)
+    {
+        if(FileStream_Read(pStream, &ByteOffset, &OneByte, 1))
+        {
+            OneByte ^= 0xFF;
+            bResult = FileStream_Write(pStream, &ByteOffset, &OneByte, 1);
+        }
+        FileStream_Close(pStream);
+    }
+    return bResult;
+}
+
+// Verifies that the scrub finds every type of damage in a deliberately damaged storage, and nothing else
+static DWORD Bench_ScrubDamage(const SYNTH_PARAMS & Params, BENCH_RESULT & Result)
+{
+    CASC_SCRUB_RESULT ScrubResult;
+    CASC_SCRUB_ENTRY Damaged[0x20];
+    CASC_SCRUB_ENTRY Expected[0x20];
+    CASC_SCRUB_ARGS ScrubArgs = {sizeof(CASC_SCRUB_ARGS)};
+    TSyntheticStorage Storage;
+    SYNTH_PARAMS DamageParams = Params;
+    SYNTH_FILE * pFile;
+    HANDLE hStorage = NULL;
+    size_t nExpected = 0;
+    TCHAR szStoragePath[MAX_PATH];
+    DWORD dwFrameless = 0;
+    DWORD dwErrCode;
+
+    #define EXPECT_DAMAGE(offs, type)  { Expected[nExpected].StorageOffset = offs; Expected[nExpected++].Damage = type; }
+
+    CombinePath(szStoragePath, _countof(szStoragePath), Params.szStoragePath, _T("scrub"), NULL);
+    DamageParams.szStoragePath = szStoragePath;
+    DamageParams.dwFileCount = BENCH_DAMAGED_FILES;
+    DamageParams.dwMinFileSize = 0x100;
+    DamageParams.dwMaxFileSize = 0x1000;
+    DamageParams.dwFrameSize = 0x1000;
+    DamageParams.dwCdnPort = 0;
+    DamageParams.dwStagedFiles = 0;
+    DamageParams.dwDamage = SYNTH_DAMAGE_CONTENT_KEY | SYNTH_DAMAGE_INDEX_SIZE | SYNTH_DAMAGE_OVERLAP | SYNTH_DAMAGE_ENCODING_PAGE;
+
+    if((dwErrCode = Storage.Generate(DamageParams)) != ERROR_SUCCESS)
+        return dwErrCode;
+
+    // Damage done by the generator. The index entry of file 2 overlaps file 3 and file 4.
+    // File 4 only overlaps file 2, which is not the entry right before it. The ENCODING
+    // entry is only matched by the damage type
+    EXPECT_DAMAGE(Storage.FileAt(0)->StorageOffset, CascScrubContent);
+    EXPECT_DAMAGE(Storage.FileAt(1)->StorageOffset, CascScrubIndexMismatch);
+    EXPECT_DAMAGE(Storage.FileAt(1)->StorageOffset, CascScrubLocalHeader);
+    EXPECT_DAMAGE(Storage.FileAt(2)->StorageOffset, CascScrubIndexMismatch);
+    EXPECT_DAMAGE(Storage.FileAt(2)->StorageOffset, CascScrubLocalHeader);
+    EXPECT_DAMAGE(Storage.FileAt(3)->StorageOffset, CascScrubIndexMismatch);
+    EXPECT_DAMAGE(Storage.FileAt(4)->StorageOffset, CascScrubIndexMismatch);
+    EXPECT_DAMAGE(0, CascScrubEncodingPage);
+
+    // Damage the local header of file 5
+    pFile = Storage.FileAt(5);
+    Result.ErrorCount += DamageDataFile(szStoragePath, pFile->StorageOffset + 15) ? 0 : 1;
+    EXPECT_DAMAGE(pFile->StorageOffset, CascScrubLocalHeader);
+
+    // Damage the data of a file without frame table and with 'N' frames (index is a multiple of 8). Only the EKey covers it
+    for(DWORD i = 8; i < BENCH_DAMAGED_FILES && dwFrameless == 0; i += 8)
+        dwFrameless = (Storage.FileAt(i)->ContentSize <= DamageParams.dwFrameSize) ? i : 0;
+    if(dwFrameless != 0)
+    {
+        pFile = Storage.FileAt(dwFrameless);
+        Result.ErrorCount += DamageDataFile(szStoragePath, pFile->StorageOffset + pFile->EncodedSize - 1) ? 0 : 1;
+        EXPECT_DAMAGE(pFile->StorageOffset, CascScrubEKey);
+    }
+    else
+    {
+        Result.ErrorCount++;
+    }
+
+    // Damage the last frame of file 12. It always has a frame table
+    pFile = Storage.FileAt(12);
+    Result.ErrorCount += DamageDataFile(szStoragePath, pFile->StorageOffset + pFile->EncodedSize - 1) ? 0 : 1;
+    EXPECT_DAMAGE(pFile->StorageOffset, CascScrubFrameHash);
+
+    if(!CascOpenStorage(szStoragePath, 0, &hStorage))
+        return GetCascError();
+
+    // Every expected damage must be found exactly once, and nothing else
+    ScrubArgs.pDamaged = Damaged;
+    ScrubArgs.nMaxDamaged = _countof(Damaged);
+    if(CascScrubStorage(hStorage, &ScrubArgs, &ScrubResult) || GetCascError() != ERROR_FILE_CORRUPT)
+        Result.ErrorCount++;
+    Result.ErrorCount += (ScrubResult.DamagedCount != nExpected) ? 1 : 0;
+    for(size_t i = 0; i < nExpected; i++)
+    {
+        DWORD dwFound = 0;
+
+        for(size_t j = 0; j < CASCLIB_MIN(ScrubResult.DamagedCount, _countof(Damaged)); j++)
+        {
+            if(Damaged[j].Damage == Expected[i].Damage && (Damaged[j].StorageOffset == Expected[i].StorageOffset || Expected[i].Damage == CascScrubEncodingPage))
+                dwFound++;
+        }
+        Result.ErrorCount += (dwFound != 1) ? 1 : 0;
+    }
+    CascCloseStorage(hStorage);
+
+    #undef EXPECT_DAMAGE
+
+    Result.TimeMs = ScrubResult.ElapsedMs;
+    Result.ByteCount = ScrubResult.BytesVerified;
+    Result.ItemCount = (DWORD)ScrubResult.DamagedCount;
+    return ERROR_SUCCESS;
+}
+
+// Extracts all files by name into a work directory
+static DWORD Bench_Extract(HANDLE hStorage, LPCTSTR szStoragePath, LPCTSTR szListFile, LPBYTE pbBuffer, BENCH_RESULT & Result)
+{
+    CASC_FIND_DATA cf;
+    TFileStream * pStream;
+    ULONGLONG StartTime = GetTimeMs();
+    HANDLE hFind;
+    HANDLE hFile;
+    TCHAR szWorkDir[MAX_PATH];
+    TCHAR szPlainName[MAX_PATH];
+    TCHAR szTargetFile[MAX_PATH];
+    bool bFileFound = true;
+
+    CombinePath(szWorkDir, _countof(szWorkDir), szStoragePath, _T("extract"), NULL);
+    MakeDirectory(szWorkDir);
+
+    if((hFind = CascFindFirstFile(hStorage, "*", &cf, szListFile)) == INVALID_HANDLE_VALUE)
+        return GetCascError();
+
+    while(bFileFound)
+    {
+        // The plain names of the synthetic files are unique, so we put them all into one directory
+        CascStrCopy(szPlainName, _countof(szPlainName), cf.szPlainName);
+        CombinePath(szTargetFile, _countof(szTargetFile), szWorkDir, szPlainName, NULL);
+
+        if(CascOpenFile(hStorage, cf.szFileName, 0, 0, &hFile))
+        {
+            if((pStream = FileStream_CreateFile(szTargetFile, BASE_PROVIDER_FILE | STREAM_PROVIDER_FLAT)) != NULL)
+            {
+                Result.ErrorCount += ReadAndVerifyFile(hFile, pbBuffer, Result.ByteCount, pStream) ? 0 : 1;
+                FileStream_Close(pStream);
+            }
+            else
+            {
+                Result.ErrorCount++;
+            }
+            CascCloseFile(hFile);
+        }
+        else
+        {
+            Result.ErrorCount++;
+        }
+
+        Result.ItemCount++;
+        bFileFound = CascFindNextFile(hFind, &cf);
+    }
+    CascFindClose(hFind);
+
+    Result.TimeMs = GetTimeMs() - StartTime;
+    return ERROR_SUCCESS;
+}
+
+// Extracts all files by CascExtractFiles, in the storage order and on all cores
+static DWORD Bench_ExtractTree(HANDLE hStorage, LPCTSTR szStoragePath, LPCTSTR szListFile, BENCH_RESULT & Result)
+{
+    CASC_EXTRACT_RESULT ExtractResult;
+    CASC_EXTRACT_ARGS ExtractArgs = {sizeof(CASC_EXTRACT_ARGS)};
+    TCHAR szWorkDir[MAX_PATH];
+
+    CombinePath(szWorkDir, _countof(szWorkDir), szStoragePath, _T("extract-tree"), NULL);
+    ExtractArgs.dwFlags = CASC_EXTRACT_VERIFY;
+    ExtractArgs.szListFile = szListFile;
+
+    if(!CascExtractFiles(hStorage, "*", szWorkDir, &ExtractArgs, &ExtractResult))
+        Result.ErrorCount += (ExtractResult.FilesFailed != 0) ? (DWORD)ExtractResult.FilesFailed : 1;
+
+    Result.TimeMs = ExtractResult.ElapsedMs;
+    Result.ByteCount = ExtractResult.ContentBytes;
+    Result.ItemCount = (DWORD)(ExtractResult.FilesExtracted + ExtractResult.FilesLinked);
+    return ERROR_SUCCESS;
+}
+
+// Reads a multi-span file by name and checks each span against the generated file.
+// Then it checks that the extracted file is the same as the content read by name
+static bool VerifySpannedFile(HANDLE hStorage, TSyntheticStorage & Storage, LPCTSTR szWorkDir, DWORD dwGroupIndex, ULONGLONG & ByteCount)
+{
+    ULONGLONG FileSize = 0;
+    ULONGLONG ByteOffset = 0;
+    LPBYTE pbFileData = NULL;
+    LPBYTE pbExtracted = NULL;
+    HANDLE hFile = NULL;
+    TCHAR szFileName[MAX_PATH];
+    TCHAR szTargetFile[MAX_PATH];
+    char szSpannedName[MAX_PATH];
+    DWORD dwFirstFile = (dwGroupIndex + 1) * SYNTH_SPAN_GROUP - SYNTH_SPAN_COUNT;
+    DWORD cbExtracted = 0;
+    DWORD dwBytesRead = 0;
+    bool bResult = false;
+
+    TSyntheticStorage::GetSpannedFileName(szSpannedName, _countof(szSpannedName), dwGroupIndex);
+    if(CascOpenFile(hStorage, szSpannedName, 0, 0, &hFile) && CascGetFileSize64(hFile, &FileSize))
+    {
+        if((pbFileData = CASC_ALLOC<BYTE>((size_t)FileSize + 1)) != NULL)
+        {
+            if(CascReadFile(hFile, pbFileData, (DWORD)FileSize, &dwBytesRead) && dwBytesRead == FileSize)
+            {
+                // The content is the spans, one after another
+                bResult = true;
+                for(DWORD i = 0; i < SYNTH_SPAN_COUNT && bResult; i++)
+                {
+                    SYNTH_FILE * pSpanFile = Storage.FileAt(dwFirstFile + i);
+                    BYTE SpanHash[MD5_HASH_SIZE];
+
+                    bResult = (ByteOffset + pSpanFile->ContentSize) <= FileSize;
+                    if(bResult)
+                    {
+                        CascCalculateDataBlockHash(pbFileData + ByteOffset, pSpanFile->ContentSize, SpanHash);
+                        bResult = (memcmp(SpanHash, pSpanFile->CKey, MD5_HASH_SIZE) == 0);
+                        ByteOffset += pSpanFile->ContentSize;
+                    }
+                }
+                bResult = bResult && (ByteOffset == FileSize);
+            }
+        }
+    }
+
+    // The extracted file must be the same
+    if(bResult)
+    {
+        CascStrCopy(szFileName, _countof(szFileName), szSpannedName);
+        CombinePath(szTargetFile, _countof(szTargetFile), szWorkDir, szFileName, NULL);
+        pbExtracted = LoadFileToMemory(szTargetFile, &cbExtracted);
+        bResult = (pbExtracted != NULL && cbExtracted == FileSize && !memcmp(pbExtracted, pbFileData, cbExtracted));
+        ByteCount += FileSize;
+    }
+
+    if(hFile != NULL)
+        CascCloseFile(hFile);
+    CASC_FREE(pbExtracted);
+    CASC_FREE(pbFileData);
+    return bResult;
+}
+
+// Reads a file that is only in the TVFS root by name. Such file has no CKey in the storage,
+// so its content is checked against the generated file
+static bool VerifyUnlistedFile(HANDLE hStorage, TSyntheticStorage & Storage, DWORD dwFileIndex, ULONGLONG & ByteCount)
+{
+    SYNTH_FILE * pFile = Storage.FileAt(dwFileIndex);
+    ULONGLONG FileSize = 0;
+    LPBYTE pbFileData = NULL;
+    HANDLE hFile = NULL;
+    BYTE FileHash[MD5_HASH_SIZE];
+    char szFileName[MAX_PATH];
+    DWORD dwBytesRead = 0;
+    bool bResult = false;
+
+    TSyntheticStorage::GetTvfsFileName(szFileName, _countof(szFileName), dwFileIndex);
+    if(CascOpenFile(hStorage, szFileName, 0, 0, &hFile) && CascGetFileSize64(hFile, &FileSize) && FileSize == pFile->ContentSize)
+    {
+        if((pbFileData = CASC_ALLOC<BYTE>((size_t)FileSize + 1)) != NULL)
+        {
+            if(CascReadFile(hFile, pbFileData, (DWORD)FileSize, &dwBytesRead) && dwBytesRead == FileSize)
+            {
+                CascCalculateDataBlockHash(pbFileData, dwBytesRead, FileHash);
+                bResult = (memcmp(FileHash, pFile->CKey, MD5_HASH_SIZE) == 0);
+                ByteCount += FileSize;
+            }
+        }
+    }
+
+    if(hFile != NULL)
+        CascCloseFile(hFile);
+    CASC_FREE(pbFileData);
+    return bResult;
+}
+
+// Verifies the multi-span files and the files that are only in the TVFS root
+static void VerifyTvfsFiles(HANDLE hStorage, TSyntheticStorage & Storage, LPCTSTR szWorkDir, BENCH_RESULT & Result)
+{
+    for(DWORD i = 0; i < (BENCH_TVFS_FILES / SYNTH_SPAN_GROUP); i++)
+    {
+        Result.ErrorCount += VerifySpannedFile(hStorage, Storage, szWorkDir, i, Result.ByteCount) ? 0 : 1;
+        Result.ErrorCount += VerifyUnlistedFile(hStorage, Storage, i * SYNTH_SPAN_GROUP, Result.ByteCount) ? 0 : 1;
+        Result.ItemCount++;
+    }
+}
+
+// Each two files that are only in the TVFS root have the same name when extracted.
+// Only one of them may be extracted, and it must not be damaged by the other one
+static DWORD VerifyCollidingNames(TSyntheticStorage & Storage, LPCTSTR szWorkDir, const CASC_EXTRACT_RESULT & ExtractResult)
+{
+    DWORD dwPairCount = (BENCH_TVFS_FILES / SYNTH_SPAN_GROUP) / 2;
+    DWORD dwErrorCount = (ExtractResult.FilesSkipped == dwPairCount) ? 0 : 1;
+
+    for(DWORD i = 0; i < dwPairCount; i++)
+    {
+        SYNTH_FILE * pFile1 = Storage.FileAt((i * 2) * SYNTH_SPAN_GROUP);
+        SYNTH_FILE * pFile2 = Storage.FileAt((i * 2 + 1) * SYNTH_SPAN_GROUP);
+        LPBYTE pbExtracted;
+        TCHAR szFileName[MAX_PATH];
+        TCHAR szTargetFile[MAX_PATH];
+        BYTE FileHash[MD5_HASH_SIZE];
+        DWORD cbExtracted = 0;
+
+        CascStrPrintf(szFileName, _countof(szFileName), _T("misc/unlisted%05u_.dat"), i);
+        CombinePath(szTargetFile, _countof(szTargetFile), szWorkDir, szFileName, NULL);
+        if((pbExtracted = LoadFileToMemory(szTargetFile, &cbExtracted)) != NULL)
+        {
+            CascCalculateDataBlockHash(pbExtracted, cbExtracted, FileHash);
+            dwErrorCount += (memcmp(FileHash, pFile1->CKey, MD5_HASH_SIZE) && memcmp(FileHash, pFile2->CKey, MD5_HASH_SIZE)) ? 1 : 0;
+            CASC_FREE(pbExtracted);
+        }
+        else
+        {
+            dwErrorCount++;
+        }
+    }
+    return dwErrorCount;
+}
+
+// Generates a small storage with TVFS root and multi-span files and extracts it by CascExtractFiles.
+// CascExtractFiles doesn't verify multi-span files, so each of them is compared with its content
+// read by name. Then the files are verified again in a storage attached to a shared index, because the ROOT
+// handler of such storage needs the index files for the files that are not in ENCODING.
+// The storage is small, so it's always generated. Item count is the number of multi-span files
+static DWORD Bench_TvfsSpans(const SYNTH_PARAMS & Params, BENCH_RESULT & Result)
+{
+    CASC_OPEN_STORAGE_ARGS OpenArgs = {sizeof(CASC_OPEN_STORAGE_ARGS)};
+    CASC_EXTRACT_RESULT ExtractResult;
+    CASC_EXTRACT_ARGS ExtractArgs = {sizeof(CASC_EXTRACT_ARGS)};
+    TSyntheticStorage Storage;
+    SYNTH_PARAMS TvfsParams = Params;
+    ULONGLONG StartTime = GetTimeMs();
+    HANDLE hPublisher = NULL;
+    HANDLE hStorage = NULL;
+    DWORD dwFeatures = 0;
+    TCHAR szStoragePath[MAX_PATH];
+    TCHAR szWorkDir[MAX_PATH];
+    DWORD dwErrCode;
+
+    CombinePath(szStoragePath, _countof(szStoragePath), Params.szStoragePath, _T("tvfs"), NULL);
+    CombinePath(szWorkDir, _countof(szWorkDir), szStoragePath, _T("extract"), NULL);
+    TvfsParams.szStoragePath = szStoragePath;
+    TvfsParams.dwFileCount = BENCH_TVFS_FILES;
+    TvfsParams.dwCdnPort = 0;
+    TvfsParams.bTvfsRoot = true;
+
+    if((dwErrCode = Storage.Generate(TvfsParams)) != ERROR_SUCCESS)
+        return dwErrCode;
+    if(!CascOpenStorage(szStoragePath, 0, &hStorage))
+        return GetCascError();
+
+    ExtractArgs.dwFlags = CASC_EXTRACT_VERIFY;
+    if(!CascExtractFiles(hStorage, "*", szWorkDir, &ExtractArgs, &ExtractResult))
+        Result.ErrorCount += (ExtractResult.FilesFailed != 0) ? (DWORD)ExtractResult.FilesFailed : 1;
+    Result.ErrorCount += VerifyCollidingNames(Storage, szWorkDir, ExtractResult);
+
+    VerifyTvfsFiles(hStorage, Storage, szWorkDir, Result);
+    CascCloseStorage(hStorage);
+
+    // The first storage publishes the index, the second one attaches to it
+    OpenArgs.szLocalPath = szStoragePath;
+    OpenArgs.szSharedIndex = BENCH_SHARED_INDEX;
+    CASC_SHARED_MEMORY::Unlink(BENCH_SHARED_INDEX);
+    if(!CascOpenStorageEx(NULL, &OpenArgs, false, &hPublisher))
+        return GetCascError();
+    if(CascOpenStorageEx(NULL, &OpenArgs, false, &hStorage))
+    {
+        CascGetStorageInfo(hStorage, CascStorageFeatures, &dwFeatures, sizeof(DWORD), NULL);
+        Result.ErrorCount += (dwFeatures & CASC_FEATURE_SHARED_INDEX) ? 0 : 1;
+        VerifyTvfsFiles(hStorage, Storage, szWorkDir, Result);
+        CascCloseStorage(hStorage);
+    }
+    else
+    {
+        Result.ErrorCount++;
+    }
+    CascCloseStorage(hPublisher);
+    CASC_SHARED_MEMORY::Unlink(BENCH_SHARED_INDEX);
+
+    Result.TimeMs = GetTimeMs() - StartTime;
+    return ERROR_SUCCESS;
+}
+
+// Queries over the tags of a storage whose file names come from the INSTALL manifest.
+// The INSTALL tag names are longer than the DOWNLOAD tag names
+static const char * InstallQueries[] =
+{
+    "Windows",
+    "speech_enus_optional",
+    "Installer_Only_Content & !Speech_enUS_Optional",
+    "deDE | Installer_Only_Content"
+};
+
+static bool MatchInstallQuery(size_t nQuery, DWORD dwFileIndex)
+{
+    #define HAS_TAG(n)  TSyntheticStorage::FileHasTag(dwFileIndex, n)
+
+    switch(nQuery)
+    {
+        case 0: return HAS_TAG(0);
+        case 1: return HAS_TAG(SYNTH_TAG_COUNT);
+        case 2: return HAS_TAG(SYNTH_TAG_COUNT + 1) && !HAS_TAG(SYNTH_TAG_COUNT);
+        case 3: return HAS_TAG(5) || HAS_TAG(SYNTH_TAG_COUNT + 1);
+    }
+
+    #undef HAS_TAG
+    return false;
+}
+
+// Storage without usable ROOT. The file names and part of the tags come from INSTALL
+static DWORD Bench_InstallTags(const SYNTH_PARAMS & Params, BENCH_RESULT & Result)
+{
+    TSyntheticStorage Storage;
+    SYNTH_PARAMS InstallParams = Params;
+    CASC_FIND_DATA cf;
+    ULONGLONG StartTime = GetTimeMs();
+    HANDLE hStorage = NULL;
+    HANDLE hFind;
+    HANDLE hFile;
+    TCHAR szStoragePath[MAX_PATH];
+    BYTE CKey[MD5_HASH_SIZE];
+    char szFileName[MAX_PATH];
+    DWORD dwErrCode;
+
+    CombinePath(szStoragePath, _countof(szStoragePath), Params.szStoragePath, _T("install"), NULL);
+    InstallParams.szStoragePath = szStoragePath;
+    InstallParams.dwFileCount = BENCH_TVFS_FILES;
+    InstallParams.dwCdnPort = 0;
+    InstallParams.bInstallRoot = true;
+
+    if((dwErrCode = Storage.Generate(InstallParams)) != ERROR_SUCCESS)
+        return dwErrCode;
+    if(!CascOpenStorage(szStoragePath, 0, &hStorage))
+        return GetCascError();
+
+    // All files must be found by their names from INSTALL
+    for(DWORD i = 0; i < BENCH_TVFS_FILES; i++)
+    {
+        TSyntheticStorage::GetFileName(szFileName, _countof(szFileName), i);
+        if(CascOpenFile(hStorage, szFileName, 0, 0, &hFile))
+        {
+            if(!CascGetFileInfo(hFile, CascFileContentKey, CKey, sizeof(CKey), NULL) || memcmp(CKey, Storage.FileAt(i)->CKey, MD5_HASH_SIZE))
+                Result.ErrorCount++;
+            CascCloseFile(hFile);
+        }
+        else
+        {
+            Result.ErrorCount++;
+        }
+    }
+
+    // The tags of both manifests must be queryable
+    for(size_t i = 0; i < _countof(InstallQueries); i++)
+    {
+        DWORD dwExpected = 0;
+        DWORD dwFound = 0;
+
+        if((hFind = CascFindFirstTaggedFile(hStorage, InstallQueries[i], &cf)) != INVALID_HANDLE_VALUE)
+        {
+            do
+            {
+                dwFound++;
+            }
+            while(CascFindNextFile(hFind, &cf));
+            CascFindClose(hFind);
+        }
+
+        for(DWORD j = 0; j < BENCH_TVFS_FILES; j++)
+            dwExpected += MatchInstallQuery(i, j) ? 1 : 0;
+        Result.ErrorCount += (dwFound != dwExpected) ? 1 : 0;
+        Result.ItemCount += dwFound;
+    }
+
+    CascCloseStorage(hStorage);
+    Result.TimeMs = GetTimeMs() - StartTime;
+    return ERROR_SUCCESS;
+}
+
+// Opens the online storage from the mock CDN. The open is retried, because it fails
+// if the injected failure hits "versions" or "cdns". Item count is the number of HTTP requests
+static HANDLE Bench_OnlineOpen(CASC_OPEN_STORAGE_ARGS & OpenArgs, TMockCdnServer & Server, BENCH_RESULT & Result)
+{
+    MOCK_CDN_STATS StatsBefore;
+    MOCK_CDN_STATS StatsAfter;
+    ULONGLONG StartTime = GetTimeMs();
+    HANDLE hStorage = NULL;
+
+    Server.GetStats(StatsBefore);
+    for(DWORD i = 0; i < BENCH_ONLINE_TRIES; i++)
+    {
+        if(CascOpenStorageEx(NULL, &OpenArgs, true, &hStorage))
+            break;
+        Result.ErrorCount++;
+        hStorage = NULL;
+    }
+    Server.GetStats(StatsAfter);
+
+    Result.TimeMs = GetTimeMs() - StartTime;
+    Result.ByteCount = StatsAfter.BytesSent - StatsBefore.BytesSent;
+    Result.ItemCount = StatsAfter.Requests - StatsBefore.Requests;
+    return hStorage;
+}
+
+// Reads all files of an online storage. Item count is the number of files, any HTTP request
+// counts as an error if the files are expected to be in the CDN cache
+static void Bench_OnlineRead(HANDLE hStorage, DWORD dwFileCount, LPBYTE pbBuffer, TMockCdnServer & Server, bool bCached, BENCH_RESULT & Result)
+{
+    MOCK_CDN_STATS StatsBefore;
+    MOCK_CDN_STATS StatsAfter;
+
+    Server.GetStats(StatsBefore);
+    Bench_ReadSequential(hStorage, dwFileCount, pbBuffer, Result);
+    Server.GetStats(StatsAfter);
+
+    if(bCached)
+        Result.ErrorCount += StatsAfter.Requests - StatsBefore.Requests;
+}
+
+static void PrintCdnCache(HANDLE hStorage, const char * szTitle)
+{
+    CASC_CDN_CACHE_INFO Info;
+
+    if(CascGetStorageInfo(hStorage, CascStorageCdnCache, &Info, sizeof(CASC_CDN_CACHE_INFO), NULL))
+    {
+        printf("CDN cache (%s): " fmt_I64u " hits, " fmt_I64u " misses, " fmt_I64u " evictions, " fmt_I64u " files in " fmt_I64u " of " fmt_I64u " bytes\n",
+            szTitle,
+            Info.Hits,
+            Info.Misses,
+            Info.Evictions,
+            Info.EntryCount,
+            Info.BytesUsed,
+            Info.BytesMax);
+    }
+}
+
+// Serves the CDN tree of the synthetic storage by the mock CDN server. Then it opens
+// the storage with an empty cache, reads all files (which downloads all archived
+// and loose files to the CDN cache) and opens the storage again, with all files in the cache.
+// The incremental open uses the warm storage as the base storage. The last pass reads
+// all files through a CDN cache with a quarter of the budget, which keeps evicting files
+static DWORD Bench_Online(const SYNTH_PARAMS & Params, MOCK_CDN_PARAMS & MockParams, LPBYTE pbBuffer, BENCH_RESULT * Results)
+{
+    CASC_OPEN_STORAGE_ARGS OpenArgs = {sizeof(CASC_OPEN_STORAGE_ARGS)};
+    TMockCdnServer Server;
+    MOCK_CDN_STATS Stats;
+    HANDLE hIncrStorage;
+    HANDLE hStorage;
+    TCHAR szCdnRoot[MAX_PATH];
+    TCHAR szCachePath[MAX_PATH];
+    TCHAR szSmallCache[MAX_PATH];
+    TCHAR szOrphanFile[MAX_PATH];
+    TCHAR szCdnHostUrl[0x40];
+    CASC_CDN_CACHE_INFO IncrCacheInfo = {0};
+    CASC_CDN_CACHE_INFO CacheInfo = {0};
+    TFileStream * pStream;
+    BENCH_RESULT BudgetOpen = {NULL};
+    DWORD dwErrCode;
+
+    CombinePath(szCdnRoot, _countof(szCdnRoot), Params.szStoragePath, _T("cdn"), NULL);
+    CombinePath(szCachePath, _countof(szCachePath), Params.szStoragePath, _T("cdn-cache"), NULL);
+    CombinePath(szSmallCache, _countof(szSmallCache), Params.szStoragePath, _T("cdn-cache-small"), NULL);
+    CascStrPrintf(szCdnHostUrl, _countof(szCdnHostUrl), _T("http://127.0.0.1:%u"), Params.dwCdnPort);
+
+    MockParams.szRootPath = szCdnRoot;
+    MockParams.dwPortNum = Params.dwCdnPort;
+    if((dwErrCode = Server.Start(MockParams)) != ERROR_SUCCESS)
+        return dwErrCode;
+
+    OpenArgs.szLocalPath = szCachePath;
+    OpenArgs.szCodeName = SYNTH_CDN_PRODUCT;
+    OpenArgs.szRegion = _T("us");
+    OpenArgs.szCdnHostUrl = szCdnHostUrl;
+
+    // Cold open and read of all files
+    RemoveDirectoryTree(szCachePath);
+    if((hStorage = Bench_OnlineOpen(OpenArgs, Server, Results[0])) == NULL)
+        return GetCascError();
+    Bench_OnlineRead(hStorage, Params.dwFileCount, pbBuffer, Server, false, Results[1]);
+    CascGetStorageInfo(hStorage, CascStorageCdnCache, &CacheInfo, sizeof(CASC_CDN_CACHE_INFO), NULL);
+    PrintCdnCache(hStorage, "cold");
+    CascCloseStorage(hStorage);
+
+    // Warm open and read of all files from the CDN cache. The open must delete
+    // the temporary files left by a download that never finished
+    CombinePath(szOrphanFile, _countof(szOrphanFile), szCachePath, _T("cache"), _T("orphan.1.1.tmp"), NULL);
+    FileStream_Close(FileStream_CreateFile(szOrphanFile, BASE_PROVIDER_FILE | STREAM_PROVIDER_FLAT));
+    if((hStorage = Bench_OnlineOpen(OpenArgs, Server, Results[2])) == NULL)
+        return GetCascError();
+    if((pStream = FileStream_OpenFile(szOrphanFile, BASE_PROVIDER_FILE | STREAM_PROVIDER_FLAT | STREAM_FLAG_READ_ONLY)) != NULL)
+    {
+        FileStream_Close(pStream);
+        Results[2].ErrorCount++;
+    }
+    Bench_OnlineRead(hStorage, Params.dwFileCount, pbBuffer, Server, true, Results[3]);
+    PrintCdnCache(hStorage, "warm");
+
+    // Incremental open, with the warm storage as the base
+    OpenArgs.hBaseStorage = hStorage;
+    if((hIncrStorage = Bench_OnlineOpen(OpenArgs, Server, Results[4])) != NULL)
+    {
+        // The base storage owns the CDN cache, so the incremental one must run without it
+        CascGetStorageInfo(hIncrStorage, CascStorageCdnCache, &IncrCacheInfo, sizeof(CASC_CDN_CACHE_INFO), NULL);
+        if(IncrCacheInfo.BytesMax != 0)
+            Results[4].ErrorCount++;
+        Results[4].ErrorCount += VerifyIncrementalStorage(hIncrStorage, hStorage, Params.dwFileCount, pbBuffer);
+        CascCloseStorage(hIncrStorage);
+    }
+    CascCloseStorage(hStorage);
+
+    // Read of all files through a CDN cache that can't hold them all
+    OpenArgs.hBaseStorage = NULL;
+    OpenArgs.szCdnCache = szSmallCache;
+    OpenArgs.CdnCacheSize = (CacheInfo.BytesUsed / 4) + 1;
+    RemoveDirectoryTree(szSmallCache);
+    if((hStorage = Bench_OnlineOpen(OpenArgs, Server, BudgetOpen)) != NULL)
+    {
+        Results[5].ErrorCount = BudgetOpen.ErrorCount;
+        Bench_OnlineRead(hStorage, Params.dwFileCount, pbBuffer, Server, false, Results[5]);
+        PrintCdnCache(hStorage, "budget");
+        CascCloseStorage(hStorage);
+    }
+
+    Server.GetStats(Stats);
+    Server.Stop();
+    printf("Mock CDN: %u connections, %u requests (%u ranges), %u not found, %u failures injected, " fmt_I64u " bytes sent\n",
+        Stats.Connections,
+        Stats.Requests,
+        Stats.RangeRequests,
+        Stats.NotFound,
+        Stats.Failures,
+        Stats.BytesSent);
+    return ERROR_SUCCESS;
+}
+
+static void PrintPerfCounters(HANDLE hStorage)
+{
+    CASC_STORAGE_PERF_COUNTERS Counters;
+
+    if(!CascGetStorageInfo(hStorage, CascStoragePerfCounters, &Counters, sizeof(CASC_STORAGE_PERF_COUNTERS), NULL))
+    {
+        printf("\nPerformance counters not available (error code %u)\n", GetCascError());
+        return;
+    }
+
+    printf("\nPerformance counters (times in ms)\n");
+    printf("-----------------------------------------------------------------\n");
+    printf("Open:    total %u, config %u, index %u, encoding %u, download %u, root %u\n",
+        (DWORD)(Counters.OpenTotalTime / 1000),
+        (DWORD)(Counters.OpenConfigTime / 1000),
+        (DWORD)(Counters.OpenIndexTime / 1000),
+        (DWORD)(Counters.OpenEncodingTime / 1000),
+        (DWORD)(Counters.OpenDownloadTime / 1000),
+        (DWORD)(Counters.OpenRootTime / 1000));
+    printf("Disk:    " fmt_I64u " reads, " fmt_I64u " bytes, " fmt_I64u " stream opens\n", Counters.DiskReadCount, Counters.DiskBytesRead, Counters.DataStreamOpens);
+    printf("CDN:     " fmt_I64u " downloads, " fmt_I64u " bytes, %u ms\n", Counters.CdnDownloadCount, Counters.CdnBytesDownloaded, (DWORD)(Counters.CdnDownloadTime / 1000));
+    printf("Frames:  " fmt_I64u " plain, " fmt_I64u " N, " fmt_I64u " Z, " fmt_I64u " E, " fmt_I64u " verified\n",
+        Counters.FramesPlain,
+        Counters.FramesNormal,
+        Counters.FramesCompressed,
+        Counters.FramesEncrypted,
+        Counters.FramesVerified);
+    printf("Decode:  total %u, decompress %u, decrypt %u, verify %u\n",
+        (DWORD)(Counters.DecodeTime / 1000),
+        (DWORD)(Counters.DecompressTime / 1000),
+        (DWORD)(Counters.DecryptTime / 1000),
+        (DWORD)(Counters.VerifyTime / 1000));
+    printf("Cache:   " fmt_I64u " hits, " fmt_I64u " misses\n", Counters.CacheHits, Counters.CacheMisses);
+    printf("Maps:    " fmt_I64u " lookups, %.2f probes per lookup\n", Counters.MapLookups, Counters.MapLookups ? (double)Counters.MapProbes / (double)Counters.MapLookups : 0.0);
+}
+
+static void PrintStorageMemory(HANDLE hStorage)
+{
+    CASC_STORAGE_MEMORY Memory;
+
+    if(CascGetStorageInfo(hStorage, CascStorageMemory, &Memory, sizeof(CASC_STORAGE_MEMORY), NULL))
+    {
+        printf("Arena:   " fmt_I64u " allocations, " fmt_I64u " bytes in " fmt_I64u " blocks, " fmt_I64u " bytes used, " fmt_I64u " peak\n",
+            Memory.ArenaAllocations,
+            Memory.ArenaReserved,
+            Memory.ArenaBlocks,
+            Memory.ArenaUsed,
+            Memory.ArenaPeak);
+    }
+}
+
+static void PrintFrameCache(HANDLE hStorage)
+{
+    CASC_FRAME_CACHE_INFO Info;
+
+    if(CascGetStorageInfo(hStorage, CascStorageFrameCache, &Info, sizeof(CASC_FRAME_CACHE_INFO), NULL))
+    {
+        printf("BLTE:    " fmt_I64u " cached frame table hits, " fmt_I64u " misses, " fmt_I64u " evictions, " fmt_I64u " tables in " fmt_I64u " of " fmt_I64u " bytes\n",
+            Info.Hits,
+            Info.Misses,
+            Info.Evictions,
+            Info.EntryCount,
+            Info.BytesUsed,
+            Info.BytesMax);
+    }
+}
+
+static void PrintUsage()
+{
+    printf("Usage: casc_bench -d <directory> [-n <file count>] [-s <min size>] [-S <max size>] [-f <frame size>] [-r <seed>] [-x] [-p]\n");
+    printf("                  [-c <port> [-l <latency>] [-b <bandwidth>] [-e <failure rate>]]\n\n");
+    printf("  -d  Directory where the synthetic storage will be created\n");
+    printf("  -n  Number of files in the storage\n");
+    printf("  -s  Minimal file size\n");
+    printf("  -S  Maximal file size. File sizes are skewed towards small files\n");
+    printf("  -f  Content size of one BLTE frame\n");
+    printf("  -r  Random seed. The same seed always generates the same storage\n");
+    printf("  -x  Skip generation; use the storage that is already in the directory\n");
+    printf("  -p  Collect and show the performance counters of the storage\n");
+    printf("  -c  Create the CDN tree too and benchmark the online storage, served by a mock CDN on 127.0.0.1:<port>\n");
+    printf("  -l  Latency of the mock CDN in milliseconds\n");
+    printf("  -b  Bandwidth of one mock CDN connection in KB/s\n");
+    printf("  -e  Percentage of the mock CDN requests that fail\n");
+}
+
+//-----------------------------------------------------------------------------
+// Main
+
+int main(int argc, char * argv[])
+{
+    CASC_OPEN_STORAGE_ARGS OpenArgs = {sizeof(CASC_OPEN_STORAGE_ARGS)};
+    MOCK_CDN_PARAMS MockParams;
+    BENCH_RESULT Results[29];
+    SYNTH_PARAMS Params;
+    HANDLE hStorage = NULL;
+    LPBYTE pbBuffer = NULL;
+    TCHAR szStoragePath[MAX_PATH] = {0};
+    TCHAR szListFile[MAX_PATH];
+    DWORD dwErrCode = ERROR_SUCCESS;
+    bool bGenerate = true;
+
+    // Parse the command line
+    for(int i = 1; i < argc; i++)
+    {
+        if(argv[i][0] != '-' || argv[i][1] == 0 || argv[i][2] != 0)
+        {
+            PrintUsage();
+            return ERROR_INVALID_PARAMETER;
+        }
+
+        if(argv[i][1] == 'x')
+        {
+            bGenerate = false;
+            continue;
+        }
+
+        if(argv[i][1] == 'p')
+        {
+            OpenArgs.dwFlags |= CASC_OPEN_PERF_COUNTERS;
+            continue;
+        }
+
+        if((i + 1) >= argc)
+        {
+            PrintUsage();
+            return ERROR_INVALID_PARAMETER;
+        }
+
+        switch(argv[i][1])
+        {
+            case 'd': CascStrCopy(szStoragePath, _countof(szStoragePath), argv[++i]); break;
+            case 'n': Params.dwFileCount = strtoul(argv[++i], NULL, 0); break;
+            case 's': Params.dwMinFileSize = strtoul(argv[++i], NULL, 0); break;
+            case 'S': Params.dwMaxFileSize = strtoul(argv[++i], NULL, 0); break;
+            case 'f': Params.dwFrameSize = strtoul(argv[++i], NULL, 0); break;
+            case 'r': Params.dwSeed = strtoul(argv[++i], NULL, 0); break;
+            case 'c': Params.dwCdnPort = strtoul(argv[++i], NULL, 0); break;
+            case 'l': MockParams.dwLatencyMs = strtoul(argv[++i], NULL, 0); break;
+            case 'b': MockParams.dwBandwidth = strtoul(argv[++i], NULL, 0); break;
+            case 'e': MockParams.dwFailRate = strtoul(argv[++i], NULL, 0); break;
+            default:
+                PrintUsage();
+                return ERROR_INVALID_PARAMETER;
+        }
+    }
+
+    if(szStoragePath[0] == 0)
+    {
+        PrintUsage();
+        return ERROR_INVALID_PARAMETER;
+    }
+
+    Params.szStoragePath = szStoragePath;
+    CombinePath(szListFile, _countof(szListFile), szStoragePath, _T("listfile.txt"), NULL);
+    memset(Results, 0, sizeof(Results));
+    Results[0].szPhase = "Generate";
+    Results[1].szPhase = "Open";
+    Results[2].szPhase = "Enumerate";
+    Results[3].szPhase = "ReadSeq";
+    Results[4].szPhase = "ReadRandom";
+    Results[5].szPhase = "ReadWhole";
+    Results[6].szPhase = "ResolveOne";
+    Results[7].szPhase = "ResolveBatch";
+    Results[8].szPhase = "Extract";
+    Results[9].szPhase = "ReadAsync";
+    Results[10].szPhase = "AsyncPool";
+    Results[11].szPhase = "TagQuery";
+    Results[12].szPhase = "OpenIncr";
+    Results[13].szPhase = "ReopenHot";
+    Results[14].szPhase = "ReopenNoCache";
+    Results[15].szPhase = "OpenShared";
+    Results[16].szPhase = "Scrub";
+    Results[17].szPhase = "ExtractTree";
+    Results[18].szPhase = "ReadShared";
+    Results[19].szPhase = "TvfsSpans";
+    Results[20].szPhase = "InstallTags";
+    Results[21].szPhase = "ScrubDamage";
+    Results[22].szPhase = "KeyLookup";
+    Results[23].szPhase = "OnlineOpen";
+    Results[24].szPhase = "OnlineRead";
+    Results[25].szPhase = "OnlineWarm";
+    Results[26].szPhase = "OnlineCached";
+    Results[27].szPhase = "OnlineIncr";
+    Results[28].szPhase = "OnlineBudget";
+
+    if(bGenerate)
+        dwErrCode = Bench_Generate(Params, Results[0]);
+
+    if(dwErrCode == ERROR_SUCCESS)
+        dwErrCode = Bench_OpenStorage(szStoragePath, Results[1]);
+
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        if((pbBuffer = CASC_ALLOC<BYTE>(BENCH_BUFFER_SIZE)) == NULL)
+            dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        if(CascOpenStorageEx(szStoragePath, &OpenArgs, false, &hStorage))
+        {
+            Bench_EnumFiles(hStorage, szListFile, Results[2]);
+            Bench_ReadSequential(hStorage, Params.dwFileCount, pbBuffer, Results[3]);
+            Bench_ReadRandom(hStorage, Params.dwFileCount, Params.dwSeed, pbBuffer, Results[4]);
+            Bench_ReadWhole(hStorage, Params.dwFileCount, Results[5]);
+            Bench_Resolve(hStorage, Params.dwFileCount, false, Results[6]);
+            Bench_Resolve(hStorage, Params.dwFileCount, true, Results[7]);
+            Bench_Extract(hStorage, szStoragePath, szListFile, pbBuffer, Results[8]);
+            Bench_ReadAsync(hStorage, Params.dwFileCount, 0, Results[9]);
+            Bench_ReadAsync(hStorage, Params.dwFileCount, CASC_READ_QUEUE_THREAD_POOL, Results[10]);
+            Bench_TagQuery(hStorage, Params.dwFileCount, Results[11]);
+            Bench_ReopenHot(hStorage, Params.dwFileCount, Results[13]);
+            Bench_ReopenHotNoCache(szStoragePath, OpenArgs.dwFlags, Params.dwFileCount, Results[14]);
+            Bench_OpenShared(szStoragePath, OpenArgs.dwFlags, Params.dwFileCount, pbBuffer, Results[15]);
+            Bench_Scrub(hStorage, Results[16]);
+            Bench_ExtractTree(hStorage, szStoragePath, szListFile, Results[17]);
+            Bench_ReadShared(hStorage, Params.dwFileCount, Results[18]);
+            Bench_KeyLookup(hStorage, Results[22]);
+            if(OpenArgs.dwFlags & CASC_OPEN_PERF_COUNTERS)
+            {
+                PrintPerfCounters(hStorage);
+                PrintStorageMemory(hStorage);
+                PrintFrameCache(hStorage);
+            }
+            CascCloseStorage(hStorage);
+        }
+        else
+        {
+            dwErrCode = GetCascError();
+        }
+    }
+
+    if(dwErrCode == ERROR_SUCCESS)
+        dwErrCode = Bench_OpenIncremental(Params, pbBuffer, Results[12]);
+
+    if(dwErrCode == ERROR_SUCCESS)
+        dwErrCode = Bench_TvfsSpans(Params, Results[19]);
+
+    if(dwErrCode == ERROR_SUCCESS)
+        dwErrCode = Bench_InstallTags(Params, Results[20]);
+
+    if(dwErrCode == ERROR_SUCCESS)
+        dwErrCode = Bench_ScrubDamage(Params, Results[21]);
+
+    if(dwErrCode == ERROR_SUCCESS && Params.dwCdnPort != 0)
+        dwErrCode = Bench_Online(Params, MockParams, pbBuffer, Results + 23);
+
+    if(dwErrCode == ERROR_SUCCESS)
+    {
+        printf("\nPhase             Items       Time         Throughput   Errors\n");
+        printf("-----------------------------------------------------------------\n");
+        for(size_t i = (bGenerate ? 0 : 1); i < ((Params.dwCdnPort != 0) ? 29 : 23); i++)
+            PrintResult(Results[i]);
+    }
+    else
+    {
+        printf("Benchmark failed (error code %u)\n", dwErrCode);
+    }
+
+    CASC_FREE(pbBuffer);
+    return (int)dwErrCode;
+}
@@ -0,0 +1,811 @@
+/*****************************************************************************/
+/* CascFuse.cpp                           Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Read-only FUSE file system (libfuse3). Mounts an opened storage, so that  */
+/* the files can be read on demand instead of being extracted first          */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 19.10.26  1.00  Lad  The first version of CascFuse.cpp                    */
+/*****************************************************************************/
+
+#define FUSE_USE_VERSION 31
+#define __CASCLIB_SELF__                    // Don't use CascLib.lib
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <dirent.h>
+#include <fuse.h>
+
+#include "../src/CascLib.h"
+#include "../src/CascCommon.h"
+
+//-----------------------------------------------------------------------------
+// Local defines
+
+#define FUSE_DIR_FILEID         "by-fileid"     // Virtual folder with the files by their FileDataId
+#define FUSE_DIR_CKEY           "by-ckey"       // Virtual folder with the files by their content key
+
+#define BENCH_READ_SIZE         0x20000         // Size of one read() in the "cat" benchmark. This is the default FUSE max_read
+#define BENCH_CAT_FILES         1000            // Default number of files read by the "cat" benchmark
+
+//-----------------------------------------------------------------------------
+// Local structures
+
+// One entry of the file system. The entries are sorted by (parent directory, name),
+// so the content of each directory is a continuous range of entries
+struct FUSE_NODE
+{
+    const char * szPath;                    // Full path, separated by '/', without the leading '/'
+    const char * szName;                    // Plain name, pointing into szPath
+    const char * szCascName;                // Files: name of the file in the storage, as given by CascFindFirstFile
+    size_t nPathOffset;                     // Offset of the path in FUSE_CONTEXT::Names. Only used while building the tree
+    size_t nCascNameOffset;                 // Offset of the storage name in FUSE_CONTEXT::Names. Only used while building the tree
+    size_t nFirstChild;                     // Directories: the first entry of the directory
+    size_t nChildCount;                     // Directories: number of entries in the directory
+    ULONGLONG FileSize;                     // Files: size of the file. CASC_INVALID_SIZE64 if not known yet
+    bool bDirectory;
+};
+
+struct FUSE_CONTEXT
+{
+    HANDLE hStorage;                        // The mounted storage
+    CASC_ARRAY Nodes;                       // All entries (FUSE_NODE)
+    CASC_ARRAY Names;                       // Paths of the entries
+    size_t nNodeCount;                      // Number of entries after removing the duplicates
+    CASC_LOCK Lock;                         // Protects the file sizes that are retrieved on demand
+    size_t nRootFirst;                      // The first entry of the root directory
+    size_t nRootCount;                      // Number of entries in the root directory
+    time_t MountTime;                       // Time stamp of all entries
+};
+
+// Latencies of one benchmark operation, in microseconds
+struct BENCH_LATENCY
+{
+    const char * szOperation;
+    CASC_ARRAY Samples;                     // ULONGLONG
+    ULONGLONG ByteCount;
+};
+
+static FUSE_CONTEXT FuseCtx;
+
+//-----------------------------------------------------------------------------
+// Building the file tree
+
+static int CompareNodes(const void * pvNode1, const void * pvNode2)
+{
+    FUSE_NODE * pNode1 = (FUSE_NODE *)pvNode1;
+    FUSE_NODE * pNode2 = (FUSE_NODE *)pvNode2;
+    size_t nParentLength1 = (pNode1->szName > pNode1->szPath) ? (pNode1->szName - pNode1->szPath - 1) : 0;
+    size_t nParentLength2 = (pNode2->szName > pNode2->szPath) ? (pNode2->szName - pNode2->szPath - 1) : 0;
+    int nResult;
+
+    // Compare the parent directories first
+    if((nResult = memcmp(pNode1->szPath, pNode2->szPath, CASCLIB_MIN(nParentLength1, nParentLength2))) != 0)
+        return nResult;
+    if(nParentLength1 != nParentLength2)
+        return (nParentLength1 < nParentLength2) ? -1 : +1;
+
+    // Then the names. If a file has the same name as a directory, the directory wins
+    if((nResult = strcmp(pNode1->szName, pNode2->szName)) != 0)
+        return nResult;
+    return (pNode1->bDirectory == pNode2->bDirectory) ? 0 : (pNode1->bDirectory ? -1 : +1);
+}
+
+static FUSE_NODE * InsertNode(FUSE_CONTEXT & Ctx, const char * szPath, size_t nPathLength, bool bDirectory)
+{
+    FUSE_NODE * pNode;
+    char * szNewPath;
+
+    if((szNewPath = (char *)Ctx.Names.Insert(nPathLength + 1)) == NULL)
+        return NULL;
+    if((pNode = (FUSE_NODE *)Ctx.Nodes.Insert(1)) == NULL)
+        return NULL;
+
+    memcpy(szNewPath, szPath, nPathLength);
+    szNewPath[nPathLength] = 0;
+
+    memset(pNode, 0, sizeof(FUSE_NODE));
+    pNode->nPathOffset = Ctx.Names.IndexOf(szNewPath);
+    pNode->FileSize = CASC_INVALID_SIZE64;
+    pNode->bDirectory = bDirectory;
+    return pNode;
+}
+
+// The file is opened by its name in the storage. Opening by the key would bypass the root
+// handler, which knows the spans of TVFS multi-span files; the entry found by the key
+// is the first span only
+static DWORD InsertFile(FUSE_CONTEXT & Ctx, const char * szPath, CASC_FIND_DATA & cf, size_t nCascNameOffset)
+{
+    FUSE_NODE * pNode;
+
+    if((pNode = InsertNode(Ctx, szPath, strlen(szPath), false)) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    pNode->nCascNameOffset = nCascNameOffset;
+    pNode->FileSize = cf.FileSize;
+    return ERROR_SUCCESS;
+}
+
+static DWORD InsertCascName(FUSE_CONTEXT & Ctx, CASC_FIND_DATA & cf, size_t & nCascNameOffset)
+{
+    size_t nLength = strlen(cf.szFileName) + 1;
+    char * szCascName;
+
+    if((szCascName = (char *)Ctx.Names.Insert(nLength)) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    memcpy(szCascName, cf.szFileName, nLength);
+    nCascNameOffset = Ctx.Names.IndexOf(szCascName);
+    return ERROR_SUCCESS;
+}
+
+// Inserts the directories of the path that were not inserted for the previous file.
+// The files are found in the order of the file tree, so this catches most of them;
+// the rest is removed as duplicates after sorting
+static DWORD InsertDirectories(FUSE_CONTEXT & Ctx, const char * szPath, char * szPrevPath)
+{
+    size_t nSame = 0;
+
+    // Skip the directories shared with the previous file
+    while(szPath[nSame] != 0 && szPath[nSame] == szPrevPath[nSame])
+        nSame++;
+    while(nSame > 0 && !(szPath[nSame] == '/' && szPrevPath[nSame] == '/'))
+        nSame--;
+
+    for(size_t i = (nSame != 0) ? nSame + 1 : 0; szPath[i] != 0; i++)
+    {
+        if(szPath[i] == '/' && InsertNode(Ctx, szPath, i, true) == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    CascStrCopy(szPrevPath, MAX_PATH, szPath);
+    return ERROR_SUCCESS;
+}
+
+static FUSE_NODE * FindNode(FUSE_CONTEXT & Ctx, const char * szPath)
+{
+    FUSE_NODE * pNodes = (FUSE_NODE *)Ctx.Nodes.ItemArray();
+    FUSE_NODE Key;
+    size_t nLow = 0;
+    size_t nHigh = Ctx.nNodeCount;
+
+    // FUSE paths always begin with '/'. The root directory has no entry
+    while(szPath[0] == '/')
+        szPath++;
+    if(szPath[0] == 0)
+        return NULL;
+
+    Key.szPath = szPath;
+    Key.szName = strrchr(szPath, '/');
+    Key.szName = (Key.szName != NULL) ? Key.szName + 1 : szPath;
+    Key.bDirectory = true;
+
+    // Binary search. The file and the directory of the same name were merged
+    while(nLow < nHigh)
+    {
+        size_t nMid = (nLow + nHigh) / 2;
+        int nResult;
+
+        Key.bDirectory = pNodes[nMid].bDirectory;
+        if((nResult = CompareNodes(&Key, &pNodes[nMid])) == 0)
+            return &pNodes[nMid];
+
+        if(nResult > 0)
+            nLow = nMid + 1;
+        else
+            nHigh = nMid;
+    }
+
+    return NULL;
+}
+
+// Sorts the entries, removes the duplicates and links the directories to their content
+static DWORD FinishTree(FUSE_CONTEXT & Ctx)
+{
+    FUSE_NODE * pNodes = (FUSE_NODE *)Ctx.Nodes.ItemArray();
+    const char * szNames = (const char *)Ctx.Names.ItemArray();
+    size_t nNodeCount = Ctx.Nodes.ItemCount();
+    size_t nNewCount = 0;
+
+    // The name buffer doesn't move anymore
+    for(size_t i = 0; i < nNodeCount; i++)
+    {
+        const char * szName;
+
+        pNodes[i].szPath = szNames + pNodes[i].nPathOffset;
+        pNodes[i].szCascName = (pNodes[i].bDirectory) ? NULL : szNames + pNodes[i].nCascNameOffset;
+        szName = strrchr(pNodes[i].szPath, '/');
+        pNodes[i].szName = (szName != NULL) ? szName + 1 : pNodes[i].szPath;
+    }
+    qsort(pNodes, nNodeCount, sizeof(FUSE_NODE), CompareNodes);
+
+    // Remove the duplicates. Names of the same file in different locales keep the first one
+    for(size_t i = 0; i < nNodeCount; i++)
+    {
+        FUSE_NODE * pPrev = (nNewCount != 0) ? &pNodes[nNewCount - 1] : NULL;
+
+        if(pPrev != NULL && pPrev->szName - pPrev->szPath == pNodes[i].szName - pNodes[i].szPath)
+        {
+            if(!strcmp(pPrev->szPath, pNodes[i].szPath))
+                continue;
+        }
+        pNodes[nNewCount++] = pNodes[i];
+    }
+    Ctx.nNodeCount = nNewCount;
+
+    // Link the directories to their entries. The entries of each directory follow each other
+    for(size_t i = 0; i < nNewCount; )
+    {
+        size_t nParentLength = (pNodes[i].szName > pNodes[i].szPath) ? (pNodes[i].szName - pNodes[i].szPath - 1) : 0;
+        size_t nFirst = i;
+        char szParent[MAX_PATH];
+
+        for(i++; i < nNewCount; i++)
+        {
+            size_t nLength = (pNodes[i].szName > pNodes[i].szPath) ? (pNodes[i].szName - pNodes[i].szPath - 1) : 0;
+
+            if(nLength != nParentLength || memcmp(pNodes[i].szPath, pNodes[nFirst].szPath, nLength))
+                break;
+        }
+
+        if(nParentLength != 0)
+        {
+            FUSE_NODE * pParent;
+
+            CascStrCopy(szParent, _countof(szParent), pNodes[nFirst].szPath, nParentLength);
+            if((pParent = FindNode(Ctx, szParent)) != NULL)
+            {
+                pParent->nFirstChild = nFirst;
+                pParent->nChildCount = i - nFirst;
+            }
+        }
+        else
+        {
+            Ctx.nRootFirst = nFirst;
+            Ctx.nRootCount = i - nFirst;
+        }
+    }
+
+    return ERROR_SUCCESS;
+}
+
+static DWORD BuildTree(FUSE_CONTEXT & Ctx, LPCTSTR szListFile)
+{
+    CASC_FIND_DATA cf;
+    HANDLE hFind;
+    char szPrevPath[MAX_PATH] = {0};
+    char szPath[MAX_PATH];
+    DWORD dwErrCode = ERROR_SUCCESS;
+    bool bHasFileIds = false;
+    bool bHasCKeys = false;
+    bool bFileFound = true;
+
+    if((dwErrCode = Ctx.Nodes.Create<FUSE_NODE>(0x10000)) != ERROR_SUCCESS)
+        return dwErrCode;
+    if((dwErrCode = Ctx.Names.Create<char>(0x100000)) != ERROR_SUCCESS)
+        return dwErrCode;
+
+    if((hFind = CascFindFirstFile(Ctx.hStorage, "*", &cf, szListFile)) == INVALID_HANDLE_VALUE)
+        return (GetCascError() == ERROR_NO_MORE_FILES) ? ERROR_SUCCESS : GetCascError();
+
+    while(bFileFound && dwErrCode == ERROR_SUCCESS)
+    {
+        size_t nCascNameOffset = 0;
+        bool bHasCKey = CascIsValidMD5(cf.CKey);
+
+        if((dwErrCode = InsertCascName(Ctx, cf, nCascNameOffset)) != ERROR_SUCCESS)
+            break;
+
+        // Files with a name are put to their directories
+        if(cf.NameType == CascNameFull)
+        {
+            for(size_t i = 0; i < _countof(szPath); i++)
+            {
+                szPath[i] = (cf.szFileName[i] == '\\') ? '/' : cf.szFileName[i];
+                if(szPath[i] == 0)
+                    break;
+            }
+
+            if((dwErrCode = InsertDirectories(Ctx, szPath, szPrevPath)) == ERROR_SUCCESS)
+                dwErrCode = InsertFile(Ctx, szPath, cf, nCascNameOffset);
+        }
+
+        // Virtual folder with the files by FileDataId
+        if(dwErrCode == ERROR_SUCCESS && cf.dwFileDataId != CASC_INVALID_ID)
+        {
+            CascStrPrintf(szPath, _countof(szPath), FUSE_DIR_FILEID "/%u", cf.dwFileDataId);
+            dwErrCode = InsertFile(Ctx, szPath, cf, nCascNameOffset);
+            bHasFileIds = true;
+        }
+
+        // Virtual folder with the files by CKey
+        if(dwErrCode == ERROR_SUCCESS && bHasCKey)
+        {
+            CascStrCopy(szPath, _countof(szPath), FUSE_DIR_CKEY "/");
+            StringFromBinary(cf.CKey, MD5_HASH_SIZE, szPath + strlen(szPath));
+            dwErrCode = InsertFile(Ctx, szPath, cf, nCascNameOffset);
+            bHasCKeys = true;
+        }
+
+        bFileFound = CascFindNextFile(hFind, &cf);
+    }
+    CascFindClose(hFind);
+
+    // Directories of the virtual folders
+    if(dwErrCode == ERROR_SUCCESS && bHasFileIds && InsertNode(Ctx, FUSE_DIR_FILEID, strlen(FUSE_DIR_FILEID), true) == NULL)
+        dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+    if(dwErrCode == ERROR_SUCCESS && bHasCKeys && InsertNode(Ctx, FUSE_DIR_CKEY, strlen(FUSE_DIR_CKEY), true) == NULL)
+        dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+
+    return (dwErrCode == ERROR_SUCCESS) ? FinishTree(Ctx) : dwErrCode;
+}
+
+//-----------------------------------------------------------------------------
+// FUSE operations
+
+// Most of CascLib error codes are errno values on POSIX systems
+static int ErrorToErrno(DWORD dwErrCode)
+{
+    switch(dwErrCode)
+    {
+        case ERROR_SUCCESS:
+            return 0;
+
+        case ERROR_FILE_ENCRYPTED:
+            return -EACCES;
+
+        case ERROR_NOT_ENOUGH_MEMORY:
+            return -ENOMEM;
+
+        case ERROR_FILE_NOT_FOUND:
+            return -ENOENT;
+
+        default:
+            return -EIO;
+    }
+}
+
+// The size is not known for some files until they are opened
+static ULONGLONG GetNodeSize(FUSE_NODE * pNode)
+{
+    ULONGLONG FileSize;
+    HANDLE hFile;
+
+    CascLock(FuseCtx.Lock);
+    FileSize = pNode->FileSize;
+    CascUnlock(FuseCtx.Lock);
+
+    if(FileSize == CASC_INVALID_SIZE64)
+    {
+        if(CascOpenFile(FuseCtx.hStorage, pNode->szCascName, 0, CASC_OPEN_BY_NAME, &hFile))
+        {
+            CascGetFileSize64(hFile, &FileSize);
+            CascCloseFile(hFile);
+        }
+
+        FileSize = (FileSize != CASC_INVALID_SIZE64) ? FileSize : 0;
+        CascLock(FuseCtx.Lock);
+        pNode->FileSize = FileSize;
+        CascUnlock(FuseCtx.Lock);
+    }
+
+    return FileSize;
+}
+
+static void FillStat(FUSE_NODE * pNode, struct stat * pStat)
+{
+    memset(pStat, 0, sizeof(struct stat));
+    pStat->st_uid = getuid();
+    pStat->st_gid = getgid();
+    pStat->st_atime = pStat->st_mtime = pStat->st_ctime = FuseCtx.MountTime;
+
+    if(pNode == NULL || pNode->bDirectory)
+    {
+        pStat->st_mode = S_IFDIR | 0555;
+        pStat->st_nlink = 2;
+    }
+    else
+    {
+        pStat->st_mode = S_IFREG | 0444;
+        pStat->st_nlink = 1;
+        pStat->st_size = (off_t)GetNodeSize(pNode);
+    }
+}
+
+static void * Fuse_Init(struct fuse_conn_info * /* conn */, struct fuse_config * cfg)
+{
+    // The content never changes, so the kernel can cache everything
+    cfg->kernel_cache = 1;
+    cfg->entry_timeout = 3600.0;
+    cfg->attr_timeout = 3600.0;
+    cfg->negative_timeout = 3600.0;
+    return &FuseCtx;
+}
+
+static int Fuse_GetAttr(const char * szPath, struct stat * pStat, struct fuse_file_info * /* fi */)
+{
+    FUSE_NODE * pNode = FindNode(FuseCtx, szPath);
+
+    // Only the root directory has no entry
+    if(pNode == NULL && szPath[strspn(szPath, "/")] != 0)
+        return -ENOENT;
+
+    FillStat(pNode, pStat);
+    return 0;
+}
+
+static int Fuse_ReadDir(const char * szPath, void * pvBuffer, fuse_fill_dir_t PfnFiller, off_t /* offset */, struct fuse_file_info * /* fi */, enum fuse_readdir_flags /* flags */)
+{
+    FUSE_NODE * pNodes = (FUSE_NODE *)FuseCtx.Nodes.ItemArray();
+    FUSE_NODE * pNode = FindNode(FuseCtx, szPath);
+    size_t nFirst = FuseCtx.nRootFirst;
+    size_t nCount = FuseCtx.nRootCount;
+
+    // Only the root directory has no entry
+    if(pNode != NULL)
+    {
+        if(pNode->bDirectory == false)
+            return -ENOTDIR;
+        nFirst = pNode->nFirstChild;
+        nCount = pNode->nChildCount;
+    }
+    else if(szPath[strspn(szPath, "/")] != 0)
+    {
+        return -ENOENT;
+    }
+
+    // The file sizes are not given here, as some of them require opening the file
+    PfnFiller(pvBuffer, ".", NULL, 0, (enum fuse_fill_dir_flags)0);
+    PfnFiller(pvBuffer, "..", NULL, 0, (enum fuse_fill_dir_flags)0);
+    for(size_t i = nFirst; i < nFirst + nCount; i++)
+    {
+        if(PfnFiller(pvBuffer, pNodes[i].szName, NULL, 0, (enum fuse_fill_dir_flags)0))
+            break;
+    }
+    return 0;
+}
+
+static int Fuse_Open(const char * szPath, struct fuse_file_info * fi)
+{
+    FUSE_NODE * pNode;
+    HANDLE hFile;
+
+    if((pNode = FindNode(FuseCtx, szPath)) == NULL)
+        return -ENOENT;
+    if(pNode->bDirectory)
+        return -EISDIR;
+    if((fi->flags & O_ACCMODE) != O_RDONLY)
+        return -EROFS;
+
+    if(!CascOpenFile(FuseCtx.hStorage, pNode->szCascName, 0, CASC_OPEN_BY_NAME, &hFile))
+        return ErrorToErrno(GetCascError());
+
+    fi->fh = (uint64_t)(size_t)hFile;
+    fi->keep_cache = 1;
+    return 0;
+}
+
+// The kernel may read the file from several threads at once, e.g. with read-ahead.
+// CascReadFileAt doesn't use the file pointer, so the reads run in parallel
+static int Fuse_Read(const char * /* szPath */, char * pbBuffer, size_t cbBuffer, off_t ByteOffset, struct fuse_file_info * fi)
+{
+    HANDLE hFile = (HANDLE)(size_t)fi->fh;
+    DWORD dwBytesRead = 0;
+
+    if(!CascReadFileAt(hFile, (ULONGLONG)ByteOffset, pbBuffer, (DWORD)cbBuffer, &dwBytesRead))
+        return ErrorToErrno(GetCascError());
+    return (int)dwBytesRead;
+}
+
+static int Fuse_Release(const char * /* szPath */, struct fuse_file_info * fi)
+{
+    CascCloseFile((HANDLE)(size_t)fi->fh);
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+// Benchmark of a mounted directory. It works on any directory, so the mounted
+// storage can be compared with the same files extracted by CascExtractFiles
+
+static int CompareLatency(const void * pvSample1, const void * pvSample2)
+{
+    ULONGLONG Sample1 = *(const ULONGLONG *)pvSample1;
+    ULONGLONG Sample2 = *(const ULONGLONG *)pvSample2;
+
+    return (Sample1 < Sample2) ? -1 : ((Sample1 > Sample2) ? +1 : 0);
+}
+
+static void AddLatency(BENCH_LATENCY & Latency, ULONGLONG StartTime)
+{
+    ULONGLONG Sample = CascPerfGetTime() - StartTime;
+
+    Latency.Samples.Insert(&Sample, 1);
+}
+
+static void PrintLatency(BENCH_LATENCY & Latency)
+{
+    ULONGLONG * Samples = (ULONGLONG *)Latency.Samples.ItemArray();
+    ULONGLONG TotalTime = 0;
+    size_t nCount = Latency.Samples.ItemCount();
+
+    if(nCount != 0)
+    {
+        qsort(Samples, nCount, sizeof(ULONGLONG), CompareLatency);
+        for(size_t i = 0; i < nCount; i++)
+            TotalTime += Samples[i];
+
+        printf("%-10s %10u %10u us %10u us %10u us %10u us %10.1f MB/s\n",
+            Latency.szOperation,
+            (DWORD)nCount,
+            (DWORD)(TotalTime / nCount),
+            (DWORD)Samples[nCount / 2],
+            (DWORD)Samples[(nCount * 99) / 100],
+            (DWORD)Samples[nCount - 1],
+            (TotalTime != 0) ? ((double)Latency.ByteCount / (1024.0 * 1024.0)) / ((double)TotalTime / 1000000.0) : 0.0);
+    }
+}
+
+static DWORD Bench_List(const char * szDirectory, CASC_ARRAY & Entries, BENCH_LATENCY & ReadDir)
+{
+    struct dirent * dir_entry;
+    ULONGLONG StartTime;
+    char szPath[MAX_PATH];
+    DIR * dir;
+
+    StartTime = CascPerfGetTime();
+    if((dir = opendir(szDirectory)) == NULL)
+        return errno;
+
+    while((dir_entry = readdir(dir)) != NULL)
+    {
+        if(strcmp(dir_entry->d_name, ".") && strcmp(dir_entry->d_name, ".."))
+        {
+            CascStrPrintf(szPath, _countof(szPath), "%s/%s", szDirectory, dir_entry->d_name);
+            Entries.Insert(szPath, strlen(szPath) + 1);
+        }
+    }
+    closedir(dir);
+    AddLatency(ReadDir, StartTime);
+    return ERROR_SUCCESS;
+}
+
+// "ls -lR": lists each directory and retrieves the attributes of each entry
+static DWORD Bench_ListTree(const char * szRootDir, CASC_ARRAY & Files, BENCH_LATENCY & ReadDir, BENCH_LATENCY & Stat)
+{
+    CASC_ARRAY Entries;
+    struct stat st;
+    ULONGLONG StartTime;
+    const char * szEntry;
+    size_t nOffset = 0;
+    DWORD dwErrCode;
+
+    // Breadth-first walk. The list of entries doubles as the queue of directories
+    if((dwErrCode = Entries.Create<char>(0x100000)) != ERROR_SUCCESS)
+        return dwErrCode;
+    Entries.Insert(szRootDir, strlen(szRootDir) + 1);
+
+    while(nOffset < Entries.ItemCount())
+    {
+        szEntry = (const char *)Entries.ItemAt(nOffset);
+        nOffset += strlen(szEntry) + 1;
+
+        StartTime = CascPerfGetTime();
+        if(stat(szEntry, &st) != 0)
+            continue;
+        AddLatency(Stat, StartTime);
+
+        if(S_ISDIR(st.st_mode))
+        {
+            char szDirectory[MAX_PATH];
+
+            // The array may be reallocated by the listing
+            CascStrCopy(szDirectory, _countof(szDirectory), szEntry);
+            Bench_List(szDirectory, Entries, ReadDir);
+        }
+        else if(S_ISREG(st.st_mode))
+        {
+            Files.Insert(szEntry, strlen(szEntry) + 1);
+        }
+    }
+
+    Entries.Free();
+    return ERROR_SUCCESS;
+}
+
+// "cat": opens the file and reads it to the end. The first read is measured separately
+static void Bench_Cat(const char * szFileName, LPBYTE pbBuffer, BENCH_LATENCY & FirstByte, BENCH_LATENCY & Cat)
+{
+    ULONGLONG StartTime = CascPerfGetTime();
+    ssize_t nBytesRead;
+    bool bFirstRead = true;
+    int fd;
+
+    if((fd = open(szFileName, O_RDONLY)) == -1)
+        return;
+
+    while((nBytesRead = read(fd, pbBuffer, BENCH_READ_SIZE)) > 0)
+    {
+        if(bFirstRead)
+            AddLatency(FirstByte, StartTime);
+        Cat.ByteCount += nBytesRead;
+        bFirstRead = false;
+    }
+    close(fd);
+
+    AddLatency(Cat, StartTime);
+}
+
+static int RunBenchmark(const char * szDirectory, DWORD dwCatFiles)
+{
+    BENCH_LATENCY Latencies[4];
+    CASC_ARRAY Files;
+    LPBYTE pbBuffer;
+    size_t nFileCount = 0;
+    size_t nStep;
+
+    // Prepare the latency counters
+    Latencies[0].szOperation = "readdir";
+    Latencies[1].szOperation = "stat";
+    Latencies[2].szOperation = "firstbyte";
+    Latencies[3].szOperation = "cat";
+    for(size_t i = 0; i < _countof(Latencies); i++)
+    {
+        Latencies[i].Samples.Create<ULONGLONG>(0x10000);
+        Latencies[i].ByteCount = 0;
+    }
+    Files.Create<char>(0x100000);
+
+    if((pbBuffer = CASC_ALLOC<BYTE>(BENCH_READ_SIZE)) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    // "ls -lR" of the whole tree
+    Bench_ListTree(szDirectory, Files, Latencies[0], Latencies[1]);
+
+    // "cat" of files evenly spread over the tree
+    for(size_t nOffset = 0; nOffset < Files.ItemCount(); nFileCount++)
+        nOffset += strlen((const char *)Files.ItemAt(nOffset)) + 1;
+    nStep = CASCLIB_MAX(nFileCount / CASCLIB_MAX(dwCatFiles, 1), 1);
+    for(size_t nOffset = 0, i = 0; nOffset < Files.ItemCount(); i++)
+    {
+        const char * szFileName = (const char *)Files.ItemAt(nOffset);
+
+        if((i % nStep) == 0)
+            Bench_Cat(szFileName, pbBuffer, Latencies[2], Latencies[3]);
+        nOffset += strlen(szFileName) + 1;
+    }
+
+    printf("%u files in %s\n\n", (DWORD)nFileCount, szDirectory);
+    printf("Operation       Count        Avg          p50          p99          Max   Throughput\n");
+    printf("-----------------------------------------------------------------------------------\n");
+    for(size_t i = 0; i < _countof(Latencies); i++)
+    {
+        PrintLatency(Latencies[i]);
+        Latencies[i].Samples.Free();
+    }
+
+    CASC_FREE(pbBuffer);
+    Files.Free();
+    return ERROR_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+// Main
+
+static void PrintUsage()
+{
+    printf("Usage: casc_fuse [-l <listfile>] [-f] [-o <fuse options>] <storage> <mountpoint>\n");
+    printf("       casc_fuse -b <directory> [-n <count>]\n\n");
+    printf("  -l  List file with the file names\n");
+    printf("  -f  Run in the foreground\n");
+    printf("  -o  Mount options, passed to FUSE\n");
+    printf("  -b  Benchmark of a directory: \"ls -lR\" of the whole tree, then \"cat\" of some files\n");
+    printf("  -n  Number of files read by the benchmark (default %u)\n\n", BENCH_CAT_FILES);
+    printf("The named files are in their directories, all files are also in \"" FUSE_DIR_FILEID "\" by FileDataId\n");
+    printf("and in \"" FUSE_DIR_CKEY "\" by the content key.\n\n");
+    printf("Example: casc_fuse /games/wow /mnt/wow\n");
+    printf("         casc_fuse -b /mnt/wow -n 5000\n");
+}
+
+int main(int argc, char * argv[])
+{
+    struct fuse_operations FuseOps;
+    const char * szBenchDir = NULL;
+    const char * szStorage = NULL;
+    const char * FuseArgv[0x20];
+    TCHAR szListFile[MAX_PATH] = {0};
+    DWORD dwCatFiles = BENCH_CAT_FILES;
+    DWORD dwErrCode;
+    int FuseArgc = 0;
+    int nResult;
+
+    // Parse the command line. The mount point and the FUSE options are given to FUSE
+    FuseArgv[FuseArgc++] = argv[0];
+    for(int i = 1; i < argc && FuseArgc < (int)(_countof(FuseArgv) - 2); i++)
+    {
+        if(argv[i][0] == '-' && argv[i][1] != 0 && argv[i][2] == 0)
+        {
+            switch(argv[i][1])
+            {
+                case 'l':
+                    if((i + 1) < argc)
+                        CascStrCopy(szListFile, _countof(szListFile), argv[++i]);
+                    continue;
+
+                case 'b':
+                    if((i + 1) < argc)
+                        szBenchDir = argv[++i];
+                    continue;
+
+                case 'n':
+                    if((i + 1) < argc)
+                        dwCatFiles = strtoul(argv[++i], NULL, 0);
+                    continue;
+
+                case 'o':
+                    FuseArgv[FuseArgc++] = argv[i];
+                    if((i + 1) < argc)
+                        FuseArgv[FuseArgc++] = argv[++i];
+                    continue;
+
+                case 'f':
+                case 'd':
+                case 's':
+                    FuseArgv[FuseArgc++] = argv[i];
+                    continue;
+            }
+
+            PrintUsage();
+            return ERROR_INVALID_PARAMETER;
+        }
+
+        // The first plain argument is the storage, the next one the mount point
+        if(szStorage == NULL)
+            szStorage = argv[i];
+        else
+            FuseArgv[FuseArgc++] = argv[i];
+    }
+    FuseArgv[FuseArgc] = NULL;
+
+    // Benchmark of an existing directory
+    if(szBenchDir != NULL)
+        return RunBenchmark(szBenchDir, dwCatFiles);
+
+    if(szStorage == NULL || FuseArgc < 2)
+    {
+        PrintUsage();
+        return ERROR_INVALID_PARAMETER;
+    }
+
+    // Open the storage and build the directory tree
+    FuseCtx.MountTime = time(NULL);
+    CascInitLock(FuseCtx.Lock);
+    if(!CascOpenStorage(szStorage, 0, &FuseCtx.hStorage))
+    {
+        printf("Failed to open the storage %s (error code %u)\n", szStorage, GetCascError());
+        return (int)GetCascError();
+    }
+
+    if((dwErrCode = BuildTree(FuseCtx, (szListFile[0] != 0) ? szListFile : NULL)) != ERROR_SUCCESS)
+    {
+        printf("Failed to enumerate the storage (error code %u)\n", dwErrCode);
+        CascCloseStorage(FuseCtx.hStorage);
+        return (int)dwErrCode;
+    }
+
+    // Mount the storage. FUSE runs the operations on multiple threads
+    memset(&FuseOps, 0, sizeof(struct fuse_operations));
+    FuseOps.init = Fuse_Init;
+    FuseOps.getattr = Fuse_GetAttr;
+    FuseOps.readdir = Fuse_ReadDir;
+    FuseOps.open = Fuse_Open;
+    FuseOps.read = Fuse_Read;
+    FuseOps.release = Fuse_Release;
+    nResult = fuse_main(FuseArgc, (char **)FuseArgv, &FuseOps, NULL);
+
+    // Unmounted
+    CascCloseStorage(FuseCtx.hStorage);
+    CascFreeLock(FuseCtx.Lock);
+    FuseCtx.Nodes.Free();
+    FuseCtx.Names.Free();
+    return nResult;
+}
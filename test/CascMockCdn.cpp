@@ -0,0 +1,111 @@
+/*****************************************************************************/
+/* CascMockCdn.cpp                        Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Standalone mock CDN server. Serves a CDN tree (as created by casc_bench)  */
+/* on 127.0.0.1, so that online storages can be opened without internet      */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 19.10.26  1.00  Lad  The first version of CascMockCdn.cpp                 */
+/*****************************************************************************/
+
+#define _CRT_NON_CONFORMING_SWPRINTFS
+#define _CRT_SECURE_NO_DEPRECATE
+#define __CASCLIB_SELF__                    // Don't use CascLib.lib
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../src/CascLib.h"
+#include "../src/CascCommon.h"
+
+#include "TMockCdnServer.cpp"
+
+#ifdef _MSC_VER
+#pragma warning(disable: 4505)              // 'XXX' : unreferenced local function has been removed
+#endif
+
+#ifdef _MSC_VER
+#define fmt_I64u "%I64u"
+#else
+#define fmt_I64u "%llu"
+#endif
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+static void PrintUsage()
+{
+    printf("Usage: casc_mockcdn -d <directory> -p <port> [-l <latency>] [-b <bandwidth>] [-e <failure rate>] [-r <seed>]\n\n");
+    printf("  -d  Root directory of the CDN tree (\"cdn\" in the directory of a synthetic storage)\n");
+    printf("  -p  TCP port on 127.0.0.1\n");
+    printf("  -l  Latency of each response in milliseconds\n");
+    printf("  -b  Bandwidth of one connection in KB/s\n");
+    printf("  -e  Percentage of requests that fail (503, dropped or truncated response)\n");
+    printf("  -r  Random seed for the failure injection\n\n");
+    printf("Example: casc_mockcdn -d /tmp/synth/cdn -p 8119\n");
+    printf("         casctest with \"<cache_dir>*http://127.0.0.1:8119*wow*us\" as the online storage\n");
+}
+
+//-----------------------------------------------------------------------------
+// Main
+
+int main(int argc, char * argv[])
+{
+    MOCK_CDN_PARAMS Params;
+    MOCK_CDN_STATS Stats;
+    TMockCdnServer Server;
+    TCHAR szRootPath[MAX_PATH] = {0};
+    DWORD dwErrCode;
+
+    // Parse the command line
+    for(int i = 1; i < argc; i++)
+    {
+        if(argv[i][0] != '-' || argv[i][1] == 0 || argv[i][2] != 0 || (i + 1) >= argc)
+        {
+            PrintUsage();
+            return ERROR_INVALID_PARAMETER;
+        }
+
+        switch(argv[i][1])
+        {
+            case 'd': CascStrCopy(szRootPath, _countof(szRootPath), argv[++i]); break;
+            case 'p': Params.dwPortNum = strtoul(argv[++i], NULL, 0); break;
+            case 'l': Params.dwLatencyMs = strtoul(argv[++i], NULL, 0); break;
+            case 'b': Params.dwBandwidth = strtoul(argv[++i], NULL, 0); break;
+            case 'e': Params.dwFailRate = strtoul(argv[++i], NULL, 0); break;
+            case 'r': Params.dwSeed = strtoul(argv[++i], NULL, 0); break;
+            default:
+                PrintUsage();
+                return ERROR_INVALID_PARAMETER;
+        }
+    }
+
+    if(szRootPath[0] == 0 || Params.dwPortNum == 0)
+    {
+        PrintUsage();
+        return ERROR_INVALID_PARAMETER;
+    }
+
+    // Serve the files until the user presses Enter
+    Params.szRootPath = szRootPath;
+    if((dwErrCode = Server.Start(Params)) != ERROR_SUCCESS)
+    {
+        printf("Failed to start the mock CDN server on port %u (error code %u)\n", Params.dwPortNum, dwErrCode);
+        return (int)dwErrCode;
+    }
+
+    printf("Mock CDN server is running on 127.0.0.1:%u. Press Enter to stop ...\n", Params.dwPortNum);
+    getchar();
+    Server.Stop();
+
+    Server.GetStats(Stats);
+    printf("%u connections, %u requests (%u ranges), %u not found, %u failures injected, " fmt_I64u " bytes sent\n",
+        Stats.Connections,
+        Stats.Requests,
+        Stats.RangeRequests,
+        Stats.NotFound,
+        Stats.Failures,
+        Stats.BytesSent);
+    return ERROR_SUCCESS;
+}
@@ -925,12 +925,216 @@ static DWORD Storage_EnumFiles(TLogHelper & LogHelper, TEST_PARAMS & Params)
     return dwErrCode;
 }
 
+// Measures how fast can the root handler resolve file names.
+// On MNDX storages (Heroes of the Storm, Starcraft II), this mostly measures
+// the speed of searching the file name database (TFileNameDatabase)
+static DWORD Storage_LookupNames(TLogHelper & LogHelper, TEST_PARAMS & Params)
+{
+    CASC_ARRAY NameOffsets;
+    CASC_ARRAY NameBuffer;
+    CASC_FIND_DATA cf;
+    ULONGLONG TotalLookups = 0;
+    HANDLE hStorage = Params.hStorage;
+    HANDLE hFind;
+    HANDLE hFile;
+    DWORD dwFailedLookups = 0;
+    DWORD dwTotalTime;
+    DWORD dwErrCode = ERROR_SUCCESS;
+    int nLookupRounds = 20;
+
+    // Create the arrays for file names
+    if(NameOffsets.Create<size_t>(0x10000) != ERROR_SUCCESS || NameBuffer.Create<char>(0x100000) != ERROR_SUCCESS)
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    // Collect all real file names from the storage
+    LogHelper.PrintProgress("Collecting file names ...");
+    hFind = CascFindFirstFile(hStorage, "*", &cf, Params.szListFile);
+    if(hFind != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if(cf.NameType == CascNameFull)
+            {
+                size_t nLength = strlen(cf.szFileName) + 1;
+                size_t * PtrOffset = (size_t *)NameOffsets.Insert(1);
+                char * szName = (char *)NameBuffer.Insert(nLength);
+
+                if(PtrOffset == NULL || szName == NULL)
+                {
+                    dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+                    break;
+                }
+
+                memcpy(szName, cf.szFileName, nLength);
+                PtrOffset[0] = NameBuffer.IndexOf(szName);
+            }
+        }
+        while(CascFindNextFile(hFind, &cf));
+        CascFindClose(hFind);
+    }
+
+    // Resolve all names several times
+    if(dwErrCode == ERROR_SUCCESS && NameOffsets.ItemCount() != 0)
+    {
+        LogHelper.SetStartTime();
+        for(int i = 0; i < nLookupRounds; i++)
+        {
+            LogHelper.PrintProgress("Resolving file names (%u of %u) ...", i, nLookupRounds);
+            for(size_t j = 0; j < NameOffsets.ItemCount(); j++)
+            {
+                size_t nNameOffset = *(size_t *)NameOffsets.ItemAt(j);
+                LPCSTR szFileName = (LPCSTR)NameBuffer.ItemAt(nNameOffset);
+
+                if(CascOpenFile(hStorage, szFileName, 0, CASC_OPEN_BY_NAME, &hFile))
+                    CascCloseFile(hFile);
+                else
+                    dwFailedLookups++;
+                TotalLookups++;
+            }
+        }
+        dwTotalTime = LogHelper.SetEndTime();
+
+        LogHelper.PrintMessage("Resolved: " fmt_I64u " names (%u failed) in %u ms", TotalLookups, dwFailedLookups, dwTotalTime);
+        if(dwTotalTime != 0)
+            LogHelper.PrintMessage("Speed: " fmt_I64u " names/sec", (TotalLookups * 1000) / dwTotalTime);
+    }
+
+    return dwErrCode;
+}
+
+static bool GetFileFullInfo(HANDLE hStorage, LPCSTR szFileName, DWORD dwOpenFlags, CASC_FILE_FULL_INFO & FileInfo)
+{
+    HANDLE hFile;
+    bool bResult = false;
+
+    if(CascOpenFile(hStorage, szFileName, 0, dwOpenFlags, &hFile))
+    {
+        bResult = CascGetFileInfo(hFile, CascFileFullInfo, &FileInfo, sizeof(CASC_FILE_FULL_INFO), NULL);
+        CascCloseFile(hFile);
+    }
+    return bResult;
+}
+
+// Opens every named file with the letter case swapped. File names are case-insensitive.
+// Each file must open and give the same encoded key and name hash as with the enumerated name.
+static DWORD Storage_OpenAnyCase(TLogHelper & LogHelper, TEST_PARAMS & Params)
+{
+    CASC_FIND_DATA cf;
+    HANDLE hStorage = Params.hStorage;
+    HANDLE hFind;
+    DWORD dwFileCount = 0;
+    DWORD dwErrCode = ERROR_SUCCESS;
+    CASC_FILE_FULL_INFO FileInfo1;
+    CASC_FILE_FULL_INFO FileInfo2;
+    char szSwapped[MAX_PATH];
+
+    LogHelper.PrintProgress("Opening files with swapped letter case ...");
+    hFind = CascFindFirstFile(hStorage, "*", &cf, GetTheProperListfile(hStorage, Params.szListFile));
+    if(hFind != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if(cf.NameType == CascNameFull && cf.bFileAvailable)
+            {
+                // Swap the case of every letter in the name
+                for(size_t i = 0; (szSwapped[i] = cf.szFileName[i]) != 0; i++)
+                {
+                    if(isupper(szSwapped[i]))
+                        szSwapped[i] = (char)tolower(szSwapped[i]);
+                    else if(islower(szSwapped[i]))
+                        szSwapped[i] = (char)toupper(szSwapped[i]);
+                }
+
+                // Both names must open the file with the same encoded key
+                if(!GetFileFullInfo(hStorage, cf.szFileName, 0, FileInfo1) || !GetFileFullInfo(hStorage, szSwapped, 0, FileInfo2))
+                {
+                    LogHelper.PrintMessage("Error: Failed to open %s (error %u)", szSwapped, GetCascError());
+                    dwErrCode = GetCascError();
+                    break;
+                }
+
+                if(memcmp(FileInfo1.EKey, FileInfo2.EKey, MD5_HASH_SIZE))
+                {
+                    LogHelper.PrintMessage("Error: %s opened a different file than %s", szSwapped, cf.szFileName);
+                    dwErrCode = ERROR_FILE_CORRUPT;
+                }
+
+                // The name hash doesn't depend on the letter case
+                if(FileInfo1.FileNameHash == 0 || FileInfo1.FileNameHash != FileInfo2.FileNameHash)
+                {
+                    LogHelper.PrintMessage("Error: %s has no name hash or a different one than %s", szSwapped, cf.szFileName);
+                    dwErrCode = ERROR_FILE_CORRUPT;
+                }
+                dwFileCount++;
+            }
+        }
+        while(dwErrCode == ERROR_SUCCESS && CascFindNextFile(hFind, &cf));
+        CascFindClose(hFind);
+    }
+
+    LogHelper.PrintMessage("Opened: %u files with swapped letter case", dwFileCount);
+    return dwErrCode;
+}
+
 static DWORD Storage_ReadFiles(TLogHelper & LogHelper, TEST_PARAMS & Params)
 {
     Params.bCheckFileData = true;
     return Storage_EnumFiles(LogHelper, Params);
 }
 
+static bool WINAPI ExtractCallback(void * PtrUserParam, PCASC_EXTRACT_RESULT pProgress)
+{
+    TLogHelper * pLogHelper = (TLogHelper *)PtrUserParam;
+    size_t FilesDone = pProgress->FilesExtracted + pProgress->FilesLinked + pProgress->FilesEncrypted + pProgress->FilesFailed;
+
+    pLogHelper->PrintProgress("Extracting files (%u of %u, %u MB/s) ...",
+                               (DWORD)FilesDone,
+                               (DWORD)pProgress->FileCount,
+                               (DWORD)(pProgress->BytesPerSecond / (1024 * 1024)));
+    return false;
+}
+
+// Reads and verifies all files of the storage by CascExtractFiles, without writing them.
+// Every file that matches the mask must be either verified, skipped or encrypted
+static DWORD Storage_ExtractFiles(TLogHelper & LogHelper, TEST_PARAMS & Params)
+{
+    CASC_EXTRACT_RESULT Result = {0};
+    CASC_EXTRACT_ARGS Args = {sizeof(CASC_EXTRACT_ARGS)};
+    size_t FilesDone;
+    DWORD dwErrCode = ERROR_SUCCESS;
+
+    Args.dwFlags = CASC_EXTRACT_NO_WRITE | CASC_EXTRACT_VERIFY;
+    Args.szListFile = GetTheProperListfile(Params.hStorage, Params.szListFile);
+    Args.PfnExtractCallback = ExtractCallback;
+    Args.PtrExtractParam = &LogHelper;
+
+    LogHelper.SetStartTime();
+    if(!CascExtractFiles(Params.hStorage, "*", NULL, &Args, &Result))
+    {
+        LogHelper.PrintMessage("Error: %u file(s) failed to extract (error %u)", (DWORD)Result.FilesFailed, GetCascError());
+        dwErrCode = GetCascError();
+    }
+
+    // The counters must add up to the number of files
+    FilesDone = Result.FilesExtracted + Result.FilesLinked + Result.FilesSkipped + Result.FilesEncrypted + Result.FilesFailed;
+    if(dwErrCode == ERROR_SUCCESS && (Result.FilesFailed != 0 || FilesDone != Result.FileCount))
+    {
+        LogHelper.PrintMessage("Error: %u of %u file(s) accounted for, %u failed", (DWORD)FilesDone, (DWORD)Result.FileCount, (DWORD)Result.FilesFailed);
+        dwErrCode = ERROR_FILE_CORRUPT;
+    }
+
+    LogHelper.IncrementTotalBytes(Result.ContentBytes);
+    LogHelper.PrintMessage("Extracted: %u files, %u linked, %u skipped, %u encrypted (%u MB/s, %u threads)",
+                            (DWORD)Result.FilesExtracted,
+                            (DWORD)Result.FilesLinked,
+                            (DWORD)Result.FilesSkipped,
+                            (DWORD)Result.FilesEncrypted,
+                            (DWORD)(Result.BytesPerSecond / (1024 * 1024)),
+                            Result.dwThreadCount);
+    LogHelper.PrintTotalTime();
+    return dwErrCode;
+}
+
 static DWORD LocalStorage_Test(PFN_RUN_TEST PfnRunTest, STORAGE_INFO1 & StorInfo)
 {
     TLogHelper LogHelper(StorInfo.szPath);
@@ -1138,6 +1342,281 @@ static STORAGE_INFO2 StorageInfo2[] =
     {szCdn2, "wow",         "us"},
 };
 
+//-----------------------------------------------------------------------------
+// Microbenchmarks (don't need a storage)
+
+// Compares CascCheckWildCard with the compiled mask (CASC_MASK) used by the search.
+// Both matchers must find the same files. A mask that doesn't end with '*' or '?' also matches
+// longer names ("*.m2" matches ".m2i" and a folder without the trailing backslash matches its files)
+// Uses clock(), because the timer of TLogHelper only has one-second resolution on Linux
+static DWORD Bench_WildCardMatch()
+{
+    TLogHelper LogHelper("WildCardMatch");
+    CASC_ARRAY NameOffsets;
+    CASC_ARRAY NameBuffer;
+    clock_t StartTime;
+    DWORD dwTimeOld;
+    DWORD dwTimeNew;
+    char szFileName[MAX_PATH];
+    int nRounds = 10;
+
+    static const char * WildCards[] =
+    {
+        "*",
+        "*.m2",
+        "*.m2i",
+        "world\\maps",
+        "Creature/Creature1",
+        "*Map1?_0",
+        "*_0?.ad?",
+        "world\\maps\\azeroth\\*",
+        "World/Maps/Map1?/*_3?_*.adt",
+        "*maps*00_0?.adt",
+        "interface/glues/*",
+        NULL
+    };
+
+    // Create the arrays for file names
+    if(NameOffsets.Create<size_t>(0x10000) != ERROR_SUCCESS || NameBuffer.Create<char>(0x100000) != ERROR_SUCCESS)
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    // Generate names that look like the ones in the WoW listfile
+    for(DWORD i = 0; i < 0x40; i++)
+    {
+        for(DWORD j = 0; j < 0x40; j++)
+        {
+            for(DWORD k = 0; k < 0x10; k++)
+            {
+                switch(k & 0x03)
+                {
+                    case 0: CascStrPrintf(szFileName, _countof(szFileName), "World\\Maps\\Map%u\\Map%u_%02u_%02u.adt", i, i, j, k); break;
+                    case 1: CascStrPrintf(szFileName, _countof(szFileName), "World\\Maps\\Azeroth\\Azeroth_%02u_%02u_obj%u.adt", i, j, k); break;
+                    case 2: CascStrPrintf(szFileName, _countof(szFileName), "Creature\\Creature%u\\Creature%u_%02u.%s", i, j, k, (k & 0x08) ? "m2i" : "m2"); break;
+                    case 3: CascStrPrintf(szFileName, _countof(szFileName), "Interface\\Glues\\Models\\Model%u_%u\\Texture%02u.blp", i, j, k); break;
+                }
+
+                size_t nLength = strlen(szFileName) + 1;
+                size_t * PtrOffset = (size_t *)NameOffsets.Insert(1);
+                char * szName = (char *)NameBuffer.Insert(nLength);
+                if(PtrOffset == NULL || szName == NULL)
+                    return ERROR_NOT_ENOUGH_MEMORY;
+
+                memcpy(szName, szFileName, nLength);
+                PtrOffset[0] = NameBuffer.IndexOf(szName);
+            }
+        }
+    }
+
+    // Run every wildcard with both matchers
+    for(size_t i = 0; WildCards[i] != NULL; i++)
+    {
+        CASC_MASK Mask;
+        size_t nFoundOld = 0;
+        size_t nFoundNew = 0;
+
+        if(Mask.Compile(WildCards[i]) != ERROR_SUCCESS)
+            return ERROR_NOT_ENOUGH_MEMORY;
+
+        StartTime = clock();
+        for(int nRound = 0; nRound < nRounds; nRound++)
+        {
+            for(size_t j = 0; j < NameOffsets.ItemCount(); j++)
+            {
+                LPCSTR szName = (LPCSTR)NameBuffer.ItemAt(*(size_t *)NameOffsets.ItemAt(j));
+                nFoundOld += CascCheckWildCard(szName, WildCards[i]) ? 1 : 0;
+            }
+        }
+        dwTimeOld = (DWORD)(((clock() - StartTime) * 1000) / CLOCKS_PER_SEC);
+
+        StartTime = clock();
+        for(int nRound = 0; nRound < nRounds; nRound++)
+        {
+            for(size_t j = 0; j < NameOffsets.ItemCount(); j++)
+            {
+                LPCSTR szName = (LPCSTR)NameBuffer.ItemAt(*(size_t *)NameOffsets.ItemAt(j));
+                nFoundNew += Mask.Check(szName) ? 1 : 0;
+            }
+        }
+        dwTimeNew = (DWORD)(((clock() - StartTime) * 1000) / CLOCKS_PER_SEC);
+
+        LogHelper.PrintMessage("%s: CascCheckWildCard: %u ms (%u found), CASC_MASK: %u ms (%u found)",
+                                WildCards[i],
+                                dwTimeOld, (DWORD)(nFoundOld / nRounds),
+                                dwTimeNew, (DWORD)(nFoundNew / nRounds));
+
+        // Both matchers must find the same files
+        if(nFoundNew != nFoundOld)
+        {
+            LogHelper.PrintMessage("Error: %s: CASC_MASK found %u files, CascCheckWildCard found %u files",
+                                   WildCards[i],
+                                   (DWORD)(nFoundNew / nRounds),
+                                   (DWORD)(nFoundOld / nRounds));
+            return ERROR_CAN_NOT_COMPLETE;
+        }
+    }
+
+    return ERROR_SUCCESS;
+}
+
+// Compares CalcFileNameHashes, which hashes the names in groups, with CalcFileNameHash.
+// There is a name of every length from 0 to MAX_PATH, so the groups mix lengths
+// around all 12-byte blocks of the hash (12/13, 24/25, ...). Every start and every count
+// up to three groups is tried, so that the last group is partial in all possible ways
+static DWORD Bench_FileNameHashes()
+{
+    TLogHelper LogHelper("FileNameHashes");
+    static const char szChars[] = "aBcDeFgHiJkLmNoPqRsTuVwXyZ0123456789_.";
+    const char * FileNames[MAX_PATH + 1];
+    ULONGLONG Expected[MAX_PATH + 1];
+    ULONGLONG Hashes[MAX_PATH + 2];
+    clock_t StartTime;
+    DWORD dwTimeOne;
+    DWORD dwTimeBatch;
+    DWORD dwErrors = 0;
+    char * szNameBuffer;
+    int nRounds = 200;
+
+    if((szNameBuffer = CASC_ALLOC<char>((MAX_PATH + 1) * (MAX_PATH + 1))) == NULL)
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    // The n-th name has n characters. Lowercase letters and slashes are changed by the normalization
+    for(size_t n = 0; n <= MAX_PATH; n++)
+    {
+        char * szFileName = szNameBuffer + n * (MAX_PATH + 1);
+
+        for(size_t i = 0; i < n; i++)
+            szFileName[i] = ((i % 9) == 8) ? '/' : szChars[(i * 7 + n) % (sizeof(szChars) - 1)];
+        szFileName[n] = 0;
+
+        FileNames[n] = szFileName;
+        Expected[n] = CalcFileNameHash(szFileName);
+    }
+
+    // The hash after the last name must stay untouched
+    for(size_t nStart = 0; nStart <= MAX_PATH; nStart++)
+    {
+        for(size_t nCount = 1; nCount <= 24 && (nStart + nCount) <= (MAX_PATH + 1); nCount++)
+        {
+            memset(Hashes, 0, sizeof(Hashes));
+            CalcFileNameHashes(FileNames + nStart, Hashes + nStart, nCount);
+
+            for(size_t i = nStart; i < nStart + nCount; i++)
+            {
+                if(Hashes[i] != Expected[i])
+                {
+                    if(dwErrors++ == 0)
+                        LogHelper.PrintMessage("Error: name length %u, start %u, count %u: hash mismatch", (DWORD)i, (DWORD)nStart, (DWORD)nCount);
+                }
+            }
+            dwErrors += (Hashes[nStart + nCount] != 0) ? 1 : 0;
+        }
+    }
+
+    // Speed of both variants over all names
+    StartTime = clock();
+    for(int nRound = 0; nRound < nRounds; nRound++)
+    {
+        for(size_t n = 0; n <= MAX_PATH; n++)
+            Hashes[n] = CalcFileNameHash(FileNames[n]);
+    }
+    dwTimeOne = (DWORD)(((clock() - StartTime) * 1000) / CLOCKS_PER_SEC);
+
+    StartTime = clock();
+    for(int nRound = 0; nRound < nRounds; nRound++)
+        CalcFileNameHashes(FileNames, Hashes, MAX_PATH + 1);
+    dwTimeBatch = (DWORD)(((clock() - StartTime) * 1000) / CLOCKS_PER_SEC);
+
+    LogHelper.PrintMessage("CalcFileNameHash: %u ms, CalcFileNameHashes: %u ms, %u errors", dwTimeOne, dwTimeBatch, dwErrors);
+    CASC_FREE(szNameBuffer);
+    return (dwErrors == 0) ? ERROR_SUCCESS : ERROR_CAN_NOT_COMPLETE;
+}
+
+// Verifies the names of extracted files with a ".." path part at the end of the buffer.
+// The ".." must never get into the safe name and nothing may be written after the buffer
+static DWORD Bench_SafeNames()
+{
+    TLogHelper LogHelper("SafeNames");
+    char szFileName[MAX_PATH + 0x10];
+    char szSafeName[MAX_PATH + 0x10];
+    DWORD dwErrors = 0;
+
+    for(size_t nDotPos = MAX_PATH - 8; nDotPos <= MAX_PATH; nDotPos++)
+    {
+        size_t nLength;
+
+        // Name "aaa...a/../b", with the ".." at the given position
+        memset(szFileName, 'a', nDotPos - 1);
+        CascStrCopy(szFileName + nDotPos - 1, _countof(szFileName) - nDotPos + 1, "/../b");
+        memset(szSafeName, 0x55, sizeof(szSafeName));
+
+        nLength = GetSafeName(szFileName, szSafeName, MAX_PATH);
+        if(nLength >= MAX_PATH || szSafeName[nLength] != 0 || strstr(szSafeName, "..") != NULL || szSafeName[MAX_PATH] != 0x55)
+        {
+            if(dwErrors++ == 0)
+                LogHelper.PrintMessage("Error: \"..\" at position %u: bad safe name", (DWORD)nDotPos);
+        }
+    }
+
+    LogHelper.PrintMessage("Safe names at the end of the buffer: %s", (dwErrors == 0) ? "OK" : "FAILED");
+    return (dwErrors == 0) ? ERROR_SUCCESS : ERROR_CAN_NOT_COMPLETE;
+}
+
+// Returns the first key with the given name in the table of static keys
+static PCASC_ENCRYPTION_KEY FindFirstStaticKey(PCASC_ENCRYPTION_KEY StaticKeys, size_t nKeyCount, ULONGLONG KeyName)
+{
+    for(size_t i = 0; i < nKeyCount; i++)
+    {
+        if(StaticKeys[i].KeyName == KeyName)
+            return &StaticKeys[i];
+    }
+    return NULL;
+}
+
+// Verifies the perfect hash of the static encryption keys. Every key name must give
+// the key of its first entry in the table; names that are not in the table must miss
+static DWORD Bench_StaticKeys()
+{
+    TLogHelper LogHelper("StaticKeys");
+    PCASC_ENCRYPTION_KEY StaticKeys;
+    CASC_KEY_MAP KeyMap;
+    size_t nKeyCount = 0;
+    DWORD dwMissCount = 0;
+    DWORD dwErrors = 0;
+
+    StaticKeys = CASC_KEY_MAP::GetStaticKeys(nKeyCount);
+    if(KeyMap.LoadStaticKeys() != ERROR_SUCCESS)
+        return ERROR_NOT_ENOUGH_MEMORY;
+    if(!KeyMap.HasStaticKeys())
+    {
+        LogHelper.PrintMessage("Error: The perfect hash of the static keys could not be built");
+        return ERROR_CAN_NOT_COMPLETE;
+    }
+
+    for(size_t i = 0; i < nKeyCount; i++)
+    {
+        PCASC_ENCRYPTION_KEY pFirstKey = FindFirstStaticKey(StaticKeys, nKeyCount, StaticKeys[i].KeyName);
+        ULONGLONG MissName = StaticKeys[i].KeyName + 1;
+        LPBYTE Key = KeyMap.FindKey(StaticKeys[i].KeyName);
+
+        if(Key == NULL || memcmp(Key, pFirstKey->Key, CASC_KEY_LENGTH))
+        {
+            if(dwErrors++ == 0)
+                LogHelper.PrintMessage("Error: Key %llX: not found or a different key", StaticKeys[i].KeyName);
+        }
+
+        // The neighbouring name must miss, unless it is a key too
+        if(FindFirstStaticKey(StaticKeys, nKeyCount, MissName) == NULL)
+        {
+            dwErrors += (KeyMap.FindKey(MissName) != NULL) ? 1 : 0;
+            dwMissCount++;
+        }
+    }
+    dwErrors += (KeyMap.FindKey(0) != NULL) ? 1 : 0;
+
+    LogHelper.PrintMessage("Static keys: %u found, %u missed, %u errors", (DWORD)nKeyCount, dwMissCount + 1, dwErrors);
+    return (dwErrors == 0) ? ERROR_SUCCESS : ERROR_CAN_NOT_COMPLETE;
+}
+
 //-----------------------------------------------------------------------------
 // Main
 
@@ -1167,6 +1646,18 @@ int main(int argc, char * argv[])
     //}
 #endif
 
+    //
+    // Run the microbenchmarks that don't need any storage
+    //
+    if((dwErrCode = Bench_WildCardMatch()) != ERROR_SUCCESS)
+        return (int)dwErrCode;
+    if((dwErrCode = Bench_FileNameHashes()) != ERROR_SUCCESS)
+        return (int)dwErrCode;
+    if((dwErrCode = Bench_SafeNames()) != ERROR_SUCCESS)
+        return (int)dwErrCode;
+    if((dwErrCode = Bench_StaticKeys()) != ERROR_SUCCESS)
+        return (int)dwErrCode;
+
     //
     // Run tests for each storage entered on command line
     //
@@ -1178,6 +1669,21 @@ int main(int argc, char * argv[])
         dwErrCode = LocalStorage_Test(Storage_ReadFiles, StorInfo);
         if(dwErrCode != ERROR_SUCCESS && dwErrCode != ERROR_FILE_NOT_FOUND)
             break;
+
+        // Extract all files at once by CascExtractFiles
+        dwErrCode = LocalStorage_Test(Storage_ExtractFiles, StorInfo);
+        if(dwErrCode != ERROR_SUCCESS && dwErrCode != ERROR_FILE_NOT_FOUND)
+            break;
+
+        // Open the files by names that differ in letter case
+        dwErrCode = LocalStorage_Test(Storage_OpenAnyCase, StorInfo);
+        if(dwErrCode != ERROR_SUCCESS && dwErrCode != ERROR_FILE_NOT_FOUND)
+            break;
+
+        // Measure the speed of resolving file names
+        dwErrCode = LocalStorage_Test(Storage_LookupNames, StorInfo);
+        if(dwErrCode != ERROR_SUCCESS && dwErrCode != ERROR_FILE_NOT_FOUND)
+            break;
     }
 
     //
@@ -1189,6 +1695,11 @@ int main(int argc, char * argv[])
         dwErrCode = LocalStorage_Test(Storage_ReadFiles, StorageInfo1[i]);
         if(dwErrCode != ERROR_SUCCESS && dwErrCode != ERROR_FILE_NOT_FOUND)
             break;
+
+        // Open the files by names that differ in letter case
+        dwErrCode = LocalStorage_Test(Storage_OpenAnyCase, StorageInfo1[i]);
+        if(dwErrCode != ERROR_SUCCESS && dwErrCode != ERROR_FILE_NOT_FOUND)
+            break;
     }
 
     //
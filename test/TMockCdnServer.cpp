@@ -0,0 +1,502 @@
+/*****************************************************************************/
+/* TMockCdnServer.cpp                     Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Local HTTP server that serves a CDN tree for testing the online storages  */
+/* This file should be included directly from the test programs using        */
+/* #include                                                                  */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 19.10.26  1.00  Lad  The first version of TMockCdnServer.cpp              */
+/*****************************************************************************/
+
+#ifndef CASCLIB_PLATFORM_WINDOWS
+#include <netinet/tcp.h>
+#endif
+
+//-----------------------------------------------------------------------------
+// Defines
+
+#define MOCK_CDN_MAX_CONNECTIONS    32              // Maximum number of connections served at once
+#define MOCK_CDN_REQUEST_SIZE       0x1000          // Maximum size of one HTTP request
+#define MOCK_CDN_SEND_CHUNK         0x4000          // Responses are sent in chunks of this size
+
+// Injected failures
+#define MOCK_FAIL_NONE              0               // No failure, the request is served normally
+#define MOCK_FAIL_STATUS            1               // "503 Service Unavailable"
+#define MOCK_FAIL_DROP              2               // The connection is closed without a response
+#define MOCK_FAIL_TRUNCATE          3               // The connection is closed in the middle of the response
+#define MOCK_FAIL_COUNT             3               // Number of failure kinds
+
+#ifdef CASCLIB_PLATFORM_WINDOWS
+#define MOCK_SHUT_RDWR              SD_BOTH
+#else
+#define MOCK_SHUT_RDWR              SHUT_RDWR
+#endif
+
+//-----------------------------------------------------------------------------
+// Local structures
+
+struct MOCK_CDN_PARAMS
+{
+    MOCK_CDN_PARAMS()
+    {
+        szRootPath = NULL;
+        dwPortNum = 0;
+        dwLatencyMs = 0;
+        dwBandwidth = 0;
+        dwFailRate = 0;
+        dwSeed = 0x12345678;
+    }
+
+    LPCTSTR szRootPath;                             // Root of the CDN tree. "GET /a/b" serves the file "<szRootPath>/a/b"
+    DWORD dwPortNum;                                // TCP port on 127.0.0.1
+    DWORD dwLatencyMs;                              // Delay before each response
+    DWORD dwBandwidth;                              // Maximum transfer speed of one connection in KB/s. 0 = unlimited
+    DWORD dwFailRate;                               // Percentage of requests that fail (503, dropped or truncated response)
+    DWORD dwSeed;                                   // Seed for the failure injection
+};
+
+struct MOCK_CDN_STATS
+{
+    ULONGLONG BytesSent;                            // Number of content bytes sent
+    DWORD Connections;                              // Number of accepted connections
+    DWORD Requests;                                 // Number of received requests
+    DWORD RangeRequests;                            // Number of requests for a range of a file
+    DWORD NotFound;                                 // Number of requests for files that don't exist
+    DWORD Failures;                                 // Number of injected failures
+};
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+// Wall-clock time in milliseconds. clock() measures CPU time of the process, which excludes waiting for I/O
+static ULONGLONG GetTimeMs()
+{
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    return GetTickCount64();
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ULONGLONG)ts.tv_sec * 1000 + (ts.tv_nsec / 1000000);
+#endif
+}
+
+static void SleepMs(DWORD dwMilliseconds)
+{
+#ifdef CASCLIB_PLATFORM_WINDOWS
+    Sleep(dwMilliseconds);
+#else
+    usleep(dwMilliseconds * 1000);
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// The mock CDN server. Each connection is served by its own thread,
+// so the latency and the bandwidth limit apply per connection.
+
+class TMockCdnServer
+{
+    public:
+
+    TMockCdnServer()
+    {
+        memset(&Stats, 0, sizeof(MOCK_CDN_STATS));
+        memset(Connections, 0, sizeof(Connections));
+        ListenSock = INVALID_SOCKET;
+        RandomState = 0;
+        bAcceptThread = false;
+        bShutdown = false;
+        CascInitLock(Lock);
+    }
+
+    ~TMockCdnServer()
+    {
+        Stop();
+        CascFreeLock(Lock);
+    }
+
+    // Starts listening on 127.0.0.1:Params.dwPortNum
+    DWORD Start(const MOCK_CDN_PARAMS & NewParams)
+    {
+        struct sockaddr_in Address;
+        int nReuseAddr = 1;
+
+        if(NewParams.szRootPath == NULL || NewParams.dwPortNum == 0 || NewParams.dwPortNum > 0xFFFF || NewParams.dwFailRate > 100)
+            return ERROR_INVALID_PARAMETER;
+        Params = NewParams;
+        RandomState = ((ULONGLONG)Params.dwSeed << 32) | 0x2545F491;
+        bShutdown = false;
+
+#ifdef CASCLIB_PLATFORM_WINDOWS
+        WSADATA wsd;
+        WSAStartup(MAKEWORD(2, 2), &wsd);
+#endif
+
+        // Create the listening socket
+        if((ListenSock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) == INVALID_SOCKET)
+            return ERROR_NETWORK_NOT_AVAILABLE;
+        setsockopt(ListenSock, SOL_SOCKET, SO_REUSEADDR, (const char *)&nReuseAddr, sizeof(int));
+
+        memset(&Address, 0, sizeof(struct sockaddr_in));
+        Address.sin_family = AF_INET;
+        Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        Address.sin_port = htons((unsigned short)Params.dwPortNum);
+        if(bind(ListenSock, (struct sockaddr *)&Address, sizeof(struct sockaddr_in)) != 0 || listen(ListenSock, 16) != 0)
+        {
+            closesocket(ListenSock);
+            ListenSock = INVALID_SOCKET;
+            return ERROR_NETWORK_NOT_AVAILABLE;
+        }
+
+        // Start accepting connections
+        if(!CascCreateThread(AcceptThread, AcceptThreadRoutine, this))
+        {
+            closesocket(ListenSock);
+            ListenSock = INVALID_SOCKET;
+            return ERROR_NOT_ENOUGH_MEMORY;
+        }
+
+        bAcceptThread = true;
+        return ERROR_SUCCESS;
+    }
+
+    // Stops the server. Closes all connections and waits for all threads
+    void Stop()
+    {
+        if(bAcceptThread)
+        {
+            // Wake up the accept thread
+            bShutdown = true;
+            shutdown(ListenSock, MOCK_SHUT_RDWR);
+            CascJoinThread(AcceptThread);
+            closesocket(ListenSock);
+            ListenSock = INVALID_SOCKET;
+            bAcceptThread = false;
+
+            // Wake up and finish all connection threads
+            for(size_t i = 0; i < MOCK_CDN_MAX_CONNECTIONS; i++)
+            {
+                if(Connections[i].bActive)
+                {
+                    shutdown(Connections[i].sock, MOCK_SHUT_RDWR);
+                    FreeConnection(Connections[i]);
+                }
+            }
+
+#ifdef CASCLIB_PLATFORM_WINDOWS
+            WSACleanup();
+#endif
+        }
+    }
+
+    // Gives a snapshot of the statistics
+    void GetStats(MOCK_CDN_STATS & OutStats)
+    {
+        CascLock(Lock);
+        OutStats = Stats;
+        CascUnlock(Lock);
+    }
+
+    protected:
+
+    struct MOCK_CDN_CONNECTION
+    {
+        TMockCdnServer * pServer;                   // The owner of the connection
+        CASC_THREAD Thread;                         // Thread serving the connection
+        SOCKET sock;                                // The connected socket. Closed when the thread is joined
+        bool bActive;                               // If true, the thread is running or has not been joined yet
+        bool bFinished;                             // If true, the thread has finished and can be joined
+    };
+
+    static void AcceptThreadRoutine(void * pvParam)
+    {
+        ((TMockCdnServer *)pvParam)->AcceptConnections();
+    }
+
+    static void ConnectionThreadRoutine(void * pvParam)
+    {
+        MOCK_CDN_CONNECTION * pConnection = (MOCK_CDN_CONNECTION *)pvParam;
+        TMockCdnServer * pServer = pConnection->pServer;
+
+        pServer->ServeConnection(pConnection->sock);
+
+        // Tell the accept thread that we can be joined. The socket stays open until then
+        CascLock(pServer->Lock);
+        pConnection->bFinished = true;
+        CascUnlock(pServer->Lock);
+    }
+
+    void FreeConnection(MOCK_CDN_CONNECTION & Connection)
+    {
+        CascJoinThread(Connection.Thread);
+        closesocket(Connection.sock);
+        Connection.bActive = false;
+    }
+
+    void AcceptConnections()
+    {
+        MOCK_CDN_CONNECTION * pConnection;
+        SOCKET sock;
+        int nNoDelay = 1;
+
+        while((sock = accept(ListenSock, NULL, NULL)) != INVALID_SOCKET && !bShutdown)
+        {
+            pConnection = NULL;
+
+            // The response header and the end of the content go in separate sends.
+            // Without this, the last segment waits for the client's delayed ACK
+            setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (const char *)&nNoDelay, sizeof(int));
+
+            // Join the finished connections and find a free slot
+            for(size_t i = 0; i < MOCK_CDN_MAX_CONNECTIONS; i++)
+            {
+                CascLock(Lock);
+                bool bFinished = Connections[i].bActive && Connections[i].bFinished;
+                CascUnlock(Lock);
+
+                if(bFinished)
+                    FreeConnection(Connections[i]);
+                if(pConnection == NULL && Connections[i].bActive == false)
+                    pConnection = &Connections[i];
+            }
+
+            // Too many connections: refuse this one
+            if(pConnection == NULL)
+            {
+                closesocket(sock);
+                continue;
+            }
+
+            pConnection->pServer = this;
+            pConnection->sock = sock;
+            pConnection->bFinished = false;
+            if(!CascCreateThread(pConnection->Thread, ConnectionThreadRoutine, pConnection))
+            {
+                closesocket(sock);
+                continue;
+            }
+            pConnection->bActive = true;
+
+            CascLock(Lock);
+            Stats.Connections++;
+            CascUnlock(Lock);
+        }
+
+        // accept() succeeded, but we are shutting down
+        if(sock != INVALID_SOCKET)
+            closesocket(sock);
+    }
+
+    // Serves the requests on one kept-alive connection until the client closes it
+    void ServeConnection(SOCKET sock)
+    {
+        char szRequest[MOCK_CDN_REQUEST_SIZE];
+        char * szHeaderEnd;
+        char * szUrlPath;
+        char * szUrlEnd;
+        char * szRange;
+        size_t cbRequest = 0;
+        size_t cbHeader;
+        int nReceived;
+
+        szRequest[0] = 0;
+        while(!bShutdown)
+        {
+            // Receive the entire request header
+            while((szHeaderEnd = strstr(szRequest, "\r\n\r\n")) == NULL)
+            {
+                if(cbRequest >= sizeof(szRequest) - 1)
+                    return;
+                if((nReceived = recv(sock, szRequest + cbRequest, (int)(sizeof(szRequest) - 1 - cbRequest), 0)) <= 0)
+                    return;
+                cbRequest += nReceived;
+                szRequest[cbRequest] = 0;
+            }
+
+            // Only "GET <path> HTTP/1.1" is supported
+            if(strncmp(szRequest, "GET /", 5) || (szUrlEnd = strchr(szRequest + 4, ' ')) == NULL || szUrlEnd > szHeaderEnd)
+            {
+                SendResponse(sock, "400 Bad Request", NULL, 0);
+                return;
+            }
+            szUrlPath = szRequest + 4;
+            szUrlEnd[0] = 0;
+
+            // "Range: bytes=<first>-<last>" requests only a part of the file
+            szRange = strstr(szUrlEnd + 1, "\r\nRange: bytes=");
+            if(szRange != NULL && szRange > szHeaderEnd)
+                szRange = NULL;
+
+            if(!ServeRequest(sock, szUrlPath, (szRange != NULL) ? szRange + 15 : NULL))
+                return;
+
+            // Keep the rest of the received data; the client may send the next request right away
+            cbHeader = (szHeaderEnd + 4) - szRequest;
+            memmove(szRequest, szRequest + cbHeader, cbRequest - cbHeader + 1);
+            cbRequest -= cbHeader;
+        }
+    }
+
+    // Sends one file or a range of it. Returns false if the connection must be closed
+    bool ServeRequest(SOCKET sock, char * szUrlPath, const char * szRange)
+    {
+        LPBYTE pbFileData = NULL;
+        LPBYTE pbContent = NULL;
+        TCHAR szFilePath[MAX_PATH];
+        TCHAR szRelPath[MAX_PATH];
+        const char * szStatus = "200 OK";
+        DWORD cbFileData = 0;
+        DWORD cbContent = 0;
+        DWORD dwFailure;
+        char * szQuery;
+        bool bIsRange = false;
+        bool bResult;
+
+        // The query string is ignored. Names with ".." are not served
+        if((szQuery = strchr(szUrlPath, '?')) != NULL)
+            szQuery[0] = 0;
+        if(strstr(szUrlPath, "..") == NULL)
+        {
+            CascStrCopy(szRelPath, _countof(szRelPath), szUrlPath + 1);
+            for(size_t i = 0; szRelPath[i] != 0; i++)
+                szRelPath[i] = (szRelPath[i] == '/') ? PATH_SEP_CHAR : szRelPath[i];
+            CombinePath(szFilePath, _countof(szFilePath), Params.szRootPath, szRelPath, NULL);
+            pbFileData = LoadFileToMemory(szFilePath, &cbFileData);
+        }
+
+        // Cut the range from the file. Ranges that are out of the file are ignored
+        pbContent = pbFileData;
+        cbContent = cbFileData;
+        if(pbFileData != NULL && szRange != NULL)
+        {
+            char * szRangeEnd;
+            DWORD dwFirst = strtoul(szRange, &szRangeEnd, 10);
+            DWORD dwLast = (szRangeEnd[0] == '-') ? strtoul(szRangeEnd + 1, NULL, 10) : 0;
+
+            if(dwFirst <= dwLast && dwFirst < cbFileData)
+            {
+                pbContent = pbFileData + dwFirst;
+                cbContent = CASCLIB_MIN(dwLast + 1, cbFileData) - dwFirst;
+                szStatus = "206 Partial Content";
+                bIsRange = true;
+            }
+        }
+
+        // Simulate the network latency
+        if(Params.dwLatencyMs != 0)
+            SleepMs(Params.dwLatencyMs);
+        dwFailure = GetNextFailure();
+
+        CascLock(Lock);
+        Stats.Requests++;
+        Stats.RangeRequests += bIsRange ? 1 : 0;
+        Stats.NotFound += (pbFileData == NULL) ? 1 : 0;
+        Stats.Failures += (dwFailure != MOCK_FAIL_NONE) ? 1 : 0;
+        CascUnlock(Lock);
+
+        switch(dwFailure)
+        {
+            case MOCK_FAIL_STATUS:
+                bResult = SendResponse(sock, "503 Service Unavailable", NULL, 0);
+                break;
+
+            case MOCK_FAIL_DROP:
+                shutdown(sock, MOCK_SHUT_RDWR);
+                bResult = false;
+                break;
+
+            case MOCK_FAIL_TRUNCATE:
+                SendResponse(sock, szStatus, pbContent, cbContent, cbContent / 2);
+                shutdown(sock, MOCK_SHUT_RDWR);
+                bResult = false;
+                break;
+
+            default:
+                if(pbFileData != NULL)
+                    bResult = SendResponse(sock, szStatus, pbContent, cbContent);
+                else
+                    bResult = SendResponse(sock, "404 Not Found", NULL, 0);
+                break;
+        }
+
+        CASC_FREE(pbFileData);
+        return bResult;
+    }
+
+    // Sends the response header and the first cbSendSize bytes of the content (all by default)
+    bool SendResponse(SOCKET sock, const char * szStatus, LPBYTE pbContent, DWORD cbContent, DWORD cbSendSize = 0xFFFFFFFF)
+    {
+        ULONGLONG StartTime = GetTimeMs();
+        ULONGLONG ExpectedTime;
+        ULONGLONG ElapsedTime;
+        char szHeader[0x100];
+        size_t nLength;
+        DWORD cbSent = 0;
+        DWORD cbChunk;
+
+        nLength = CascStrPrintf(szHeader, _countof(szHeader),
+            "HTTP/1.1 %s\r\n"
+            "Content-Type: application/octet-stream\r\n"
+            "Content-Length: %u\r\n"
+            "Connection: keep-alive\r\n"
+            "\r\n", szStatus, cbContent);
+        if(send(sock, szHeader, (int)nLength, MSG_NOSIGNAL) != (int)nLength)
+            return false;
+
+        // Send the content in chunks. With the bandwidth limit, we wait
+        // after each chunk until the expected transfer time elapses
+        cbSendSize = CASCLIB_MIN(cbSendSize, cbContent);
+        while(cbSent < cbSendSize)
+        {
+            cbChunk = CASCLIB_MIN(cbSendSize - cbSent, MOCK_CDN_SEND_CHUNK);
+            if(send(sock, (const char *)(pbContent + cbSent), (int)cbChunk, MSG_NOSIGNAL) != (int)cbChunk)
+                return false;
+            cbSent += cbChunk;
+
+            if(Params.dwBandwidth != 0)
+            {
+                ExpectedTime = ((ULONGLONG)cbSent * 1000) / ((ULONGLONG)Params.dwBandwidth * 1024);
+                ElapsedTime = GetTimeMs() - StartTime;
+                if(ExpectedTime > ElapsedTime)
+                    SleepMs((DWORD)(ExpectedTime - ElapsedTime));
+            }
+        }
+
+        CascLock(Lock);
+        Stats.BytesSent += cbSent;
+        CascUnlock(Lock);
+        return true;
+    }
+
+    DWORD GetNextFailure()
+    {
+        ULONGLONG Random;
+
+        if(Params.dwFailRate == 0)
+            return MOCK_FAIL_NONE;
+
+        // xorshift64*, shared by all connections
+        CascLock(Lock);
+        RandomState ^= RandomState >> 12;
+        RandomState ^= RandomState << 25;
+        RandomState ^= RandomState >> 27;
+        Random = RandomState * 0x2545F4914F6CDD1DULL;
+        CascUnlock(Lock);
+
+        if((DWORD)((Random >> 32) % 100) >= Params.dwFailRate)
+            return MOCK_FAIL_NONE;
+        return MOCK_FAIL_STATUS + (DWORD)((Random & 0xFFFF) % MOCK_FAIL_COUNT);
+    }
+
+    MOCK_CDN_PARAMS Params;
+    MOCK_CDN_STATS Stats;                           // Statistics, protected by Lock
+    MOCK_CDN_CONNECTION Connections[MOCK_CDN_MAX_CONNECTIONS];
+    CASC_THREAD AcceptThread;                       // Thread accepting the connections
+    CASC_LOCK Lock;                                 // Protects Stats, RandomState and MOCK_CDN_CONNECTION::bFinished
+    SOCKET ListenSock;                              // The listening socket
+    ULONGLONG RandomState;                          // State of the failure generator
+    bool bAcceptThread;                             // If true, the accept thread is running
+    volatile bool bShutdown;                        // If true, the server is being stopped
+};
@@ -0,0 +1,1782 @@
+/*****************************************************************************/
+/* TSyntheticStorage.cpp                  Copyright (c) Ladislav Zezula 2026 */
+/*---------------------------------------------------------------------------*/
+/* Generator of synthetic local CASC storages for benchmarking CascLib       */
+/* This file should be included directly from CascBench.cpp using #include   */
+/*---------------------------------------------------------------------------*/
+/*   Date    Ver   Who  Comment                                              */
+/* --------  ----  ---  -------                                              */
+/* 19.10.26  1.00  Lad  The first version of TSyntheticStorage.cpp           */
+/*****************************************************************************/
+
+//-----------------------------------------------------------------------------
+// Defines
+
+#define SYNTH_FILE_OFFSET_BITS  30                  // Number of bits for data file offset in the index entries
+#define SYNTH_SEGMENT_SIZE      ((ULONGLONG)1 << SYNTH_FILE_OFFSET_BITS)
+#define SYNTH_INDEX_ALIGNMENT   0x10000             // The index files are padded to this size
+#define SYNTH_CKEY_PAGE_SIZE    0x1000              // Size of one CKey page in ENCODING
+#define SYNTH_LOCALE_FLAGS      CASC_LOCALE_ENUS    // All files are enUS
+#define SYNTH_ENCRYPTION_KEY    0x2C547F26A2613E01ULL // One of the static keys in CascDecrypt.cpp. The readers don't need to import it
+
+// The CDN tree for the mock CDN server
+#define SYNTH_CDN_PRODUCT       _T("wow")           // Product code name, as in "http://host/wow/versions"
+#define SYNTH_CDN_PATH          "tpr/synth"         // CDN path of the product, as in "http://host/tpr/synth/data/xx/yy/key"
+#define SYNTH_ARCHIVE_SIZE      0x1000000           // Maximal size of one CDN archive
+#define SYNTH_ARCHIVE_PAGE_SIZE 0x1000              // Size of one page in the CDN archive index
+#define SYNTH_ARCHIVE_ITEM_SIZE (MD5_HASH_SIZE + 4 + 4) // EKey, encoded size, offset in the archive
+#define SYNTH_ARCHIVE_HASH_SIZE 8                   // Length of the hashes in the CDN archive index
+#define SYNTH_LOOSE_FILE_STEP   32                  // Every n-th file is a loose file on the CDN
+#define SYNTH_SPAN_GROUP        16                  // In TVFS storages, the last SYNTH_SPAN_COUNT files of each group ...
+#define SYNTH_SPAN_COUNT        3                   // ... of SYNTH_SPAN_GROUP files are the spans of one multi-span file
+                                                    // The first file of each group is only in the TVFS root, not in ENCODING nor DOWNLOAD
+#define SYNTH_TVFS_CFT_ENTRY    (9 + 4 + 4)         // Size of the container file table entry: EKey, encoded size, content size
+#define SYNTH_TVFS_HEADER_SIZE  0x26                // Size of the TVFS header without the encoding specifier table
+
+// Deliberate damage of the generated storage (SYNTH_PARAMS::dwDamage), for testing CascScrubStorage
+#define SYNTH_DAMAGE_CONTENT_KEY    0x0001          // The CKey of file 0 in the manifests doesn't match its content
+#define SYNTH_DAMAGE_INDEX_SIZE     0x0002          // The index entry of file 1 is one byte shorter than the file
+#define SYNTH_DAMAGE_OVERLAP        0x0004          // The index entry of file 2 also covers file 3 and a half of file 4
+#define SYNTH_DAMAGE_ENCODING_PAGE  0x0008          // The hash of the first CKey page of ENCODING is wrong
+
+// Encoding modes of the generated files. The modes rotate over the files
+#define SYNTH_MODE_NORMAL       0                   // 'N' frames
+#define SYNTH_MODE_ZLIB         1                   // 'Z' frames
+#define SYNTH_MODE_ENCRYPTED_N  2                   // 'E' frames containing 'N' frames
+#define SYNTH_MODE_ENCRYPTED_Z  3                   // 'E' frames containing 'Z' frames
+#define SYNTH_MODE_COUNT        4
+
+// Tags in the DOWNLOAD manifest. SynthTags has more tags, which are only in the INSTALL manifest
+#define SYNTH_TAG_COUNT         7
+#define SYNTH_INSTALL_TAG_COUNT 4                   // Number of tags in the INSTALL manifest (see SynthInstallTags)
+
+//-----------------------------------------------------------------------------
+// Local structures
+
+struct SYNTH_PARAMS
+{
+    SYNTH_PARAMS()
+    {
+        szStoragePath = NULL;
+        dwFileCount = 20000;
+        dwMinFileSize = 0x10;
+        dwMaxFileSize = 0x80000;
+        dwFrameSize = 0x10000;
+        dwSeed = 0x12345678;
+        dwCdnPort = 0;
+        dwStagedFiles = 0;
+        dwDamage = 0;
+        bTvfsRoot = false;
+        bInstallRoot = false;
+    }
+
+    LPCTSTR szStoragePath;                          // Root directory of the storage (where .build.info will be)
+    DWORD dwFileCount;                              // Number of files in the storage
+    DWORD dwMinFileSize;                            // Minimal content size of a file
+    DWORD dwMaxFileSize;                            // Maximal content size of a file. Most files are small, like in the real storages
+    DWORD dwFrameSize;                              // Content size of one BLTE frame
+    DWORD dwSeed;                                   // Seed for the file sizes and file content
+    DWORD dwCdnPort;                                // If nonzero, the CDN tree for a mock CDN server at 127.0.0.1:dwCdnPort is created as well
+    DWORD dwStagedFiles;                            // Files that are in the data and index files, but not in the build yet (see TSyntheticStorage::Update)
+    DWORD dwDamage;                                 // Deliberate damage of the storage. See SYNTH_DAMAGE_XXX
+    bool bTvfsRoot;                                 // If true, the ROOT is a TVFS manifest with multi-span files
+    bool bInstallRoot;                              // If true, the ROOT is not usable and the file names come from the INSTALL manifest
+};
+
+// Everything we need to know about one generated file
+// One tag in the DOWNLOAD manifest. A file has the tag if its hash is below the density
+struct SYNTH_TAG
+{
+    const char * szTagName;                         // Name of the tag
+    USHORT TagValue;                                // Type of the tag (platform, architecture, locale)
+    DWORD Density;                                  // Probability that a file has the tag, in 1/256
+};
+
+struct SYNTH_FILE
+{
+    BYTE CKey[MD5_HASH_SIZE];                       // MD5 of the file content
+    BYTE EKey[MD5_HASH_SIZE];                       // MD5 of the BLTE header (or of the entire BLTE data if there is no frame table)
+    ULONGLONG StorageOffset;                        // (Data file index << SYNTH_FILE_OFFSET_BITS) | offset in the data file
+    ULONGLONG FileNameHash;                         // Jenkins hash of the file name
+    DWORD ContentSize;                              // Size of the file content
+    DWORD EncodedSize;                              // Size of the encoded file in the data file, including BLTE_ENCODED_HEADER
+    DWORD FileDataId;                               // File data ID in the ROOT file
+};
+
+// One file in the current CDN archive
+struct SYNTH_ARCHIVE_ENTRY
+{
+    BYTE EKey[MD5_HASH_SIZE];                       // EKey of the file
+    DWORD EncodedSize;                              // Size of the BLTE data (without BLTE_ENCODED_HEADER)
+    DWORD ArchiveOffset;                            // Offset of the BLTE data in the archive
+};
+
+//-----------------------------------------------------------------------------
+// Local variables
+
+// Both dense and very sparse tags, so the tag bitsets have both kinds of chunks
+static const SYNTH_TAG SynthTags[SYNTH_TAG_COUNT + 2] =
+{
+    {"Windows", 1, 192},
+    {"OSX",     1,  96},
+    {"x86_64",  2, 230},
+    {"arm64",   2,   8},
+    {"enUS",    3, 200},
+    {"deDE",    3,  16},
+    {"frFR",    3,   1},
+    {"Speech_enUS_Optional",   4, 128},     // Only in INSTALL. The names are longer than any name in DOWNLOAD
+    {"Installer_Only_Content", 4,  24}
+};
+
+// Tags in the INSTALL manifest. Those that are in DOWNLOAD as well tag the same files
+static const DWORD SynthInstallTags[SYNTH_INSTALL_TAG_COUNT] = {0, 4, SYNTH_TAG_COUNT, SYNTH_TAG_COUNT + 1};
+
+//-----------------------------------------------------------------------------
+// Local functions
+
+static void ConvertIntegerToBytes_BE(ULONGLONG Value, LPBYTE ValueAsBytes, size_t nLength)
+{
+    while(nLength > 0)
+    {
+        ValueAsBytes[--nLength] = (BYTE)(Value & 0xFF);
+        Value >>= 8;
+    }
+}
+
+// The bucket (index file) of an EKey. Same as the one used by the Blizzard agent
+static DWORD GetEKeyBucketIndex(LPBYTE EKey)
+{
+    BYTE HashValue = 0;
+
+    for(size_t i = 0; i < CASC_EKEY_SIZE; i++)
+        HashValue ^= EKey[i];
+    return (HashValue & 0x0F) ^ (HashValue >> 4);
+}
+
+static int CompareEKeyEntries(const void * pvEntry1, const void * pvEntry2)
+{
+    return memcmp(pvEntry1, pvEntry2, CASC_EKEY_SIZE);
+}
+
+static int CompareArchiveEntries(const void * pvEntry1, const void * pvEntry2)
+{
+    return memcmp(((SYNTH_ARCHIVE_ENTRY *)pvEntry1)->EKey, ((SYNTH_ARCHIVE_ENTRY *)pvEntry2)->EKey, MD5_HASH_SIZE);
+}
+
+static int CompareCKeys(const void * pvFile1, const void * pvFile2)
+{
+    return memcmp(((SYNTH_FILE *)pvFile1)->CKey, ((SYNTH_FILE *)pvFile2)->CKey, MD5_HASH_SIZE);
+}
+
+static int CompareEKeys(const void * pvFile1, const void * pvFile2)
+{
+    return memcmp(((SYNTH_FILE *)pvFile1)->EKey, ((SYNTH_FILE *)pvFile2)->EKey, MD5_HASH_SIZE);
+}
+
+// Creates the zlib stream. Without system zlib, CascLib only contains the inflate part,
+// so we create a zlib stream with stored (uncompressed) deflate blocks instead
+static DWORD ZlibCompress(LPBYTE pbOutBuffer, DWORD cbOutBuffer, LPBYTE pbInBuffer, DWORD cbInBuffer)
+{
+#ifdef CASC_USE_SYSTEM_ZLIB
+    uLongf cbCompressed = cbOutBuffer;
+
+    if(compress2(pbOutBuffer, &cbCompressed, pbInBuffer, cbInBuffer, Z_DEFAULT_COMPRESSION) != Z_OK)
+        return 0;
+    return (DWORD)cbCompressed;
+#else
+    LPBYTE pbOutPtr = pbOutBuffer;
+    DWORD dwAdler32 = (DWORD)adler32(1, pbInBuffer, cbInBuffer);
+    DWORD cbBlock;
+
+    CASCLIB_UNUSED(cbOutBuffer);
+
+    // zlib header: deflate, 32K window, no dictionary
+    *pbOutPtr++ = 0x78;
+    *pbOutPtr++ = 0x01;
+
+    // Stored blocks, up to 0xFFFF bytes each
+    do
+    {
+        cbBlock = CASCLIB_MIN(cbInBuffer, 0xFFFF);
+        *pbOutPtr++ = (cbBlock == cbInBuffer) ? 1 : 0;
+        *pbOutPtr++ = (BYTE)(cbBlock);
+        *pbOutPtr++ = (BYTE)(cbBlock >> 8);
+        *pbOutPtr++ = (BYTE)(~cbBlock);
+        *pbOutPtr++ = (BYTE)(~cbBlock >> 8);
+        memcpy(pbOutPtr, pbInBuffer, cbBlock);
+        pbOutPtr += cbBlock;
+        pbInBuffer += cbBlock;
+        cbInBuffer -= cbBlock;
+    }
+    while(cbInBuffer != 0);
+
+    // Adler-32 checksum (big endian)
+    ConvertIntegerToBytes_4(dwAdler32, pbOutPtr);
+    return (DWORD)((pbOutPtr + 4) - pbOutBuffer);
+#endif
+}
+
+// Worst-case size of the encoded frame: 'E' header, 'Z' + zlib overhead of stored blocks
+static DWORD GetMaxEncodedFrameSize(DWORD cbFrame)
+{
+    return cbFrame + (cbFrame / 0x1000) + (5 * (cbFrame / 0xFFFF + 1)) + 0x40;
+}
+
+//-----------------------------------------------------------------------------
+// The generator
+
+class TSyntheticStorage
+{
+    public:
+
+    TSyntheticStorage()
+    {
+        hsCrypt = NULL;
+        pDataFile = NULL;
+        pbContent = pbEncoded = pbFrame = pbArchive = NULL;
+        cbArchive = 0;
+        DataFileIndex = 0;
+        DataFileOffset = 0;
+        RandomState = 0;
+        TotalContentSize = 0;
+        TotalEncodedSize = 0;
+        ArchiveCount = LooseFileCount = 0;
+        EncodingPageCount = UnchangedIndexCount = UnchangedPageCount = StagedUnchangedCount = 0;
+        memset(IndexSubIndex, 0, sizeof(IndexSubIndex));
+        memset(IndexUnchanged, 0, sizeof(IndexUnchanged));
+        szCdnConfigDir[0] = szCdnDataDir[0] = 0;
+        memset(ModeCounts, 0, sizeof(ModeCounts));
+        memset(&RootFile, 0, sizeof(SYNTH_FILE));
+        memset(&EncodingFile, 0, sizeof(SYNTH_FILE));
+        memset(&DownloadFile, 0, sizeof(SYNTH_FILE));
+        memset(&InstallFile, 0, sizeof(SYNTH_FILE));
+    }
+
+    ~TSyntheticStorage()
+    {
+        FileStream_Close(pDataFile);
+        if(hsCrypt != NULL)
+            hsCrypt->Release();
+        CASC_FREE(pbContent);
+        CASC_FREE(pbEncoded);
+        CASC_FREE(pbFrame);
+        CASC_FREE(pbArchive);
+    }
+
+    // Creates the entire storage in Params.szStoragePath
+    DWORD Generate(const SYNTH_PARAMS & NewParams)
+    {
+        DWORD dwErrCode;
+
+        // Check and remember the parameters
+        if(NewParams.szStoragePath == NULL || NewParams.dwFileCount == 0 || NewParams.dwFrameSize == 0)
+            return ERROR_INVALID_PARAMETER;
+        if(NewParams.dwMinFileSize == 0 || NewParams.dwMinFileSize > NewParams.dwMaxFileSize)
+            return ERROR_INVALID_PARAMETER;
+        Params = NewParams;
+        RandomState = ((ULONGLONG)Params.dwSeed << 32) | 0x9E3779B9;
+
+        // Prepare the directory structure, buffers and the encryption key
+        if((dwErrCode = CreateDirectories()) != ERROR_SUCCESS)
+            return dwErrCode;
+        if((dwErrCode = AllocateBuffers()) != ERROR_SUCCESS)
+            return dwErrCode;
+        if((dwErrCode = Files.Create<SYNTH_FILE>(Params.dwFileCount)) != ERROR_SUCCESS)
+            return dwErrCode;
+
+        // Generate all files into the data files. The staged files follow the files of the build
+        if((dwErrCode = StagedFiles.Create<SYNTH_FILE>(Params.dwStagedFiles)) != ERROR_SUCCESS)
+            return dwErrCode;
+        for(DWORD i = 0; i < Params.dwFileCount; i++)
+        {
+            if((dwErrCode = GenerateFile(Files, i)) != ERROR_SUCCESS)
+                return dwErrCode;
+        }
+        for(DWORD i = 0; i < Params.dwStagedFiles; i++)
+        {
+            if((dwErrCode = GenerateFile(StagedFiles, Params.dwFileCount + i)) != ERROR_SUCCESS)
+                return dwErrCode;
+        }
+
+        return WriteBuild();
+    }
+
+    // Creates the next build in the same directory, like the agent does when the game is updated.
+    // Every n-th file gets a new content and the staged files become part of the build.
+    // Only the index files whose entries changed are written again, with a new sub-index.
+    // The previous build is not modified, so it can be still open
+    DWORD Update(DWORD dwChangedFiles)
+    {
+        DWORD dwFirstStaged = (DWORD)Files.ItemCount();
+        DWORD dwErrCode;
+
+        // Only WoW storages without the CDN tree are supported
+        if(Files.ItemCount() == 0 || Params.bTvfsRoot || Params.bInstallRoot || Params.dwCdnPort != 0)
+            return ERROR_NOT_SUPPORTED;
+        if(dwChangedFiles == 0 || dwChangedFiles > Files.ItemCount())
+            return ERROR_INVALID_PARAMETER;
+
+        // The changed files go to a new data file
+        DataFileIndex++;
+        for(DWORD i = 0; i < dwChangedFiles; i++)
+        {
+            DWORD dwFileIndex = (DWORD)(((ULONGLONG)i * Files.ItemCount()) / dwChangedFiles);
+
+            if((dwErrCode = EncodeAndStoreFile(*FileAt(dwFileIndex), dwFileIndex)) != ERROR_SUCCESS)
+                return dwErrCode;
+        }
+
+        // The staged files are already in the data files
+        if(StagedFiles.ItemCount() != 0 && Files.Insert(StagedFiles.ItemArray(), StagedFiles.ItemCount()) == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+        Params.dwFileCount += Params.dwStagedFiles;
+        Params.dwStagedFiles = 0;
+        StagedFiles.Reset();
+
+        if((dwErrCode = WriteBuild()) != ERROR_SUCCESS)
+            return dwErrCode;
+
+        // The index file of a staged file may be the same as in the previous build,
+        // while the file itself is not known to the previous build
+        StagedUnchangedCount = 0;
+        for(DWORD i = dwFirstStaged; i < Files.ItemCount(); i++)
+            StagedUnchangedCount += IndexUnchanged[GetEKeyBucketIndex(FileAt(i)->EKey)] ? 1 : 0;
+        return ERROR_SUCCESS;
+    }
+
+    // Retrieves the name of the n-th file. Deterministic, so the benchmark can find the files
+    static void GetFileName(char * szBuffer, size_t ccBuffer, DWORD dwFileIndex)
+    {
+        switch(dwFileIndex & 0x03)
+        {
+            case 0: CascStrPrintf(szBuffer, ccBuffer, "world/maps/synth%02u/synth%02u_%02u_%05u.adt", (dwFileIndex >> 10) & 0x3F, (dwFileIndex >> 10) & 0x3F, (dwFileIndex >> 4) & 0x3F, dwFileIndex); break;
+            case 1: CascStrPrintf(szBuffer, ccBuffer, "creature/synth%03u/synth%03u_%05u.m2", (dwFileIndex >> 6) & 0x3FF, (dwFileIndex >> 6) & 0x3FF, dwFileIndex); break;
+            case 2: CascStrPrintf(szBuffer, ccBuffer, "interface/glues/synth%02u/texture%05u.blp", (dwFileIndex >> 8) & 0x3F, dwFileIndex); break;
+            case 3: CascStrPrintf(szBuffer, ccBuffer, "sound/synth/synth%04u/sound%05u.ogg", (dwFileIndex >> 7) & 0x1FFF, dwFileIndex); break;
+        }
+    }
+
+    // In TVFS storages, returns true if the n-th file is a span of a multi-span file.
+    // Such files have no name of their own. Only complete groups have the spans
+    static bool IsSpanFile(DWORD dwFileIndex, DWORD dwFileCount)
+    {
+        DWORD dwGroupEnd = (dwFileIndex / SYNTH_SPAN_GROUP + 1) * SYNTH_SPAN_GROUP;
+
+        return (dwGroupEnd <= dwFileCount) && (dwFileIndex % SYNTH_SPAN_GROUP) >= (SYNTH_SPAN_GROUP - SYNTH_SPAN_COUNT);
+    }
+
+    // In TVFS storages, returns true if the n-th file is only in the ROOT manifest.
+    // CascLib finds such files by their EKeys in the index files
+    static bool IsUnlistedFile(DWORD dwFileIndex)
+    {
+        return (dwFileIndex % SYNTH_SPAN_GROUP) == 0;
+    }
+
+    // Name of the n-th file in TVFS storages. The names of the files that are only in ROOT
+    // contain characters that are not allowed in file names; each two of them only differ
+    // in such character, so they have the same name when extracted
+    static void GetTvfsFileName(char * szBuffer, size_t ccBuffer, DWORD dwFileIndex)
+    {
+        DWORD dwGroupIndex = dwFileIndex / SYNTH_SPAN_GROUP;
+
+        if(IsUnlistedFile(dwFileIndex))
+            CascStrPrintf(szBuffer, ccBuffer, "misc/unlisted%05u%c.dat", dwGroupIndex / 2, (dwGroupIndex & 1) ? '>' : '<');
+        else
+            GetFileName(szBuffer, ccBuffer, dwFileIndex);
+    }
+
+    // Name of the multi-span file of the n-th group. Its spans are the files
+    // (dwGroupIndex * SYNTH_SPAN_GROUP) + SYNTH_SPAN_GROUP - SYNTH_SPAN_COUNT and above
+    static void GetSpannedFileName(char * szBuffer, size_t ccBuffer, DWORD dwGroupIndex)
+    {
+        CascStrPrintf(szBuffer, ccBuffer, "zone/spanned/zone%05u.xpak", dwGroupIndex);
+    }
+
+    // Returns true if the n-th file has the given tag (index to SynthTags)
+    static bool FileHasTag(DWORD dwFileIndex, DWORD dwTagIndex)
+    {
+        DWORD dwHash = (dwFileIndex ^ (dwTagIndex * 0x9E3779B9)) * 0x85EBCA6B;
+
+        dwHash ^= dwHash >> 13;
+        dwHash *= 0xC2B2AE35;
+        dwHash ^= dwHash >> 16;
+        return (dwHash & 0xFF) < SynthTags[dwTagIndex].Density;
+    }
+
+    static const char * GetTagName(DWORD dwTagIndex)
+    {
+        return SynthTags[dwTagIndex].szTagName;
+    }
+
+    // Index to SynthTags of the n-th tag in the INSTALL manifest
+    static DWORD GetInstallTag(DWORD dwInstallTagIndex)
+    {
+        return SynthInstallTags[dwInstallTagIndex];
+    }
+
+    SYNTH_FILE * FileAt(size_t nIndex)
+    {
+        return (SYNTH_FILE *)Files.ItemAt(nIndex);
+    }
+
+    ULONGLONG TotalContentSize;                     // Sum of content sizes of all generated files
+    ULONGLONG TotalEncodedSize;                     // Sum of encoded sizes of all generated files
+    DWORD ModeCounts[SYNTH_MODE_COUNT];             // Number of files per encoding mode
+    DWORD ArchiveCount;                             // Number of CDN archives
+    DWORD LooseFileCount;                           // Number of loose files on the CDN
+    DWORD EncodingPageCount;                        // Number of CKey pages in ENCODING
+    DWORD UnchangedIndexCount;                      // Index files that are the same as in the previous build
+    DWORD UnchangedPageCount;                       // ENCODING pages that are the same as in the previous build
+    DWORD StagedUnchangedCount;                     // Staged files that are in an unchanged index file (see Update)
+
+    protected:
+
+    // Returns true if the n-th file is in the ENCODING and DOWNLOAD manifests
+    bool IsListedFile(DWORD dwFileIndex)
+    {
+        return !(Params.bTvfsRoot && IsUnlistedFile(dwFileIndex));
+    }
+
+    DWORD GetListedFileCount()
+    {
+        DWORD dwFileCount = 0;
+
+        for(DWORD i = 0; i < Files.ItemCount(); i++)
+            dwFileCount += IsListedFile(i) ? 1 : 0;
+        return dwFileCount;
+    }
+
+    DWORD CreateDirectories()
+    {
+        TCHAR szPath[MAX_PATH];
+
+        // The storage root, "data", "data/data" and "data/config"
+        MakeDirectory(Params.szStoragePath);
+        CombinePath(szPath, _countof(szPath), Params.szStoragePath, _T("data"), NULL);
+        MakeDirectory(szPath);
+        CombinePath(szPath, _countof(szPath), Params.szStoragePath, _T("data"), _T("config"), NULL);
+        MakeDirectory(szPath);
+        CombinePath(szPath, _countof(szPath), Params.szStoragePath, _T("data"), _T("data"), NULL);
+        MakeDirectory(szPath);
+        if(!DirectoryExists(szPath))
+            return ERROR_PATH_NOT_FOUND;
+
+        // The CDN tree: "cdn/wow", "cdn/tpr/synth/config" and "cdn/tpr/synth/data"
+        if(Params.dwCdnPort != 0)
+        {
+            CombinePath(szPath, _countof(szPath), Params.szStoragePath, _T("cdn"), NULL);
+            MakeDirectory(szPath);
+            CombinePath(szPath, _countof(szPath), Params.szStoragePath, _T("cdn"), SYNTH_CDN_PRODUCT, NULL);
+            MakeDirectory(szPath);
+            CombinePath(szPath, _countof(szPath), Params.szStoragePath, _T("cdn"), _T("tpr"), NULL);
+            MakeDirectory(szPath);
+            CombinePath(szPath, _countof(szPath), Params.szStoragePath, _T("cdn"), _T("tpr"), _T("synth"), NULL);
+            MakeDirectory(szPath);
+            CombinePath(szCdnConfigDir, _countof(szCdnConfigDir), Params.szStoragePath, _T("cdn"), _T("tpr"), _T("synth"), _T("config"), NULL);
+            MakeDirectory(szCdnConfigDir);
+            CombinePath(szCdnDataDir, _countof(szCdnDataDir), Params.szStoragePath, _T("cdn"), _T("tpr"), _T("synth"), _T("data"), NULL);
+            MakeDirectory(szCdnDataDir);
+            if(!DirectoryExists(szCdnDataDir))
+                return ERROR_PATH_NOT_FOUND;
+        }
+
+        return ERROR_SUCCESS;
+    }
+
+    DWORD AllocateBuffers()
+    {
+        DWORD dwFrameCount = (Params.dwMaxFileSize + Params.dwFrameSize - 1) / Params.dwFrameSize;
+
+        // Buffers for the file content, one encoded frame and the entire BLTE data
+        pbContent = CASC_ALLOC<BYTE>(Params.dwMaxFileSize);
+        pbFrame = CASC_ALLOC<BYTE>(GetMaxEncodedFrameSize(Params.dwFrameSize));
+        pbEncoded = CASC_ALLOC<BYTE>(sizeof(BLTE_ENCODED_HEADER) + dwFrameCount * (sizeof(BLTE_FRAME) + GetMaxEncodedFrameSize(Params.dwFrameSize)));
+        if(pbContent == NULL || pbFrame == NULL || pbEncoded == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+
+        // Buffer for the current CDN archive, list of its files and the list of all archives
+        if(Params.dwCdnPort != 0)
+        {
+            if((pbArchive = CASC_ALLOC<BYTE>(SYNTH_ARCHIVE_SIZE)) == NULL)
+                return ERROR_NOT_ENOUGH_MEMORY;
+            if(ArchiveEntries.Create<SYNTH_ARCHIVE_ENTRY>(0x400) != ERROR_SUCCESS)
+                return ERROR_NOT_ENOUGH_MEMORY;
+            if(ArchiveKeys.Create(MD5_HASH_SIZE, 0x40) != ERROR_SUCCESS)
+                return ERROR_NOT_ENOUGH_MEMORY;
+        }
+
+        // Hashes of the ENCODING pages, for comparing with the next build
+        if(PageHashes.Create(MD5_HASH_SIZE, 0x100) != ERROR_SUCCESS)
+            return ERROR_NOT_ENOUGH_MEMORY;
+
+        // We use the decryption of a dummy storage for encrypting. Salsa20 is symmetric
+        if((hsCrypt = new TCascStorage()) == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+        return CascLoadEncryptionKeys(hsCrypt);
+    }
+
+    ULONGLONG GetRandom()
+    {
+        // xorshift64*
+        RandomState ^= RandomState >> 12;
+        RandomState ^= RandomState << 25;
+        RandomState ^= RandomState >> 27;
+        return RandomState * 0x2545F4914F6CDD1DULL;
+    }
+
+    // Most files in real storages are small. Use cubic distribution of the sizes
+    DWORD GetRandomFileSize()
+    {
+        ULONGLONG Range = Params.dwMaxFileSize - Params.dwMinFileSize;
+        ULONGLONG Random = GetRandom() & 0x3FF;
+
+        return Params.dwMinFileSize + (DWORD)((Range * Random * Random * Random) >> 30);
+    }
+
+    // Half of the files is compressible text, the other half is random data
+    void GenerateContent(LPBYTE pbBuffer, DWORD cbBuffer, DWORD dwFileIndex)
+    {
+        static const char * Words[] = {"CASC ", "storage ", "frame ", "encoding ", "root ", "index ", "synthetic ", "data\n"};
+        LPBYTE pbBufferEnd = pbBuffer + cbBuffer;
+        ULONGLONG RandomValue;
+
+        if(dwFileIndex & 0x01)
+        {
+            char szFileIndex[0x10];
+            size_t nLength;
+
+            // Small text files would often be identical. Duplicate CKeys are not allowed in ENCODING
+            nLength = CascStrPrintf(szFileIndex, _countof(szFileIndex), "%u ", dwFileIndex);
+            nLength = CASCLIB_MIN(nLength, (size_t)(pbBufferEnd - pbBuffer));
+            memcpy(pbBuffer, szFileIndex, nLength);
+            pbBuffer += nLength;
+
+            while(pbBuffer < pbBufferEnd)
+            {
+                const char * szWord = Words[GetRandom() & 0x07];
+
+                nLength = CASCLIB_MIN(strlen(szWord), (size_t)(pbBufferEnd - pbBuffer));
+                memcpy(pbBuffer, szWord, nLength);
+                pbBuffer += nLength;
+            }
+        }
+        else
+        {
+            while(pbBuffer < pbBufferEnd)
+            {
+                RandomValue = GetRandom();
+                for(size_t i = 0; i < sizeof(ULONGLONG) && pbBuffer < pbBufferEnd; i++, RandomValue >>= 8)
+                    *pbBuffer++ = (BYTE)RandomValue;
+            }
+        }
+    }
+
+    DWORD EncodeFrame(LPBYTE pbOutBuffer, LPBYTE pbInBuffer, DWORD cbInBuffer, DWORD dwMode, DWORD dwFrameIndex)
+    {
+        LPBYTE pbPlainFrame = (dwMode >= SYNTH_MODE_ENCRYPTED_N) ? pbFrame + 0x0F : pbOutBuffer;
+        DWORD cbPlainFrame = 0;
+
+        // Create the 'N' or 'Z' frame
+        switch(dwMode)
+        {
+            case SYNTH_MODE_NORMAL:
+            case SYNTH_MODE_ENCRYPTED_N:
+                pbPlainFrame[0] = 'N';
+                memcpy(pbPlainFrame + 1, pbInBuffer, cbInBuffer);
+                cbPlainFrame = cbInBuffer + 1;
+                break;
+
+            case SYNTH_MODE_ZLIB:
+            case SYNTH_MODE_ENCRYPTED_Z:
+                pbPlainFrame[0] = 'Z';
+                cbPlainFrame = ZlibCompress(pbPlainFrame + 1, GetMaxEncodedFrameSize(Params.dwFrameSize) - 0x10, pbInBuffer, cbInBuffer);
+                if(cbPlainFrame == 0)
+                    return 0;
+                cbPlainFrame++;
+                break;
+        }
+
+        // Encrypt the frame. The input for CascDecrypt is: key name length, key name,
+        // IV length, IV, encryption type and the data. The output is just the data
+        if(dwMode >= SYNTH_MODE_ENCRYPTED_N)
+        {
+            ULONGLONG KeyName = SYNTH_ENCRYPTION_KEY;
+            DWORD Vector = (DWORD)GetRandom();
+            DWORD cbEncrypted = cbPlainFrame;
+
+            pbFrame[0] = sizeof(ULONGLONG);
+            memcpy(pbFrame + 1, &KeyName, sizeof(ULONGLONG));
+            pbFrame[9] = sizeof(DWORD);
+            memcpy(pbFrame + 10, &Vector, sizeof(DWORD));
+            pbFrame[14] = 'S';
+
+            pbOutBuffer[0] = 'E';
+            memcpy(pbOutBuffer + 1, pbFrame, 0x0F);
+            if(CascDecrypt(hsCrypt, pbOutBuffer + 0x10, &cbEncrypted, pbFrame, 0x0F + cbPlainFrame, dwFrameIndex) != ERROR_SUCCESS)
+                return 0;
+            return cbEncrypted + 0x10;
+        }
+
+        return cbPlainFrame;
+    }
+
+    // Encodes the content to BLTE, behind the space for BLTE_ENCODED_HEADER
+    DWORD EncodeFile(SYNTH_FILE & File, LPBYTE pbFileData, DWORD dwMode, bool bFrameTable)
+    {
+        LPBYTE pbBlte = pbEncoded + FIELD_OFFSET(BLTE_ENCODED_HEADER, Signature);
+        LPBYTE pbFramePtr;
+        LPBYTE pbDataPtr;
+        DWORD dwFrameCount = bFrameTable ? (File.ContentSize + Params.dwFrameSize - 1) / Params.dwFrameSize : 1;
+        DWORD cbHeader = bFrameTable ? (0x0C + dwFrameCount * sizeof(BLTE_FRAME)) : 0;
+        DWORD cbEncodedFrame;
+        DWORD cbFrame;
+
+        // BLTE header. The frame table is only present if the header size is nonzero
+        ConvertIntegerToBytes_4_LE(BLTE_HEADER_SIGNATURE, pbBlte);
+        ConvertIntegerToBytes_4(cbHeader, pbBlte + 4);
+        pbFramePtr = pbBlte + 0x0C;
+        pbDataPtr = bFrameTable ? (pbBlte + cbHeader) : (pbBlte + 8);
+        if(bFrameTable)
+        {
+            pbBlte[8] = 0x0F;
+            ConvertIntegerToBytes_BE(dwFrameCount, pbBlte + 9, 3);
+        }
+
+        // Encode all frames
+        for(DWORD i = 0; i < dwFrameCount; i++)
+        {
+            cbFrame = bFrameTable ? CASCLIB_MIN(Params.dwFrameSize, File.ContentSize - i * Params.dwFrameSize) : File.ContentSize;
+            cbEncodedFrame = EncodeFrame(pbDataPtr, pbFileData + i * Params.dwFrameSize, cbFrame, dwMode, i);
+            if(cbEncodedFrame == 0)
+                return ERROR_CAN_NOT_COMPLETE;
+
+            // Fill the frame table entry
+            if(bFrameTable)
+            {
+                PBLTE_FRAME pFrame = (PBLTE_FRAME)(pbFramePtr + i * sizeof(BLTE_FRAME));
+
+                ConvertIntegerToBytes_4(cbEncodedFrame, pFrame->EncodedSize);
+                ConvertIntegerToBytes_4(cbFrame, pFrame->ContentSize);
+                CascCalculateDataBlockHash(pbDataPtr, cbEncodedFrame, pFrame->FrameHash.Value);
+            }
+            pbDataPtr += cbEncodedFrame;
+        }
+
+        // EKey is the MD5 of the BLTE header. Without frame table, it's the MD5 of the entire BLTE data
+        CascCalculateDataBlockHash(pbBlte, bFrameTable ? cbHeader : (DWORD)(pbDataPtr - pbBlte), File.EKey);
+        File.EncodedSize = (DWORD)(pbDataPtr - pbEncoded);
+        return ERROR_SUCCESS;
+    }
+
+    // Writes the encoded file with the header span to the current data file.
+    // If there is a CDN tree, the file also goes to a CDN archive or it becomes a loose file
+    DWORD StoreFile(SYNTH_FILE & File, bool bLooseFile)
+    {
+        PBLTE_ENCODED_HEADER pHeader = (PBLTE_ENCODED_HEADER)pbEncoded;
+        TCHAR szPlainName[0x20];
+        TCHAR szDataFile[MAX_PATH];
+
+        // Move to the next data file if this one is full
+        if(pDataFile != NULL && (DataFileOffset + File.EncodedSize) > SYNTH_SEGMENT_SIZE)
+        {
+            FileStream_Close(pDataFile);
+            pDataFile = NULL;
+            DataFileIndex++;
+        }
+
+        // Create the data file, if not open yet
+        if(pDataFile == NULL)
+        {
+            CascStrPrintf(szPlainName, _countof(szPlainName), _T("data.%03u"), DataFileIndex);
+            CombinePath(szDataFile, _countof(szDataFile), Params.szStoragePath, _T("data"), _T("data"), szPlainName, NULL);
+            if((pDataFile = FileStream_CreateFile(szDataFile, BASE_PROVIDER_FILE | STREAM_PROVIDER_FLAT)) == NULL)
+                return GetCascError();
+            DataFileOffset = 0;
+        }
+
+        // Fill the header span. The EKey is stored byte-reversed
+        for(size_t i = 0; i < MD5_HASH_SIZE; i++)
+            pHeader->EKey.Value[i] = File.EKey[MD5_HASH_SIZE - 1 - i];
+        pHeader->EncodedSize = File.EncodedSize;
+        pHeader->field_14 = 0;
+        pHeader->field_15 = 0;
+        ConvertIntegerToBytes_4_LE(hashlittle(pHeader, FIELD_OFFSET(BLTE_ENCODED_HEADER, JenkinsHash), 0x3D6BE971), pHeader->JenkinsHash);
+        memset(pHeader->Checksum, 0, sizeof(pHeader->Checksum));
+
+        // Write the file to the data file
+        File.StorageOffset = ((ULONGLONG)DataFileIndex << SYNTH_FILE_OFFSET_BITS) | DataFileOffset;
+        if(!FileStream_Write(pDataFile, &DataFileOffset, pbEncoded, File.EncodedSize))
+            return GetCascError();
+        DataFileOffset += File.EncodedSize;
+
+        TotalContentSize += File.ContentSize;
+        TotalEncodedSize += File.EncodedSize;
+        return (Params.dwCdnPort != 0) ? StoreCdnFile(File, bLooseFile) : ERROR_SUCCESS;
+    }
+
+    // CDN archives and loose files only contain the BLTE data, without BLTE_ENCODED_HEADER
+    DWORD StoreCdnFile(SYNTH_FILE & File, bool bLooseFile)
+    {
+        SYNTH_ARCHIVE_ENTRY * pEntry;
+        LPBYTE pbBlte = pbEncoded + FIELD_OFFSET(BLTE_ENCODED_HEADER, Signature);
+        DWORD cbBlte = File.EncodedSize - FIELD_OFFSET(BLTE_ENCODED_HEADER, Signature);
+        DWORD dwErrCode;
+
+        // Loose file is stored as "data/xx/yy/<ekey>"
+        if(bLooseFile || cbBlte > SYNTH_ARCHIVE_SIZE)
+        {
+            LooseFileCount++;
+            return WriteKeyedFile(szCdnDataDir, File.EKey, pbBlte, cbBlte, NULL);
+        }
+
+        // Close the current archive if the file doesn't fit in
+        if((cbArchive + cbBlte) > SYNTH_ARCHIVE_SIZE)
+        {
+            if((dwErrCode = FlushArchive()) != ERROR_SUCCESS)
+                return dwErrCode;
+        }
+
+        // Append the file to the archive
+        if((pEntry = (SYNTH_ARCHIVE_ENTRY *)ArchiveEntries.Insert(1)) == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+        memcpy(pEntry->EKey, File.EKey, MD5_HASH_SIZE);
+        pEntry->EncodedSize = cbBlte;
+        pEntry->ArchiveOffset = cbArchive;
+        memcpy(pbArchive + cbArchive, pbBlte, cbBlte);
+        cbArchive += cbBlte;
+        return ERROR_SUCCESS;
+    }
+
+    // Writes the current CDN archive and its index. The index has pages of entries sorted by EKey,
+    // the table of contents (last EKey and hash of each page) and the footer.
+    // The name of both the archive and the index is the MD5 of the footer
+    DWORD FlushArchive()
+    {
+        SYNTH_ARCHIVE_ENTRY * pEntries = (SYNTH_ARCHIVE_ENTRY *)ArchiveEntries.ItemArray();
+        LPBYTE pbIndexFile;
+        LPBYTE pbTocKeys;
+        LPBYTE pbTocHashes;
+        LPBYTE pbFooter;
+        BYTE ArchiveKey[MD5_HASH_SIZE];
+        BYTE Hash[MD5_HASH_SIZE];
+        DWORD dwEntryCount = (DWORD)ArchiveEntries.ItemCount();
+        DWORD dwEntriesPerPage = SYNTH_ARCHIVE_PAGE_SIZE / SYNTH_ARCHIVE_ITEM_SIZE;
+        DWORD dwPageCount = (dwEntryCount + dwEntriesPerPage - 1) / dwEntriesPerPage;
+        DWORD cbTocEntry = MD5_HASH_SIZE + SYNTH_ARCHIVE_HASH_SIZE;
+        DWORD cbFooter = SYNTH_ARCHIVE_HASH_SIZE + 12 + SYNTH_ARCHIVE_HASH_SIZE;
+        DWORD cbIndexFile = dwPageCount * (SYNTH_ARCHIVE_PAGE_SIZE + cbTocEntry) + cbFooter;
+        DWORD dwErrCode;
+
+        // Nothing to do if the archive is empty (or if there is no CDN tree)
+        if(dwEntryCount == 0)
+            return ERROR_SUCCESS;
+        qsort(pEntries, dwEntryCount, sizeof(SYNTH_ARCHIVE_ENTRY), CompareArchiveEntries);
+
+        if((pbIndexFile = CASC_ALLOC_ZERO<BYTE>(cbIndexFile)) == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+        pbTocKeys = pbIndexFile + dwPageCount * SYNTH_ARCHIVE_PAGE_SIZE;
+        pbTocHashes = pbTocKeys + dwPageCount * MD5_HASH_SIZE;
+        pbFooter = pbTocHashes + dwPageCount * SYNTH_ARCHIVE_HASH_SIZE;
+
+        // Pages of entries. Entries don't cross the page boundary; the rest of the page is zeroed
+        for(DWORD i = 0; i < dwEntryCount; i++)
+        {
+            LPBYTE pbEntry = pbIndexFile + (i / dwEntriesPerPage) * SYNTH_ARCHIVE_PAGE_SIZE + (i % dwEntriesPerPage) * SYNTH_ARCHIVE_ITEM_SIZE;
+
+            memcpy(pbEntry, pEntries[i].EKey, MD5_HASH_SIZE);
+            ConvertIntegerToBytes_4(pEntries[i].EncodedSize, pbEntry + MD5_HASH_SIZE);
+            ConvertIntegerToBytes_4(pEntries[i].ArchiveOffset, pbEntry + MD5_HASH_SIZE + 4);
+        }
+
+        // Table of contents: last EKey of each page, then the truncated MD5 of each page
+        for(DWORD i = 0; i < dwPageCount; i++)
+        {
+            DWORD dwLastEntry = CASCLIB_MIN((i + 1) * dwEntriesPerPage, dwEntryCount) - 1;
+
+            memcpy(pbTocKeys + i * MD5_HASH_SIZE, pEntries[dwLastEntry].EKey, MD5_HASH_SIZE);
+            CascCalculateDataBlockHash(pbIndexFile + i * SYNTH_ARCHIVE_PAGE_SIZE, SYNTH_ARCHIVE_PAGE_SIZE, Hash);
+            memcpy(pbTocHashes + i * SYNTH_ARCHIVE_HASH_SIZE, Hash, SYNTH_ARCHIVE_HASH_SIZE);
+        }
+
+        // Footer: TOC hash, version, 2 reserved bytes, page size in KB, offset bytes, size bytes,
+        // EKey length, footer hash length, element count (little endian) and the footer hash.
+        // The footer hash is the MD5 of the footer from the version on, with the footer hash zeroed
+        CascCalculateDataBlockHash(pbTocKeys, (DWORD)(pbFooter - pbTocKeys), Hash);
+        memcpy(pbFooter, Hash, SYNTH_ARCHIVE_HASH_SIZE);
+        pbFooter[SYNTH_ARCHIVE_HASH_SIZE + 0] = 1;
+        pbFooter[SYNTH_ARCHIVE_HASH_SIZE + 3] = SYNTH_ARCHIVE_PAGE_SIZE >> 10;
+        pbFooter[SYNTH_ARCHIVE_HASH_SIZE + 4] = 4;
+        pbFooter[SYNTH_ARCHIVE_HASH_SIZE + 5] = 4;
+        pbFooter[SYNTH_ARCHIVE_HASH_SIZE + 6] = MD5_HASH_SIZE;
+        pbFooter[SYNTH_ARCHIVE_HASH_SIZE + 7] = SYNTH_ARCHIVE_HASH_SIZE;
+        ConvertIntegerToBytes_4_LE(dwEntryCount, pbFooter + SYNTH_ARCHIVE_HASH_SIZE + 8);
+        CascCalculateDataBlockHash(pbFooter + SYNTH_ARCHIVE_HASH_SIZE, cbFooter - SYNTH_ARCHIVE_HASH_SIZE, Hash);
+        memcpy(pbFooter + SYNTH_ARCHIVE_HASH_SIZE + 12, Hash, SYNTH_ARCHIVE_HASH_SIZE);
+        CascCalculateDataBlockHash(pbFooter, cbFooter, ArchiveKey);
+
+        // Write the archive and its index
+        dwErrCode = WriteKeyedFile(szCdnDataDir, ArchiveKey, pbArchive, cbArchive, NULL);
+        if(dwErrCode == ERROR_SUCCESS)
+            dwErrCode = WriteKeyedFile(szCdnDataDir, ArchiveKey, pbIndexFile, cbIndexFile, _T(".index"));
+        if(dwErrCode == ERROR_SUCCESS && ArchiveKeys.Insert(ArchiveKey, 1) == NULL)
+            dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+        CASC_FREE(pbIndexFile);
+
+        // Start a new archive
+        ArchiveEntries.Reset();
+        cbArchive = 0;
+        ArchiveCount++;
+        return dwErrCode;
+    }
+
+    DWORD GenerateFile(CASC_ARRAY & FileArray, DWORD dwFileIndex)
+    {
+        SYNTH_FILE * pFile = (SYNTH_FILE *)FileArray.Insert(1);
+
+        if(pFile == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+        return EncodeAndStoreFile(*pFile, dwFileIndex);
+    }
+
+    // Creates a new content of the file, encodes it and writes it to the data file
+    DWORD EncodeAndStoreFile(SYNTH_FILE & File, DWORD dwFileIndex)
+    {
+        DWORD dwMode = dwFileIndex % SYNTH_MODE_COUNT;
+        DWORD dwErrCode;
+        char szFileName[MAX_PATH];
+
+        // Create the file content
+        File.ContentSize = GetRandomFileSize();
+        File.FileDataId = dwFileIndex + 1;
+        GenerateContent(pbContent, File.ContentSize, dwFileIndex);
+        CascCalculateDataBlockHash(pbContent, File.ContentSize, File.CKey);
+        if((Params.dwDamage & SYNTH_DAMAGE_CONTENT_KEY) && dwFileIndex == 0)
+            File.CKey[0] ^= 0xFF;
+
+        // Name hash for the ROOT file
+        GetFileName(szFileName, _countof(szFileName), dwFileIndex);
+        File.FileNameHash = CalcFileNameHash(szFileName);
+
+        // Small files are sometimes stored without the frame table
+        if((dwErrCode = EncodeFile(File, pbContent, dwMode, (File.ContentSize > Params.dwFrameSize || (dwFileIndex & 0x04)))) != ERROR_SUCCESS)
+            return dwErrCode;
+        ModeCounts[dwMode]++;
+
+        return StoreFile(File, (dwFileIndex % SYNTH_LOOSE_FILE_STEP) == (SYNTH_LOOSE_FILE_STEP - 1));
+    }
+
+    // Creates the manifests, the index files, configs and the build file for the files in Files
+    DWORD WriteBuild()
+    {
+        DWORD dwErrCode;
+
+        // ROOT, DOWNLOAD and INSTALL must be done first, as they must be in ENCODING
+        if((dwErrCode = (Params.bTvfsRoot) ? WriteTvfsRootFile() : WriteRootFile()) != ERROR_SUCCESS)
+            return dwErrCode;
+        if((dwErrCode = WriteDownloadFile()) != ERROR_SUCCESS)
+            return dwErrCode;
+        if(Params.bInstallRoot && (dwErrCode = WriteInstallFile()) != ERROR_SUCCESS)
+            return dwErrCode;
+        if((dwErrCode = WriteEncodingFile()) != ERROR_SUCCESS)
+            return dwErrCode;
+        if((dwErrCode = FlushArchive()) != ERROR_SUCCESS)
+            return dwErrCode;
+        FileStream_Close(pDataFile);
+        pDataFile = NULL;
+
+        // Create the index files, configs and the build file
+        if((dwErrCode = WriteIndexFiles()) != ERROR_SUCCESS)
+            return dwErrCode;
+        if((dwErrCode = WriteConfigsAndBuildInfo()) != ERROR_SUCCESS)
+            return dwErrCode;
+        return WriteListFile();
+    }
+
+    // Stores a manifest file. The manifests are not part of the Files array, and they are loose files on the CDN
+    DWORD StoreManifest(SYNTH_FILE & File, LPBYTE pbFileData, DWORD cbFileData, DWORD dwMode)
+    {
+        LPBYTE pbSaveEncoded = pbEncoded;
+        DWORD dwFrameCount = (cbFileData + Params.dwFrameSize - 1) / Params.dwFrameSize;
+        DWORD dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+
+        // The manifests can be larger than the maximal file size
+        memset(&File, 0, sizeof(SYNTH_FILE));
+        File.ContentSize = cbFileData;
+        CascCalculateDataBlockHash(pbFileData, cbFileData, File.CKey);
+
+        if((pbEncoded = CASC_ALLOC<BYTE>(sizeof(BLTE_ENCODED_HEADER) + dwFrameCount * (sizeof(BLTE_FRAME) + GetMaxEncodedFrameSize(Params.dwFrameSize)))) != NULL)
+        {
+            if((dwErrCode = EncodeFile(File, pbFileData, dwMode, true)) == ERROR_SUCCESS)
+                dwErrCode = StoreFile(File, true);
+            CASC_FREE(pbEncoded);
+        }
+
+        pbEncoded = pbSaveEncoded;
+        return dwErrCode;
+    }
+
+    // ROOT in the format of WoW 8.2+ with one group of files with name hashes.
+    // Storages with the file names in INSTALL only have a MD5 string there, which CascLib ignores
+    DWORD WriteRootFile()
+    {
+        if(Params.bInstallRoot)
+        {
+            char szRootText[MD5_STRING_SIZE + 1];
+
+            StringFromBinary(FileAt(0)->CKey, MD5_HASH_SIZE, szRootText);
+            return StoreManifest(RootFile, (LPBYTE)szRootText, MD5_STRING_SIZE, SYNTH_MODE_NORMAL);
+        }
+
+        FILE_ROOT_HEADER RootHeader;
+        LPBYTE pbRootFile;
+        LPBYTE pbRootPtr;
+        DWORD dwFileCount = (DWORD)Files.ItemCount();
+        DWORD cbRootFile = sizeof(FILE_ROOT_HEADER) + 3 * sizeof(DWORD) + dwFileCount * (sizeof(DWORD) + MD5_HASH_SIZE + sizeof(ULONGLONG));
+        DWORD dwPrevFileDataId = 0;
+        DWORD dwErrCode;
+
+        if((pbRootFile = pbRootPtr = CASC_ALLOC<BYTE>(cbRootFile)) == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+
+        // Header and the group header
+        RootHeader.Signature = CASC_WOW82_ROOT_SIGNATURE;
+        RootHeader.TotalFiles = dwFileCount;
+        RootHeader.FilesWithNameHash = dwFileCount;
+        memcpy(pbRootPtr, &RootHeader, sizeof(FILE_ROOT_HEADER));
+        pbRootPtr += sizeof(FILE_ROOT_HEADER);
+        pbRootPtr = WriteDword(pbRootPtr, dwFileCount);
+        pbRootPtr = WriteDword(pbRootPtr, 0);
+        pbRootPtr = WriteDword(pbRootPtr, SYNTH_LOCALE_FLAGS);
+
+        // File data IDs are stored as deltas
+        for(DWORD i = 0; i < dwFileCount; i++)
+        {
+            pbRootPtr = WriteDword(pbRootPtr, FileAt(i)->FileDataId - dwPrevFileDataId);
+            dwPrevFileDataId = FileAt(i)->FileDataId + 1;
+        }
+
+        // CKeys, then name hashes
+        for(DWORD i = 0; i < dwFileCount; i++, pbRootPtr += MD5_HASH_SIZE)
+            memcpy(pbRootPtr, FileAt(i)->CKey, MD5_HASH_SIZE);
+        for(DWORD i = 0; i < dwFileCount; i++, pbRootPtr += sizeof(ULONGLONG))
+            memcpy(pbRootPtr, &FileAt(i)->FileNameHash, sizeof(ULONGLONG));
+
+        dwErrCode = StoreManifest(RootFile, pbRootFile, cbRootFile, SYNTH_MODE_ZLIB);
+        CASC_FREE(pbRootFile);
+        return dwErrCode;
+    }
+
+    // TVFS root: header, path table, VFS table and container file table (CFT). Each file has one CFT entry.
+    // The path table is flat, each name is one node. Multi-span files have several spans in their VFS entry
+    DWORD WriteTvfsRootFile()
+    {
+        LPBYTE pbRootFile;
+        LPBYTE pbPathPtr;
+        LPBYTE pbVfsTable;
+        LPBYTE pbVfsPtr;
+        LPBYTE pbCftTable;
+        DWORD dwFileCount = (DWORD)Files.ItemCount();
+        DWORD dwGroupCount = dwFileCount / SYNTH_SPAN_GROUP;
+        DWORD cbCftTable = dwFileCount * SYNTH_TVFS_CFT_ENTRY;
+        DWORD cbCftOffset = (cbCftTable > 0xffffff) ? 4 : (cbCftTable > 0xffff) ? 3 : (cbCftTable > 0xff) ? 2 : 1;
+        DWORD cbPathTable = 0;
+        DWORD cbVfsTable = 0;
+        DWORD cbRootFile;
+        DWORD dwErrCode;
+        char szFileName[MAX_PATH];
+
+        // Size of the path table and of the VFS table
+        for(DWORD i = 0; i < dwFileCount; i++)
+        {
+            if(!IsSpanFile(i, dwFileCount))
+            {
+                GetTvfsFileName(szFileName, _countof(szFileName), i);
+                cbPathTable += 1 + (DWORD)strlen(szFileName) + 1 + sizeof(DWORD);
+                cbVfsTable += 1 + 8 + cbCftOffset;
+            }
+        }
+        for(DWORD i = 0; i < dwGroupCount; i++)
+        {
+            GetSpannedFileName(szFileName, _countof(szFileName), i);
+            cbPathTable += 1 + (DWORD)strlen(szFileName) + 1 + sizeof(DWORD);
+            cbVfsTable += 1 + SYNTH_SPAN_COUNT * (8 + cbCftOffset);
+        }
+
+        cbRootFile = SYNTH_TVFS_HEADER_SIZE + cbPathTable + cbVfsTable + cbCftTable;
+        if((pbRootFile = CASC_ALLOC_ZERO<BYTE>(cbRootFile)) == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+        pbPathPtr = pbRootFile + SYNTH_TVFS_HEADER_SIZE;
+        pbVfsTable = pbVfsPtr = pbPathPtr + cbPathTable;
+        pbCftTable = pbVfsTable + cbVfsTable;
+
+        // Header: signature, version, header size, EKey size, patch key size, flags,
+        // then offsets and sizes of the tables (big endian) and the maximum depth
+        ConvertIntegerToBytes_4_LE(CASC_TVFS_ROOT_SIGNATURE, pbRootFile);
+        pbRootFile[4] = 1;
+        pbRootFile[5] = SYNTH_TVFS_HEADER_SIZE;
+        pbRootFile[6] = 9;
+        pbRootFile[7] = 9;
+        ConvertIntegerToBytes_4((DWORD)(pbPathPtr - pbRootFile), pbRootFile + 0x0C);
+        ConvertIntegerToBytes_4(cbPathTable, pbRootFile + 0x10);
+        ConvertIntegerToBytes_4((DWORD)(pbVfsTable - pbRootFile), pbRootFile + 0x14);
+        ConvertIntegerToBytes_4(cbVfsTable, pbRootFile + 0x18);
+        ConvertIntegerToBytes_4((DWORD)(pbCftTable - pbRootFile), pbRootFile + 0x1C);
+        ConvertIntegerToBytes_4(cbCftTable, pbRootFile + 0x20);
+        ConvertIntegerToBytes_BE(1, pbRootFile + 0x24, 2);
+
+        // Container file table
+        for(DWORD i = 0; i < dwFileCount; i++)
+        {
+            SYNTH_FILE * pFile = (SYNTH_FILE *)Files.ItemArray() + i;
+            LPBYTE pbCftEntry = pbCftTable + i * SYNTH_TVFS_CFT_ENTRY;
+
+            memcpy(pbCftEntry, pFile->EKey, 9);
+            ConvertIntegerToBytes_4(pFile->EncodedSize - FIELD_OFFSET(BLTE_ENCODED_HEADER, Signature), pbCftEntry + 9);
+            ConvertIntegerToBytes_4(pFile->ContentSize, pbCftEntry + 13);
+        }
+
+        // Single-span files, then multi-span files
+        for(DWORD i = 0; i < dwFileCount; i++)
+        {
+            if(!IsSpanFile(i, dwFileCount))
+            {
+                GetTvfsFileName(szFileName, _countof(szFileName), i);
+                pbPathPtr = WriteTvfsPathEntry(pbPathPtr, szFileName, (DWORD)(pbVfsPtr - pbVfsTable));
+                pbVfsPtr = WriteTvfsVfsEntry(pbVfsPtr, i, 1, cbCftOffset);
+            }
+        }
+        for(DWORD i = 0; i < dwGroupCount; i++)
+        {
+            GetSpannedFileName(szFileName, _countof(szFileName), i);
+            pbPathPtr = WriteTvfsPathEntry(pbPathPtr, szFileName, (DWORD)(pbVfsPtr - pbVfsTable));
+            pbVfsPtr = WriteTvfsVfsEntry(pbVfsPtr, (i + 1) * SYNTH_SPAN_GROUP - SYNTH_SPAN_COUNT, SYNTH_SPAN_COUNT, cbCftOffset);
+        }
+
+        dwErrCode = StoreManifest(RootFile, pbRootFile, cbRootFile, SYNTH_MODE_ZLIB);
+        CASC_FREE(pbRootFile);
+        return dwErrCode;
+    }
+
+    // Path table entry: name length, name, 0xFF and the node value (offset of the VFS entry)
+    static LPBYTE WriteTvfsPathEntry(LPBYTE pbPathPtr, const char * szFileName, DWORD dwVfsOffset)
+    {
+        size_t nLength = strlen(szFileName);
+
+        *pbPathPtr++ = (BYTE)nLength;
+        memcpy(pbPathPtr, szFileName, nLength);
+        pbPathPtr += nLength;
+        *pbPathPtr++ = 0xFF;
+        ConvertIntegerToBytes_4(dwVfsOffset, pbPathPtr);
+        return pbPathPtr + sizeof(DWORD);
+    }
+
+    // VFS entry: span count, then offset in the file, size and CFT offset of each span
+    LPBYTE WriteTvfsVfsEntry(LPBYTE pbVfsPtr, DWORD dwFirstFile, DWORD dwSpanCount, DWORD cbCftOffset)
+    {
+        *pbVfsPtr++ = (BYTE)dwSpanCount;
+        for(DWORD i = 0; i < dwSpanCount; i++)
+        {
+            ConvertIntegerToBytes_4(0, pbVfsPtr);
+            ConvertIntegerToBytes_4(FileAt(dwFirstFile + i)->ContentSize, pbVfsPtr + 4);
+            ConvertIntegerToBytes_BE((dwFirstFile + i) * SYNTH_TVFS_CFT_ENTRY, pbVfsPtr + 8, cbCftOffset);
+            pbVfsPtr += 8 + cbCftOffset;
+        }
+        return pbVfsPtr;
+    }
+
+    // DOWNLOAD of version 1, without checksums. The tags follow the entries
+    DWORD WriteDownloadFile()
+    {
+        PFILE_DOWNLOAD_HEADER pHeader;
+        LPBYTE pbDownloadFile;
+        LPBYTE pbDownloadPtr;
+        DWORD dwFileCount = GetListedFileCount();
+        DWORD cbBitmap = (dwFileCount + 7) / 8;
+        DWORD cbDownloadFile = FIELD_OFFSET(FILE_DOWNLOAD_HEADER, FlagByteSize) + dwFileCount * sizeof(FILE_DOWNLOAD_ENTRY);
+        DWORD dwErrCode;
+
+        for(DWORD i = 0; i < SYNTH_TAG_COUNT; i++)
+            cbDownloadFile += (DWORD)strlen(SynthTags[i].szTagName) + 1 + sizeof(USHORT) + cbBitmap;
+        if((pbDownloadFile = CASC_ALLOC_ZERO<BYTE>(cbDownloadFile)) == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+
+        // File header
+        pHeader = (PFILE_DOWNLOAD_HEADER)pbDownloadFile;
+        pHeader->Magic = FILE_MAGIC_DOWNLOAD;
+        pHeader->Version = 1;
+        pHeader->EKeyLength = MD5_HASH_SIZE;
+        pHeader->EntryHasChecksum = 0;
+        ConvertIntegerToBytes_4(dwFileCount, pHeader->EntryCount);
+        ConvertIntegerToBytes_BE(SYNTH_TAG_COUNT, pHeader->TagCount, 2);
+        pbDownloadPtr = pbDownloadFile + FIELD_OFFSET(FILE_DOWNLOAD_HEADER, FlagByteSize);
+
+        // Entries. The file size is the size of the BLTE data
+        for(DWORD i = 0; i < Files.ItemCount(); i++)
+        {
+            PFILE_DOWNLOAD_ENTRY pEntry = (PFILE_DOWNLOAD_ENTRY)pbDownloadPtr;
+
+            if(IsListedFile(i))
+            {
+                memcpy(pEntry->EKey, FileAt(i)->EKey, MD5_HASH_SIZE);
+                ConvertIntegerToBytes_BE(FileAt(i)->EncodedSize - FIELD_OFFSET(BLTE_ENCODED_HEADER, Signature), pEntry->FileSize, 5);
+                pbDownloadPtr += sizeof(FILE_DOWNLOAD_ENTRY);
+            }
+        }
+
+        // Tags: name, big-endian type and a bitmap of entries, the most significant bit first
+        for(DWORD i = 0; i < SYNTH_TAG_COUNT; i++)
+        {
+            size_t nLength = strlen(SynthTags[i].szTagName) + 1;
+
+            memcpy(pbDownloadPtr, SynthTags[i].szTagName, nLength);
+            ConvertIntegerToBytes_BE(SynthTags[i].TagValue, pbDownloadPtr + nLength, sizeof(USHORT));
+            pbDownloadPtr += nLength + sizeof(USHORT);
+
+            for(DWORD j = 0, dwEntry = 0; j < Files.ItemCount(); j++)
+            {
+                if(IsListedFile(j))
+                {
+                    if(FileHasTag(j, i))
+                        pbDownloadPtr[dwEntry / 8] |= (BYTE)(0x80 >> (dwEntry % 8));
+                    dwEntry++;
+                }
+            }
+            pbDownloadPtr += cbBitmap;
+        }
+
+        dwErrCode = StoreManifest(DownloadFile, pbDownloadFile, cbDownloadFile, SYNTH_MODE_ZLIB);
+        CASC_FREE(pbDownloadFile);
+        return dwErrCode;
+    }
+
+    // INSTALL: header, tags with a bitmap of entries, then the entries (name, CKey, content size).
+    // The tags have the same format as in DOWNLOAD
+    DWORD WriteInstallFile()
+    {
+        PFILE_INSTALL_HEADER pHeader;
+        LPBYTE pbInstallFile;
+        LPBYTE pbInstallPtr;
+        DWORD dwFileCount = GetListedFileCount();
+        DWORD cbBitmap = (dwFileCount + 7) / 8;
+        DWORD cbInstallFile = sizeof(FILE_INSTALL_HEADER);
+        DWORD dwErrCode;
+        char szFileName[MAX_PATH];
+
+        for(DWORD i = 0; i < SYNTH_INSTALL_TAG_COUNT; i++)
+            cbInstallFile += (DWORD)strlen(GetTagName(GetInstallTag(i))) + 1 + sizeof(USHORT) + cbBitmap;
+        for(DWORD i = 0; i < Files.ItemCount(); i++)
+        {
+            GetFileName(szFileName, _countof(szFileName), i);
+            cbInstallFile += IsListedFile(i) ? (DWORD)strlen(szFileName) + 1 + MD5_HASH_SIZE + sizeof(DWORD) : 0;
+        }
+        if((pbInstallFile = CASC_ALLOC_ZERO<BYTE>(cbInstallFile)) == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+
+        // File header
+        pHeader = (PFILE_INSTALL_HEADER)pbInstallFile;
+        pHeader->Magic = FILE_MAGIC_INSTALL;
+        pHeader->Version = 1;
+        pHeader->EKeyLength = MD5_HASH_SIZE;
+        ConvertIntegerToBytes_BE(SYNTH_INSTALL_TAG_COUNT, pHeader->TagCount, 2);
+        ConvertIntegerToBytes_4(dwFileCount, pHeader->EntryCount);
+        pbInstallPtr = pbInstallFile + sizeof(FILE_INSTALL_HEADER);
+
+        // Tags
+        for(DWORD i = 0; i < SYNTH_INSTALL_TAG_COUNT; i++)
+        {
+            DWORD dwTagIndex = GetInstallTag(i);
+            size_t nLength = strlen(GetTagName(dwTagIndex)) + 1;
+
+            memcpy(pbInstallPtr, GetTagName(dwTagIndex), nLength);
+            ConvertIntegerToBytes_BE(SynthTags[dwTagIndex].TagValue, pbInstallPtr + nLength, sizeof(USHORT));
+            pbInstallPtr += nLength + sizeof(USHORT);
+
+            for(DWORD j = 0, dwEntry = 0; j < Files.ItemCount(); j++)
+            {
+                if(IsListedFile(j))
+                {
+                    if(FileHasTag(j, dwTagIndex))
+                        pbInstallPtr[dwEntry / 8] |= (BYTE)(0x80 >> (dwEntry % 8));
+                    dwEntry++;
+                }
+            }
+            pbInstallPtr += cbBitmap;
+        }
+
+        // Entries
+        for(DWORD i = 0; i < Files.ItemCount(); i++)
+        {
+            if(IsListedFile(i))
+            {
+                GetFileName(szFileName, _countof(szFileName), i);
+                memcpy(pbInstallPtr, szFileName, strlen(szFileName) + 1);
+                pbInstallPtr += strlen(szFileName) + 1;
+                memcpy(pbInstallPtr, FileAt(i)->CKey, MD5_HASH_SIZE);
+                ConvertIntegerToBytes_4(FileAt(i)->ContentSize, pbInstallPtr + MD5_HASH_SIZE);
+                pbInstallPtr += MD5_HASH_SIZE + sizeof(DWORD);
+            }
+        }
+
+        dwErrCode = StoreManifest(InstallFile, pbInstallFile, cbInstallFile, SYNTH_MODE_ZLIB);
+        CASC_FREE(pbInstallFile);
+        return dwErrCode;
+    }
+
+    // ENCODING with CKey pages only. CascLib doesn't need the EKey pages
+    DWORD WriteEncodingFile()
+    {
+        static const char szESpec[] = "z";
+        PFILE_ENCODING_HEADER pHeader;
+        PFILE_CKEY_PAGE pEKeyPageHeader;
+        PFILE_CKEY_PAGE pPageHeader;
+        SYNTH_FILE * SortedFiles;
+        LPBYTE pbEncodingFile;
+        LPBYTE pbPage;
+        DWORD dwEntryCount = GetListedFileCount() + ((Params.bInstallRoot) ? 3 : 2);
+        DWORD dwEntriesPerPage = SYNTH_CKEY_PAGE_SIZE / sizeof(FILE_CKEY_ENTRY);
+        DWORD dwPageCount = (dwEntryCount + dwEntriesPerPage - 1) / dwEntriesPerPage;
+        DWORD dwESpecsPerPage = SYNTH_CKEY_PAGE_SIZE / sizeof(FILE_ESPEC_ENTRY);
+        DWORD dwEKeyPageCount = (dwEntryCount + dwESpecsPerPage - 1) / dwESpecsPerPage;
+        DWORD cbEncodingFile = sizeof(FILE_ENCODING_HEADER) + sizeof(szESpec) + (dwPageCount + dwEKeyPageCount) * (sizeof(FILE_CKEY_PAGE) + SYNTH_CKEY_PAGE_SIZE);
+        DWORD dwErrCode;
+
+        // The entries must be sorted by CKey. ROOT, DOWNLOAD and INSTALL are there as well
+        if((SortedFiles = CASC_ALLOC<SYNTH_FILE>(dwEntryCount)) == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+        for(DWORD i = 0, dwEntry = 0; i < Files.ItemCount(); i++)
+        {
+            if(IsListedFile(i))
+                SortedFiles[dwEntry++] = FileAt(i)[0];
+        }
+        SortedFiles[GetListedFileCount()] = RootFile;
+        SortedFiles[GetListedFileCount() + 1] = DownloadFile;
+        if(Params.bInstallRoot)
+            SortedFiles[GetListedFileCount() + 2] = InstallFile;
+        qsort(SortedFiles, dwEntryCount, sizeof(SYNTH_FILE), CompareCKeys);
+
+        if((pbEncodingFile = CASC_ALLOC_ZERO<BYTE>(cbEncodingFile)) == NULL)
+        {
+            CASC_FREE(SortedFiles);
+            return ERROR_NOT_ENOUGH_MEMORY;
+        }
+
+        // File header
+        pHeader = (PFILE_ENCODING_HEADER)pbEncodingFile;
+        pHeader->Magic = FILE_MAGIC_ENCODING;
+        pHeader->Version = 1;
+        pHeader->CKeyLength = MD5_HASH_SIZE;
+        pHeader->EKeyLength = MD5_HASH_SIZE;
+        ConvertIntegerToBytes_BE(SYNTH_CKEY_PAGE_SIZE / 1024, pHeader->CKeyPageSize, 2);
+        ConvertIntegerToBytes_BE(SYNTH_CKEY_PAGE_SIZE / 1024, pHeader->EKeyPageSize, 2);
+        ConvertIntegerToBytes_4(dwPageCount, pHeader->CKeyPageCount);
+        ConvertIntegerToBytes_4(dwEKeyPageCount, pHeader->EKeyPageCount);
+        ConvertIntegerToBytes_4(sizeof(szESpec), pHeader->ESpecBlockSize);
+        memcpy(pHeader + 1, szESpec, sizeof(szESpec));
+
+        // Page headers, followed by the pages. Entries don't cross the page boundary
+        pPageHeader = (PFILE_CKEY_PAGE)(pbEncodingFile + sizeof(FILE_ENCODING_HEADER) + sizeof(szESpec));
+        pbPage = (LPBYTE)(pPageHeader + dwPageCount);
+        for(DWORD i = 0; i < dwPageCount; i++, pbPage += SYNTH_CKEY_PAGE_SIZE)
+        {
+            PFILE_CKEY_ENTRY pEntry = (PFILE_CKEY_ENTRY)pbPage;
+            DWORD dwFirst = i * dwEntriesPerPage;
+            DWORD dwLast = CASCLIB_MIN(dwFirst + dwEntriesPerPage, dwEntryCount);
+
+            for(DWORD j = dwFirst; j < dwLast; j++, pEntry++)
+            {
+                // EKeyCount is one byte followed by the high byte of the 40-bit content size (zero)
+                ((LPBYTE)&pEntry->EKeyCount)[0] = 1;
+                ((LPBYTE)&pEntry->EKeyCount)[1] = 0;
+                ConvertIntegerToBytes_4(SortedFiles[j].ContentSize, pEntry->ContentSize);
+                memcpy(pEntry->CKey, SortedFiles[j].CKey, MD5_HASH_SIZE);
+                memcpy(pEntry->EKey, SortedFiles[j].EKey, MD5_HASH_SIZE);
+            }
+
+            memcpy(pPageHeader[i].FirstKey, SortedFiles[dwFirst].CKey, MD5_HASH_SIZE);
+            CascCalculateDataBlockHash(pbPage, SYNTH_CKEY_PAGE_SIZE, pPageHeader[i].SegmentHash);
+        }
+        if(Params.dwDamage & SYNTH_DAMAGE_ENCODING_PAGE)
+            pPageHeader[0].SegmentHash[0] ^= 0xFF;
+
+        // EKey pages follow, sorted by EKey. They give the encoded size (without the local header) of each file
+        qsort(SortedFiles, dwEntryCount, sizeof(SYNTH_FILE), CompareEKeys);
+        pEKeyPageHeader = (PFILE_CKEY_PAGE)pbPage;
+        pbPage = (LPBYTE)(pEKeyPageHeader + dwEKeyPageCount);
+        for(DWORD i = 0; i < dwEKeyPageCount; i++, pbPage += SYNTH_CKEY_PAGE_SIZE)
+        {
+            PFILE_ESPEC_ENTRY pEntry = (PFILE_ESPEC_ENTRY)pbPage;
+            DWORD dwFirst = i * dwESpecsPerPage;
+            DWORD dwLast = CASCLIB_MIN(dwFirst + dwESpecsPerPage, dwEntryCount);
+
+            // All files use the first (and only) ESpec string
+            for(DWORD j = dwFirst; j < dwLast; j++, pEntry++)
+            {
+                memcpy(pEntry->ESpecKey, SortedFiles[j].EKey, MD5_HASH_SIZE);
+                ConvertIntegerToBytes_4(0, pEntry->ESpecIndexBE);
+                ConvertIntegerToBytes_BE(SortedFiles[j].EncodedSize - BLTE_HEADER_DELTA, pEntry->FileSizeBE, 5);
+            }
+
+            memcpy(pEKeyPageHeader[i].FirstKey, SortedFiles[dwFirst].EKey, MD5_HASH_SIZE);
+            CascCalculateDataBlockHash(pbPage, SYNTH_CKEY_PAGE_SIZE, pEKeyPageHeader[i].SegmentHash);
+        }
+
+        // Remember which pages were in the previous build, then replace the page hashes
+        EncodingPageCount = dwPageCount;
+        UnchangedPageCount = 0;
+        for(DWORD i = 0; i < dwPageCount; i++)
+        {
+            for(size_t j = 0; j < PageHashes.ItemCount(); j++)
+            {
+                if(!memcmp(pPageHeader[i].SegmentHash, PageHashes.ItemAt(j), MD5_HASH_SIZE))
+                {
+                    UnchangedPageCount++;
+                    break;
+                }
+            }
+        }
+        PageHashes.Reset();
+        for(DWORD i = 0; i < dwPageCount; i++)
+        {
+            if(PageHashes.Insert(pPageHeader[i].SegmentHash, 1) == NULL)
+            {
+                CASC_FREE(pbEncodingFile);
+                CASC_FREE(SortedFiles);
+                return ERROR_NOT_ENOUGH_MEMORY;
+            }
+        }
+
+        dwErrCode = StoreManifest(EncodingFile, pbEncodingFile, cbEncodingFile, SYNTH_MODE_NORMAL);
+        CASC_FREE(pbEncodingFile);
+        CASC_FREE(SortedFiles);
+        return dwErrCode;
+    }
+
+    // Returns the encoded size of the n-th entry for the index files. Differs from the real size in a damaged storage
+    DWORD GetIndexSize(DWORD dwEntryIndex, SYNTH_FILE * pFile)
+    {
+        if((Params.dwDamage & SYNTH_DAMAGE_INDEX_SIZE) && dwEntryIndex == 1)
+            return pFile->EncodedSize - 1;
+        if((Params.dwDamage & SYNTH_DAMAGE_OVERLAP) && dwEntryIndex == 2 && Files.ItemCount() > 4)
+            return pFile->EncodedSize + FileAt(3)->EncodedSize + FileAt(4)->EncodedSize / 2;
+        return pFile->EncodedSize;
+    }
+
+    DWORD WriteIndexFile(DWORD dwBucket, PFILE_EKEY_ENTRY pEntries, DWORD dwEntryCount)
+    {
+        PFILE_INDEX_GUARDED_BLOCK pBlock;
+        PFILE_INDEX_HEADER_V2 pHeader;
+        TFileStream * pStream;
+        ULONGLONG ByteOffset = 0;
+        LPBYTE pbIndexFile;
+        TCHAR szPlainName[0x20];
+        TCHAR szIndexFile[MAX_PATH];
+        DWORD cbEntries = dwEntryCount * sizeof(FILE_EKEY_ENTRY);
+        DWORD cbIndexFile = (DWORD)ALIGN_TO_SIZE(0x28 + cbEntries, SYNTH_INDEX_ALIGNMENT);
+        DWORD dwErrCode = ERROR_SUCCESS;
+        unsigned int HashHigh = 0;
+        unsigned int HashLow = 0;
+
+        if((pbIndexFile = CASC_ALLOC_ZERO<BYTE>(cbIndexFile)) == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+
+        // Guarded header
+        pBlock = (PFILE_INDEX_GUARDED_BLOCK)pbIndexFile;
+        pHeader = (PFILE_INDEX_HEADER_V2)(pBlock + 1);
+        pHeader->IndexVersion = 0x07;
+        pHeader->BucketIndex = (BYTE)dwBucket;
+        pHeader->ExtraBytes = 0;
+        pHeader->EncodedSizeLength = 4;
+        pHeader->StorageOffsetLength = 5;
+        pHeader->EKeyLength = CASC_EKEY_SIZE;
+        pHeader->FileOffsetBits = SYNTH_FILE_OFFSET_BITS;
+        pHeader->SegmentSize = SYNTH_SEGMENT_SIZE;
+        pBlock->BlockSize = sizeof(FILE_INDEX_HEADER_V2);
+        pBlock->BlockHash = hashlittle(pHeader, sizeof(FILE_INDEX_HEADER_V2), 0);
+
+        // Guarded block of entries at 0x20. The hash is calculated entry by entry.
+        // An empty bucket has zero-sized block, followed by empty pages
+        pBlock = (PFILE_INDEX_GUARDED_BLOCK)(pbIndexFile + 0x20);
+        memcpy(pBlock + 1, pEntries, cbEntries);
+        for(DWORD i = 0; i < dwEntryCount; i++)
+            hashlittle2(pEntries + i, sizeof(FILE_EKEY_ENTRY), &HashHigh, &HashLow);
+        pBlock->BlockSize = cbEntries;
+        pBlock->BlockHash = (dwEntryCount != 0) ? HashHigh : 0;
+
+        // Write the index file
+        CascStrPrintf(szPlainName, _countof(szPlainName), _T("%02x%08x.idx"), dwBucket, IndexSubIndex[dwBucket]);
+        CombinePath(szIndexFile, _countof(szIndexFile), Params.szStoragePath, _T("data"), _T("data"), szPlainName, NULL);
+        if((pStream = FileStream_CreateFile(szIndexFile, BASE_PROVIDER_FILE | STREAM_PROVIDER_FLAT)) != NULL)
+        {
+            if(!FileStream_Write(pStream, &ByteOffset, pbIndexFile, cbIndexFile))
+                dwErrCode = GetCascError();
+            FileStream_Close(pStream);
+        }
+        else
+        {
+            dwErrCode = GetCascError();
+        }
+
+        CASC_FREE(pbIndexFile);
+        return dwErrCode;
+    }
+
+    DWORD WriteIndexFiles()
+    {
+        PFILE_EKEY_ENTRY BucketEntries[CASC_INDEX_COUNT];
+        DWORD BucketCounts[CASC_INDEX_COUNT] = {0};
+        DWORD dwFileCount = (DWORD)(Files.ItemCount() + StagedFiles.ItemCount());
+        DWORD dwEntryCount = dwFileCount + ((Params.bInstallRoot) ? 4 : 3);
+        DWORD dwErrCode = ERROR_SUCCESS;
+
+        // Worst case: all entries are in one bucket
+        for(DWORD i = 0; i < CASC_INDEX_COUNT; i++)
+            BucketEntries[i] = NULL;
+        for(DWORD i = 0; i < CASC_INDEX_COUNT && dwErrCode == ERROR_SUCCESS; i++)
+        {
+            if((BucketEntries[i] = CASC_ALLOC<FILE_EKEY_ENTRY>(dwEntryCount)) == NULL)
+                dwErrCode = ERROR_NOT_ENOUGH_MEMORY;
+        }
+
+        // Distribute the entries (files + staged files + ROOT + DOWNLOAD + ENCODING + INSTALL) to the buckets
+        if(dwErrCode == ERROR_SUCCESS)
+        {
+            SYNTH_FILE * Manifests[4] = {&RootFile, &DownloadFile, &EncodingFile, &InstallFile};
+
+            for(DWORD i = 0; i < dwEntryCount; i++)
+            {
+                SYNTH_FILE * pFile;
+
+                if(i < Files.ItemCount())
+                    pFile = FileAt(i);
+                else if(i < dwFileCount)
+                    pFile = (SYNTH_FILE *)StagedFiles.ItemAt(i - Files.ItemCount());
+                else
+                    pFile = Manifests[i - dwFileCount];
+                DWORD dwBucket = GetEKeyBucketIndex(pFile->EKey);
+                PFILE_EKEY_ENTRY pEntry = &BucketEntries[dwBucket][BucketCounts[dwBucket]++];
+
+                memcpy(pEntry->EKey, pFile->EKey, CASC_EKEY_SIZE);
+                ConvertIntegerToBytes_BE(pFile->StorageOffset, pEntry->FileOffsetBE, 5);
+                ConvertIntegerToBytes_4_LE(GetIndexSize(i, pFile), pEntry->EncodedSize);
+            }
+
+            // Each index file is sorted by EKey. An index file with the same entries
+            // as in the previous build is left as-is
+            UnchangedIndexCount = 0;
+            for(DWORD i = 0; i < CASC_INDEX_COUNT && dwErrCode == ERROR_SUCCESS; i++)
+            {
+                BYTE IndexHash[MD5_HASH_SIZE];
+
+                qsort(BucketEntries[i], BucketCounts[i], sizeof(FILE_EKEY_ENTRY), CompareEKeyEntries);
+                CascCalculateDataBlockHash(BucketEntries[i], BucketCounts[i] * sizeof(FILE_EKEY_ENTRY), IndexHash);
+                IndexUnchanged[i] = (IndexSubIndex[i] != 0 && !memcmp(IndexHashes[i], IndexHash, MD5_HASH_SIZE));
+
+                if(IndexUnchanged[i] == false)
+                {
+                    memcpy(IndexHashes[i], IndexHash, MD5_HASH_SIZE);
+                    IndexSubIndex[i]++;
+                    dwErrCode = WriteIndexFile(i, BucketEntries[i], BucketCounts[i]);
+                }
+                else
+                {
+                    UnchangedIndexCount++;
+                }
+            }
+        }
+
+        for(DWORD i = 0; i < CASC_INDEX_COUNT; i++)
+            CASC_FREE(BucketEntries[i]);
+        return dwErrCode;
+    }
+
+    // Writes a file to "<directory>/xx/yy/<key><extension>"
+    DWORD WriteKeyedFile(LPCTSTR szDirectory, LPBYTE FileKey, const void * pvData, DWORD cbData, LPCTSTR szExtension)
+    {
+        TFileStream * pStream;
+        ULONGLONG ByteOffset = 0;
+        TCHAR szPath[MAX_PATH];
+        TCHAR szPlainName[MD5_STRING_SIZE + 0x10];
+        TCHAR szHash[MD5_STRING_SIZE + 1];
+        TCHAR szSubDir1[3];
+        TCHAR szSubDir2[3];
+        DWORD dwErrCode = ERROR_SUCCESS;
+
+        StringFromBinary(FileKey, MD5_HASH_SIZE, szHash);
+        CascStrPrintf(szPlainName, _countof(szPlainName), _T("%s%s"), szHash, (szExtension != NULL) ? szExtension : _T(""));
+        CascStrCopy(szSubDir1, _countof(szSubDir1), szHash, 2);
+        CascStrCopy(szSubDir2, _countof(szSubDir2), szHash + 2, 2);
+
+        // Create the subdirectories
+        CombinePath(szPath, _countof(szPath), szDirectory, szSubDir1, NULL);
+        MakeDirectory(szPath);
+        CombinePath(szPath, _countof(szPath), szDirectory, szSubDir1, szSubDir2, NULL);
+        MakeDirectory(szPath);
+        CombinePath(szPath, _countof(szPath), szDirectory, szSubDir1, szSubDir2, szPlainName, NULL);
+
+        if((pStream = FileStream_CreateFile(szPath, BASE_PROVIDER_FILE | STREAM_PROVIDER_FLAT)) != NULL)
+        {
+            if(!FileStream_Write(pStream, &ByteOffset, pvData, cbData))
+                dwErrCode = GetCascError();
+            FileStream_Close(pStream);
+            return dwErrCode;
+        }
+
+        return GetCascError();
+    }
+
+    // Writes a config file to "data/config/xx/yy/<md5>" and to the CDN tree.
+    // The name is the MD5 of the content
+    DWORD WriteConfigFile(const char * szContent, LPBYTE ConfigKey)
+    {
+        TCHAR szConfigDir[MAX_PATH];
+        DWORD cbContent = (DWORD)strlen(szContent);
+        DWORD dwErrCode;
+
+        CascCalculateDataBlockHash((void *)szContent, cbContent, ConfigKey);
+        CombinePath(szConfigDir, _countof(szConfigDir), Params.szStoragePath, _T("data"), _T("config"), NULL);
+        dwErrCode = WriteKeyedFile(szConfigDir, ConfigKey, szContent, cbContent, NULL);
+
+        if(dwErrCode == ERROR_SUCCESS && Params.dwCdnPort != 0)
+            dwErrCode = WriteKeyedFile(szCdnConfigDir, ConfigKey, szContent, cbContent, NULL);
+        return dwErrCode;
+    }
+
+    DWORD WriteTextFile(LPCTSTR szDirectory, LPCTSTR szPlainName, const char * szContent)
+    {
+        TFileStream * pStream;
+        ULONGLONG ByteOffset = 0;
+        TCHAR szPath[MAX_PATH];
+        DWORD dwErrCode = ERROR_SUCCESS;
+
+        CombinePath(szPath, _countof(szPath), szDirectory, szPlainName, NULL);
+        if((pStream = FileStream_CreateFile(szPath, BASE_PROVIDER_FILE | STREAM_PROVIDER_FLAT)) != NULL)
+        {
+            if(!FileStream_Write(pStream, &ByteOffset, szContent, (DWORD)strlen(szContent)))
+                dwErrCode = GetCascError();
+            FileStream_Close(pStream);
+            return dwErrCode;
+        }
+
+        return GetCascError();
+    }
+
+    DWORD WriteConfigsAndBuildInfo()
+    {
+        BYTE BuildKey[MD5_HASH_SIZE];
+        BYTE CdnKey[MD5_HASH_SIZE];
+        TCHAR szPath[MAX_PATH];
+        char szRootCKey[MD5_STRING_SIZE + 1];
+        char szRootEKey[MD5_STRING_SIZE + 1];
+        char szEncodingCKey[MD5_STRING_SIZE + 1];
+        char szEncodingEKey[MD5_STRING_SIZE + 1];
+        char szDownloadCKey[MD5_STRING_SIZE + 1];
+        char szDownloadEKey[MD5_STRING_SIZE + 1];
+        char szInstallCKey[MD5_STRING_SIZE + 1];
+        char szInstallEKey[MD5_STRING_SIZE + 1];
+        char szBuildKey[MD5_STRING_SIZE + 1];
+        char szCdnKey[MD5_STRING_SIZE + 1];
+        char szText[0x800];
+        DWORD dwBuildNumber = 90000 + (Params.dwSeed % 10000);
+        DWORD dwErrCode;
+
+        // Build config. Only ROOT, ENCODING, DOWNLOAD and (optionally) INSTALL are present
+        StringFromBinary(RootFile.CKey, MD5_HASH_SIZE, szRootCKey);
+        StringFromBinary(EncodingFile.CKey, MD5_HASH_SIZE, szEncodingCKey);
+        StringFromBinary(EncodingFile.EKey, MD5_HASH_SIZE, szEncodingEKey);
+        StringFromBinary(DownloadFile.CKey, MD5_HASH_SIZE, szDownloadCKey);
+        StringFromBinary(DownloadFile.EKey, MD5_HASH_SIZE, szDownloadEKey);
+        CascStrPrintf(szText, _countof(szText),
+            "# Build Configuration\n"
+            "\n"
+            "root = %s\n"
+            "encoding = %s %s\n"
+            "encoding-size = %u %u\n"
+            "download = %s %s\n"
+            "download-size = %u %u\n"
+            "build-name = WOW-%upatch9.9.9_Synthetic\n"
+            "build-uid = wow\n"
+            "build-product = WoW\n",
+            szRootCKey,
+            szEncodingCKey, szEncodingEKey,
+            EncodingFile.ContentSize, EncodingFile.EncodedSize - FIELD_OFFSET(BLTE_ENCODED_HEADER, Signature),
+            szDownloadCKey, szDownloadEKey,
+            DownloadFile.ContentSize, DownloadFile.EncodedSize - FIELD_OFFSET(BLTE_ENCODED_HEADER, Signature),
+            dwBuildNumber);
+
+        // The INSTALL manifest, if the file names are there
+        if(Params.bInstallRoot)
+        {
+            size_t nLength = strlen(szText);
+
+            StringFromBinary(InstallFile.CKey, MD5_HASH_SIZE, szInstallCKey);
+            StringFromBinary(InstallFile.EKey, MD5_HASH_SIZE, szInstallEKey);
+            CascStrPrintf(szText + nLength, _countof(szText) - nLength,
+                "install = %s %s\n"
+                "install-size = %u %u\n",
+                szInstallCKey, szInstallEKey,
+                InstallFile.ContentSize, InstallFile.EncodedSize - FIELD_OFFSET(BLTE_ENCODED_HEADER, Signature));
+        }
+
+        // The TVFS root is given by "vfs-root", which takes precedence over "root"
+        if(Params.bTvfsRoot)
+        {
+            size_t nLength = strlen(szText);
+
+            StringFromBinary(RootFile.EKey, MD5_HASH_SIZE, szRootEKey);
+            CascStrPrintf(szText + nLength, _countof(szText) - nLength,
+                "vfs-root = %s %s\n"
+                "vfs-root-size = %u %u\n",
+                szRootCKey, szRootEKey,
+                RootFile.ContentSize, RootFile.EncodedSize - FIELD_OFFSET(BLTE_ENCODED_HEADER, Signature));
+        }
+        if((dwErrCode = WriteConfigFile(szText, BuildKey)) != ERROR_SUCCESS)
+            return dwErrCode;
+
+        // CDN config
+        if((dwErrCode = WriteCdnConfig(CdnKey)) != ERROR_SUCCESS)
+            return dwErrCode;
+
+        // The .build.info
+        StringFromBinary(BuildKey, MD5_HASH_SIZE, szBuildKey);
+        StringFromBinary(CdnKey, MD5_HASH_SIZE, szCdnKey);
+        CascStrPrintf(szText, _countof(szText),
+            "Branch!STRING:0|Active!DEC:1|Build Key!HEX:16|CDN Key!HEX:16|Install Key!HEX:16|IM Size!DEC:4|CDN Path!STRING:0|CDN Hosts!STRING:0|CDN Servers!STRING:0|Tags!STRING:0|Armadillo!STRING:0|Last Activated!STRING:0|Version!STRING:0|Product!STRING:0\n"
+            "us|1|%s|%s||||||Windows x86_64 US? enUS speech?:Windows x86_64 US? enUS text?|||9.9.9.%u|wow\n",
+            szBuildKey, szCdnKey, dwBuildNumber);
+        if((dwErrCode = WriteTextFile(Params.szStoragePath, _T(".build.info"), szText)) != ERROR_SUCCESS)
+            return dwErrCode;
+        if(Params.dwCdnPort == 0)
+            return ERROR_SUCCESS;
+
+        // The "versions" and "cdns" files of the CDN. Both hosts point to the mock CDN server,
+        // so that CascLib has a second server to try when a download fails
+        CombinePath(szPath, _countof(szPath), Params.szStoragePath, _T("cdn"), SYNTH_CDN_PRODUCT, NULL);
+        CascStrPrintf(szText, _countof(szText),
+            "Region!STRING:0|BuildConfig!HEX:16|CDNConfig!HEX:16|KeyRing!HEX:16|BuildId!DEC:4|VersionsName!String:0|ProductConfig!HEX:16\n"
+            "us|%s|%s||%u|9.9.9.%u|\n",
+            szBuildKey, szCdnKey, dwBuildNumber, dwBuildNumber);
+        if((dwErrCode = WriteTextFile(szPath, _T("versions"), szText)) != ERROR_SUCCESS)
+            return dwErrCode;
+
+        CascStrPrintf(szText, _countof(szText),
+            "Name!STRING:0|Path!STRING:0|Hosts!STRING:0|Servers!STRING:0|ConfigPath!STRING:0\n"
+            "us|%s|127.0.0.1:%u localhost:%u|http://127.0.0.1:%u/?maxhosts=4|tpr/configs/data\n",
+            SYNTH_CDN_PATH, Params.dwCdnPort, Params.dwCdnPort, Params.dwCdnPort);
+        return WriteTextFile(szPath, _T("cdns"), szText);
+    }
+
+    // The CDN config lists all CDN archives
+    DWORD WriteCdnConfig(LPBYTE CdnKey)
+    {
+        BYTE ArchiveKey[MD5_HASH_SIZE];
+        char * szText;
+        char * szTextPtr;
+        size_t nArchiveCount = ArchiveKeys.ItemCount();
+        size_t cchText = 0x100 + nArchiveCount * (MD5_STRING_SIZE + 1);
+        DWORD dwErrCode;
+
+        if((szText = szTextPtr = CASC_ALLOC<char>(cchText)) == NULL)
+            return ERROR_NOT_ENOUGH_MEMORY;
+        szTextPtr += CascStrPrintf(szTextPtr, cchText, "# CDN Configuration\n\narchives =");
+
+        // Without the CDN tree, there is one fake archive
+        if(nArchiveCount == 0)
+        {
+            CascCalculateDataBlockHash((void *)"synthetic archive", 17, ArchiveKey);
+            *szTextPtr++ = ' ';
+            StringFromBinary(ArchiveKey, MD5_HASH_SIZE, szTextPtr);
+            szTextPtr += MD5_STRING_SIZE;
+        }
+
+        for(size_t i = 0; i < nArchiveCount; i++)
+        {
+            *szTextPtr++ = ' ';
+            StringFromBinary((LPBYTE)ArchiveKeys.ItemAt(i), MD5_HASH_SIZE, szTextPtr);
+            szTextPtr += MD5_STRING_SIZE;
+        }
+        CascStrCopy(szTextPtr, cchText - (szTextPtr - szText), "\n");
+
+        dwErrCode = WriteConfigFile(szText, CdnKey);
+        CASC_FREE(szText);
+        return dwErrCode;
+    }
+
+    // Plain listfile. CascLib only recognizes the CSV format ("FileDataId;FileName")
+    // in listfiles greater than 1 MB, so the names are resolved by their hashes
+    DWORD WriteListFile()
+    {
+        TFileStream * pStream;
+        ULONGLONG ByteOffset = 0;
+        TCHAR szPath[MAX_PATH];
+        char szLine[MAX_PATH + 1];
+        char szFileName[MAX_PATH];
+        DWORD dwErrCode = ERROR_SUCCESS;
+
+        CombinePath(szPath, _countof(szPath), Params.szStoragePath, _T("listfile.txt"), NULL);
+        if((pStream = FileStream_CreateFile(szPath, BASE_PROVIDER_FILE | STREAM_PROVIDER_FLAT)) == NULL)
+            return GetCascError();
+
+        for(DWORD i = 0; i < Files.ItemCount(); i++)
+        {
+            // The spans of multi-span files have no names
+            if(Params.bTvfsRoot && IsSpanFile(i, (DWORD)Files.ItemCount()))
+                continue;
+
+            if(Params.bTvfsRoot)
+                GetTvfsFileName(szFileName, _countof(szFileName), i);
+            else
+                GetFileName(szFileName, _countof(szFileName), i);
+            size_t nLength = CascStrPrintf(szLine, _countof(szLine), "%s\n", szFileName);
+
+            if(!FileStream_Write(pStream, &ByteOffset, szLine, (DWORD)nLength))
+            {
+                dwErrCode = GetCascError();
+                break;
+            }
+            ByteOffset += nLength;
+        }
+
+        FileStream_Close(pStream);
+        return dwErrCode;
+    }
+
+    static LPBYTE WriteDword(LPBYTE pbBuffer, DWORD dwValue)
+    {
+        memcpy(pbBuffer, &dwValue, sizeof(DWORD));
+        return pbBuffer + sizeof(DWORD);
+    }
+
+    // Same layout as FILE_ROOT_HEADER_82 in CascRootFile_WoW.cpp
+    struct FILE_ROOT_HEADER
+    {
+        DWORD Signature;
+        DWORD TotalFiles;
+        DWORD FilesWithNameHash;
+    };
+
+    SYNTH_PARAMS Params;
+    CASC_ARRAY Files;                               // Array of SYNTH_FILE
+    CASC_ARRAY StagedFiles;                         // Array of SYNTH_FILE that are stored, but not in the build yet
+    CASC_ARRAY PageHashes;                          // Segment hashes of the ENCODING pages of the last build
+    CASC_ARRAY ArchiveEntries;                      // Array of SYNTH_ARCHIVE_ENTRY in the current CDN archive
+    CASC_ARRAY ArchiveKeys;                         // Keys of all finished CDN archives
+    SYNTH_FILE RootFile;
+    SYNTH_FILE EncodingFile;
+    SYNTH_FILE DownloadFile;
+    SYNTH_FILE InstallFile;
+    TCascStorage * hsCrypt;                         // Dummy storage with the encryption keys
+    TFileStream * pDataFile;                        // The currently written data.### file
+    ULONGLONG DataFileOffset;                       // Write position in the current data file
+    ULONGLONG RandomState;
+    LPBYTE pbContent;                               // Buffer for the file content
+    LPBYTE pbEncoded;                               // Buffer for BLTE_ENCODED_HEADER + BLTE data
+    LPBYTE pbFrame;                                 // Work buffer for encrypted frames
+    LPBYTE pbArchive;                               // Buffer for the current CDN archive
+    DWORD cbArchive;                                // Size of the current CDN archive
+    TCHAR szCdnConfigDir[MAX_PATH];                 // "cdn/tpr/synth/config" in the storage directory
+    TCHAR szCdnDataDir[MAX_PATH];                   // "cdn/tpr/synth/data" in the storage directory
+    DWORD DataFileIndex;                            // Index of the current data file
+    DWORD IndexSubIndex[CASC_INDEX_COUNT];          // Sub-index of the last written index file of each bucket
+    BYTE IndexHashes[CASC_INDEX_COUNT][MD5_HASH_SIZE];  // MD5 of the entries of the last written index file of each bucket
+    bool IndexUnchanged[CASC_INDEX_COUNT];          // True if the last build didn't write the index file
+};